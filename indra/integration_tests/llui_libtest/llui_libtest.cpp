@@ -44,6 +44,7 @@
 #include "llfloater.h"
 #include "llfontfreetype.h"
 #include "llfontgl.h"
+#include "lltimer.h"
 #include "lltransutil.h"
 #include "llui.h"
 #include "lluictrlfactory.h"
@@ -209,6 +210,110 @@ void export_test_floaters()
 	}
 }
 
+// Builds a tree of plain views, fanout children per view down to depth.
+static void build_view_tree(LLView* parent, S32 fanout, S32 depth, std::vector<std::string>& leaf_names)
+{
+	for (S32 i = 0; i < fanout; ++i)
+	{
+		LLView::Params params;
+		params.name(llformat("%s_%d", parent->getName().c_str(), i));
+		params.rect(LLRect(0, 10, 10, 0));
+		LLView* view = LLUICtrlFactory::create<LLView>(params);
+		parent->addChild(view);
+		if (depth > 1)
+		{
+			build_view_tree(view, fanout, depth - 1, leaf_names);
+		}
+		else
+		{
+			leaf_names.push_back(view->getName());
+		}
+	}
+}
+
+// What findChildView(name, TRUE) did before it kept a cache.
+static LLView* find_child_view_uncached(LLView* parent, const std::string& name)
+{
+	const LLView::child_list_t* children = parent->getChildList();
+	for (LLView::child_list_const_iter_t it = children->begin(); it != children->end(); ++it)
+	{
+		if ((*it)->getName() == name)
+		{
+			return *it;
+		}
+	}
+	for (LLView::child_list_const_iter_t it = children->begin(); it != children->end(); ++it)
+	{
+		LLView* view = find_child_view_uncached(*it, name);
+		if (view)
+		{
+			return view;
+		}
+	}
+	return NULL;
+}
+
+// Times recursive findChildView() against a plain walk of the same tree.
+void benchmark_find_child_view()
+{
+	const S32 FANOUT = 4;
+	const S32 DEPTH = 6;
+	const S32 PASSES = 20;
+
+	LLView::Params params;
+	params.name("root");
+	params.rect(LLRect(0, 10, 10, 0));
+	LLView* root = LLUICtrlFactory::create<LLView>(params);
+	std::vector<std::string> leaf_names;
+	build_view_tree(root, FANOUT, DEPTH, leaf_names);
+
+	S32 misses = 0;
+	LLTimer timer;
+	for (S32 pass = 0; pass < PASSES; ++pass)
+	{
+		for (std::vector<std::string>::iterator it = leaf_names.begin(); it != leaf_names.end(); ++it)
+		{
+			if (!find_child_view_uncached(root, *it))
+			{
+				++misses;
+			}
+		}
+	}
+	F64 uncached_time = timer.getElapsedTimeF64();
+
+	// The first pass fills the lookup caches, the rest are served from them.
+	F64 first_pass_time = 0.0;
+	timer.reset();
+	for (S32 pass = 0; pass < PASSES; ++pass)
+	{
+		for (std::vector<std::string>::iterator it = leaf_names.begin(); it != leaf_names.end(); ++it)
+		{
+			if (!root->findChildView(*it, TRUE))
+			{
+				++misses;
+			}
+		}
+		if (pass == 0)
+		{
+			first_pass_time = timer.getElapsedTimeF64();
+		}
+	}
+	F64 cached_time = timer.getElapsedTimeF64();
+
+	S32 lookups = PASSES * (S32)leaf_names.size();
+	llinfos << "findChildView: " << lookups << " lookups of " << leaf_names.size()
+			<< " leaves, fanout " << FANOUT << " depth " << DEPTH
+			<< ": walk " << uncached_time * 1000.0 << " ms, findChildView "
+			<< cached_time * 1000.0 << " ms (first pass "
+			<< first_pass_time * 1000.0 << " ms)" << llendl;
+	if (misses)
+	{
+		llwarns << "findChildView: " << misses << " lookups failed" << llendl;
+	}
+
+	delete root;
+}
+
 int main(int argc, char** argv)
 {
 	// Must init LLError for llerrs to actually cause errors.
@@ -218,5 +323,7 @@ int main(int argc, char** argv)
 	
 	export_test_floaters();
 	
+	benchmark_find_child_view();
+
 	return 0;
 }
@@ -56,7 +56,9 @@ LLCharacter::LLCharacter()
 	mPreferredPelvisHeight( 0.f ),
 	mSex( SEX_FEMALE ),
 	mAppearanceSerialNum( 0 ),
-	mSkeletonSerialNum( 0 )
+	mSkeletonSerialNum( 0 ),
+	mEvaluatingMotions( false ),
+	mVisualParamsUpdatePending( false )
 {
 	mMotionController.setCharacter( this );
 	sInstances.push_back(this);
@@ -194,13 +196,55 @@ void LLCharacter::updateMotions(e_update_t update_type)
 	else
 	{
 		LLFastTimer t(FTM_UPDATE_ANIMATION);
+		beginUpdateMotions(update_type);
+		evaluateMotions();
+		endUpdateMotions();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// beginUpdateMotions()
+//-----------------------------------------------------------------------------
+void LLCharacter::beginUpdateMotions(e_update_t update_type)
+{
+	if (update_type == HIDDEN_UPDATE)
+	{
+		LLFastTimer t(FTM_UPDATE_HIDDEN_ANIMATION);
+		mMotionController.updateMotionsMinimal();
+	}
+	else
+	{
 		// unpause if the number of outstanding pause requests has dropped to the initial one
 		if (mMotionController.isPaused() && mPauseRequest->getNumRefs() == 1)
 		{
 			mMotionController.unpauseAllMotions();
 		}
 		bool force_update = (update_type == FORCE_UPDATE);
-		mMotionController.updateMotions(force_update);
+		mMotionController.beginUpdateMotions(force_update);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// evaluateMotions()
+//-----------------------------------------------------------------------------
+void LLCharacter::evaluateMotions()
+{
+	mEvaluatingMotions = true;
+	mMotionController.evaluateMotions();
+	mEvaluatingMotions = false;
+}
+
+//-----------------------------------------------------------------------------
+// endUpdateMotions()
+//-----------------------------------------------------------------------------
+void LLCharacter::endUpdateMotions()
+{
+	mMotionController.endUpdateMotions();
+
+	if (mVisualParamsUpdatePending)
+	{
+		mVisualParamsUpdatePending = false;
+		updateVisualParams();
 	}
 }
 
@@ -488,6 +532,23 @@ void LLCharacter::addVisualParam(LLVisualParam *param)
 	//llinfos << "Adding Visual Param '" << param->getName() << "' ( " << index << " )" << llendl;
 }
 
+//-----------------------------------------------------------------------------
+// requestVisualParamsUpdate()
+//-----------------------------------------------------------------------------
+void LLCharacter::requestVisualParamsUpdate()
+{
+	if (mEvaluatingMotions)
+	{
+		// updateVisualParams() applies morphs and, for avatars, touches
+		// the pipeline, none of which is safe off the main thread
+		mVisualParamsUpdatePending = true;
+	}
+	else
+	{
+		updateVisualParams();
+	}
+}
+
 //-----------------------------------------------------------------------------
 // updateVisualParams()
 //-----------------------------------------------------------------------------
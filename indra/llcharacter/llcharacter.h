@@ -131,6 +131,12 @@ public:
 	// updates all visual parameters for this character
 	virtual void updateVisualParams();
 
+	// Motions call this rather than updateVisualParams().  From
+	// evaluateMotions(), which may run off the main thread, the update is
+	// held for endUpdateMotions(); otherwise it happens right away.
+	void requestVisualParamsUpdate();
+	bool isVisualParamsUpdatePending() const { return mVisualParamsUpdatePending; }
+
 	virtual void addDebugText( const std::string& text ) = 0;
 
 	virtual const LLUUID&	getID() = 0;
@@ -169,6 +175,14 @@ public:
 	enum e_update_t { NORMAL_UPDATE, HIDDEN_UPDATE, FORCE_UPDATE };
 	void updateMotions(e_update_t update_type);
 
+	// updateMotions() split up for animating many characters in parallel,
+	// see LLMotionController::beginUpdateMotions().  The motions run by
+	// evaluateMotions() may only read state shared with other characters.
+	// endUpdateMotions() applies the visual params they changed.
+	void beginUpdateMotions(e_update_t update_type);	// MAIN THREAD
+	void evaluateMotions();
+	void endUpdateMotions();							// MAIN THREAD
+
 	LLAnimPauseRequest requestPause();
 	BOOL areAnimationsPaused() const { return mMotionController.isPaused(); }
 	void setAnimTimeFactor(F32 factor) { mMotionController.setTimeFactor(factor); }
@@ -273,6 +287,9 @@ protected:
 	U32					mAppearanceSerialNum;
 	U32					mSkeletonSerialNum;
 	LLAnimPauseRequest	mPauseRequest;
+	// only touched by the thread running this character's motions
+	bool				mEvaluatingMotions;
+	bool				mVisualParamsUpdatePending;
 
 
 private:
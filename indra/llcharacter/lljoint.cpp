@@ -40,8 +40,8 @@
 
 #include "llmath.h"
 
-S32 LLJoint::sNumUpdates = 0;
-S32 LLJoint::sNumTouches = 0;
+LLAtomicS32 LLJoint::sNumUpdates(0);
+LLAtomicS32 LLJoint::sNumTouches(0);
 
 //-----------------------------------------------------------------------------
 // LLJoint()
@@ -40,6 +40,7 @@
 #include <string>
 
 #include "linked_lists.h"
+#include "llapr.h"
 #include "v3math.h"
 #include "v4math.h"
 #include "m4math.h"
@@ -101,9 +102,9 @@ public:
 	typedef std::list<LLJoint*> child_list_t;
 	child_list_t mChildren;
 
-	// debug statics
-	static S32		sNumTouches;
-	static S32		sNumUpdates;
+	// debug statics, counted from the avatar update threads
+	static LLAtomicS32	sNumTouches;
+	static LLAtomicS32	sNumUpdates;
 
 public:
 	LLJoint();
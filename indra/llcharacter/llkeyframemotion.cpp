@@ -36,6 +36,8 @@
 //-----------------------------------------------------------------------------
 #include "linden_common.h"
 
+#include <algorithm>
+
 #include "llmath.h"
 #include "llanimationstates.h"
 #include "llassetstorage.h"
@@ -46,6 +48,7 @@
 #include "llendianswizzle.h"
 #include "llkeyframemotion.h"
 #include "llquantize.h"
+#include "llsys.h"
 #include "llvfile.h"
 #include "m3math.h"
 #include "message.h"
@@ -54,6 +57,7 @@
 // Static Definitions
 //-----------------------------------------------------------------------------
 LLVFS*				LLKeyframeMotion::sVFS = NULL;
+bool				LLKeyframeMotion::sVectorize = false;
 LLKeyframeDataCache::keyframe_data_map_t	LLKeyframeDataCache::sKeyframeDataMap;
 
 //-----------------------------------------------------------------------------
@@ -134,6 +138,89 @@ U32 LLKeyframeMotion::JointMotionList::dumpDiagInfo()
 //-----------------------------------------------------------------------------
 
 
+//-----------------------------------------------------------------------------
+// Key lookup, shared by the curve classes
+//-----------------------------------------------------------------------------
+template <class KEY>
+struct key_time_less
+{
+	bool operator()(const KEY& a, const KEY& b) const	{ return a.mTime < b.mTime; }
+	bool operator()(const KEY& a, F32 time) const		{ return a.mTime < time; }
+	bool operator()(F32 time, const KEY& b) const		{ return time < b.mTime; }
+};
+
+// Sorts keys by time.  Of several keys with the same time the last one
+// read wins, as it did when the keys were kept in a map.
+template <class KEY>
+static void sort_keys(std::vector<KEY>& keys)
+{
+	std::stable_sort(keys.begin(), keys.end(), key_time_less<KEY>());
+
+	S32 num_keys = 0;
+	for (S32 i = 0; i < (S32)keys.size(); i++)
+	{
+		if (num_keys && keys[num_keys - 1].mTime == keys[i].mTime)
+		{
+			keys[num_keys - 1] = keys[i];
+		}
+		else
+		{
+			keys[num_keys++] = keys[i];
+		}
+	}
+	keys.resize(num_keys);
+}
+
+// Returns the index of the first key at or after time, as lower_bound()
+// would.  Animations play forward a frame at a time, so the answer is
+// nearly always the one left in cursor last time or the next one.  Only
+// when neither fits (seeking, looping) is the array searched.
+template <class KEY>
+static S32 find_key(const std::vector<KEY>& keys, F32 time, S32& cursor)
+{
+	S32 num_keys = (S32)keys.size();
+	for (S32 i = llmax(cursor, 0); i <= cursor + 1 && i <= num_keys; i++)
+	{
+		if ((i == 0 || keys[i - 1].mTime < time) &&
+			(i == num_keys || !(keys[i].mTime < time)))
+		{
+			cursor = i;
+			return i;
+		}
+	}
+
+	cursor = (S32)(std::lower_bound(keys.begin(), keys.end(), time, key_time_less<KEY>()) - keys.begin());
+	return cursor;
+}
+
+// Returns the index of the key that gives the value at time.  If
+// interpolate is set the value lies between that key and the next one,
+// a fraction u of the way along.  keys must not be empty.
+template <class KEY>
+static S32 seek_key(const std::vector<KEY>& keys, F32 time, S32& cursor, bool& interpolate, F32& u)
+{
+	S32 right = find_key(keys, time, cursor);
+	interpolate = false;
+
+	if (right == (S32)keys.size())
+	{
+		// Past last key
+		return right - 1;
+	}
+	if (right == 0 || keys[right].mTime == time)
+	{
+		// Before first key or exactly on a key
+		return right;
+	}
+
+	// Between two keys
+	F32 index_before = keys[right - 1].mTime;
+	F32 index_after = keys[right].mTime;
+	u = (time - index_before) / (index_after - index_before);
+	interpolate = true;
+	return right - 1;
+}
+
 //-----------------------------------------------------------------------------
 // ScaleCurve::ScaleCurve()
 //-----------------------------------------------------------------------------
@@ -156,6 +243,12 @@ LLKeyframeMotion::ScaleCurve::~ScaleCurve()
 // getValue()
 //-----------------------------------------------------------------------------
 LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
+{
+	S32 cursor = 0;
+	return getValue(time, duration, cursor);
+}
+
+LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration, S32& cursor)
 {
 	LLVector3 value;
 
@@ -164,35 +257,17 @@ LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
 		value.clearVec();
 		return value;
 	}
-	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
-	{
-		// Past last key
-		--right;
-		value = right->second.mScale;
-	}
-	else if (right == mKeys.begin() || right->first == time)
+
+	bool interpolate;
+	F32 u;
+	S32 key = seek_key(mKeys, time, cursor, interpolate, u);
+	if (interpolate)
 	{
-		// Before first key or exactly on a key
-		value = right->second.mScale;
+		value = interp(u, mKeys[key], mKeys[key + 1]);
 	}
 	else
 	{
-		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		ScaleKey& scale_before = left->second;
-		ScaleKey& scale_after = right->second;
-		if (right == mKeys.end())
-		{
-			scale_after = mLoopInKey;
-			index_after = duration;
-		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, scale_before, scale_after);
+		value = mKeys[key].mScale;
 	}
 	return value;
 }
@@ -214,6 +289,15 @@ LLVector3 LLKeyframeMotion::ScaleCurve::interp(F32 u, ScaleKey& before, ScaleKey
 	}
 }
 
+//-----------------------------------------------------------------------------
+// sortKeys()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::ScaleCurve::sortKeys()
+{
+	sort_keys(mKeys);
+	mNumKeys = (S32)mKeys.size();
+}
+
 //-----------------------------------------------------------------------------
 // RotationCurve::RotationCurve()
 //-----------------------------------------------------------------------------
@@ -236,6 +320,12 @@ LLKeyframeMotion::RotationCurve::~RotationCurve()
 // RotationCurve::getValue()
 //-----------------------------------------------------------------------------
 LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
+{
+	S32 cursor = 0;
+	return getValue(time, duration, cursor);
+}
+
+LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration, S32& cursor)
 {
 	LLQuaternion value;
 
@@ -244,35 +334,17 @@ LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
 		value = LLQuaternion::DEFAULT;
 		return value;
 	}
-	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
-	{
-		// Past last key
-		--right;
-		value = right->second.mRotation;
-	}
-	else if (right == mKeys.begin() || right->first == time)
+
+	bool interpolate;
+	F32 u;
+	S32 key = seek_key(mKeys, time, cursor, interpolate, u);
+	if (interpolate)
 	{
-		// Before first key or exactly on a key
-		value = right->second.mRotation;
+		value = interp(u, mKeys[key], mKeys[key + 1]);
 	}
 	else
 	{
-		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		RotationKey& rot_before = left->second;
-		RotationKey& rot_after = right->second;
-		if (right == mKeys.end())
-		{
-			rot_after = mLoopInKey;
-			index_after = duration;
-		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, rot_before, rot_after);
+		value = mKeys[key].mRotation;
 	}
 	return value;
 }
@@ -294,6 +366,15 @@ LLQuaternion LLKeyframeMotion::RotationCurve::interp(F32 u, RotationKey& before,
 	}
 }
 
+//-----------------------------------------------------------------------------
+// sortKeys()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::RotationCurve::sortKeys()
+{
+	sort_keys(mKeys);
+	mNumKeys = (S32)mKeys.size();
+}
+
 
 //-----------------------------------------------------------------------------
 // PositionCurve::PositionCurve()
@@ -317,6 +398,12 @@ LLKeyframeMotion::PositionCurve::~PositionCurve()
 // PositionCurve::getValue()
 //-----------------------------------------------------------------------------
 LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
+{
+	S32 cursor = 0;
+	return getValue(time, duration, cursor);
+}
+
+LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration, S32& cursor)
 {
 	LLVector3 value;
 
@@ -325,35 +412,17 @@ LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
 		value.clearVec();
 		return value;
 	}
-	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
-	{
-		// Past last key
-		--right;
-		value = right->second.mPosition;
-	}
-	else if (right == mKeys.begin() || right->first == time)
+
+	bool interpolate;
+	F32 u;
+	S32 key = seek_key(mKeys, time, cursor, interpolate, u);
+	if (interpolate)
 	{
-		// Before first key or exactly on a key
-		value = right->second.mPosition;
+		value = interp(u, mKeys[key], mKeys[key + 1]);
 	}
 	else
 	{
-		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		PositionKey& pos_before = left->second;
-		PositionKey& pos_after = right->second;
-		if (right == mKeys.end())
-		{
-			pos_after = mLoopInKey;
-			index_after = duration;
-		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, pos_before, pos_after);
+		value = mKeys[key].mPosition;
 	}
 
 	llassert(value.isFinite());
@@ -377,6 +446,169 @@ LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, Po
 	}
 }
 
+//-----------------------------------------------------------------------------
+// sortKeys()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::PositionCurve::sortKeys()
+{
+	sort_keys(mKeys);
+	mNumKeys = (S32)mKeys.size();
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// KeyframeBatch class
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+class LLKeyframeMotion::KeyframeBatch
+{
+public:
+	KeyframeBatch() : mNumRotations(0), mNumVectors(0) {}
+
+	void addRotation(LLJointState* joint_state, const LLQuaternion& before, const LLQuaternion& after, F32 u)
+	{
+		if (mNumRotations == BATCH_SIZE)
+		{
+			flushRotations();
+		}
+		S32 i = mNumRotations++;
+		mRotationStates[i] = joint_state;
+		memcpy(mRotationBefore + i * 4, before.mQ, sizeof(before.mQ));	/* Flawfinder: ignore */
+		memcpy(mRotationAfter + i * 4, after.mQ, sizeof(after.mQ));		/* Flawfinder: ignore */
+		mRotationU[i] = u;
+	}
+
+	// usage is LLJointState::POS or LLJointState::SCALE
+	void addVector(LLJointState* joint_state, U32 usage, const LLVector3& before, const LLVector3& after, F32 u)
+	{
+		if (mNumVectors == BATCH_SIZE)
+		{
+			flushVectors();
+		}
+		S32 i = mNumVectors++;
+		mVectorStates[i] = joint_state;
+		mVectorUsage[i] = usage;
+		memcpy(mVectorBefore + i * 3, before.mV, sizeof(before.mV));	/* Flawfinder: ignore */
+		memcpy(mVectorAfter + i * 3, after.mV, sizeof(after.mV));		/* Flawfinder: ignore */
+		mVectorU[i] = u;
+	}
+
+	void flush()
+	{
+		flushRotations();
+		flushVectors();
+	}
+
+private:
+	void flushRotations()
+	{
+		if (LLKeyframeMotion::getVectorize())
+		{
+			LLKeyframeMotion::interpRotationsSSE2(mRotationBefore, mRotationAfter, mRotationU, mRotationResult, mNumRotations);
+		}
+		else
+		{
+			LLKeyframeMotion::interpRotations(mRotationBefore, mRotationAfter, mRotationU, mRotationResult, mNumRotations);
+		}
+
+		LLQuaternion rotation;
+		for (S32 i = 0; i < mNumRotations; i++)
+		{
+			memcpy(rotation.mQ, mRotationResult + i * 4, sizeof(rotation.mQ));	/* Flawfinder: ignore */
+			mRotationStates[i]->setRotation(rotation);
+		}
+		mNumRotations = 0;
+	}
+
+	void flushVectors()
+	{
+		if (LLKeyframeMotion::getVectorize())
+		{
+			LLKeyframeMotion::interpVectorsSSE2(mVectorBefore, mVectorAfter, mVectorU, mVectorResult, mNumVectors);
+		}
+		else
+		{
+			LLKeyframeMotion::interpVectors(mVectorBefore, mVectorAfter, mVectorU, mVectorResult, mNumVectors);
+		}
+
+		LLVector3 vec;
+		for (S32 i = 0; i < mNumVectors; i++)
+		{
+			memcpy(vec.mV, mVectorResult + i * 3, sizeof(vec.mV));	/* Flawfinder: ignore */
+			if (mVectorUsage[i] == LLJointState::POS)
+			{
+				llassert(vec.isFinite());
+				mVectorStates[i]->setPosition(vec);
+			}
+			else
+			{
+				mVectorStates[i]->setScale(vec);
+			}
+		}
+		mNumVectors = 0;
+	}
+
+	enum { BATCH_SIZE = 32 };
+
+	S32				mNumRotations;
+	LLJointState*	mRotationStates[BATCH_SIZE];
+	F32				mRotationBefore[BATCH_SIZE * 4];
+	F32				mRotationAfter[BATCH_SIZE * 4];
+	F32				mRotationU[BATCH_SIZE];
+	F32				mRotationResult[BATCH_SIZE * 4];
+
+	S32				mNumVectors;
+	LLJointState*	mVectorStates[BATCH_SIZE];
+	U32				mVectorUsage[BATCH_SIZE];
+	F32				mVectorBefore[BATCH_SIZE * 3];
+	F32				mVectorAfter[BATCH_SIZE * 3];
+	F32				mVectorU[BATCH_SIZE];
+	F32				mVectorResult[BATCH_SIZE * 3];
+};
+
+//-----------------------------------------------------------------------------
+// interpRotations()
+//-----------------------------------------------------------------------------
+//static
+void LLKeyframeMotion::interpRotations(const F32* before, const F32* after, const F32* u, F32* result, S32 count)
+{
+	// Copied in rather than set(), which would normalize the keys
+	LLQuaternion a, b, r;
+	for (S32 i = 0; i < count; i++)
+	{
+		memcpy(a.mQ, before + i * 4, sizeof(a.mQ));	/* Flawfinder: ignore */
+		memcpy(b.mQ, after + i * 4, sizeof(b.mQ));	/* Flawfinder: ignore */
+		r = nlerp(u[i], a, b);
+		memcpy(result + i * 4, r.mQ, sizeof(r.mQ));	/* Flawfinder: ignore */
+	}
+}
+
+//-----------------------------------------------------------------------------
+// interpVectors()
+//-----------------------------------------------------------------------------
+//static
+void LLKeyframeMotion::interpVectors(const F32* before, const F32* after, const F32* u, F32* result, S32 count)
+{
+	for (S32 i = 0; i < count; i++)
+	{
+		for (S32 j = 0; j < 3; j++)
+		{
+			F32 a = before[i * 3 + j];
+			result[i * 3 + j] = a + (after[i * 3 + j] - a) * u[i];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// setVectorize()
+//-----------------------------------------------------------------------------
+//static
+void LLKeyframeMotion::setVectorize(bool vectorize)
+{
+	sVectorize = vectorize && hasSSE2Kernels() && gSysCPU.hasSSE2();
+}
+
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
@@ -387,7 +619,7 @@ LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, Po
 //-----------------------------------------------------------------------------
 // JointMotion::update()
 //-----------------------------------------------------------------------------
-void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration)
+void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration, S32* cursors, KeyframeBatch& batch)
 {
 	// this value being 0 is the cause of https://jira.lindenlab.com/browse/SL-22678 but I haven't 
 	// managed to get a stack to see how it got here. Testing for 0 here will stop the crash.
@@ -397,13 +629,24 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	}
 
 	U32 usage = joint_state->getUsage();
+	bool interpolate;
+	F32 u;
+	S32 key;
 
 	//-------------------------------------------------------------------------
 	// update scale component of joint state
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::SCALE) && mScaleCurve.mNumKeys)
 	{
-		joint_state->setScale( mScaleCurve.getValue( time, duration ) );
+		key = seek_key(mScaleCurve.mKeys, time, cursors[0], interpolate, u);
+		if (interpolate && mScaleCurve.mInterpolationType != IT_STEP)
+		{
+			batch.addVector(joint_state, LLJointState::SCALE, mScaleCurve.mKeys[key].mScale, mScaleCurve.mKeys[key + 1].mScale, u);
+		}
+		else
+		{
+			joint_state->setScale( mScaleCurve.mKeys[key].mScale );
+		}
 	}
 
 	//-------------------------------------------------------------------------
@@ -411,7 +654,15 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::ROT) && mRotationCurve.mNumKeys)
 	{
-		joint_state->setRotation( mRotationCurve.getValue( time, duration ) );
+		key = seek_key(mRotationCurve.mKeys, time, cursors[1], interpolate, u);
+		if (interpolate && mRotationCurve.mInterpolationType != IT_STEP)
+		{
+			batch.addRotation(joint_state, mRotationCurve.mKeys[key].mRotation, mRotationCurve.mKeys[key + 1].mRotation, u);
+		}
+		else
+		{
+			joint_state->setRotation( mRotationCurve.mKeys[key].mRotation );
+		}
 	}
 
 	//-------------------------------------------------------------------------
@@ -419,11 +670,18 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::POS) && mPositionCurve.mNumKeys)
 	{
-		joint_state->setPosition( mPositionCurve.getValue( time, duration ) );
+		key = seek_key(mPositionCurve.mKeys, time, cursors[2], interpolate, u);
+		if (interpolate && mPositionCurve.mInterpolationType != IT_STEP)
+		{
+			batch.addVector(joint_state, LLJointState::POS, mPositionCurve.mKeys[key].mPosition, mPositionCurve.mKeys[key + 1].mPosition, u);
+		}
+		else
+		{
+			joint_state->setPosition( mPositionCurve.mKeys[key].mPosition );
+		}
 	}
 }
 
-
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // LLKeyframeMotion class
@@ -727,13 +985,23 @@ BOOL LLKeyframeMotion::onUpdate(F32 time, U8* joint_mask)
 //-----------------------------------------------------------------------------
 void LLKeyframeMotion::applyKeyframes(F32 time)
 {
-	llassert_always (mJointMotionList->getNumJointMotions() <= mJointStates.size());
-	for (U32 i=0; i<mJointMotionList->getNumJointMotions(); i++)
+	U32 num_joint_motions = mJointMotionList->getNumJointMotions();
+	llassert_always (num_joint_motions <= mJointStates.size());
+	if (mKeyCursors.size() != num_joint_motions * 3)
+	{
+		mKeyCursors.assign(num_joint_motions * 3, 0);
+	}
+
+	KeyframeBatch batch;
+	for (U32 i=0; i<num_joint_motions; i++)
 	{
 		mJointMotionList->getJointMotion(i)->update(mJointStates[i],
 													  time, 
-													  mJointMotionList->mDuration );
+													  mJointMotionList->mDuration,
+													  &mKeyCursors[i * 3],
+													  batch);
 	}
+	batch.flush();
 
 	LLJoint::JointPriority* pose_priority = (LLJoint::JointPriority* )mCharacter->getAnimationData("Hand Pose Priority");
 	if (pose_priority)
@@ -1481,8 +1749,9 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 				return FALSE;
 			}
 
-			rCurve->mKeys[time] = rot_key;
+			rCurve->mKeys.push_back(rot_key);
 		}
+		rCurve->sortKeys();
 
 		//---------------------------------------------------------------------
 		// scan position curve header
@@ -1559,13 +1828,14 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 				return FALSE;
 			}
 			
-			pCurve->mKeys[pos_key.mTime] = pos_key;
+			pCurve->mKeys.push_back(pos_key);
 
 			if (is_pelvis)
 			{
 				mJointMotionList->mPelvisBBox.addPoint(pos_key.mPosition);
 			}
 		}
+		pCurve->sortKeys();
 
 		joint_motion->mUsage = joint_state->getUsage();
 	}
@@ -1810,10 +2080,10 @@ BOOL LLKeyframeMotion::serialize(LLDataPacker& dp) const
 		success &= dp.packS32(joint_motionp->mPriority, "joint_priority");
 		success &= dp.packS32(joint_motionp->mRotationCurve.mNumKeys, "num_rot_keys");
 
-		for (RotationCurve::key_map_t::iterator iter = joint_motionp->mRotationCurve.mKeys.begin();
+		for (RotationCurve::key_list_t::iterator iter = joint_motionp->mRotationCurve.mKeys.begin();
 			 iter != joint_motionp->mRotationCurve.mKeys.end(); ++iter)
 		{
-			RotationKey& rot_key = iter->second;
+			RotationKey& rot_key = *iter;
 			U16 time_short = F32_to_U16(rot_key.mTime, 0.f, mJointMotionList->mDuration);
 			success &= dp.packU16(time_short, "time");
 
@@ -1830,10 +2100,10 @@ BOOL LLKeyframeMotion::serialize(LLDataPacker& dp) const
 		}
 
 		success &= dp.packS32(joint_motionp->mPositionCurve.mNumKeys, "num_pos_keys");
-		for (PositionCurve::key_map_t::iterator iter = joint_motionp->mPositionCurve.mKeys.begin();
+		for (PositionCurve::key_list_t::iterator iter = joint_motionp->mPositionCurve.mKeys.begin();
 			 iter != joint_motionp->mPositionCurve.mKeys.end(); ++iter)
 		{
-			PositionKey& pos_key = iter->second;
+			PositionKey& pos_key = *iter;
 			U16 time_short = F32_to_U16(pos_key.mTime, 0.f, mJointMotionList->mDuration);
 			success &= dp.packU16(time_short, "time");
 
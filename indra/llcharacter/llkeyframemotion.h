@@ -39,6 +39,7 @@
 //-----------------------------------------------------------------------------
 
 #include <string>
+#include <vector>
 
 #include "llassetstorage.h"
 #include "llbboxlocal.h"
@@ -199,6 +200,21 @@ public:
 
 	static void flushKeyframeCache();
 
+	// Batched interpolation of count joint channels.  Rotations are four
+	// floats each, as in LLQuaternion::mQ, and are blended like nlerp();
+	// vectors are three and blended like lerp().  The SSE2 versions are in
+	// llkeyframemotion_sse2.cpp and are bit-exact with these on builds that
+	// do scalar float math with SSE.
+	static void interpRotations(const F32* before, const F32* after, const F32* u, F32* result, S32 count);
+	static void interpVectors(const F32* before, const F32* after, const F32* u, F32* result, S32 count);
+	static void interpRotationsSSE2(const F32* before, const F32* after, const F32* u, F32* result, S32 count);
+	static void interpVectorsSSE2(const F32* before, const F32* after, const F32* u, F32* result, S32 count);
+	static bool hasSSE2Kernels();
+
+	// Use the SSE2 kernels.  No effect if the CPU or the build lacks SSE2.
+	static void setVectorize(bool vectorize);
+	static bool getVectorize()						{ return sVectorize; }
+
 protected:
 	//-------------------------------------------------------------------------
 	// JointConstraintSharedData
@@ -318,6 +334,13 @@ public:
 		LLVector3	mPosition;
 	};
 
+	// The curves keep their keys in arrays sorted by time, built by
+	// sortKeys() when an animation is loaded.  The getValue() that takes a
+	// cursor starts looking from the key it found last time, so playing
+	// forward costs O(1) per frame.  Curves are shared between motions
+	// through LLKeyframeDataCache, so each LLKeyframeMotion keeps its own
+	// cursors.
+
 	//-------------------------------------------------------------------------
 	// ScaleCurve
 	//-------------------------------------------------------------------------
@@ -327,12 +350,14 @@ public:
 		ScaleCurve();
 		~ScaleCurve();
 		LLVector3 getValue(F32 time, F32 duration);
+		LLVector3 getValue(F32 time, F32 duration, S32& cursor);
 		LLVector3 interp(F32 u, ScaleKey& before, ScaleKey& after);
+		void sortKeys();
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, ScaleKey> key_map_t;
-		key_map_t 			mKeys;
+		typedef std::vector<ScaleKey> key_list_t;
+		key_list_t			mKeys;		// sorted by time
 		ScaleKey			mLoopInKey;
 		ScaleKey			mLoopOutKey;
 	};
@@ -346,12 +371,14 @@ public:
 		RotationCurve();
 		~RotationCurve();
 		LLQuaternion getValue(F32 time, F32 duration);
+		LLQuaternion getValue(F32 time, F32 duration, S32& cursor);
 		LLQuaternion interp(F32 u, RotationKey& before, RotationKey& after);
+		void sortKeys();
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, RotationKey> key_map_t;
-		key_map_t		mKeys;
+		typedef std::vector<RotationKey> key_list_t;
+		key_list_t		mKeys;		// sorted by time
 		RotationKey		mLoopInKey;
 		RotationKey		mLoopOutKey;
 	};
@@ -365,16 +392,23 @@ public:
 		PositionCurve();
 		~PositionCurve();
 		LLVector3 getValue(F32 time, F32 duration);
+		LLVector3 getValue(F32 time, F32 duration, S32& cursor);
 		LLVector3 interp(F32 u, PositionKey& before, PositionKey& after);
+		void sortKeys();
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, PositionKey> key_map_t;
-		key_map_t		mKeys;
+		typedef std::vector<PositionKey> key_list_t;
+		key_list_t		mKeys;		// sorted by time
 		PositionKey		mLoopInKey;
 		PositionKey		mLoopOutKey;
 	};
 
+	// Collects the joint channels that need interpolating during
+	// applyKeyframes() and runs them through interpRotations() and
+	// interpVectors() or their SSE2 versions.
+	class KeyframeBatch;
+
 	//-------------------------------------------------------------------------
 	// JointMotion
 	//-------------------------------------------------------------------------
@@ -388,7 +422,8 @@ public:
 		U32				mUsage;
 		LLJoint::JointPriority	mPriority;
 
-		void update(LLJointState* joint_state, F32 time, F32 duration);
+		// cursors holds this motion's scale, rotation and position cursors.
+		void update(LLJointState* joint_state, F32 time, F32 duration, S32* cursors, KeyframeBatch& batch);
 	};
 	
 	//-------------------------------------------------------------------------
@@ -425,12 +460,14 @@ public:
 
 protected:
 	static LLVFS*				sVFS;
+	static bool					sVectorize;
 
 	//-------------------------------------------------------------------------
 	// Member Data
 	//-------------------------------------------------------------------------
 	JointMotionList*				mJointMotionList;
 	std::vector<LLPointer<LLJointState> > mJointStates;
+	std::vector<S32>				mKeyCursors;	// three per joint motion
 	LLJoint*						mPelvisp;
 	LLCharacter*					mCharacter;
 	typedef std::list<JointConstraint*>	constraint_list_t;
@@ -0,0 +1,192 @@
+/** 
+ * @file llkeyframemotion_sse2.cpp
+ * @brief SSE2 keyframe interpolation kernels.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+#include "linden_common.h"
+
+#include "llkeyframemotion.h"
+
+#include "llmath.h"
+#include "llquaternion.h"
+
+#if (LL_GNUC && defined(__SSE2__)) || (LL_MSVC && (defined(_M_IX86) || defined(_M_X64)))
+#define LL_KEYFRAME_SSE2 1
+#else
+#define LL_KEYFRAME_SSE2 0
+#endif
+
+#if LL_KEYFRAME_SSE2
+
+#include <emmintrin.h>
+
+// Four channels at a time, each lane doing the same operations in the
+// same order as the scalar kernels in llkeyframemotion.cpp.  Rotations are
+// transposed so that each register holds one component of four keys.
+
+//static
+bool LLKeyframeMotion::hasSSE2Kernels()
+{
+	return true;
+}
+
+//static
+void LLKeyframeMotion::interpRotationsSSE2(const F32* before, const F32* after, const F32* u, F32* result, S32 count)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 mag_threshold = _mm_set1_ps(FP_MAG_THRESHOLD);
+	const __m128 unity_threshold = _mm_set1_ps(ONE_PART_IN_A_MILLION);
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	S32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 ax = _mm_loadu_ps(before + i * 4);
+		__m128 ay = _mm_loadu_ps(before + i * 4 + 4);
+		__m128 az = _mm_loadu_ps(before + i * 4 + 8);
+		__m128 aw = _mm_loadu_ps(before + i * 4 + 12);
+		_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+		__m128 bx = _mm_loadu_ps(after + i * 4);
+		__m128 by = _mm_loadu_ps(after + i * 4 + 4);
+		__m128 bz = _mm_loadu_ps(after + i * 4 + 8);
+		__m128 bw = _mm_loadu_ps(after + i * 4 + 12);
+		_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+		// nlerp() hands keys in opposite hemispheres to slerp()
+		__m128 cos_t = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+											 _mm_mul_ps(az, bz)),
+								  _mm_mul_ps(aw, bw));
+		S32 slerp_lanes = _mm_movemask_ps(_mm_cmplt_ps(cos_t, zero));
+
+		// lerp()
+		__m128 t = _mm_loadu_ps(u + i);
+		__m128 inv_t = _mm_sub_ps(one, t);
+		__m128 rx = _mm_add_ps(_mm_mul_ps(t, bx), _mm_mul_ps(inv_t, ax));
+		__m128 ry = _mm_add_ps(_mm_mul_ps(t, by), _mm_mul_ps(inv_t, ay));
+		__m128 rz = _mm_add_ps(_mm_mul_ps(t, bz), _mm_mul_ps(inv_t, az));
+		__m128 rw = _mm_add_ps(_mm_mul_ps(t, bw), _mm_mul_ps(inv_t, aw));
+
+		// LLQuaternion::normalize(): rescale only if the length is off by
+		// more than one part in a million, identity if it is near zero
+		__m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)),
+													   _mm_mul_ps(rz, rz)),
+											_mm_mul_ps(rw, rw)));
+		__m128 valid = _mm_cmpgt_ps(mag, mag_threshold);
+		__m128 rescale = _mm_and_ps(valid,
+									_mm_cmpgt_ps(_mm_and_ps(_mm_sub_ps(one, mag), abs_mask), unity_threshold));
+		__m128 oomag = _mm_div_ps(one, mag);
+		rx = _mm_or_ps(_mm_and_ps(rescale, _mm_mul_ps(rx, oomag)), _mm_andnot_ps(rescale, rx));
+		ry = _mm_or_ps(_mm_and_ps(rescale, _mm_mul_ps(ry, oomag)), _mm_andnot_ps(rescale, ry));
+		rz = _mm_or_ps(_mm_and_ps(rescale, _mm_mul_ps(rz, oomag)), _mm_andnot_ps(rescale, rz));
+		rw = _mm_or_ps(_mm_and_ps(rescale, _mm_mul_ps(rw, oomag)), _mm_andnot_ps(rescale, rw));
+		rx = _mm_and_ps(valid, rx);
+		ry = _mm_and_ps(valid, ry);
+		rz = _mm_and_ps(valid, rz);
+		rw = _mm_or_ps(_mm_and_ps(valid, rw), _mm_andnot_ps(valid, one));
+
+		_MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+		_mm_storeu_ps(result + i * 4, rx);
+		_mm_storeu_ps(result + i * 4 + 4, ry);
+		_mm_storeu_ps(result + i * 4 + 8, rz);
+		_mm_storeu_ps(result + i * 4 + 12, rw);
+
+		if (slerp_lanes)
+		{
+			for (S32 lane = 0; lane < 4; lane++)
+			{
+				if (slerp_lanes & (1 << lane))
+				{
+					S32 j = i + lane;
+					interpRotations(before + j * 4, after + j * 4, u + j, result + j * 4, 1);
+				}
+			}
+		}
+	}
+
+	interpRotations(before + i * 4, after + i * 4, u + i, result + i * 4, count - i);
+}
+
+//static
+void LLKeyframeMotion::interpVectorsSSE2(const F32* before, const F32* after, const F32* u, F32* result, S32 count)
+{
+	S32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		// Twelve floats, with each u repeated for its three components
+		__m128 t = _mm_loadu_ps(u + i);
+		__m128 t0 = _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 0, 0, 0));
+		__m128 t1 = _mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 1, 1));
+		__m128 t2 = _mm_shuffle_ps(t, t, _MM_SHUFFLE(3, 3, 3, 2));
+
+		__m128 a0 = _mm_loadu_ps(before + i * 3);
+		__m128 a1 = _mm_loadu_ps(before + i * 3 + 4);
+		__m128 a2 = _mm_loadu_ps(before + i * 3 + 8);
+		__m128 b0 = _mm_loadu_ps(after + i * 3);
+		__m128 b1 = _mm_loadu_ps(after + i * 3 + 4);
+		__m128 b2 = _mm_loadu_ps(after + i * 3 + 8);
+
+		_mm_storeu_ps(result + i * 3, _mm_add_ps(a0, _mm_mul_ps(_mm_sub_ps(b0, a0), t0)));
+		_mm_storeu_ps(result + i * 3 + 4, _mm_add_ps(a1, _mm_mul_ps(_mm_sub_ps(b1, a1), t1)));
+		_mm_storeu_ps(result + i * 3 + 8, _mm_add_ps(a2, _mm_mul_ps(_mm_sub_ps(b2, a2), t2)));
+	}
+
+	interpVectors(before + i * 3, after + i * 3, u + i, result + i * 3, count - i);
+}
+
+#else // LL_KEYFRAME_SSE2
+
+// Never called: LLKeyframeMotion::setVectorize() checks hasSSE2Kernels()
+
+//static
+bool LLKeyframeMotion::hasSSE2Kernels()
+{
+	return false;
+}
+
+//static
+void LLKeyframeMotion::interpRotationsSSE2(const F32* before, const F32* after, const F32* u, F32* result, S32 count)
+{
+	llerrs << "SSE2 kernels not built" << llendl;
+}
+
+//static
+void LLKeyframeMotion::interpVectorsSSE2(const F32* before, const F32* after, const F32* u, F32* result, S32 count)
+{
+	llerrs << "SSE2 kernels not built" << llendl;
+}
+
+#endif // LL_KEYFRAME_SSE2
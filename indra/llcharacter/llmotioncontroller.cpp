@@ -144,7 +144,10 @@ LLMotionController::LLMotionController()
 	  mPauseTime(0.f),
 	  mTimeStep(0.f),
 	  mTimeStepCount(0),
-	  mLastInterp(0.f)
+	  mLastInterp(0.f),
+	  mPendingUpdate(UPDATE_NONE),
+	  mPendingInterp(0.f),
+	  mForceUpdate(false)
 {
 }
 
@@ -175,6 +178,7 @@ void LLMotionController::deleteAllMotions()
 	mLoadingMotions.clear();
 	mLoadedMotions.clear();
 	mActiveMotions.clear();
+	mStopRequests.clear();
 
 	for_each(mAllMotions.begin(), mAllMotions.end(), DeletePairedPointer());
 	mAllMotions.clear();
@@ -516,7 +520,7 @@ void LLMotionController::updateIdleMotion(LLMotion* motionp)
 		// this will only be called when an animation stops itself (runs out of time)
 		if (mLastTime <= motionp->mSendStopTimestamp)
 		{
-			mCharacter->requestStopMotion( motionp );
+			requestStop( motionp );
 			stopMotionInstance(motionp, FALSE);
 		}
 	}
@@ -617,7 +621,7 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 				// this will only be called when an animation stops itself (runs out of time)
 				if (mLastTime <= motionp->mSendStopTimestamp)
 				{
-					mCharacter->requestStopMotion( motionp );
+					requestStop( motionp );
 					stopMotionInstance(motionp, FALSE);
 				}
 			}
@@ -698,7 +702,7 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 				// this will only be called when an animation stops itself (runs out of time)
 				if (mLastTime <= motionp->mSendStopTimestamp)
 				{
-					mCharacter->requestStopMotion( motionp );
+					requestStop( motionp );
 					stopMotionInstance(motionp, FALSE);
 				}
 			}
@@ -742,7 +746,7 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 				// animation has stopped itself due to internal logic
 				// propagate this to the network
 				// as not all viewers are guaranteed to have access to the same logic
-				mCharacter->requestStopMotion( motionp );
+				requestStop( motionp );
 				stopMotionInstance(motionp, FALSE);
 			}
 
@@ -804,6 +808,16 @@ void LLMotionController::updateLoadingMotions()
 // updateMotion()
 //-----------------------------------------------------------------------------
 void LLMotionController::updateMotions(bool force_update)
+{
+	beginUpdateMotions(force_update);
+	evaluateMotions();
+	endUpdateMotions();
+}
+
+//-----------------------------------------------------------------------------
+// beginUpdateMotions()
+//-----------------------------------------------------------------------------
+void LLMotionController::beginUpdateMotions(bool force_update)
 {
 	BOOL use_quantum = (mTimeStep != 0.f);
 
@@ -816,6 +830,9 @@ void LLMotionController::updateMotions(bool force_update)
 	// Always cap the number of loaded motions
 	purgeExcessMotions();
 	
+	mPendingUpdate = UPDATE_EVALUATE;
+	mForceUpdate = force_update;
+
 	// Update timing info for this time step.
 	if (!mPaused)
 	{
@@ -829,20 +846,17 @@ void LLMotionController::updateMotions(bool force_update)
 			if (quantum_count == mTimeStepCount)
 			{
 				// we're still in same time quantum as before, so just interpolate and exit
-				if (!mPaused)
-				{
-					F32 interp = time_interval / mTimeStep;
-					mPoseBlender.interpolate(interp - mLastInterp);
-					mLastInterp = interp;
-				}
+				F32 interp = time_interval / mTimeStep;
+				mPendingUpdate = UPDATE_INTERPOLATE;
+				mPendingInterp = interp - mLastInterp;
+				mLastInterp = interp;
 
 				updateLoadingMotions();
 				return;
 			}
 			
 			// is calculating a new keyframe pose, make sure the last one gets applied
-			mPoseBlender.interpolate(1.f);
-			clearBlenders();
+			mPendingUpdate = UPDATE_QUANTUM;
 
 			mTimeStepCount = quantum_count;
 			mAnimTime = (F32)quantum_count * mTimeStep;
@@ -854,11 +868,39 @@ void LLMotionController::updateMotions(bool force_update)
 		}
 	}
 
+	// loading only touches the poses of the motions it activates, not the
+	// blender, so it can run before the last quantum is applied
 	updateLoadingMotions();
+}
+
+//-----------------------------------------------------------------------------
+// evaluateMotions()
+//-----------------------------------------------------------------------------
+void LLMotionController::evaluateMotions()
+{
+	EPendingUpdate update = mPendingUpdate;
+	mPendingUpdate = UPDATE_NONE;
+
+	if (update == UPDATE_NONE)
+	{
+		return;
+	}
+	if (update == UPDATE_INTERPOLATE)
+	{
+		mPoseBlender.interpolate(mPendingInterp);
+		return;
+	}
+	if (update == UPDATE_QUANTUM)
+	{
+		mPoseBlender.interpolate(1.f);
+		clearBlenders();
+	}
+
+	BOOL use_quantum = (mTimeStep != 0.f);
 
 	resetJointSignatures();
 
-	if (mPaused && !force_update)
+	if (mPaused && !mForceUpdate)
 	{
 		updateIdleActiveMotions();
 	}
@@ -885,6 +927,31 @@ void LLMotionController::updateMotions(bool force_update)
 //	llinfos << "Motion controller time " << motionTimer.getElapsedTimeF32() << llendl;
 }
 
+//-----------------------------------------------------------------------------
+// endUpdateMotions()
+//-----------------------------------------------------------------------------
+void LLMotionController::endUpdateMotions()
+{
+	// A motion that asked to stop is stopped, not deactivated, so it is
+	// still around.
+	for (std::vector<LLMotion*>::iterator iter = mStopRequests.begin();
+		 iter != mStopRequests.end(); ++iter)
+	{
+		mCharacter->requestStopMotion(*iter);
+	}
+	mStopRequests.clear();
+}
+
+//-----------------------------------------------------------------------------
+// requestStop()
+// Holds a stop request for endUpdateMotions(), which might be on another
+// thread.
+//-----------------------------------------------------------------------------
+void LLMotionController::requestStop(LLMotion* motion)
+{
+	mStopRequests.push_back(motion);
+}
+
 //-----------------------------------------------------------------------------
 // updateMotionsMinimal()
 // minimal update (e.g. while hidden)
@@ -893,6 +960,7 @@ void LLMotionController::updateMotionsMinimal()
 {
 	// Always update mPrevTimerElapsed
 	mPrevTimerElapsed = mTimer.getElapsedTimeF32();
+	mPendingUpdate = UPDATE_NONE;
 
 	purgeExcessMotions();
 	updateLoadingMotions();
@@ -40,6 +40,7 @@
 #include <string>
 #include <map>
 #include <deque>
+#include <vector>
 
 #include "lluuidhashmap.h"
 #include "llmotion.h"
@@ -139,6 +140,18 @@ public:
 	// deactivates terminated motions`
 	void updateMotions(bool force_update = false);
 
+	// updateMotions() in three steps, so that many characters can be
+	// animated in parallel.
+	// MAIN THREAD.  Advances the animation clock, purges motions and
+	// finishes loading them.
+	void beginUpdateMotions(bool force_update = false);
+	// Any thread, one at a time per controller.  Runs the active motions
+	// and blends their poses into the joints.  Stops the motions ask for
+	// are held for endUpdateMotions().
+	void evaluateMotions();
+	// MAIN THREAD.  Passes the stops on to the character.
+	void endUpdateMotions();
+
 	// minimal update (e.g. while hidden)
 	void updateMotionsMinimal();
 
@@ -187,6 +200,7 @@ protected:
 	void updateIdleActiveMotions();
 	void purgeExcessMotions();
 	void deactivateStoppedMotions();
+	void requestStop(LLMotion* motion);
 
 protected:
 	F32					mTimeFactor;
@@ -222,6 +236,13 @@ protected:
 	S32					mTimeStepCount;
 	F32					mLastInterp;
 
+	// what evaluateMotions() has left to do
+	enum EPendingUpdate { UPDATE_NONE, UPDATE_INTERPOLATE, UPDATE_QUANTUM, UPDATE_EVALUATE };
+	EPendingUpdate		mPendingUpdate;
+	F32					mPendingInterp;
+	bool				mForceUpdate;
+	std::vector<LLMotion*> mStopRequests;
+
 	U8					mJointSignature[2][LL_CHARACTER_MAX_JOINTS];
 };
 
@@ -0,0 +1,1035 @@
+/** 
+ * @file llkeyframemotion_test.cpp
+ * @brief LLKeyframeMotion tests: curve lookup, batched interpolation and playback timing.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include <map>
+
+#include "linden_common.h"
+
+#include "../llkeyframemotion.h"
+
+#include "llcharacter.h"
+#include "llcriticaldamp.h"
+#include "lldatapacker.h"
+#include "llformat.h"
+#include "llframetimer.h"
+#include "llhandmotion.h"
+#include "llheadrotmotion.h"
+#include "llquantize.h"
+#include "llstl.h"
+#include "lltaskscheduler.h"
+#include "llthread.h"
+#include "lltimer.h"
+#include "llvisualparam.h"
+
+#include "../test/lltut.h"
+
+extern const char *gHandPoseNames[LLHandMotion::NUM_HAND_POSES];
+
+namespace
+{
+	// Roughly the avatar skeleton
+	const char* JOINT_NAMES[] =
+	{
+		"mPelvis", "mTorso", "mChest", "mNeck", "mHead", "mSkull",
+		"mEyeLeft", "mEyeRight",
+		"mCollarLeft", "mShoulderLeft", "mElbowLeft", "mWristLeft",
+		"mCollarRight", "mShoulderRight", "mElbowRight", "mWristRight",
+		"mHipLeft", "mKneeLeft", "mAnkleLeft", "mFootLeft", "mToeLeft",
+		"mHipRight", "mKneeRight", "mAnkleRight", "mFootRight", "mToeRight"
+	};
+	const S32 NUM_JOINTS = sizeof(JOINT_NAMES) / sizeof(JOINT_NAMES[0]);
+
+	// Deterministic, so failures can be reproduced
+	class Random
+	{
+	public:
+		Random(U32 seed) : mState(seed * 2654435761u + 1) {}
+		U32 next()
+		{
+			mState = mState * 1664525u + 1013904223u;
+			return mState >> 8;
+		}
+		F32 frand(F32 lo, F32 hi)
+		{
+			return lo + (hi - lo) * (F32)(next() & 0xffff) / 65535.f;
+		}
+	private:
+		U32 mState;
+	};
+
+	bool same_bits(const F32* a, const F32* b, S32 count)
+	{
+		return memcmp(a, b, count * sizeof(F32)) == 0;
+	}
+
+	LLQuaternion random_rotation(Random& random)
+	{
+		LLQuaternion q;
+		q.unpackFromVector3(LLVector3(random.frand(-0.57f, 0.57f), random.frand(-0.57f, 0.57f), random.frand(-0.57f, 0.57f)));
+		return q;
+	}
+
+	// The curve lookup before keys were kept in arrays
+	template <class VALUE>
+	bool map_lookup(const std::map<F32, VALUE>& keys, F32 time, VALUE& before, VALUE& after, F32& u)
+	{
+		typename std::map<F32, VALUE>::const_iterator right = keys.lower_bound(time);
+		if (right == keys.end())
+		{
+			--right;
+			before = right->second;
+			return false;
+		}
+		if (right == keys.begin() || right->first == time)
+		{
+			before = right->second;
+			return false;
+		}
+		typename std::map<F32, VALUE>::const_iterator left = right;
+		--left;
+		before = left->second;
+		after = right->second;
+		u = (time - left->first) / (right->first - left->first);
+		return true;
+	}
+
+	LLQuaternion map_rotation(const std::map<F32, LLQuaternion>& keys, F32 time)
+	{
+		LLQuaternion before, after;
+		F32 u;
+		if (!map_lookup(keys, time, before, after, u))
+		{
+			return before;
+		}
+		return nlerp(u, before, after);
+	}
+
+	LLVector3 map_vector(const std::map<F32, LLVector3>& keys, F32 time)
+	{
+		LLVector3 before, after;
+		F32 u;
+		if (!map_lookup(keys, time, before, after, u))
+		{
+			return before;
+		}
+		return lerp(before, after, u);
+	}
+
+	// Writes an animation in the format LLKeyframeMotion::deserialize()
+	// reads.  Every joint has rotation keys at roughly 30 per second with
+	// the odd large swing, so that some neighbouring keys lie in opposite
+	// hemispheres; the pelvis also has position keys.
+	S32 build_anim(U32 seed, U8* buffer, S32 size)
+	{
+		Random random(seed);
+		LLDataPackerBinaryBuffer dp(buffer, size);
+		F32 duration = random.frand(2.f, 6.f);
+
+		dp.packU16(KEYFRAME_MOTION_VERSION, "version");
+		dp.packU16(KEYFRAME_MOTION_SUBVERSION, "sub_version");
+		dp.packS32(LLJoint::MEDIUM_PRIORITY, "base_priority");
+		dp.packF32(duration, "duration");
+		dp.packString(std::string(), "emote_name");
+		dp.packF32(0.f, "loop_in_point");
+		dp.packF32(duration, "loop_out_point");
+		dp.packS32(TRUE, "loop");
+		dp.packF32(0.3f, "ease_in_duration");
+		dp.packF32(0.3f, "ease_out_duration");
+		dp.packU32(LLHandMotion::HAND_POSE_RELAXED, "hand_pose");
+		dp.packU32(NUM_JOINTS, "num_joints");
+
+		for (S32 j = 0; j < NUM_JOINTS; j++)
+		{
+			dp.packString(JOINT_NAMES[j], "joint_name");
+			dp.packS32(LLJoint::USE_MOTION_PRIORITY, "joint_priority");
+
+			S32 num_keys = (S32)(duration * random.frand(10.f, 30.f)) + 2;
+			dp.packS32(num_keys, "num_rot_keys");
+			F32 phase = random.frand(0.f, F_TWO_PI);
+			F32 rate = random.frand(1.f, 4.f);
+			for (S32 k = 0; k < num_keys; k++)
+			{
+				F32 time = duration * k / (num_keys - 1);
+				dp.packU16(F32_to_U16(time, 0.f, duration), "time");
+				F32 angle = phase + rate * time;
+				F32 swing = (random.next() % 8) ? 0.3f : 0.55f;
+				F32 sign = (random.next() % 8) ? 1.f : -1.f;
+				dp.packU16(F32_to_U16(sign * swing * sinf(angle), -1.f, 1.f), "rot_angle_x");
+				dp.packU16(F32_to_U16(swing * cosf(angle), -1.f, 1.f), "rot_angle_y");
+				dp.packU16(F32_to_U16(0.2f * sinf(2.f * angle), -1.f, 1.f), "rot_angle_z");
+			}
+
+			num_keys = j ? 0 : (S32)(duration * 15.f) + 2;
+			dp.packS32(num_keys, "num_pos_keys");
+			for (S32 k = 0; k < num_keys; k++)
+			{
+				F32 time = duration * k / (num_keys - 1);
+				dp.packU16(F32_to_U16(time, 0.f, duration), "time");
+				dp.packU16(F32_to_U16(0.1f * sinf(time), -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET), "pos_x");
+				dp.packU16(F32_to_U16(0.f, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET), "pos_y");
+				dp.packU16(F32_to_U16(0.05f * cosf(3.f * time), -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET), "pos_z");
+			}
+		}
+		dp.packS32(0, "num_constraints");
+
+		return dp.getCurrentSize();
+	}
+
+	class TestCharacter : public LLCharacter
+	{
+	public:
+		TestCharacter()
+		{
+			mID.generate();
+			mRoot.setName("mRoot");
+			for (S32 j = 0; j < NUM_JOINTS; j++)
+			{
+				mJoints[j].setName(JOINT_NAMES[j]);
+				mRoot.addChild(&mJoints[j]);
+			}
+		}
+		~TestCharacter()
+		{
+			mRoot.removeAllChildren();
+		}
+
+		virtual const char* getAnimationPrefix()				{ return "test"; }
+		virtual LLJoint* getRootJoint()						{ return &mRoot; }
+		virtual LLVector3 getCharacterPosition()				{ return LLVector3::zero; }
+		virtual LLQuaternion getCharacterRotation()			{ return LLQuaternion::DEFAULT; }
+		virtual LLVector3 getCharacterVelocity()				{ return LLVector3::zero; }
+		virtual LLVector3 getCharacterAngularVelocity()		{ return LLVector3::zero; }
+		virtual void getGround(const LLVector3& inPos, LLVector3& outPos, LLVector3& outNorm)
+		{
+			outPos = inPos;
+			outNorm = LLVector3::z_axis;
+		}
+		virtual BOOL allocateCharacterJoints(U32 num)			{ return FALSE; }
+		virtual LLJoint* getCharacterJoint(U32 i)				{ return i < (U32)NUM_JOINTS ? &mJoints[i] : NULL; }
+		virtual F32 getTimeDilation()							{ return 1.f; }
+		virtual F32 getPixelArea() const						{ return 100000.f; }
+		virtual LLPolyMesh* getHeadMesh()						{ return NULL; }
+		virtual LLPolyMesh* getUpperBodyMesh()					{ return NULL; }
+		virtual LLVector3d getPosGlobalFromAgent(const LLVector3& position)	{ return LLVector3d(position); }
+		virtual LLVector3 getPosAgentFromGlobal(const LLVector3d& position)	{ return LLVector3(position); }
+		virtual void addDebugText(const std::string& text)		{}
+		virtual const LLUUID& getID()							{ return mID; }
+
+	private:
+		LLUUID mID;
+		LLJoint mRoot;
+		LLJoint mJoints[NUM_JOINTS];
+	};
+
+	class TestMotion : public LLKeyframeMotion
+	{
+	public:
+		TestMotion(const LLUUID& id) : LLKeyframeMotion(id) {}
+
+		// The first motion of an animation reads it, the others find it
+		// in the keyframe cache.
+		bool load(TestCharacter* character, U8* buffer, S32 size)
+		{
+			if (LLKeyframeDataCache::getKeyframeData(getID()))
+			{
+				return onInitialize(character) == STATUS_SUCCESS;
+			}
+			mCharacter = character;
+			LLDataPackerBinaryBuffer dp(buffer, size);
+			return deserialize(dp) != FALSE;
+		}
+
+		using LLKeyframeMotion::applyKeyframes;
+		using LLKeyframeMotion::mJointMotionList;
+		using LLKeyframeMotion::mJointStates;
+	};
+
+	// Runs the evaluation phase of a crowd update, as LLVOAvatar does
+	class EvaluateBody : public LLTaskScheduler::ParallelBody
+	{
+	public:
+		EvaluateBody(std::vector<TestCharacter*>& characters) : mCharacters(characters) {}
+		/*virtual*/ void run(S32 index)
+		{
+			mCharacters[index]->evaluateMotions();
+			mCharacters[index]->getRootJoint()->updateWorldMatrixChildren();
+		}
+	private:
+		std::vector<TestCharacter*>& mCharacters;
+	};
+
+	void make_crowd(std::vector<TestCharacter*>& characters, S32 count, const LLUUID* ids, S32 num_anims)
+	{
+		for (S32 c = 0; c < count; c++)
+		{
+			TestCharacter* character = new TestCharacter;
+			character->registerMotion(ids[c % num_anims], LLKeyframeMotion::create);
+			character->registerMotion(ids[(c + 3) % num_anims], LLKeyframeMotion::create);
+			character->startMotion(ids[c % num_anims]);
+			character->startMotion(ids[(c + 3) % num_anims], 0.5f);
+			if (c % 2)
+			{
+				// exercise the interpolated updates of far away avatars
+				character->getMotionController().setTimeStep(0.1f);
+			}
+			characters.push_back(character);
+		}
+	}
+
+	bool same_pose(TestCharacter* a, TestCharacter* b)
+	{
+		for (S32 j = 0; j < NUM_JOINTS; j++)
+		{
+			if (!same_bits(a->getCharacterJoint(j)->getWorldMatrix().mMatrix[0],
+						   b->getCharacterJoint(j)->getWorldMatrix().mMatrix[0], 16))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Stands in for the avatar's morph targets
+	class TestParamInfo : public LLVisualParamInfo
+	{
+	public:
+		TestParamInfo(S32 id, const std::string& name)
+		{
+			mID = id;
+			mName = name;
+			mGroup = VISUAL_PARAM_GROUP_ANIMATABLE;
+		}
+	};
+
+	class TestParam : public LLVisualParam
+	{
+	public:
+		TestParam(TestParamInfo* info)
+		{
+			mInfo = info;
+			mID = info->getID();
+			setWeight(getDefaultWeight(), FALSE);
+		}
+		/*virtual*/ void apply(ESex avatar_sex) { mLastWeight = mCurWeight; }
+	};
+
+	const char* EMOTE_PARAM = "Express_Test";
+
+	// Drives a morph the way LLEmote does, but short enough to cycle
+	// through activation and deactivation in a few frames
+	class TestEmoteMotion : public LLMotion
+	{
+	public:
+		TestEmoteMotion(const LLUUID& id) : LLMotion(id), mCharacter(NULL) { mName = "test_emote"; }
+		static LLMotion* create(const LLUUID& id) { return new TestEmoteMotion(id); }
+
+		virtual BOOL getLoop()							{ return FALSE; }
+		virtual F32 getDuration()						{ return 0.1f; }
+		virtual F32 getEaseInDuration()					{ return 0.02f; }
+		virtual F32 getEaseOutDuration()				{ return 0.02f; }
+		virtual F32 getMinPixelArea()					{ return 0.f; }
+		virtual LLJoint::JointPriority getPriority()	{ return LLJoint::MEDIUM_PRIORITY; }
+		virtual LLMotionBlendType getBlendType()		{ return NORMAL_BLEND; }
+		virtual BOOL canDeprecate()						{ return FALSE; }
+
+		virtual LLMotionInitStatus onInitialize(LLCharacter* character)
+		{
+			mCharacter = character;
+			return STATUS_SUCCESS;
+		}
+		virtual BOOL onActivate()
+		{
+			mCharacter->setVisualParamWeight(EMOTE_PARAM, 0.f);
+			mCharacter->requestVisualParamsUpdate();
+			return TRUE;
+		}
+		virtual BOOL onUpdate(F32 time, U8* joint_mask)
+		{
+			mCharacter->setVisualParamWeight(EMOTE_PARAM, llclamp(time / getDuration(), 0.f, 1.f));
+			mCharacter->requestVisualParamsUpdate();
+			return TRUE;
+		}
+		virtual void onDeactivate()
+		{
+			mCharacter->setVisualParamWeight(EMOTE_PARAM, 0.f);
+			mCharacter->requestVisualParamsUpdate();
+		}
+
+	private:
+		LLCharacter* mCharacter;
+	};
+
+	// A character with the blink, hand pose and emote morphs, keeping
+	// track of which threads apply them
+	class ExpressiveCharacter : public TestCharacter
+	{
+	public:
+		ExpressiveCharacter(std::vector<TestParamInfo*>& infos, U32 main_thread_id)
+		:	mMainThreadID(main_thread_id),
+			mUpdates(0),
+			mOffThreadUpdates(0)
+		{
+			for (size_t i = 0; i < infos.size(); i++)
+			{
+				addVisualParam(new TestParam(infos[i]));
+			}
+		}
+
+		/*virtual*/ void updateVisualParams()
+		{
+			mUpdates++;
+			if (LLThread::currentID() != mMainThreadID)
+			{
+				mOffThreadUpdates++;
+			}
+			LLCharacter::updateVisualParams();
+		}
+
+		U32 mMainThreadID;
+		S32 mUpdates;
+		S32 mOffThreadUpdates;
+	};
+
+	void make_expressive_crowd(std::vector<ExpressiveCharacter*>& characters, S32 count,
+							   std::vector<TestParamInfo*>& infos, const LLUUID* ids)
+	{
+		for (S32 c = 0; c < count; c++)
+		{
+			ExpressiveCharacter* character = new ExpressiveCharacter(infos, LLThread::currentID());
+			character->registerMotion(ids[0], LLEyeMotion::create);
+			character->registerMotion(ids[1], LLHandMotion::create);
+			character->registerMotion(ids[2], TestEmoteMotion::create);
+			character->startMotion(ids[0]);
+			character->startMotion(ids[1]);
+			characters.push_back(character);
+		}
+	}
+
+	typedef std::map<F32, LLQuaternion> rotation_map_t;
+	typedef std::map<F32, LLVector3> vector_map_t;
+}
+
+namespace tut
+{
+	struct keyframemotion_data
+	{
+		keyframemotion_data()
+		{
+			mWasVectorized = LLKeyframeMotion::getVectorize();
+		}
+		~keyframemotion_data()
+		{
+			LLKeyframeMotion::setVectorize(mWasVectorized);
+			LLKeyframeDataCache::clear();
+		}
+
+		bool mWasVectorized;
+	};
+	typedef test_group<keyframemotion_data> keyframemotion_test;
+	typedef keyframemotion_test::object keyframemotion_object;
+	tut::keyframemotion_test keyframemotion_testcase("LLKeyframeMotion");
+
+	template<> template<>
+	void keyframemotion_object::test<1>()
+	{
+		set_test_name("sorted keys and cursors match the map lookup");
+
+		Random random(1);
+		const F32 duration = 4.f;
+		LLKeyframeMotion::RotationCurve curve;
+		rotation_map_t keys;
+
+		// Out of order, with repeated times
+		for (S32 k = 0; k < 200; k++)
+		{
+			LLKeyframeMotion::RotationKey key(U16_to_F32((U16)(random.next() % 4000 * 16), 0.f, duration), random_rotation(random));
+			curve.mKeys.push_back(key);
+			keys[key.mTime] = key.mRotation;
+		}
+		curve.sortKeys();
+		ensure_equals("repeated keys merged", curve.mNumKeys, (S32)keys.size());
+		ensure_equals("sorted size", curve.mKeys.size(), keys.size());
+
+		S32 k = 0;
+		for (rotation_map_t::iterator iter = keys.begin(); iter != keys.end(); ++iter, ++k)
+		{
+			ensure("key time", curve.mKeys[k].mTime == iter->first);
+			ensure(llformat("last repeated key wins at %d", k), same_bits(curve.mKeys[k].mRotation.mQ, iter->second.mQ, 4));
+		}
+
+		// Forward at several frame rates, backward, looping and random
+		// seeks, plus times before the first and after the last key and
+		// exactly on keys
+		std::vector<F32> times;
+		for (F32 step = 0.005f; step < 0.5f; step *= 3.f)
+		{
+			for (F32 t = -0.1f; t < duration + 0.1f; t += step)
+			{
+				times.push_back(t);
+			}
+		}
+		for (S32 loop = 0; loop < 3; loop++)
+		{
+			for (F32 t = 0.f; t < duration; t += 1.f / 45.f)
+			{
+				times.push_back(t);
+			}
+		}
+		for (F32 t = duration; t > 0.f; t -= 1.f / 30.f)
+		{
+			times.push_back(t);
+		}
+		for (S32 i = 0; i < 500; i++)
+		{
+			times.push_back(random.frand(-0.1f, duration + 0.1f));
+		}
+		for (k = 0; k < curve.mNumKeys; k++)
+		{
+			times.push_back(curve.mKeys[k].mTime);
+		}
+
+		S32 cursor = 0;
+		for (size_t i = 0; i < times.size(); i++)
+		{
+			LLQuaternion expected = map_rotation(keys, times[i]);
+			LLQuaternion searched = curve.getValue(times[i], duration);
+			LLQuaternion cursored = curve.getValue(times[i], duration, cursor);
+			ensure(llformat("lookup at %f", times[i]), same_bits(expected.mQ, searched.mQ, 4));
+			ensure(llformat("cursor lookup at %f", times[i]), same_bits(expected.mQ, cursored.mQ, 4));
+		}
+
+		// A cursor left over from a longer curve
+		cursor = 100000;
+		ensure("stale cursor", same_bits(curve.getValue(1.f, duration, cursor).mQ, map_rotation(keys, 1.f).mQ, 4));
+
+		// Single key and empty curves
+		LLKeyframeMotion::PositionCurve pos_curve;
+		ensure("empty curve", pos_curve.getValue(1.f, duration, cursor) == LLVector3::zero);
+		pos_curve.mKeys.push_back(LLKeyframeMotion::PositionKey(2.f, LLVector3(1.f, 2.f, 3.f)));
+		pos_curve.sortKeys();
+		ensure("single key before", pos_curve.getValue(0.f, duration, cursor) == LLVector3(1.f, 2.f, 3.f));
+		ensure("single key after", pos_curve.getValue(3.f, duration, cursor) == LLVector3(1.f, 2.f, 3.f));
+	}
+
+	template<> template<>
+	void keyframemotion_object::test<2>()
+	{
+		set_test_name("batched kernels");
+
+		// Up to 4 channels past a multiple of 4, to cover the tails
+		const S32 COUNT = 103;
+		Random random(2);
+		std::vector<F32> before(COUNT * 4), after(COUNT * 4), u(COUNT);
+		S32 opposite = 0;
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			LLQuaternion a = random_rotation(random);
+			LLQuaternion b = random_rotation(random);
+			if (i % 5 == 0)
+			{
+				// opposite hemispheres: nlerp() slerps these
+				for (S32 c = 0; c < 4; c++)
+				{
+					b.mQ[c] = random.frand(-0.2f, 0.2f) - a.mQ[c];
+				}
+				b.normalize();
+			}
+			opposite += dot(a, b) < 0.f;
+			memcpy(&before[i * 4], a.mQ, sizeof(a.mQ));
+			memcpy(&after[i * 4], b.mQ, sizeof(b.mQ));
+			u[i] = random.frand(0.f, 1.f);
+		}
+		ensure("some channels slerp", opposite > 0);
+
+		std::vector<F32> expected(COUNT * 4), actual(COUNT * 4);
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			LLQuaternion a, b;
+			memcpy(a.mQ, &before[i * 4], sizeof(a.mQ));
+			memcpy(b.mQ, &after[i * 4], sizeof(b.mQ));
+			LLQuaternion r = nlerp(u[i], a, b);
+			memcpy(&expected[i * 4], r.mQ, sizeof(r.mQ));
+		}
+		LLKeyframeMotion::interpRotations(&before[0], &after[0], &u[0], &actual[0], COUNT);
+		ensure("scalar rotations are nlerp()", same_bits(&expected[0], &actual[0], COUNT * 4));
+
+		std::vector<F32> vec_before(COUNT * 3), vec_after(COUNT * 3), vec_expected(COUNT * 3), vec_actual(COUNT * 3);
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			LLVector3 a(random.frand(-5.f, 5.f), random.frand(-5.f, 5.f), random.frand(-5.f, 5.f));
+			LLVector3 b(random.frand(-5.f, 5.f), random.frand(-5.f, 5.f), random.frand(-5.f, 5.f));
+			LLVector3 r = lerp(a, b, u[i]);
+			memcpy(&vec_before[i * 3], a.mV, sizeof(a.mV));
+			memcpy(&vec_after[i * 3], b.mV, sizeof(b.mV));
+			memcpy(&vec_expected[i * 3], r.mV, sizeof(r.mV));
+		}
+		LLKeyframeMotion::interpVectors(&vec_before[0], &vec_after[0], &u[0], &vec_actual[0], COUNT);
+		ensure("scalar vectors are lerp()", same_bits(&vec_expected[0], &vec_actual[0], COUNT * 3));
+
+		LLKeyframeMotion::setVectorize(true);
+		if (!LLKeyframeMotion::getVectorize())
+		{
+			skip("SSE2 kernels unavailable");
+		}
+
+		for (S32 count = 0; count <= COUNT; count += (count < 9) ? 1 : 47)
+		{
+			std::fill(actual.begin(), actual.end(), 0.f);
+			LLKeyframeMotion::interpRotationsSSE2(&before[0], &after[0], &u[0], &actual[0], count);
+			ensure(llformat("SSE2 rotations, count %d", count), same_bits(&expected[0], &actual[0], count * 4) || !LL_SSE2_MATH);
+
+			std::fill(vec_actual.begin(), vec_actual.end(), 0.f);
+			LLKeyframeMotion::interpVectorsSSE2(&vec_before[0], &vec_after[0], &u[0], &vec_actual[0], count);
+			ensure(llformat("SSE2 vectors, count %d", count), same_bits(&vec_expected[0], &vec_actual[0], count * 3) || !LL_SSE2_MATH);
+
+			for (S32 i = count * 4; i < COUNT * 4; i++)
+			{
+				ensure("SSE2 rotations write only count", actual[i] == 0.f);
+			}
+			for (S32 i = count * 3; i < COUNT * 3; i++)
+			{
+				ensure("SSE2 vectors write only count", vec_actual[i] == 0.f);
+			}
+		}
+	}
+
+	template<> template<>
+	void keyframemotion_object::test<3>()
+	{
+		set_test_name("playback matches the curves");
+
+		std::vector<U8> buffer(256 * 1024);
+		S32 size = build_anim(3, &buffer[0], (S32)buffer.size());
+		LLUUID id;
+		id.generate();
+
+		TestCharacter character;
+		TestMotion motion(id);
+		ensure("deserialize", motion.load(&character, &buffer[0], size));
+		ensure_equals("joints", motion.mJointMotionList->getNumJointMotions(), (U32)NUM_JOINTS);
+
+		// A second motion shares the cached curves but has its own cursors
+		TestCharacter other_character;
+		TestMotion other_motion(id);
+		ensure("cached", other_motion.load(&other_character, &buffer[0], size));
+		ensure("shared curves", other_motion.mJointMotionList == motion.mJointMotionList);
+
+		// The file round trips, up to the requantizing of rotations
+		std::vector<U8> written(buffer.size());
+		LLDataPackerBinaryBuffer dp(&written[0], (S32)written.size());
+		ensure("serialize", motion.serialize(dp));
+		ensure_equals("serialized size", dp.getCurrentSize(), size);
+		LLUUID written_id;
+		written_id.generate();
+		TestMotion written_motion(written_id);
+		ensure("deserialize serialized", written_motion.load(&character, &written[0], size));
+		F32 time_step = motion.mJointMotionList->mDuration / 65535.f;
+		for (S32 j = 0; j < NUM_JOINTS; j++)
+		{
+			const LLKeyframeMotion::RotationCurve& curve = motion.mJointMotionList->getJointMotion(j)->mRotationCurve;
+			const LLKeyframeMotion::RotationCurve& written_curve = written_motion.mJointMotionList->getJointMotion(j)->mRotationCurve;
+			ensure_equals("serialized keys", written_curve.mNumKeys, curve.mNumKeys);
+			for (S32 k = 0; k < curve.mNumKeys; k++)
+			{
+				ensure("serialized key time", fabsf(written_curve.mKeys[k].mTime - curve.mKeys[k].mTime) <= 1.01f * time_step);
+			}
+		}
+
+		F32 duration = motion.mJointMotionList->mDuration;
+		for (S32 vectorize = 0; vectorize < 2; vectorize++)
+		{
+			LLKeyframeMotion::setVectorize(vectorize != 0);
+			if (vectorize && !LLKeyframeMotion::getVectorize())
+			{
+				break;
+			}
+
+			for (S32 frame = 0; frame < 400; frame++)
+			{
+				// The two motions run at different rates and directions
+				F32 time = fmodf(frame / 30.f, duration);
+				F32 other_time = duration - fmodf(frame / 70.f, duration);
+				motion.applyKeyframes(time);
+				other_motion.applyKeyframes(other_time);
+
+				for (S32 j = 0; j < NUM_JOINTS; j++)
+				{
+					LLKeyframeMotion::JointMotion* joint_motion = motion.mJointMotionList->getJointMotion(j);
+					LLQuaternion rot = joint_motion->mRotationCurve.getValue(time, duration);
+					LLQuaternion other_rot = joint_motion->mRotationCurve.getValue(other_time, duration);
+					bool exact = LL_SSE2_MATH || !vectorize;
+					ensure(llformat("rotation of joint %d at %f", j, time),
+						   same_bits(motion.mJointStates[j]->getRotation().mQ, rot.mQ, 4) || !exact);
+					ensure(llformat("other rotation of joint %d at %f", j, other_time),
+						   same_bits(other_motion.mJointStates[j]->getRotation().mQ, other_rot.mQ, 4) || !exact);
+					if (joint_motion->mPositionCurve.mNumKeys)
+					{
+						LLVector3 pos = joint_motion->mPositionCurve.getValue(time, duration);
+						ensure(llformat("position of joint %d at %f", j, time),
+							   same_bits(motion.mJointStates[j]->getPosition().mV, pos.mV, 3) || !exact);
+					}
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void keyframemotion_object::test<4>()
+	{
+		set_test_name("benchmark: a crowd playing a set of animations");
+
+		const S32 NUM_ANIMS = 8;
+		const S32 NUM_CHARACTERS = 100;
+		const S32 MOTIONS_PER_CHARACTER = 2;
+		const S32 NUM_FRAMES = 300;
+		const F32 FRAME_TIME = 1.f / 30.f;
+
+		std::vector<U8> buffers[NUM_ANIMS];
+		S32 sizes[NUM_ANIMS];
+		LLUUID ids[NUM_ANIMS];
+		for (S32 a = 0; a < NUM_ANIMS; a++)
+		{
+			buffers[a].resize(256 * 1024);
+			sizes[a] = build_anim(100 + a, &buffers[a][0], (S32)buffers[a].size());
+			ids[a].generate();
+		}
+
+		std::vector<TestCharacter*> characters;
+		std::vector<TestMotion*> motions;
+		std::vector<F32> offsets;
+		Random random(4);
+		for (S32 c = 0; c < NUM_CHARACTERS; c++)
+		{
+			characters.push_back(new TestCharacter);
+			for (S32 m = 0; m < MOTIONS_PER_CHARACTER; m++)
+			{
+				S32 a = (c + m * 3) % NUM_ANIMS;
+				TestMotion* motion = new TestMotion(ids[a]);
+				ensure("load", motion->load(characters.back(), &buffers[a][0], sizes[a]));
+				motions.push_back(motion);
+				offsets.push_back(random.frand(0.f, 10.f));
+			}
+		}
+
+		// The keys as the curves used to hold them
+		std::map<LLKeyframeMotion::JointMotionList*, std::vector<rotation_map_t> > rotation_maps;
+		std::map<LLKeyframeMotion::JointMotionList*, vector_map_t> position_maps;
+		for (size_t m = 0; m < motions.size(); m++)
+		{
+			LLKeyframeMotion::JointMotionList* list = motions[m]->mJointMotionList;
+			std::vector<rotation_map_t>& maps = rotation_maps[list];
+			if (!maps.empty())
+			{
+				continue;
+			}
+			maps.resize(list->getNumJointMotions());
+			for (U32 j = 0; j < list->getNumJointMotions(); j++)
+			{
+				LLKeyframeMotion::JointMotion* joint_motion = list->getJointMotion(j);
+				for (S32 k = 0; k < joint_motion->mRotationCurve.mNumKeys; k++)
+				{
+					maps[j][joint_motion->mRotationCurve.mKeys[k].mTime] = joint_motion->mRotationCurve.mKeys[k].mRotation;
+				}
+				for (S32 k = 0; k < joint_motion->mPositionCurve.mNumKeys; k++)
+				{
+					position_maps[list][joint_motion->mPositionCurve.mKeys[k].mTime] = joint_motion->mPositionCurve.mKeys[k].mPosition;
+				}
+			}
+		}
+
+		U32 channels = 0;
+		for (size_t m = 0; m < motions.size(); m++)
+		{
+			LLKeyframeMotion::JointMotionList* list = motions[m]->mJointMotionList;
+			channels += list->getNumJointMotions() + (position_maps[list].empty() ? 0 : 1);
+		}
+
+		LLTimer timer;
+		F64 map_seconds = 0.0;
+		{
+			timer.reset();
+			for (S32 frame = 0; frame < NUM_FRAMES; frame++)
+			{
+				for (size_t m = 0; m < motions.size(); m++)
+				{
+					TestMotion* motion = motions[m];
+					LLKeyframeMotion::JointMotionList* list = motion->mJointMotionList;
+					F32 time = fmodf(offsets[m] + frame * FRAME_TIME, list->mDuration);
+					std::vector<rotation_map_t>& maps = rotation_maps[list];
+					for (size_t j = 0; j < maps.size(); j++)
+					{
+						motion->mJointStates[j]->setRotation(map_rotation(maps[j], time));
+					}
+					vector_map_t& positions = position_maps[list];
+					if (!positions.empty())
+					{
+						motion->mJointStates[0]->setPosition(map_vector(positions, time));
+					}
+				}
+			}
+			map_seconds = timer.getElapsedTimeF64();
+		}
+
+		llinfos << "LLKeyframeMotion: " << NUM_CHARACTERS << " characters, " << motions.size() << " motions, "
+				<< channels << " channels, " << NUM_FRAMES << " frames" << llendl;
+		llinfos << "LLKeyframeMotion: map lookups " << map_seconds * 1000.0 << " ms, "
+				<< (F64)channels * NUM_FRAMES / map_seconds / 1000000.0 << "M channels/s" << llendl;
+
+		const char* names[] = { "scalar", "SSE2" };
+		for (S32 vectorize = 0; vectorize < 2; vectorize++)
+		{
+			LLKeyframeMotion::setVectorize(vectorize != 0);
+			if (vectorize && !LLKeyframeMotion::getVectorize())
+			{
+				llinfos << "LLKeyframeMotion: SSE2 kernels unavailable, skipping" << llendl;
+				break;
+			}
+
+			timer.reset();
+			for (S32 frame = 0; frame < NUM_FRAMES; frame++)
+			{
+				for (size_t m = 0; m < motions.size(); m++)
+				{
+					TestMotion* motion = motions[m];
+					F32 time = fmodf(offsets[m] + frame * FRAME_TIME, motion->mJointMotionList->mDuration);
+					motion->applyKeyframes(time);
+				}
+			}
+			F64 seconds = timer.getElapsedTimeF64();
+			llinfos << "LLKeyframeMotion: sorted keys, " << names[vectorize] << " " << seconds * 1000.0 << " ms, "
+					<< (F64)channels * NUM_FRAMES / seconds / 1000000.0 << "M channels/s, "
+					<< map_seconds / seconds << "x" << llendl;
+		}
+
+		for_each(motions.begin(), motions.end(), DeletePointer());
+		for_each(characters.begin(), characters.end(), DeletePointer());
+	}
+
+	template<> template<>
+	void keyframemotion_object::test<5>()
+	{
+		set_test_name("crowd updates on the task scheduler match the serial update");
+
+		const S32 NUM_ANIMS = 8;
+		const S32 NUM_FRAMES = 60;
+		const S32 CROWD_SIZES[] = { 25, 50, 100, 200 };
+		const S32 THREAD_COUNTS[] = { 1, 2, 4 };
+
+		LLCriticalDamp::initClass();
+
+		std::vector<U8> buffer(256 * 1024);
+		LLUUID ids[NUM_ANIMS];
+		std::vector<TestMotion*> loaders;
+		TestCharacter loader_character;
+		for (S32 a = 0; a < NUM_ANIMS; a++)
+		{
+			// loading one motion puts the animation in the keyframe cache
+			S32 size = build_anim(200 + a, &buffer[0], (S32)buffer.size());
+			ids[a].generate();
+			loaders.push_back(new TestMotion(ids[a]));
+			ensure("load", loaders.back()->load(&loader_character, &buffer[0], size));
+		}
+
+		for (size_t s = 0; s < LL_ARRAY_SIZE(CROWD_SIZES); s++)
+		{
+			S32 crowd_size = CROWD_SIZES[s];
+			for (size_t t = 0; t < LL_ARRAY_SIZE(THREAD_COUNTS); t++)
+			{
+				LLTaskScheduler scheduler(THREAD_COUNTS[t]);
+
+				// the same crowd twice, one updated serially as the reference
+				std::vector<TestCharacter*> serial;
+				std::vector<TestCharacter*> parallel;
+				make_crowd(serial, crowd_size, ids, NUM_ANIMS);
+				make_crowd(parallel, crowd_size, ids, NUM_ANIMS);
+
+				EvaluateBody body(parallel);
+				F64 serial_seconds = 0.0;
+				F64 parallel_seconds = 0.0;
+				LLTimer timer;
+				for (S32 frame = 0; frame < NUM_FRAMES; frame++)
+				{
+					LLFrameTimer::updateFrameTime();
+
+					timer.reset();
+					for (S32 c = 0; c < crowd_size; c++)
+					{
+						serial[c]->updateMotions(LLCharacter::NORMAL_UPDATE);
+						serial[c]->getRootJoint()->updateWorldMatrixChildren();
+					}
+					serial_seconds += timer.getElapsedTimeF64();
+
+					timer.reset();
+					for (S32 c = 0; c < crowd_size; c++)
+					{
+						parallel[c]->beginUpdateMotions(LLCharacter::NORMAL_UPDATE);
+					}
+					scheduler.parallelFor(crowd_size, body);
+					for (S32 c = 0; c < crowd_size; c++)
+					{
+						parallel[c]->endUpdateMotions();
+					}
+					parallel_seconds += timer.getElapsedTimeF64();
+
+					for (S32 c = 0; c < crowd_size; c++)
+					{
+						ensure(llformat("pose of character %d at frame %d", c, frame), same_pose(serial[c], parallel[c]));
+					}
+				}
+
+				llinfos << "LLKeyframeMotion: " << crowd_size << " characters, " << scheduler.getNumThreads() << " threads, "
+						<< serial_seconds * 1000.0 / NUM_FRAMES << " ms/frame serial, "
+						<< parallel_seconds * 1000.0 / NUM_FRAMES << " ms/frame parallel, "
+						<< serial_seconds / parallel_seconds << "x" << llendl;
+
+				for_each(serial.begin(), serial.end(), DeletePointer());
+				for_each(parallel.begin(), parallel.end(), DeletePointer());
+			}
+		}
+
+		for_each(loaders.begin(), loaders.end(), DeletePointer());
+		LLCriticalDamp::cleanupClass();
+	}
+
+	template<> template<>
+	void keyframemotion_object::test<6>()
+	{
+		set_test_name("blink, hand and emote morphs from a parallel crowd update are applied on the main thread");
+
+		const S32 NUM_FRAMES = 60;
+		const S32 CROWD_SIZE = 16;
+		const S32 THREAD_COUNTS[] = { 1, 2, 4 };
+
+		LLCriticalDamp::initClass();
+
+		std::vector<TestParamInfo*> infos;
+		infos.push_back(new TestParamInfo(1, "Blink_Left"));
+		infos.push_back(new TestParamInfo(2, "Blink_Right"));
+		infos.push_back(new TestParamInfo(3, EMOTE_PARAM));
+		for (S32 p = 1; p < LLHandMotion::NUM_HAND_POSES; p++)
+		{
+			infos.push_back(new TestParamInfo(100 + p, gHandPoseNames[p]));
+		}
+
+		LLHandMotion::eHandPose poses[LLHandMotion::NUM_HAND_POSES];
+		for (S32 p = 0; p < LLHandMotion::NUM_HAND_POSES; p++)
+		{
+			poses[p] = (LLHandMotion::eHandPose)p;
+		}
+
+		// eyes, hands, emote
+		LLUUID ids[3];
+		for (S32 i = 0; i < 3; i++)
+		{
+			ids[i].generate();
+		}
+
+		for (size_t t = 0; t < LL_ARRAY_SIZE(THREAD_COUNTS); t++)
+		{
+			LLTaskScheduler scheduler(THREAD_COUNTS[t]);
+
+			std::vector<ExpressiveCharacter*> serial;
+			std::vector<ExpressiveCharacter*> parallel;
+			make_expressive_crowd(serial, CROWD_SIZE, infos, ids);
+			make_expressive_crowd(parallel, CROWD_SIZE, infos, ids);
+
+			std::vector<TestCharacter*> bodies(parallel.begin(), parallel.end());
+			EvaluateBody body(bodies);
+			for (S32 frame = 0; frame < NUM_FRAMES; frame++)
+			{
+				LLFrameTimer::updateFrameTime();
+
+				// new hand poses and emotes come in from the main thread
+				for (S32 c = 0; c < CROWD_SIZE; c++)
+				{
+					S32 pose = (frame / 10 + c) % LLHandMotion::NUM_HAND_POSES;
+					serial[c]->setAnimationData("Hand Pose", &poses[pose]);
+					parallel[c]->setAnimationData("Hand Pose", &poses[pose]);
+					if ((frame + c) % 15 == 0)
+					{
+						serial[c]->startMotion(ids[2]);
+						parallel[c]->startMotion(ids[2]);
+					}
+				}
+
+				for (S32 c = 0; c < CROWD_SIZE; c++)
+				{
+					serial[c]->updateMotions(LLCharacter::NORMAL_UPDATE);
+				}
+
+				for (S32 c = 0; c < CROWD_SIZE; c++)
+				{
+					parallel[c]->beginUpdateMotions(LLCharacter::NORMAL_UPDATE);
+				}
+				scheduler.parallelFor(CROWD_SIZE, body);
+				for (S32 c = 0; c < CROWD_SIZE; c++)
+				{
+					parallel[c]->endUpdateMotions();
+				}
+
+				for (S32 c = 0; c < CROWD_SIZE; c++)
+				{
+					ensure(llformat("update of character %d left pending at frame %d", c, frame),
+						   !parallel[c]->isVisualParamsUpdatePending());
+					for (size_t p = 0; p < infos.size(); p++)
+					{
+						LLVisualParam* serial_param = serial[c]->getVisualParam(infos[p]->getID());
+						LLVisualParam* parallel_param = parallel[c]->getVisualParam(infos[p]->getID());
+						ensure_equals(llformat("%s applied on character %d at frame %d", parallel_param->getName().c_str(), c, frame),
+									  parallel_param->getLastWeight(), parallel_param->getWeight());
+						// blinks are random, the hand poses and emotes are not
+						if (p >= 2)
+						{
+							ensure_equals(llformat("weight of %s on character %d at frame %d", parallel_param->getName().c_str(), c, frame),
+										  parallel_param->getWeight(), serial_param->getWeight());
+						}
+					}
+				}
+			}
+
+			for (S32 c = 0; c < CROWD_SIZE; c++)
+			{
+				ensure(llformat("character %d updated its visual params", c), parallel[c]->mUpdates > 0);
+				ensure_equals(llformat("visual param updates of character %d off the main thread", c),
+							  parallel[c]->mOffThreadUpdates, 0);
+			}
+
+			for_each(serial.begin(), serial.end(), DeletePointer());
+			for_each(parallel.begin(), parallel.end(), DeletePointer());
+		}
+
+		for_each(infos.begin(), infos.end(), DeletePointer());
+		LLCriticalDamp::cleanupClass();
+	}
+}
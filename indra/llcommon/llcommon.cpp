@@ -34,6 +34,7 @@
 
 #include "llcommon.h"
 
+#include "llcriticaldamp.h"
 #include "llmemory.h"
 #include "llthread.h"
 
@@ -51,6 +52,7 @@ void LLCommon::initClass()
 	}
 	LLTimer::initClass();
 	LLThreadSafeRefCount::initThreadSafeRefCount();
+	LLCriticalDamp::initClass();
 // 	LLWorkerThread::initClass();
 // 	LLFrameCallbackManager::initClass();
 }
@@ -60,6 +62,7 @@ void LLCommon::cleanupClass()
 {
 // 	LLFrameCallbackManager::cleanupClass();
 // 	LLWorkerThread::cleanupClass();
+	LLCriticalDamp::cleanupClass();
 	LLThreadSafeRefCount::cleanupThreadSafeRefCount();
 	LLTimer::cleanupClass();
 	if (sAprInitialized)
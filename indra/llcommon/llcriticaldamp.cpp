@@ -35,12 +35,15 @@
 
 #include "llcriticaldamp.h"
 
+#include "llthread.h"
+
 //-----------------------------------------------------------------------------
 // static members
 //-----------------------------------------------------------------------------
 LLFrameTimer LLCriticalDamp::sInternalTimer;
 std::map<F32, F32> LLCriticalDamp::sInterpolants;
 F32 LLCriticalDamp::sTimeDelta;
+LLMutex* LLCriticalDamp::sMutex = NULL;
 
 //-----------------------------------------------------------------------------
 // LLCriticalDamp()
@@ -50,6 +53,22 @@ LLCriticalDamp::LLCriticalDamp()
 	sTimeDelta = 0.f;
 }
 
+// static
+void LLCriticalDamp::initClass()
+{
+	if (!sMutex)
+	{
+		sMutex = new LLMutex(NULL);
+	}
+}
+
+// static
+void LLCriticalDamp::cleanupClass()
+{
+	delete sMutex;
+	sMutex = NULL;
+}
+
 // static
 //-----------------------------------------------------------------------------
 // updateInterpolants()
@@ -58,6 +77,7 @@ void LLCriticalDamp::updateInterpolants()
 {
 	sTimeDelta = sInternalTimer.getElapsedTimeAndResetF32();
 
+	if (sMutex) sMutex->lock();
 	F32 time_constant;
 
 	for (std::map<F32, F32>::iterator iter = sInterpolants.begin();
@@ -68,6 +88,7 @@ void LLCriticalDamp::updateInterpolants()
 		new_interpolant = llclamp(new_interpolant, 0.f, 1.f);
 		sInterpolants[time_constant] = new_interpolant;
 	}
+	if (sMutex) sMutex->unlock();
 } 
 
 //-----------------------------------------------------------------------------
@@ -80,16 +101,27 @@ F32 LLCriticalDamp::getInterpolant(const F32 time_constant, BOOL use_cache)
 		return 1.f;
 	}
 
-	if (use_cache && sInterpolants.count(time_constant))
+	if (use_cache)
 	{
-		return sInterpolants[time_constant];
+		// animations call this from the avatar update threads
+		if (sMutex) sMutex->lock();
+		std::map<F32, F32>::iterator iter = sInterpolants.find(time_constant);
+		bool found = (iter != sInterpolants.end());
+		F32 interpolant = found ? iter->second : 0.f;
+		if (sMutex) sMutex->unlock();
+		if (found)
+		{
+			return interpolant;
+		}
 	}
 	
 	F32 interpolant = 1.f - pow(2.f, -sTimeDelta / time_constant);
 	interpolant = llclamp(interpolant, 0.f, 1.f);
 	if (use_cache)
 	{
+		if (sMutex) sMutex->lock();
 		sInterpolants[time_constant] = interpolant;
+		if (sMutex) sMutex->unlock();
 	}
 
 	return interpolant;
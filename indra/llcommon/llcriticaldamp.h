@@ -39,11 +39,18 @@
 
 #include "llframetimer.h"
 
+class LLMutex;
+
 class LL_COMMON_API LLCriticalDamp 
 {
 public:
 	LLCriticalDamp();
 
+	// Creates the lock that lets getInterpolant() be called from any
+	// thread.  Called by LLCommon::initClass().
+	static void initClass();
+	static void cleanupClass();
+
 	// MANIPULATORS
 	static void updateInterpolants();
 
@@ -55,6 +62,7 @@ protected:
 
 	static std::map<F32, F32> 	sInterpolants;
 	static F32					sTimeDelta;
+	static LLMutex*				sMutex;		// guards sInterpolants
 };
 
 #endif  // LL_LLCRITICALDAMP_H
@@ -254,12 +254,14 @@ LLFastTimer::FrameState::FrameState(LLFastTimer::NamedTimer* timerp)
 	mParent(NULL),
 	mLastCaller(NULL),
 	mMoveUpTree(false),
-	mTimer(timerp)
+	mTimer(timerp),
+	mTraceID(timerp ? timerp->mTraceID : 0)
 {}
 
 
 LLFastTimer::NamedTimer::NamedTimer(const std::string& name)
 :	mName(name),
+	mTraceID(LLTraceRecorder::registerTimer(name)),
 	mCollapsed(true),
 	mParent(NULL),
 	mTotalTimeCounter(0),
@@ -693,6 +695,11 @@ void LLFastTimer::nextFrame()
 	// get ready for next frame
 	NamedTimer::resetFrame();
 	sLastFrameTime = frame_time;
+
+	if (LLTraceRecorder::isRecording())
+	{
+		LLTraceRecorder::markFrame();
+	}
 }
 
 //static
@@ -727,6 +734,9 @@ void LLFastTimer::dumpCurTimes()
 
 		llinfos << out_str.str() << llendl;
 	}
+
+	// worker threads keep their own timers
+	LLTraceRecorder::dumpThreadTimes();
 }
 
 //static 
@@ -739,12 +749,21 @@ void LLFastTimer::reset()
 //static
 void LLFastTimer::writeLog(std::ostream& os)
 {
-	while (!sLogQueue.empty())
+	// Empty the queue under the lock and format outside of it, so the main
+	// thread never waits on the XML formatter (and front() is never read
+	// while the main thread pushes).  Copying an LLSD only takes a reference.
+	std::vector<LLSD> frames;
 	{
-		LLSD& sd = sLogQueue.front();
-		LLSDSerialize::toXML(sd, os);
 		LLMutexLock lock(sLogLock);
-		sLogQueue.pop();
+		while (!sLogQueue.empty())
+		{
+			frames.push_back(sLogQueue.front());
+			sLogQueue.pop();
+		}
+	}
+	for (std::vector<LLSD>::iterator it = frames.begin(); it != frames.end(); ++it)
+	{
+		LLSDSerialize::toXML(*it, os);
 	}
 }
 
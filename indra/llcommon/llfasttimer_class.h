@@ -35,6 +35,7 @@
 #define LL_FASTTIMER_CLASS_H
 
 #include "llinstancetracker.h"
+#include "lltracerecorder.h"
 
 #define FAST_TIMER_ON 1
 #define TIME_FAST_TIMERS 0
@@ -58,6 +59,7 @@ public:
 		FrameState*			mParent;		// info for caller timer
 		FrameState*			mLastCaller;	// used to bootstrap tree construction
 		NamedTimer*			mTimer;
+		U32					mTraceID;		// LLTraceRecorder timer id
 		U16					mActiveCount;	// number of timers with this ID active on stack
 		bool				mMoveUpTree;	// needs to be moved up the tree of timers at the end of frame
 	};
@@ -123,6 +125,7 @@ public:
 		S32			mFrameStateIndex;
 
 		std::string	mName;
+		U32			mTraceID;
 
 		U32 		mTotalTimeCounter;
 
@@ -150,6 +153,8 @@ public:
 
 		static void updateCachedPointers();
 
+		U32 getTraceID() const { return mTimer.mTraceID; }
+
 	private:
 		NamedTimer&		mTimer;
 		FrameState*		mFrameState;
@@ -178,6 +183,10 @@ public:
 		cur_timer_data->mCurTimer = this;
 		cur_timer_data->mFrameState = frame_state;
 		cur_timer_data->mChildTime = 0;
+		if (LLTraceRecorder::isRecording())
+		{
+			LLTraceRecorder::recordMainThreadEvent(LLTraceRecorder::EVENT_BEGIN, frame_state->mTraceID);
+		}
 #endif
 #if TIME_FAST_TIMERS
 		U64 timer_end = getCPUClockCount64();
@@ -205,6 +214,10 @@ public:
 		mLastTimerData.mChildTime += total_time;
 
 		LLFastTimer::sCurTimerData = mLastTimerData;
+		if (LLTraceRecorder::isRecording())
+		{
+			LLTraceRecorder::recordMainThreadEvent(LLTraceRecorder::EVENT_END, frame_state->mTraceID);
+		}
 #endif
 #if TIME_FAST_TIMERS
 		U64 timer_end = getCPUClockCount64();
@@ -270,4 +283,23 @@ private:
 
 typedef class LLFastTimer LLFastTimer;
 
+// Times a block on any thread.  LLFastTimer keeps its state in statics and
+// is main thread only; this one accumulates into the calling thread's own
+// timer stack in LLTraceRecorder and shows up in traces and
+// LLTraceRecorder::dumpThreadTimes().  Declare the timer at file scope,
+// named timers are not created thread safely.
+class LL_COMMON_API LLThreadFastTimer
+{
+public:
+	LLThreadFastTimer(LLFastTimer::DeclareTimer& timer)
+	{
+		LLTraceRecorder::pushTimer(timer.getTraceID());
+	}
+
+	~LLThreadFastTimer()
+	{
+		LLTraceRecorder::popTimer();
+	}
+};
+
 #endif // LL_LLFASTTIMER_CLASS_H
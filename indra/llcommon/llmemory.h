@@ -33,6 +33,10 @@
 #ifndef LLMEMORY_H
 #define LLMEMORY_H
 
+#include <stdlib.h>
+#if LL_WINDOWS
+#include <malloc.h>
+#endif
 
 
 extern S32 gTotalDAlloc;
@@ -55,6 +59,33 @@ private:
 	static char* reserveMem;
 };
 
+// Allocations for SIMD data. The returned block MUST be freed with
+// ll_aligned_free_16().
+inline void* ll_aligned_malloc_16(size_t size)
+{
+#if LL_WINDOWS
+	return _aligned_malloc(size, 16);
+#elif LL_DARWIN
+	return malloc(size); // the OS X malloc is always 16 byte aligned
+#else
+	void* rtn;
+	if (LL_LIKELY(0 == posix_memalign(&rtn, 16, size)))
+	{
+		return rtn;
+	}
+	return NULL; // out of memory
+#endif
+}
+
+inline void ll_aligned_free_16(void* p)
+{
+#if LL_WINDOWS
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
 // LLRefCount moved to llrefcount.h
 
 // LLPointer moved to llpointer.h
@@ -95,6 +95,14 @@
 	#endif
 #endif
 
+// Scalar float math is done in SSE registers rather than on the x87
+// stack, so it rounds exactly like the SSE2 kernels do.
+#if defined(__SSE2_MATH__) || defined(__x86_64__) || defined(_M_X64)
+	#define LL_SSE2_MATH 1
+#else
+	#define LL_SSE2_MATH 0
+#endif
+
 // Deal with minor differences on Unixy OSes.
 #if LL_DARWIN || LL_LINUX
 	// Different name, same functionality.
@@ -34,21 +34,57 @@
 #include "llqueuedthread.h"
 
 #include "llstl.h"
+#include "lltaskscheduler.h"
 #include "lltimer.h"	// ms_sleep()
 
 //============================================================================
 
+// Processes requests on the scheduler, see LLQueuedThread::drain()
+class LLQueuedThread::DrainTask : public LLTaskScheduler::Task
+{
+public:
+	DrainTask(LLQueuedThread* owner, U32 priority)
+		: LLTaskScheduler::Task(priority),
+		  mOwner(owner)
+	{
+	}
+
+protected:
+	/*virtual*/ void run()
+	{
+		mOwner->drain();
+	}
+
+private:
+	LLQueuedThread* mOwner;
+};
+
+//============================================================================
+
 // MAIN THREAD
-LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded) :
+LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded, bool use_scheduler) :
 	LLThread(name),
 	mThreaded(threaded),
 	mIdleThread(TRUE),
 	mNextHandle(0),
-	mStarted(FALSE)
+	mStarted(FALSE),
+	mScheduler(NULL),
+	mMaxConcurrency(1),
+	mScheduledDrains(0)
 {
 	if (mThreaded)
 	{
-		start();
+		mScheduler = use_scheduler ? LLTaskScheduler::getInstance() : NULL;
+		if (mScheduler)
+		{
+			// No thread of our own, but we are running as far as
+			// LLThread is concerned (see isPaused())
+			mStatus = RUNNING;
+		}
+		else
+		{
+			start();
+		}
 	}
 }
 
@@ -68,7 +104,38 @@ void LLQueuedThread::shutdown()
 	setQuitting();
 
 	unpause(); // MAIN THREAD
-	if (mThreaded)
+	if (mScheduler)
+	{
+		if (mStatus != STOPPED)
+		{
+			// Wait for the drain tasks to see that we are quitting.  They
+			// point at us, so there is no giving up on them.
+			LLTimer timer;
+			bool warned = false;
+			while (true)
+			{
+				lockData();
+				S32 drains = mScheduledDrains;
+				unlockData();
+				if (!drains)
+				{
+					break;
+				}
+				if (!warned && timer.getElapsedTimeF32() > 10.f)
+				{
+					llwarns << "~LLQueuedThread (" << mName << ") still waiting for " << drains << " drain tasks" << llendl;
+					warned = true;
+				}
+				ms_sleep(1);
+			}
+			if (mStarted)
+			{
+				endThread();
+			}
+			mStatus = STOPPED;
+		}
+	}
+	else if (mThreaded)
 	{
 		S32 timeout = 100;
 		for ( ; timeout>0; timeout--)
@@ -136,8 +203,12 @@ S32 LLQueuedThread::updateQueue(U32 max_time_ms)
 		pending = getPending();
 		if(pending > 0)
 		{
-		unpause();
-	}
+			unpause();
+			if (mScheduler)
+			{
+				scheduleDrain();
+			}
+		}
 	}
 	else
 	{
@@ -156,13 +227,24 @@ void LLQueuedThread::incQueue()
 	// Something has been added to the queue
 	if (!isPaused())
 	{
-		if (mThreaded)
+		if (mScheduler)
+		{
+			scheduleDrain();
+		}
+		else if (mThreaded)
 		{
 			wake(); // Wake the thread up if necessary.
 		}
 	}
 }
 
+void LLQueuedThread::setMaxConcurrency(S32 count)
+{
+	lockData();
+	mMaxConcurrency = llmax(count, 1);
+	unlockData();
+}
+
 //virtual
 // May be called from any thread
 S32 LLQueuedThread::getPending()
@@ -401,6 +483,19 @@ bool LLQueuedThread::check()
 // Runs on its OWN thread
 
 S32 LLQueuedThread::processNextRequest()
+{
+	bool back_off = false;
+	S32 pending = processNextRequest(back_off);
+	if (back_off && mThreaded && !mScheduler)
+	{
+		ms_sleep(1); // sleep the thread a little
+	}
+	return pending;
+}
+
+// back_off is set when a low priority request did not complete, and the
+// caller should give it some time before trying again.
+S32 LLQueuedThread::processNextRequest(bool& back_off)
 {
 	QueuedRequest *req;
 	// Get next request from pool
@@ -463,9 +558,9 @@ S32 LLQueuedThread::processNextRequest()
 			req->setStatus(STATUS_QUEUED);
 			mRequestQueue.insert(req);
 			unlockData();
-			if (mThreaded && start_priority < PRIORITY_NORMAL)
+			if (start_priority < PRIORITY_NORMAL)
 			{
-				ms_sleep(1); // sleep the thread a little
+				back_off = true;
 			}
 		}
 	}
@@ -519,6 +614,97 @@ void LLQueuedThread::run()
 	llinfos << "LLQueuedThread " << mName << " EXITING." << llendl;
 }
 
+//============================================================================
+// Scheduled LLQueuedThreads
+
+// Submits another DrainTask if this queue may use one
+void LLQueuedThread::scheduleDrain()
+{
+	lockData();
+	// Nothing else may run until startThread() has returned
+	S32 max_drains = mStarted ? llmin(mMaxConcurrency, (S32)mRequestQueue.size()) : 1;
+	bool submit = (mStatus == RUNNING) && !isPaused() && !mRequestQueue.empty() && mScheduledDrains < max_drains;
+	U32 priority = 0;
+	if (submit)
+	{
+		priority = (*mRequestQueue.begin())->getPriority();
+		mScheduledDrains++;
+		mIdleThread = FALSE;
+	}
+	unlockData();
+	if (submit)
+	{
+		submitDrain(priority, false);
+	}
+}
+
+void LLQueuedThread::submitDrain(U32 priority, bool back_off)
+{
+	DrainTask* task = new DrainTask(this, priority);
+	if (back_off)
+	{
+		mScheduler->submitDelayed(task, 1);
+	}
+	else
+	{
+		mScheduler->submit(task);
+	}
+}
+
+// Runs on a SCHEDULER thread
+// Processes requests until the queue is empty, a request asks us to back
+// off or the time slice is up, so that other queues and more urgent tasks
+// get a turn.
+void LLQueuedThread::drain()
+{
+	const F64 MAX_DRAIN_TIME = 0.005;
+
+	if (!mStarted)
+	{
+		startThread();
+		lockData();
+		mStarted = TRUE;
+		unlockData();
+		// Requests added meanwhile may want more drains
+		scheduleDrain();
+	}
+
+	LLTimer timer;
+	bool back_off = false;
+	while (!isQuitting() && !isPaused())
+	{
+		threadedUpdate();
+		S32 pending = processNextRequest(back_off);
+		if (pending == 0 || back_off || timer.getElapsedTimeF64() > MAX_DRAIN_TIME)
+		{
+			break;
+		}
+	}
+
+	// Either hand our slot to a new task or give it up.  Once it is given
+	// up shutdown() may delete us, so decide everything under the lock.
+	lockData();
+	bool again = (mStatus == RUNNING) && !isPaused() && !mRequestQueue.empty();
+	U32 priority = 0;
+	if (again)
+	{
+		priority = (*mRequestQueue.begin())->getPriority();
+	}
+	else
+	{
+		mScheduledDrains--;
+		if (mScheduledDrains == 0 && mRequestQueue.empty())
+		{
+			mIdleThread = TRUE;
+		}
+	}
+	unlockData();
+	if (again)
+	{
+		submitDrain(priority, back_off);
+	}
+}
+
 // virtual
 void LLQueuedThread::startThread()
 {
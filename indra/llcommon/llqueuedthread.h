@@ -44,9 +44,24 @@
 #include "llthread.h"
 #include "llsimplehash.h"
 
+class LLTaskScheduler;
+
 //============================================================================
 // Note: ~LLQueuedThread is O(N) N=# of queued threads, assumed to be small
 //   It is assumed that LLQueuedThreads are rarely created/destroyed.
+//
+// A threaded LLQueuedThread created while LLTaskScheduler::getInstance()
+// is set does not start a thread.  Instead it submits tasks to the
+// scheduler that process its requests for a few milliseconds at a time,
+// at the priority of the request at the head of the queue.  By default
+// one such task runs at a time, so requests see the same serial order as
+// on a thread of their own; see setMaxConcurrency().  startThread(),
+// threadedUpdate() and endThread() are still called, but from whichever
+// worker runs the task (endThread() from shutdown()).
+//
+// A queue whose startThread() sets up state that must stay on one thread
+// (LLTextureFetch's LLCurlRequest) passes use_scheduler = false to keep a
+// thread of its own.
 
 class LL_COMMON_API LLQueuedThread : public LLThread
 {
@@ -156,7 +171,7 @@ public:
 	static handle_t nullHandle() { return handle_t(0); }
 	
 public:
-	LLQueuedThread(const std::string& name, bool threaded = true);
+	LLQueuedThread(const std::string& name, bool threaded = true, bool use_scheduler = true);
 	virtual ~LLQueuedThread();	
 	virtual void shutdown();
 	
@@ -171,11 +186,21 @@ private:
 	virtual void endThread(void);
 	virtual void threadedUpdate(void);
 
+	class DrainTask;
+	friend class DrainTask;
+	S32 processNextRequest(bool& back_off);
+	void scheduleDrain();
+	void submitDrain(U32 priority, bool back_off);
+	void drain();
+
 protected:
 	handle_t generateHandle();
 	bool addRequest(QueuedRequest* req);
 	S32  processNextRequest(void);
 	void incQueue();
+	// Scheduled only: how many scheduler tasks may process requests at
+	// once.  Only for subclasses whose requests are independent.
+	void setMaxConcurrency(S32 count);
 
 public:
 	bool waitForResult(handle_t handle, bool auto_complete = true);
@@ -188,6 +213,7 @@ public:
 
 	S32 getPending();
 	bool getThreaded() { return mThreaded ? true : false; }
+	bool getScheduled() const { return mScheduler != NULL; }
 
 	// Request accessors
 	status_t getRequestStatus(handle_t handle);
@@ -215,6 +241,10 @@ protected:
 	request_hash_t mRequestHash;
 
 	handle_t mNextHandle;
+
+	LLTaskScheduler* mScheduler; // runs the requests if set, instead of our own thread
+	S32 mMaxConcurrency;
+	S32 mScheduledDrains; // DrainTasks submitted and not finished, guarded by lockData()
 };
 
 #endif // LL_LLQUEUEDTHREAD_H
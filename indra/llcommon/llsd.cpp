@@ -67,6 +67,7 @@ class LLSD::Impl
 {
 private:
 	U32 mUseCount;
+	bool mStatic;
 	
 protected:
 	Impl();
@@ -75,11 +76,12 @@ protected:
 	Impl(StaticAllocationMarker);
 		///< This constructor is used for static objects and causes the
 		//   suppresses adjusting the debugging counters when they are
-		//	 finally initialized.
+		//	 finally initialized.  Static objects are never reference
+		//	 counted, so they can be shared between threads.
 		
 	virtual ~Impl();
 	
-	bool shared() const							{ return mUseCount > 1; }
+	bool shared() const							{ return mStatic || mUseCount > 1; }
 	
 public:
 	static void reset(Impl*& var, Impl* impl);
@@ -89,6 +91,11 @@ public:
 	static const Impl& safe(const Impl*);
 		///< since a NULL Impl* is used for undefined, this ensures there is
 		//	 always an object you call virtual member functions on
+
+	static void initShared();
+		///< makes the shared scalars, before main() or by the first LLSD
+		//	 built during static initialization, while there is only the
+		//	 one thread
 		
 	virtual ImplMap& makeMap(Impl*& var);
 	virtual ImplArray& makeArray(Impl*& var);
@@ -160,6 +167,8 @@ namespace
 
 	public:
 		ImplBase(DataRef value) : mValue(value) { }
+		ImplBase(DataRef value, StaticAllocationMarker m)
+			: Impl(m), mValue(value) { }
 		
 		virtual LLSD::Type type() const { return T; }
 
@@ -176,12 +185,19 @@ namespace
 		}
 	};
 
+	// The shared scalars are never freed, so that LLSD objects destroyed
+	// during static destruction can still safely refer to them.  See
+	// LLSD::Impl::initShared().
+	bool sSharedImplsReady = false;
 	
 	class ImplBoolean
 		: public ImplBase<LLSD::TypeBoolean, LLSD::Boolean>
 	{
 	public:
 		ImplBoolean(LLSD::Boolean v) : Base(v) { }
+		ImplBoolean(LLSD::Boolean v, StaticAllocationMarker m) : Base(v, m) { }
+		
+		static LLSD::Impl* create(LLSD::Boolean v);
 		
 		virtual LLSD::Boolean	asBoolean() const	{ return mValue; }
 		virtual LLSD::Integer	asInteger() const	{ return mValue ? 1 : 0; }
@@ -189,6 +205,18 @@ namespace
 		virtual LLSD::String	asString() const;
 	};
 
+	ImplBoolean* sTrue = NULL;
+	ImplBoolean* sFalse = NULL;
+
+	LLSD::Impl* ImplBoolean::create(LLSD::Boolean v)
+	{
+		if (!sSharedImplsReady)
+		{
+			initShared();
+		}
+		return v ? sTrue : sFalse;
+	}
+
 	LLSD::String ImplBoolean::asString() const
 		// *NOTE: The reason that false is not converted to "false" is
 		// because that would break roundtripping,
@@ -203,6 +231,9 @@ namespace
 	{
 	public:
 		ImplInteger(LLSD::Integer v) : Base(v) { }
+		ImplInteger(LLSD::Integer v, StaticAllocationMarker m) : Base(v, m) { }
+		
+		static LLSD::Impl* create(LLSD::Integer v);
 		
 		virtual LLSD::Boolean	asBoolean() const	{ return mValue != 0; }
 		virtual LLSD::Integer	asInteger() const	{ return mValue; }
@@ -210,6 +241,25 @@ namespace
 		virtual LLSD::String	asString() const;
 	};
 
+	// Small integers are mostly flags, enums, counts and indexes, and
+	// every one of them used to cost an allocation.
+	const LLSD::Integer SHARED_INTEGER_MIN = -1;
+	const LLSD::Integer SHARED_INTEGER_MAX = 255;
+	ImplInteger* sSharedIntegers[SHARED_INTEGER_MAX - SHARED_INTEGER_MIN + 1];
+
+	LLSD::Impl* ImplInteger::create(LLSD::Integer v)
+	{
+		if (v < SHARED_INTEGER_MIN  ||  v > SHARED_INTEGER_MAX)
+		{
+			return new ImplInteger(v);
+		}
+		if (!sSharedImplsReady)
+		{
+			initShared();
+		}
+		return sSharedIntegers[v - SHARED_INTEGER_MIN];
+	}
+
 	LLSD::String ImplInteger::asString() const
 		{ return llformat("%d", mValue); }
 
@@ -219,6 +269,9 @@ namespace
 	{
 	public:
 		ImplReal(LLSD::Real v) : Base(v) { }
+		ImplReal(LLSD::Real v, StaticAllocationMarker m) : Base(v, m) { }
+		
+		static LLSD::Impl* create(LLSD::Real v);
 				
 		virtual LLSD::Boolean	asBoolean() const;
 		virtual LLSD::Integer	asInteger() const;
@@ -226,6 +279,23 @@ namespace
 		virtual LLSD::String	asString() const;
 	};
 
+	ImplReal* sZeroReal = NULL;
+
+	LLSD::Impl* ImplReal::create(LLSD::Real v)
+	{
+		// compare the bits, so -0.0 and NaNs keep their own impl
+		static const LLSD::Real ZERO = 0.0;
+		if (memcmp(&v, &ZERO, sizeof(LLSD::Real)))
+		{
+			return new ImplReal(v);
+		}
+		if (!sSharedImplsReady)
+		{
+			initShared();
+		}
+		return sZeroReal;
+	}
+
 	LLSD::Boolean ImplReal::asBoolean() const
 		{ return !llisnan(mValue)  &&  mValue != 0.0; }
 		
@@ -241,6 +311,9 @@ namespace
 	{
 	public:
 		ImplString(const LLSD::String& v) : Base(v) { }
+		ImplString(const LLSD::String& v, StaticAllocationMarker m) : Base(v, m) { }
+		
+		static LLSD::Impl* create(const LLSD::String& v);
 				
 		virtual LLSD::Boolean	asBoolean() const	{ return !mValue.empty(); }
 		virtual LLSD::Integer	asInteger() const;
@@ -251,6 +324,21 @@ namespace
 		virtual LLSD::URI		asURI() const	{ return LLURI(mValue); }
 	};
 	
+	ImplString* sEmptyString = NULL;
+
+	LLSD::Impl* ImplString::create(const LLSD::String& v)
+	{
+		if (!v.empty())
+		{
+			return new ImplString(v);
+		}
+		if (!sSharedImplsReady)
+		{
+			initShared();
+		}
+		return sEmptyString;
+	}
+
 	LLSD::Integer	ImplString::asInteger() const
 	{
 		// This must treat "1.23" not as an error, but as a number, which is
@@ -283,11 +371,29 @@ namespace
 	{
 	public:
 		ImplUUID(const LLSD::UUID& v) : Base(v) { }
+		ImplUUID(const LLSD::UUID& v, StaticAllocationMarker m) : Base(v, m) { }
+		
+		static LLSD::Impl* create(const LLSD::UUID& v);
 				
 		virtual LLSD::String	asString() const{ return mValue.asString(); }
 		virtual LLSD::UUID		asUUID() const	{ return mValue; }
 	};
 
+	ImplUUID* sNullUUID = NULL;
+
+	LLSD::Impl* ImplUUID::create(const LLSD::UUID& v)
+	{
+		if (v.notNull())
+		{
+			return new ImplUUID(v);
+		}
+		if (!sSharedImplsReady)
+		{
+			initShared();
+		}
+		return sNullUUID;
+	}
+
 
 	class ImplDate
 		: public ImplBase<LLSD::TypeDate, LLSD::Date, const LLSD::Date&>
@@ -407,6 +513,12 @@ namespace
 	
 	LLSD& ImplMap::ref(const LLSD::String& k)
 	{
+		// Maps are usually filled in key order, since that is how
+		// they are serialized, so try the end before searching.
+		if (mData.empty()  ||  mData.key_comp()(mData.rbegin()->first, k))
+		{
+			return mData.insert(mData.end(), DataMap::value_type(k, LLSD()))->second;
+		}
 		return mData[k];
 	}
 	
@@ -552,15 +664,19 @@ namespace
 	}
 }
 
+// *NOTE: Impls come straight from the heap.  A locked free-list for
+// them made no measurable difference to parsing large documents, since
+// the common small values are shared and the map nodes and strings
+// that make up the rest of the allocations aren't Impls.
 LLSD::Impl::Impl()
-	: mUseCount(0)
+	: mUseCount(0), mStatic(false)
 {
 	++sAllocationCount;
 	++sOutstandingCount;
 }
 
 LLSD::Impl::Impl(StaticAllocationMarker)
-	: mUseCount(0)
+	: mUseCount(0), mStatic(true)
 {
 }
 
@@ -571,8 +687,8 @@ LLSD::Impl::~Impl()
 
 void LLSD::Impl::reset(Impl*& var, Impl* impl)
 {
-	if (impl) ++impl->mUseCount;
-	if (var  &&  --var->mUseCount == 0)
+	if (impl  &&  !impl->mStatic) ++impl->mUseCount;
+	if (var  &&  !var->mStatic  &&  --var->mUseCount == 0)
 	{
 		delete var;
 	}
@@ -591,6 +707,33 @@ const LLSD::Impl& LLSD::Impl::safe(const Impl* impl)
 	return impl ? *impl : theUndefined;
 }
 
+void LLSD::Impl::initShared()
+{
+	if (sSharedImplsReady)
+	{
+		return;
+	}
+	sTrue = new ImplBoolean(true, STATIC);
+	sFalse = new ImplBoolean(false, STATIC);
+	for (LLSD::Integer i = SHARED_INTEGER_MIN; i <= SHARED_INTEGER_MAX; ++i)
+	{
+		sSharedIntegers[i - SHARED_INTEGER_MIN] = new ImplInteger(i, STATIC);
+	}
+	sZeroReal = new ImplReal(0.0, STATIC);
+	sEmptyString = new ImplString(LLSD::String(), STATIC);
+	// not LLUUID::null, which may not be constructed yet
+	sNullUUID = new ImplUUID(LLUUID(), STATIC);
+	sSharedImplsReady = true;
+}
+
+namespace
+{
+	struct SharedImplsInit
+	{
+		SharedImplsInit()	{ LLSD::Impl::initShared(); }
+	} sSharedImplsInit;
+}
+
 ImplMap& LLSD::Impl::makeMap(Impl*& var)
 {
 	ImplMap* im = new ImplMap;
@@ -618,27 +761,27 @@ void LLSD::Impl::assignUndefined(Impl*& var)
 
 void LLSD::Impl::assign(Impl*& var, LLSD::Boolean v)
 {
-	reset(var, new ImplBoolean(v));
+	reset(var, ImplBoolean::create(v));
 }
 
 void LLSD::Impl::assign(Impl*& var, LLSD::Integer v)
 {
-	reset(var, new ImplInteger(v));
+	reset(var, ImplInteger::create(v));
 }
 
 void LLSD::Impl::assign(Impl*& var, LLSD::Real v)
 {
-	reset(var, new ImplReal(v));
+	reset(var, ImplReal::create(v));
 }
 
 void LLSD::Impl::assign(Impl*& var, const LLSD::String& v)
 {
-	reset(var, new ImplString(v));
+	reset(var, ImplString::create(v));
 }
 
 void LLSD::Impl::assign(Impl*& var, const LLSD::UUID& v)
 {
-	reset(var, new ImplUUID(v));
+	reset(var, ImplUUID::create(v));
 }
 
 void LLSD::Impl::assign(Impl*& var, const LLSD::Date& v)
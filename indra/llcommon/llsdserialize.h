@@ -404,6 +404,109 @@ private:
 };
 
 
+/** 
+ * @class LLSDParseHandler
+ * @brief Receives a document from LLSDMemoryParser one value at a time.
+ *
+ * Derive from this to pull what you need out of a large document
+ * without building the whole LLSD tree. Maps arrive as startMap(),
+ * then a mapKey() before each value, then endMap(). Arrays arrive as
+ * startArray(), the values, then endArray(). Strings, uris, binary
+ * data and keys are passed as pointers which are only good for the
+ * duration of the call. Return false from any method to stop the
+ * parse, which then fails.
+ */
+class LL_COMMON_API LLSDParseHandler
+{
+public:
+	virtual ~LLSDParseHandler();
+
+	/**
+	 * @brief Called when a map starts.
+	 *
+	 * @param size The number of entries if the format says, otherwise -1.
+	 */
+	virtual bool startMap(S32 size) = 0;
+	virtual bool mapKey(const char* key, S32 length) = 0;
+	virtual bool endMap() = 0;
+
+	/**
+	 * @brief Called when an array starts.
+	 *
+	 * @param size The number of values if the format says, otherwise -1.
+	 */
+	virtual bool startArray(S32 size) = 0;
+	virtual bool endArray() = 0;
+
+	virtual bool undefinedValue() = 0;
+	virtual bool booleanValue(bool value) = 0;
+	virtual bool integerValue(S32 value) = 0;
+	virtual bool realValue(F64 value) = 0;
+	virtual bool uuidValue(const LLUUID& value) = 0;
+	virtual bool stringValue(const char* value, S32 length) = 0;
+	virtual bool dateValue(const LLDate& value) = 0;
+	virtual bool uriValue(const char* value, S32 length) = 0;
+	virtual bool binaryValue(const U8* value, S32 length) = 0;
+};
+
+/** 
+ * @class LLSDMemoryParser
+ * @brief Parses binary or notation LLSD straight out of a block of memory.
+ *
+ * This reads the same formats as LLSDBinaryParser and
+ * LLSDNotationParser, but walks a pointer through the bytes instead of
+ * pulling them off an istream one get() at a time. Since the end of
+ * the data is known, there is no separate byte limit to keep, and
+ * strings which need no unescaping are handed on without a copy.
+ * Use it whenever the whole document is already in memory.
+ */
+class LL_COMMON_API LLSDMemoryParser
+{
+public:
+	enum EFormat
+	{
+		FORMAT_BINARY,
+		FORMAT_NOTATION
+	};
+
+	LLSDMemoryParser(EFormat format);
+
+	/** 
+	 * @brief Parse one LLSD object out of data.
+	 *
+	 * @param data The start of the document.
+	 * @param size The number of bytes available at data.
+	 * @param sd[out] The newly parsed structured data. Undefined on failure.
+	 * @return Returns the number of LLSD objects parsed into sd, as
+	 * LLSDParser::parse() does. Returns LLSDParser::PARSE_FAILURE on
+	 * parse failure.
+	 */
+	S32 parse(const U8* data, S32 size, LLSD& sd);
+
+	/** 
+	 * @brief Parse one LLSD object out of data, passing each value to
+	 * handler rather than building an LLSD.
+	 *
+	 * @return Returns the same as the other parse().
+	 */
+	S32 parse(const U8* data, S32 size, LLSDParseHandler& handler);
+
+	/** 
+	 * @brief How many bytes the last parse read, so the caller can
+	 * carry on reading after it.
+	 */
+	S32 getBytesRead() const { return mBytesRead; }
+
+private:
+	EFormat mFormat;
+	S32 mBytesRead;
+
+	// Reused between parses for strings which need unescaping and
+	// binary data which needs decoding.
+	std::string mScratch;
+	std::vector<U8> mScratchBinary;
+};
+
 /** 
  * @class LLSDFormatter
  * @brief Abstract base class for formatting LLSD.
@@ -739,6 +842,11 @@ public:
 		(void)p->parse(str, sd, max_bytes);
 		return sd;
 	}
+	static S32 fromNotation(LLSD& sd, const U8* data, S32 size)
+	{
+		LLSDMemoryParser p(LLSDMemoryParser::FORMAT_NOTATION);
+		return p.parse(data, size, sd);
+	}
 	
 	/*
 	 * XML Methods
@@ -795,6 +903,11 @@ public:
 		(void)p->parse(str, sd, max_bytes);
 		return sd;
 	}
+	static S32 fromBinary(LLSD& sd, const U8* data, S32 size)
+	{
+		LLSDMemoryParser p(LLSDMemoryParser::FORMAT_BINARY);
+		return p.parse(data, size, sd);
+	}
 };
 
 #endif // LL_LLSDSERIALIZE_H
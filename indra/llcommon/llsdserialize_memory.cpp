@@ -0,0 +1,1047 @@
+/** 
+ * @file llsdserialize_memory.cpp
+ * @brief Implementation of the in-memory binary and notation LLSD parser.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#include "linden_common.h"
+#include "llsdserialize.h"
+
+#include <cctype>
+#include <cstdlib>
+#include "apr_base64.h"
+
+#include "llstring.h"
+
+/**
+ * LLSDParseHandler
+ */
+// virtual
+LLSDParseHandler::~LLSDParseHandler()
+{
+}
+
+namespace
+{
+	/**
+	 * A small direct mapped cache of the short strings seen in one
+	 * document. Documents repeat the same keys and many of the same
+	 * values over and over. Assigning a cached LLSD shares its impl
+	 * rather than allocating another, and copying a cached key shares
+	 * its buffer where std::string is reference counted.
+	 */
+	class LLSDStringCache
+	{
+	public:
+		enum
+		{
+			SLOTS = 256,		// must be a power of two
+			MAX_LENGTH = 64
+		};
+
+		struct Slot
+		{
+			Slot() : mUsed(false) {}
+			std::string mString;
+			LLSD mValue;
+			bool mUsed;
+		};
+
+		// Returns NULL for strings too long to be worth caching.
+		Slot* lookup(const char* value, S32 length, bool make_value)
+		{
+			if(length > MAX_LENGTH)
+			{
+				return NULL;
+			}
+			if(mSlots.empty())
+			{
+				mSlots.resize(SLOTS);
+			}
+
+			// FNV-1a
+			U32 hash = 2166136261U;
+			for(S32 i = 0; i < length; ++i)
+			{
+				hash = (hash ^ (U8)value[i]) * 16777619U;
+			}
+			Slot& slot = mSlots[hash & (SLOTS - 1)];
+			if(!slot.mUsed
+			   || (slot.mString.size() != (size_t)length)
+			   || memcmp(slot.mString.data(), value, length))
+			{
+				slot.mString.assign(value, length);
+				slot.mValue.clear();
+				slot.mUsed = true;
+			}
+			if(make_value && slot.mValue.isUndefined())
+			{
+				slot.mValue = slot.mString;
+			}
+			return &slot;
+		}
+
+	private:
+		std::vector<Slot> mSlots;
+	};
+
+	/**
+	 * Builds an LLSD tree out of the parse. It has the same methods as
+	 * LLSDParseHandler, but is used directly so the calls inline.
+	 */
+	class LLSDTreeBuilder
+	{
+	public:
+		LLSDTreeBuilder(LLSD& root) : mRoot(root), mKey(NULL) {}
+
+		bool startMap(S32 size)
+		{
+			LLSD& node = nextNode();
+			node = LLSD::emptyMap();
+			mStack.push_back(Frame(&node, true));
+			return true;
+		}
+
+		bool mapKey(const char* key, S32 length)
+		{
+			LLSDStringCache::Slot* slot = mKeys.lookup(key, length, false);
+			if(slot)
+			{
+				mKey = &slot->mString;
+			}
+			else
+			{
+				mLongKey.assign(key, length);
+				mKey = &mLongKey;
+			}
+			return true;
+		}
+
+		bool endMap()
+		{
+			mStack.pop_back();
+			return true;
+		}
+
+		bool startArray(S32 size)
+		{
+			LLSD& node = nextNode();
+			node = LLSD::emptyArray();
+			if(size > 0)
+			{
+				// size all of it up front rather than growing it a
+				// value at a time.
+				node[size - 1];
+			}
+			mStack.push_back(Frame(&node, false));
+			return true;
+		}
+
+		bool endArray()
+		{
+			mStack.pop_back();
+			return true;
+		}
+
+		bool undefinedValue()							{ nextNode().clear(); return true; }
+		bool booleanValue(bool value)					{ nextNode() = value; return true; }
+		bool integerValue(S32 value)					{ nextNode() = value; return true; }
+		bool realValue(F64 value)						{ nextNode() = value; return true; }
+		bool uuidValue(const LLUUID& value)				{ nextNode() = value; return true; }
+		bool dateValue(const LLDate& value)				{ nextNode() = value; return true; }
+
+		bool stringValue(const char* value, S32 length)
+		{
+			LLSDStringCache::Slot* slot = mValues.lookup(value, length, true);
+			if(slot)
+			{
+				nextNode() = slot->mValue;
+			}
+			else
+			{
+				nextNode() = LLSD::String(value, length);
+			}
+			return true;
+		}
+
+		bool uriValue(const char* value, S32 length)
+		{
+			nextNode() = LLURI(LLSD::String(value, length));
+			return true;
+		}
+
+		bool binaryValue(const U8* value, S32 length)
+		{
+			nextNode() = LLSD::Binary(value, value + length);
+			return true;
+		}
+
+	private:
+		struct Frame
+		{
+			Frame(LLSD* node, bool is_map) : mNode(node), mIsMap(is_map), mIndex(0) {}
+			LLSD* mNode;
+			bool mIsMap;
+			S32 mIndex;
+		};
+
+		// Values are written straight into their place in the tree.
+		// A container is never changed while one of its children is
+		// being filled in, so the pointers on the stack stay good.
+		LLSD& nextNode()
+		{
+			if(mStack.empty())
+			{
+				return mRoot;
+			}
+			Frame& top = mStack.back();
+			if(top.mIsMap)
+			{
+				return (*top.mNode)[*mKey];
+			}
+			return (*top.mNode)[top.mIndex++];
+		}
+
+		LLSD& mRoot;
+		std::vector<Frame> mStack;
+		const std::string* mKey;
+		std::string mLongKey;
+		LLSDStringCache mKeys;
+		LLSDStringCache mValues;
+	};
+
+	/**
+	 * Reads one LLSD object out of memory and passes it to a
+	 * handler. Handler is LLSDParseHandler or LLSDTreeBuilder.
+	 */
+	template<class Handler>
+	class LLSDMemoryReader
+	{
+	public:
+		LLSDMemoryReader(
+			const U8* data,
+			S32 size,
+			Handler& handler,
+			std::string& scratch,
+			std::vector<U8>& scratch_binary) :
+			mStart(data),
+			mPos(data),
+			mEnd(data + size),
+			mHandler(handler),
+			mScratch(scratch),
+			mScratchBinary(scratch_binary)
+		{
+		}
+
+		S32 parseBinary();
+		S32 parseNotation();
+		S32 bytesRead() const { return (S32)(mPos - mStart); }
+
+	private:
+		size_t left() const { return (size_t)(mEnd - mPos); }
+		bool readU32(U32& value);
+		bool readSize(S32& size);
+		bool readDelimited(U8 delim, const char*& value, S32& length);
+		bool readRawString(const char*& value, S32& length);
+		bool readNotationString(const char*& value, S32& length);
+		bool readNotationBinary(const U8*& value, S32& length);
+		bool readNotationBoolean(const char* compare);
+		bool readNumber(char* buf, size_t buf_size, const char* accept);
+		void skipSpace();
+
+		const U8* mStart;
+		const U8* mPos;
+		const U8* mEnd;
+		Handler& mHandler;
+		std::string& mScratch;
+		std::vector<U8>& mScratchBinary;
+	};
+
+	template<class Handler>
+	bool LLSDMemoryReader<Handler>::readU32(U32& value)
+	{
+		if(left() < 4)
+		{
+			return false;
+		}
+		value = ((U32)mPos[0] << 24) | ((U32)mPos[1] << 16)
+			| ((U32)mPos[2] << 8) | (U32)mPos[3];
+		mPos += 4;
+		return true;
+	}
+
+	// Reads a binary size and checks that at least that many bytes
+	// are left, which any well formed container or string needs.
+	template<class Handler>
+	bool LLSDMemoryReader<Handler>::readSize(S32& size)
+	{
+		U32 value = 0;
+		if(!readU32(value) || (value > left()))
+		{
+			return false;
+		}
+		size = (S32)value;
+		return true;
+	}
+
+	// Reads up to the unescaped delim and consumes it. When there is
+	// nothing to unescape value points into the data, otherwise into
+	// mScratch.
+	template<class Handler>
+	bool LLSDMemoryReader<Handler>::readDelimited(U8 delim, const char*& value, S32& length)
+	{
+		const U8* start = mPos;
+		while(mPos < mEnd && *mPos != delim && *mPos != '\\')
+		{
+			++mPos;
+		}
+		if(mPos >= mEnd)
+		{
+			return false;
+		}
+		if(*mPos == delim)
+		{
+			value = (const char*)start;
+			length = (S32)(mPos - start);
+			++mPos;
+			return true;
+		}
+
+		mScratch.assign((const char*)start, mPos - start);
+		while(mPos < mEnd)
+		{
+			U8 c = *mPos++;
+			if(c == delim)
+			{
+				value = mScratch.data();
+				length = (S32)mScratch.size();
+				return true;
+			}
+			if(c != '\\')
+			{
+				mScratch += (char)c;
+				continue;
+			}
+			if(mPos >= mEnd)
+			{
+				break;
+			}
+			c = *mPos++;
+			switch(c)
+			{
+			case 'a': mScratch += '\a'; break;
+			case 'b': mScratch += '\b'; break;
+			case 'f': mScratch += '\f'; break;
+			case 'n': mScratch += '\n'; break;
+			case 'r': mScratch += '\r'; break;
+			case 't': mScratch += '\t'; break;
+			case 'v': mScratch += '\v'; break;
+			case 'x':
+				if(left() < 2)
+				{
+					return false;
+				}
+				mScratch += (char)((hex_as_nybble(mPos[0]) << 4) | hex_as_nybble(mPos[1]));
+				mPos += 2;
+				break;
+			default: mScratch += (char)c; break;
+			}
+		}
+		return false;
+	}
+
+	// s(size)"raw data"
+	template<class Handler>
+	bool LLSDMemoryReader<Handler>::readRawString(const char*& value, S32& length)
+	{
+		const S32 MAX_SIZE_LEN = 20;
+		char buf[MAX_SIZE_LEN + 1];		/* Flawfinder: ignore */
+		S32 len = 0;
+		if(mPos >= mEnd || *mPos++ != '(')
+		{
+			return false;
+		}
+		while(mPos < mEnd && *mPos != ')' && len < MAX_SIZE_LEN)
+		{
+			buf[len++] = *mPos++;
+		}
+		buf[len] = '\0';
+		if(left() < 2 || *mPos != ')')
+		{
+			return false;
+		}
+		++mPos;
+		U8 quote = *mPos++;
+		S32 size = strtol(buf, NULL, 0);
+		if((quote != '"' && quote != '\'') || size < 0 || (size_t)size >= left())
+		{
+			return false;
+		}
+		value = (const char*)mPos;
+		length = size;
+		mPos += size;
+		quote = *mPos++;
+		return (quote == '"' || quote == '\'');
+	}
+
+	template<class Handler>
+	bool LLSDMemoryReader<Handler>::readNotationString(const char*& value, S32& length)
+	{
+		if(mPos >= mEnd)
+		{
+			return false;
+		}
+		U8 c = *mPos++;
+		switch(c)
+		{
+		case '"':
+		case '\'':
+			return readDelimited(c, value, length);
+		case 's':
+			return readRawString(value, length);
+		default:
+			return false;
+		}
+	}
+
+	// b(size)"raw data" | b64"base 64" | b16"base 16"
+	template<class Handler>
+	bool LLSDMemoryReader<Handler>::readNotationBinary(const U8*& value, S32& length)
+	{
+		if(left() >= 2 && mPos[1] == '(')
+		{
+			++mPos;
+			const char* raw = NULL;
+			if(!readRawString(raw, length))
+			{
+				return false;
+			}
+			value = (const U8*)raw;
+			return true;
+		}
+		if(left() < 4 || mPos[3] != '"')
+		{
+			return false;
+		}
+		bool base64 = (0 == strncmp((const char*)mPos, "b64", 3));
+		bool base16 = (0 == strncmp((const char*)mPos, "b16", 3));
+		if(!base64 && !base16)
+		{
+			return false;
+		}
+		mPos += 4;
+		const U8* start = mPos;
+		while(mPos < mEnd && *mPos != '"')
+		{
+			++mPos;
+		}
+		if(mPos >= mEnd)
+		{
+			return false;
+		}
+		std::string encoded((const char*)start, mPos - start);
+		++mPos;
+
+		mScratchBinary.clear();
+		if(base64)
+		{
+			S32 len = apr_base64_decode_len(encoded.c_str());
+			if(len > 0)
+			{
+				mScratchBinary.resize(len);
+				len = apr_base64_decode_binary(&mScratchBinary[0], encoded.c_str());
+				mScratchBinary.resize(len);
+			}
+		}
+		else
+		{
+			mScratchBinary.reserve(encoded.size() / 2);
+			for(size_t i = 0; i + 1 < encoded.size(); i += 2)
+			{
+				mScratchBinary.push_back((hex_as_nybble(encoded[i]) << 4) | hex_as_nybble(encoded[i + 1]));
+			}
+		}
+		value = mScratchBinary.empty() ? NULL : &mScratchBinary[0];
+		length = (S32)mScratchBinary.size();
+		return true;
+	}
+
+	// The t or f has been consumed. A bare letter is fine, otherwise
+	// the rest of the word has to match, in any case.
+	template<class Handler>
+	bool LLSDMemoryReader<Handler>::readNotationBoolean(const char* compare)
+	{
+		if(mPos >= mEnd || !isalpha(*mPos))
+		{
+			return true;
+		}
+		for(++compare; *compare; ++compare)
+		{
+			if(mPos >= mEnd || tolower(*mPos) != *compare)
+			{
+				return false;
+			}
+			++mPos;
+		}
+		return true;
+	}
+
+	// Copies the characters of a number into buf for strtol() or
+	// strtod(), which need a terminated string.
+	template<class Handler>
+	bool LLSDMemoryReader<Handler>::readNumber(char* buf, size_t buf_size, const char* accept)
+	{
+		skipSpace();
+		size_t len = 0;
+		while(mPos < mEnd && len < buf_size - 1 && strchr(accept, *mPos))
+		{
+			buf[len++] = *mPos++;
+		}
+		buf[len] = '\0';
+		return len > 0;
+	}
+
+	template<class Handler>
+	void LLSDMemoryReader<Handler>::skipSpace()
+	{
+		while(mPos < mEnd && isspace(*mPos))
+		{
+			++mPos;
+		}
+	}
+
+	template<class Handler>
+	S32 LLSDMemoryReader<Handler>::parseBinary()
+	{
+		if(mPos >= mEnd)
+		{
+			return 0;
+		}
+		S32 parse_count = 1;
+		U8 c = *mPos++;
+		switch(c)
+		{
+		case '{':
+		{
+			// an entry is at least a key marker and a value
+			S32 size = 0;
+			if(!readSize(size) || (size_t)size * 2 > left() || !mHandler.startMap(size))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			for(S32 i = 0; i < size; ++i)
+			{
+				if(mPos >= mEnd)
+				{
+					return LLSDParser::PARSE_FAILURE;
+				}
+				const char* key = NULL;
+				S32 length = 0;
+				c = *mPos++;
+				if(c == 'k')
+				{
+					if(!readSize(length))
+					{
+						return LLSDParser::PARSE_FAILURE;
+					}
+					key = (const char*)mPos;
+					mPos += length;
+				}
+				else if((c == '\'') || (c == '"'))
+				{
+					if(!readDelimited(c, key, length))
+					{
+						return LLSDParser::PARSE_FAILURE;
+					}
+				}
+				else
+				{
+					return LLSDParser::PARSE_FAILURE;
+				}
+				if(!mHandler.mapKey(key, length))
+				{
+					return LLSDParser::PARSE_FAILURE;
+				}
+				S32 child_count = parseBinary();
+				if(child_count <= 0)
+				{
+					// There must be a value for every key.
+					return LLSDParser::PARSE_FAILURE;
+				}
+				parse_count += child_count;
+			}
+			if(mPos >= mEnd || *mPos++ != '}' || !mHandler.endMap())
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case '[':
+		{
+			S32 size = 0;
+			if(!readSize(size) || !mHandler.startArray(size))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			for(S32 i = 0; i < size; ++i)
+			{
+				S32 child_count = parseBinary();
+				if(child_count <= 0)
+				{
+					return LLSDParser::PARSE_FAILURE;
+				}
+				parse_count += child_count;
+			}
+			if(mPos >= mEnd || *mPos++ != ']' || !mHandler.endArray())
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case '!':
+			if(!mHandler.undefinedValue()) return LLSDParser::PARSE_FAILURE;
+			break;
+
+		case '0':
+			if(!mHandler.booleanValue(false)) return LLSDParser::PARSE_FAILURE;
+			break;
+
+		case '1':
+			if(!mHandler.booleanValue(true)) return LLSDParser::PARSE_FAILURE;
+			break;
+
+		case 'i':
+		{
+			U32 value = 0;
+			if(!readU32(value) || !mHandler.integerValue((S32)value))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case 'r':
+		{
+			U32 high = 0;
+			U32 low = 0;
+			if(!readU32(high) || !readU32(low))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			U64 bits = ((U64)high << 32) | low;
+			F64 value;
+			memcpy(&value, &bits, sizeof(F64));		/* Flawfinder: ignore */
+			if(!mHandler.realValue(value))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case 'u':
+		{
+			if(left() < UUID_BYTES)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			LLUUID id;
+			memcpy(id.mData, mPos, UUID_BYTES);		/* Flawfinder: ignore */
+			mPos += UUID_BYTES;
+			if(!mHandler.uuidValue(id))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case '\'':
+		case '"':
+		{
+			const char* value = NULL;
+			S32 length = 0;
+			if(!readDelimited(c, value, length) || !mHandler.stringValue(value, length))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case 's':
+		case 'l':
+		case 'b':
+		{
+			S32 length = 0;
+			if(!readSize(length))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			const U8* value = mPos;
+			mPos += length;
+			bool ok;
+			if(c == 's')
+			{
+				ok = mHandler.stringValue((const char*)value, length);
+			}
+			else if(c == 'l')
+			{
+				ok = mHandler.uriValue((const char*)value, length);
+			}
+			else
+			{
+				ok = mHandler.binaryValue(value, length);
+			}
+			if(!ok)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case 'd':
+		{
+			// dates are written in host order
+			if(left() < sizeof(F64))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			F64 seconds;
+			memcpy(&seconds, mPos, sizeof(F64));		/* Flawfinder: ignore */
+			mPos += sizeof(F64);
+			if(!mHandler.dateValue(LLDate(seconds)))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		default:
+			llinfos << "Unrecognized character while parsing: int(" << (int)c
+				<< ")" << llendl;
+			parse_count = LLSDParser::PARSE_FAILURE;
+			break;
+		}
+		return parse_count;
+	}
+
+	template<class Handler>
+	S32 LLSDMemoryReader<Handler>::parseNotation()
+	{
+		// map: { string:object, string:object }
+		// array: [ object, object, object ]
+		// undef: !
+		// boolean: true | false | 1 | 0 | T | F | t | f | TRUE | FALSE
+		// integer: i####
+		// real: r####
+		// uuid: u####
+		// string: "g'day" | 'have a "nice" day' | s(size)"raw data"
+		// uri: l"escaped"
+		// date: d"YYYY-MM-DDTHH:MM:SS.FFZ"
+		// binary: b##"ff3120ab1" | b(size)"raw data"
+		skipSpace();
+		if(mPos >= mEnd)
+		{
+			return 0;
+		}
+		S32 parse_count = 1;
+		U8 c = *mPos;
+		switch(c)
+		{
+		case '{':
+		{
+			++mPos;
+			if(!mHandler.startMap(-1))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			while(true)
+			{
+				while(mPos < mEnd && (isspace(*mPos) || *mPos == ','))
+				{
+					++mPos;
+				}
+				if(mPos >= mEnd)
+				{
+					return LLSDParser::PARSE_FAILURE;
+				}
+				if(*mPos == '}')
+				{
+					++mPos;
+					break;
+				}
+				const char* key = NULL;
+				S32 length = 0;
+				if(!readNotationString(key, length) || !mHandler.mapKey(key, length))
+				{
+					return LLSDParser::PARSE_FAILURE;
+				}
+				while(mPos < mEnd && (isspace(*mPos) || *mPos == ':'))
+				{
+					++mPos;
+				}
+				S32 child_count = parseNotation();
+				if(child_count <= 0)
+				{
+					return LLSDParser::PARSE_FAILURE;
+				}
+				parse_count += child_count;
+			}
+			if(!mHandler.endMap())
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case '[':
+		{
+			++mPos;
+			if(!mHandler.startArray(-1))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			while(true)
+			{
+				while(mPos < mEnd && (isspace(*mPos) || *mPos == ','))
+				{
+					++mPos;
+				}
+				if(mPos >= mEnd)
+				{
+					return LLSDParser::PARSE_FAILURE;
+				}
+				if(*mPos == ']')
+				{
+					++mPos;
+					break;
+				}
+				S32 child_count = parseNotation();
+				if(child_count <= 0)
+				{
+					return LLSDParser::PARSE_FAILURE;
+				}
+				parse_count += child_count;
+			}
+			if(!mHandler.endArray())
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case '!':
+			++mPos;
+			if(!mHandler.undefinedValue()) return LLSDParser::PARSE_FAILURE;
+			break;
+
+		case '0':
+			++mPos;
+			if(!mHandler.booleanValue(false)) return LLSDParser::PARSE_FAILURE;
+			break;
+
+		case '1':
+			++mPos;
+			if(!mHandler.booleanValue(true)) return LLSDParser::PARSE_FAILURE;
+			break;
+
+		case 'F':
+		case 'f':
+			++mPos;
+			if(!readNotationBoolean("false") || !mHandler.booleanValue(false))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+
+		case 'T':
+		case 't':
+			++mPos;
+			if(!readNotationBoolean("true") || !mHandler.booleanValue(true))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+
+		case 'i':
+		{
+			++mPos;
+			char buf[32];		/* Flawfinder: ignore */
+			if(!readNumber(buf, sizeof(buf), "+-0123456789"))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			char* end = NULL;
+			S64 value = strtoll(buf, &end, 10);
+			if(*end != '\0' || value > S32_MAX || value < S32_MIN
+			   || !mHandler.integerValue((S32)value))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case 'r':
+		{
+			++mPos;
+			char buf[64];		/* Flawfinder: ignore */
+			if(!readNumber(buf, sizeof(buf), "+-.0123456789eE"))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			char* end = NULL;
+			F64 value = strtod(buf, &end);
+			if(*end != '\0' || !mHandler.realValue(value))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case 'u':
+		{
+			++mPos;
+			skipSpace();
+			if(left() < UUID_STR_LENGTH - 1)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			LLUUID id;
+			id.set(std::string((const char*)mPos, UUID_STR_LENGTH - 1));
+			mPos += UUID_STR_LENGTH - 1;
+			if(!mHandler.uuidValue(id))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case '"':
+		case '\'':
+		case 's':
+		{
+			const char* value = NULL;
+			S32 length = 0;
+			if(!readNotationString(value, length) || !mHandler.stringValue(value, length))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case 'l':
+		case 'd':
+		{
+			// the character after the l or d is the delimiter
+			if(left() < 2)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			U8 delim = mPos[1];
+			mPos += 2;
+			const char* value = NULL;
+			S32 length = 0;
+			if(!readDelimited(delim, value, length))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			bool ok = (c == 'l')
+				? mHandler.uriValue(value, length)
+				: mHandler.dateValue(LLDate(std::string(value, length)));
+			if(!ok)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case 'b':
+		{
+			const U8* value = NULL;
+			S32 length = 0;
+			if(!readNotationBinary(value, length) || !mHandler.binaryValue(value, length))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		default:
+			llinfos << "Unrecognized character while parsing: int(" << (int)c
+				<< ")" << llendl;
+			parse_count = LLSDParser::PARSE_FAILURE;
+			break;
+		}
+		return parse_count;
+	}
+
+	template<class Handler>
+	S32 read_memory(
+		LLSDMemoryParser::EFormat format,
+		const U8* data,
+		S32 size,
+		Handler& handler,
+		std::string& scratch,
+		std::vector<U8>& scratch_binary,
+		S32& bytes_read)
+	{
+		LLSDMemoryReader<Handler> reader(data, llmax(size, 0), handler, scratch, scratch_binary);
+		S32 parse_count = (LLSDMemoryParser::FORMAT_BINARY == format)
+			? reader.parseBinary()
+			: reader.parseNotation();
+		bytes_read = reader.bytesRead();
+		return parse_count;
+	}
+}
+
+/**
+ * LLSDMemoryParser
+ */
+LLSDMemoryParser::LLSDMemoryParser(EFormat format) :
+	mFormat(format),
+	mBytesRead(0)
+{
+}
+
+S32 LLSDMemoryParser::parse(const U8* data, S32 size, LLSD& sd)
+{
+	LLSDTreeBuilder builder(sd);
+	S32 parse_count = read_memory(mFormat, data, size, builder, mScratch, mScratchBinary, mBytesRead);
+	if(LLSDParser::PARSE_FAILURE == parse_count)
+	{
+		sd.clear();
+	}
+	return parse_count;
+}
+
+S32 LLSDMemoryParser::parse(const U8* data, S32 size, LLSDParseHandler& handler)
+{
+	return read_memory(mFormat, data, size, handler, mScratch, mScratchBinary, mBytesRead);
+}
@@ -53,6 +53,7 @@
 #	include <sys/sysctl.h>
 #	include <sys/utsname.h>
 #	include <stdint.h>
+#	include <unistd.h>
 #elif LL_LINUX
 #	include <errno.h>
 #	include <sys/utsname.h>
@@ -524,6 +525,15 @@ LLCPUInfo::LLCPUInfo()
 	mFamily.assign( info->strFamily );
 	mCPUString = "Unknown";
 
+#if LL_WINDOWS
+	SYSTEM_INFO sys_info;
+	GetSystemInfo(&sys_info);
+	mProcessorCount = (S32)sys_info.dwNumberOfProcessors;
+#else
+	mProcessorCount = (S32)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	mProcessorCount = llmax(mProcessorCount, 1);
+
 #if LL_WINDOWS || LL_DARWIN || LL_SOLARIS
 	out << proc.strCPUName;
 	if (200 < mCPUMhz && mCPUMhz < 10000)           // *NOTE: cpu speed is often way wrong, do a sanity check
@@ -601,6 +611,11 @@ S32 LLCPUInfo::getMhz() const
 	return mCPUMhz;
 }
 
+S32 LLCPUInfo::getProcessorCount() const
+{
+	return mProcessorCount;
+}
+
 std::string LLCPUInfo::getCPUString() const
 {
 	return mCPUString;
@@ -646,6 +661,7 @@ void LLCPUInfo::stream(std::ostream& s) const
 	s << "->mHasSSE2:    " << (U32)mHasSSE2 << std::endl;
 	s << "->mHasAltivec: " << (U32)mHasAltivec << std::endl;
 	s << "->mCPUMhz:     " << mCPUMhz << std::endl;
+	s << "->mProcessorCount: " << mProcessorCount << std::endl;
 	s << "->mCPUString:  " << mCPUString << std::endl;
 }
 
@@ -83,6 +83,7 @@ public:
 	bool hasSSE() const;
 	bool hasSSE2() const;
 	S32	 getMhz() const;
+	S32	 getProcessorCount() const;	// logical processors currently online
 
 	// Family is "AMD Duron" or "Intel Pentium Pro"
 	const std::string& getFamily() const { return mFamily; }
@@ -92,6 +93,7 @@ private:
 	bool mHasSSE2;
 	bool mHasAltivec;
 	S32 mCPUMhz;
+	S32 mProcessorCount;
 	std::string mFamily;
 	std::string mCPUString;
 };
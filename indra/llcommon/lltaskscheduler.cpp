@@ -0,0 +1,765 @@
+/** 
+ * @file lltaskscheduler.cpp
+ * @brief Work-stealing task scheduler shared by the queued threads.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+#include "lltaskscheduler.h"
+
+#include "llpointer.h"
+#include "llstl.h"
+#include "llsys.h"
+#include "lltimer.h"
+
+//============================================================================
+
+LLTaskScheduler* LLTaskScheduler::sInstance = NULL;
+
+//----------------------------------------------------------------------------
+
+// Runs tasks from its own deque, steals from the others when that is
+// empty and sleeps when there is nothing anywhere.
+class LLTaskScheduler::Worker : public LLThread
+{
+public:
+	Worker(LLTaskScheduler* owner, S32 index)
+		: LLThread(llformat("task%d", index)),
+		  mOwner(owner),
+		  mIndex(index),
+		  mThreadID(0)
+	{
+		start();
+	}
+
+	U32 getThreadID() { return mThreadID; }
+
+protected:
+	/*virtual*/ void run()
+	{
+		mThreadID = LLThread::currentID();
+		while (!mOwner->mQuitting)
+		{
+			bool stolen = false;
+			Task* task = mOwner->findTask(mIndex, stolen);
+			if (task)
+			{
+				mOwner->execute(task, mIndex, stolen);
+			}
+			else
+			{
+				mOwner->workerWait(mIndex);
+			}
+		}
+		llinfos << "LLTaskScheduler worker " << mIndex << " EXITING." << llendl;
+	}
+
+private:
+	LLTaskScheduler* mOwner;
+	S32 mIndex;
+	LLAtomicU32 mThreadID;
+};
+
+//----------------------------------------------------------------------------
+
+// The indices of one parallelFor().  Shared by the calling thread and
+// the helper tasks; a helper that only runs after the loop is over finds
+// nothing left to claim and never touches the body.
+class LLTaskScheduler::ParallelLoop
+{
+public:
+	ParallelLoop(S32 count, ParallelBody* body)
+		: mCount(count),
+		  mNext(0),
+		  mRemaining(count),
+		  mBody(body),
+		  mRef(0)
+	{
+	}
+
+	// Thread safe reference count, for LLPointer
+	void ref() { mRef++; }
+	void unref() { if (mRef-- == 0) delete this; }
+
+	// Runs indices until none are left to claim.
+	void work()
+	{
+		while (true)
+		{
+			S32 index = mNext++;
+			if (index >= mCount)
+			{
+				break;
+			}
+			mBody->run(index);
+			mRemaining--;
+		}
+	}
+
+	bool isDone() { return mRemaining == 0; }
+
+private:
+	const S32 mCount;
+	LLAtomicS32 mNext;
+	LLAtomicS32 mRemaining;
+	ParallelBody* mBody;
+	LLAtomicS32 mRef;
+};
+
+class LLTaskScheduler::ParallelTask : public Task
+{
+public:
+	ParallelTask(ParallelLoop* loop, U32 priority)
+		: Task(priority),
+		  mLoop(loop)
+	{
+	}
+
+protected:
+	/*virtual*/ void run()
+	{
+		mLoop->work();
+		mLoop = NULL;
+	}
+
+private:
+	LLPointer<ParallelLoop> mLoop;
+};
+
+// One chunk of a parallelRange() per index
+class LLTaskScheduler::RangeBody : public ParallelBody
+{
+public:
+	RangeBody(range_func_t func, void* context, S32 count, S32 chunk)
+		: mFunc(func),
+		  mContext(context),
+		  mCount(count),
+		  mChunk(chunk)
+	{
+	}
+
+	/*virtual*/ void run(S32 index)
+	{
+		S32 begin = index * mChunk;
+		mFunc(mContext, begin, llmin(begin + mChunk, mCount));
+	}
+
+private:
+	range_func_t mFunc;
+	void* mContext;
+	S32 mCount;
+	S32 mChunk;
+};
+
+//----------------------------------------------------------------------------
+
+LLTaskScheduler::Task::Task(U32 priority, U32 flags)
+	: mPriority(priority),
+	  mFlags(flags),
+	  mRef(0),
+	  mWaiting(1),
+	  mDone(0)
+{
+}
+
+LLTaskScheduler::Task::~Task()
+{
+	llassert(mContinuations.empty());
+}
+
+LLTaskScheduler::Stats::Stats()
+	: mRun(0),
+	  mStolen(0),
+	  mMainThread(0),
+	  mSleeps(0)
+{
+}
+
+LLTaskScheduler::Queues::Queues()
+	: mMask(0)
+{
+	mMutex = new LLMutex(NULL);
+}
+
+LLTaskScheduler::Queues::~Queues()
+{
+	delete mMutex;
+}
+
+//----------------------------------------------------------------------------
+
+// MAIN THREAD
+LLTaskScheduler::LLTaskScheduler(S32 num_threads)
+	: mMainThreadID(LLThread::currentID()),
+	  mNextQueue(0),
+	  mQueued(0),
+	  mSleeping(0),
+	  mQuitting(0),
+	  mNumDelayed(0),
+	  mRunCount(0),
+	  mStolenCount(0),
+	  mMainThreadCount(0),
+	  mSleepCount(0)
+{
+	mWorkCondition = new LLCondition(NULL);
+	mContinuationMutex = new LLMutex(NULL);
+	mDelayedMutex = new LLMutex(NULL);
+
+	num_threads = llclamp(num_threads, 1, (S32)MAX_THREADS);
+	for (S32 i = 0; i < num_threads; ++i)
+	{
+		mQueues.push_back(new Queues);
+	}
+	// The queues must all exist before the first worker looks for work
+	for (S32 i = 0; i < num_threads; ++i)
+	{
+		mWorkers.push_back(new Worker(this, i));
+	}
+	// LLThread::shutdown() does not wait for a thread that has not started
+	// running yet, so make sure they all have
+	for (S32 i = 0; i < num_threads; ++i)
+	{
+		while (!mWorkers[i]->getThreadID())
+		{
+			LLThread::yield();
+		}
+	}
+}
+
+// MAIN THREAD
+LLTaskScheduler::~LLTaskScheduler()
+{
+	mWorkCondition->lock();
+	mQuitting = 1;
+	mWorkCondition->broadcast();
+	mWorkCondition->unlock();
+
+	for (std::vector<Worker*>::iterator iter = mWorkers.begin();
+		 iter != mWorkers.end(); ++iter)
+	{
+		(*iter)->shutdown();
+	}
+	std::for_each(mWorkers.begin(), mWorkers.end(), DeletePointer());
+	mWorkers.clear();
+
+	// Whatever did not get to run is dropped, along with its continuations
+	S32 dropped = 0;
+	for (S32 band = 0; band < NUM_BANDS; ++band)
+	{
+		for (std::vector<Queues*>::iterator iter = mQueues.begin();
+			 iter != mQueues.end(); ++iter)
+		{
+			Task* task;
+			while ((task = popFront(**iter, band)))
+			{
+				discard(task);
+				++dropped;
+			}
+		}
+		Task* task;
+		while ((task = popFront(mMainQueues, band)))
+		{
+			discard(task);
+			++dropped;
+		}
+	}
+	for (std::vector<Delayed>::iterator iter = mDelayed.begin();
+		 iter != mDelayed.end(); ++iter)
+	{
+		discard(iter->mTask);
+		++dropped;
+	}
+	mDelayed.clear();
+	if (dropped)
+	{
+		llwarns << "~LLTaskScheduler() dropped " << dropped << " tasks" << llendl;
+	}
+
+	std::for_each(mQueues.begin(), mQueues.end(), DeletePointer());
+	mQueues.clear();
+	delete mDelayedMutex;
+	delete mContinuationMutex;
+	delete mWorkCondition;
+}
+
+//static
+void LLTaskScheduler::initClass(S32 num_threads)
+{
+	llassert(sInstance == NULL);
+	if (num_threads < 0)
+	{
+		return;
+	}
+	if (num_threads == 0)
+	{
+		// leave a core for the main thread
+		num_threads = llmax(gSysCPU.getProcessorCount() - 1, 1);
+	}
+	sInstance = new LLTaskScheduler(num_threads);
+	llinfos << "Task scheduler threads: " << sInstance->getNumThreads() << llendl;
+}
+
+//static
+void LLTaskScheduler::cleanupClass()
+{
+	delete sInstance;
+	sInstance = NULL;
+}
+
+//static
+S32 LLTaskScheduler::getBand(U32 priority)
+{
+	return (S32)((priority & LLQueuedThread::PRIORITY_HIGHBITS) >> 28);
+}
+
+//----------------------------------------------------------------------------
+// Any thread
+
+void LLTaskScheduler::submit(Task* task)
+{
+	task->ref();
+	release(task);
+}
+
+void LLTaskScheduler::submitDelayed(Task* task, U32 delay_ms)
+{
+	task->ref();
+	Delayed delayed;
+	delayed.mTime = totalTime() + (U64)delay_ms * 1000;
+	delayed.mTask = task;
+	{
+		LLMutexLock lock(mDelayedMutex);
+		mDelayed.push_back(delayed);
+		mNumDelayed++;
+	}
+	// Worker 0 keeps the time while there are delayed tasks
+	if (mSleeping > 0)
+	{
+		mWorkCondition->lock();
+		mWorkCondition->broadcast();
+		mWorkCondition->unlock();
+	}
+}
+
+void LLTaskScheduler::addContinuation(Task* task, Task* next)
+{
+	LLMutexLock lock(mContinuationMutex);
+	if (!task->mDone)
+	{
+		next->ref();
+		next->mWaiting++;
+		task->mContinuations.push_back(next);
+	}
+}
+
+void LLTaskScheduler::wait(Task* task)
+{
+	const bool main_thread = (LLThread::currentID() == mMainThreadID);
+	const S32 index = getWorkerIndex();
+	while (!task->isDone())
+	{
+		Task* other = main_thread ? popMainThreadTask() : NULL;
+		if (other)
+		{
+			other->run();
+			mMainThreadCount++;
+			finish(other);
+			continue;
+		}
+		bool stolen = false;
+		other = findTask(index, stolen);
+		if (other)
+		{
+			execute(other, index, stolen);
+			continue;
+		}
+		LLThread::yield();
+	}
+}
+
+void LLTaskScheduler::parallelFor(S32 count, ParallelBody& body, U32 priority)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	LLPointer<ParallelLoop> loop = new ParallelLoop(count, &body);
+	S32 helpers = llmin(getNumThreads(), count - 1);
+	for (S32 i = 0; i < helpers; ++i)
+	{
+		submit(new ParallelTask(loop, priority));
+	}
+	loop->work();
+	// the last indices may still be running on workers
+	while (!loop->isDone())
+	{
+		LLThread::yield();
+	}
+}
+
+//static
+void LLTaskScheduler::parallelRange(range_func_t func, void* context, S32 count, S32 min_count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	LLTaskScheduler* scheduler = sInstance;
+	if (!scheduler || count < llmax(min_count, 2))
+	{
+		func(context, 0, count);
+		return;
+	}
+	// A few chunks per thread so that uneven items balance out
+	S32 chunk = llmax(1, count / ((scheduler->getNumThreads() + 1) * 4));
+	RangeBody body(func, context, count, chunk);
+	scheduler->parallelFor((count + chunk - 1) / chunk, body);
+}
+
+S32 LLTaskScheduler::getPending()
+{
+	S32 res = llmax((S32)mQueued, 0);
+	LLMutexLock lock(mMainQueues.mMutex);
+	for (S32 band = 0; band < NUM_BANDS; ++band)
+	{
+		res += (S32)mMainQueues.mBands[band].size();
+	}
+	return res;
+}
+
+LLTaskScheduler::Stats LLTaskScheduler::getStats()
+{
+	Stats stats;
+	stats.mRun = mRunCount;
+	stats.mStolen = mStolenCount;
+	stats.mMainThread = mMainThreadCount;
+	stats.mSleeps = mSleepCount;
+	return stats;
+}
+
+void LLTaskScheduler::resetStats()
+{
+	mRunCount = 0;
+	mStolenCount = 0;
+	mMainThreadCount = 0;
+	mSleepCount = 0;
+}
+
+//----------------------------------------------------------------------------
+// MAIN THREAD
+
+S32 LLTaskScheduler::update(U32 max_time_ms)
+{
+	llassert(LLThread::currentID() == mMainThreadID);
+	F64 max_time = (F64)max_time_ms * .001;
+	LLTimer timer;
+	while (1)
+	{
+		Task* task = popMainThreadTask();
+		if (!task)
+		{
+			break;
+		}
+		task->run();
+		mMainThreadCount++;
+		finish(task);
+		if (max_time && timer.getElapsedTimeF64() > max_time)
+		{
+			break;
+		}
+	}
+	LLMutexLock lock(mMainQueues.mMutex);
+	S32 res = 0;
+	for (S32 band = 0; band < NUM_BANDS; ++band)
+	{
+		res += (S32)mMainQueues.mBands[band].size();
+	}
+	return res;
+}
+
+//----------------------------------------------------------------------------
+
+// A task with nothing left to wait for
+void LLTaskScheduler::enqueue(Task* task)
+{
+	if (task->mFlags & Task::FLAG_MAIN_THREAD)
+	{
+		push(mMainQueues, task);
+		return;
+	}
+
+	// Work spawned by a worker stays on it, the rest is spread out
+	S32 index = getWorkerIndex();
+	if (index < 0)
+	{
+		index = (S32)(mNextQueue++ % (U32)mQueues.size());
+	}
+	push(*mQueues[index], task);
+	mQueued++;
+
+	// A worker counts itself as sleeping before it checks mQueued, so
+	// either it sees this task or we see it and wake it.
+	if (mSleeping > 0)
+	{
+		mWorkCondition->lock();
+		mWorkCondition->signal();
+		mWorkCondition->unlock();
+	}
+}
+
+void LLTaskScheduler::release(Task* task)
+{
+	if (task->mWaiting-- == 0)
+	{
+		enqueue(task);
+	}
+}
+
+// After run(): queues the continuations and drops the scheduler's reference
+void LLTaskScheduler::finish(Task* task)
+{
+	std::vector<Task*> continuations;
+	{
+		LLMutexLock lock(mContinuationMutex);
+		task->mDone = 1;
+		continuations.swap(task->mContinuations);
+	}
+	for (std::vector<Task*>::iterator iter = continuations.begin();
+		 iter != continuations.end(); ++iter)
+	{
+		release(*iter);
+		(*iter)->unref();
+	}
+	task->unref();
+}
+
+// Drops a task that will never run, and its continuations.
+void LLTaskScheduler::discard(Task* task)
+{
+	std::vector<Task*> continuations;
+	{
+		LLMutexLock lock(mContinuationMutex);
+		continuations.swap(task->mContinuations);
+	}
+	std::for_each(continuations.begin(), continuations.end(), std::mem_fun(&Task::unref));
+	task->unref();
+}
+
+void LLTaskScheduler::execute(Task* task, S32 index, bool stolen)
+{
+	task->run();
+	mRunCount++;
+	if (stolen)
+	{
+		mStolenCount++;
+	}
+	finish(task);
+}
+
+// Highest band first.  Within a band a worker takes its newest task, which
+// is the one most likely to still be in its cache, and steals the oldest
+// task of another worker, which is the one least likely to be.
+LLTaskScheduler::Task* LLTaskScheduler::findTask(S32 index, bool& stolen)
+{
+	if (mNumDelayed > 0)
+	{
+		promoteDelayed();
+	}
+	if (mQueued <= 0)
+	{
+		return NULL;
+	}
+
+	const S32 count = (S32)mQueues.size();
+	U32 mask = 0;
+	for (S32 i = 0; i < count; ++i)
+	{
+		mask |= mQueues[i]->mMask;
+	}
+	for (S32 band = NUM_BANDS - 1; band >= 0; --band)
+	{
+		if (!(mask & (1 << band)))
+		{
+			continue;
+		}
+		if (index >= 0 && (mQueues[index]->mMask & (1 << band)))
+		{
+			Task* task = popBack(*mQueues[index], band);
+			if (task)
+			{
+				mQueued--;
+				stolen = false;
+				return task;
+			}
+		}
+		for (S32 i = 0; i < count; ++i)
+		{
+			S32 victim = (index + 1 + i) % count;
+			if (victim == index || !(mQueues[victim]->mMask & (1 << band)))
+			{
+				continue;
+			}
+			Task* task = popFront(*mQueues[victim], band);
+			if (task)
+			{
+				mQueued--;
+				stolen = (index >= 0);
+				return task;
+			}
+		}
+	}
+	return NULL;
+}
+
+LLTaskScheduler::Task* LLTaskScheduler::popMainThreadTask()
+{
+	U32 mask = mMainQueues.mMask;
+	for (S32 band = NUM_BANDS - 1; band >= 0; --band)
+	{
+		if (mask & (1 << band))
+		{
+			Task* task = popFront(mMainQueues, band);
+			if (task)
+			{
+				return task;
+			}
+		}
+	}
+	return NULL;
+}
+
+void LLTaskScheduler::promoteDelayed()
+{
+	std::vector<Task*> ready;
+	{
+		LLMutexLock lock(mDelayedMutex);
+		U64 now = totalTime();
+		for (std::vector<Delayed>::iterator iter = mDelayed.begin();
+			 iter != mDelayed.end(); )
+		{
+			if (iter->mTime <= now)
+			{
+				ready.push_back(iter->mTask);
+				iter = mDelayed.erase(iter);
+				mNumDelayed--;
+			}
+			else
+			{
+				++iter;
+			}
+		}
+	}
+	// submitDelayed() took the reference finish() drops
+	for (std::vector<Task*>::iterator iter = ready.begin();
+		 iter != ready.end(); ++iter)
+	{
+		release(*iter);
+	}
+}
+
+S32 LLTaskScheduler::getWorkerIndex()
+{
+	U32 id = LLThread::currentID();
+	for (S32 i = 0; i < (S32)mWorkers.size(); ++i)
+	{
+		if (mWorkers[i]->getThreadID() == id)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+// WORKER THREAD
+// Blocks until there may be work.  While tasks are delayed worker 0 wakes
+// up every millisecond to promote them.
+void LLTaskScheduler::workerWait(S32 index)
+{
+	mSleepCount++;
+	const bool keeps_time = (index == 0);
+	mWorkCondition->lock();
+	mSleeping++;
+	while (mQueued <= 0 && !mQuitting && !(keeps_time && mNumDelayed > 0))
+	{
+		mWorkCondition->wait();
+	}
+	mSleeping--;
+	mWorkCondition->unlock();
+	if (keeps_time && mQueued <= 0 && !mQuitting)
+	{
+		ms_sleep(1);
+	}
+}
+
+//static
+LLTaskScheduler::Task* LLTaskScheduler::popBack(Queues& queues, S32 band)
+{
+	Task* task = NULL;
+	LLMutexLock lock(queues.mMutex);
+	task_queue_t& queue = queues.mBands[band];
+	if (!queue.empty())
+	{
+		task = queue.back();
+		queue.pop_back();
+	}
+	if (queue.empty())
+	{
+		queues.mMask = queues.mMask & ~(1 << band);
+	}
+	return task;
+}
+
+//static
+LLTaskScheduler::Task* LLTaskScheduler::popFront(Queues& queues, S32 band)
+{
+	Task* task = NULL;
+	LLMutexLock lock(queues.mMutex);
+	task_queue_t& queue = queues.mBands[band];
+	if (!queue.empty())
+	{
+		task = queue.front();
+		queue.pop_front();
+	}
+	if (queue.empty())
+	{
+		queues.mMask = queues.mMask & ~(1 << band);
+	}
+	return task;
+}
+
+//static
+void LLTaskScheduler::push(Queues& queues, Task* task)
+{
+	S32 band = getBand(task->mPriority);
+	LLMutexLock lock(queues.mMutex);
+	queues.mBands[band].push_back(task);
+	queues.mMask = queues.mMask | (1 << band);
+}
@@ -0,0 +1,247 @@
+/** 
+ * @file lltaskscheduler.h
+ * @brief Work-stealing task scheduler shared by the queued threads.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#ifndef LL_LLTASKSCHEDULER_H
+#define LL_LLTASKSCHEDULER_H
+
+#include <deque>
+#include <vector>
+
+#include "llapr.h"
+#include "llthread.h"
+#include "llqueuedthread.h"
+
+// A pool of worker threads, one per core, that run small tasks.
+//
+// Each worker owns a deque of runnable tasks per priority band.  A worker
+// takes its own newest task first and, when it has nothing left in a band,
+// steals the oldest task in that band from another worker before looking
+// at a lower band.  Priorities are the LLQueuedThread::priority_t values;
+// only the high bits (PRIORITY_HIGHBITS) choose the band.
+//
+// A task may have continuations: tasks that are only queued once it (and
+// any other task they were chained to) has run.  Tasks flagged
+// FLAG_MAIN_THREAD are never run by a worker; they wait for update() on
+// the main thread, which makes them the way to hand results back to code
+// that is not thread safe.
+//
+// Threaded LLQueuedThreads created while LLTaskScheduler::getInstance()
+// is set run their requests as tasks here instead of starting a thread
+// of their own, see LLQueuedThread.
+class LL_COMMON_API LLTaskScheduler
+{
+public:
+	class LL_COMMON_API Task
+	{
+		friend class LLTaskScheduler;
+	public:
+		enum flags_t {
+			FLAG_MAIN_THREAD = 1	// run from update() on the main thread
+		};
+
+		Task(U32 priority = LLQueuedThread::PRIORITY_NORMAL, U32 flags = 0);
+
+		U32 getPriority() const { return mPriority; }
+		U32 getFlags() const { return mFlags; }
+		// True once run() has returned.
+		bool isDone() { return mDone != 0; }
+
+		// Thread safe reference count, for LLPointer
+		void ref() { mRef++; }
+		void unref() { if (mRef-- == 0) delete this; }
+
+	protected:
+		virtual ~Task(); // use unref()
+
+		// Does the work.  Called exactly once.
+		virtual void run() = 0;
+
+	private:
+		// No copy constructor or copy assignment
+		Task(const Task&);
+		Task& operator=(const Task&);
+
+		U32 mPriority;
+		U32 mFlags;
+		LLAtomicS32 mRef;
+		LLAtomicS32 mWaiting;	// one for submit() plus one per unfinished predecessor
+		LLAtomicU32 mDone;
+		std::vector<Task*> mContinuations; // guarded by LLTaskScheduler::mContinuationMutex
+	};
+
+	// The work of a parallelFor(), one call per index.
+	class LL_COMMON_API ParallelBody
+	{
+	public:
+		virtual ~ParallelBody() {}
+		virtual void run(S32 index) = 0;
+	};
+
+	// Counters for tuning and the benchmarks.
+	struct Stats
+	{
+		Stats();
+		U32 mRun;				// tasks run by workers
+		U32 mStolen;			// of those, taken from another worker's deque
+		U32 mMainThread;		// tasks run by update()
+		U32 mSleeps;			// times a worker went idle
+	};
+
+	enum { MAX_THREADS = 16 };
+
+	// num_threads is clamped to [1, MAX_THREADS].  Must be created and
+	// destroyed on the main thread.
+	LLTaskScheduler(S32 num_threads);
+	~LLTaskScheduler();
+
+	// num_threads 0 sizes the pool from the processor count, leaving one
+	// core for the main thread.  Negative means no scheduler: queued
+	// threads then start threads of their own as before.
+	static void initClass(S32 num_threads = 0);
+	static void cleanupClass();
+	static LLTaskScheduler* getInstance() { return sInstance; }
+
+	// Queues a task once every task it was chained to has run.  The
+	// scheduler holds a reference until the task has run.  Any thread.
+	void submit(Task* task);
+	// Same, but not before delay_ms have passed.  Meant for polling
+	// (a queue waiting on the network) without keeping a worker busy.
+	void submitDelayed(Task* task, U32 delay_ms);
+	// next will not be queued before task has run.  Call before
+	// submit(next).  A task may be chained to several others and may have
+	// several continuations.  Any thread.
+	void addContinuation(Task* task, Task* next);
+
+	// Runs other tasks until task is done.  On the main thread this also
+	// runs FLAG_MAIN_THREAD tasks.  Any thread.
+	void wait(Task* task);
+
+	// Calls body.run(i) for every i in [0, count) on the workers and the
+	// calling thread, and returns once all of them have returned.  Unlike
+	// wait(), the caller only works on this loop, so no FLAG_MAIN_THREAD
+	// task or unrelated request runs on it in the meantime.  Any thread.
+	void parallelFor(S32 count, ParallelBody& body, U32 priority = LLQueuedThread::PRIORITY_HIGH);
+
+	// Runs func(context, begin, end) over [0, count) in a few chunks per
+	// thread with parallelFor() on getInstance().  Without a scheduler, or
+	// for fewer than min_count items, it is a single call on the calling
+	// thread.  For kernels that want a range rather than one index at a
+	// time (image rows, terrain patches).  Any thread.
+	typedef void (*range_func_t)(void* context, S32 begin, S32 end);
+	static void parallelRange(range_func_t func, void* context, S32 count, S32 min_count = 2);
+
+	// MAIN THREAD.  Runs FLAG_MAIN_THREAD tasks until none are left or
+	// max_time_ms has passed (0 for no limit).  Returns the number left.
+	S32 update(U32 max_time_ms = 0);
+
+	S32 getNumThreads() const { return (S32)mWorkers.size(); }
+	// Tasks queued for the workers or the main thread, not counting
+	// delayed or running tasks.
+	S32 getPending();
+	Stats getStats();
+	void resetStats();
+
+	// Maps a priority to a band, higher is more urgent.
+	static S32 getBand(U32 priority);
+	enum { NUM_BANDS = 8 };
+
+private:
+	class Worker;
+	friend class Worker;
+	class ParallelLoop;
+	class ParallelTask;
+	class RangeBody;
+
+	typedef std::deque<Task*> task_queue_t;
+	struct Queues
+	{
+		Queues();
+		~Queues();
+		LLMutex* mMutex;
+		task_queue_t mBands[NUM_BANDS];
+		LLAtomicU32 mMask;	// bit per non-empty band, read without the lock
+	};
+
+	struct Delayed
+	{
+		U64 mTime;
+		Task* mTask;
+	};
+
+	// No copy constructor or copy assignment
+	LLTaskScheduler(const LLTaskScheduler&);
+	LLTaskScheduler& operator=(const LLTaskScheduler&);
+
+	void enqueue(Task* task);
+	void release(Task* task);
+	void finish(Task* task);
+	void execute(Task* task, S32 index, bool stolen);
+	// Pops the next task for worker index, or any worker if index < 0.
+	Task* findTask(S32 index, bool& stolen);
+	Task* popMainThreadTask();
+	void promoteDelayed();
+	S32 getWorkerIndex();
+	void workerWait(S32 index);
+	void discard(Task* task);
+
+	static Task* popBack(Queues& queues, S32 band);
+	static Task* popFront(Queues& queues, S32 band);
+	static void push(Queues& queues, Task* task);
+
+	static LLTaskScheduler* sInstance;
+
+	std::vector<Worker*> mWorkers;
+	std::vector<Queues*> mQueues;	// one per worker
+	Queues mMainQueues;
+	U32 mMainThreadID;
+
+	LLAtomicU32 mNextQueue;			// round robin for tasks submitted off the workers
+	LLAtomicS32 mQueued;			// tasks in the worker deques
+	LLAtomicS32 mSleeping;			// workers waiting on mWorkCondition
+	LLCondition* mWorkCondition;
+	LLAtomicU32 mQuitting;
+
+	LLMutex* mContinuationMutex;
+
+	LLMutex* mDelayedMutex;
+	std::vector<Delayed> mDelayed;
+	LLAtomicS32 mNumDelayed;
+
+	LLAtomicU32 mRunCount;
+	LLAtomicU32 mStolenCount;
+	LLAtomicU32 mMainThreadCount;
+	LLAtomicU32 mSleepCount;
+};
+
+#endif // LL_LLTASKSCHEDULER_H
@@ -38,6 +38,7 @@
 #include "llthread.h"
 
 #include "lltimer.h"
+#include "lltracerecorder.h"
 
 #if LL_LINUX || LL_SOLARIS
 #include <sched.h>
@@ -73,9 +74,14 @@ void *APR_THREAD_FUNC LLThread::staticRun(apr_thread_t *apr_threadp, void *datap
 	// Set thread state to running
 	threadp->mStatus = RUNNING;
 
+	// Name the thread's timers in traces
+	LLTraceRecorder::registerThread(threadp->mName);
+
 	// Run the user supplied function
 	threadp->run();
 
+	LLTraceRecorder::unregisterThread();
+
 	llinfos << "LLThread::staticRun() Exiting: " << threadp->mName << llendl;
 	
 	// We're done with the run function, this thread is done executing now.
@@ -159,11 +165,14 @@ void LLThread::shutdown()
 		mAPRThreadp = NULL;
 	}
 
+	// shutdown() may be called again from ~LLThread()
 	delete mRunCondition;
+	mRunCondition = NULL;
 	
-	if (mIsLocalPool)
+	if (mIsLocalPool && mAPRPoolp)
 	{
 		apr_pool_destroy(mAPRPoolp);
+		mAPRPoolp = NULL;
 	}
 }
 
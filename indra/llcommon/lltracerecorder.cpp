@@ -0,0 +1,854 @@
+/** 
+ * @file lltracerecorder.cpp
+ * @brief Per-thread timer stacks and a binary timeline trace recorder
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "lltracerecorder.h"
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "llapr.h"
+#include "llfile.h"
+#include "llthread.h"
+#include "lltimer.h"
+
+// Trace file format.  Numbers are little endian.
+//
+//   header  "LLTRACE1", F64 clock counts per second
+//   'T'     U32 timer id, U16 length, name
+//   'H'     U32 thread index, U16 length, name
+//   'B'     U32 thread index, U32 count, then count events of
+//           U64 clock count, U32 timer id, U8 event type
+//
+// Records follow each other to the end of the file.  Events of one thread
+// are in order; 'T' records for timers created while recording come last.
+
+namespace
+{
+	const char TRACE_MAGIC[] = "LLTRACE1";
+	const U32 TRACE_MAGIC_LENGTH = 8;
+	const U32 EVENTS_PER_BLOCK = 512;
+	const U32 MAX_NAME_LENGTH = 0xffff;
+
+	struct TraceEvent
+	{
+		U64 mTime;
+		U32 mTimerID;
+		U32 mType;
+	};
+
+	struct ThreadEvent
+	{
+		U32 mThread;
+		TraceEvent mEvent;
+	};
+
+	// Function static so that named timers can register during static
+	// initialization.
+	std::vector<std::string>& timer_names()
+	{
+		static std::vector<std::string> names;
+		return names;
+	}
+
+	void write_u8(std::ostream& os, U8 value)
+	{
+		os.put((char)value);
+	}
+
+	void write_u16(std::ostream& os, U16 value)
+	{
+		write_u8(os, (U8)value);
+		write_u8(os, (U8)(value >> 8));
+	}
+
+	void write_u32(std::ostream& os, U32 value)
+	{
+		write_u16(os, (U16)value);
+		write_u16(os, (U16)(value >> 16));
+	}
+
+	void write_u64(std::ostream& os, U64 value)
+	{
+		write_u32(os, (U32)value);
+		write_u32(os, (U32)(value >> 32));
+	}
+
+	void write_name(std::ostream& os, char tag, U32 id, const std::string& name)
+	{
+		U16 length = (U16)llmin((U32)name.size(), MAX_NAME_LENGTH);
+		write_u8(os, (U8)tag);
+		write_u32(os, id);
+		write_u16(os, length);
+		os.write(name.data(), length);
+	}
+
+	bool read_bytes(std::istream& is, U8* bytes, S32 count)
+	{
+		is.read((char*)bytes, count);
+		return is.gcount() == count;
+	}
+
+	bool read_u16(std::istream& is, U16& value)
+	{
+		U8 bytes[2];
+		if (!read_bytes(is, bytes, 2)) return false;
+		value = (U16)(bytes[0] | (bytes[1] << 8));
+		return true;
+	}
+
+	bool read_u32(std::istream& is, U32& value)
+	{
+		U8 bytes[4];
+		if (!read_bytes(is, bytes, 4)) return false;
+		value = (U32)bytes[0] | ((U32)bytes[1] << 8) | ((U32)bytes[2] << 16) | ((U32)bytes[3] << 24);
+		return true;
+	}
+
+	bool read_u64(std::istream& is, U64& value)
+	{
+		U32 low, high;
+		if (!read_u32(is, low) || !read_u32(is, high)) return false;
+		value = ((U64)high << 32) | low;
+		return true;
+	}
+
+	bool read_name(std::istream& is, U32& id, std::string& name)
+	{
+		U16 length;
+		if (!read_u32(is, id) || !read_u16(is, length)) return false;
+		name.resize(length);
+		return length == 0 || read_bytes(is, (U8*)&name[0], length);
+	}
+
+	void write_json_string(std::ostream& os, const std::string& str)
+	{
+		os << '"';
+		for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+		{
+			char c = *it;
+			if (c == '"' || c == '\\')
+			{
+				os << '\\' << c;
+			}
+			else if ((U8)c < 0x20)
+			{
+				static const char HEX[] = "0123456789abcdef";
+				os << "\\u00" << HEX[(c >> 4) & 0xf] << HEX[c & 0xf];
+			}
+			else
+			{
+				os << c;
+			}
+		}
+		os << '"';
+	}
+}
+
+//----------------------------------------------------------------------------
+
+class LLTraceRecorder::ThreadData
+{
+public:
+	ThreadData(U32 thread_id, const std::string& name)
+	:	mThreadID(thread_id),
+		mName(name),
+		mNextRetired(NULL),
+		mEvents(NULL),
+		mDepth(0)
+	{
+		mExited = 0;
+		mHead = 0;
+		mTail = 0;
+		mDropped = 0;
+		for (S32 i = 0; i < MAX_TIMERS; ++i)
+		{
+			mSelfTime[i] = 0;
+			mCalls[i] = 0;
+			mLastSelfTime[i] = 0;
+			mLastCalls[i] = 0;
+		}
+	}
+
+	// OWNING THREAD
+	void record(U32 type, U32 timer_id, U64 time)
+	{
+		if (!mEvents)
+		{
+			// only threads that record while a trace is on pay for a ring
+			mEvents = new TraceEvent[RING_SIZE];
+		}
+		U32 head = mHead;
+		if (head - (U32)mTail >= (U32)RING_SIZE)
+		{
+			// the writer fell behind, drop rather than wait for it
+			mDropped++;
+			return;
+		}
+		TraceEvent& event = mEvents[head & (RING_SIZE - 1)];
+		event.mTime = time;
+		event.mTimerID = timer_id;
+		event.mType = type;
+		mHead++;	// publishes the event
+	}
+
+	struct StackEntry
+	{
+		U32 mTimerID;
+		U64 mStart;
+		U64 mChildTime;
+	};
+
+	const U32 mThreadID;
+	const std::string mName;
+
+	// Set once the owning thread has exited, see unregisterThread().
+	LLAtomicU32 mExited;
+	ThreadData* mNextRetired;
+
+	// Event ring, single producer (the owning thread) and single consumer
+	// (the writer thread).  mHead is only written by the owner, mTail only
+	// by the writer.
+	TraceEvent* mEvents;
+	LLAtomicU32 mHead;
+	LLAtomicU32 mTail;
+	LLAtomicU32 mDropped;
+
+	// Timer stack, owning thread only.  mDepth keeps counting past
+	// MAX_DEPTH so that pushes and pops stay paired.
+	StackEntry mStack[MAX_DEPTH];
+	S32 mDepth;
+
+	// Clock counts and calls per timer id.  Written by the owning thread
+	// only, so the atomics just make the reads from dumpThreadTimes()
+	// clean.  They wrap, only differences are meaningful.
+	LLAtomicU32 mSelfTime[MAX_TIMERS];
+	LLAtomicU32 mCalls[MAX_TIMERS];
+	// Values at the last dumpThreadTimes(), main thread only.
+	U32 mLastSelfTime[MAX_TIMERS];
+	U32 mLastCalls[MAX_TIMERS];
+};
+
+//----------------------------------------------------------------------------
+
+namespace
+{
+	// Slots are claimed with an atomic increment and published with a
+	// compare and swap, so lookups never lock.  The slot of a thread that
+	// has exited is taken over by swapping in a new entry, once the writer
+	// has its events.  Entries are never freed, since other threads may
+	// still be looking at one they found in sThreads; retired ones only
+	// lose their event ring, see free_retired_events().
+	LLTraceRecorder::ThreadData* volatile sThreads[LLTraceRecorder::MAX_THREADS];
+	LLAtomicU32 sNumThreads;
+	LLTraceRecorder::ThreadData* volatile sRetiredThreads = NULL;
+
+	U32 num_thread_slots()
+	{
+		return llmin((U32)sNumThreads, (U32)LLTraceRecorder::MAX_THREADS);
+	}
+
+	LLTraceRecorder::ThreadData* find_thread(U32 thread_id)
+	{
+		// newest first: when the OS reuses an id, the newest entry is the
+		// live thread
+		for (U32 i = num_thread_slots(); i-- > 0; )
+		{
+			LLTraceRecorder::ThreadData* data = sThreads[i];
+			if (data && data->mThreadID == thread_id && !data->mExited)
+			{
+				return data;
+			}
+		}
+		return NULL;
+	}
+
+	void retire_thread(LLTraceRecorder::ThreadData* data)
+	{
+		LLTraceRecorder::ThreadData* head;
+		do
+		{
+			head = sRetiredThreads;
+			data->mNextRetired = head;
+		}
+		while (apr_atomic_casptr((volatile void**)&sRetiredThreads, data, head) != head);
+	}
+
+	// MAIN THREAD, while the writer is not running
+	void free_retired_events()
+	{
+		for (LLTraceRecorder::ThreadData* data = sRetiredThreads; data; data = data->mNextRetired)
+		{
+			delete[] data->mEvents;
+			data->mEvents = NULL;
+		}
+	}
+
+	LLTraceRecorder::ThreadData* add_thread(U32 thread_id, const std::string& name)
+	{
+		for (U32 i = 0; i < num_thread_slots(); ++i)
+		{
+			LLTraceRecorder::ThreadData* old = sThreads[i];
+			if (old && old->mExited
+				&& (!LLTraceRecorder::isRecording() || (U32)old->mHead == (U32)old->mTail))
+			{
+				LLTraceRecorder::ThreadData* data = new LLTraceRecorder::ThreadData(thread_id, name);
+				if (apr_atomic_casptr((volatile void**)&sThreads[i], data, old) == old)
+				{
+					retire_thread(old);
+					return data;
+				}
+				delete data;	// another thread took it
+			}
+		}
+
+		U32 slot = sNumThreads++;
+		if (slot >= LLTraceRecorder::MAX_THREADS)
+		{
+			static bool warned = false;
+			if (!warned)
+			{
+				warned = true;
+				llwarns << "Out of trace thread slots, not timing thread " << name << llendl;
+			}
+			return NULL;
+		}
+		LLTraceRecorder::ThreadData* data = new LLTraceRecorder::ThreadData(thread_id, name);
+		apr_atomic_casptr((volatile void**)&sThreads[slot], data, NULL);
+		return data;
+	}
+}
+
+//----------------------------------------------------------------------------
+
+class LLTraceRecorder::WriterThread : public LLThread
+{
+public:
+	WriterThread(llofstream* stream, U32 timers_written)
+	:	LLThread("trace writer"),
+		mStream(stream),
+		mTimersWritten(timers_written),
+		mNamedThreads(MAX_THREADS, NULL),
+		mTraceIDs(MAX_THREADS, 0),
+		mNextTraceID(0)
+	{
+	}
+
+	~WriterThread()
+	{
+		delete mStream;
+	}
+
+	/*virtual*/ void run()
+	{
+		while (!isQuitting())
+		{
+			drain();
+			ms_sleep(32);
+		}
+		drain();
+	}
+
+	// MAIN THREAD, once run() has returned.  Names timers created while
+	// recording and closes the file.
+	void finish()
+	{
+		U32 num_timers = getNumTimers();
+		for (U32 id = mTimersWritten; id < num_timers; ++id)
+		{
+			write_name(*mStream, 'T', id, getTimerName(id));
+		}
+		mStream->close();
+
+		for (U32 i = 0; i < num_thread_slots(); ++i)
+		{
+			ThreadData* data = sThreads[i];
+			U32 dropped = data ? (U32)data->mDropped : 0;
+			if (dropped)
+			{
+				llwarns << "Trace dropped " << dropped << " events from thread " << data->mName << llendl;
+				data->mDropped = 0;
+			}
+		}
+	}
+
+private:
+	void drain()
+	{
+		for (U32 i = 0; i < num_thread_slots(); ++i)
+		{
+			ThreadData* data = sThreads[i];
+			if (!data)
+			{
+				continue;	// claimed but not published yet
+			}
+			U32 head = data->mHead;
+			U32 tail = data->mTail;
+			if (tail != head && mNamedThreads[i] != data)
+			{
+				// a new thread, or one that took over the slot
+				mNamedThreads[i] = data;
+				mTraceIDs[i] = mNextTraceID++;
+				write_name(*mStream, 'H', mTraceIDs[i], data->mName);
+			}
+			while (tail != head)
+			{
+				U32 count = llmin(head - tail, EVENTS_PER_BLOCK);
+				write_u8(*mStream, 'B');
+				write_u32(*mStream, mTraceIDs[i]);
+				write_u32(*mStream, count);
+				for (U32 n = 0; n < count; ++n)
+				{
+					const TraceEvent& event = data->mEvents[(tail + n) & (RING_SIZE - 1)];
+					write_u64(*mStream, event.mTime);
+					write_u32(*mStream, event.mTimerID);
+					write_u8(*mStream, (U8)event.mType);
+				}
+				tail += count;
+				data->mTail += count;	// hands the slots back to the producer
+			}
+		}
+		mStream->flush();
+	}
+
+	llofstream* mStream;
+	U32 mTimersWritten;
+	// Entries are never freed, so a slot holding a different pointer
+	// always means a different thread.
+	std::vector<ThreadData*> mNamedThreads;
+	std::vector<U32> mTraceIDs;
+	U32 mNextTraceID;
+};
+
+//----------------------------------------------------------------------------
+
+bool LLTraceRecorder::sRecording = false;
+LLTraceRecorder::ThreadData* LLTraceRecorder::sMainThreadData = NULL;
+LLTraceRecorder::WriterThread* LLTraceRecorder::sWriterThread = NULL;
+
+//static
+U32 LLTraceRecorder::registerTimer(const std::string& name)
+{
+	std::vector<std::string>& names = timer_names();
+	if (names.size() >= MAX_TIMERS)
+	{
+		// share the last id rather than overrun the per-thread totals
+		return MAX_TIMERS - 1;
+	}
+	names.push_back(name);
+	return names.size() - 1;
+}
+
+//static
+const std::string& LLTraceRecorder::getTimerName(U32 timer_id)
+{
+	std::vector<std::string>& names = timer_names();
+	return timer_id < names.size() ? names[timer_id] : LLStringUtil::null;
+}
+
+//static
+U32 LLTraceRecorder::getNumTimers()
+{
+	return timer_names().size();
+}
+
+//static
+void LLTraceRecorder::registerThread(const std::string& name)
+{
+	U32 thread_id = LLThread::currentID();
+	ThreadData* data = find_thread(thread_id);
+	if (!data || data->mName != name)
+	{
+		if (data && data != sMainThreadData)
+		{
+			// an unnamed entry, or one left by an exited thread that had
+			// the same id
+			data->mExited = 1;
+		}
+		add_thread(thread_id, name);
+	}
+}
+
+//static
+void LLTraceRecorder::unregisterThread()
+{
+	ThreadData* data = find_thread(LLThread::currentID());
+	if (data && data != sMainThreadData)
+	{
+		data->mExited = 1;
+	}
+}
+
+//static
+LLTraceRecorder::ThreadData* LLTraceRecorder::getThreadData()
+{
+	U32 thread_id = LLThread::currentID();
+	ThreadData* data = find_thread(thread_id);
+	return data ? data : add_thread(thread_id, LLStringUtil::null);
+}
+
+//static
+bool LLTraceRecorder::startRecording(const std::string& filename)
+{
+	if (sWriterThread)
+	{
+		stopRecording();
+	}
+
+	llofstream* stream = new llofstream(filename, std::ios::out | std::ios::binary);
+	if (!stream->is_open())
+	{
+		llwarns << "Unable to open trace file " << filename << llendl;
+		delete stream;
+		return false;
+	}
+
+	U32 thread_id = LLThread::currentID();
+	sMainThreadData = find_thread(thread_id);
+	if (!sMainThreadData)
+	{
+		sMainThreadData = add_thread(thread_id, "main");
+	}
+
+	// forget whatever a previous recording left behind
+	for (U32 i = 0; i < num_thread_slots(); ++i)
+	{
+		ThreadData* data = sThreads[i];
+		if (data)
+		{
+			data->mTail = (U32)data->mHead;
+		}
+	}
+
+	stream->write(TRACE_MAGIC, TRACE_MAGIC_LENGTH);
+	F64 frequency = calc_clock_frequency(50U);
+	U64 frequency_bits;
+	memcpy(&frequency_bits, &frequency, sizeof(frequency_bits));
+	write_u64(*stream, frequency_bits);
+	U32 num_timers = getNumTimers();
+	for (U32 id = 0; id < num_timers; ++id)
+	{
+		write_name(*stream, 'T', id, getTimerName(id));
+	}
+
+	sWriterThread = new WriterThread(stream, num_timers);
+	sWriterThread->start();
+	while (sWriterThread->isStopped())
+	{
+		// or a quick stopRecording() would find nothing to wait for
+		ms_sleep(1);
+	}
+	sRecording = true;
+	llinfos << "Recording timer trace to " << filename << llendl;
+	return true;
+}
+
+//static
+void LLTraceRecorder::stopRecording()
+{
+	if (!sWriterThread)
+	{
+		return;
+	}
+	sRecording = false;
+	sWriterThread->shutdown();
+	sWriterThread->finish();
+	delete sWriterThread;
+	sWriterThread = NULL;
+	free_retired_events();
+	llinfos << "Timer trace stopped" << llendl;
+}
+
+//static
+void LLTraceRecorder::markFrame()
+{
+	recordMainThreadEvent(EVENT_FRAME, 0);
+}
+
+//static
+void LLTraceRecorder::pushTimer(U32 timer_id)
+{
+	ThreadData* data = getThreadData();
+	if (!data)
+	{
+		return;
+	}
+	S32 depth = data->mDepth++;
+	if (depth >= MAX_DEPTH)
+	{
+		return;
+	}
+	U64 now = get_clock_count();
+	ThreadData::StackEntry& entry = data->mStack[depth];
+	entry.mTimerID = timer_id;
+	entry.mStart = now;
+	entry.mChildTime = 0;
+	if (sRecording)
+	{
+		data->record(EVENT_BEGIN, timer_id, now);
+	}
+}
+
+//static
+void LLTraceRecorder::popTimer()
+{
+	ThreadData* data = getThreadData();
+	if (!data || data->mDepth <= 0)
+	{
+		return;
+	}
+	S32 depth = --data->mDepth;
+	if (depth >= MAX_DEPTH)
+	{
+		return;
+	}
+	U64 now = get_clock_count();
+	ThreadData::StackEntry& entry = data->mStack[depth];
+	U64 total_time = now - entry.mStart;
+	data->mSelfTime[entry.mTimerID] += (U32)(total_time - entry.mChildTime);
+	data->mCalls[entry.mTimerID]++;
+	if (depth > 0)
+	{
+		data->mStack[depth - 1].mChildTime += total_time;
+	}
+	if (sRecording)
+	{
+		data->record(EVENT_END, entry.mTimerID, now);
+	}
+}
+
+//static
+void LLTraceRecorder::recordEvent(EEventType type, U32 timer_id)
+{
+	if (sRecording)
+	{
+		ThreadData* data = getThreadData();
+		if (data)
+		{
+			data->record(type, timer_id, get_clock_count());
+		}
+	}
+}
+
+//static
+void LLTraceRecorder::recordMainThreadEvent(EEventType type, U32 timer_id)
+{
+	if (sRecording && sMainThreadData)
+	{
+		sMainThreadData->record(type, timer_id, get_clock_count());
+	}
+}
+
+//static
+void LLTraceRecorder::dumpThreadTimes()
+{
+	F64 ms_per_count = 1000.0 / calc_clock_frequency(50U);
+	U32 num_timers = getNumTimers();
+	for (U32 i = 0; i < num_thread_slots(); ++i)
+	{
+		ThreadData* data = sThreads[i];
+		if (!data || data == sMainThreadData)
+		{
+			continue;	// the main thread has the fast timer view
+		}
+		for (U32 id = 0; id < num_timers; ++id)
+		{
+			U32 self_time = data->mSelfTime[id];
+			U32 calls = data->mCalls[id];
+			U32 new_calls = calls - data->mLastCalls[id];
+			if (new_calls)
+			{
+				llinfos << data->mName << " " << getTimerName(id) << " "
+					<< (F64)(self_time - data->mLastSelfTime[id]) * ms_per_count << " ms, "
+					<< new_calls << " calls" << llendl;
+			}
+			data->mLastSelfTime[id] = self_time;
+			data->mLastCalls[id] = calls;
+		}
+	}
+}
+
+//static
+bool LLTraceRecorder::exportChromeTrace(const std::string& trace_file, std::ostream& json)
+{
+	llifstream is(trace_file, std::ios::in | std::ios::binary);
+	if (!is.is_open())
+	{
+		llwarns << "Unable to open trace file " << trace_file << llendl;
+		return false;
+	}
+
+	char magic[TRACE_MAGIC_LENGTH];
+	U64 frequency_bits;
+	if (!read_bytes(is, (U8*)magic, TRACE_MAGIC_LENGTH)
+		|| memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LENGTH)
+		|| !read_u64(is, frequency_bits))
+	{
+		llwarns << trace_file << " is not a timer trace" << llendl;
+		return false;
+	}
+	F64 frequency;
+	memcpy(&frequency, &frequency_bits, sizeof(frequency));
+	F64 us_per_count = frequency > 0.0 ? 1000000.0 / frequency : 1.0;
+
+	// Names may follow the events that use them, so read everything first.
+	std::map<U32, std::string> timers;
+	std::map<U32, std::string> threads;
+	std::vector<ThreadEvent> events;
+	U64 start_time = ~(U64)0;
+	bool truncated = false;
+	char tag;
+	while (!truncated && is.get(tag))
+	{
+		U32 id;
+		std::string name;
+		switch (tag)
+		{
+		case 'T':
+			truncated = !read_name(is, id, name);
+			timers[id] = name;
+			break;
+		case 'H':
+			truncated = !read_name(is, id, name);
+			threads[id] = name;
+			break;
+		case 'B':
+		{
+			U32 count;
+			truncated = !read_u32(is, id) || !read_u32(is, count);
+			for (U32 n = 0; n < count && !truncated; ++n)
+			{
+				ThreadEvent event;
+				U8 type;
+				event.mThread = id;
+				truncated = !read_u64(is, event.mEvent.mTime)
+					|| !read_u32(is, event.mEvent.mTimerID)
+					|| !read_bytes(is, &type, 1);
+				event.mEvent.mType = type;
+				if (!truncated)
+				{
+					events.push_back(event);
+					start_time = llmin(start_time, event.mEvent.mTime);
+				}
+			}
+			break;
+		}
+		default:
+			truncated = true;
+			break;
+		}
+	}
+	if (truncated)
+	{
+		// a viewer that crashed mid block still leaves a useful trace
+		llwarns << "Trace " << trace_file << " is truncated, exporting what was read" << llendl;
+	}
+
+	std::ios::fmtflags flags = json.flags();
+	std::streamsize precision = json.precision();
+	json.setf(std::ios::fixed, std::ios::floatfield);
+	json.precision(3);
+
+	json << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (std::map<U32, std::string>::iterator it = threads.begin(); it != threads.end(); ++it)
+	{
+		json << (first ? "" : ",\n");
+		first = false;
+		json << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << it->first
+			<< ",\"args\":{\"name\":";
+		write_json_string(json, it->second.empty() ? "unnamed" : it->second);
+		json << "}}";
+	}
+
+	// Chrome wants B/E balanced per thread: drop ends of timers that were
+	// already running when recording started and close whatever was still
+	// open at the end.
+	std::map<U32, std::vector<U32> > open_timers;
+	std::map<U32, F64> last_time;
+	for (std::vector<ThreadEvent>::iterator it = events.begin(); it != events.end(); ++it)
+	{
+		const TraceEvent& event = it->mEvent;
+		std::vector<U32>& stack = open_timers[it->mThread];
+		F64 ts = (F64)(event.mTime - start_time) * us_per_count;
+		last_time[it->mThread] = ts;
+
+		const char* phase;
+		if (event.mType == EVENT_BEGIN)
+		{
+			stack.push_back(event.mTimerID);
+			phase = "B";
+		}
+		else if (event.mType == EVENT_END)
+		{
+			if (stack.empty())
+			{
+				continue;
+			}
+			stack.pop_back();
+			phase = "E";
+		}
+		else
+		{
+			json << (first ? "" : ",\n");
+			first = false;
+			json << "{\"name\":\"frame\",\"ph\":\"i\",\"s\":\"g\",\"ts\":" << ts
+				<< ",\"pid\":1,\"tid\":" << it->mThread << "}";
+			continue;
+		}
+
+		json << (first ? "" : ",\n");
+		first = false;
+		json << "{\"name\":";
+		std::map<U32, std::string>::iterator name_it = timers.find(event.mTimerID);
+		write_json_string(json, name_it != timers.end() ? name_it->second : "unknown");
+		json << ",\"ph\":\"" << phase << "\",\"ts\":" << ts << ",\"pid\":1,\"tid\":" << it->mThread << "}";
+	}
+	for (std::map<U32, std::vector<U32> >::iterator it = open_timers.begin(); it != open_timers.end(); ++it)
+	{
+		for (size_t n = it->second.size(); n > 0; --n)
+		{
+			json << (first ? "" : ",\n");
+			first = false;
+			json << "{\"ph\":\"E\",\"ts\":" << last_time[it->first] << ",\"pid\":1,\"tid\":" << it->first << "}";
+		}
+	}
+	json << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	json.flags(flags);
+	json.precision(precision);
+	return true;
+}
@@ -0,0 +1,130 @@
+/** 
+ * @file lltracerecorder.h
+ * @brief Per-thread timer stacks and a binary timeline trace recorder
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#ifndef LL_LLTRACERECORDER_H
+#define LL_LLTRACERECORDER_H
+
+#include <iosfwd>
+#include <string>
+
+// Per-thread timer accounting and a timeline recorder.
+//
+// Every thread that records gets a buffer of its own: a stack of active
+// timers, lock free self time and call totals per timer, and (while
+// recording) a single producer/single consumer ring of begin/end events.
+// Nothing on the recording path takes a lock; the owning thread is the
+// only writer of its buffer.
+//
+// While recording, a writer thread drains the rings every 32ms into a
+// compact binary trace file (see the format notes in lltracerecorder.cpp).
+// exportChromeTrace() turns such a file into Chrome trace event JSON,
+// which chrome://tracing and Perfetto load directly.
+//
+// Timer ids come from registerTimer(), which LLFastTimer::NamedTimer calls
+// for every named timer.  Worker threads time themselves with
+// LLThreadFastTimer (see llfasttimer_class.h); LLFastTimer itself stays
+// main thread only and just mirrors its begin/end events in here while
+// recording is on.
+class LL_COMMON_API LLTraceRecorder
+{
+public:
+	enum EEventType
+	{
+		EVENT_BEGIN = 0,
+		EVENT_END = 1,
+		EVENT_FRAME = 2
+	};
+
+	enum
+	{
+		MAX_THREADS = 64,		// threads timed at once
+		MAX_TIMERS = 1024,
+		MAX_DEPTH = 64,
+		RING_SIZE = 16384		// events, a power of two
+	};
+
+	// Returns a small id for the named timer.  Not thread safe: named
+	// timers are created during static initialization or on the main
+	// thread.
+	static U32 registerTimer(const std::string& name);
+	static const std::string& getTimerName(U32 timer_id);
+	static U32 getNumTimers();
+
+	// Names the calling thread.  LLThread does this when a thread starts;
+	// threads that never call it are registered unnamed on first use.
+	static void registerThread(const std::string& name);
+	// Gives the calling thread's slot up for reuse.  LLThread does this
+	// when run() returns.
+	static void unregisterThread();
+
+	// MAIN THREAD
+	// Starts streaming events to filename.  Returns false if the file
+	// could not be opened.
+	static bool startRecording(const std::string& filename);
+	static void stopRecording();
+	static bool isRecording() { return sRecording; }
+	// Drops a frame marker into the main thread's timeline.
+	static void markFrame();
+
+	// Timer stack of the calling thread, see LLThreadFastTimer.
+	static void pushTimer(U32 timer_id);
+	static void popTimer();
+
+	// Records a single event for the calling thread, if recording.
+	static void recordEvent(EEventType type, U32 timer_id);
+	// Same, for the thread that called startRecording().
+	static void recordMainThreadEvent(EEventType type, U32 timer_id);
+
+	// MAIN THREAD
+	// Logs self time and calls per thread and timer accumulated by
+	// pushTimer()/popTimer() since the last call.
+	static void dumpThreadTimes();
+
+	// Converts a trace file written by startRecording() to Chrome trace
+	// event JSON.  Returns false if the file is missing or not a trace.
+	static bool exportChromeTrace(const std::string& trace_file, std::ostream& json);
+
+	class ThreadData;	// per-thread buffers, private to lltracerecorder.cpp
+
+private:
+	class WriterThread;
+
+	static ThreadData* getThreadData();
+
+	static bool sRecording;
+	static ThreadData* sMainThreadData;
+	static WriterThread* sWriterThread;
+};
+
+#endif // LL_LLTRACERECORDER_H
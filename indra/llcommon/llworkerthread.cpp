@@ -41,8 +41,8 @@
 //============================================================================
 // Run on MAIN thread
 
-LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded) :
-	LLQueuedThread(name, threaded)
+LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded, bool use_scheduler) :
+	LLQueuedThread(name, threaded, use_scheduler)
 {
 	mDeleteMutex = new LLMutex(NULL);
 
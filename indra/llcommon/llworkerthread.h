@@ -90,7 +90,7 @@ private:
 	LLMutex* mDeleteMutex;
 	
 public:
-	LLWorkerThread(const std::string& name, bool threaded = true);
+	LLWorkerThread(const std::string& name, bool threaded = true, bool use_scheduler = true);
 	~LLWorkerThread();
 
 	/*virtual*/ S32 update(U32 max_time_ms);
@@ -40,6 +40,7 @@
 #include "../llsd.h"
 #include "../llsdserialize.h"
 #include "../llformat.h"
+#include "../lltimer.h"
 
 #include "../test/lltut.h"
 
@@ -248,9 +249,15 @@ namespace tut
 		
 		LLPointer<LLSDFormatter> mFormatter;
 		LLPointer<LLSDParser> mParser;
+
+		// parse with LLSDMemoryParser instead of mParser
+		bool mMemoryParse;
+		LLSDMemoryParser::EFormat mMemoryFormat;
 	};
 
-	TestLLSDSerializeData::TestLLSDSerializeData()
+	TestLLSDSerializeData::TestLLSDSerializeData() :
+		mMemoryParse(false),
+		mMemoryFormat(LLSDMemoryParser::FORMAT_NOTATION)
 	{
 	}
 
@@ -264,8 +271,18 @@ namespace tut
 		mFormatter->format(v, stream);
 		//llinfos << "checkRoundTrip: length " << stream.str().length() << llendl;
 		LLSD w;
-		mParser->reset();	// reset() call is needed since test code re-uses mParser
-		mParser->parse(stream, w, stream.str().size());
+		if(mMemoryParse)
+		{
+			std::string str = stream.str();
+			LLSDMemoryParser parser(mMemoryFormat);
+			parser.parse((const U8*)str.data(), str.size(), w);
+			ensure_equals("memory parse bytes read", parser.getBytesRead(), (S32)str.size());
+		}
+		else
+		{
+			mParser->reset();	// reset() call is needed since test code re-uses mParser
+			mParser->parse(stream, w, stream.str().size());
+		}
 		
 		try
 		{
@@ -491,6 +508,24 @@ namespace tut
 		doRoundTripTests("binary serialization");
 	}
 
+	template<> template<> 
+	void TestLLSDSerializeObject::test<4>()
+	{
+		mFormatter = new LLSDNotationFormatter();
+		mMemoryParse = true;
+		mMemoryFormat = LLSDMemoryParser::FORMAT_NOTATION;
+		doRoundTripTests("notation memory serialization");
+	}
+
+	template<> template<> 
+	void TestLLSDSerializeObject::test<5>()
+	{
+		mFormatter = new LLSDBinaryFormatter();
+		mMemoryParse = true;
+		mMemoryFormat = LLSDMemoryParser::FORMAT_BINARY;
+		doRoundTripTests("binary memory serialization");
+	}
+
 
 	/**
 	 * @class TestLLSDParsing
@@ -1349,6 +1384,30 @@ namespace tut
 				(msg + " (binaryandnotation)").c_str(),
 				actual_value_notation,
 				input);
+
+			// and both again straight out of memory
+			std::string bin = str1.str();
+			LLSD actual_value_mem;
+			S32 count5 = LLSDSerialize::fromBinary(
+				actual_value_mem,
+				(const U8*)bin.data(),
+				bin.size());
+			ensure_equals("ensureBinaryAndNotation memory binary count", count5, count1);
+			ensure_equals(
+				(msg + " (memory binary)").c_str(),
+				actual_value_mem,
+				input);
+
+			std::string notation = str2.str();
+			S32 count6 = LLSDSerialize::fromNotation(
+				actual_value_mem,
+				(const U8*)notation.data(),
+				notation.size());
+			ensure_equals("ensureBinaryAndNotation memory notation count", count6, count3);
+			ensure_equals(
+				(msg + " (memory notation)").c_str(),
+				actual_value_mem,
+				input);
 		}
 
 		void ensureBinaryAndXML(
@@ -1501,5 +1560,341 @@ namespace tut
 		ensureBinaryAndNotation("map", test);
 		ensureBinaryAndXML("map", test);
 	}
-}
 
+	/**
+	 * @class TestLLSDMemoryParsing
+	 * @brief Tests for LLSDMemoryParser which the round trips above
+	 * do not cover.
+	 */
+	class TestLLSDMemoryParsing
+	{
+	public:
+		TestLLSDMemoryParsing() {}
+
+		S32 parse(
+			LLSDMemoryParser::EFormat format,
+			const std::string& in,
+			LLSD& result)
+		{
+			LLSDMemoryParser parser(format);
+			return parser.parse((const U8*)in.data(), in.size(), result);
+		}
+
+		void ensureNotation(
+			const std::string& msg,
+			const std::string& in,
+			const LLSD& expected_value,
+			S32 expected_count)
+		{
+			LLSD result;
+			S32 count = parse(LLSDMemoryParser::FORMAT_NOTATION, in, result);
+			ensure_equals(msg.c_str(), result, expected_value);
+			ensure_equals((msg + " (count)").c_str(), count, expected_count);
+		}
+
+		// Builds a document shaped like a large inventory
+		// descendents reply, which is what the viewer parses most of.
+		static LLSD makeInventory(S32 folders, S32 items_per_folder)
+		{
+			LLSD folder_array = LLSD::emptyArray();
+			for(S32 i = 0; i < folders; ++i)
+			{
+				LLSD folder;
+				LLUUID folder_id;
+				folder_id.generate();
+				folder["folder_id"] = folder_id;
+				folder["owner_id"] = LLUUID::generateNewID();
+				folder["version"] = i;
+				folder["descendents"] = items_per_folder;
+				LLSD categories = LLSD::emptyArray();
+				LLSD items = LLSD::emptyArray();
+				for(S32 j = 0; j < items_per_folder; ++j)
+				{
+					LLSD item;
+					item["item_id"] = LLUUID::generateNewID();
+					item["parent_id"] = folder_id;
+					item["asset_id"] = LLUUID::generateNewID();
+					item["name"] = llformat("Object %d in folder %d", j, i);
+					item["desc"] = "(No Description)";
+					item["type"] = 6;
+					item["inv_type"] = 6;
+					item["flags"] = 0;
+					item["created_at"] = 1262304000 + j;
+					LLSD permissions;
+					permissions["creator_id"] = LLUUID::generateNewID();
+					permissions["owner_id"] = folder["owner_id"];
+					permissions["group_id"] = LLUUID::null;
+					permissions["base_mask"] = (S32)0x7fffffff;
+					permissions["owner_mask"] = (S32)0x7fffffff;
+					permissions["group_mask"] = 0;
+					permissions["everyone_mask"] = 0;
+					permissions["next_owner_mask"] = (S32)0x82000;
+					permissions["is_owner_group"] = false;
+					item["permissions"] = permissions;
+					LLSD sale_info;
+					sale_info["sale_price"] = 10;
+					sale_info["sale_type"] = "not";
+					item["sale_info"] = sale_info;
+					items.append(item);
+				}
+				folder["categories"] = categories;
+				folder["items"] = items;
+				folder_array.append(folder);
+			}
+			LLSD doc;
+			doc["agent_id"] = LLUUID::generateNewID();
+			doc["folders"] = folder_array;
+			return doc;
+		}
+	};
+
+	typedef tut::test_group<TestLLSDMemoryParsing> TestLLSDMemoryParsingGroup;
+	typedef TestLLSDMemoryParsingGroup::object TestLLSDMemoryParsingObject;
+	TestLLSDMemoryParsingGroup gTestLLSDMemoryParsingGroup(
+		"llsd memory parsing");
+
+	template<> template<> 
+	void TestLLSDMemoryParsingObject::test<1>()
+	{
+		// the notation spellings the stream parser accepts
+		ensureNotation("true", "true", LLSD(true), 1);
+		ensureNotation("TRUE", "TRUE", LLSD(true), 1);
+		ensureNotation("t", "t", LLSD(true), 1);
+		ensureNotation("False", "False", LLSD(false), 1);
+		ensureNotation("bad boolean", "tru", LLSD(), LLSDParser::PARSE_FAILURE);
+		ensureNotation("integer", "i-1234", LLSD(-1234), 1);
+		ensureNotation("integer overflow", "i99999999999", LLSD(), LLSDParser::PARSE_FAILURE);
+		ensureNotation("real", "r1.5e2", LLSD(150.0), 1);
+		ensureNotation("escaped string", "'a\\tb\\x41\\''", LLSD("a\tbA'"), 1);
+		ensureNotation("raw string", "s(5)\"he'lo\"", LLSD("he'lo"), 1);
+		ensureNotation("short raw string", "s(50)\"hello\"", LLSD(), LLSDParser::PARSE_FAILURE);
+		ensureNotation("empty", "   ", LLSD(), 0);
+
+		std::vector<U8> expected_binary;
+		expected_binary.push_back('a');
+		expected_binary.push_back('b');
+		expected_binary.push_back(0xff);
+		ensureNotation("base 16", "b16\"6162FF\"", LLSD(expected_binary), 1);
+		ensureNotation("raw binary", "b(3)\"ab\xff\"", LLSD(expected_binary), 1);
+
+		LLSD map;
+		map["a"] = 1;
+		map["b"] = LLSD::emptyArray();
+		map["b"].append("x");
+		map["b"].append(LLSD());
+		ensureNotation("map", " { 'a' : i1 , \"b\":[ 'x', ! ] } ", map, 5);
+		ensureNotation("unterminated map", "{'a':i1", LLSD(), LLSDParser::PARSE_FAILURE);
+		ensureNotation("key without value", "{'a':}", LLSD(), LLSDParser::PARSE_FAILURE);
+	}
+
+	template<> template<> 
+	void TestLLSDMemoryParsingObject::test<2>()
+	{
+		// binary sizes are checked against the data, not trusted
+		std::string huge_array("[\xff\xff\xff\xff]", 6);
+		LLSD result;
+		ensure_equals(
+			"huge array",
+			parse(LLSDMemoryParser::FORMAT_BINARY, huge_array, result),
+			LLSDParser::PARSE_FAILURE);
+
+		std::string short_string("s\0\0\0\x10" "abc", 8);
+		ensure_equals(
+			"short string",
+			parse(LLSDMemoryParser::FORMAT_BINARY, short_string, result),
+			LLSDParser::PARSE_FAILURE);
+		ensure("failed parse leaves undef", result.isUndefined());
+
+		std::string short_array("[\0\0\0\x02i\0\0\0\x01]", 11);
+		ensure_equals(
+			"array with fewer values than its size",
+			parse(LLSDMemoryParser::FORMAT_BINARY, short_array, result),
+			LLSDParser::PARSE_FAILURE);
+
+		// two documents back to back
+		std::stringstream stream;
+		LLSDSerialize::toBinary(LLSD("first"), stream);
+		LLSDSerialize::toBinary(LLSD(2), stream);
+		std::string both = stream.str();
+		LLSDMemoryParser parser(LLSDMemoryParser::FORMAT_BINARY);
+		ensure_equals("first count", parser.parse((const U8*)both.data(), both.size(), result), 1);
+		ensure_equals("first value", result.asString(), std::string("first"));
+		S32 offset = parser.getBytesRead();
+		ensure_equals(
+			"second count",
+			parser.parse((const U8*)both.data() + offset, both.size() - offset, result),
+			1);
+		ensure_equals("second value", result.asInteger(), 2);
+	}
+
+	/**
+	 * Counts what it is handed and stops at a given key.
+	 */
+	class CountingHandler : public LLSDParseHandler
+	{
+	public:
+		CountingHandler(const std::string& stop_key = std::string()) :
+			mStopKey(stop_key), mContainers(0), mKeys(0), mValues(0), mDepth(0), mMaxDepth(0) {}
+
+		virtual bool startMap(S32 size)		{ return startContainer(); }
+		virtual bool endMap()				{ --mDepth; return true; }
+		virtual bool startArray(S32 size)	{ return startContainer(); }
+		virtual bool endArray()				{ --mDepth; return true; }
+		virtual bool mapKey(const char* key, S32 length)
+		{
+			++mKeys;
+			mLastKey.assign(key, length);
+			return mLastKey != mStopKey;
+		}
+		virtual bool undefinedValue()						{ ++mValues; return true; }
+		virtual bool booleanValue(bool)						{ ++mValues; return true; }
+		virtual bool integerValue(S32)						{ ++mValues; return true; }
+		virtual bool realValue(F64)							{ ++mValues; return true; }
+		virtual bool uuidValue(const LLUUID&)				{ ++mValues; return true; }
+		virtual bool stringValue(const char*, S32)			{ ++mValues; return true; }
+		virtual bool dateValue(const LLDate&)				{ ++mValues; return true; }
+		virtual bool uriValue(const char*, S32)				{ ++mValues; return true; }
+		virtual bool binaryValue(const U8*, S32)			{ ++mValues; return true; }
+
+		bool startContainer()
+		{
+			++mContainers;
+			mMaxDepth = llmax(mMaxDepth, ++mDepth);
+			return true;
+		}
+
+		std::string mStopKey;
+		std::string mLastKey;
+		S32 mContainers;
+		S32 mKeys;
+		S32 mValues;
+		S32 mDepth;
+		S32 mMaxDepth;
+	};
+
+	template<> template<> 
+	void TestLLSDMemoryParsingObject::test<3>()
+	{
+		LLSD doc = makeInventory(3, 4);
+		std::stringstream bin_stream;
+		std::stringstream notation_stream;
+		LLSDSerialize::toBinary(doc, bin_stream);
+		LLSDSerialize::toNotation(doc, notation_stream);
+		std::string bin = bin_stream.str();
+		std::string notation = notation_stream.str();
+
+		// doc, folders, each folder, its categories, its items,
+		// each item, its permissions and its sale info.
+		const S32 containers = 2 + 3 * 3 + 3 * 4 * 3;
+		const S32 keys = 2 + 3 * 6 + 3 * 4 * (11 + 9 + 2);
+		for(S32 i = 0; i < 2; ++i)
+		{
+			const std::string& in = i ? notation : bin;
+			LLSDMemoryParser parser(i ? LLSDMemoryParser::FORMAT_NOTATION : LLSDMemoryParser::FORMAT_BINARY);
+			CountingHandler handler;
+			S32 count = parser.parse((const U8*)in.data(), in.size(), handler);
+			ensure_equals("containers", handler.mContainers, containers);
+			ensure_equals("keys", handler.mKeys, keys);
+			ensure_equals("count", count, handler.mContainers + handler.mValues);
+			ensure_equals("depth", handler.mMaxDepth, 6);
+			ensure_equals("balanced", handler.mDepth, 0);
+
+			CountingHandler stopper("permissions");
+			count = parser.parse((const U8*)in.data(), in.size(), stopper);
+			ensure_equals("stopped parse fails", count, LLSDParser::PARSE_FAILURE);
+			ensure_equals("stopped at key", stopper.mLastKey, std::string("permissions"));
+			ensure("stopped early", parser.getBytesRead() < (S32)in.size());
+		}
+	}
+
+	template<> template<> 
+	void TestLLSDMemoryParsingObject::test<4>()
+	{
+		// Compare against the stream parsers on an inventory sized
+		// document. This is synthetic since there are no recorded
+		// replies in the tree.
+		LLSD doc = makeInventory(100, 50);
+		std::stringstream bin_stream;
+		std::stringstream notation_stream;
+		LLSDSerialize::toBinary(doc, bin_stream);
+		LLSDSerialize::toNotation(doc, notation_stream);
+		std::string bin = bin_stream.str();
+		std::string notation = notation_stream.str();
+
+		const S32 PASSES = 5;
+		F64 times[4] = { 0.0, 0.0, 0.0, 0.0 };
+		for(S32 pass = 0; pass < PASSES; ++pass)
+		{
+			LLTimer timer;
+			LLSD result;
+
+			{
+				std::istringstream istr(bin);
+				timer.reset();
+				LLSDSerialize::fromBinary(result, istr, bin.size());
+				times[0] += timer.getElapsedTimeF64();
+				ensure_equals("stream binary", result, doc);
+			}
+			result.clear();
+			timer.reset();
+			LLSDSerialize::fromBinary(result, (const U8*)bin.data(), bin.size());
+			times[1] += timer.getElapsedTimeF64();
+			ensure_equals("memory binary", result, doc);
+
+			{
+				std::istringstream istr(notation);
+				timer.reset();
+				LLSDSerialize::fromNotation(result, istr, notation.size());
+				times[2] += timer.getElapsedTimeF64();
+				ensure_equals("stream notation", result, doc);
+			}
+			result.clear();
+			timer.reset();
+			LLSDSerialize::fromNotation(result, (const U8*)notation.data(), notation.size());
+			times[3] += timer.getElapsedTimeF64();
+			ensure_equals("memory notation", result, doc);
+		}
+
+		llinfos << "Parsing " << bin.size() << " bytes of binary, " << notation.size()
+			<< " bytes of notation, " << PASSES << " passes. binary stream: "
+			<< times[0] << "s memory: " << times[1] << "s. notation stream: "
+			<< times[2] << "s memory: " << times[3] << "s" << llendl;
+	}
+
+	template<> template<> 
+	void TestLLSDMemoryParsingObject::test<5>()
+	{
+		// What a parsed inventory sized document costs to build and
+		// to free, in impl allocations and time.
+		LLSD doc = makeInventory(100, 50);
+		std::stringstream bin_stream;
+		LLSDSerialize::toBinary(doc, bin_stream);
+		std::string bin = bin_stream.str();
+
+		// report the fastest pass, which is the least disturbed
+		const S32 PASSES = 10;
+		F64 parse_time = 1000.0;
+		F64 free_time = 1000.0;
+		U32 allocations = 0;
+		for(S32 pass = 0; pass < PASSES; ++pass)
+		{
+			LLTimer timer;
+			U32 start_allocations = LLSD::allocationCount();
+			U32 start_outstanding = LLSD::outstandingCount();
+			LLSD* result = new LLSD;
+			LLSDSerialize::fromBinary(*result, (const U8*)bin.data(), bin.size());
+			parse_time = llmin(parse_time, timer.getElapsedTimeF64());
+			allocations = LLSD::allocationCount() - start_allocations;
+			ensure_equals("parsed", *result, doc);
+
+			timer.reset();
+			delete result;
+			free_time = llmin(free_time, timer.getElapsedTimeF64());
+			ensure_equals("all freed", LLSD::outstandingCount(), start_outstanding);
+		}
+
+		llinfos << "Inventory document of " << bin.size() << " bytes: "
+			<< allocations << " impl allocations, parse " << parse_time
+			<< "s, free " << free_time << "s" << llendl;
+	}
+}
@@ -0,0 +1,519 @@
+/** 
+ * @file lltaskscheduler_test.cpp
+ * @brief LLTaskScheduler and scheduled LLQueuedThread tests, with a throughput benchmark against the queued threads.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "../lltaskscheduler.h"
+#include "../llqueuedthread.h"
+#include "../llpointer.h"
+#include "../lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Records the order tasks ran in
+	LLAtomicS32 sSequence(0);
+
+	class OrderTask : public LLTaskScheduler::Task
+	{
+	public:
+		OrderTask(U32 priority = LLQueuedThread::PRIORITY_NORMAL, U32 flags = 0)
+			: LLTaskScheduler::Task(priority, flags),
+			  mOrder(-1),
+			  mThreadID(0)
+		{
+		}
+		S32 mOrder;
+		U32 mThreadID;
+	protected:
+		/*virtual*/ void run()
+		{
+			mThreadID = LLThread::currentID();
+			mOrder = sSequence++;
+		}
+	};
+
+	// Holds its worker until released
+	class BlockTask : public LLTaskScheduler::Task
+	{
+	public:
+		BlockTask() : mStarted(0), mRelease(0) {}
+		LLAtomicU32 mStarted;
+		LLAtomicU32 mRelease;
+	protected:
+		/*virtual*/ void run()
+		{
+			mStarted = 1;
+			while (!mRelease)
+			{
+				LLThread::yield();
+			}
+		}
+	};
+
+	// Some arithmetic standing in for a cache lookup or a decode slice
+	U32 busy_work(U32 seed, S32 iterations)
+	{
+		U32 x = seed | 1;
+		for (S32 i = 0; i < iterations; ++i)
+		{
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+		}
+		return x;
+	}
+
+	// Counts the calls for each index of a parallelFor()
+	class CountBody : public LLTaskScheduler::ParallelBody
+	{
+	public:
+		CountBody(S32 count) : mCounts(count, LLAtomicS32(0)), mChecksum(0), mCalls(0) {}
+		/*virtual*/ void run(S32 index)
+		{
+			mChecksum += busy_work(index, 200) & 0xff;
+			mCounts[index]++;
+		}
+		std::vector<LLAtomicS32> mCounts;
+		LLAtomicU32 mChecksum;
+		LLAtomicS32 mCalls;
+	};
+
+	// Counts the calls for each index of a parallelRange(), context is a
+	// CountBody
+	void count_range(void* context, S32 begin, S32 end)
+	{
+		CountBody* body = (CountBody*)context;
+		for (S32 i = begin; i < end; ++i)
+		{
+			body->run(i);
+		}
+		body->mCalls++;
+	}
+
+	class TestQueue : public LLQueuedThread
+	{
+	public:
+		class TestRequest : public LLQueuedThread::QueuedRequest
+		{
+		public:
+			TestRequest(handle_t handle, U32 priority, TestQueue* owner, S32 slices, S32 work)
+				: LLQueuedThread::QueuedRequest(handle, priority, FLAG_AUTO_COMPLETE),
+				  mOwner(owner),
+				  mSlices(slices),
+				  mWork(work)
+			{
+			}
+
+			/*virtual*/ bool processRequest()
+			{
+				mOwner->mChecksum += busy_work(getHashKey(), mWork);
+				return --mSlices <= 0;
+			}
+
+			/*virtual*/ void finishRequest(bool completed)
+			{
+				if (completed)
+				{
+					mOwner->mCompleted++;
+				}
+			}
+
+		private:
+			TestQueue* mOwner;
+			S32 mSlices;
+			S32 mWork;
+		};
+
+		TestQueue(const std::string& name, S32 max_concurrency = 1, bool use_scheduler = true)
+			: LLQueuedThread(name, true, use_scheduler),
+			  mCompleted(0),
+			  mChecksum(0)
+		{
+			setMaxConcurrency(max_concurrency);
+		}
+
+		void addTest(U32 priority, S32 slices, S32 work)
+		{
+			addRequest(new TestRequest(generateHandle(), priority, this, slices, work));
+		}
+
+		LLAtomicS32 mCompleted;
+		LLAtomicU32 mChecksum;
+	};
+
+	// Checks that threadedUpdate() and endThread() run on the thread that
+	// ran startThread(), as LLTextureFetch's LLCurlRequest requires
+	class AffineQueue : public TestQueue
+	{
+	public:
+		AffineQueue(const std::string& name, bool use_scheduler)
+			: TestQueue(name, 1, use_scheduler),
+			  mStartThreadID(0),
+			  mUpdates(0),
+			  mWrongThread(0),
+			  mEndedOnStartThread(false)
+		{
+		}
+
+		/*virtual*/ void startThread()
+		{
+			mStartThreadID = LLThread::currentID();
+		}
+		/*virtual*/ void threadedUpdate()
+		{
+			mUpdates++;
+			if (LLThread::currentID() != mStartThreadID)
+			{
+				mWrongThread++;
+			}
+		}
+		/*virtual*/ void endThread()
+		{
+			mEndedOnStartThread = (LLThread::currentID() == mStartThreadID);
+		}
+
+		U32 mStartThreadID;
+		LLAtomicS32 mUpdates;
+		LLAtomicS32 mWrongThread;
+		bool mEndedOnStartThread;
+	};
+
+	// Adds count requests to each queue, returns seconds until all have completed
+	F64 run_queues(std::vector<TestQueue*>& queues, S32 count, S32 slices, S32 work)
+	{
+		LLTimer timer;
+		for (S32 i = 0; i < count; ++i)
+		{
+			for (std::vector<TestQueue*>::iterator iter = queues.begin();
+				 iter != queues.end(); ++iter)
+			{
+				(*iter)->addTest(LLQueuedThread::PRIORITY_NORMAL + i, slices, work);
+			}
+		}
+		bool done = false;
+		while (!done)
+		{
+			done = true;
+			for (std::vector<TestQueue*>::iterator iter = queues.begin();
+				 iter != queues.end(); ++iter)
+			{
+				(*iter)->update(0);
+				done = done && ((*iter)->mCompleted == count);
+			}
+			if (!done)
+			{
+				LLThread::yield();
+			}
+		}
+		return timer.getElapsedTimeF64();
+	}
+}
+
+namespace tut
+{
+	struct scheduler_test
+	{
+		scheduler_test()
+		{
+			sSequence = 0;
+		}
+		~scheduler_test()
+		{
+			LLTaskScheduler::cleanupClass();
+		}
+	};
+	typedef test_group<scheduler_test> scheduler_group_t;
+	typedef scheduler_group_t::object scheduler_object_t;
+	tut::scheduler_group_t scheduler_instance("LLTaskScheduler");
+
+	template<> template<>
+	void scheduler_object_t::test<1>()
+	{
+		// continuations: a -> (b, c) -> d
+		LLTaskScheduler scheduler(2);
+		LLPointer<OrderTask> a = new OrderTask;
+		LLPointer<OrderTask> b = new OrderTask;
+		LLPointer<OrderTask> c = new OrderTask;
+		LLPointer<OrderTask> d = new OrderTask;
+		scheduler.addContinuation(a, b);
+		scheduler.addContinuation(a, c);
+		scheduler.addContinuation(b, d);
+		scheduler.addContinuation(c, d);
+		scheduler.submit(d);
+		scheduler.submit(c);
+		scheduler.submit(b);
+		ms_sleep(10);
+		ensure("nothing runs before its predecessor", !b->isDone() && !c->isDone() && !d->isDone());
+		scheduler.submit(a);
+		scheduler.wait(d);
+		ensure("a first", a->mOrder < b->mOrder && a->mOrder < c->mOrder);
+		ensure("d last", d->mOrder > b->mOrder && d->mOrder > c->mOrder);
+
+		// a continuation of a finished task is only waiting on its own submit()
+		LLPointer<OrderTask> e = new OrderTask;
+		scheduler.addContinuation(d, e);
+		scheduler.submit(e);
+		scheduler.wait(e);
+		ensure("continuation of a done task", e->mOrder > d->mOrder);
+	}
+
+	template<> template<>
+	void scheduler_object_t::test<2>()
+	{
+		// main thread completion callbacks
+		LLTaskScheduler scheduler(2);
+		LLPointer<OrderTask> work = new OrderTask;
+		LLPointer<OrderTask> callback = new OrderTask(LLQueuedThread::PRIORITY_NORMAL,
+													  LLTaskScheduler::Task::FLAG_MAIN_THREAD);
+		scheduler.addContinuation(work, callback);
+		scheduler.submit(callback);
+		scheduler.submit(work);
+		while (!work->isDone())
+		{
+			LLThread::yield();
+		}
+		ms_sleep(10);
+		ensure("callback waits for update()", !callback->isDone());
+		ensure_equals("callback queued", scheduler.update(), 0);
+		ensure("callback ran", callback->isDone());
+		ensure_equals("callback on the main thread", callback->mThreadID, LLThread::currentID());
+		ensure("work on a worker", work->mThreadID != LLThread::currentID());
+	}
+
+	template<> template<>
+	void scheduler_object_t::test<3>()
+	{
+		// priorities, using one worker held busy while the tasks are queued
+		LLTaskScheduler scheduler(1);
+		LLPointer<BlockTask> block = new BlockTask;
+		scheduler.submit(block);
+		while (!block->mStarted)
+		{
+			LLThread::yield();
+		}
+		LLPointer<OrderTask> low = new OrderTask(LLQueuedThread::PRIORITY_LOW);
+		LLPointer<OrderTask> normal = new OrderTask(LLQueuedThread::PRIORITY_NORMAL | 5);
+		LLPointer<OrderTask> urgent = new OrderTask(LLQueuedThread::PRIORITY_URGENT);
+		LLPointer<OrderTask> high = new OrderTask(LLQueuedThread::PRIORITY_HIGH);
+		scheduler.submit(low);
+		scheduler.submit(normal);
+		scheduler.submit(urgent);
+		scheduler.submit(high);
+		LLPointer<OrderTask> delayed = new OrderTask(LLQueuedThread::PRIORITY_IMMEDIATE);
+		scheduler.submitDelayed(delayed, 200);
+		block->mRelease = 1;
+		// not wait(), the main thread would run some of them too
+		while (!low->isDone())
+		{
+			LLThread::yield();
+		}
+		ensure("urgent before high", urgent->mOrder < high->mOrder);
+		ensure("high before normal", high->mOrder < normal->mOrder);
+		ensure("normal before low", normal->mOrder < low->mOrder);
+		ensure("delayed task waits", !delayed->isDone());
+		while (!delayed->isDone())
+		{
+			LLThread::yield();
+		}
+		ensure("delayed task ran", delayed->mOrder > low->mOrder);
+	}
+
+	template<> template<>
+	void scheduler_object_t::test<4>()
+	{
+		// LLQueuedThread requests run on the scheduler
+		LLTaskScheduler::initClass(2);
+		TestQueue* queue = new TestQueue("scheduled", 2);
+		ensure("queue uses the scheduler", queue->getScheduled());
+		std::vector<TestQueue*> queues(1, queue);
+		run_queues(queues, 200, 3, 100);
+		ensure_equals("all requests completed", (S32)queue->mCompleted, 200);
+		queue->waitOnPending();
+		ensure_equals("nothing pending", queue->getPending(), 0);
+
+		// paused queues keep their requests
+		queue->pause();
+		queue->addTest(LLQueuedThread::PRIORITY_HIGH, 1, 1);
+		ms_sleep(20);
+		ensure_equals("paused queue waits", (S32)queue->mCompleted, 200);
+		while (queue->mCompleted == 200)
+		{
+			queue->update(0); // unpauses
+			LLThread::yield();
+		}
+		delete queue;
+
+		// a request still queued at shutdown is aborted
+		queue = new TestQueue("shutdown");
+		queue->pause();
+		queue->addTest(LLQueuedThread::PRIORITY_NORMAL, 1, 1);
+		delete queue;
+
+		// deleting a busy queue waits for the drains still running
+		queue = new TestQueue("busy", 2);
+		for (S32 i = 0; i < 50; ++i)
+		{
+			queue->addTest(LLQueuedThread::PRIORITY_NORMAL, 5, 10000);
+		}
+		while (queue->mCompleted == 0)
+		{
+			queue->update(0);
+			LLThread::yield();
+		}
+		delete queue;
+	}
+
+	template<> template<>
+	void scheduler_object_t::test<5>()
+	{
+		// Throughput: five queues standing in for the texture cache, texture
+		// fetch, image decode, VFS and LFS threads, first each on its own
+		// thread, then sharing the scheduler.
+		const S32 NUM_QUEUES = 5;
+		const S32 COUNT = 2000;
+		const S32 SLICES = 2;
+		const S32 WORK[] = { 50, 2000 };
+		for (S32 w = 0; w < 2; ++w)
+		{
+			F64 times[2];
+			U32 checksums[2];
+			for (S32 mode = 0; mode < 2; ++mode)
+			{
+				if (mode == 1)
+				{
+					LLTaskScheduler::initClass();
+				}
+				std::vector<TestQueue*> queues;
+				for (S32 i = 0; i < NUM_QUEUES; ++i)
+				{
+					queues.push_back(new TestQueue(llformat("bench%d", i)));
+				}
+				times[mode] = run_queues(queues, COUNT, SLICES, WORK[w]);
+				checksums[mode] = 0;
+				for (S32 i = 0; i < NUM_QUEUES; ++i)
+				{
+					checksums[mode] += queues[i]->mChecksum;
+				}
+				std::for_each(queues.begin(), queues.end(), DeletePointer());
+				LLTaskScheduler::cleanupClass();
+			}
+			ensure_equals("same work done", checksums[1], checksums[0]);
+			const F64 total = (F64)(NUM_QUEUES * COUNT);
+			llinfos << "LLTaskScheduler " << NUM_QUEUES << " queues x " << COUNT
+					<< " requests, " << WORK[w] << " work: threads " << total / times[0]
+					<< "/s, scheduler " << total / times[1] << "/s" << llendl;
+		}
+	}
+
+	template<> template<>
+	void scheduler_object_t::test<6>()
+	{
+		// parallelFor() runs each index once, and the caller does not pick
+		// up main thread tasks while it waits
+		LLTaskScheduler scheduler(3);
+		LLPointer<OrderTask> callback = new OrderTask(LLQueuedThread::PRIORITY_URGENT,
+													  LLTaskScheduler::Task::FLAG_MAIN_THREAD);
+		scheduler.submit(callback);
+		const S32 COUNT = 1000;
+		CountBody body(COUNT);
+		scheduler.parallelFor(COUNT, body);
+		U32 checksum = 0;
+		for (S32 i = 0; i < COUNT; ++i)
+		{
+			ensure_equals("each index once", (S32)body.mCounts[i], 1);
+			checksum += busy_work(i, 200) & 0xff;
+		}
+		ensure_equals("all the work done", (U32)body.mChecksum, checksum);
+		ensure("main thread task left for update()", !callback->isDone());
+		scheduler.update();
+		ensure("main thread task run by update()", callback->isDone());
+
+		CountBody one(1);
+		scheduler.parallelFor(0, one);
+		ensure_equals("empty loop", (S32)one.mCounts[0], 0);
+		scheduler.parallelFor(1, one);
+		ensure_equals("loop of one", (S32)one.mCounts[0], 1);
+	}
+
+	template<> template<>
+	void scheduler_object_t::test<7>()
+	{
+		// a queue that opts out of the scheduler keeps one thread for
+		// startThread(), threadedUpdate() and endThread(), even with
+		// other queues' drains running on the workers
+		LLTaskScheduler::initClass(3);
+		AffineQueue* affine = new AffineQueue("affine", false);
+		TestQueue* scheduled = new TestQueue("scheduled", 3);
+		ensure("opted out", !affine->getScheduled());
+		ensure("others still scheduled", scheduled->getScheduled());
+		std::vector<TestQueue*> queues;
+		queues.push_back(affine);
+		queues.push_back(scheduled);
+		run_queues(queues, 500, 2, 200);
+		ensure("threadedUpdate() called", affine->mUpdates > 0);
+		ensure_equals("threadedUpdate() on the startThread() thread", (S32)affine->mWrongThread, 0);
+		ensure("not the main thread", affine->mStartThreadID != LLThread::currentID());
+		affine->shutdown();
+		ensure("endThread() on the startThread() thread", affine->mEndedOnStartThread);
+		delete affine;
+		delete scheduled;
+	}
+
+	template<> template<>
+	void scheduler_object_t::test<8>()
+	{
+		// parallelRange() is one call without a scheduler, and covers each
+		// index once in chunks with one
+		const S32 COUNT = 1000;
+		CountBody serial(COUNT);
+		LLTaskScheduler::parallelRange(count_range, &serial, COUNT);
+		ensure_equals("one call without a scheduler", (S32)serial.mCalls, 1);
+
+		LLTaskScheduler::initClass(3);
+		CountBody body(COUNT);
+		LLTaskScheduler::parallelRange(count_range, &body, COUNT);
+		for (S32 i = 0; i < COUNT; ++i)
+		{
+			ensure_equals("each index once", (S32)body.mCounts[i], 1);
+		}
+		ensure("split into chunks", body.mCalls > 1);
+
+		CountBody small(4);
+		LLTaskScheduler::parallelRange(count_range, &small, 4, 8);
+		ensure_equals("one call under min_count", (S32)small.mCalls, 1);
+		ensure_equals("small range done", (S32)small.mCounts[3], 1);
+	}
+}
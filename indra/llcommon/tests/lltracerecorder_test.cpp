@@ -0,0 +1,237 @@
+/** 
+ * @file lltracerecorder_test.cpp
+ * @brief LLTraceRecorder tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+
+#include "linden_common.h"
+
+#include <sstream>
+
+#include "../lltracerecorder.h"
+#include "../llfile.h"
+#include "../llthread.h"
+#include "../lltimer.h"
+#include "../lluuid.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Times a few nested blocks on its own thread
+	class TimedThread : public LLThread
+	{
+	public:
+		TimedThread(U32 outer, U32 inner)
+			: LLThread("traced worker"),
+			  mOuter(outer),
+			  mInner(inner),
+			  mDone(0)
+		{
+		}
+
+		// isStopped() alone is also true before the thread gets going
+		bool isDone() { return mDone != 0 && isStopped(); }
+
+		/*virtual*/ void run()
+		{
+			for (S32 i = 0; i < 10; ++i)
+			{
+				LLTraceRecorder::pushTimer(mOuter);
+				LLTraceRecorder::pushTimer(mInner);
+				ms_sleep(1);
+				LLTraceRecorder::popTimer();
+				LLTraceRecorder::popTimer();
+			}
+			mDone = 1;
+		}
+
+	private:
+		U32 mOuter;
+		U32 mInner;
+		LLAtomicU32 mDone;
+	};
+
+	S32 count_of(const std::string& str, const std::string& what)
+	{
+		S32 count = 0;
+		for (size_t pos = str.find(what); pos != std::string::npos; pos = str.find(what, pos + 1))
+		{
+			++count;
+		}
+		return count;
+	}
+}
+
+namespace tut
+{
+	struct trace_recorder
+	{
+		std::string mTraceFile;
+
+		trace_recorder()
+		{
+			LLUUID random;
+			random.generate();
+			std::ostringstream name;
+#ifdef LL_WINDOWS
+			char* tmp_dir = getenv("TMP");
+			name << (tmp_dir ? tmp_dir : "c:/tmp") << "/lltrace-test-" << random << ".lltrace";
+#else
+			name << "/tmp/lltrace-test-" << random << ".lltrace";
+#endif
+			mTraceFile = name.str();
+		}
+
+		~trace_recorder()
+		{
+			LLTraceRecorder::stopRecording();
+			LLFile::remove(mTraceFile);
+		}
+	};
+	typedef test_group<trace_recorder> trace_recorder_group_t;
+	typedef trace_recorder_group_t::object trace_recorder_object_t;
+	tut::trace_recorder_group_t trace_recorder_instance("LLTraceRecorder");
+
+	template<> template<>
+	void trace_recorder_object_t::test<1>()
+	{
+		// main thread and worker thread events end up in one trace
+		U32 main_timer = LLTraceRecorder::registerTimer("test main \"quoted\"");
+		U32 outer_timer = LLTraceRecorder::registerTimer("test outer");
+		U32 inner_timer = LLTraceRecorder::registerTimer("test inner");
+		ensure_equals("timer name", LLTraceRecorder::getTimerName(outer_timer), "test outer");
+
+		ensure("start", LLTraceRecorder::startRecording(mTraceFile));
+		ensure("recording", LLTraceRecorder::isRecording());
+
+		TimedThread thread(outer_timer, inner_timer);
+		thread.start();
+		for (S32 i = 0; i < 5; ++i)
+		{
+			LLTraceRecorder::recordMainThreadEvent(LLTraceRecorder::EVENT_BEGIN, main_timer);
+			ms_sleep(2);
+			LLTraceRecorder::recordMainThreadEvent(LLTraceRecorder::EVENT_END, main_timer);
+			LLTraceRecorder::markFrame();
+		}
+		while (!thread.isDone())
+		{
+			ms_sleep(1);
+		}
+
+		// a timer created while recording is named when the trace closes
+		U32 late_timer = LLTraceRecorder::registerTimer("test late");
+		LLTraceRecorder::recordMainThreadEvent(LLTraceRecorder::EVENT_BEGIN, late_timer);
+		LLTraceRecorder::recordMainThreadEvent(LLTraceRecorder::EVENT_END, late_timer);
+		LLTraceRecorder::stopRecording();
+		ensure("stopped", !LLTraceRecorder::isRecording());
+
+		std::ostringstream json;
+		ensure("export", LLTraceRecorder::exportChromeTrace(mTraceFile, json));
+		std::string str = json.str();
+		ensure("json object", str.find("{\"traceEvents\":[") == 0);
+		ensure("worker thread named", str.find("\"traced worker\"") != std::string::npos);
+		ensure("main thread named", str.find("\"main\"") != std::string::npos);
+		ensure("name escaped", str.find("\"test main \\\"quoted\\\"\"") != std::string::npos);
+		// begin and end events both carry the name
+		ensure_equals("outer timer events", count_of(str, "\"test outer\""), 20);
+		ensure_equals("inner timer events", count_of(str, "\"test inner\""), 20);
+		ensure_equals("main timer events", count_of(str, "quoted"), 10);
+		ensure_equals("late timer events", count_of(str, "\"test late\""), 2);
+		ensure_equals("frames", count_of(str, "\"name\":\"frame\""), 5);
+		ensure_equals("balanced", count_of(str, "\"ph\":\"B\""), count_of(str, "\"ph\":\"E\""));
+	}
+
+	template<> template<>
+	void trace_recorder_object_t::test<2>()
+	{
+		// timers already running when recording starts or still running
+		// when it stops do not unbalance the export
+		U32 outer_timer = LLTraceRecorder::registerTimer("test open outer");
+		U32 inner_timer = LLTraceRecorder::registerTimer("test open inner");
+
+		LLTraceRecorder::pushTimer(outer_timer);
+		ensure("start", LLTraceRecorder::startRecording(mTraceFile));
+		LLTraceRecorder::pushTimer(inner_timer);
+		LLTraceRecorder::popTimer();
+		LLTraceRecorder::popTimer();
+		LLTraceRecorder::pushTimer(outer_timer);
+		LLTraceRecorder::stopRecording();
+		LLTraceRecorder::popTimer();
+
+		std::ostringstream json;
+		ensure("export", LLTraceRecorder::exportChromeTrace(mTraceFile, json));
+		std::string str = json.str();
+		ensure_equals("begins", count_of(str, "\"ph\":\"B\""), 2);
+		ensure_equals("ends", count_of(str, "\"ph\":\"E\""), 2);
+	}
+
+	template<> template<>
+	void trace_recorder_object_t::test<3>()
+	{
+		// not a trace
+		{
+			llofstream file(mTraceFile);
+			file << "<llsd><undef /></llsd>";
+		}
+		std::ostringstream json;
+		ensure("not a trace", !LLTraceRecorder::exportChromeTrace(mTraceFile, json));
+		ensure("missing file", !LLTraceRecorder::exportChromeTrace(mTraceFile + ".missing", json));
+	}
+
+	template<> template<>
+	void trace_recorder_object_t::test<4>()
+	{
+		// threads that have exited give their slots to new ones
+		U32 outer_timer = LLTraceRecorder::registerTimer("test reused outer");
+		U32 inner_timer = LLTraceRecorder::registerTimer("test reused inner");
+		const S32 NUM_THREADS = LLTraceRecorder::MAX_THREADS * 2;
+
+		ensure("start", LLTraceRecorder::startRecording(mTraceFile));
+		for (S32 i = 0; i < NUM_THREADS; ++i)
+		{
+			TimedThread thread(outer_timer, inner_timer);
+			thread.start();
+			while (!thread.isDone())
+			{
+				ms_sleep(1);
+			}
+		}
+		LLTraceRecorder::stopRecording();
+
+		std::ostringstream json;
+		ensure("export", LLTraceRecorder::exportChromeTrace(mTraceFile, json));
+		std::string str = json.str();
+		ensure_equals("every thread named", count_of(str, "\"traced worker\""), NUM_THREADS);
+		ensure_equals("every thread timed", count_of(str, "\"test reused outer\""), NUM_THREADS * 20);
+	}
+}
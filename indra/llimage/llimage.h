@@ -37,6 +37,7 @@
 #include "lluuid.h"
 #include "llstring.h"
 //#include "llmemory.h"
+#include "llapr.h"
 #include "llthread.h"
 #include "llmemtype.h"
 
@@ -235,16 +236,14 @@ protected:
 	// Create an image from a local file (generally used in tools)
 	bool createFromFile(const std::string& filename, bool j2c_lowest_mip_only = false);
 
-	void copyLineScaled( U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len, S32 in_pixel_step, S32 out_pixel_step );
-	void compositeRowScaled4onto3( U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len );
-
 	U8	fastFractionalMult(U8 a,U8 b);
 
 	void setDataAndSize(U8 *data, S32 width, S32 height, S8 components) ;
 
 public:
-	static S32 sGlobalRawMemory;
-	static S32 sRawImageCount;
+	// Updated from every decode thread
+	static LLAtomicS32 sGlobalRawMemory;
+	static LLAtomicS32 sRawImageCount;
 };
 
 // Compressed representation of image.
@@ -0,0 +1,561 @@
+/** 
+ * @file llimagescale.cpp
+ * @brief Image scaling, compositing and mip kernels with SSE2 and threaded paths.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#include "linden_common.h"
+
+#include "llimagescale.h"
+
+#include "llmath.h"
+#include "llsys.h"
+#include "lltaskscheduler.h"
+
+//static
+bool LLImageScale::sVectorize = false;
+bool LLImageScale::sParallel = false;
+
+// Below this much input a pass is not worth handing to other threads
+const S32 MIN_PARALLEL_BYTES = 256 * 1024;
+
+//----------------------------------------------------------------------------
+
+//static
+void LLImageScale::initClass()
+{
+	sVectorize = hasSSE2Kernels() && gSysCPU.hasSSE2();
+	sParallel = true;
+
+	llinfos << "Image scaling: " << (sVectorize ? "SSE2" : "scalar") << llendl;
+}
+
+//static
+void LLImageScale::cleanupClass()
+{
+	sParallel = false;
+}
+
+//static
+void LLImageScale::setVectorize(bool vectorize)
+{
+	sVectorize = vectorize && hasSSE2Kernels() && gSysCPU.hasSSE2();
+}
+
+//static
+void LLImageScale::parallelFor(range_func_t func, void* context, S32 count, S32 bytes_per_item)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	if (sParallel && count * bytes_per_item >= MIN_PARALLEL_BYTES)
+	{
+		LLTaskScheduler::parallelRange(func, context, count);
+	}
+	else
+	{
+		func(context, 0, count);
+	}
+}
+
+//----------------------------------------------------------------------------
+
+//static
+void LLImageScale::buildSpans(S32 in_len, S32 out_len, span_list_t& spans)
+{
+	// Same arithmetic as scaleLine(), so the vector kernels sample exactly
+	// the same input.
+	const F32 ratio = F32(in_len) / out_len;
+	spans.resize(out_len);
+	for (S32 x = 0; x < out_len; x++)
+	{
+		const F32 sample0 = x * ratio;
+		const F32 sample1 = (x+1) * ratio;
+		Span& span = spans[x];
+		span.mIndex0 = llfloor(sample0);
+		span.mIndex1 = llfloor(sample1);
+		span.mFract0 = 1.f - (sample0 - F32(span.mIndex0));
+		span.mFract1 = sample1 - F32(span.mIndex1);
+	}
+}
+
+namespace
+{
+	struct ScaleContext
+	{
+		const U8* mSrc;
+		U8* mDst;
+		U8* mTemp;
+		S32 mSrcWidth;
+		S32 mSrcHeight;
+		S32 mDstWidth;
+		S32 mDstHeight;
+		S32 mComponents;
+		LLImageScale::span_list_t mSpans;
+	};
+
+	// Vertical pass, scalar: a range of columns
+	void scale_columns(void* context, S32 begin, S32 end)
+	{
+		ScaleContext* ctx = (ScaleContext*)context;
+		const S32 c = ctx->mComponents;
+		for (S32 col = begin; col < end; col++)
+		{
+			LLImageScale::scaleLine(ctx->mSrc + c * col, ctx->mTemp + c * col, c,
+									ctx->mSrcHeight, ctx->mDstHeight, ctx->mSrcWidth, ctx->mSrcWidth);
+		}
+	}
+
+	// Vertical pass, SSE2: a range of output rows
+	void scale_columns_sse2(void* context, S32 begin, S32 end)
+	{
+		ScaleContext* ctx = (ScaleContext*)context;
+		LLImageScale::scaleColumnsSSE2(ctx->mSrc, ctx->mTemp, ctx->mSrcWidth * ctx->mComponents,
+									   ctx->mSrcHeight, ctx->mDstHeight, &ctx->mSpans[0], begin, end);
+	}
+
+	// Horizontal pass: a range of rows
+	void scale_rows(void* context, S32 begin, S32 end)
+	{
+		ScaleContext* ctx = (ScaleContext*)context;
+		const S32 c = ctx->mComponents;
+		bool sse2 = !ctx->mSpans.empty() && c >= 3;
+		for (S32 row = begin; row < end; row++)
+		{
+			const U8* in = ctx->mTemp + c * ctx->mSrcWidth * row;
+			U8* out = ctx->mDst + c * ctx->mDstWidth * row;
+			if (sse2)
+			{
+				LLImageScale::scaleRowSSE2(in, out, c, ctx->mSrcWidth, ctx->mDstWidth, &ctx->mSpans[0]);
+			}
+			else
+			{
+				LLImageScale::scaleLine(in, out, c, ctx->mSrcWidth, ctx->mDstWidth, 1, 1);
+			}
+		}
+	}
+
+	void composite_rows(void* context, S32 begin, S32 end)
+	{
+		ScaleContext* ctx = (ScaleContext*)context;
+		for (S32 row = begin; row < end; row++)
+		{
+			const U8* in = ctx->mTemp + 4 * ctx->mSrcWidth * row;
+			U8* out = ctx->mDst + 3 * ctx->mDstWidth * row;
+			if (!ctx->mSpans.empty())
+			{
+				LLImageScale::compositeRow4onto3SSE2(in, out, ctx->mSrcWidth, ctx->mDstWidth, &ctx->mSpans[0]);
+			}
+			else
+			{
+				LLImageScale::compositeLine4onto3(in, out, ctx->mSrcWidth, ctx->mDstWidth);
+			}
+		}
+	}
+
+	// Scales src vertically into ctx.mTemp (src_width x dst_height)
+	void scale_vertical(ScaleContext& ctx, std::vector<U8>& temp_buffer, bool vectorize)
+	{
+		temp_buffer.resize(ctx.mSrcWidth * ctx.mDstHeight * ctx.mComponents);
+		ctx.mTemp = &temp_buffer[0];
+		S32 row_bytes = ctx.mSrcWidth * ctx.mComponents;
+		if (vectorize)
+		{
+			LLImageScale::buildSpans(ctx.mSrcHeight, ctx.mDstHeight, ctx.mSpans);
+			// each output row reads about src_height / dst_height input rows
+			S32 bytes_per_row = row_bytes * llmax(1, ctx.mSrcHeight / ctx.mDstHeight);
+			LLImageScale::parallelFor(scale_columns_sse2, &ctx, ctx.mDstHeight, bytes_per_row);
+		}
+		else
+		{
+			LLImageScale::parallelFor(scale_columns, &ctx, ctx.mSrcWidth, ctx.mSrcHeight * ctx.mComponents);
+		}
+	}
+}
+
+//static
+void LLImageScale::scale(const U8* src, S32 src_width, S32 src_height,
+						 U8* dst, S32 dst_width, S32 dst_height, S32 components)
+{
+	llassert(components >= 1 && components <= 4);
+
+	ScaleContext ctx;
+	ctx.mSrc = src;
+	ctx.mDst = dst;
+	ctx.mSrcWidth = src_width;
+	ctx.mSrcHeight = src_height;
+	ctx.mDstWidth = dst_width;
+	ctx.mDstHeight = dst_height;
+	ctx.mComponents = components;
+
+	// Vertical
+	std::vector<U8> temp_buffer;
+	scale_vertical(ctx, temp_buffer, sVectorize);
+
+	// Horizontal
+	ctx.mSpans.clear();
+	if (sVectorize && components >= 3)
+	{
+		buildSpans(src_width, dst_width, ctx.mSpans);
+	}
+	parallelFor(scale_rows, &ctx, dst_height, src_width * components);
+}
+
+//static
+void LLImageScale::compositeScaled4onto3(const U8* src, S32 src_width, S32 src_height,
+										 U8* dst, S32 dst_width, S32 dst_height)
+{
+	ScaleContext ctx;
+	ctx.mSrc = src;
+	ctx.mDst = dst;
+	ctx.mSrcWidth = src_width;
+	ctx.mSrcHeight = src_height;
+	ctx.mDstWidth = dst_width;
+	ctx.mDstHeight = dst_height;
+	ctx.mComponents = 4;
+
+	// Vertical: scale but no composite
+	std::vector<U8> temp_buffer;
+	scale_vertical(ctx, temp_buffer, sVectorize);
+
+	// Horizontal: scale and composite
+	ctx.mSpans.clear();
+	if (sVectorize)
+	{
+		buildSpans(src_width, dst_width, ctx.mSpans);
+	}
+	parallelFor(composite_rows, &ctx, dst_height, src_width * 4);
+}
+
+namespace
+{
+	struct MipContext
+	{
+		const U8* mIn;
+		U8* mOut;
+		S32 mWidth;
+		S32 mChannels;
+	};
+
+	void mip_rows(void* context, S32 begin, S32 end)
+	{
+		MipContext* ctx = (MipContext*)context;
+		LLImageScale::generateMipRows(ctx->mIn, ctx->mOut, ctx->mWidth, begin, end, ctx->mChannels);
+	}
+
+	void mip_rows_sse2(void* context, S32 begin, S32 end)
+	{
+		MipContext* ctx = (MipContext*)context;
+		LLImageScale::generateMipRowsSSE2(ctx->mIn, ctx->mOut, ctx->mWidth, begin, end, ctx->mChannels);
+	}
+}
+
+//static
+void LLImageScale::generateMip(const U8* indata, U8* mipdata, S32 width, S32 height, S32 nchannels)
+{
+	llassert(width > 0 && height > 0);
+	MipContext ctx;
+	ctx.mIn = indata;
+	ctx.mOut = mipdata;
+	ctx.mWidth = width;
+	ctx.mChannels = nchannels;
+	bool sse2 = sVectorize && (nchannels == 4 || nchannels == 1);
+	parallelFor(sse2 ? mip_rows_sse2 : mip_rows, &ctx, height, width * nchannels * 4);
+}
+
+//----------------------------------------------------------------------------
+// Scalar kernels
+
+//static
+void LLImageScale::scaleLine(const U8* in, U8* out, S32 components, S32 in_pixel_len, S32 out_pixel_len,
+							 S32 in_pixel_step, S32 out_pixel_step)
+{
+	llassert( components >= 1 && components <= 4 );
+
+	const F32 ratio = F32(in_pixel_len) / out_pixel_len; // ratio of old to new
+	const F32 norm_factor = 1.f / ratio;
+
+	S32 goff = components >= 2 ? 1 : 0;
+	S32 boff = components >= 3 ? 2 : 0;
+	for( S32 x = 0; x < out_pixel_len; x++ )
+	{
+		// Sample input pixels in range from sample0 to sample1.
+		// Avoid floating point accumulation error... don't just add ratio each time.  JC
+		const F32 sample0 = x * ratio;
+		const F32 sample1 = (x+1) * ratio;
+		const S32 index0 = llfloor(sample0);			// left integer (floor)
+		const S32 index1 = llfloor(sample1);			// right integer (floor)
+		const F32 fract0 = 1.f - (sample0 - F32(index0));	// spill over on left
+		const F32 fract1 = sample1 - F32(index1);			// spill-over on right
+
+		if( index0 == index1 )
+		{
+			// Interval is embedded in one input pixel
+			S32 t0 = x * out_pixel_step * components;
+			S32 t1 = index0 * in_pixel_step * components;
+			U8* outp = out + t0;
+			const U8* inp = in + t1;
+			for (S32 i = 0; i < components; ++i)
+			{
+				*outp = *inp;
+				++outp;
+				++inp;
+			}
+		}
+		else
+		{
+			// Left straddle
+			S32 t1 = index0 * in_pixel_step * components;
+			F32 r = in[t1 + 0] * fract0;
+			F32 g = in[t1 + goff] * fract0;
+			F32 b = in[t1 + boff] * fract0;
+			F32 a = 0;
+			if( components == 4)
+			{
+				a = in[t1 + 3] * fract0;
+			}
+		
+			// Central interval
+			if (components < 4)
+			{
+				for( S32 u = index0 + 1; u < index1; u++ )
+				{
+					S32 t2 = u * in_pixel_step * components;
+					r += in[t2 + 0];
+					g += in[t2 + goff];
+					b += in[t2 + boff];
+				}
+			}
+			else
+			{
+				for( S32 u = index0 + 1; u < index1; u++ )
+				{
+					S32 t2 = u * in_pixel_step * components;
+					r += in[t2 + 0];
+					g += in[t2 + 1];
+					b += in[t2 + 2];
+					a += in[t2 + 3];
+				}
+			}
+
+			// right straddle
+			// Watch out for reading off of end of input array.
+			if( fract1 && index1 < in_pixel_len )
+			{
+				S32 t3 = index1 * in_pixel_step * components;
+				if (components < 4)
+				{
+					U8 in0 = in[t3 + 0];
+					U8 in1 = in[t3 + goff];
+					U8 in2 = in[t3 + boff];
+					r += in0 * fract1;
+					g += in1 * fract1;
+					b += in2 * fract1;
+				}
+				else
+				{
+					U8 in0 = in[t3 + 0];
+					U8 in1 = in[t3 + 1];
+					U8 in2 = in[t3 + 2];
+					U8 in3 = in[t3 + 3];
+					r += in0 * fract1;
+					g += in1 * fract1;
+					b += in2 * fract1;
+					a += in3 * fract1;
+				}
+			}
+
+			r *= norm_factor;
+			g *= norm_factor;
+			b *= norm_factor;
+			a *= norm_factor;  // skip conditional
+
+			S32 t4 = x * out_pixel_step * components;
+			out[t4 + 0] = U8(llround(r));
+			if (components >= 2)
+				out[t4 + 1] = U8(llround(g));
+			if (components >= 3)
+				out[t4 + 2] = U8(llround(b));
+			if( components == 4)
+				out[t4 + 3] = U8(llround(a));
+		}
+	}
+}
+
+//static
+void LLImageScale::compositeLine4onto3(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len)
+{
+	const S32 IN_COMPONENTS = 4;
+	const S32 OUT_COMPONENTS = 3;
+
+	const F32 ratio = F32(in_pixel_len) / out_pixel_len; // ratio of old to new
+	const F32 norm_factor = 1.f / ratio;
+
+	for( S32 x = 0; x < out_pixel_len; x++ )
+	{
+		// Sample input pixels in range from sample0 to sample1.
+		// Avoid floating point accumulation error... don't just add ratio each time.  JC
+		const F32 sample0 = x * ratio;
+		const F32 sample1 = (x+1) * ratio;
+		const S32 index0 = llfloor(sample0);			// left integer (floor)
+		const S32 index1 = llfloor(sample1);			// right integer (floor)
+		const F32 fract0 = 1.f - (sample0 - F32(index0));	// spill over on left
+		const F32 fract1 = sample1 - F32(index1);			// spill-over on right
+
+		U8 in_scaled_r;
+		U8 in_scaled_g;
+		U8 in_scaled_b;
+		U8 in_scaled_a;
+
+		if( index0 == index1 )
+		{
+			// Interval is embedded in one input pixel
+			S32 t1 = index0 * IN_COMPONENTS;
+			in_scaled_r = in[t1 + 0];
+			in_scaled_g = in[t1 + 1];
+			in_scaled_b = in[t1 + 2];
+			in_scaled_a = in[t1 + 3];
+		}
+		else
+		{
+			// Left straddle
+			S32 t1 = index0 * IN_COMPONENTS;
+			F32 r = in[t1 + 0] * fract0;
+			F32 g = in[t1 + 1] * fract0;
+			F32 b = in[t1 + 2] * fract0;
+			F32 a = in[t1 + 3] * fract0;
+		
+			// Central interval
+			for( S32 u = index0 + 1; u < index1; u++ )
+			{
+				S32 t2 = u * IN_COMPONENTS;
+				r += in[t2 + 0];
+				g += in[t2 + 1];
+				b += in[t2 + 2];
+				a += in[t2 + 3];
+			}
+
+			// right straddle
+			// Watch out for reading off of end of input array.
+			if( fract1 && index1 < in_pixel_len )
+			{
+				S32 t3 = index1 * IN_COMPONENTS;
+				r += in[t3 + 0] * fract1;
+				g += in[t3 + 1] * fract1;
+				b += in[t3 + 2] * fract1;
+				a += in[t3 + 3] * fract1;
+			}
+
+			r *= norm_factor;
+			g *= norm_factor;
+			b *= norm_factor;
+			a *= norm_factor;
+
+			in_scaled_r = U8(llround(r));
+			in_scaled_g = U8(llround(g));
+			in_scaled_b = U8(llround(b));
+			in_scaled_a = U8(llround(a));
+		}
+
+		if( in_scaled_a )
+		{
+			if( 255 == in_scaled_a )
+			{
+				out[0] = in_scaled_r;
+				out[1] = in_scaled_g;
+				out[2] = in_scaled_b;
+			}
+			else
+			{
+				U8 transparency = 255 - in_scaled_a;
+				out[0] = fastFractionalMult( out[0], transparency ) + fastFractionalMult( in_scaled_r, in_scaled_a );
+				out[1] = fastFractionalMult( out[1], transparency ) + fastFractionalMult( in_scaled_g, in_scaled_a );
+				out[2] = fastFractionalMult( out[2], transparency ) + fastFractionalMult( in_scaled_b, in_scaled_a );
+			}
+		}
+		out += OUT_COMPONENTS;
+	}
+}
+
+static void avg4_colors4(const U8* a, const U8* b, const U8* c, const U8* d, U8* dst)
+{
+	dst[0] = (U8)(((U32)(a[0]) + b[0] + c[0] + d[0])>>2);
+	dst[1] = (U8)(((U32)(a[1]) + b[1] + c[1] + d[1])>>2);
+	dst[2] = (U8)(((U32)(a[2]) + b[2] + c[2] + d[2])>>2);
+	dst[3] = (U8)(((U32)(a[3]) + b[3] + c[3] + d[3])>>2);
+}
+
+static void avg4_colors3(const U8* a, const U8* b, const U8* c, const U8* d, U8* dst)
+{
+	dst[0] = (U8)(((U32)(a[0]) + b[0] + c[0] + d[0])>>2);
+	dst[1] = (U8)(((U32)(a[1]) + b[1] + c[1] + d[1])>>2);
+	dst[2] = (U8)(((U32)(a[2]) + b[2] + c[2] + d[2])>>2);
+}
+
+static void avg4_colors2(const U8* a, const U8* b, const U8* c, const U8* d, U8* dst)
+{
+	dst[0] = (U8)(((U32)(a[0]) + b[0] + c[0] + d[0])>>2);
+	dst[1] = (U8)(((U32)(a[1]) + b[1] + c[1] + d[1])>>2);
+}
+
+//static
+void LLImageScale::generateMipRows(const U8* indata, U8* mipdata, S32 width, S32 row_begin, S32 row_end, S32 nchannels)
+{
+	S32 in_width = width*2;
+	U8* data = mipdata + row_begin * width * nchannels;
+	indata += row_begin * 2 * in_width * nchannels;
+	for (S32 h=row_begin; h<row_end; h++)
+	{
+		for (S32 w=0; w<width; w++)
+		{
+			switch(nchannels)
+			{
+			  case 4:
+				avg4_colors4(indata, indata+4, indata+4*in_width, indata+4*in_width+4, data);
+				break;
+			  case 3:
+				avg4_colors3(indata, indata+3, indata+3*in_width, indata+3*in_width+3, data);
+				break;
+			  case 2:
+				avg4_colors2(indata, indata+2, indata+2*in_width, indata+2*in_width+2, data);
+				break;
+			  case 1:
+				*(U8*)data = (U8)(((U32)(indata[0]) + indata[1] + indata[in_width] + indata[in_width+1])>>2);
+				break;
+			  default:
+				llerrs << "generateMmip called with bad num channels" << llendl;
+			}
+			indata += nchannels*2;
+			data += nchannels;
+		}
+		indata += nchannels*in_width; // skip odd lines
+	}
+}
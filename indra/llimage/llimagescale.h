@@ -0,0 +1,122 @@
+/** 
+ * @file llimagescale.h
+ * @brief Image scaling, compositing and mip kernels with SSE2 and threaded paths.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#ifndef LL_LLIMAGESCALE_H
+#define LL_LLIMAGESCALE_H
+
+#include <vector>
+
+#include "stdtypes.h"
+
+// Box filter scaling used by LLImageRaw::scale(), copyScaled() and
+// compositeScaled4onto3(), and the 2x2 box filter of
+// LLImageBase::generateMip().
+//
+// Each operation has a scalar version (the reference) and an SSE2 version
+// that is bit-exact with it on builds that do scalar float math in SSE
+// registers.  The SSE2 kernels are used when the CPU supports them, and
+// large images are split into row ranges that are run on the
+// LLTaskScheduler threads when there is a scheduler.
+class LLImageScale
+{
+public:
+	// How one output sample is built from input samples [mIndex0, mIndex1]
+	struct Span
+	{
+		S32 mIndex0;
+		S32 mIndex1;
+		F32 mFract0;	// weight of mIndex0
+		F32 mFract1;	// weight of mIndex1
+	};
+	typedef std::vector<Span> span_list_t;
+
+	// Selects the kernels for this CPU.
+	static void initClass();
+	static void cleanupClass();
+
+	// For tests and benchmarks.  setVectorize(true) has no effect if the
+	// CPU or the build lacks SSE2; setParallel(true) none without an
+	// LLTaskScheduler.
+	static void setVectorize(bool vectorize);
+	static bool getVectorize()				{ return sVectorize; }
+	static void setParallel(bool parallel)	{ sParallel = parallel; }
+	static bool getParallel()				{ return sParallel; }
+
+	static void buildSpans(S32 in_len, S32 out_len, span_list_t& spans);
+
+	// src and dst have the same number of components (1 to 4)
+	static void scale(const U8* src, S32 src_width, S32 src_height,
+					  U8* dst, S32 dst_width, S32 dst_height, S32 components);
+
+	// Scales a 4 component src and alpha blends it onto a 3 component dst
+	static void compositeScaled4onto3(const U8* src, S32 src_width, S32 src_height,
+									  U8* dst, S32 dst_width, S32 dst_height);
+
+	// width and height are the dimensions of mipdata
+	static void generateMip(const U8* indata, U8* mipdata, S32 width, S32 height, S32 nchannels);
+
+	// Scalar reference kernels
+	static void scaleLine(const U8* in, U8* out, S32 components, S32 in_pixel_len, S32 out_pixel_len,
+						  S32 in_pixel_step, S32 out_pixel_step);
+	static void compositeLine4onto3(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len);
+	static void generateMipRows(const U8* indata, U8* mipdata, S32 width, S32 row_begin, S32 row_end, S32 nchannels);
+
+	// SSE2 kernels, in llimagescale_sse2.cpp
+	static bool hasSSE2Kernels();
+	// Vertical pass: output rows [row_begin, row_end) of row_bytes bytes each
+	static void scaleColumnsSSE2(const U8* in, U8* out, S32 row_bytes, S32 in_rows, S32 out_rows,
+								 const Span* spans, S32 row_begin, S32 row_end);
+	// Horizontal pass for one row of 3 or 4 component pixels
+	static void scaleRowSSE2(const U8* in, U8* out, S32 components, S32 in_pixel_len, S32 out_pixel_len,
+							 const Span* spans);
+	static void compositeRow4onto3SSE2(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len,
+									   const Span* spans);
+	static void generateMipRowsSSE2(const U8* indata, U8* mipdata, S32 width, S32 row_begin, S32 row_end, S32 nchannels);
+
+	// Runs func(context, begin, end) over [0, count), split up with
+	// LLTaskScheduler::parallelRange() when the work is large enough.
+	typedef void (*range_func_t)(void* context, S32 begin, S32 end);
+	static void parallelFor(range_func_t func, void* context, S32 count, S32 bytes_per_item);
+
+	static inline U8 fastFractionalMult(U8 a, U8 b)
+	{
+		U32 i = a * b + 128;
+		return U8((i + (i>>8)) >> 8);
+	}
+
+private:
+	static bool sVectorize;
+	static bool sParallel;
+};
+
+#endif // LL_LLIMAGESCALE_H
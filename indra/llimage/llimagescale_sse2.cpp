@@ -0,0 +1,354 @@
+/** 
+ * @file llimagescale_sse2.cpp
+ * @brief SSE2 versions of the LLImageScale kernels.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+#include "linden_common.h"
+
+#include "llimagescale.h"
+
+#if (LL_GNUC && defined(__SSE2__)) || (LL_MSVC && (defined(_M_IX86) || defined(_M_X64)))
+#define LL_IMAGE_SSE2 1
+#else
+#define LL_IMAGE_SSE2 0
+#endif
+
+#if LL_IMAGE_SSE2
+
+#include <emmintrin.h>
+
+// The float kernels below perform the same operations in the same order
+// as LLImageScale::scaleLine(): input * fract0, plus each whole input,
+// plus input * fract1, times norm_factor, then floor(x + 0.5).  All the
+// values are positive, so truncation is the floor.
+
+//static
+bool LLImageScale::hasSSE2Kernels()
+{
+	return true;
+}
+
+// 16 bytes to 4 x 4 floats
+static inline void load_16(const U8* p, __m128 out[4])
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v = _mm_loadu_si128((const __m128i*)p);
+	__m128i lo = _mm_unpacklo_epi8(v, zero);
+	__m128i hi = _mm_unpackhi_epi8(v, zero);
+	out[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+	out[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+	out[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+	out[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+}
+
+// 4 x 4 floats rounded to 16 bytes
+static inline void store_16(U8* p, const __m128 in[4], __m128 norm)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	__m128i i0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(in[0], norm), half));
+	__m128i i1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(in[1], norm), half));
+	__m128i i2 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(in[2], norm), half));
+	__m128i i3 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(in[3], norm), half));
+	__m128i lo = _mm_packs_epi32(i0, i1);
+	__m128i hi = _mm_packs_epi32(i2, i3);
+	_mm_storeu_si128((__m128i*)p, _mm_packus_epi16(lo, hi));
+}
+
+// One 3 or 4 component pixel to floats
+static inline __m128 load_pixel(const U8* p, S32 components)
+{
+	U32 bits = 0;
+	memcpy(&bits, p, components);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v = _mm_cvtsi32_si128((int)bits);
+	v = _mm_unpacklo_epi8(v, zero);
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+}
+
+// Weighted sum of a span of pixels, normalized and rounded
+static inline __m128i scale_pixel(const U8* in, S32 components, S32 in_pixel_len,
+								  const LLImageScale::Span& span, __m128 norm)
+{
+	__m128 acc = _mm_mul_ps(load_pixel(in + span.mIndex0 * components, components), _mm_set1_ps(span.mFract0));
+	for (S32 u = span.mIndex0 + 1; u < span.mIndex1; u++)
+	{
+		acc = _mm_add_ps(acc, load_pixel(in + u * components, components));
+	}
+	if (span.mFract1 && span.mIndex1 < in_pixel_len)
+	{
+		acc = _mm_add_ps(acc, _mm_mul_ps(load_pixel(in + span.mIndex1 * components, components),
+										 _mm_set1_ps(span.mFract1)));
+	}
+	acc = _mm_add_ps(_mm_mul_ps(acc, norm), _mm_set1_ps(0.5f));
+	return _mm_cvttps_epi32(acc);
+}
+
+static inline U32 pack_pixel(__m128i v)
+{
+	v = _mm_packs_epi32(v, v);
+	v = _mm_packus_epi16(v, v);
+	return (U32)_mm_cvtsi128_si32(v);
+}
+
+//static
+void LLImageScale::scaleColumnsSSE2(const U8* in, U8* out, S32 row_bytes, S32 in_rows, S32 out_rows,
+									const Span* spans, S32 row_begin, S32 row_end)
+{
+	const F32 ratio = F32(in_rows) / out_rows;
+	const F32 norm_factor = 1.f / ratio;
+	const __m128 norm = _mm_set1_ps(norm_factor);
+	const S32 vec_bytes = row_bytes & ~15;
+
+	for (S32 y = row_begin; y < row_end; y++)
+	{
+		const Span& span = spans[y];
+		U8* outp = out + y * row_bytes;
+		if (span.mIndex0 == span.mIndex1)
+		{
+			// Interval is embedded in one input row
+			memcpy(outp, in + span.mIndex0 * row_bytes, row_bytes);
+			continue;
+		}
+
+		const U8* row0 = in + span.mIndex0 * row_bytes;
+		const bool right = span.mFract1 && span.mIndex1 < in_rows;
+		const U8* row1 = in + span.mIndex1 * row_bytes;
+		const __m128 fract0 = _mm_set1_ps(span.mFract0);
+		const __m128 fract1 = _mm_set1_ps(span.mFract1);
+
+		for (S32 i = 0; i < vec_bytes; i += 16)
+		{
+			__m128 acc[4];
+			__m128 v[4];
+			load_16(row0 + i, acc);
+			acc[0] = _mm_mul_ps(acc[0], fract0);
+			acc[1] = _mm_mul_ps(acc[1], fract0);
+			acc[2] = _mm_mul_ps(acc[2], fract0);
+			acc[3] = _mm_mul_ps(acc[3], fract0);
+			for (S32 u = span.mIndex0 + 1; u < span.mIndex1; u++)
+			{
+				load_16(in + u * row_bytes + i, v);
+				acc[0] = _mm_add_ps(acc[0], v[0]);
+				acc[1] = _mm_add_ps(acc[1], v[1]);
+				acc[2] = _mm_add_ps(acc[2], v[2]);
+				acc[3] = _mm_add_ps(acc[3], v[3]);
+			}
+			if (right)
+			{
+				load_16(row1 + i, v);
+				acc[0] = _mm_add_ps(acc[0], _mm_mul_ps(v[0], fract1));
+				acc[1] = _mm_add_ps(acc[1], _mm_mul_ps(v[1], fract1));
+				acc[2] = _mm_add_ps(acc[2], _mm_mul_ps(v[2], fract1));
+				acc[3] = _mm_add_ps(acc[3], _mm_mul_ps(v[3], fract1));
+			}
+			store_16(outp + i, acc, norm);
+		}
+
+		// remaining bytes
+		for (S32 i = vec_bytes; i < row_bytes; i++)
+		{
+			F32 r = row0[i] * span.mFract0;
+			for (S32 u = span.mIndex0 + 1; u < span.mIndex1; u++)
+			{
+				r += in[u * row_bytes + i];
+			}
+			if (right)
+			{
+				r += row1[i] * span.mFract1;
+			}
+			r *= norm_factor;
+			outp[i] = U8(llround(r));
+		}
+	}
+}
+
+//static
+void LLImageScale::scaleRowSSE2(const U8* in, U8* out, S32 components, S32 in_pixel_len, S32 out_pixel_len,
+								const Span* spans)
+{
+	llassert(components == 3 || components == 4);
+	const F32 ratio = F32(in_pixel_len) / out_pixel_len;
+	const __m128 norm = _mm_set1_ps(1.f / ratio);
+
+	for (S32 x = 0; x < out_pixel_len; x++)
+	{
+		const Span& span = spans[x];
+		U8* outp = out + x * components;
+		if (span.mIndex0 == span.mIndex1)
+		{
+			memcpy(outp, in + span.mIndex0 * components, components);
+		}
+		else
+		{
+			U32 pixel = pack_pixel(scale_pixel(in, components, in_pixel_len, span, norm));
+			memcpy(outp, &pixel, components);
+		}
+	}
+}
+
+//static
+void LLImageScale::compositeRow4onto3SSE2(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len,
+										  const Span* spans)
+{
+	const F32 ratio = F32(in_pixel_len) / out_pixel_len;
+	const __m128 norm = _mm_set1_ps(1.f / ratio);
+
+	for (S32 x = 0; x < out_pixel_len; x++, out += 3)
+	{
+		const Span& span = spans[x];
+		U8 scaled[4];
+		if (span.mIndex0 == span.mIndex1)
+		{
+			memcpy(scaled, in + span.mIndex0 * 4, 4);
+		}
+		else
+		{
+			U32 pixel = pack_pixel(scale_pixel(in, 4, in_pixel_len, span, norm));
+			memcpy(scaled, &pixel, 4);
+		}
+
+		U8 alpha = scaled[3];
+		if (alpha == 255)
+		{
+			out[0] = scaled[0];
+			out[1] = scaled[1];
+			out[2] = scaled[2];
+		}
+		else if (alpha)
+		{
+			U8 transparency = 255 - alpha;
+			out[0] = fastFractionalMult(out[0], transparency) + fastFractionalMult(scaled[0], alpha);
+			out[1] = fastFractionalMult(out[1], transparency) + fastFractionalMult(scaled[1], alpha);
+			out[2] = fastFractionalMult(out[2], transparency) + fastFractionalMult(scaled[2], alpha);
+		}
+	}
+}
+
+//static
+void LLImageScale::generateMipRowsSSE2(const U8* indata, U8* mipdata, S32 width, S32 row_begin, S32 row_end, S32 nchannels)
+{
+	if (nchannels != 4 && nchannels != 1)
+	{
+		generateMipRows(indata, mipdata, width, row_begin, row_end, nchannels);
+		return;
+	}
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+	const S32 in_row_bytes = width * 2 * nchannels;
+	const S32 out_row_bytes = width * nchannels;
+	// each iteration makes 8 output bytes from 16 bytes of each input row
+	const S32 vec_bytes = out_row_bytes & ~7;
+
+	for (S32 h = row_begin; h < row_end; h++)
+	{
+		const U8* row0 = indata + h * 2 * in_row_bytes;
+		const U8* row1 = row0 + in_row_bytes;
+		U8* outp = mipdata + h * out_row_bytes;
+
+		for (S32 i = 0; i < vec_bytes; i += 8)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(row0 + i * 2));
+			__m128i b = _mm_loadu_si128((const __m128i*)(row1 + i * 2));
+			__m128i sum;
+			if (nchannels == 4)
+			{
+				// pixels 0,1 and 2,3 summed down the columns, then across
+				__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+				hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+				sum = _mm_unpacklo_epi64(lo, hi);
+			}
+			else
+			{
+				// even plus odd bytes of both rows
+				sum = _mm_add_epi16(_mm_and_si128(a, low_bytes), _mm_srli_epi16(a, 8));
+				sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_and_si128(b, low_bytes), _mm_srli_epi16(b, 8)));
+			}
+			sum = _mm_srli_epi16(sum, 2);
+			_mm_storel_epi64((__m128i*)(outp + i), _mm_packus_epi16(sum, sum));
+		}
+
+		for (S32 i = vec_bytes; i < out_row_bytes; i++)
+		{
+			// matching bytes of the two input pixels in each row
+			S32 pixel = i / nchannels;
+			S32 channel = i % nchannels;
+			S32 in0 = pixel * 2 * nchannels + channel;
+			S32 in1 = in0 + nchannels;
+			outp[i] = (U8)(((U32)row0[in0] + row0[in1] + row1[in0] + row1[in1]) >> 2);
+		}
+	}
+}
+
+#else // LL_IMAGE_SSE2
+
+// Never called: LLImageScale::setVectorize() checks hasSSE2Kernels()
+
+//static
+bool LLImageScale::hasSSE2Kernels()
+{
+	return false;
+}
+
+//static
+void LLImageScale::scaleColumnsSSE2(const U8* in, U8* out, S32 row_bytes, S32 in_rows, S32 out_rows,
+									const Span* spans, S32 row_begin, S32 row_end)
+{
+	llerrs << "SSE2 kernels not built" << llendl;
+}
+
+//static
+void LLImageScale::scaleRowSSE2(const U8* in, U8* out, S32 components, S32 in_pixel_len, S32 out_pixel_len,
+								const Span* spans)
+{
+	llerrs << "SSE2 kernels not built" << llendl;
+}
+
+//static
+void LLImageScale::compositeRow4onto3SSE2(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len,
+										  const Span* spans)
+{
+	llerrs << "SSE2 kernels not built" << llendl;
+}
+
+//static
+void LLImageScale::generateMipRowsSSE2(const U8* indata, U8* mipdata, S32 width, S32 row_begin, S32 row_end, S32 nchannels)
+{
+	llerrs << "SSE2 kernels not built" << llendl;
+}
+
+#endif // LL_IMAGE_SSE2
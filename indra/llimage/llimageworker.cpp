@@ -34,29 +34,180 @@
 #include "linden_common.h"
 
 #include "llimageworker.h"
+#include "llfasttimer.h"
 #include "llimagedxt.h"
+#include "llstl.h"
+#include "llsys.h"
+#include "lltaskscheduler.h"
+#include "lltimer.h"
+
+//----------------------------------------------------------------------------
+
+// Helper decode thread. Pulls requests from the owner's queue while the
+// owner has work and is not paused, otherwise sleeps on its run condition.
+class LLImageDecodeThread::Worker : public LLThread
+{
+public:
+	Worker(LLImageDecodeThread* owner, S32 index)
+		: LLThread(llformat("imagedecode%d", index)),
+		  mOwner(owner),
+		  mIndex(index)
+	{
+		start();
+	}
+
+protected:
+	/*virtual*/ bool runCondition()
+	{
+		return !mOwner->isPaused() && mOwner->getPending() > 0;
+	}
+
+	/*virtual*/ void run()
+	{
+		mOwner->registerWorker(mIndex);
+		while (1)
+		{
+			// blocks until the owner has queued work, or we are quitting
+			checkPause();
+			if (isQuitting())
+			{
+				break;
+			}
+			mOwner->processNextRequest();
+		}
+		llinfos << "LLImageDecodeThread worker " << mIndex << " EXITING." << llendl;
+	}
+
+private:
+	LLImageDecodeThread* mOwner;
+	S32 mIndex;
+};
+
+//----------------------------------------------------------------------------
+
+LLImageDecodeThread::WorkerStats::WorkerStats()
+	: mThreadID(0),
+	  mBusy(FALSE),
+	  mSlices(0),
+	  mDecodes(0),
+	  mBusyTime(0.0),
+	  mMaxSliceTime(0.0)
+{
+}
+
+LLImageDecodeThread::Stats::Stats()
+	: mDecodes(0),
+	  mFailures(0),
+	  mCancels(0),
+	  mWaitTime(0.0),
+	  mLatency(0.0),
+	  mMaxLatency(0.0)
+{
+}
 
 //----------------------------------------------------------------------------
 
 // MAIN THREAD
-LLImageDecodeThread::LLImageDecodeThread(bool threaded)
+LLImageDecodeThread::LLImageDecodeThread(bool threaded, S32 num_workers)
 	: LLQueuedThread("imagedecode", threaded)
 {
 	mCreationMutex = new LLMutex(getAPRPool());
+	mStatsMutex = new LLMutex(getAPRPool());
+
+	if (!threaded)
+	{
+		num_workers = 1;
+	}
+	else if (num_workers <= 0)
+	{
+		// leave a core for the main thread
+		num_workers = gSysCPU.getProcessorCount() - 1;
+	}
+	num_workers = llclamp(num_workers, 1, (S32)MAX_WORKERS);
+	if (getScheduled())
+	{
+		// Decodes share the scheduler's threads, and any of them may run one
+		setMaxConcurrency(num_workers);
+		mWorkerStats.resize(llmax(num_workers, LLTaskScheduler::getInstance()->getNumThreads()));
+	}
+	else
+	{
+		mWorkerStats.resize(num_workers);
+		startWorkers(num_workers);
+	}
+
+	llinfos << "Image decode threads: " << num_workers << llendl;
+}
+
+// MAIN THREAD
+LLImageDecodeThread::~LLImageDecodeThread()
+{
+	// Stop every thread here, they use the mutexes deleted below
+	shutdown();
+	delete mCreationMutex;
+	mCreationMutex = NULL;
+	delete mStatsMutex;
+	mStatsMutex = NULL;
+}
+
+// MAIN THREAD
+//virtual
+void LLImageDecodeThread::shutdown()
+{
+	// The helpers must be gone before LLQueuedThread deletes the requests
+	stopWorkers();
+	LLQueuedThread::shutdown();
+}
+
+void LLImageDecodeThread::startWorkers(S32 num_workers)
+{
+	for (S32 i = 1; i < num_workers; ++i)
+	{
+		mWorkers.push_back(new Worker(this, i));
+	}
+}
+
+void LLImageDecodeThread::stopWorkers()
+{
+	for (std::vector<Worker*>::iterator iter = mWorkers.begin();
+		 iter != mWorkers.end(); ++iter)
+	{
+		(*iter)->shutdown();
+	}
+	std::for_each(mWorkers.begin(), mWorkers.end(), DeletePointer());
+	mWorkers.clear();
+}
+
+// OWN THREAD (or main thread when not threaded)
+//virtual
+void LLImageDecodeThread::startThread()
+{
+	registerWorker(0);
 }
 
 // MAIN THREAD
 // virtual
 S32 LLImageDecodeThread::update(U32 max_time_ms)
 {
-	LLMutexLock lock(mCreationMutex);
-	for (creation_list_t::iterator iter = mCreationList.begin();
-		 iter != mCreationList.end(); ++iter)
+	// Take the new requests under the creation lock but add them without it:
+	// decodeImage() is called with fetch worker locks held, which the
+	// responders take from inside the queue lock.
+	creation_list_t creation_list;
+	std::vector<handle_t> cancel_list;
+	{
+		LLMutexLock lock(mCreationMutex);
+		creation_list.swap(mCreationList);
+		cancel_list.swap(mCancelList);
+	}
+	for (creation_list_t::iterator iter = creation_list.begin();
+		 iter != creation_list.end(); ++iter)
 	{
 		creation_info& info = *iter;
 		ImageRequest* req = new ImageRequest(info.handle, info.image,
 						     info.priority, info.discard, info.needs_aux,
 						     info.responder);
+		req->mOwner = this;
+		req->mQueuedTime = info.queued_time;
 
 		bool res = addRequest(req);
 		if (!res)
@@ -64,8 +215,23 @@ S32 LLImageDecodeThread::update(U32 max_time_ms)
 			llerrs << "request added after LLLFSThread::cleanupClass()" << llendl;
 		}
 	}
-	mCreationList.clear();
+	for (std::vector<handle_t>::iterator iter = cancel_list.begin();
+		 iter != cancel_list.end(); ++iter)
+	{
+		abortRequest(*iter, false);
+	}
+
 	S32 res = LLQueuedThread::update(max_time_ms);
+
+	if (res > 0 && !isPaused())
+	{
+		// This thread may be busy with a long decode, let the helpers share the queue
+		S32 count = llmin(res, (S32)mWorkers.size());
+		for (S32 i = 0; i < count; ++i)
+		{
+			mWorkers[i]->wake();
+		}
+	}
 	return res;
 }
 
@@ -74,10 +240,17 @@ LLImageDecodeThread::handle_t LLImageDecodeThread::decodeImage(LLImageFormatted*
 {
 	LLMutexLock lock(mCreationMutex);
 	handle_t handle = generateHandle();
-	mCreationList.push_back(creation_info(handle, image, priority, discard, needs_aux, responder));
+	mCreationList.push_back(creation_info(handle, image, priority, discard, needs_aux, responder,
+										  LLTimer::getTotalSeconds()));
 	return handle;
 }
 
+void LLImageDecodeThread::cancelDecode(handle_t handle)
+{
+	LLMutexLock lock(mCreationMutex);
+	mCancelList.push_back(handle);
+}
+
 // Used by unit test only
 // Returns the size of the mutex guarded list as an indication of sanity
 S32 LLImageDecodeThread::tut_size()
@@ -87,6 +260,118 @@ S32 LLImageDecodeThread::tut_size()
 	return res;
 }
 
+//----------------------------------------------------------------------------
+// Stats
+
+void LLImageDecodeThread::registerWorker(S32 index)
+{
+	LLMutexLock lock(mStatsMutex);
+	if (index < (S32)mWorkerStats.size())
+	{
+		mWorkerStats[index].mThreadID = LLThread::currentID();
+	}
+}
+
+// Threads that were not registered (scheduler threads) take the first free slot
+static S32 find_worker(std::vector<LLImageDecodeThread::WorkerStats>& stats, U32 thread_id)
+{
+	for (S32 i = 0; i < (S32)stats.size(); ++i)
+	{
+		if (stats[i].mThreadID == thread_id)
+		{
+			return i;
+		}
+	}
+	for (S32 i = 0; i < (S32)stats.size(); ++i)
+	{
+		if (stats[i].mThreadID == 0)
+		{
+			stats[i].mThreadID = thread_id;
+			return i;
+		}
+	}
+	return -1;
+}
+
+void LLImageDecodeThread::beginSlice(ImageRequest* req)
+{
+	F64 now = LLTimer::getTotalSeconds();
+	LLMutexLock lock(mStatsMutex);
+	if (req->mStartTime == 0.0)
+	{
+		req->mStartTime = now;
+		mStats.mWaitTime += now - req->mQueuedTime;
+	}
+	S32 idx = find_worker(mWorkerStats, LLThread::currentID());
+	if (idx >= 0)
+	{
+		mWorkerStats[idx].mBusy = TRUE;
+	}
+}
+
+void LLImageDecodeThread::endSlice(F64 slice_time, bool done)
+{
+	LLMutexLock lock(mStatsMutex);
+	S32 idx = find_worker(mWorkerStats, LLThread::currentID());
+	if (idx >= 0)
+	{
+		WorkerStats& stats = mWorkerStats[idx];
+		stats.mBusy = FALSE;
+		stats.mSlices++;
+		stats.mBusyTime += slice_time;
+		stats.mMaxSliceTime = llmax(stats.mMaxSliceTime, slice_time);
+		if (done)
+		{
+			stats.mDecodes++;
+		}
+	}
+}
+
+void LLImageDecodeThread::requestFinished(ImageRequest* req, bool success, bool cancelled)
+{
+	F64 latency = LLTimer::getTotalSeconds() - req->mQueuedTime;
+	LLMutexLock lock(mStatsMutex);
+	mStats.mDecodes++;
+	if (cancelled)
+	{
+		mStats.mCancels++;
+	}
+	else if (!success)
+	{
+		mStats.mFailures++;
+	}
+	mStats.mLatency += latency;
+	mStats.mMaxLatency = llmax(mStats.mMaxLatency, latency);
+}
+
+void LLImageDecodeThread::getWorkerStats(std::vector<WorkerStats>& stats)
+{
+	LLMutexLock lock(mStatsMutex);
+	stats = mWorkerStats;
+}
+
+LLImageDecodeThread::Stats LLImageDecodeThread::getStats()
+{
+	LLMutexLock lock(mStatsMutex);
+	return mStats;
+}
+
+void LLImageDecodeThread::resetStats()
+{
+	LLMutexLock lock(mStatsMutex);
+	mStats = Stats();
+	for (std::vector<WorkerStats>::iterator iter = mWorkerStats.begin();
+		 iter != mWorkerStats.end(); ++iter)
+	{
+		WorkerStats& stats = *iter;
+		U32 thread_id = stats.mThreadID;
+		BOOL busy = stats.mBusy;
+		stats = WorkerStats();
+		stats.mThreadID = thread_id;
+		stats.mBusy = busy;
+	}
+}
+
 LLImageDecodeThread::Responder::~Responder()
 {
 }
@@ -102,7 +387,10 @@ LLImageDecodeThread::ImageRequest::ImageRequest(handle_t handle, LLImageFormatte
 	  mNeedsAux(needs_aux),
 	  mDecodedRaw(FALSE),
 	  mDecodedAux(FALSE),
-	  mResponder(responder)
+	  mResponder(responder),
+	  mOwner(NULL),
+	  mQueuedTime(0.0),
+	  mStartTime(0.0)
 {
 }
 
@@ -116,8 +404,29 @@ LLImageDecodeThread::ImageRequest::~ImageRequest()
 //----------------------------------------------------------------------------
 
 
+static LLFastTimer::DeclareTimer FTM_IMAGE_DECODE_WORK("Image Decode Worker");
+
 // Returns true when done, whether or not decode was successful.
 bool LLImageDecodeThread::ImageRequest::processRequest()
+{
+	LLThreadFastTimer t(FTM_IMAGE_DECODE_WORK);
+	if (getFlags() & FLAG_ABORT)
+	{
+		// Cancelled between slices, finishRequest() reports the failure
+		return true;
+	}
+	if (!mOwner)
+	{
+		return decodeSlice();
+	}
+	LLTimer timer;
+	mOwner->beginSlice(this);
+	bool done = decodeSlice();
+	mOwner->endSlice(timer.getElapsedTimeF64(), done);
+	return done;
+}
+
+bool LLImageDecodeThread::ImageRequest::decodeSlice()
 {
 	const F32 decode_time_slice = .1f;
 	bool done = true;
@@ -146,6 +455,10 @@ bool LLImageDecodeThread::ImageRequest::processRequest()
 		done = mFormattedImage->decode(mDecodedImageRaw, decode_time_slice); // 1ms
 		mDecodedRaw = done;
 	}
+	if (done && (getFlags() & FLAG_ABORT))
+	{
+		return true; // cancelled, skip the aux channel
+	}
 	if (done && mNeedsAux && !mDecodedAux && mFormattedImage.notNull())
 	{
 		// Decode aux channel
@@ -164,9 +477,14 @@ bool LLImageDecodeThread::ImageRequest::processRequest()
 
 void LLImageDecodeThread::ImageRequest::finishRequest(bool completed)
 {
+	bool success = completed && mDecodedRaw && (!mNeedsAux || mDecodedAux);
+	if (mOwner)
+	{
+		bool cancelled = !success && (getFlags() & FLAG_ABORT);
+		mOwner->requestFinished(this, success, cancelled);
+	}
 	if (mResponder.notNull())
 	{
-		bool success = completed && mDecodedRaw && (!mNeedsAux || mDecodedAux);
 		mResponder->completed(success, mDecodedImageRaw, mDecodedImageAux);
 	}
 	// Will automatically be deleted
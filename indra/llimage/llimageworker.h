@@ -38,6 +38,12 @@
 #include "llpointer.h"
 #include "llworkerthread.h"
 
+// Decodes images on a pool of threads sharing one LLQueuedThread
+// priority queue. The LLQueuedThread itself is the first worker; the
+// rest are LLImageDecodeThread::Worker helpers that only run while the
+// queue has work and the thread is not paused. When the queue runs on
+// the LLTaskScheduler there are no helpers; up to num_workers scheduler
+// tasks decode at once instead.
 class LLImageDecodeThread : public LLQueuedThread
 {
 public:
@@ -51,6 +57,8 @@ public:
 
 	class ImageRequest : public LLQueuedThread::QueuedRequest
 	{
+		friend class LLImageDecodeThread;
+
 	protected:
 		virtual ~ImageRequest(); // use deleteRequest()
 		
@@ -65,6 +73,9 @@ public:
 		// Used by unit tests to check the consitency of the request instance
 		bool tut_isOK();
 		
+	private:
+		bool decodeSlice();
+
 	private:
 		// input
 		LLPointer<LLImageFormatted> mFormattedImage;
@@ -76,18 +87,75 @@ public:
 		BOOL mDecodedRaw;
 		BOOL mDecodedAux;
 		LLPointer<LLImageDecodeThread::Responder> mResponder;
+		// stats
+		LLImageDecodeThread* mOwner;
+		F64 mQueuedTime;
+		F64 mStartTime;
+	};
+
+	// Snapshot of one decode thread, see getWorkerStats()
+	struct WorkerStats
+	{
+		WorkerStats();
+		U32 mThreadID;
+		BOOL mBusy;				// inside a decode slice right now
+		U32 mSlices;			// decode slices run
+		U32 mDecodes;			// requests finished on this thread
+		F64 mBusyTime;			// seconds spent decoding
+		F64 mMaxSliceTime;		// longest single slice, seconds
+	};
+
+	// Totals across the pool, see getStats()
+	struct Stats
+	{
+		Stats();
+		U32 mDecodes;			// finished, successful or not
+		U32 mFailures;
+		U32 mCancels;			// aborted before they finished
+		F64 mWaitTime;			// seconds between decodeImage() and the first slice
+		F64 mLatency;			// seconds between decodeImage() and completion
+		F64 mMaxLatency;
 	};
 	
 public:
-	LLImageDecodeThread(bool threaded = true);
+	enum { MAX_WORKERS = 8 };
+
+	// num_workers <= 0 sizes the pool from the number of processors.
+	// A non threaded instance always has a single worker: the main thread.
+	LLImageDecodeThread(bool threaded = true, S32 num_workers = 0);
+	virtual ~LLImageDecodeThread();
+	/*virtual*/ void shutdown();
+
 	handle_t decodeImage(LLImageFormatted* image,
 						 U32 priority, S32 discard, BOOL needs_aux,
 						 Responder* responder);
+	// Safe to call from any thread, including while holding locks the
+	// responder takes: the abort is applied by the next update().
+	// A request that has not started is dropped; one that is decoding
+	// stops at the next slice. Either way the responder gets success = false.
+	void cancelDecode(handle_t handle);
 	S32 update(U32 max_time_ms);
 
+	S32 getNumWorkers() const { return (S32)mWorkerStats.size(); }
+	void getWorkerStats(std::vector<WorkerStats>& stats);
+	Stats getStats();
+	void resetStats();
+
 	// Used by unit tests to check the consistency of the thread instance
 	S32 tut_size();
 	
+private:
+	class Worker;
+	friend class Worker;
+
+	/*virtual*/ void startThread();
+	void startWorkers(S32 num_workers);
+	void stopWorkers();
+	void registerWorker(S32 index);
+	void beginSlice(ImageRequest* req);
+	void endSlice(F64 slice_time, bool done);
+	void requestFinished(ImageRequest* req, bool success, bool cancelled);
+
 private:
 	struct creation_info
 	{
@@ -97,13 +165,21 @@ private:
 		S32 discard;
 		BOOL needs_aux;
 		LLPointer<Responder> responder;
-		creation_info(handle_t h, LLImageFormatted* i, U32 p, S32 d, BOOL aux, Responder* r)
-			: handle(h), image(i), priority(p), discard(d), needs_aux(aux), responder(r)
+		F64 queued_time;
+		creation_info(handle_t h, LLImageFormatted* i, U32 p, S32 d, BOOL aux, Responder* r, F64 t)
+			: handle(h), image(i), priority(p), discard(d), needs_aux(aux), responder(r), queued_time(t)
 		{}
 	};
 	typedef std::list<creation_info> creation_list_t;
 	creation_list_t mCreationList;
+	std::vector<handle_t> mCancelList;
 	LLMutex* mCreationMutex;
+
+	std::vector<Worker*> mWorkers;
+
+	LLMutex* mStatsMutex;
+	std::vector<WorkerStats> mWorkerStats; // index 0 is this thread
+	Stats mStats;
 };
 
 #endif
@@ -0,0 +1,246 @@
+/** 
+ * @file llimagescale_test.cpp
+ * @brief LLImageScale test cases and benchmarks.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#include "linden_common.h"
+
+#include "../llimagescale.h"
+
+#include "lltaskscheduler.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// x87 float math can round a channel differently from the SSE2 kernels.
+	const S32 MAX_DIFFERENCE = LL_SSE2_MATH ? 0 : 1;
+
+	void fill_random(std::vector<U8>& data)
+	{
+		for (U32 i = 0; i < data.size(); ++i)
+		{
+			data[i] = (U8)(rand() & 0xff);
+		}
+	}
+
+	S32 max_difference(const std::vector<U8>& a, const std::vector<U8>& b)
+	{
+		S32 diff = 0;
+		for (U32 i = 0; i < a.size(); ++i)
+		{
+			S32 d = (S32)a[i] - (S32)b[i];
+			diff = llmax(diff, d < 0 ? -d : d);
+		}
+		return diff;
+	}
+
+	void set_mode(bool vectorize, bool parallel)
+	{
+		LLImageScale::setVectorize(vectorize);
+		LLImageScale::setParallel(parallel);
+	}
+}
+
+namespace tut
+{
+	struct LLImageScaleTest
+	{
+		LLImageScaleTest()
+		{
+			srand(1);
+			LLTaskScheduler::initClass(2);
+			LLImageScale::initClass();
+		}
+
+		~LLImageScaleTest()
+		{
+			LLImageScale::cleanupClass();
+			LLTaskScheduler::cleanupClass();
+			LLImageScale::setVectorize(false);
+		}
+
+		// scales src with the reference kernels and with the fast ones
+		void checkScale(S32 src_width, S32 src_height, S32 dst_width, S32 dst_height, S32 components)
+		{
+			std::vector<U8> src(src_width * src_height * components);
+			fill_random(src);
+			std::vector<U8> expected(dst_width * dst_height * components);
+			std::vector<U8> actual(expected.size());
+
+			set_mode(false, false);
+			LLImageScale::scale(&src[0], src_width, src_height, &expected[0], dst_width, dst_height, components);
+			set_mode(true, true);
+			LLImageScale::scale(&src[0], src_width, src_height, &actual[0], dst_width, dst_height, components);
+
+			std::string msg = llformat("scale %dx%d to %dx%d, %d components",
+									   src_width, src_height, dst_width, dst_height, components);
+			ensure(msg.c_str(), max_difference(expected, actual) <= MAX_DIFFERENCE);
+		}
+
+	};
+	typedef test_group<LLImageScaleTest> LLImageScaleTest_t;
+	typedef LLImageScaleTest_t::object LLImageScaleTest_object_t;
+	tut::LLImageScaleTest_t tut_LLImageScaleTest("LLImageScale");
+
+	template<> template<>
+	void LLImageScaleTest_object_t::test<1>()
+		// scaling matches the reference for all component counts
+	{
+		for (S32 components = 1; components <= 4; ++components)
+		{
+			checkScale(64, 64, 32, 32, components);		// halving
+			checkScale(100, 37, 300, 111, components);	// enlarging
+			checkScale(513, 257, 70, 301, components);	// uneven, mixed
+			checkScale(1, 1, 17, 5, components);
+			checkScale(1024, 512, 1024, 7, components);	// large enough to run threaded
+		}
+	}
+
+	template<> template<>
+	void LLImageScaleTest_object_t::test<2>()
+		// compositing matches the reference
+	{
+		const S32 SRC_WIDTH = 301;
+		const S32 SRC_HEIGHT = 127;
+		const S32 DST_WIDTH = 128;
+		const S32 DST_HEIGHT = 200;
+		std::vector<U8> src(SRC_WIDTH * SRC_HEIGHT * 4);
+		fill_random(src);
+		// mix of transparent, opaque and blended pixels
+		for (U32 i = 3; i < src.size(); i += 4)
+		{
+			S32 r = rand() % 3;
+			if (r < 2)
+			{
+				src[i] = r ? 255 : 0;
+			}
+		}
+		std::vector<U8> expected(DST_WIDTH * DST_HEIGHT * 3);
+		fill_random(expected);
+		std::vector<U8> actual(expected);
+
+		set_mode(false, false);
+		LLImageScale::compositeScaled4onto3(&src[0], SRC_WIDTH, SRC_HEIGHT, &expected[0], DST_WIDTH, DST_HEIGHT);
+		set_mode(true, true);
+		LLImageScale::compositeScaled4onto3(&src[0], SRC_WIDTH, SRC_HEIGHT, &actual[0], DST_WIDTH, DST_HEIGHT);
+		ensure("composite", max_difference(expected, actual) <= MAX_DIFFERENCE);
+	}
+
+	template<> template<>
+	void LLImageScaleTest_object_t::test<3>()
+		// mip generation is exact for every channel count
+	{
+		const S32 WIDTH = 133;
+		const S32 HEIGHT = 61;
+		for (S32 channels = 1; channels <= 4; ++channels)
+		{
+			std::vector<U8> src(WIDTH * 2 * HEIGHT * 2 * channels);
+			fill_random(src);
+			std::vector<U8> expected(WIDTH * HEIGHT * channels);
+			std::vector<U8> actual(expected.size());
+
+			set_mode(false, false);
+			LLImageScale::generateMip(&src[0], &expected[0], WIDTH, HEIGHT, channels);
+			set_mode(true, true);
+			LLImageScale::generateMip(&src[0], &actual[0], WIDTH, HEIGHT, channels);
+			ensure(llformat("mip, %d channels", channels).c_str(), expected == actual);
+		}
+	}
+
+	template<> template<>
+	void LLImageScaleTest_object_t::test<4>()
+		// a box filter over a constant image is constant
+	{
+		std::vector<U8> src(77 * 33 * 4, 200);
+		std::vector<U8> dst(50 * 50 * 4);
+		set_mode(true, true);
+		LLImageScale::scale(&src[0], 77, 33, &dst[0], 50, 50, 4);
+		ensure("constant", dst == std::vector<U8>(dst.size(), 200));
+	}
+
+	template<> template<>
+	void LLImageScaleTest_object_t::test<5>()
+		// benchmark: scalar, SSE2 and threaded SSE2 kernels
+	{
+		const S32 SIZE = 1024;
+		const S32 ITERATIONS = 10;
+		std::vector<U8> src(SIZE * SIZE * 4);
+		fill_random(src);
+		std::vector<U8> dst(SIZE * SIZE * 4);
+
+		const char* names[] = { "scalar", "SSE2", "SSE2 threaded" };
+		for (S32 mode = 0; mode < 3; ++mode)
+		{
+			set_mode(mode > 0, mode > 1);
+			if (mode > 0 && !LLImageScale::getVectorize())
+			{
+				llinfos << "LLImageScale: SSE2 kernels unavailable, skipping" << llendl;
+				break;
+			}
+
+			LLTimer timer;
+			for (S32 i = 0; i < ITERATIONS; ++i)
+			{
+				LLImageScale::scale(&src[0], SIZE, SIZE, &dst[0], SIZE / 2, SIZE / 2, 4);
+			}
+			F32 halve_time = timer.getElapsedTimeF32();
+
+			timer.reset();
+			for (S32 i = 0; i < ITERATIONS; ++i)
+			{
+				LLImageScale::scale(&src[0], SIZE, SIZE, &dst[0], 700, 300, 3);
+			}
+			F32 scale_time = timer.getElapsedTimeF32();
+
+			timer.reset();
+			for (S32 i = 0; i < ITERATIONS; ++i)
+			{
+				LLImageScale::compositeScaled4onto3(&src[0], SIZE, SIZE, &dst[0], 640, 480);
+			}
+			F32 composite_time = timer.getElapsedTimeF32();
+
+			timer.reset();
+			for (S32 i = 0; i < ITERATIONS; ++i)
+			{
+				LLImageScale::generateMip(&src[0], &dst[0], SIZE / 2, SIZE / 2, 4);
+			}
+			F32 mip_time = timer.getElapsedTimeF32();
+
+			F32 ms = 1000.f / ITERATIONS;
+			llinfos << "LLImageScale " << names[mode] << ": 1024x1024x4 halve " << halve_time * ms
+					<< " ms, 1024x1024x3 to 700x300 " << scale_time * ms
+					<< " ms, composite to 640x480 " << composite_time * ms
+					<< " ms, mip " << mip_time * ms << " ms" << llendl;
+		}
+	}
+}
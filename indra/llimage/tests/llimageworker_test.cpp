@@ -239,6 +239,60 @@ namespace tut
 		ensure("LLImageDecodeThread: threaded work unit not processed", done == true);
 	}
 
+	template<> template<>
+	void imagedecodethread_object_t::test<3>()
+	{
+		// Test a *threaded* pool of decode threads
+		const S32 NUM_WORKERS = 4;
+		const S32 NUM_REQUESTS = 32;
+		mThread = new LLImageDecodeThread(true, NUM_WORKERS);
+		ensure_equals("LLImageDecodeThread: pool size incorrect", mThread->getNumWorkers(), NUM_WORKERS);
+		bool done[NUM_REQUESTS];
+		for (S32 i = 0; i < NUM_REQUESTS; ++i)
+		{
+			mThread->decodeImage(NULL, LLQueuedThread::PRIORITY_NORMAL + i, 0, FALSE, new responder_test(&done[i]));
+		}
+		mThread->update(1);
+		// Wait till all the work orders are handled, 10 seconds max
+		const U32 INCREMENT_TIME = 100;
+		const U32 MAX_TIME = 100 * INCREMENT_TIME;
+		U32 total_time = 0;
+		while ((mThread->getStats().mDecodes < (U32)NUM_REQUESTS) && (total_time < MAX_TIME))
+		{
+			ms_sleep(INCREMENT_TIME);
+			total_time += INCREMENT_TIME;
+			mThread->update(1);
+		}
+		for (S32 i = 0; i < NUM_REQUESTS; ++i)
+		{
+			ensure("LLImageDecodeThread: pooled work unit not processed", done[i]);
+		}
+		std::vector<LLImageDecodeThread::WorkerStats> worker_stats;
+		mThread->getWorkerStats(worker_stats);
+		ensure_equals("LLImageDecodeThread: worker stats size incorrect", (S32)worker_stats.size(), NUM_WORKERS);
+		U32 decodes = 0;
+		for (S32 i = 0; i < NUM_WORKERS; ++i)
+		{
+			decodes += worker_stats[i].mDecodes;
+		}
+		ensure_equals("LLImageDecodeThread: per worker decode counts incorrect", decodes, (U32)NUM_REQUESTS);
+	}
+
+	template<> template<>
+	void imagedecodethread_object_t::test<4>()
+	{
+		// Test that a cancelled request completes without success
+		mThread = new LLImageDecodeThread(false);
+		bool done = false;
+		LLImageDecodeThread::handle_t decodeHandle = mThread->decodeImage(NULL, LLQueuedThread::PRIORITY_NORMAL, 0, FALSE, new responder_test(&done));
+		mThread->cancelDecode(decodeHandle);
+		mThread->update(0);
+		ensure("LLImageDecodeThread: cancelled work unit not completed", done);
+		LLImageDecodeThread::Stats stats = mThread->getStats();
+		ensure_equals("LLImageDecodeThread: cancel not counted", stats.mCancels, (U32)1);
+		ensure_equals("LLImageDecodeThread: cancel counted as a failure", stats.mFailures, (U32)0);
+	}
+
 	// ---------------------------------------------------------------------------------------
 	// Test the LLImageDecodeThread::ImageRequest interface
 	// ---------------------------------------------------------------------------------------
@@ -0,0 +1,137 @@
+/** 
+ * @file llinventoryindex.cpp
+ * @brief Hash-indexed storage for an inventory tree
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "llinventoryindex.h"
+
+static const U32 MIN_TABLE_SIZE = 64;
+
+LLUUIDSlotTable::LLUUIDSlotTable()
+:	mMask(0),
+	mSize(0)
+{
+}
+
+void LLUUIDSlotTable::clear()
+{
+	mEntries.clear();
+	mMask = 0;
+	mSize = 0;
+}
+
+void LLUUIDSlotTable::grow()
+{
+	std::vector<Entry> old_entries;
+	old_entries.swap(mEntries);
+
+	U32 size = old_entries.empty() ? MIN_TABLE_SIZE : (U32)old_entries.size() * 2;
+	Entry empty;
+	empty.mSlot = NO_SLOT;
+	mEntries.assign(size, empty);
+	mMask = size - 1;
+
+	for (U32 i = 0; i < old_entries.size(); ++i)
+	{
+		const Entry& entry = old_entries[i];
+		if (entry.mSlot != NO_SLOT)
+		{
+			U32 pos = hash(entry.mID) & mMask;
+			while (mEntries[pos].mSlot != NO_SLOT)
+			{
+				pos = (pos + 1) & mMask;
+			}
+			mEntries[pos] = entry;
+		}
+	}
+}
+
+void LLUUIDSlotTable::insert(const LLUUID& id, S32 slot)
+{
+	llassert(slot != NO_SLOT);
+	// keep at least half the entries empty
+	if ((U32)(mSize + 1) * 2 > mEntries.size())
+	{
+		grow();
+	}
+	U32 pos = hash(id) & mMask;
+	while (mEntries[pos].mSlot != NO_SLOT)
+	{
+		llassert(mEntries[pos].mID != id);
+		pos = (pos + 1) & mMask;
+	}
+	mEntries[pos].mID = id;
+	mEntries[pos].mSlot = slot;
+	++mSize;
+}
+
+bool LLUUIDSlotTable::erase(const LLUUID& id)
+{
+	if (!mSize)
+	{
+		return false;
+	}
+	U32 pos = hash(id) & mMask;
+	while (mEntries[pos].mID != id)
+	{
+		if (mEntries[pos].mSlot == NO_SLOT)
+		{
+			return false;
+		}
+		pos = (pos + 1) & mMask;
+	}
+	if (mEntries[pos].mSlot == NO_SLOT)
+	{
+		return false;
+	}
+
+	// Shift back every entry after the hole that could not be found
+	// across it any more.
+	U32 hole = pos;
+	for (U32 next = (hole + 1) & mMask; mEntries[next].mSlot != NO_SLOT; next = (next + 1) & mMask)
+	{
+		U32 home = hash(mEntries[next].mID) & mMask;
+		// is home cyclically outside (hole, next]?
+		bool movable = (hole <= next) ? (home <= hole || home > next)
+									  : (home <= hole && home > next);
+		if (movable)
+		{
+			mEntries[hole] = mEntries[next];
+			hole = next;
+		}
+	}
+	mEntries[hole].mSlot = NO_SLOT;
+	--mSize;
+	return true;
+}
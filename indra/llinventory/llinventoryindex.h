@@ -0,0 +1,647 @@
+/** 
+ * @file llinventoryindex.h
+ * @brief Hash-indexed storage for an inventory tree
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#ifndef LL_LLINVENTORYINDEX_H
+#define LL_LLINVENTORYINDEX_H
+
+#include "lldarray.h"
+#include "llpointer.h"
+#include "lluuid.h"
+#include <vector>
+
+// Open-addressed hash table from UUIDs to slot numbers.  Collisions are
+// probed linearly and erase() shifts the entries after the erased one
+// back, so lookups never wade through deleted entries.
+class LLUUIDSlotTable
+{
+public:
+	enum { NO_SLOT = -1 };
+
+	LLUUIDSlotTable();
+
+	// Returns NO_SLOT if id is not in the table.
+	S32 find(const LLUUID& id) const;
+	// id must not be in the table yet.
+	void insert(const LLUUID& id, S32 slot);
+	bool erase(const LLUUID& id);
+	void clear();
+	S32 size() const { return mSize; }
+
+private:
+	struct Entry
+	{
+		LLUUID mID;
+		S32 mSlot;		// NO_SLOT for an empty entry
+	};
+
+	static U32 hash(const LLUUID& id)
+	{
+		U32 words[4];
+		memcpy(words, id.mData, sizeof(words));
+		U32 h = (words[0] ^ words[2]) * 0x9e3779b1 + (words[1] ^ words[3]);
+		return h ^ (h >> 15);
+	}
+	void grow();
+
+	std::vector<Entry> mEntries;
+	U32 mMask;
+	S32 mSize;
+};
+
+inline S32 LLUUIDSlotTable::find(const LLUUID& id) const
+{
+	if (!mSize)
+	{
+		return NO_SLOT;
+	}
+	for (U32 i = hash(id) & mMask; ; i = (i + 1) & mMask)
+	{
+		const Entry& entry = mEntries[i];
+		if (entry.mSlot == NO_SLOT || entry.mID == id)
+		{
+			return entry.mSlot;
+		}
+	}
+}
+
+// The categories and items of an inventory, by id, and the tree the
+// child arrays make of them.
+//
+// Objects live in dense slabs found through LLUUIDSlotTable.  Each
+// category slot holds the category's child arrays, in blocks that are
+// never moved, so the array pointers handed out stay good until the
+// category is removed.
+//
+// Changes to the tree go through link*() and unlink*().  From the child
+// arrays the index lays the categories out in depth first order, each
+// with the range its subtree covers and a count of the items in it.
+// That makes ancestry checks two comparisons and subtree walks a scan
+// of an array.  The layout is rebuilt on the first query after a
+// category moves; item changes only update the counts up the tree.
+template <class CATEGORY, class ITEM>
+class LLInventoryIndex
+{
+public:
+	typedef LLDynamicArray<LLPointer<CATEGORY> > cat_array_t;
+	typedef LLDynamicArray<LLPointer<ITEM> > item_array_t;
+
+	LLInventoryIndex();
+	~LLInventoryIndex();
+
+	CATEGORY* getCategory(const LLUUID& id) const;
+	ITEM* getItem(const LLUUID& id) const;
+	S32 getCategoryCount() const { return mCategoryCount; }
+	S32 getItemCount() const { return (S32)mItemTable.size(); }
+
+	// Adds the object, or replaces the one with the same id.  A new
+	// category comes with empty child arrays.  Neither is linked into
+	// its parent.
+	void addCategory(CATEGORY* cat);
+	void addItem(ITEM* item);
+	// A category goes with its child arrays.  Unlink it first.
+	void removeCategory(const LLUUID& id);
+	void removeItem(const LLUUID& id);
+	// Child arrays for an id that is not a category, such as the null
+	// parent of the root folders.
+	void addChildArrays(const LLUUID& id);
+	void clear();
+
+	// NULL if id has no child arrays.  Read only, change the tree with
+	// link*() and unlink*().
+	cat_array_t* getChildCategories(const LLUUID& id) const;
+	item_array_t* getChildItems(const LLUUID& id) const;
+
+	// Put an object in or take it out of parent_id's child array.
+	// link*() return false if parent_id has no child arrays.
+	bool linkCategory(CATEGORY* cat, const LLUUID& parent_id);
+	void unlinkCategory(CATEGORY* cat, const LLUUID& parent_id);
+	bool linkItem(ITEM* item, const LLUUID& parent_id);
+	void unlinkItem(ITEM* item, const LLUUID& parent_id);
+
+	// Every object, in no particular order
+	void getAllCategories(cat_array_t& cats) const;
+	void getAllItems(item_array_t& items) const;
+
+	// True if id is ancestor_id or a category in its subtree.
+	bool isCategoryUnder(const LLUUID& id, const LLUUID& ancestor_id) const;
+	// Categories and items in id's subtree, not counting id.  Returns
+	// false if id is not in the tree.
+	bool getDescendentCounts(const LLUUID& id, S32& categories, S32& items) const;
+
+	// Adds what add() accepts of id's subtree, in the order a recursive
+	// walk of the child arrays would: each category, then its subtree,
+	// then its items.  skip_id's contents are left out, though skip_id
+	// itself is offered.  id's own items come last, if add_own_items.
+	// add() must not change the inventory.
+	template <class FUNCTOR>
+	void collectDescendentsIf(const LLUUID& id, cat_array_t& cats, item_array_t& items,
+							  const LLUUID& skip_id, FUNCTOR& add, bool add_own_items = true) const;
+
+private:
+	struct CategorySlot
+	{
+		CategorySlot() : mLive(false), mParent(-1), mEnter(-1), mExit(-1), mSubtreeItems(0) {}
+
+		LLUUID mID;
+		LLPointer<CATEGORY> mCategory;	// NULL for bare child arrays
+		cat_array_t mChildCategories;
+		item_array_t mChildItems;
+		bool mLive;
+		// Layout, mEnter is -1 for a category that is not in the tree
+		// (one on a parent cycle).
+		S32 mParent;
+		S32 mEnter;
+		S32 mExit;
+		S32 mSubtreeItems;
+	};
+
+	enum { SLOT_BLOCK_SHIFT = 6, SLOT_BLOCK_SIZE = 1 << SLOT_BLOCK_SHIFT };
+
+	// No copy constructor or copy assignment
+	LLInventoryIndex(const LLInventoryIndex&);
+	LLInventoryIndex& operator=(const LLInventoryIndex&);
+
+	CategorySlot& getSlot(S32 slot) const
+	{
+		return mSlotBlocks[slot >> SLOT_BLOCK_SHIFT][slot & (SLOT_BLOCK_SIZE - 1)];
+	}
+	S32 findOrAddSlot(const LLUUID& id);
+	void updateLayout() const;
+	void addSubtreeItems(S32 slot, S32 count);
+
+	LLUUIDSlotTable mCategoryTable;
+	std::vector<CategorySlot*> mSlotBlocks;
+	std::vector<S32> mFreeSlots;
+	S32 mSlotCount;			// slots handed out, live or free
+	S32 mCategoryCount;
+
+	LLUUIDSlotTable mItemTable;
+	std::vector<LLPointer<ITEM> > mItems;
+	std::vector<S32> mFreeItems;
+
+	mutable bool mLayoutDirty;
+	mutable std::vector<S32> mPreorder;	// slots in depth first order
+};
+
+template <class CATEGORY, class ITEM>
+LLInventoryIndex<CATEGORY, ITEM>::LLInventoryIndex()
+:	mSlotCount(0),
+	mCategoryCount(0),
+	mLayoutDirty(true)
+{
+}
+
+template <class CATEGORY, class ITEM>
+LLInventoryIndex<CATEGORY, ITEM>::~LLInventoryIndex()
+{
+	clear();
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::clear()
+{
+	for (U32 i = 0; i < mSlotBlocks.size(); ++i)
+	{
+		delete[] mSlotBlocks[i];
+	}
+	mSlotBlocks.clear();
+	mFreeSlots.clear();
+	mSlotCount = 0;
+	mCategoryCount = 0;
+	mCategoryTable.clear();
+	mItemTable.clear();
+	mItems.clear();
+	mFreeItems.clear();
+	mPreorder.clear();
+	mLayoutDirty = true;
+}
+
+template <class CATEGORY, class ITEM>
+CATEGORY* LLInventoryIndex<CATEGORY, ITEM>::getCategory(const LLUUID& id) const
+{
+	S32 slot = mCategoryTable.find(id);
+	return slot == LLUUIDSlotTable::NO_SLOT ? NULL : getSlot(slot).mCategory.get();
+}
+
+template <class CATEGORY, class ITEM>
+ITEM* LLInventoryIndex<CATEGORY, ITEM>::getItem(const LLUUID& id) const
+{
+	S32 slot = mItemTable.find(id);
+	return slot == LLUUIDSlotTable::NO_SLOT ? NULL : mItems[slot].get();
+}
+
+template <class CATEGORY, class ITEM>
+S32 LLInventoryIndex<CATEGORY, ITEM>::findOrAddSlot(const LLUUID& id)
+{
+	S32 slot = mCategoryTable.find(id);
+	if (slot != LLUUIDSlotTable::NO_SLOT)
+	{
+		return slot;
+	}
+	if (!mFreeSlots.empty())
+	{
+		slot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else
+	{
+		if (mSlotCount == (S32)mSlotBlocks.size() * SLOT_BLOCK_SIZE)
+		{
+			mSlotBlocks.push_back(new CategorySlot[SLOT_BLOCK_SIZE]);
+		}
+		slot = mSlotCount++;
+	}
+	CategorySlot& cat_slot = getSlot(slot);
+	cat_slot.mID = id;
+	cat_slot.mLive = true;
+	mCategoryTable.insert(id, slot);
+	mLayoutDirty = true;
+	return slot;
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::addCategory(CATEGORY* cat)
+{
+	CategorySlot& slot = getSlot(findOrAddSlot(cat->getUUID()));
+	if (slot.mCategory.isNull())
+	{
+		++mCategoryCount;
+	}
+	slot.mCategory = cat;
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::addChildArrays(const LLUUID& id)
+{
+	findOrAddSlot(id);
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::removeCategory(const LLUUID& id)
+{
+	S32 slot = mCategoryTable.find(id);
+	if (slot == LLUUIDSlotTable::NO_SLOT)
+	{
+		return;
+	}
+	CategorySlot& cat_slot = getSlot(slot);
+	if (cat_slot.mCategory.notNull())
+	{
+		--mCategoryCount;
+	}
+	cat_slot.mCategory = NULL;
+	cat_slot.mChildCategories.reset();
+	cat_slot.mChildItems.reset();
+	cat_slot.mLive = false;
+	mCategoryTable.erase(id);
+	mFreeSlots.push_back(slot);
+	mLayoutDirty = true;
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::addItem(ITEM* item)
+{
+	S32 slot = mItemTable.find(item->getUUID());
+	if (slot == LLUUIDSlotTable::NO_SLOT)
+	{
+		if (!mFreeItems.empty())
+		{
+			slot = mFreeItems.back();
+			mFreeItems.pop_back();
+		}
+		else
+		{
+			slot = (S32)mItems.size();
+			mItems.push_back(NULL);
+		}
+		mItemTable.insert(item->getUUID(), slot);
+	}
+	mItems[slot] = item;
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::removeItem(const LLUUID& id)
+{
+	S32 slot = mItemTable.find(id);
+	if (slot != LLUUIDSlotTable::NO_SLOT)
+	{
+		mItems[slot] = NULL;
+		mItemTable.erase(id);
+		mFreeItems.push_back(slot);
+	}
+}
+
+template <class CATEGORY, class ITEM>
+typename LLInventoryIndex<CATEGORY, ITEM>::cat_array_t* LLInventoryIndex<CATEGORY, ITEM>::getChildCategories(const LLUUID& id) const
+{
+	S32 slot = mCategoryTable.find(id);
+	return slot == LLUUIDSlotTable::NO_SLOT ? NULL : &getSlot(slot).mChildCategories;
+}
+
+template <class CATEGORY, class ITEM>
+typename LLInventoryIndex<CATEGORY, ITEM>::item_array_t* LLInventoryIndex<CATEGORY, ITEM>::getChildItems(const LLUUID& id) const
+{
+	S32 slot = mCategoryTable.find(id);
+	return slot == LLUUIDSlotTable::NO_SLOT ? NULL : &getSlot(slot).mChildItems;
+}
+
+template <class CATEGORY, class ITEM>
+bool LLInventoryIndex<CATEGORY, ITEM>::linkCategory(CATEGORY* cat, const LLUUID& parent_id)
+{
+	S32 slot = mCategoryTable.find(parent_id);
+	if (slot == LLUUIDSlotTable::NO_SLOT)
+	{
+		return false;
+	}
+	getSlot(slot).mChildCategories.put(cat);
+	mLayoutDirty = true;
+	return true;
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::unlinkCategory(CATEGORY* cat, const LLUUID& parent_id)
+{
+	S32 slot = mCategoryTable.find(parent_id);
+	if (slot != LLUUIDSlotTable::NO_SLOT
+		&& getSlot(slot).mChildCategories.removeObj(cat) != cat_array_t::FAIL)
+	{
+		mLayoutDirty = true;
+	}
+}
+
+template <class CATEGORY, class ITEM>
+bool LLInventoryIndex<CATEGORY, ITEM>::linkItem(ITEM* item, const LLUUID& parent_id)
+{
+	S32 slot = mCategoryTable.find(parent_id);
+	if (slot == LLUUIDSlotTable::NO_SLOT)
+	{
+		return false;
+	}
+	getSlot(slot).mChildItems.put(item);
+	addSubtreeItems(slot, 1);
+	return true;
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::unlinkItem(ITEM* item, const LLUUID& parent_id)
+{
+	S32 slot = mCategoryTable.find(parent_id);
+	if (slot != LLUUIDSlotTable::NO_SLOT
+		&& getSlot(slot).mChildItems.removeObj(item) != item_array_t::FAIL)
+	{
+		addSubtreeItems(slot, -1);
+	}
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::addSubtreeItems(S32 slot, S32 count)
+{
+	// a dirty layout recounts everything anyway
+	if (mLayoutDirty || getSlot(slot).mEnter < 0)
+	{
+		return;
+	}
+	for (; slot >= 0; slot = getSlot(slot).mParent)
+	{
+		getSlot(slot).mSubtreeItems += count;
+	}
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::getAllCategories(cat_array_t& cats) const
+{
+	cats.reserve(cats.size() + mCategoryCount);
+	for (S32 slot = 0; slot < mSlotCount; ++slot)
+	{
+		const CategorySlot& cat_slot = getSlot(slot);
+		if (cat_slot.mCategory.notNull())
+		{
+			cats.push_back(cat_slot.mCategory);
+		}
+	}
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::getAllItems(item_array_t& items) const
+{
+	items.reserve(items.size() + mItemTable.size());
+	for (U32 i = 0; i < mItems.size(); ++i)
+	{
+		if (mItems[i].notNull())
+		{
+			items.push_back(mItems[i]);
+		}
+	}
+}
+
+template <class CATEGORY, class ITEM>
+void LLInventoryIndex<CATEGORY, ITEM>::updateLayout() const
+{
+	if (!mLayoutDirty)
+	{
+		return;
+	}
+	mLayoutDirty = false;
+	mPreorder.clear();
+	mPreorder.reserve(mSlotCount);
+
+	for (S32 slot = 0; slot < mSlotCount; ++slot)
+	{
+		CategorySlot& cat_slot = getSlot(slot);
+		cat_slot.mParent = -1;
+		cat_slot.mEnter = -1;
+		cat_slot.mExit = -1;
+	}
+	// a category listed by two parents belongs to the first
+	for (S32 slot = 0; slot < mSlotCount; ++slot)
+	{
+		const cat_array_t& children = getSlot(slot).mChildCategories;
+		for (S32 i = 0; i < children.count(); ++i)
+		{
+			S32 child = mCategoryTable.find(children[i]->getUUID());
+			if (child != LLUUIDSlotTable::NO_SLOT && child != slot && getSlot(child).mParent < 0)
+			{
+				getSlot(child).mParent = slot;
+			}
+		}
+	}
+
+	// Depth first from every category without a parent.  The stack
+	// holds (slot, next child) pairs.
+	std::vector<std::pair<S32, S32> > stack;
+	for (S32 root = 0; root < mSlotCount; ++root)
+	{
+		CategorySlot& root_slot = getSlot(root);
+		if (!root_slot.mLive || root_slot.mParent >= 0)
+		{
+			continue;
+		}
+		root_slot.mEnter = (S32)mPreorder.size();
+		root_slot.mSubtreeItems = root_slot.mChildItems.count();
+		mPreorder.push_back(root);
+		stack.push_back(std::make_pair(root, 0));
+		while (!stack.empty())
+		{
+			S32 slot = stack.back().first;
+			CategorySlot& cat_slot = getSlot(slot);
+			S32& next = stack.back().second;
+			if (next < cat_slot.mChildCategories.count())
+			{
+				S32 child = mCategoryTable.find(cat_slot.mChildCategories[next++]->getUUID());
+				if (child != LLUUIDSlotTable::NO_SLOT
+					&& getSlot(child).mParent == slot
+					&& getSlot(child).mEnter < 0)
+				{
+					CategorySlot& child_slot = getSlot(child);
+					child_slot.mEnter = (S32)mPreorder.size();
+					child_slot.mSubtreeItems = child_slot.mChildItems.count();
+					mPreorder.push_back(child);
+					stack.push_back(std::make_pair(child, 0));
+				}
+			}
+			else
+			{
+				cat_slot.mExit = (S32)mPreorder.size();
+				stack.pop_back();
+				if (!stack.empty())
+				{
+					getSlot(stack.back().first).mSubtreeItems += cat_slot.mSubtreeItems;
+				}
+			}
+		}
+	}
+}
+
+template <class CATEGORY, class ITEM>
+bool LLInventoryIndex<CATEGORY, ITEM>::isCategoryUnder(const LLUUID& id, const LLUUID& ancestor_id) const
+{
+	S32 slot = mCategoryTable.find(id);
+	S32 ancestor = mCategoryTable.find(ancestor_id);
+	if (slot == LLUUIDSlotTable::NO_SLOT || ancestor == LLUUIDSlotTable::NO_SLOT)
+	{
+		return false;
+	}
+	updateLayout();
+	S32 enter = getSlot(slot).mEnter;
+	const CategorySlot& ancestor_slot = getSlot(ancestor);
+	return enter >= 0 && ancestor_slot.mEnter >= 0
+		&& enter >= ancestor_slot.mEnter && enter < ancestor_slot.mExit;
+}
+
+template <class CATEGORY, class ITEM>
+bool LLInventoryIndex<CATEGORY, ITEM>::getDescendentCounts(const LLUUID& id, S32& categories, S32& items) const
+{
+	S32 slot = mCategoryTable.find(id);
+	if (slot == LLUUIDSlotTable::NO_SLOT)
+	{
+		return false;
+	}
+	updateLayout();
+	const CategorySlot& cat_slot = getSlot(slot);
+	if (cat_slot.mEnter < 0)
+	{
+		return false;
+	}
+	categories = cat_slot.mExit - cat_slot.mEnter - 1;
+	items = cat_slot.mSubtreeItems;
+	return true;
+}
+
+template <class CATEGORY, class ITEM>
+template <class FUNCTOR>
+void LLInventoryIndex<CATEGORY, ITEM>::collectDescendentsIf(const LLUUID& id, cat_array_t& cats, item_array_t& items,
+															 const LLUUID& skip_id, FUNCTOR& add, bool add_own_items) const
+{
+	S32 slot = mCategoryTable.find(id);
+	if (slot == LLUUIDSlotTable::NO_SLOT)
+	{
+		return;
+	}
+	updateLayout();
+	const CategorySlot& top = getSlot(slot);
+	if (top.mEnter < 0)
+	{
+		return;
+	}
+
+	// Categories whose items are still to come, innermost last
+	std::vector<S32> open;
+	for (S32 pos = top.mEnter + 1; pos < top.mExit; ++pos)
+	{
+		const CategorySlot& cat_slot = getSlot(mPreorder[pos]);
+		while (!open.empty() && getSlot(open.back()).mExit <= pos)
+		{
+			const item_array_t& children = getSlot(open.back()).mChildItems;
+			for (S32 i = 0; i < children.count(); ++i)
+			{
+				if (add(NULL, children[i]))
+				{
+					items.put(children[i]);
+				}
+			}
+			open.pop_back();
+		}
+
+		if (add(cat_slot.mCategory, NULL))
+		{
+			cats.put(cat_slot.mCategory);
+		}
+		if (cat_slot.mID == skip_id)
+		{
+			pos = cat_slot.mExit - 1;
+		}
+		else
+		{
+			open.push_back(mPreorder[pos]);
+		}
+	}
+	if (add_own_items)
+	{
+		open.insert(open.begin(), slot);
+	}
+	while (!open.empty())
+	{
+		const item_array_t& children = getSlot(open.back()).mChildItems;
+		for (S32 i = 0; i < children.count(); ++i)
+		{
+			if (add(NULL, children[i]))
+			{
+				items.put(children[i]);
+			}
+		}
+		open.pop_back();
+	}
+}
+
+#endif // LL_LLINVENTORYINDEX_H
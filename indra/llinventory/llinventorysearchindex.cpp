@@ -0,0 +1,219 @@
+/** 
+ * @file llinventorysearchindex.cpp
+ * @brief Name and attribute index for searching an inventory
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#include "linden_common.h"
+
+#include "llinventorysearchindex.h"
+
+#include <algorithm>
+#include <iterator>
+
+LLInventorySearchIndex::Entry::Entry()
+:	mInventoryType(LLInventoryType::IT_NONE),
+	mIsLink(FALSE),
+	mPermissions(PERM_NONE),
+	mCreationDate(0)
+{
+}
+
+///----------------------------------------------------------------------------
+/// Class LLInventorySearchIndex::Query
+///----------------------------------------------------------------------------
+
+LLInventorySearchIndex::Query::Query()
+:	mAllEntries(false),
+	mNext(0),
+	mDone(true)
+{
+}
+
+void LLInventorySearchIndex::Query::start(const LLInventorySearchIndex& index, const std::string& substring)
+{
+	mSubString = substring;
+	mCandidates.clear();
+	mNext = 0;
+	mDone = false;
+
+	trigrams_t trigrams;
+	getTrigrams(substring, trigrams);
+	mAllEntries = trigrams.empty();
+	if (mAllEntries)
+	{
+		return;
+	}
+
+	// Every match has all the trigrams, so the shortest list will do.
+	const std::vector<S32>* shortest = NULL;
+	for (trigrams_t::const_iterator it = trigrams.begin(); it != trigrams.end(); ++it)
+	{
+		postings_t::const_iterator found = index.mPostings.find(*it);
+		if (found == index.mPostings.end())
+		{
+			// nothing has this trigram, so nothing matches
+			mDone = true;
+			return;
+		}
+		if (!shortest || found->second.size() < shortest->size())
+		{
+			shortest = &found->second;
+		}
+	}
+	// a slot renamed back and forth can be listed twice
+	mCandidates = *shortest;
+	std::sort(mCandidates.begin(), mCandidates.end());
+	mCandidates.erase(std::unique(mCandidates.begin(), mCandidates.end()), mCandidates.end());
+}
+
+///----------------------------------------------------------------------------
+/// Class LLInventorySearchIndex
+///----------------------------------------------------------------------------
+
+LLInventorySearchIndex::LLInventorySearchIndex()
+:	mPostingCount(0),
+	mStalePostingCount(0)
+{
+}
+
+// static
+void LLInventorySearchIndex::getTrigrams(const std::string& name, trigrams_t& trigrams)
+{
+	trigrams.clear();
+	for (size_t i = 0; i + 3 <= name.size(); ++i)
+	{
+		trigrams.push_back(((U32)(U8)name[i] << 16) | ((U32)(U8)name[i + 1] << 8) | (U32)(U8)name[i + 2]);
+	}
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+}
+
+void LLInventorySearchIndex::addPostings(S32 slot, const trigrams_t& trigrams)
+{
+	for (trigrams_t::const_iterator it = trigrams.begin(); it != trigrams.end(); ++it)
+	{
+		mPostings[*it].push_back(slot);
+	}
+	mPostingCount += (S32)trigrams.size();
+}
+
+void LLInventorySearchIndex::rebuildPostings()
+{
+	mPostings.clear();
+	mPostingCount = 0;
+	mStalePostingCount = 0;
+	trigrams_t trigrams;
+	for (S32 slot = 0; slot < (S32)mEntries.size(); ++slot)
+	{
+		if (mEntries[slot].mID.notNull())
+		{
+			getTrigrams(mEntries[slot].mName, trigrams);
+			addPostings(slot, trigrams);
+		}
+	}
+}
+
+void LLInventorySearchIndex::update(const Entry& entry)
+{
+	S32 slot = mTable.find(entry.mID);
+	trigrams_t trigrams;
+	getTrigrams(entry.mName, trigrams);
+	if (slot == LLUUIDSlotTable::NO_SLOT)
+	{
+		if (!mFreeSlots.empty())
+		{
+			slot = mFreeSlots.back();
+			mFreeSlots.pop_back();
+		}
+		else
+		{
+			slot = (S32)mEntries.size();
+			mEntries.push_back(Entry());
+		}
+		mTable.insert(entry.mID, slot);
+		addPostings(slot, trigrams);
+	}
+	else if (mEntries[slot].mName != entry.mName)
+	{
+		// List the slot under the trigrams it gained.  The ones it
+		// lost go stale.
+		trigrams_t old_trigrams;
+		getTrigrams(mEntries[slot].mName, old_trigrams);
+		trigrams_t gained;
+		std::set_difference(trigrams.begin(), trigrams.end(),
+							old_trigrams.begin(), old_trigrams.end(),
+							std::back_inserter(gained));
+		addPostings(slot, gained);
+		mStalePostingCount += (S32)(old_trigrams.size() + gained.size() - trigrams.size());
+	}
+	mEntries[slot] = entry;
+
+	if (mStalePostingCount * 2 > mPostingCount)
+	{
+		rebuildPostings();
+	}
+}
+
+void LLInventorySearchIndex::remove(const LLUUID& id)
+{
+	S32 slot = mTable.find(id);
+	if (slot == LLUUIDSlotTable::NO_SLOT)
+	{
+		return;
+	}
+	trigrams_t trigrams;
+	getTrigrams(mEntries[slot].mName, trigrams);
+	mStalePostingCount += (S32)trigrams.size();
+	mEntries[slot] = Entry();
+	mTable.erase(id);
+	mFreeSlots.push_back(slot);
+
+	if (mStalePostingCount * 2 > mPostingCount)
+	{
+		rebuildPostings();
+	}
+}
+
+void LLInventorySearchIndex::clear()
+{
+	mTable.clear();
+	mEntries.clear();
+	mFreeSlots.clear();
+	mPostings.clear();
+	mPostingCount = 0;
+	mStalePostingCount = 0;
+}
+
+const LLInventorySearchIndex::Entry* LLInventorySearchIndex::getEntry(const LLUUID& id) const
+{
+	S32 slot = mTable.find(id);
+	return slot == LLUUIDSlotTable::NO_SLOT ? NULL : &mEntries[slot];
+}
@@ -0,0 +1,148 @@
+/** 
+ * @file llinventorysearchindex.h
+ * @brief Name and attribute index for searching an inventory
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#ifndef LL_LLINVENTORYSEARCHINDEX_H
+#define LL_LLINVENTORYSEARCHINDEX_H
+
+#include "llinventoryindex.h"
+#include "llinventorytype.h"
+#include "llpermissionsflags.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// What a search needs to know about every inventory object, without
+// the folder views that display them.  Names are indexed by their
+// trigrams, so a substring search only looks at the objects whose
+// names hold every three letters of it.
+class LLInventorySearchIndex
+{
+public:
+	struct Entry
+	{
+		Entry();
+
+		LLUUID mID;
+		LLUUID mParentID;
+		LLUUID mLinkedID;			// mID unless this is a link
+		std::string mName;			// upper case, as the folder views search it
+		LLInventoryType::EType mInventoryType;	// IT_CATEGORY for folders
+		BOOL mIsLink;
+		PermissionMask mPermissions;	// what the agent may do with it
+		time_t mCreationDate;
+	};
+
+	// A search that can be spread over several frames.  The index may
+	// change in between: removed entries are skipped and renamed ones
+	// are matched by their new names, but entries added after start()
+	// may be missed.
+	class Query
+	{
+	public:
+		Query();
+
+		// substring must be upper case, empty matches every entry.
+		void start(const LLInventorySearchIndex& index, const std::string& substring);
+		bool isDone() const { return mDone; }
+
+		// Offers entries whose names match to accept(entry) until
+		// max_checks entries have been looked at or accept() has
+		// returned true max_accepted times.  Returns true once every
+		// entry has been offered.
+		template <class FUNCTOR>
+		bool step(const LLInventorySearchIndex& index, S32 max_checks, S32 max_accepted, FUNCTOR& accept);
+
+	private:
+		std::string mSubString;
+		std::vector<S32> mCandidates;
+		bool mAllEntries;			// substring too short for the trigrams
+		S32 mNext;
+		bool mDone;
+	};
+
+	LLInventorySearchIndex();
+
+	// Adds the entry, or replaces the one with the same id
+	void update(const Entry& entry);
+	void remove(const LLUUID& id);
+	void clear();
+
+	const Entry* getEntry(const LLUUID& id) const;
+	S32 getEntryCount() const { return mTable.size(); }
+
+private:
+	friend class Query;
+	typedef std::vector<U32> trigrams_t;
+	typedef std::map<U32, std::vector<S32> > postings_t;
+
+	static void getTrigrams(const std::string& name, trigrams_t& trigrams);
+	void addPostings(S32 slot, const trigrams_t& trigrams);
+	void rebuildPostings();
+
+	LLUUIDSlotTable mTable;
+	std::vector<Entry> mEntries;	// a null mID marks a free slot
+	std::vector<S32> mFreeSlots;
+
+	// Entries by trigram.  Renames and removals leave stale slots
+	// behind, which searches check away; once they are the majority
+	// the postings are rebuilt.
+	postings_t mPostings;
+	S32 mPostingCount;
+	S32 mStalePostingCount;
+};
+
+template <class FUNCTOR>
+bool LLInventorySearchIndex::Query::step(const LLInventorySearchIndex& index, S32 max_checks, S32 max_accepted, FUNCTOR& accept)
+{
+	S32 end = mAllEntries ? (S32)index.mEntries.size() : (S32)mCandidates.size();
+	S32 accepted = 0;
+	for (; mNext < end && max_checks > 0 && accepted < max_accepted; ++mNext, --max_checks)
+	{
+		S32 slot = mAllEntries ? mNext : mCandidates[mNext];
+		if (slot >= (S32)index.mEntries.size())
+		{
+			continue;
+		}
+		const Entry& entry = index.mEntries[slot];
+		if (entry.mID.notNull()
+			&& (mSubString.empty() || entry.mName.find(mSubString) != std::string::npos)
+			&& accept(entry))
+		{
+			++accepted;
+		}
+	}
+	mDone = (mNext >= end);
+	return mDone;
+}
+
+#endif // LL_LLINVENTORYSEARCHINDEX_H
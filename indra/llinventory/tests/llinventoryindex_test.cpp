@@ -0,0 +1,482 @@
+/** 
+ * @file llinventoryindex_test.cpp
+ * @brief LLInventoryIndex tests and benchmark
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "../llinventoryindex.h"
+#include "../llinventory.h"
+#include "lltimer.h"
+#include <map>
+
+#include "../test/lltut.h"
+
+typedef LLInventoryIndex<LLInventoryCategory, LLInventoryItem> test_index_t;
+
+namespace
+{
+	struct AddAll
+	{
+		bool operator()(LLInventoryCategory*, LLInventoryItem*) { return true; }
+	};
+
+	// The std::map layout the viewer's inventory model used before it
+	// had LLInventoryIndex, to check against and time against.
+	struct MapInventory
+	{
+		typedef std::map<LLUUID, LLPointer<LLInventoryCategory> > cat_map_t;
+		typedef std::map<LLUUID, LLPointer<LLInventoryItem> > item_map_t;
+		typedef std::map<LLUUID, test_index_t::cat_array_t*> parent_cat_map_t;
+		typedef std::map<LLUUID, test_index_t::item_array_t*> parent_item_map_t;
+
+		~MapInventory()
+		{
+			for (parent_cat_map_t::iterator it = mParentChildCategoryTree.begin();
+				 it != mParentChildCategoryTree.end(); ++it)
+			{
+				delete it->second;
+			}
+			for (parent_item_map_t::iterator it = mParentChildItemTree.begin();
+				 it != mParentChildItemTree.end(); ++it)
+			{
+				delete it->second;
+			}
+		}
+
+		void addCategory(LLInventoryCategory* cat)
+		{
+			mCategoryMap[cat->getUUID()] = cat;
+			mParentChildCategoryTree[cat->getUUID()] = new test_index_t::cat_array_t;
+			mParentChildItemTree[cat->getUUID()] = new test_index_t::item_array_t;
+			if (mParentChildCategoryTree.count(cat->getParentUUID()))
+			{
+				mParentChildCategoryTree[cat->getParentUUID()]->put(cat);
+			}
+		}
+
+		void addItem(LLInventoryItem* item)
+		{
+			mItemMap[item->getUUID()] = item;
+			mParentChildItemTree[item->getParentUUID()]->put(item);
+		}
+
+		bool isDescendentOf(const LLUUID& obj_id, const LLUUID& cat_id) const
+		{
+			const LLInventoryObject* obj = NULL;
+			item_map_t::const_iterator item_it = mItemMap.find(obj_id);
+			if (item_it != mItemMap.end())
+			{
+				obj = item_it->second;
+			}
+			else
+			{
+				cat_map_t::const_iterator cat_it = mCategoryMap.find(obj_id);
+				obj = (cat_it == mCategoryMap.end()) ? NULL : cat_it->second.get();
+			}
+			while (obj)
+			{
+				const LLUUID& parent_id = obj->getParentUUID();
+				if (parent_id.isNull())
+				{
+					return false;
+				}
+				if (parent_id == cat_id)
+				{
+					return true;
+				}
+				cat_map_t::const_iterator cat_it = mCategoryMap.find(parent_id);
+				obj = (cat_it == mCategoryMap.end()) ? NULL : cat_it->second.get();
+			}
+			return false;
+		}
+
+		void collectDescendents(const LLUUID& id,
+								test_index_t::cat_array_t& cats,
+								test_index_t::item_array_t& items,
+								const LLUUID& skip_id) const
+		{
+			if (id == skip_id)
+			{
+				return;
+			}
+			parent_cat_map_t::const_iterator cat_it = mParentChildCategoryTree.find(id);
+			if (cat_it != mParentChildCategoryTree.end())
+			{
+				const test_index_t::cat_array_t& children = *cat_it->second;
+				for (S32 i = 0; i < children.count(); ++i)
+				{
+					cats.put(children[i]);
+					collectDescendents(children[i]->getUUID(), cats, items, skip_id);
+				}
+			}
+			parent_item_map_t::const_iterator item_it = mParentChildItemTree.find(id);
+			if (item_it != mParentChildItemTree.end())
+			{
+				const test_index_t::item_array_t& children = *item_it->second;
+				for (S32 i = 0; i < children.count(); ++i)
+				{
+					items.put(children[i]);
+				}
+			}
+		}
+
+		cat_map_t mCategoryMap;
+		item_map_t mItemMap;
+		parent_cat_map_t mParentChildCategoryTree;
+		parent_item_map_t mParentChildItemTree;
+	};
+
+	// A random tree of categories holding item_count items, about
+	// twenty to a category, under a root in the null id's arrays.
+	void make_inventory(S32 item_count,
+						std::vector<LLPointer<LLInventoryCategory> >& cats,
+						std::vector<LLPointer<LLInventoryItem> >& items)
+	{
+		S32 cat_count = llmax(1, item_count / 20);
+		for (S32 i = 0; i < cat_count; ++i)
+		{
+			LLUUID id;
+			id.generate();
+			// mostly shallow and wide, with some long chains
+			LLUUID parent_id;
+			if (i > 0)
+			{
+				S32 parent = (rand() % 4) ? rand() % llmin(i, 50) : i - 1;
+				parent_id = cats[parent]->getUUID();
+			}
+			cats.push_back(new LLInventoryCategory(id, parent_id, LLFolderType::FT_NONE,
+												   llformat("Folder %d", i)));
+		}
+		for (S32 i = 0; i < item_count; ++i)
+		{
+			LLPointer<LLInventoryItem> item = new LLInventoryItem;
+			LLUUID id;
+			id.generate();
+			item->setUUID(id);
+			item->setParent(cats[rand() % cat_count]->getUUID());
+			items.push_back(item);
+		}
+	}
+
+	void fill_index(test_index_t& index,
+					const std::vector<LLPointer<LLInventoryCategory> >& cats,
+					const std::vector<LLPointer<LLInventoryItem> >& items)
+	{
+		index.addChildArrays(LLUUID::null);
+		for (U32 i = 0; i < cats.size(); ++i)
+		{
+			index.addCategory(cats[i]);
+			index.linkCategory(cats[i], cats[i]->getParentUUID());
+		}
+		for (U32 i = 0; i < items.size(); ++i)
+		{
+			index.addItem(items[i]);
+			index.linkItem(items[i], items[i]->getParentUUID());
+		}
+	}
+
+	void fill_map(MapInventory& inventory,
+				  const std::vector<LLPointer<LLInventoryCategory> >& cats,
+				  const std::vector<LLPointer<LLInventoryItem> >& items)
+	{
+		inventory.mParentChildCategoryTree[LLUUID::null] = new test_index_t::cat_array_t;
+		inventory.mParentChildItemTree[LLUUID::null] = new test_index_t::item_array_t;
+		for (U32 i = 0; i < cats.size(); ++i)
+		{
+			inventory.addCategory(cats[i]);
+		}
+		for (U32 i = 0; i < items.size(); ++i)
+		{
+			inventory.addItem(items[i]);
+		}
+	}
+}
+
+namespace tut
+{
+	struct llinventoryindex_data
+	{
+	};
+	typedef test_group<llinventoryindex_data> llinventoryindex_test;
+	typedef llinventoryindex_test::object llinventoryindex_object;
+	tut::llinventoryindex_test llinventoryindex("llinventoryindex");
+
+	template<> template<>
+	void llinventoryindex_object::test<1>()
+	{
+		// LLUUIDSlotTable against std::map, through growth and erasure
+		LLUUIDSlotTable table;
+		std::map<LLUUID, S32> reference;
+		std::vector<LLUUID> ids;
+		for (S32 i = 0; i < 20000; ++i)
+		{
+			LLUUID id;
+			id.generate();
+			ids.push_back(id);
+			table.insert(id, i);
+			reference[id] = i;
+			if (i % 3 == 0)
+			{
+				const LLUUID& victim = ids[rand() % ids.size()];
+				ensure_equals("erase", table.erase(victim), reference.erase(victim) != 0);
+			}
+		}
+		ensure_equals("size", table.size(), (S32)reference.size());
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			std::map<LLUUID, S32>::iterator it = reference.find(ids[i]);
+			S32 expected = (it == reference.end()) ? (S32)LLUUIDSlotTable::NO_SLOT : it->second;
+			ensure_equals("find", table.find(ids[i]), expected);
+		}
+		LLUUID unknown;
+		unknown.generate();
+		ensure_equals("unknown id", table.find(unknown), (S32)LLUUIDSlotTable::NO_SLOT);
+		table.clear();
+		ensure_equals("cleared", table.find(ids[0]), (S32)LLUUIDSlotTable::NO_SLOT);
+	}
+
+	template<> template<>
+	void llinventoryindex_object::test<2>()
+	{
+		// ancestry and counts follow links and moves
+		LLUUID root_id, a_id, b_id, c_id, item_id;
+		root_id.generate();
+		a_id.generate();
+		b_id.generate();
+		c_id.generate();
+		item_id.generate();
+		LLPointer<LLInventoryCategory> root = new LLInventoryCategory(root_id, LLUUID::null, LLFolderType::FT_ROOT_INVENTORY, "root");
+		LLPointer<LLInventoryCategory> a = new LLInventoryCategory(a_id, root_id, LLFolderType::FT_NONE, "a");
+		LLPointer<LLInventoryCategory> b = new LLInventoryCategory(b_id, a_id, LLFolderType::FT_NONE, "b");
+		LLPointer<LLInventoryCategory> c = new LLInventoryCategory(c_id, root_id, LLFolderType::FT_NONE, "c");
+		LLPointer<LLInventoryItem> item = new LLInventoryItem;
+		item->setUUID(item_id);
+		item->setParent(b_id);
+
+		test_index_t index;
+		index.addChildArrays(LLUUID::null);
+		index.addCategory(root);
+		index.addCategory(a);
+		index.addCategory(b);
+		index.addCategory(c);
+		index.addItem(item);
+		ensure("link root", index.linkCategory(root, LLUUID::null));
+		ensure("link a", index.linkCategory(a, root_id));
+		ensure("link b", index.linkCategory(b, a_id));
+		ensure("link c", index.linkCategory(c, root_id));
+		ensure("link item", index.linkItem(item, b_id));
+		ensure("no arrays", !index.linkItem(item, item_id));
+
+		ensure_equals("categories", index.getCategoryCount(), 4);
+		ensure_equals("items", index.getItemCount(), 1);
+		ensure("getItem", index.getItem(item_id) == item.get());
+		ensure("getCategory", index.getCategory(b_id) == b.get());
+		ensure("b under a", index.isCategoryUnder(b_id, a_id));
+		ensure("b under itself", index.isCategoryUnder(b_id, b_id));
+		ensure("a not under b", !index.isCategoryUnder(a_id, b_id));
+		ensure("b not under c", !index.isCategoryUnder(b_id, c_id));
+
+		S32 cat_count = 0, item_count = 0;
+		ensure("root counts", index.getDescendentCounts(root_id, cat_count, item_count));
+		ensure_equals("root categories", cat_count, 3);
+		ensure_equals("root items", item_count, 1);
+
+		// an item added to a laid out tree updates the counts above it
+		LLPointer<LLInventoryItem> item2 = new LLInventoryItem;
+		LLUUID item2_id;
+		item2_id.generate();
+		item2->setUUID(item2_id);
+		index.addItem(item2);
+		index.linkItem(item2, a_id);
+		index.getDescendentCounts(root_id, cat_count, item_count);
+		ensure_equals("root items after add", item_count, 2);
+		index.getDescendentCounts(a_id, cat_count, item_count);
+		ensure_equals("a items after add", item_count, 2);
+		index.unlinkItem(item, b_id);
+		index.removeItem(item_id);
+		index.getDescendentCounts(a_id, cat_count, item_count);
+		ensure_equals("a items after remove", item_count, 1);
+		ensure("removed item", index.getItem(item_id) == NULL);
+
+		// move b under c
+		index.unlinkCategory(b, a_id);
+		index.linkCategory(b, c_id);
+		ensure("b under c", index.isCategoryUnder(b_id, c_id));
+		ensure("b no longer under a", !index.isCategoryUnder(b_id, a_id));
+		index.getDescendentCounts(a_id, cat_count, item_count);
+		ensure_equals("a categories after move", cat_count, 0);
+
+		// remove c and what is under it
+		index.unlinkCategory(c, root_id);
+		index.unlinkCategory(b, c_id);
+		index.removeCategory(b_id);
+		index.removeCategory(c_id);
+		ensure("removed category", index.getCategory(c_id) == NULL);
+		ensure("removed arrays", index.getChildItems(c_id) == NULL);
+		ensure_equals("categories after remove", index.getCategoryCount(), 2);
+		index.getDescendentCounts(root_id, cat_count, item_count);
+		ensure_equals("root categories after remove", cat_count, 1);
+	}
+
+	template<> template<>
+	void llinventoryindex_object::test<3>()
+	{
+		// walks and ancestry match the std::map inventory exactly
+		std::vector<LLPointer<LLInventoryCategory> > cats;
+		std::vector<LLPointer<LLInventoryItem> > items;
+		make_inventory(20000, cats, items);
+		test_index_t index;
+		fill_index(index, cats, items);
+		MapInventory reference;
+		fill_map(reference, cats, items);
+
+		const LLUUID& root_id = cats[0]->getUUID();
+		const LLUUID& skip_id = cats[3]->getUUID();
+		AddAll add_all;
+		test_index_t::cat_array_t index_cats, map_cats;
+		test_index_t::item_array_t index_items, map_items;
+		index.collectDescendentsIf(root_id, index_cats, index_items, skip_id, add_all);
+		reference.collectDescendents(root_id, map_cats, map_items, skip_id);
+		ensure("categories in order", index_cats == map_cats);
+		ensure("items in order", index_items == map_items);
+
+		for (S32 i = 0; i < 2000; ++i)
+		{
+			const LLUUID& obj_id = (i & 1) ? items[rand() % items.size()]->getUUID()
+										   : cats[rand() % cats.size()]->getUUID();
+			const LLUUID& cat_id = cats[rand() % 60]->getUUID();
+			bool expected = reference.isDescendentOf(obj_id, cat_id);
+			bool found = index.getItem(obj_id)
+				? index.isCategoryUnder(index.getItem(obj_id)->getParentUUID(), cat_id)
+				: (obj_id != cat_id && index.isCategoryUnder(obj_id, cat_id));
+			ensure_equals("descendent", found, expected);
+		}
+
+		S32 cat_count = 0, item_count = 0;
+		index.getDescendentCounts(root_id, cat_count, item_count);
+		ensure_equals("all categories", cat_count, (S32)cats.size() - 1);
+		ensure_equals("all items", item_count, (S32)items.size());
+	}
+
+	template<> template<>
+	void llinventoryindex_object::test<4>()
+	{
+		// timings over a 250k item inventory, index against std::map
+		const S32 ITEM_COUNT = 250000;
+		const S32 QUERIES = 100000;
+		std::vector<LLPointer<LLInventoryCategory> > cats;
+		std::vector<LLPointer<LLInventoryItem> > items;
+		make_inventory(ITEM_COUNT, cats, items);
+		std::vector<LLUUID> query_ids;
+		for (S32 i = 0; i < QUERIES; ++i)
+		{
+			query_ids.push_back(items[rand() % items.size()]->getUUID());
+		}
+		const LLUUID& root_id = cats[0]->getUUID();
+		const LLUUID& ancestor_id = cats[1]->getUUID();
+		AddAll add_all;
+
+		LLTimer timer;
+		F64 map_build, map_lookup, map_collect, map_ancestry;
+		S32 map_found = 0, map_under = 0;
+		{
+			MapInventory reference;
+			timer.reset();
+			fill_map(reference, cats, items);
+			map_build = timer.getElapsedTimeF64();
+
+			timer.reset();
+			for (S32 i = 0; i < QUERIES; ++i)
+			{
+				map_found += reference.mItemMap.count(query_ids[i]);
+			}
+			map_lookup = timer.getElapsedTimeF64();
+
+			timer.reset();
+			test_index_t::cat_array_t found_cats;
+			test_index_t::item_array_t found_items;
+			reference.collectDescendents(root_id, found_cats, found_items, LLUUID::null);
+			map_collect = timer.getElapsedTimeF64();
+
+			timer.reset();
+			for (S32 i = 0; i < QUERIES; ++i)
+			{
+				map_under += reference.isDescendentOf(query_ids[i], ancestor_id);
+			}
+			map_ancestry = timer.getElapsedTimeF64();
+		}
+
+		F64 index_build, index_lookup, index_collect, index_ancestry;
+		S32 index_found = 0, index_under = 0;
+		{
+			test_index_t index;
+			timer.reset();
+			fill_index(index, cats, items);
+			S32 cat_count, item_count;
+			index.getDescendentCounts(root_id, cat_count, item_count);
+			index_build = timer.getElapsedTimeF64();
+
+			timer.reset();
+			for (S32 i = 0; i < QUERIES; ++i)
+			{
+				index_found += (index.getItem(query_ids[i]) != NULL);
+			}
+			index_lookup = timer.getElapsedTimeF64();
+
+			timer.reset();
+			test_index_t::cat_array_t found_cats;
+			test_index_t::item_array_t found_items;
+			found_cats.reserve(cat_count);
+			found_items.reserve(item_count);
+			index.collectDescendentsIf(root_id, found_cats, found_items, LLUUID::null, add_all);
+			index_collect = timer.getElapsedTimeF64();
+
+			timer.reset();
+			for (S32 i = 0; i < QUERIES; ++i)
+			{
+				const LLInventoryItem* item = index.getItem(query_ids[i]);
+				index_under += index.isCategoryUnder(item->getParentUUID(), ancestor_id);
+			}
+			index_ancestry = timer.getElapsedTimeF64();
+		}
+
+		llinfos << ITEM_COUNT << " items in " << cats.size() << " categories."
+				<< " std::map build: " << map_build << "s lookup: " << map_lookup
+				<< "s collect: " << map_collect << "s ancestry: " << map_ancestry << "s."
+				<< " LLInventoryIndex build: " << index_build << "s lookup: " << index_lookup
+				<< "s collect: " << index_collect << "s ancestry: " << index_ancestry << "s"
+				<< llendl;
+		ensure_equals("same lookups", index_found, map_found);
+		ensure_equals("same ancestry", index_under, map_under);
+	}
+}
@@ -0,0 +1,176 @@
+/** 
+ * @file llinventorysearchindex_test.cpp
+ * @brief LLInventorySearchIndex tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#include "linden_common.h"
+
+#include "../llinventorysearchindex.h"
+#include "llstring.h"
+#include <set>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	struct CollectIDs
+	{
+		bool operator()(const LLInventorySearchIndex::Entry& entry)
+		{
+			mIDs.insert(entry.mID);
+			return true;
+		}
+		std::set<LLUUID> mIDs;
+	};
+
+	std::string random_name()
+	{
+		static const char* words[] = { "RED", "BLUE", "HAT", "SHIRT", "BOX", "TEXTURE", "SCRIPT", "SKIRT", "JACKET", "BOOTS" };
+		std::string name;
+		S32 count = 1 + rand() % 3;
+		for (S32 i = 0; i < count; ++i)
+		{
+			if (i) name += " ";
+			name += words[rand() % 10];
+		}
+		return name;
+	}
+}
+
+namespace tut
+{
+	struct llinventorysearchindex_data
+	{
+		LLInventorySearchIndex mIndex;
+		std::map<LLUUID, std::string> mNames;
+
+		void add(S32 count)
+		{
+			for (S32 i = 0; i < count; ++i)
+			{
+				LLInventorySearchIndex::Entry entry;
+				entry.mID.generate();
+				entry.mName = random_name();
+				mIndex.update(entry);
+				mNames[entry.mID] = entry.mName;
+			}
+		}
+
+		// the query against a plain scan of every name
+		void check(const std::string& substring)
+		{
+			std::set<LLUUID> expected;
+			for (std::map<LLUUID, std::string>::iterator it = mNames.begin(); it != mNames.end(); ++it)
+			{
+				if (it->second.find(substring) != std::string::npos)
+				{
+					expected.insert(it->first);
+				}
+			}
+			LLInventorySearchIndex::Query query;
+			query.start(mIndex, substring);
+			CollectIDs collect;
+			while (!query.step(mIndex, 37, 1000, collect))
+			{
+			}
+			ensure("matches for '" + substring + "'", collect.mIDs == expected);
+		}
+	};
+	typedef test_group<llinventorysearchindex_data> llinventorysearchindex_test;
+	typedef llinventorysearchindex_test::object llinventorysearchindex_object;
+	tut::llinventorysearchindex_test llinventorysearchindex("llinventorysearchindex");
+
+	template<> template<>
+	void llinventorysearchindex_object::test<1>()
+	{
+		// substrings short and long, present and not
+		add(2000);
+		check("");
+		check("R");
+		check("HA");
+		check("HAT");
+		check("SKIRT");
+		check("T B");
+		check("BLUE HAT");
+		check("GREEN");
+		ensure_equals("entries", mIndex.getEntryCount(), 2000);
+	}
+
+	template<> template<>
+	void llinventorysearchindex_object::test<2>()
+	{
+		// renames and removals, enough to rebuild the postings
+		add(1000);
+		for (S32 round = 0; round < 5; ++round)
+		{
+			std::vector<LLUUID> ids;
+			for (std::map<LLUUID, std::string>::iterator it = mNames.begin(); it != mNames.end(); ++it)
+			{
+				ids.push_back(it->first);
+			}
+			for (U32 i = 0; i < ids.size(); i += 3)
+			{
+				LLInventorySearchIndex::Entry entry = *mIndex.getEntry(ids[i]);
+				entry.mName = random_name();
+				mIndex.update(entry);
+				mNames[entry.mID] = entry.mName;
+			}
+			for (U32 i = 1; i < ids.size(); i += 7)
+			{
+				mIndex.remove(ids[i]);
+				mNames.erase(ids[i]);
+			}
+			add(200);
+			check("SHIRT");
+			check("RED BOX");
+			check("OOT");
+		}
+		ensure_equals("entries", mIndex.getEntryCount(), (S32)mNames.size());
+		ensure("removed entry", mIndex.getEntry(LLUUID::null) == NULL);
+	}
+
+	template<> template<>
+	void llinventorysearchindex_object::test<3>()
+	{
+		// steps stop at the accept limit and pick up where they left off
+		add(500);
+		LLInventorySearchIndex::Query query;
+		query.start(mIndex, "");
+		CollectIDs collect;
+		ensure("not done after one step", !query.step(mIndex, 1000, 10, collect));
+		ensure_equals("accepted per step", (S32)collect.mIDs.size(), 10);
+		while (!query.step(mIndex, 1000, 10, collect))
+		{
+		}
+		ensure_equals("all entries", (S32)collect.mIDs.size(), 500);
+		ensure("done", query.isDone());
+	}
+}
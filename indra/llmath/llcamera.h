@@ -144,7 +144,10 @@ private:
 public:
 	LLVector3 mAgentFrustum[8];  //8 corners of 6-plane frustum
 	F32	mFrustumCornerDist;		//distance to corner of frustum against far clip plane
-	LLPlane getAgentPlane(U32 idx) { return mAgentPlanes[idx].p; }
+	LLPlane getAgentPlane(U32 idx) const { return mAgentPlanes[idx].p; }
+	// octant of the box corner furthest behind the plane, 0xff if ignored
+	U8 getAgentPlaneMask(U32 idx) const { return mAgentPlanes[idx].mask; }
+	U32 getPlaneCount() const { return mPlaneCount; }
 
 public:
 	LLCamera();
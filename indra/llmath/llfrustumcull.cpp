@@ -0,0 +1,204 @@
+/** 
+ * @file llfrustumcull.cpp
+ * @brief Frustum tests for many axis aligned boxes at once
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "llfrustumcull.h"
+
+#include "llcamera.h"
+#include "llmemory.h"
+#include "llsys.h"
+#include "v3math.h"
+
+bool LLFrustumCuller::sVectorize = false;
+
+//----------------------------------------------------------------------------
+
+LLAABBStreams::LLAABBStreams()
+:	mData(NULL),
+	mCount(0),
+	mCapacity(0)
+{
+}
+
+LLAABBStreams::~LLAABBStreams()
+{
+	ll_aligned_free_16(mData);
+}
+
+void LLAABBStreams::resize(U32 count)
+{
+	U32 padded = (count + 3) & ~3;
+	if (padded > mCapacity)
+	{
+		U32 capacity = llmax(padded, mCapacity * 2);
+		F32* data = (F32*)ll_aligned_malloc_16(sizeof(F32) * NUM_STREAMS * capacity);
+		memset(data, 0, sizeof(F32) * NUM_STREAMS * capacity);
+		for (U32 s = 0; s < NUM_STREAMS && mCount; ++s)
+		{
+			memcpy(data + s * capacity, mData + s * mCapacity, sizeof(F32) * mCount);
+		}
+		ll_aligned_free_16(mData);
+		mData = data;
+		mCapacity = capacity;
+	}
+	else
+	{
+		// clear what is dropped so padding stays empty
+		for (U32 s = 0; s < NUM_STREAMS && count < mCount; ++s)
+		{
+			memset(mData + s * mCapacity + count, 0, sizeof(F32) * (mCount - count));
+		}
+	}
+	mCount = count;
+}
+
+void LLAABBStreams::set(U32 index, const LLVector3& center, const LLVector3& radius)
+{
+	llassert(index < mCount);
+	F32* data = mData + index;
+	data[CENTER_X * mCapacity] = center.mV[VX];
+	data[CENTER_Y * mCapacity] = center.mV[VY];
+	data[CENTER_Z * mCapacity] = center.mV[VZ];
+	data[RADIUS_X * mCapacity] = radius.mV[VX];
+	data[RADIUS_Y * mCapacity] = radius.mV[VY];
+	data[RADIUS_Z * mCapacity] = radius.mV[VZ];
+}
+
+void LLAABBStreams::get(U32 index, LLVector3& center, LLVector3& radius) const
+{
+	llassert(index < mCount);
+	const F32* data = mData + index;
+	center.setVec(data[CENTER_X * mCapacity], data[CENTER_Y * mCapacity], data[CENTER_Z * mCapacity]);
+	radius.setVec(data[RADIUS_X * mCapacity], data[RADIUS_Y * mCapacity], data[RADIUS_Z * mCapacity]);
+}
+
+//----------------------------------------------------------------------------
+
+LLFrustumCuller::LLFrustumCuller(const LLCamera& camera, bool far_clip)
+:	mNumPlanes(0)
+{
+	U32 plane_count = llmin(camera.getPlaneCount(), (U32)MAX_PLANES);
+	for (U32 i = 0; i < plane_count; i++)
+	{
+		U8 mask = camera.getAgentPlaneMask(i);
+		if (mask == 0xff || (i == LLCamera::AGENT_PLANE_FAR && !far_clip))
+		{
+			continue;
+		}
+		LLPlane p = camera.getAgentPlane(i);
+		Plane& plane = mPlanes[mNumPlanes++];
+		plane.mNormal[0] = p.mV[VX];
+		plane.mNormal[1] = p.mV[VY];
+		plane.mNormal[2] = p.mV[VZ];
+		plane.mNegD = -p.mV[VW];
+		// the corner LLCamera picks with its scaler table
+		plane.mSign[0] = (mask & 1) ? 1.f : -1.f;
+		plane.mSign[1] = (mask & 2) ? 1.f : -1.f;
+		plane.mSign[2] = (mask & 4) ? 1.f : -1.f;
+		plane.mPad = 0.f;
+	}
+}
+
+void LLFrustumCuller::test(const LLAABBStreams& boxes, U32 first, U32 count, U8* results) const
+{
+	llassert((first & 3) == 0 && (count & 3) == 0 && first + count <= boxes.paddedSize());
+	if (sVectorize)
+	{
+		testSSE2(mPlanes, mNumPlanes, boxes, first, count, results);
+	}
+	else
+	{
+		testScalar(mPlanes, mNumPlanes, boxes, first, count, results);
+	}
+}
+
+//static
+void LLFrustumCuller::setVectorize(bool vectorize)
+{
+	sVectorize = vectorize && hasSSE2Kernels() && gSysCPU.hasSSE2();
+}
+
+// Same operations in the same order as LLCamera::AABBInFrustum():
+// minp = center - radius * sign, then n * minp > -d.
+//static
+void LLFrustumCuller::testScalar(const Plane* planes, U32 num_planes, const LLAABBStreams& boxes, U32 first, U32 count, U8* results)
+{
+	const F32* cx = boxes.getStream(LLAABBStreams::CENTER_X);
+	const F32* cy = boxes.getStream(LLAABBStreams::CENTER_Y);
+	const F32* cz = boxes.getStream(LLAABBStreams::CENTER_Z);
+	const F32* rx = boxes.getStream(LLAABBStreams::RADIUS_X);
+	const F32* ry = boxes.getStream(LLAABBStreams::RADIUS_Y);
+	const F32* rz = boxes.getStream(LLAABBStreams::RADIUS_Z);
+
+	for (U32 i = first; i < first + count; ++i)
+	{
+		U8 result = 2;
+		for (U32 p = 0; p < num_planes; ++p)
+		{
+			const Plane& plane = planes[p];
+			F32 sx = rx[i] * plane.mSign[0];
+			F32 sy = ry[i] * plane.mSign[1];
+			F32 sz = rz[i] * plane.mSign[2];
+
+			F32 min_dist = plane.mNormal[0] * (cx[i] - sx) + plane.mNormal[1] * (cy[i] - sy) + plane.mNormal[2] * (cz[i] - sz);
+			if (min_dist > plane.mNegD)
+			{
+				result = 0;
+				break;
+			}
+
+			F32 max_dist = plane.mNormal[0] * (cx[i] + sx) + plane.mNormal[1] * (cy[i] + sy) + plane.mNormal[2] * (cz[i] + sz);
+			if (max_dist > plane.mNegD)
+			{
+				result = 1;
+			}
+		}
+		*results++ = result;
+	}
+}
+
+//----------------------------------------------------------------------------
+
+void LLFrustumCullResults::begin(const LLFrustumCuller* culler, const LLAABBStreams* boxes)
+{
+	mCuller = culler;
+	mBoxes = boxes;
+	U32 padded = boxes->paddedSize();
+	if (mResults.size() < padded)
+	{
+		mResults.resize(padded);
+	}
+	mTested.assign(padded >> 2, 0);
+}
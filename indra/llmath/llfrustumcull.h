@@ -0,0 +1,151 @@
+/** 
+ * @file llfrustumcull.h
+ * @brief Frustum tests for many axis aligned boxes at once
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#ifndef LL_LLFRUSTUMCULL_H
+#define LL_LLFRUSTUMCULL_H
+
+#include <vector>
+
+class LLCamera;
+class LLVector3;
+
+// Axis aligned boxes as center and half size streams, one stream per
+// component, 16 byte aligned and padded to a multiple of four boxes.
+class LLAABBStreams
+{
+public:
+	enum
+	{
+		CENTER_X = 0,
+		CENTER_Y,
+		CENTER_Z,
+		RADIUS_X,
+		RADIUS_Y,
+		RADIUS_Z,
+		NUM_STREAMS
+	};
+
+	LLAABBStreams();
+	~LLAABBStreams();
+
+	// Keeps the boxes below count; new boxes are empty boxes at the origin.
+	void resize(U32 count);
+	void clear() { resize(0); }
+	U32 size() const { return mCount; }
+	// Boxes in the streams including padding, a multiple of four.
+	U32 paddedSize() const { return (mCount + 3) & ~3; }
+
+	void set(U32 index, const LLVector3& center, const LLVector3& radius);
+	void get(U32 index, LLVector3& center, LLVector3& radius) const;
+
+	const F32* getStream(U32 stream) const { return mData + stream * mCapacity; }
+
+private:
+	LLAABBStreams(const LLAABBStreams&);
+	LLAABBStreams& operator=(const LLAABBStreams&);
+
+	F32* mData;
+	U32 mCount;
+	U32 mCapacity;
+};
+
+// The agent space planes of an LLCamera, ready to test LLAABBStreams four
+// boxes at a time.  Results are those of LLCamera::AABBInFrustum(), or of
+// AABBInFrustumNoFarClip() when built without the far plane: 0 outside,
+// 1 partly inside, 2 inside.
+class LLFrustumCuller
+{
+public:
+	LLFrustumCuller(const LLCamera& camera, bool far_clip);
+
+	// Tests boxes [first, first + count), first and count multiples of
+	// four, writing one result per box.
+	void test(const LLAABBStreams& boxes, U32 first, U32 count, U8* results) const;
+
+	// Use the SSE2 kernel.  No effect if the CPU or the build lacks SSE2.
+	static void setVectorize(bool vectorize);
+	static bool getVectorize() { return sVectorize; }
+
+	// A plane with the corner signs LLCamera keeps as a mask.
+	struct Plane
+	{
+		F32 mNormal[3];
+		F32 mNegD;			// -d, the compare is n.p > -d
+		F32 mSign[3];		// +/-1, the box corner facing away from the plane
+		F32 mPad;
+	};
+
+private:
+	// The kernels, the SSE2 version is in llfrustumcull_sse2.cpp
+	static void testScalar(const Plane* planes, U32 num_planes, const LLAABBStreams& boxes, U32 first, U32 count, U8* results);
+	static void testSSE2(const Plane* planes, U32 num_planes, const LLAABBStreams& boxes, U32 first, U32 count, U8* results);
+	static bool hasSSE2Kernels();
+
+	enum { MAX_PLANES = 7 };
+	Plane mPlanes[MAX_PLANES];
+	U32 mNumPlanes;
+
+	static bool sVectorize;
+};
+
+// Results of an LLFrustumCuller over an LLAABBStreams, tested a block of
+// four boxes at a time on first use.  A traversal that skips the subtrees
+// of boxes that are outside or fully inside never pays for their tests.
+// Keep one around to reuse its buffers.
+class LLFrustumCullResults
+{
+public:
+	LLFrustumCullResults() : mCuller(NULL), mBoxes(NULL) {}
+
+	void begin(const LLFrustumCuller* culler, const LLAABBStreams* boxes);
+
+	S32 get(U32 index)
+	{
+		U32 block = index >> 2;
+		if (!mTested[block])
+		{
+			mCuller->test(*mBoxes, block << 2, 4, &mResults[block << 2]);
+			mTested[block] = 1;
+		}
+		return mResults[index];
+	}
+
+private:
+	const LLFrustumCuller* mCuller;
+	const LLAABBStreams* mBoxes;
+	std::vector<U8> mResults;
+	std::vector<U8> mTested;
+};
+
+#endif // LL_LLFRUSTUMCULL_H
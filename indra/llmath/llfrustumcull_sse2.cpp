@@ -0,0 +1,138 @@
+/** 
+ * @file llfrustumcull_sse2.cpp
+ * @brief SSE2 frustum test kernel.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+#include "linden_common.h"
+
+#include "llfrustumcull.h"
+
+#if (LL_GNUC && defined(__SSE2__)) || (LL_MSVC && (defined(_M_IX86) || defined(_M_X64)))
+#define LL_FRUSTUMCULL_SSE2 1
+#else
+#define LL_FRUSTUMCULL_SSE2 0
+#endif
+
+#if LL_FRUSTUMCULL_SSE2
+
+#include <emmintrin.h>
+
+// Four boxes at a time, each lane doing the same operations in the same
+// order as LLFrustumCuller::testScalar().  Unlike the scalar loop, a block
+// keeps testing planes until all four lanes are outside.
+
+//static
+bool LLFrustumCuller::hasSSE2Kernels()
+{
+	return true;
+}
+
+//static
+void LLFrustumCuller::testSSE2(const Plane* planes, U32 num_planes, const LLAABBStreams& boxes, U32 first, U32 count, U8* results)
+{
+	const F32* cx = boxes.getStream(LLAABBStreams::CENTER_X);
+	const F32* cy = boxes.getStream(LLAABBStreams::CENTER_Y);
+	const F32* cz = boxes.getStream(LLAABBStreams::CENTER_Z);
+	const F32* rx = boxes.getStream(LLAABBStreams::RADIUS_X);
+	const F32* ry = boxes.getStream(LLAABBStreams::RADIUS_Y);
+	const F32* rz = boxes.getStream(LLAABBStreams::RADIUS_Z);
+
+	for (U32 i = first; i < first + count; i += 4)
+	{
+		__m128 center_x = _mm_load_ps(cx + i);
+		__m128 center_y = _mm_load_ps(cy + i);
+		__m128 center_z = _mm_load_ps(cz + i);
+		__m128 radius_x = _mm_load_ps(rx + i);
+		__m128 radius_y = _mm_load_ps(ry + i);
+		__m128 radius_z = _mm_load_ps(rz + i);
+
+		__m128 outside = _mm_setzero_ps();
+		__m128 partial = _mm_setzero_ps();
+		for (U32 p = 0; p < num_planes; ++p)
+		{
+			const Plane& plane = planes[p];
+			__m128 nx = _mm_set1_ps(plane.mNormal[0]);
+			__m128 ny = _mm_set1_ps(plane.mNormal[1]);
+			__m128 nz = _mm_set1_ps(plane.mNormal[2]);
+			__m128 neg_d = _mm_set1_ps(plane.mNegD);
+
+			__m128 sx = _mm_mul_ps(radius_x, _mm_set1_ps(plane.mSign[0]));
+			__m128 sy = _mm_mul_ps(radius_y, _mm_set1_ps(plane.mSign[1]));
+			__m128 sz = _mm_mul_ps(radius_z, _mm_set1_ps(plane.mSign[2]));
+
+			__m128 min_dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_sub_ps(center_x, sx)),
+													_mm_mul_ps(ny, _mm_sub_ps(center_y, sy))),
+										 _mm_mul_ps(nz, _mm_sub_ps(center_z, sz)));
+			outside = _mm_or_ps(outside, _mm_cmpgt_ps(min_dist, neg_d));
+
+			__m128 max_dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_add_ps(center_x, sx)),
+													_mm_mul_ps(ny, _mm_add_ps(center_y, sy))),
+										 _mm_mul_ps(nz, _mm_add_ps(center_z, sz)));
+			partial = _mm_or_ps(partial, _mm_cmpgt_ps(max_dist, neg_d));
+
+			if (_mm_movemask_ps(outside) == 0xf)
+			{
+				break;
+			}
+		}
+
+		S32 outside_mask = _mm_movemask_ps(outside);
+		S32 partial_mask = _mm_movemask_ps(partial);
+		for (U32 lane = 0; lane < 4; ++lane)
+		{
+			*results++ = (outside_mask & (1 << lane)) ? 0 : ((partial_mask & (1 << lane)) ? 1 : 2);
+		}
+	}
+}
+
+#else // LL_FRUSTUMCULL_SSE2
+
+// Never called: LLFrustumCuller::setVectorize() checks hasSSE2Kernels()
+
+//static
+bool LLFrustumCuller::hasSSE2Kernels()
+{
+	return false;
+}
+
+//static
+void LLFrustumCuller::testSSE2(const Plane* planes, U32 num_planes, const LLAABBStreams& boxes, U32 first, U32 count, U8* results)
+{
+	llerrs << "SSE2 kernels not built" << llendl;
+}
+
+#endif // LL_FRUSTUMCULL_SSE2
@@ -58,6 +58,7 @@ public:
 	void				multiply(const LLVector3 &a, LLVector3& out) const;
 	void				multiply(const LLVector4 &a, LLV4Vector3& out) const;
 	void				multiply(const LLVector3 &a, LLV4Vector3& out) const;
+	void				multiply(const LLV4Vector3 &a, LLV4Vector3& out) const;
 
 	const LLV4Matrix3&	transpose();
 	const LLV4Matrix3&	operator=(const LLMatrix3& a);
@@ -110,6 +111,13 @@ inline void LLV4Matrix3::multiply(const LLVector3 &a, LLV4Vector3& o) const
 	o.v = _mm_add_ps(o.v  , _mm_mul_ps(_mm_set1_ps(a.mV[VZ]), mV[VZ]));
 }
 
+inline void LLV4Matrix3::multiply(const LLV4Vector3 &a, LLV4Vector3& o) const
+{
+	o.v =					_mm_mul_ps(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(0,0,0,0)), mV[VX]); // ( ax * vx ) + ...
+	o.v = _mm_add_ps(o.v  , _mm_mul_ps(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1,1,1,1)), mV[VY]));
+	o.v = _mm_add_ps(o.v  , _mm_mul_ps(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2,2,2,2)), mV[VZ]));
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // LLV4Matrix3
@@ -178,6 +186,21 @@ inline void LLV4Matrix3::multiply(const LLVector3 &a, LLV4Vector3& o) const
 					a.mV[VZ] * mMatrix[VZ][VZ]);
 }
 
+inline void LLV4Matrix3::multiply(const LLV4Vector3 &a, LLV4Vector3& o) const
+{
+	o.setVec(		a.mV[VX] * mMatrix[VX][VX] + 
+					a.mV[VY] * mMatrix[VY][VX] + 
+					a.mV[VZ] * mMatrix[VZ][VX],
+					 
+					a.mV[VX] * mMatrix[VX][VY] + 
+					a.mV[VY] * mMatrix[VY][VY] + 
+					a.mV[VZ] * mMatrix[VZ][VY],
+					 
+					a.mV[VX] * mMatrix[VX][VZ] + 
+					a.mV[VY] * mMatrix[VY][VZ] + 
+					a.mV[VZ] * mMatrix[VZ][VZ]);
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // LLV4Matrix3
@@ -57,6 +57,7 @@ public:
 	void				lerp(const LLV4Matrix4 &a, const LLV4Matrix4 &b, const F32 &w);
 	void				multiply(const LLVector3 &a, LLVector3& o) const;
 	void				multiply(const LLVector3 &a, LLV4Vector3& o) const;
+	void				multiply(const LLV4Vector3 &a, LLV4Vector3& o) const;
 
 	const LLV4Matrix4&	transpose();
 	const LLV4Matrix4&  translate(const LLVector3 &vec);
@@ -104,6 +105,13 @@ inline void LLV4Matrix4::multiply(const LLVector3 &a, LLV4Vector3& o) const
 	o.v = _mm_add_ps(o.v   , _mm_mul_ps(_mm_set1_ps(a.mV[VZ]), mV[VZ]));
 }
 
+inline void LLV4Matrix4::multiply(const LLV4Vector3 &a, LLV4Vector3& o) const
+{
+	o.v = _mm_add_ps(mV[VW], _mm_mul_ps(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(0,0,0,0)), mV[VX])); // ( ax * vx ) + vw
+	o.v = _mm_add_ps(o.v   , _mm_mul_ps(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1,1,1,1)), mV[VY]));
+	o.v = _mm_add_ps(o.v   , _mm_mul_ps(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2,2,2,2)), mV[VZ]));
+}
+
 inline const LLV4Matrix4& LLV4Matrix4::translate(const LLV4Vector3 &vec)
 {
 	mV[VW] = _mm_add_ps(mV[VW], vec.v);
@@ -173,6 +181,24 @@ inline void LLV4Matrix4::multiply(const LLVector3 &a, LLV4Vector3& o) const
 					mMatrix[VW][VZ]);
 }
 
+inline void LLV4Matrix4::multiply(const LLV4Vector3 &a, LLV4Vector3& o) const
+{
+	o.setVec(		a.mV[VX] * mMatrix[VX][VX] + 
+					a.mV[VY] * mMatrix[VY][VX] + 
+					a.mV[VZ] * mMatrix[VZ][VX] +
+					mMatrix[VW][VX],
+					 
+					a.mV[VX] * mMatrix[VX][VY] + 
+					a.mV[VY] * mMatrix[VY][VY] + 
+					a.mV[VZ] * mMatrix[VZ][VY] +
+					mMatrix[VW][VY],
+					 
+					a.mV[VX] * mMatrix[VX][VZ] + 
+					a.mV[VY] * mMatrix[VY][VZ] + 
+					a.mV[VZ] * mMatrix[VZ][VZ] +
+					mMatrix[VW][VZ]);
+}
+
 inline const LLV4Matrix4& LLV4Matrix4::translate(const LLV4Vector3 &vec)
 {
 	mMatrix[3][0] += vec.mV[0];
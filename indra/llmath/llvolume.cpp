@@ -36,6 +36,7 @@
 #include <set>
 
 #include "llerror.h"
+#include "llmemory.h"
 #include "llmemtype.h"
 
 #include "llvolumemgr.h"
@@ -44,6 +45,8 @@
 #include "v4math.h"
 #include "m4math.h"
 #include "m3math.h"
+#include "llv4matrix3.h"
+#include "llv4matrix4.h"
 #include "lldarray.h"
 #include "llvolume.h"
 #include "llstl.h"
@@ -1663,7 +1666,7 @@ LLProfile::~LLProfile()
 }
 
 
-S32 LLVolume::sNumMeshPoints = 0;
+LLAtomicS32 LLVolume::sNumMeshPoints(0);
 
 LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face, const BOOL is_unique)
 	: mParams(params)
@@ -3416,9 +3419,9 @@ void LLVolume::generateSilhouetteVertices(std::vector<LLVector3> &vertices,
 				S32 v3 = face.mIndices[j*3+2];
 
 				//get current face center
-				LLVector3 cCenter = (face.mVertices[v1].mPosition + 
-									face.mVertices[v2].mPosition + 
-									face.mVertices[v3].mPosition) / 3.0f;
+				LLVector3 cCenter = (face.getPosition(v1) + 
+									face.getPosition(v2) + 
+									face.getPosition(v3)) / 3.0f;
 
 				//for each edge
 				for (S32 k = 0; k < 3; k++) {
@@ -3436,9 +3439,9 @@ void LLVolume::generateSilhouetteVertices(std::vector<LLVector3> &vertices,
 					v3 = face.mIndices[nIndex*3+2];
 
 					//get neighbor face center
-					LLVector3 nCenter = (face.mVertices[v1].mPosition + 
-									face.mVertices[v2].mPosition + 
-									face.mVertices[v3].mPosition) / 3.0f;
+					LLVector3 nCenter = (face.getPosition(v1) + 
+									face.getPosition(v2) + 
+									face.getPosition(v3)) / 3.0f;
 
 					//draw line
 					vertices.push_back(cCenter);
@@ -3461,15 +3464,15 @@ void LLVolume::generateSilhouetteVertices(std::vector<LLVector3> &vertices,
 #elif DEBUG_SILHOUETTE_NORMALS
 
 			//for each vertex
-			for (U32 j = 0; j < face.mVertices.size(); j++) {
-				vertices.push_back(face.mVertices[j].mPosition);
-				vertices.push_back(face.mVertices[j].mPosition + face.mVertices[j].mNormal*0.1f);
+			for (S32 j = 0; j < face.getNumVertices(); j++) {
+				vertices.push_back(face.getPosition(j));
+				vertices.push_back(face.getPosition(j) + face.getNormal(j)*0.1f);
 				normals.push_back(LLVector3(0,0,1));
 				normals.push_back(LLVector3(0,0,1));
 				segments.push_back(vertices.size());
 #if DEBUG_SILHOUETTE_BINORMALS
-				vertices.push_back(face.mVertices[j].mPosition);
-				vertices.push_back(face.mVertices[j].mPosition + face.mVertices[j].mBinormal*0.1f);
+				vertices.push_back(face.getPosition(j));
+				vertices.push_back(face.getPosition(j) + face.getBinormal(j)*0.1f);
 				normals.push_back(LLVector3(0,0,1));
 				normals.push_back(LLVector3(0,0,1));
 				segments.push_back(vertices.size());
@@ -3495,8 +3498,8 @@ void LLVolume::generateSilhouetteVertices(std::vector<LLVector3> &vertices,
 				S32 v2 = face.mIndices[j*3+1];
 				S32 v3 = face.mIndices[j*3+2];
 
-				LLVector3 norm = (face.mVertices[v1].mPosition - face.mVertices[v2].mPosition) % 
-					(face.mVertices[v2].mPosition - face.mVertices[v3].mPosition);
+				LLVector3 norm = (face.getPosition(v1) - face.getPosition(v2)) % 
+					(face.getPosition(v2) - face.getPosition(v3));
 				
 				if (norm.magVecSquared() < 0.00000001f) 
 				{
@@ -3505,7 +3508,7 @@ void LLVolume::generateSilhouetteVertices(std::vector<LLVector3> &vertices,
 				else 
 				{
 					//get view vector
-					LLVector3 view = (obj_cam_vec-face.mVertices[v1].mPosition);
+					LLVector3 view = (obj_cam_vec-face.getPosition(v1));
 					bool away = view * norm > 0.0f; 
 					if (away) 
 					{
@@ -3552,13 +3555,13 @@ void LLVolume::generateSilhouetteVertices(std::vector<LLVector3> &vertices,
 						S32 v1 = face.mIndices[j*3+k];
 						S32 v2 = face.mIndices[j*3+((k+1)%3)];
 						
-						vertices.push_back(face.mVertices[v1].mPosition*mat);
-						LLVector3 norm1 = face.mVertices[v1].mNormal * norm_mat;
+						vertices.push_back(face.getPosition(v1)*mat);
+						LLVector3 norm1 = face.getNormal(v1) * norm_mat;
 						norm1.normVec();
 						normals.push_back(norm1);
 
-						vertices.push_back(face.mVertices[v2].mPosition*mat);
-						LLVector3 norm2 = face.mVertices[v2].mNormal * norm_mat;
+						vertices.push_back(face.getPosition(v2)*mat);
+						LLVector3 norm2 = face.getNormal(v2) * norm_mat;
 						norm2.normVec();
 						normals.push_back(norm2);
 
@@ -3617,9 +3620,9 @@ S32 LLVolume::lineSegmentIntersect(const LLVector3& start, const LLVector3& end,
 
 				F32 a, b, t;
 			
-				if (LLTriangleRayIntersect(face.mVertices[index1].mPosition,
-										   face.mVertices[index2].mPosition,
-										   face.mVertices[index3].mPosition,
+				if (LLTriangleRayIntersect(face.getPosition(index1),
+										   face.getPosition(index2),
+										   face.getPosition(index3),
 										   start, dir, &a, &b, &t, FALSE))
 				{
 					if ((t >= 0.f) &&      // if hit is after start
@@ -3636,24 +3639,24 @@ S32 LLVolume::lineSegmentIntersect(const LLVector3& start, const LLVector3& end,
 			
 						if (tex_coord != NULL)
 			{
-							*tex_coord = ((1.f - a - b)  * face.mVertices[index1].mTexCoord +
-										  a              * face.mVertices[index2].mTexCoord +
-										  b              * face.mVertices[index3].mTexCoord);
+							*tex_coord = ((1.f - a - b)  * face.getTexCoord(index1) +
+										  a              * face.getTexCoord(index2) +
+										  b              * face.getTexCoord(index3));
 
 						}
 
 						if (normal != NULL)
 				{
-							*normal    = ((1.f - a - b)  * face.mVertices[index1].mNormal + 
-										  a              * face.mVertices[index2].mNormal +
-										  b              * face.mVertices[index3].mNormal);
+							*normal    = ((1.f - a - b)  * face.getNormal(index1) + 
+										  a              * face.getNormal(index2) +
+										  b              * face.getNormal(index3));
 						}
 
 						if (bi_normal != NULL)
 					{
-							*bi_normal = ((1.f - a - b)  * face.mVertices[index1].mBinormal + 
-										  a              * face.mVertices[index2].mBinormal +
-										  b              * face.mVertices[index3].mBinormal);
+							*bi_normal = ((1.f - a - b)  * face.getBinormal(index1) + 
+										  a              * face.getBinormal(index2) +
+										  b              * face.getBinormal(index3));
 						}
 
 					}
@@ -4400,6 +4403,158 @@ std::ostream& operator<<(std::ostream &s, const LLVolume *volumep)
 }
 
 
+LLVolumeFace::LLVolumeFace(const LLVolumeFace& src)
+	: mNumVertices(0),
+	  mPositions(NULL),
+	  mNormals(NULL),
+	  mBinormals(NULL),
+	  mTexCoords(NULL)
+{
+	*this = src;
+}
+
+LLVolumeFace::~LLVolumeFace()
+{
+	ll_aligned_free_16(mPositions);
+}
+
+LLVolumeFace& LLVolumeFace::operator=(const LLVolumeFace& rhs)
+{
+	if (&rhs == this)
+	{
+		return *this;
+	}
+	mID = rhs.mID;
+	mTypeMask = rhs.mTypeMask;
+	mCenter = rhs.mCenter;
+	mHasBinormals = rhs.mHasBinormals;
+	mBeginS = rhs.mBeginS;
+	mBeginT = rhs.mBeginT;
+	mNumS = rhs.mNumS;
+	mNumT = rhs.mNumT;
+	mExtents[0] = rhs.mExtents[0];
+	mExtents[1] = rhs.mExtents[1];
+
+	resizeVertices(0);
+	resizeVertices(rhs.mNumVertices);
+	if (mNumVertices)
+	{
+		memcpy(mPositions, rhs.mPositions, mNumVertices * sizeof(LLV4Vector3));
+		memcpy(mNormals, rhs.mNormals, mNumVertices * sizeof(LLV4Vector3));
+		memcpy(mBinormals, rhs.mBinormals, mNumVertices * sizeof(LLV4Vector3));
+		memcpy(mTexCoords, rhs.mTexCoords, mNumVertices * sizeof(LLVector2));
+	}
+
+	mIndices = rhs.mIndices;
+	mTriStrip = rhs.mTriStrip;
+	mEdge = rhs.mEdge;
+	return *this;
+}
+
+// The four streams share one allocation: positions, normals and binormals
+// (16 bytes a vertex each) followed by the texture coordinates.
+void LLVolumeFace::resizeVertices(S32 num_verts)
+{
+	if (num_verts == mNumVertices)
+	{
+		return;
+	}
+
+	LLV4Vector3* positions = NULL;
+	LLV4Vector3* normals = NULL;
+	LLV4Vector3* binormals = NULL;
+	LLVector2* tex_coords = NULL;
+	if (num_verts > 0)
+	{
+		size_t size = num_verts * (3 * sizeof(LLV4Vector3) + sizeof(LLVector2));
+		positions = (LLV4Vector3*)ll_aligned_malloc_16(size);
+		if (!positions)
+		{
+			llerrs << "Out of memory allocating " << num_verts << " volume face vertices" << llendl;
+		}
+		normals = positions + num_verts;
+		binormals = normals + num_verts;
+		tex_coords = (LLVector2*)(binormals + num_verts);
+
+		S32 keep = llmin(num_verts, mNumVertices);
+		if (keep > 0)
+		{
+			memcpy(positions, mPositions, keep * sizeof(LLV4Vector3));
+			memcpy(normals, mNormals, keep * sizeof(LLV4Vector3));
+			memcpy(binormals, mBinormals, keep * sizeof(LLV4Vector3));
+			memcpy(tex_coords, mTexCoords, keep * sizeof(LLVector2));
+		}
+	}
+
+	ll_aligned_free_16(mPositions);
+	mPositions = positions;
+	mNormals = normals;
+	mBinormals = binormals;
+	mTexCoords = tex_coords;
+	mNumVertices = num_verts;
+}
+
+void LLVolumeFace::setVertex(S32 i, const VertexData& v)
+{
+	llassert(i >= 0 && i < mNumVertices);
+	mPositions[i].setVec(v.mPosition.mV[VX], v.mPosition.mV[VY], v.mPosition.mV[VZ]);
+	mNormals[i].setVec(v.mNormal.mV[VX], v.mNormal.mV[VY], v.mNormal.mV[VZ]);
+	mBinormals[i].setVec(v.mBinormal.mV[VX], v.mBinormal.mV[VY], v.mBinormal.mV[VZ]);
+	mTexCoords[i] = v.mTexCoord;
+}
+
+void LLVolumeFace::getPositions(LLStrider<LLVector3>& dst, const LLMatrix4& mat) const
+{
+	LLV4Matrix4 v4mat;
+	v4mat = mat;
+	LLV4Vector3 pos;
+	for (S32 i = 0; i < mNumVertices; i++)
+	{
+		v4mat.multiply(mPositions[i], pos);
+		(dst++)->setVec(pos.mV);
+	}
+}
+
+void LLVolumeFace::getNormals(LLStrider<LLVector3>& dst, const LLMatrix3& mat) const
+{
+	transformNormals(mNormals, dst, mat);
+}
+
+void LLVolumeFace::getBinormals(LLStrider<LLVector3>& dst, const LLMatrix3& mat) const
+{
+	transformNormals(mBinormals, dst, mat);
+}
+
+void LLVolumeFace::getTexCoords(LLStrider<LLVector2>& dst) const
+{
+	for (S32 i = 0; i < mNumVertices; i++)
+	{
+		*(dst++) = mTexCoords[i];
+	}
+}
+
+// Same result as (v * mat).normVec() for each vertex
+void LLVolumeFace::transformNormals(const LLV4Vector3* src, LLStrider<LLVector3>& dst, const LLMatrix3& mat) const
+{
+	LLV4Matrix3 v4mat;
+	v4mat = mat;
+	LLV4Vector3 n;
+	for (S32 i = 0; i < mNumVertices; i++)
+	{
+		v4mat.multiply(src[i], n);
+		F32 mag = (F32) sqrt(n.mV[VX]*n.mV[VX] + n.mV[VY]*n.mV[VY] + n.mV[VZ]*n.mV[VZ]);
+		if (mag > FP_MAG_THRESHOLD)
+		{
+			F32 oomag = 1.f/mag;
+			(dst++)->setVec(n.mV[VX]*oomag, n.mV[VY]*oomag, n.mV[VZ]*oomag);
+		}
+		else
+		{
+			(dst++)->setVec(0.f, 0.f, 0.f);
+		}
+	}
+}
+
 BOOL LLVolumeFace::create(LLVolume* volume, BOOL partial_build)
 {
 	if (mTypeMask & CAP_MASK)
@@ -4491,10 +4646,12 @@ BOOL LLVolumeFace::createUnCutCubeCap(LLVolume* volume, BOOL partial_build)
 
 	if (partial_build)
 	{
-		mVertices.clear();
+		resizeVertices(0);
 	}
 
-	S32	vtop = mVertices.size();
+	S32	vtop = mNumVertices;
+	resizeVertices(vtop + num_vertices);
+	S32 cur_vertex = vtop;
 	for(int gx = 0;gx<grid_size+1;gx++){
 		for(int gy = 0;gy<grid_size+1;gy++){
 			VertexData newVert;
@@ -4505,7 +4662,7 @@ BOOL LLVolumeFace::createUnCutCubeCap(LLVolume* volume, BOOL partial_build)
 				newVert,
 				(F32)gx/(F32)grid_size,
 				(F32)gy/(F32)grid_size);
-			mVertices.push_back(newVert);
+			setVertex(cur_vertex++, newVert);
 
 			if (gx == 0 && gy == 0)
 			{
@@ -4611,7 +4768,7 @@ BOOL LLVolumeFace::createCap(LLVolume* volume, BOOL partial_build)
 	num_vertices = profile.size();
 	num_indices = (profile.size() - 2)*3;
 
-	mVertices.resize(num_vertices);
+	resizeVertices(num_vertices);
 
 	if (!partial_build)
 	{
@@ -4647,27 +4804,27 @@ BOOL LLVolumeFace::createCap(LLVolume* volume, BOOL partial_build)
 	{
 		if (mTypeMask & TOP_MASK)
 		{
-			mVertices[i].mTexCoord.mV[0] = profile[i].mV[0]+0.5f;
-			mVertices[i].mTexCoord.mV[1] = profile[i].mV[1]+0.5f;
+			getTexCoord(i).mV[0] = profile[i].mV[0]+0.5f;
+			getTexCoord(i).mV[1] = profile[i].mV[1]+0.5f;
 		}
 		else
 		{
 			// Mirror for underside.
-			mVertices[i].mTexCoord.mV[0] = profile[i].mV[0]+0.5f;
-			mVertices[i].mTexCoord.mV[1] = 0.5f - profile[i].mV[1];
+			getTexCoord(i).mV[0] = profile[i].mV[0]+0.5f;
+			getTexCoord(i).mV[1] = 0.5f - profile[i].mV[1];
 		}
 
-		mVertices[i].mPosition = mesh[i + offset].mPos;
+		getPosition(i) = mesh[i + offset].mPos;
 		
 		if (i == 0)
 		{
-			min = max = mVertices[i].mPosition;
-			min_uv = max_uv = mVertices[i].mTexCoord;
+			min = max = getPosition(i);
+			min_uv = max_uv = getTexCoord(i);
 		}
 		else
 		{
-			update_min_max(min,max, mVertices[i].mPosition);
-			update_min_max(min_uv, max_uv, mVertices[i].mTexCoord);
+			update_min_max(min,max, getPosition(i));
+			update_min_max(min_uv, max_uv, getTexCoord(i));
 		}
 	}
 
@@ -4676,16 +4833,16 @@ BOOL LLVolumeFace::createCap(LLVolume* volume, BOOL partial_build)
 
 	LLVector3 binormal = calc_binormal_from_triangle( 
 		mCenter, cuv,
-		mVertices[0].mPosition, mVertices[0].mTexCoord,
-		mVertices[1].mPosition, mVertices[1].mTexCoord);
+		getPosition(0), getTexCoord(0),
+		getPosition(1), getTexCoord(1));
 	binormal.normVec();
 
 	LLVector3 d0;
 	LLVector3 d1;
 	LLVector3 normal;
 
-	d0 = mCenter-mVertices[0].mPosition;
-	d1 = mCenter-mVertices[1].mPosition;
+	d0 = mCenter-getPosition(0);
+	d1 = mCenter-getPosition(1);
 
 	normal = (mTypeMask & TOP_MASK) ? (d0%d1) : (d1%d0);
 	normal.normVec();
@@ -4698,7 +4855,8 @@ BOOL LLVolumeFace::createCap(LLVolume* volume, BOOL partial_build)
 	
 	if (!(mTypeMask & HOLLOW_MASK) && !(mTypeMask & OPEN_MASK))
 	{
-		mVertices.push_back(vd);
+		resizeVertices(num_vertices + 1);
+		setVertex(num_vertices, vd);
 		num_vertices++;
 		if (!partial_build)
 		{
@@ -4709,8 +4867,8 @@ BOOL LLVolumeFace::createCap(LLVolume* volume, BOOL partial_build)
 	
 	for (S32 i = 0; i < num_vertices; i++)
 	{
-		mVertices[i].mBinormal = binormal;
-		mVertices[i].mNormal = normal;
+		getBinormal(i) = binormal;
+		getNormal(i) = normal;
 	}
 
 	mHasBinormals = TRUE;
@@ -5039,36 +5197,36 @@ void LLVolumeFace::createBinormals()
 		//generate binormals
 		for (U32 i = 0; i < mIndices.size()/3; i++) 
 		{	//for each triangle
-			const VertexData& v0 = mVertices[mIndices[i*3+0]];
-			const VertexData& v1 = mVertices[mIndices[i*3+1]];
-			const VertexData& v2 = mVertices[mIndices[i*3+2]];
+			const S32 i0 = mIndices[i*3+0];
+			const S32 i1 = mIndices[i*3+1];
+			const S32 i2 = mIndices[i*3+2];
 						
 			//calculate binormal
-			LLVector3 binorm = calc_binormal_from_triangle(v0.mPosition, v0.mTexCoord,
-															v1.mPosition, v1.mTexCoord,
-															v2.mPosition, v2.mTexCoord);
+			LLVector3 binorm = calc_binormal_from_triangle(getPosition(i0), getTexCoord(i0),
+															getPosition(i1), getTexCoord(i1),
+															getPosition(i2), getTexCoord(i2));
 
 			for (U32 j = 0; j < 3; j++) 
 			{ //add triangle normal to vertices
-				mVertices[mIndices[i*3+j]].mBinormal += binorm; // * (weight_sum - d[j])/weight_sum;
+				getBinormal(mIndices[i*3+j]) += binorm; // * (weight_sum - d[j])/weight_sum;
 			}
 
 			//even out quad contributions
 			if (i % 2 == 0) 
 			{
-				mVertices[mIndices[i*3+2]].mBinormal += binorm;
+				getBinormal(mIndices[i*3+2]) += binorm;
 			}
 			else 
 			{
-				mVertices[mIndices[i*3+1]].mBinormal += binorm;
+				getBinormal(mIndices[i*3+1]) += binorm;
 			}
 		}
 
 		//normalize binormals
-		for (U32 i = 0; i < mVertices.size(); i++) 
+		for (S32 i = 0; i < mNumVertices; i++) 
 		{
-			mVertices[i].mBinormal.normVec();
-			mVertices[i].mNormal.normVec();
+			getBinormal(i).normVec();
+			getNormal(i).normVec();
 		}
 
 		mHasBinormals = TRUE;
@@ -5101,7 +5259,7 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 	num_vertices = mNumS*mNumT;
 	num_indices = (mNumS-1)*(mNumT-1)*6;
 
-	mVertices.resize(num_vertices);
+	resizeVertices(num_vertices);
 
 	if (!partial_build)
 	{
@@ -5169,11 +5327,11 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 				i = mBeginS + s + max_s*t;
 			}
 
-			mVertices[cur_vertex].mPosition = mesh[i].mPos;
-			mVertices[cur_vertex].mTexCoord = LLVector2(ss,tt);
+			getPosition(cur_vertex) = mesh[i].mPos;
+			getTexCoord(cur_vertex) = LLVector2(ss,tt);
 		
-			mVertices[cur_vertex].mNormal = LLVector3(0,0,0);
-			mVertices[cur_vertex].mBinormal = LLVector3(0,0,0);
+			getNormal(cur_vertex) = LLVector3(0,0,0);
+			getBinormal(cur_vertex) = LLVector3(0,0,0);
 			
 			if (cur_vertex == 0)
 			{
@@ -5188,11 +5346,11 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 
 			if ((mTypeMask & INNER_MASK) && (mTypeMask & FLAT_MASK) && mNumS > 2 && s > 0)
 			{
-				mVertices[cur_vertex].mPosition = mesh[i].mPos;
-				mVertices[cur_vertex].mTexCoord = LLVector2(ss,tt);
+				getPosition(cur_vertex) = mesh[i].mPos;
+				getTexCoord(cur_vertex) = LLVector2(ss,tt);
 			
-				mVertices[cur_vertex].mNormal = LLVector3(0,0,0);
-				mVertices[cur_vertex].mBinormal = LLVector3(0,0,0);
+				getNormal(cur_vertex) = LLVector3(0,0,0);
+				getBinormal(cur_vertex) = LLVector3(0,0,0);
 				cur_vertex++;
 			}
 		}
@@ -5210,11 +5368,11 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 
 			i = mBeginS + s + max_s*t;
 			ss = profile[mBeginS + s].mV[2] - begin_stex;
-			mVertices[cur_vertex].mPosition = mesh[i].mPos;
-			mVertices[cur_vertex].mTexCoord = LLVector2(ss,tt);
+			getPosition(cur_vertex) = mesh[i].mPos;
+			getTexCoord(cur_vertex) = LLVector2(ss,tt);
 		
-			mVertices[cur_vertex].mNormal = LLVector3(0,0,0);
-			mVertices[cur_vertex].mBinormal = LLVector3(0,0,0);
+			getNormal(cur_vertex) = LLVector3(0,0,0);
+			getBinormal(cur_vertex) = LLVector3(0,0,0);
 
 			update_min_max(face_min,face_max,mesh[i].mPos);
 
@@ -5311,43 +5469,43 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 		const S32 i0 = mIndices[i*3+0];
 		const S32 i1 = mIndices[i*3+1];
 		const S32 i2 = mIndices[i*3+2];
-		const VertexData& v0 = mVertices[i0];
-		const VertexData& v1 = mVertices[i1];
-		const VertexData& v2 = mVertices[i2];
+		const LLVector3& p0 = getPosition(i0);
+		const LLVector3& p1 = getPosition(i1);
+		const LLVector3& p2 = getPosition(i2);
 					
 		//calculate triangle normal
-		LLVector3 norm = (v0.mPosition-v1.mPosition) % (v0.mPosition-v2.mPosition);
+		LLVector3 norm = (p0-p1) % (p0-p2);
 
 		for (U32 j = 0; j < 3; j++) 
 		{ //add triangle normal to vertices
 			const S32 idx = mIndices[i*3+j];
-			mVertices[idx].mNormal += norm; // * (weight_sum - d[j])/weight_sum;
+			getNormal(idx) += norm; // * (weight_sum - d[j])/weight_sum;
 		}
 
 		//even out quad contributions
 		if ((i & 1) == 0) 
 		{
-			mVertices[i2].mNormal += norm;
+			getNormal(i2) += norm;
 		}
 		else 
 		{
-			mVertices[i1].mNormal += norm;
+			getNormal(i1) += norm;
 		}
 	}
 	
 	// adjust normals based on wrapping and stitching
 	
-	BOOL s_bottom_converges = ((mVertices[0].mPosition - mVertices[mNumS*(mNumT-2)].mPosition).magVecSquared() < 0.000001f);
-	BOOL s_top_converges = ((mVertices[mNumS-1].mPosition - mVertices[mNumS*(mNumT-2)+mNumS-1].mPosition).magVecSquared() < 0.000001f);
+	BOOL s_bottom_converges = ((getPosition(0) - getPosition(mNumS*(mNumT-2))).magVecSquared() < 0.000001f);
+	BOOL s_top_converges = ((getPosition(mNumS-1) - getPosition(mNumS*(mNumT-2)+mNumS-1)).magVecSquared() < 0.000001f);
 	if (sculpt_stitching == LL_SCULPT_TYPE_NONE)  // logic for non-sculpt volumes
 	{
 		if (volume->getPath().isOpen() == FALSE)
 		{ //wrap normals on T
 			for (S32 i = 0; i < mNumS; i++)
 			{
-				LLVector3 norm = mVertices[i].mNormal + mVertices[mNumS*(mNumT-1)+i].mNormal;
-				mVertices[i].mNormal = norm;
-				mVertices[mNumS*(mNumT-1)+i].mNormal = norm;
+				LLVector3 norm = getNormal(i) + getNormal(mNumS*(mNumT-1)+i);
+				getNormal(i) = norm;
+				getNormal(mNumS*(mNumT-1)+i) = norm;
 			}
 		}
 
@@ -5355,9 +5513,9 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 		{ //wrap normals on S
 			for (S32 i = 0; i < mNumT; i++)
 			{
-				LLVector3 norm = mVertices[mNumS*i].mNormal + mVertices[mNumS*i+mNumS-1].mNormal;
-				mVertices[mNumS * i].mNormal = norm;
-				mVertices[mNumS * i+mNumS-1].mNormal = norm;
+				LLVector3 norm = getNormal(mNumS*i) + getNormal(mNumS*i+mNumS-1);
+				getNormal(mNumS * i) = norm;
+				getNormal(mNumS * i+mNumS-1) = norm;
 			}
 		}
 	
@@ -5368,7 +5526,7 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 			{ //all lower S have same normal
 				for (S32 i = 0; i < mNumT; i++)
 				{
-					mVertices[mNumS*i].mNormal = LLVector3(1,0,0);
+					getNormal(mNumS*i) = LLVector3(1,0,0);
 				}
 			}
 
@@ -5376,7 +5534,7 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 			{ //all upper S have same normal
 				for (S32 i = 0; i < mNumT; i++)
 				{
-					mVertices[mNumS*i+mNumS-1].mNormal = LLVector3(-1,0,0);
+					getNormal(mNumS*i+mNumS-1) = LLVector3(-1,0,0);
 				}
 			}
 		}
@@ -5407,13 +5565,13 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 			LLVector3 average(0.0, 0.0, 0.0);
 			for (S32 i = 0; i < mNumS; i++)
 			{
-				average += mVertices[i].mNormal;
+				average += getNormal(i);
 			}
 
 			// set average
 			for (S32 i = 0; i < mNumS; i++)
 			{
-				mVertices[i].mNormal = average;
+				getNormal(i) = average;
 			}
 
 			// average normals for south pole
@@ -5421,13 +5579,13 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 			average = LLVector3(0.0, 0.0, 0.0);
 			for (S32 i = 0; i < mNumS; i++)
 			{
-				average += mVertices[i + mNumS * (mNumT - 1)].mNormal;
+				average += getNormal(i + mNumS * (mNumT - 1));
 			}
 
 			// set average
 			for (S32 i = 0; i < mNumS; i++)
 			{
-				mVertices[i + mNumS * (mNumT - 1)].mNormal = average;
+				getNormal(i + mNumS * (mNumT - 1)) = average;
 			}
 
 		}
@@ -5437,9 +5595,9 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 		{
 			for (S32 i = 0; i < mNumT; i++)
 			{
-				LLVector3 norm = mVertices[mNumS*i].mNormal + mVertices[mNumS*i+mNumS-1].mNormal;
-				mVertices[mNumS * i].mNormal = norm;
-				mVertices[mNumS * i+mNumS-1].mNormal = norm;
+				LLVector3 norm = getNormal(mNumS*i) + getNormal(mNumS*i+mNumS-1);
+				getNormal(mNumS * i) = norm;
+				getNormal(mNumS * i+mNumS-1) = norm;
 			}
 		}
 
@@ -5449,9 +5607,9 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 		{
 			for (S32 i = 0; i < mNumS; i++)
 			{
-				LLVector3 norm = mVertices[i].mNormal + mVertices[mNumS*(mNumT-1)+i].mNormal;
-				mVertices[i].mNormal = norm;
-				mVertices[mNumS*(mNumT-1)+i].mNormal = norm;
+				LLVector3 norm = getNormal(i) + getNormal(mNumS*(mNumT-1)+i);
+				getNormal(i) = norm;
+				getNormal(mNumS*(mNumT-1)+i) = norm;
 			}
 			
 		}
@@ -43,6 +43,8 @@ class LLProfile;
 class LLPath;
 class LLVolumeFace;
 class LLVolume;
+class LLMatrix3;
+class LLMatrix4;
 
 #include "lldarray.h"
 #include "lluuid.h"
@@ -52,9 +54,11 @@ class LLVolume;
 #include "v3math.h"
 #include "llquaternion.h"
 #include "llstrider.h"
+#include "llv4vector3.h"
 #include "v4coloru.h"
 #include "llrefcount.h"
 #include "llfile.h"
+#include "llapr.h"
 
 //============================================================================
 
@@ -793,9 +797,17 @@ public:
 		mBeginS(0),
 		mBeginT(0),
 		mNumS(0),
-		mNumT(0)
+		mNumT(0),
+		mNumVertices(0),
+		mPositions(NULL),
+		mNormals(NULL),
+		mBinormals(NULL),
+		mTexCoords(NULL)
 	{
 	}
+	LLVolumeFace(const LLVolumeFace& src);
+	~LLVolumeFace();
+	LLVolumeFace& operator=(const LLVolumeFace& rhs);
 
 	BOOL create(LLVolume* volume, BOOL partial_build = FALSE);
 	void createBinormals();
@@ -810,6 +822,27 @@ public:
 		LLVector2 mTexCoord;
 	};
 
+	S32 getNumVertices() const							{ return mNumVertices; }
+	// Keeps the first min(old, new) vertices, new ones are uninitialized
+	void resizeVertices(S32 num_verts);
+	void setVertex(S32 i, const VertexData& v);
+
+	LLVector3& getPosition(S32 i)						{ return *reinterpret_cast<LLVector3*>(mPositions[i].mV); }
+	const LLVector3& getPosition(S32 i) const			{ return *reinterpret_cast<const LLVector3*>(mPositions[i].mV); }
+	LLVector3& getNormal(S32 i)							{ return *reinterpret_cast<LLVector3*>(mNormals[i].mV); }
+	const LLVector3& getNormal(S32 i) const				{ return *reinterpret_cast<const LLVector3*>(mNormals[i].mV); }
+	LLVector3& getBinormal(S32 i)						{ return *reinterpret_cast<LLVector3*>(mBinormals[i].mV); }
+	const LLVector3& getBinormal(S32 i) const			{ return *reinterpret_cast<const LLVector3*>(mBinormals[i].mV); }
+	LLVector2& getTexCoord(S32 i)						{ return mTexCoords[i]; }
+	const LLVector2& getTexCoord(S32 i) const			{ return mTexCoords[i]; }
+
+	// Whole-stream copies into (possibly interleaved) vertex buffer arrays.
+	// Normals and binormals are normalized after the transform.
+	void getPositions(LLStrider<LLVector3>& dst, const LLMatrix4& mat) const;
+	void getNormals(LLStrider<LLVector3>& dst, const LLMatrix3& mat) const;
+	void getBinormals(LLStrider<LLVector3>& dst, const LLMatrix3& mat) const;
+	void getTexCoords(LLStrider<LLVector2>& dst) const;
+
 	enum
 	{
 		SINGLE_MASK =	0x0001,
@@ -839,12 +872,22 @@ public:
 
 	LLVector3 mExtents[2]; //minimum and maximum point of face
 
-	std::vector<VertexData> mVertices;
+	// Vertex streams, all in one 16 byte aligned block.  Positions, normals
+	// and binormals are padded to four floats so SIMD code can load them
+	// straight from the face, the w component is unused.
+	S32 mNumVertices;
+	LLV4Vector3* mPositions;
+	LLV4Vector3* mNormals;
+	LLV4Vector3* mBinormals;
+	LLVector2* mTexCoords;
+
 	std::vector<U16>	mIndices;
 	std::vector<U16>	mTriStrip;
 	std::vector<S32>	mEdge;
 
 private:
+	void transformNormals(const LLV4Vector3* src, LLStrider<LLVector3>& dst, const LLMatrix3& mat) const;
+
 	BOOL createUnCutCubeCap(LLVolume* volume, BOOL partial_build = FALSE);
 	BOOL createCap(LLVolume* volume, BOOL partial_build = FALSE);
 	BOOL createSide(LLVolume* volume, BOOL partial_build = FALSE);
@@ -938,7 +981,7 @@ public:
 	LLFaceID generateFaceMask();
 
 	BOOL isFaceMaskValid(LLFaceID face_mask);
-	static S32 sNumMeshPoints;
+	static LLAtomicS32 sNumMeshPoints; // updated by LLVolumeGenerateThread too
 
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume &volume);
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume *volumep);		// HACK to bypass Windoze confusion over 
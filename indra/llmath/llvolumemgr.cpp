@@ -34,6 +34,7 @@
 
 #include "llvolumemgr.h"
 #include "llmemtype.h"
+#include "lltimer.h"
 #include "llvolume.h"
 
 
@@ -51,8 +52,24 @@ F32 LLVolumeLODGroup::mDetailScales[NUM_LODS] = {1.f, 1.5f, 2.5f, 4.f};
 
 //============================================================================
 
+LLVolumeMgr::Stats::Stats()
+:	mHits(0),
+	mMisses(0),
+	mQueued(0),
+	mGenerated(0),
+	mDiscarded(0),
+	mEvictions(0),
+	mMissTime(0.0),
+	mGenerateTime(0.0)
+{
+}
+
 LLVolumeMgr::LLVolumeMgr()
-:	mDataMutex(NULL)
+:	mDataMutex(NULL),
+	mGenerateThread(NULL),
+	mCacheSize(0),
+	mNumCached(0),
+	mUseStamp(0)
 {
 	// the LLMutex magic interferes with easy unit testing,
 	// so you now must manually call useMutex() to use it
@@ -61,6 +78,7 @@ LLVolumeMgr::LLVolumeMgr()
 
 LLVolumeMgr::~LLVolumeMgr()
 {
+	stopGenerateThread();
 	cleanup();
 
 	delete mDataMutex;
@@ -86,6 +104,7 @@ BOOL LLVolumeMgr::cleanup()
  		delete volgroupp;
 	}
 	mVolumeLODGroups.clear();
+	mNumCached = 0;
 	if (mDataMutex)
 	{
 		mDataMutex->unlock();
@@ -113,11 +132,27 @@ LLVolume* LLVolumeMgr::refVolume(const LLVolumeParams &volume_params, const S32
 	{
 		volgroupp = iter->second;
 	}
+	if (volgroupp->isLODReady(detail) && volgroupp->getNumLODRefs(detail) == 0)
+	{
+		// back out of the cache
+		mNumCached--;
+	}
 	if (mDataMutex)
 	{
 		mDataMutex->unlock();
 	}
-	return volgroupp->refLOD(detail);
+
+	if (volgroupp->isLODReady(detail))
+	{
+		mStats.mHits++;
+		return volgroupp->refLOD(detail);
+	}
+
+	mStats.mMisses++;
+	LLTimer timer;
+	LLVolume* volumep = volgroupp->refLOD(detail);
+	mStats.mMissTime += timer.getElapsedTimeF64();
+	return volumep;
 }
 
 // virtual
@@ -166,12 +201,13 @@ void LLVolumeMgr::unrefVolume(LLVolume *volumep)
 	{
 		LLVolumeLODGroup* volgroupp = iter->second;
 
+		S32 detail = volgroupp->findLOD(volumep);
 		volgroupp->derefLOD(volumep);
-		if (volgroupp->getNumRefs() == 0)
+		if (detail >= 0 && volgroupp->getNumLODRefs(detail) == 0)
 		{
-			mVolumeLODGroups.erase(params);
-			delete volgroupp;
+			releaseUnused(volgroupp, detail);
 		}
+		deleteGroupIfUnused(volgroupp);
 	}
 	if (mDataMutex)
 	{
@@ -219,6 +255,264 @@ void LLVolumeMgr::dump()
 	llinfos << "Average usage of LODs " << avg << llendl;
 }
 
+// protected, mDataMutex locked
+// Either frees a LOD nothing references any more or keeps it for reuse.
+void LLVolumeMgr::releaseUnused(LLVolumeLODGroup* volgroupp, S32 detail)
+{
+	if (mCacheSize <= 0)
+	{
+		volgroupp->releaseLOD(detail);
+		return;
+	}
+	volgroupp->setLastUsed(detail, ++mUseStamp);
+	mNumCached++;
+	if (mNumCached > mCacheSize)
+	{
+		trimCache();
+	}
+}
+
+// protected, mDataMutex locked
+void LLVolumeMgr::deleteGroupIfUnused(LLVolumeLODGroup* volgroupp)
+{
+	if (volgroupp->getNumRefs() == 0 &&
+		!volgroupp->hasCachedLODs() &&
+		!volgroupp->hasPendingLODs())
+	{
+		mVolumeLODGroups.erase(volgroupp->getVolumeParams());
+		delete volgroupp;
+	}
+}
+
+// protected, mDataMutex locked
+// Frees the least recently used cached LODs. Trims to 7/8 of the budget so
+// that the scan is not repeated on every unref.
+void LLVolumeMgr::trimCache()
+{
+	typedef std::pair<U32, std::pair<LLVolumeLODGroup*, S32> > cached_lod_t;
+	std::vector<cached_lod_t> cached;
+	cached.reserve(mNumCached);
+	for (volume_lod_group_map_t::iterator iter = mVolumeLODGroups.begin();
+		 iter != mVolumeLODGroups.end(); ++iter)
+	{
+		LLVolumeLODGroup* volgroupp = iter->second;
+		for (S32 i = 0; i < LLVolumeLODGroup::NUM_LODS; i++)
+		{
+			if (volgroupp->isLODReady(i) && volgroupp->getNumLODRefs(i) == 0)
+			{
+				cached.push_back(cached_lod_t(volgroupp->getLastUsed(i), std::make_pair(volgroupp, i)));
+			}
+		}
+	}
+
+	S32 target = mCacheSize - mCacheSize / 8;
+	S32 num_evict = (S32)cached.size() - target;
+	if (num_evict <= 0)
+	{
+		return;
+	}
+	std::nth_element(cached.begin(), cached.begin() + (num_evict - 1), cached.end());
+	for (S32 i = 0; i < num_evict; i++)
+	{
+		LLVolumeLODGroup* volgroupp = cached[i].second.first;
+		volgroupp->releaseLOD(cached[i].second.second);
+		mNumCached--;
+		mStats.mEvictions++;
+		if (!volgroupp->hasCachedLODs())
+		{
+			// may delete it, nothing later in the list points to a group without cached LODs
+			deleteGroupIfUnused(volgroupp);
+		}
+	}
+}
+
+void LLVolumeMgr::setCacheSize(S32 count)
+{
+	if (mDataMutex)
+	{
+		mDataMutex->lock();
+	}
+	mCacheSize = llmax(count, 0);
+	if (mNumCached > mCacheSize)
+	{
+		if (mCacheSize == 0)
+		{
+			// release everything
+			for (volume_lod_group_map_t::iterator iter = mVolumeLODGroups.begin();
+				 iter != mVolumeLODGroups.end(); )
+			{
+				LLVolumeLODGroup* volgroupp = (iter++)->second;
+				for (S32 i = 0; i < LLVolumeLODGroup::NUM_LODS; i++)
+				{
+					if (volgroupp->isLODReady(i) && volgroupp->getNumLODRefs(i) == 0)
+					{
+						volgroupp->releaseLOD(i);
+						mStats.mEvictions++;
+					}
+				}
+				deleteGroupIfUnused(volgroupp);
+			}
+			mNumCached = 0;
+		}
+		else
+		{
+			trimCache();
+		}
+	}
+	if (mDataMutex)
+	{
+		mDataMutex->unlock();
+	}
+}
+
+void LLVolumeMgr::startGenerateThread(bool threaded)
+{
+	if (!mGenerateThread)
+	{
+		mGenerateThread = new LLVolumeGenerateThread(threaded);
+	}
+}
+
+void LLVolumeMgr::stopGenerateThread()
+{
+	if (mGenerateThread)
+	{
+		mGenerateThread->shutdown();
+		delete mGenerateThread;
+		mGenerateThread = NULL;
+		// drop the pending flags, nothing will complete them now
+		if (mDataMutex)
+		{
+			mDataMutex->lock();
+		}
+		for (volume_lod_group_map_t::iterator iter = mVolumeLODGroups.begin();
+			 iter != mVolumeLODGroups.end(); )
+		{
+			LLVolumeLODGroup* volgroupp = (iter++)->second;
+			for (S32 i = 0; i < LLVolumeLODGroup::NUM_LODS; i++)
+			{
+				volgroupp->setLODPending(i, FALSE);
+			}
+			deleteGroupIfUnused(volgroupp);
+		}
+		if (mDataMutex)
+		{
+			mDataMutex->unlock();
+		}
+	}
+}
+
+S32 LLVolumeMgr::requestVolume(const LLVolumeParams& volume_params, const S32 detail)
+{
+	llassert(detail >= 0 && detail < LLVolumeLODGroup::NUM_LODS);
+	S32 res = -1;
+	if (mDataMutex)
+	{
+		mDataMutex->lock();
+	}
+	volume_lod_group_map_t::iterator iter = mVolumeLODGroups.find(&volume_params);
+	if (iter != mVolumeLODGroups.end())
+	{
+		LLVolumeLODGroup* volgroupp = iter->second;
+		if (volgroupp->isLODReady(detail))
+		{
+			res = detail;
+		}
+		else if (mGenerateThread && volume_params.getSculptID().isNull())
+		{
+			res = volgroupp->getNearestReadyLOD(detail);
+			if (res >= 0 && !volgroupp->isLODPending(detail))
+			{
+				volgroupp->setLODPending(detail, TRUE);
+				mGenerateThread->generate(volume_params, detail);
+				mStats.mQueued++;
+			}
+		}
+	}
+	if (mDataMutex)
+	{
+		mDataMutex->unlock();
+	}
+	return res;
+}
+
+BOOL LLVolumeMgr::isVolumeReady(const LLVolumeParams& volume_params, const S32 detail) const
+{
+	BOOL res = FALSE;
+	if (mDataMutex)
+	{
+		mDataMutex->lock();
+	}
+	volume_lod_group_map_t::const_iterator iter = mVolumeLODGroups.find(&volume_params);
+	if (iter != mVolumeLODGroups.end())
+	{
+		res = iter->second->isLODReady(detail);
+	}
+	if (mDataMutex)
+	{
+		mDataMutex->unlock();
+	}
+	return res;
+}
+
+void LLVolumeMgr::update()
+{
+	if (!mGenerateThread)
+	{
+		return;
+	}
+	mGenerateThread->update(0);
+
+	LLVolumeGenerateThread::result_list_t results;
+	mGenerateThread->getFinished(results);
+	if (results.empty())
+	{
+		return;
+	}
+
+	if (mDataMutex)
+	{
+		mDataMutex->lock();
+	}
+	for (LLVolumeGenerateThread::result_list_t::iterator res_iter = results.begin();
+		 res_iter != results.end(); ++res_iter)
+	{
+		LLVolumeGenerateThread::Result& result = *res_iter;
+		mStats.mGenerateTime += result.mTime;
+		volume_lod_group_map_t::iterator iter = mVolumeLODGroups.find(&result.mParams);
+		if (iter == mVolumeLODGroups.end())
+		{
+			mStats.mDiscarded++;
+			continue;
+		}
+		LLVolumeLODGroup* volgroupp = iter->second;
+		volgroupp->setLODPending(result.mDetail, FALSE);
+		if (result.mVolume.notNull() && volgroupp->setGeneratedLOD(result.mDetail, result.mVolume))
+		{
+			// nothing references it yet, it waits in the cache
+			mStats.mGenerated++;
+			volgroupp->setLastUsed(result.mDetail, ++mUseStamp);
+			mNumCached++;
+		}
+		else
+		{
+			// built synchronously in the meantime
+			mStats.mDiscarded++;
+			deleteGroupIfUnused(volgroupp);
+		}
+	}
+	// Without a cache the generated LODs still wait for the objects that
+	// asked for them, they go away on their first unref.
+	if (mCacheSize > 0 && mNumCached > mCacheSize)
+	{
+		trimCache();
+	}
+	if (mDataMutex)
+	{
+		mDataMutex->unlock();
+	}
+}
+
 void LLVolumeMgr::useMutex()
 { 
 	if (!mDataMutex)
@@ -262,6 +556,8 @@ LLVolumeLODGroup::LLVolumeLODGroup(const LLVolumeParams &params)
 	{
 		mLODRefs[i] = 0;
 		mAccessCount[i] = 0;
+		mPendingLODs[i] = FALSE;
+		mLastUsed[i] = 0;
 	}
 }
 
@@ -321,12 +617,7 @@ BOOL LLVolumeLODGroup::derefLOD(LLVolume *volumep)
 		{
 			llassert_always(mLODRefs[i] > 0);
 			mLODRefs[i]--;
-#if 1 // SJB: Possible opt: keep other lods around
-			if (!mLODRefs[i])
-			{
-				mVolumeLODs[i] = NULL;
-			}
-#endif
+			// An unreferenced LOD is kept until LLVolumeMgr releases or caches it
 			return TRUE;
 		}
 	}
@@ -334,6 +625,77 @@ BOOL LLVolumeLODGroup::derefLOD(LLVolume *volumep)
 	return FALSE;
 }
 
+S32 LLVolumeLODGroup::getNearestReadyLOD(const S32 detail) const
+{
+	// prefer more detail over less at the same distance
+	for (S32 delta = 0; delta < NUM_LODS; delta++)
+	{
+		if (detail + delta < NUM_LODS && mVolumeLODs[detail + delta].notNull())
+		{
+			return detail + delta;
+		}
+		if (detail - delta >= 0 && mVolumeLODs[detail - delta].notNull())
+		{
+			return detail - delta;
+		}
+	}
+	return -1;
+}
+
+S32 LLVolumeLODGroup::findLOD(const LLVolume* volumep) const
+{
+	for (S32 i = 0; i < NUM_LODS; i++)
+	{
+		if (mVolumeLODs[i] == volumep)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+BOOL LLVolumeLODGroup::hasPendingLODs() const
+{
+	for (S32 i = 0; i < NUM_LODS; i++)
+	{
+		if (mPendingLODs[i])
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+BOOL LLVolumeLODGroup::hasCachedLODs() const
+{
+	for (S32 i = 0; i < NUM_LODS; i++)
+	{
+		if (mVolumeLODs[i].notNull() && mLODRefs[i] == 0)
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+BOOL LLVolumeLODGroup::setGeneratedLOD(const S32 detail, LLVolume* volumep)
+{
+	llassert(detail >= 0 && detail < NUM_LODS);
+	if (mVolumeLODs[detail].notNull())
+	{
+		return FALSE;
+	}
+	mVolumeLODs[detail] = volumep;
+	return TRUE;
+}
+
+void LLVolumeLODGroup::releaseLOD(const S32 detail)
+{
+	llassert_always(mLODRefs[detail] == 0);
+	mVolumeLODs[detail] = NULL;
+	mLastUsed[detail] = 0;
+}
+
 S32 LLVolumeLODGroup::getDetailFromTan(const F32 tan_angle)
 {
 	S32 i = 0;
@@ -403,3 +765,84 @@ std::ostream& operator<<(std::ostream& s, const LLVolumeLODGroup& volgroup)
 	return s;
 }
 
+//============================================================================
+
+LLVolumeGenerateThread::LLVolumeGenerateThread(bool threaded)
+	: LLQueuedThread("volumegenerate", threaded),
+	  mFinishedMutex(NULL)
+{
+}
+
+LLVolumeGenerateThread::~LLVolumeGenerateThread()
+{
+	shutdown();
+}
+
+// MAIN THREAD
+LLVolumeGenerateThread::handle_t LLVolumeGenerateThread::generate(const LLVolumeParams& volume_params, S32 detail)
+{
+	handle_t handle = generateHandle();
+	GenerateRequest* req = new GenerateRequest(handle, this, volume_params, detail);
+	bool res = addRequest(req);
+	if (!res)
+	{
+		llerrs << "request added after LLVolumeGenerateThread::shutdown()" << llendl;
+	}
+	return handle;
+}
+
+// MAIN THREAD
+void LLVolumeGenerateThread::getFinished(result_list_t& results)
+{
+	LLMutexLock lock(&mFinishedMutex);
+	results.swap(mFinished);
+}
+
+// Takes the only reference to volume. The reference count is only ever
+// changed with mFinishedMutex held until the main thread owns the result.
+void LLVolumeGenerateThread::addFinished(LLPointer<LLVolume>& volume, const LLVolumeParams& volume_params,
+										 S32 detail, F64 time)
+{
+	LLMutexLock lock(&mFinishedMutex);
+	Result result;
+	result.mParams = volume_params;
+	result.mDetail = detail;
+	result.mTime = time;
+	mFinished.push_back(result);
+	mFinished.back().mVolume = volume;
+	volume = NULL;
+}
+
+LLVolumeGenerateThread::GenerateRequest::GenerateRequest(handle_t handle, LLVolumeGenerateThread* thread,
+														 const LLVolumeParams& volume_params, S32 detail)
+	// Cheap LODs first, they replace what is on screen soonest
+	: LLQueuedThread::QueuedRequest(handle, PRIORITY_NORMAL | (U32)(LLVolumeLODGroup::NUM_LODS - detail),
+									FLAG_AUTO_COMPLETE),
+	  mThread(thread),
+	  mParams(volume_params),
+	  mDetail(detail),
+	  mTime(0.0)
+{
+}
+
+LLVolumeGenerateThread::GenerateRequest::~GenerateRequest()
+{
+	// Only reached with a volume when the thread shuts down with requests
+	// still queued, and then on the main thread
+	mVolume = NULL;
+}
+
+bool LLVolumeGenerateThread::GenerateRequest::processRequest()
+{
+	LLTimer timer;
+	F32 volume_detail = LLVolumeLODGroup::getVolumeScaleFromDetail(mDetail);
+	mVolume = new LLVolume(mParams, volume_detail);
+	mTime = timer.getElapsedTimeF64();
+	return true;
+}
+
+void LLVolumeGenerateThread::GenerateRequest::finishRequest(bool completed)
+{
+	// Report aborted requests too so the group clears its pending flag
+	mThread->addFinished(mVolume, mParams, mDetail, mTime);
+}
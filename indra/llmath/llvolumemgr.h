@@ -38,10 +38,12 @@
 
 #include "llvolume.h"
 #include "llpointer.h"
+#include "llqueuedthread.h"
 #include "llthread.h"
 
 class LLVolumeParams;
 class LLVolumeLODGroup;
+class LLVolumeGenerateThread;
 
 class LLVolumeLODGroup
 {
@@ -64,6 +66,23 @@ public:
 	LLVolume* refLOD(const S32 detail);
 	BOOL derefLOD(LLVolume *volumep);
 	S32 getNumRefs() const { return mRefs; }
+	S32 getNumLODRefs(const S32 detail) const { return mLODRefs[detail]; }
+
+	// A LOD is ready when its volume exists, whether or not anything
+	// references it. Unreferenced LODs stay around until LLVolumeMgr
+	// evicts them from its cache.
+	BOOL isLODReady(const S32 detail) const { return mVolumeLODs[detail].notNull(); }
+	S32 getNearestReadyLOD(const S32 detail) const; // -1 if none
+	S32 findLOD(const LLVolume* volumep) const; // -1 if not in this group
+	BOOL isLODPending(const S32 detail) const { return mPendingLODs[detail]; }
+	void setLODPending(const S32 detail, BOOL pending) { mPendingLODs[detail] = pending; }
+	BOOL hasPendingLODs() const;
+	BOOL hasCachedLODs() const;
+	// Takes a volume built outside refLOD(), returns FALSE if the LOD already exists
+	BOOL setGeneratedLOD(const S32 detail, LLVolume* volumep);
+	void releaseLOD(const S32 detail);
+	U32 getLastUsed(const S32 detail) const { return mLastUsed[detail]; }
+	void setLastUsed(const S32 detail, U32 stamp) { mLastUsed[detail] = stamp; }
 	
 	const LLVolumeParams* getVolumeParams() const { return &mVolumeParams; };
 
@@ -79,6 +98,8 @@ protected:
 	static F32 mDetailThresholds[NUM_LODS];
 	static F32 mDetailScales[NUM_LODS];
 	S32		mAccessCount[NUM_LODS];
+	BOOL	mPendingLODs[NUM_LODS];
+	U32		mLastUsed[NUM_LODS];
 };
 
 class LLVolumeMgr
@@ -101,6 +122,46 @@ public:
 	// manually call this for mutex magic
 	void useMutex();
 
+	//--------------------------------------------------------------------
+	// Background generation
+	//
+	// Without the generate thread every volume is built inside refVolume().
+	// With it, callers that can live with a different LOD for a while use
+	// requestVolume() first and only call refVolume() for a LOD that is ready.
+	void startGenerateThread(bool threaded = true);
+	void stopGenerateThread();
+	bool hasGenerateThread() const { return mGenerateThread != NULL; }
+
+	// Returns detail if it is ready. Otherwise queues it for the generate
+	// thread and returns the nearest ready LOD of the same params, or -1 if
+	// there is none (refVolume() will then build it, nothing is queued).
+	// Sculpts are never queued, their faces need the sculpt texture.
+	S32 requestVolume(const LLVolumeParams& volume_params, const S32 detail);
+	BOOL isVolumeReady(const LLVolumeParams& volume_params, const S32 detail) const;
+
+	// MAIN THREAD: hands finished volumes to their groups. Call once a frame.
+	void update();
+
+	// Number of unreferenced volumes kept for reuse, 0 frees them right away
+	void setCacheSize(S32 count);
+	S32 getCacheSize() const { return mCacheSize; }
+	S32 getNumCached() const { return mNumCached; }
+
+	struct Stats
+	{
+		Stats();
+		U32 mHits;				// refVolume() found the LOD ready
+		U32 mMisses;			// refVolume() had to build it
+		U32 mQueued;			// sent to the generate thread
+		U32 mGenerated;			// built by the generate thread
+		U32 mDiscarded;			// built in the background but no longer needed
+		U32 mEvictions;			// cached volumes freed to stay in budget
+		F64 mMissTime;			// seconds spent building in refVolume()
+		F64 mGenerateTime;		// seconds spent building on the generate thread
+	};
+	const Stats& getStats() const { return mStats; }
+	void resetStats() { mStats = Stats(); }
+
 	friend std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr);
 
 protected:
@@ -108,11 +169,74 @@ protected:
 	// Overridden in llphysics/abstract/utils/llphysicsvolumemanager.h
 	virtual LLVolumeLODGroup* createNewGroup(const LLVolumeParams& volume_params);
 
+	// mDataMutex must be locked
+	void releaseUnused(LLVolumeLODGroup* volgroupp, S32 detail);
+	void trimCache();
+	void deleteGroupIfUnused(LLVolumeLODGroup* volgroupp);
+
 protected:
 	typedef std::map<const LLVolumeParams*, LLVolumeLODGroup*, LLVolumeParams::compare> volume_lod_group_map_t;
 	volume_lod_group_map_t mVolumeLODGroups;
 
 	LLMutex* mDataMutex;
+
+	LLVolumeGenerateThread* mGenerateThread;
+	S32 mCacheSize;
+	S32 mNumCached;
+	U32 mUseStamp;
+	Stats mStats;
+};
+
+// Builds LLVolumes for LLVolumeMgr::requestVolume(). The volumes are
+// created and filled on this thread and handed back through
+// getFinished(), so the main thread is the only one that touches a
+// volume's reference count once it is shared.
+class LLVolumeGenerateThread : public LLQueuedThread
+{
+public:
+	struct Result
+	{
+		LLVolumeParams mParams;
+		S32 mDetail;
+		LLPointer<LLVolume> mVolume;
+		F64 mTime;
+	};
+	typedef std::vector<Result> result_list_t;
+
+	class GenerateRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~GenerateRequest(); // use deleteRequest()
+
+	public:
+		GenerateRequest(handle_t handle, LLVolumeGenerateThread* thread,
+						const LLVolumeParams& volume_params, S32 detail);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+	private:
+		LLVolumeGenerateThread* mThread;
+		LLVolumeParams mParams;
+		S32 mDetail;
+		LLPointer<LLVolume> mVolume;
+		F64 mTime;
+	};
+
+public:
+	LLVolumeGenerateThread(bool threaded = true);
+	virtual ~LLVolumeGenerateThread();
+
+	// MAIN THREAD
+	handle_t generate(const LLVolumeParams& volume_params, S32 detail);
+	// MAIN THREAD: swaps out everything finished so far
+	void getFinished(result_list_t& results);
+
+private:
+	void addFinished(LLPointer<LLVolume>& volume, const LLVolumeParams& volume_params, S32 detail, F64 time);
+
+	LLMutex mFinishedMutex;
+	result_list_t mFinished;
 };
 
 #endif // LL_LLVOLUMEMGR_H
@@ -0,0 +1,579 @@
+/** 
+ * @file llfrustumcull_test.cpp
+ * @brief Test cases and benchmark for LLFrustumCuller.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "../llfrustumcull.h"
+
+#include "../llcamera.h"
+#include "llpointer.h"
+#include "llrefcount.h"
+#include "llsys.h"
+#include "lltimer.h"
+#include "../v3math.h"
+#include "../v3dmath.h"
+#include "../lloctree.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Repeatable pseudo random numbers in [0, 1)
+	class TestRand
+	{
+	public:
+		TestRand(U32 seed) : mState(seed) {}
+		F32 next()
+		{
+			mState = mState * 1664525 + 1013904223;
+			return (F32)(mState >> 8) / (F32)(1 << 24);
+		}
+		F32 range(F32 low, F32 high) { return low + (high - low) * next(); }
+	private:
+		U32 mState;
+	};
+
+	// A drawable as the octree sees it
+	class TestElement : public LLRefCount
+	{
+	public:
+		TestElement(const LLVector3& center, const LLVector3& radius)
+		:	mCenter(center),
+			mRadius(radius),
+			mPositionGroup(center),
+			mBinRadius(radius.magVec())
+		{
+		}
+
+		const LLVector3d& getPositionGroup() const { return mPositionGroup; }
+		F64 getBinRadius() const { return mBinRadius; }
+
+		LLVector3 mCenter;
+		LLVector3 mRadius;
+
+	private:
+		LLVector3d mPositionGroup;
+		F64 mBinRadius;
+	};
+
+	typedef LLOctreeNode<TestElement> TestNode;
+	typedef LLOctreeRoot<TestElement> TestRoot;
+
+	// Per node bounds, kept by a listener like LLSpatialGroup does
+	class TestGroup : public LLOctreeListener<TestElement>
+	{
+	public:
+		TestGroup(U32 index) : mIndex(index) {}
+
+		virtual void handleInsertion(const LLTreeNode<TestElement>* node, TestElement* data) { }
+		virtual void handleRemoval(const LLTreeNode<TestElement>* node, TestElement* data) { }
+		virtual void handleDestruction(const LLTreeNode<TestElement>* node) { }
+		virtual void handleStateChange(const LLTreeNode<TestElement>* node) { }
+		virtual void handleChildAddition(const TestNode* parent, TestNode* child) { }
+		virtual void handleChildRemoval(const TestNode* parent, const TestNode* child) { }
+
+		LLVector3 mBounds[2];	// center, half size
+		U32 mIndex;				// preorder index
+	};
+
+	// A dense region: clusters of small builds, some big prims and
+	// ground clutter over 256m x 256m.
+	void build_scene(TestRoot* root, U32 num_elements, U32 seed)
+	{
+		TestRand rand(seed);
+		const U32 NUM_CLUSTERS = 150;
+		std::vector<LLVector3> clusters;
+		for (U32 i = 0; i < NUM_CLUSTERS; i++)
+		{
+			clusters.push_back(LLVector3(rand.range(0.f, 256.f), rand.range(0.f, 256.f), rand.range(20.f, 80.f)));
+		}
+
+		for (U32 i = 0; i < num_elements; i++)
+		{
+			LLVector3 center;
+			LLVector3 radius;
+			F32 kind = rand.next();
+			if (kind < 0.8f)
+			{
+				const LLVector3& cluster = clusters[i % NUM_CLUSTERS];
+				center = cluster + LLVector3(rand.range(-12.f, 12.f), rand.range(-12.f, 12.f), rand.range(-6.f, 10.f));
+				radius.setVec(rand.range(0.05f, 2.f), rand.range(0.05f, 2.f), rand.range(0.05f, 2.f));
+			}
+			else if (kind < 0.95f)
+			{
+				center.setVec(rand.range(0.f, 256.f), rand.range(0.f, 256.f), rand.range(20.f, 24.f));
+				radius.setVec(rand.range(0.2f, 1.f), rand.range(0.2f, 1.f), rand.range(0.2f, 1.f));
+			}
+			else
+			{
+				center.setVec(rand.range(0.f, 256.f), rand.range(0.f, 256.f), rand.range(20.f, 60.f));
+				radius.setVec(rand.range(4.f, 32.f), rand.range(4.f, 32.f), rand.range(0.5f, 16.f));
+			}
+			root->insert(new TestElement(center, radius));
+		}
+	}
+
+	// Preorder layout of the tree, what LLSpatialPartition rebuilds
+	struct TestLayout
+	{
+		std::vector<TestNode*> mNodes;
+		std::vector<U32> mSubtreeEnd;
+		LLAABBStreams mBounds;
+	};
+
+	void bound_node(TestNode* node, LLVector3& min, LLVector3& max)
+	{
+		bool empty = true;
+		for (TestNode::element_iter i = node->getData().begin(); i != node->getData().end(); ++i)
+		{
+			LLVector3 emin = (*i)->mCenter - (*i)->mRadius;
+			LLVector3 emax = (*i)->mCenter + (*i)->mRadius;
+			if (empty)
+			{
+				min = emin;
+				max = emax;
+				empty = false;
+			}
+			else
+			{
+				update_min_max(min, max, emin);
+				update_min_max(min, max, emax);
+			}
+		}
+
+		for (U32 i = 0; i < node->getChildCount(); i++)
+		{
+			LLVector3 cmin, cmax;
+			bound_node(node->getChild(i), cmin, cmax);
+			if (empty)
+			{
+				min = cmin;
+				max = cmax;
+				empty = false;
+			}
+			else
+			{
+				update_min_max(min, max, cmin);
+				update_min_max(min, max, cmax);
+			}
+		}
+
+		TestGroup* group = new TestGroup(0);
+		group->mBounds[0] = (min + max) * 0.5f;
+		group->mBounds[1] = (max - min) * 0.5f;
+		node->addListener(group);
+	}
+
+	void flatten_node(TestNode* node, TestLayout& layout)
+	{
+		U32 index = layout.mNodes.size();
+		((TestGroup*)node->getListener(0))->mIndex = index;
+		layout.mNodes.push_back(node);
+		layout.mSubtreeEnd.push_back(0);
+		for (U32 i = 0; i < node->getChildCount(); i++)
+		{
+			flatten_node(node->getChild(i), layout);
+		}
+		layout.mSubtreeEnd[index] = layout.mNodes.size();
+	}
+
+	void build_layout(TestRoot* root, TestLayout& layout)
+	{
+		LLVector3 min, max;
+		bound_node(root, min, max);
+		flatten_node(root, layout);
+		layout.mBounds.resize(layout.mNodes.size());
+		for (U32 i = 0; i < layout.mNodes.size(); i++)
+		{
+			TestGroup* group = (TestGroup*)layout.mNodes[i]->getListener(0);
+			layout.mBounds.set(i, group->mBounds[0], group->mBounds[1]);
+		}
+	}
+
+	// Sets up the agent frustum the way LLViewerCamera does, from the
+	// corners of the near and far planes.
+	void setup_camera(LLCamera& camera, const LLVector3& origin, const LLVector3& target, F32 fov, F32 aspect, F32 near_dist, F32 far_dist)
+	{
+		camera.lookAt(origin, target);
+		LLVector3 at = camera.getAtAxis();
+		LLVector3 right = -camera.getLeftAxis();
+		LLVector3 up = camera.getUpAxis();
+
+		F32 half_height = near_dist * tanf(fov * 0.5f);
+		F32 half_width = half_height * aspect;
+		LLVector3 near_center = origin + at * near_dist;
+
+		LLVector3 frust[8];
+		frust[0] = near_center - right * half_width - up * half_height;
+		frust[1] = near_center + right * half_width - up * half_height;
+		frust[2] = near_center + right * half_width + up * half_height;
+		frust[3] = near_center - right * half_width + up * half_height;
+		for (U32 i = 0; i < 4; i++)
+		{
+			frust[i + 4] = origin + (frust[i] - origin) * (far_dist / near_dist);
+		}
+		camera.calcAgentFrustumPlanes(frust);
+	}
+
+	void setup_test_camera(LLCamera& camera, U32 index)
+	{
+		F32 angle = (F32)index * 0.7f;
+		LLVector3 origin(128.f + 60.f * cosf(angle), 128.f + 60.f * sinf(angle), 35.f + 5.f * (F32)(index % 3));
+		LLVector3 target(128.f, 128.f, 30.f);
+		setup_camera(camera, origin, target, 1.0f, 1.6f, 0.5f, 128.f);
+	}
+
+	// Today's cull: recursive descent over the octree, testing each node
+	// against the camera until a node is fully inside.
+	class TestRecursiveCull : public LLOctreeTraveler<TestElement>
+	{
+	public:
+		TestRecursiveCull(LLCamera* camera, std::vector<U8>& visible)
+		:	mCamera(camera), mVisible(visible), mRes(0)
+		{
+		}
+
+		virtual void traverse(const TestNode* node)
+		{
+			TestGroup* group = (TestGroup*)node->getListener(0);
+			if (mRes == 2)
+			{
+				visit(node);
+				for (U32 i = 0; i < node->getChildCount(); i++)
+				{
+					traverse(node->getChild(i));
+				}
+				return;
+			}
+
+			mRes = mCamera->AABBInFrustumNoFarClip(group->mBounds[0], group->mBounds[1]);
+			if (mRes)
+			{
+				visit(node);
+				for (U32 i = 0; i < node->getChildCount(); i++)
+				{
+					traverse(node->getChild(i));
+				}
+			}
+			mRes = 0;
+		}
+
+		virtual void visit(const TestNode* node)
+		{
+			mVisible[((TestGroup*)node->getListener(0))->mIndex] = 1;
+		}
+
+	private:
+		LLCamera* mCamera;
+		std::vector<U8>& mVisible;
+		S32 mRes;
+	};
+
+	// The linear cull over the preorder layout
+	void linear_cull(const TestLayout& layout, LLFrustumCullResults& results, std::vector<U8>& visible)
+	{
+		U32 count = layout.mNodes.size();
+		U32 i = 0;
+		while (i < count)
+		{
+			S32 res = results.get(i);
+			if (res == 0)
+			{
+				i = layout.mSubtreeEnd[i];
+			}
+			else if (res == 2)
+			{
+				for (U32 end = layout.mSubtreeEnd[i]; i < end; i++)
+				{
+					visible[i] = 1;
+				}
+			}
+			else
+			{
+				visible[i++] = 1;
+			}
+		}
+	}
+}
+
+namespace tut
+{
+	struct frustumcull_test
+	{
+		frustumcull_test()
+		{
+			mOldVectorize = LLFrustumCuller::getVectorize();
+		}
+
+		~frustumcull_test()
+		{
+			LLFrustumCuller::setVectorize(mOldVectorize);
+		}
+
+		bool mOldVectorize;
+	};
+	typedef test_group<frustumcull_test> frustumcull_t;
+	typedef frustumcull_t::object frustumcull_object_t;
+	tut::frustumcull_t tut_frustumcull("LLFrustumCuller");
+
+	// boxes from around and through a frustum, many of them straddling
+	// planes
+	void make_test_boxes(LLAABBStreams& boxes, U32 count, U32 seed)
+	{
+		TestRand rand(seed);
+		boxes.resize(count);
+		for (U32 i = 0; i < count; i++)
+		{
+			F32 size = (i % 7 == 0) ? 40.f : 4.f;
+			LLVector3 center(rand.range(-50.f, 250.f), rand.range(-50.f, 250.f), rand.range(-20.f, 100.f));
+			LLVector3 radius(rand.range(0.f, size), rand.range(0.f, size), rand.range(0.f, size));
+			boxes.set(i, center, radius);
+		}
+	}
+
+	// streams round trip and padding
+	template<> template<>
+	void frustumcull_object_t::test<1>()
+	{
+		LLAABBStreams boxes;
+		boxes.resize(5);
+		ensure_equals("size", boxes.size(), (U32)5);
+		ensure_equals("padded size", boxes.paddedSize(), (U32)8);
+		ensure("aligned", ((uintptr_t)boxes.getStream(0) & 15) == 0);
+
+		boxes.set(4, LLVector3(1.f, 2.f, 3.f), LLVector3(4.f, 5.f, 6.f));
+		boxes.resize(200);
+		LLVector3 center, radius;
+		boxes.get(4, center, radius);
+		ensure_equals("center kept", center, LLVector3(1.f, 2.f, 3.f));
+		ensure_equals("radius kept", radius, LLVector3(4.f, 5.f, 6.f));
+		ensure("aligned after growing", ((uintptr_t)boxes.getStream(LLAABBStreams::RADIUS_Z) & 15) == 0);
+
+		boxes.resize(3);
+		boxes.resize(5);
+		boxes.get(4, center, radius);
+		ensure_equals("dropped box cleared", center, LLVector3::zero);
+		ensure_equals("dropped box radius cleared", radius, LLVector3::zero);
+	}
+
+	// scalar kernel against LLCamera, with and without the far plane
+	template<> template<>
+	void frustumcull_object_t::test<2>()
+	{
+		LLFrustumCuller::setVectorize(false);
+
+		const U32 NUM_BOXES = 4096;
+		LLAABBStreams boxes;
+		make_test_boxes(boxes, NUM_BOXES, 17);
+		std::vector<U8> results(boxes.paddedSize());
+
+		for (U32 c = 0; c < 8; c++)
+		{
+			LLCamera camera;
+			setup_test_camera(camera, c);
+
+			LLVector3 ahead = camera.getOrigin() + camera.getAtAxis() * 20.f;
+			LLVector3 behind = camera.getOrigin() - camera.getAtAxis() * 20.f;
+			ensure_equals("box ahead is inside", camera.AABBInFrustum(ahead, LLVector3(1.f, 1.f, 1.f)), 2);
+			ensure_equals("box behind is outside", camera.AABBInFrustum(behind, LLVector3(1.f, 1.f, 1.f)), 0);
+
+			for (U32 far_clip = 0; far_clip < 2; far_clip++)
+			{
+				LLFrustumCuller culler(camera, far_clip != 0);
+				culler.test(boxes, 0, boxes.paddedSize(), &results[0]);
+
+				U32 counts[3] = { 0, 0, 0 };
+				for (U32 i = 0; i < NUM_BOXES; i++)
+				{
+					LLVector3 center, radius;
+					boxes.get(i, center, radius);
+					S32 expected = far_clip ? camera.AABBInFrustum(center, radius)
+											: camera.AABBInFrustumNoFarClip(center, radius);
+					ensure_equals("scalar matches LLCamera", (S32)results[i], expected);
+					counts[expected]++;
+				}
+				ensure("some boxes outside", counts[0] > 0);
+				ensure("some boxes partly inside", counts[1] > 0);
+				ensure("some boxes inside", counts[2] > 0);
+			}
+		}
+	}
+
+	// SSE2 kernel against the scalar one
+	template<> template<>
+	void frustumcull_object_t::test<3>()
+	{
+		LLFrustumCuller::setVectorize(true);
+		if (!LLFrustumCuller::getVectorize())
+		{
+			skip("no SSE2");
+		}
+
+		const U32 NUM_BOXES = 4093;
+		LLAABBStreams boxes;
+		make_test_boxes(boxes, NUM_BOXES, 23);
+		std::vector<U8> scalar(boxes.paddedSize());
+		std::vector<U8> vectorized(boxes.paddedSize());
+
+		for (U32 c = 0; c < 8; c++)
+		{
+			LLCamera camera;
+			setup_test_camera(camera, c);
+			for (U32 far_clip = 0; far_clip < 2; far_clip++)
+			{
+				LLFrustumCuller culler(camera, far_clip != 0);
+				LLFrustumCuller::setVectorize(false);
+				culler.test(boxes, 0, boxes.paddedSize(), &scalar[0]);
+				LLFrustumCuller::setVectorize(true);
+				culler.test(boxes, 0, boxes.paddedSize(), &vectorized[0]);
+				for (U32 i = 0; i < boxes.paddedSize(); i++)
+				{
+					ensure_equals("SSE2 matches scalar", vectorized[i], scalar[i]);
+				}
+			}
+		}
+	}
+
+	// lazy results only test what is asked for
+	template<> template<>
+	void frustumcull_object_t::test<4>()
+	{
+		LLFrustumCuller::setVectorize(false);
+
+		LLAABBStreams boxes;
+		make_test_boxes(boxes, 37, 5);
+		LLCamera camera;
+		setup_test_camera(camera, 0);
+		LLFrustumCuller culler(camera, false);
+
+		LLFrustumCullResults results;
+		for (U32 pass = 0; pass < 2; pass++)
+		{
+			results.begin(&culler, &boxes);
+			for (U32 i = 36; i < 37; i--)
+			{
+				LLVector3 center, radius;
+				boxes.get(i, center, radius);
+				ensure_equals("lazy result", results.get(i), camera.AABBInFrustumNoFarClip(center, radius));
+			}
+		}
+	}
+
+	// Octree benchmark: the recursive cull against the linear one, which
+	// must see the same nodes.
+	template<> template<>
+	void frustumcull_object_t::test<5>()
+	{
+		const U32 NUM_ELEMENTS = 16384;
+		const U32 NUM_CAMERAS = 16;
+		const U32 PASSES = 20;
+
+		TestRoot* root = new TestRoot(LLVector3d(0, 0, 0), LLVector3d(1, 1, 1), NULL);
+		build_scene(root, NUM_ELEMENTS, 42);
+
+		TestLayout layout;
+		build_layout(root, layout);
+		U32 num_nodes = layout.mNodes.size();
+		ensure("octree has branches", num_nodes > 64);
+
+		std::vector<LLCamera> cameras(NUM_CAMERAS);
+		for (U32 c = 0; c < NUM_CAMERAS; c++)
+		{
+			setup_test_camera(cameras[c], c);
+		}
+
+		LLFrustumCuller::setVectorize(true);
+		bool has_sse2 = LLFrustumCuller::getVectorize();
+
+		std::vector<U8> expected(num_nodes);
+		std::vector<U8> visible(num_nodes);
+		LLFrustumCullResults results;
+		for (U32 c = 0; c < NUM_CAMERAS; c++)
+		{
+			std::fill(expected.begin(), expected.end(), 0);
+			TestRecursiveCull cull(&cameras[c], expected);
+			cull.traverse(root);
+
+			for (U32 vectorize = 0; vectorize < 2; vectorize++)
+			{
+				LLFrustumCuller::setVectorize(vectorize != 0);
+				LLFrustumCuller culler(cameras[c], false);
+				std::fill(visible.begin(), visible.end(), 0);
+				results.begin(&culler, &layout.mBounds);
+				linear_cull(layout, results, visible);
+				ensure("linear cull sees the same nodes", visible == expected);
+			}
+		}
+
+		F64 seconds[3] = { 0.0, 0.0, 0.0 };
+		U32 visible_count = 0;
+		for (U32 method = 0; method < 3; method++)
+		{
+			if (method == 2 && !has_sse2)
+			{
+				break;
+			}
+			LLFrustumCuller::setVectorize(method == 2);
+
+			LLTimer timer;
+			for (U32 pass = 0; pass < PASSES; pass++)
+			{
+				for (U32 c = 0; c < NUM_CAMERAS; c++)
+				{
+					std::fill(visible.begin(), visible.end(), 0);
+					if (method == 0)
+					{
+						TestRecursiveCull cull(&cameras[c], visible);
+						cull.traverse(root);
+					}
+					else
+					{
+						LLFrustumCuller culler(cameras[c], false);
+						results.begin(&culler, &layout.mBounds);
+						linear_cull(layout, results, visible);
+					}
+					visible_count += visible[0];
+				}
+			}
+			seconds[method] = timer.getElapsedTimeF64();
+		}
+
+		llinfos << "LLFrustumCuller: " << NUM_ELEMENTS << " elements in " << num_nodes << " nodes, "
+			<< PASSES * NUM_CAMERAS << " culls.  recursive: " << seconds[0]
+			<< "s linear: " << seconds[1] << "s linear SSE2: " << seconds[2] << "s" << llendl;
+
+		delete root;
+		ensure("timed", visible_count > 0);
+	}
+}
@@ -0,0 +1,275 @@
+/** 
+ * @file llvolume_test.cpp
+ * @brief Test for llvolume.cpp.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "../test/lltut.h"
+
+#include "llpointer.h"
+#include "lltimer.h"
+#include "m3math.h"
+#include "m4math.h"
+#include "v4coloru.h"
+#include "../llvolume.h"
+
+#include <vector>
+
+namespace tut
+{
+	// Interleaved like an LLVertexBuffer with position, normal, texcoord,
+	// color and binormal
+	struct BufferVertex
+	{
+		LLVector3 mPosition;
+		LLVector3 mNormal;
+		LLVector2 mTexCoord;
+		LLColor4U mColor;
+		LLVector3 mBinormal;
+	};
+
+	struct LLVolumeData
+	{
+		std::vector<LLVolumeParams> mCorpus;
+		LLMatrix4 mMatVert;
+		LLMatrix3 mMatNormal;
+
+		LLVolumeData()
+		{
+			// the shapes people build with most, plain and with the usual edits
+			const U8 shapes[][2] =
+			{
+				{ LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE },		// box
+				{ LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_LINE },		// cylinder
+				{ LL_PCODE_PROFILE_EQUALTRI, LL_PCODE_PATH_LINE },		// prism
+				{ LL_PCODE_PROFILE_CIRCLE_HALF, LL_PCODE_PATH_CIRCLE },	// sphere
+				{ LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE },		// torus
+				{ LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_CIRCLE },		// tube
+				{ LL_PCODE_PROFILE_EQUALTRI, LL_PCODE_PATH_CIRCLE }		// ring
+			};
+			for (S32 i = 0; i < (S32)(sizeof(shapes) / sizeof(shapes[0])); i++)
+			{
+				for (S32 variant = 0; variant < 4; variant++)
+				{
+					LLVolumeParams params;
+					params.setType(shapes[i][0], shapes[i][1]);
+					params.setBeginAndEndS(variant & 1 ? 0.125f : 0.f, 1.f);
+					params.setBeginAndEndT(0.f, 1.f);
+					params.setRatio(1.f, 1.f);
+					params.setShear(0.f, 0.f);
+					params.setHollow(variant & 2 ? 0.5f : 0.f);
+					params.setTwistEnd(variant == 3 ? 0.5f : 0.f);
+					mCorpus.push_back(params);
+				}
+			}
+
+			LLQuaternion rot(0.3f, LLVector3(0.f, 1.f, 1.f));
+			mMatVert.initAll(LLVector3(2.f, 0.5f, 1.f), rot, LLVector3(128.f, 64.f, 22.f));
+			mMatNormal = rot.getMatrix3();
+		}
+
+		// What LLFace::getGeometryVolume() did with one interleaved vertex at a time
+		static void fillInterleaved(const std::vector<LLVolumeFace::VertexData>& verts,
+									const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
+									BufferVertex* out)
+		{
+			for (U32 i = 0; i < verts.size(); i++)
+			{
+				out[i].mPosition = verts[i].mPosition * mat_vert;
+				LLVector3 normal = verts[i].mNormal * mat_normal;
+				normal.normVec();
+				out[i].mNormal = normal;
+				LLVector3 binormal = verts[i].mBinormal * mat_normal;
+				binormal.normVec();
+				out[i].mBinormal = binormal;
+			}
+		}
+
+		static void fillStreams(const LLVolumeFace& face,
+								const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
+								BufferVertex* out)
+		{
+			LLStrider<LLVector3> vertices;
+			vertices = &out[0].mPosition;
+			vertices.setStride(sizeof(BufferVertex));
+			LLStrider<LLVector3> normals;
+			normals = &out[0].mNormal;
+			normals.setStride(sizeof(BufferVertex));
+			LLStrider<LLVector3> binormals;
+			binormals = &out[0].mBinormal;
+			binormals.setStride(sizeof(BufferVertex));
+
+			face.getPositions(vertices, mat_vert);
+			face.getNormals(normals, mat_normal);
+			face.getBinormals(binormals, mat_normal);
+		}
+
+		static void copyVertices(const LLVolumeFace& face, std::vector<LLVolumeFace::VertexData>& verts)
+		{
+			verts.resize(face.getNumVertices());
+			for (S32 i = 0; i < face.getNumVertices(); i++)
+			{
+				verts[i].mPosition = face.getPosition(i);
+				verts[i].mNormal = face.getNormal(i);
+				verts[i].mBinormal = face.getBinormal(i);
+				verts[i].mTexCoord = face.getTexCoord(i);
+			}
+		}
+	};
+
+	typedef test_group<LLVolumeData> factory;
+	typedef factory::object object;
+}
+
+namespace
+{
+	tut::factory llvolume_test_factory("LLVolume");
+}
+
+namespace tut
+{
+	template<> template<>
+	void object::test<1>()
+	{
+		// the streams are aligned for SIMD loads and survive face copies
+		LLPointer<LLVolume> volume = new LLVolume(mCorpus[1], 1.f);
+		ensure("volume has faces", volume->getNumVolumeFaces() > 0);
+		for (S32 f = 0; f < volume->getNumVolumeFaces(); f++)
+		{
+			const LLVolumeFace& face = volume->getVolumeFace(f);
+			ensure("face has vertices", face.getNumVertices() > 0);
+			ensure("positions aligned", ((uintptr_t)face.mPositions & 15) == 0);
+			ensure("normals aligned", ((uintptr_t)face.mNormals & 15) == 0);
+			ensure("binormals aligned", ((uintptr_t)face.mBinormals & 15) == 0);
+
+			LLVolumeFace copy(face);
+			ensure_equals("copy vertex count", copy.getNumVertices(), face.getNumVertices());
+			ensure("copy has its own streams", copy.mPositions != face.mPositions);
+			for (S32 i = 0; i < face.getNumVertices(); i++)
+			{
+				ensure("copied position", copy.getPosition(i) == face.getPosition(i));
+				ensure("copied normal", copy.getNormal(i) == face.getNormal(i));
+				ensure("copied tex coord", copy.getTexCoord(i) == face.getTexCoord(i));
+			}
+
+			copy.resizeVertices(face.getNumVertices() + 5);
+			ensure("grow keeps vertices", copy.getPosition(0) == face.getPosition(0));
+			copy.resizeVertices(0);
+			ensure("empty face has no streams", copy.mPositions == NULL);
+		}
+	}
+
+	template<> template<>
+	void object::test<2>()
+	{
+		// stream copies match the old per vertex transform
+		for (U32 p = 0; p < mCorpus.size(); p++)
+		{
+			LLPointer<LLVolume> volume = new LLVolume(mCorpus[p], 2.5f);
+			for (S32 f = 0; f < volume->getNumVolumeFaces(); f++)
+			{
+				volume->genBinormals(f);
+				const LLVolumeFace& face = volume->getVolumeFace(f);
+				std::vector<LLVolumeFace::VertexData> verts;
+				copyVertices(face, verts);
+
+				std::vector<BufferVertex> expected(verts.size());
+				std::vector<BufferVertex> actual(verts.size());
+				fillInterleaved(verts, mMatVert, mMatNormal, &expected[0]);
+				fillStreams(face, mMatVert, mMatNormal, &actual[0]);
+
+				for (U32 i = 0; i < verts.size(); i++)
+				{
+					ensure("position matches", dist_vec(expected[i].mPosition, actual[i].mPosition) < 1e-4f);
+					ensure("normal matches", dist_vec(expected[i].mNormal, actual[i].mNormal) < 1e-5f);
+					ensure("binormal matches", dist_vec(expected[i].mBinormal, actual[i].mBinormal) < 1e-5f);
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void object::test<3>()
+	{
+		// benchmark: refilling the vertex buffer for every face of the corpus,
+		// which is what a REBUILD_VOLUME costs per object
+		const S32 PASSES = 50;
+		std::vector<LLPointer<LLVolume> > volumes;
+		std::vector<std::vector<LLVolumeFace::VertexData> > legacy;
+		U32 max_verts = 0;
+		U32 total_verts = 0;
+		for (U32 p = 0; p < mCorpus.size(); p++)
+		{
+			LLPointer<LLVolume> volume = new LLVolume(mCorpus[p], 4.f);
+			volumes.push_back(volume);
+			for (S32 f = 0; f < volume->getNumVolumeFaces(); f++)
+			{
+				volume->genBinormals(f);
+				legacy.push_back(std::vector<LLVolumeFace::VertexData>());
+				copyVertices(volume->getVolumeFace(f), legacy.back());
+				max_verts = llmax(max_verts, (U32)legacy.back().size());
+				total_verts += legacy.back().size();
+			}
+		}
+		std::vector<BufferVertex> buffer(max_verts);
+
+		LLTimer timer;
+		for (S32 pass = 0; pass < PASSES; pass++)
+		{
+			for (U32 i = 0; i < legacy.size(); i++)
+			{
+				fillInterleaved(legacy[i], mMatVert, mMatNormal, &buffer[0]);
+			}
+		}
+		F64 interleaved_time = timer.getElapsedTimeF64();
+
+		timer.reset();
+		for (S32 pass = 0; pass < PASSES; pass++)
+		{
+			for (U32 v = 0; v < volumes.size(); v++)
+			{
+				for (S32 f = 0; f < volumes[v]->getNumVolumeFaces(); f++)
+				{
+					fillStreams(volumes[v]->getVolumeFace(f), mMatVert, mMatNormal, &buffer[0]);
+				}
+			}
+		}
+		F64 stream_time = timer.getElapsedTimeF64();
+
+		llinfos << "Volume face fill, " << mCorpus.size() << " prims, " << total_verts
+				<< " vertices x " << PASSES << " passes: per vertex "
+				<< interleaved_time * 1000.0 << " ms, streams " << stream_time * 1000.0 << " ms ("
+				<< (stream_time > 0.0 ? interleaved_time / stream_time : 0.0) << "x)" << llendl;
+		ensure("benchmark ran", total_verts > 0);
+	}
+}
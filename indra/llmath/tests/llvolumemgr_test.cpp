@@ -0,0 +1,209 @@
+/** 
+ * @file llvolumemgr_test.cpp
+ * @brief Test for llvolumemgr.cpp.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "../test/lltut.h"
+
+#include "lltimer.h"
+#include "../llvolume.h"
+#include "../llvolumemgr.h"
+
+namespace tut
+{
+	struct LLVolumeMgrData
+	{
+		LLVolumeMgr* mMgr;
+
+		LLVolumeMgrData()
+		{
+			mMgr = new LLVolumeMgr();
+		}
+		~LLVolumeMgrData()
+		{
+			delete mMgr;
+		}
+
+		// a box cut by begin, so each begin value is its own LOD group
+		static LLVolumeParams makeParams(F32 begin)
+		{
+			LLVolumeParams params;
+			params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+			params.setBeginAndEndS(begin, 1.f);
+			params.setBeginAndEndT(0.f, 1.f);
+			params.setRatio(1.f, 1.f);
+			params.setShear(0.f, 0.f);
+			return params;
+		}
+
+		// pumps update() until the LOD is ready or a few seconds went by
+		bool waitReady(const LLVolumeParams& params, S32 detail)
+		{
+			LLTimer timer;
+			while (timer.getElapsedTimeF32() < 5.f)
+			{
+				mMgr->update();
+				if (mMgr->isVolumeReady(params, detail))
+				{
+					return true;
+				}
+				ms_sleep(1);
+			}
+			return false;
+		}
+	};
+
+	typedef test_group<LLVolumeMgrData> factory;
+	typedef factory::object object;
+}
+
+namespace
+{
+	tut::factory llvolumemgr_test_factory("LLVolumeMgr");
+}
+
+namespace tut
+{
+	template<> template<>
+	void object::test<1>()
+	{
+		// without a cache an unreferenced LOD goes away right away
+		LLVolumeParams params = makeParams(0.f);
+		LLVolume* volumep = mMgr->refVolume(params, 2);
+		ensure("ref builds the volume", volumep != NULL);
+		ensure("ref'd LOD is ready", mMgr->isVolumeReady(params, 2));
+		ensure_equals("first ref misses", mMgr->getStats().mMisses, 1U);
+		mMgr->unrefVolume(volumep);
+		ensure("unref'd LOD is freed", !mMgr->isVolumeReady(params, 2));
+		ensure_equals("nothing cached", mMgr->getNumCached(), 0);
+	}
+
+	template<> template<>
+	void object::test<2>()
+	{
+		// with a cache it is kept and the next ref is a hit
+		mMgr->setCacheSize(8);
+		LLVolumeParams params = makeParams(0.f);
+		LLPointer<LLVolume> volumep = mMgr->refVolume(params, 2);
+		LLVolume* first = volumep;
+		mMgr->unrefVolume(volumep);
+		ensure("unref'd LOD is cached", mMgr->isVolumeReady(params, 2));
+		ensure_equals("one cached", mMgr->getNumCached(), 1);
+
+		LLVolume* second = mMgr->refVolume(params, 2);
+		ensure("same volume comes back", first == second);
+		ensure_equals("second ref hits", mMgr->getStats().mHits, 1U);
+		ensure_equals("no longer cached", mMgr->getNumCached(), 0);
+		mMgr->unrefVolume(second);
+		volumep = NULL;
+
+		mMgr->setCacheSize(0);
+		ensure("cache size 0 frees it", !mMgr->isVolumeReady(params, 2));
+	}
+
+	template<> template<>
+	void object::test<3>()
+	{
+		// the least recently used LODs are evicted first
+		const S32 CACHE_SIZE = 8;
+		const S32 COUNT = 16;
+		mMgr->setCacheSize(CACHE_SIZE);
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			LLVolume* volumep = mMgr->refVolume(makeParams(i * 0.05f), 1);
+			mMgr->unrefVolume(volumep);
+		}
+		ensure("cache stays in budget", mMgr->getNumCached() <= CACHE_SIZE);
+		ensure("cache is used", mMgr->getNumCached() > 0);
+		ensure("evictions counted", mMgr->getStats().mEvictions >= (U32)(COUNT - CACHE_SIZE));
+		ensure("oldest evicted", !mMgr->isVolumeReady(makeParams(0.f), 1));
+		ensure("newest kept", mMgr->isVolumeReady(makeParams((COUNT - 1) * 0.05f), 1));
+	}
+
+	template<> template<>
+	void object::test<4>()
+	{
+		// background generation run from update()
+		mMgr->setCacheSize(8);
+		mMgr->startGenerateThread(false);
+		LLVolumeParams params = makeParams(0.f);
+
+		ensure_equals("nothing ready, build it now", mMgr->requestVolume(params, 3), -1);
+		LLVolume* low = mMgr->refVolume(params, 0);
+		ensure_equals("ready LOD is returned", mMgr->requestVolume(params, 0), 0);
+		ensure_equals("nearest ready LOD meanwhile", mMgr->requestVolume(params, 3), 0);
+		mMgr->requestVolume(params, 3);
+		ensure_equals("queued once", mMgr->getStats().mQueued, 1U);
+
+		ensure("LOD generated", waitReady(params, 3));
+		ensure_equals("generated counted", mMgr->getStats().mGenerated, 1U);
+		LLVolume* high = mMgr->refVolume(params, 3);
+		ensure_equals("generated LOD detail",
+					  high->getDetail(), LLVolumeLODGroup::getVolumeScaleFromDetail(3));
+		ensure_equals("generated LOD is a hit", mMgr->getStats().mHits, 1U);
+
+		mMgr->unrefVolume(low);
+		mMgr->unrefVolume(high);
+		mMgr->stopGenerateThread();
+		ensure("no references left", mMgr->cleanup());
+	}
+
+	template<> template<>
+	void object::test<5>()
+	{
+		// background generation on its own thread
+		mMgr->setCacheSize(8);
+		mMgr->startGenerateThread(true);
+		const S32 COUNT = 8;
+		std::vector<LLVolume*> volumes;
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			LLVolumeParams params = makeParams(i * 0.05f);
+			volumes.push_back(mMgr->refVolume(params, 0));
+			ensure_equals("nearest ready LOD meanwhile", mMgr->requestVolume(params, 2), 0);
+		}
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			ensure("LOD generated", waitReady(makeParams(i * 0.05f), 2));
+		}
+		ensure_equals("all generated", mMgr->getStats().mGenerated, (U32)COUNT);
+
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			mMgr->unrefVolume(volumes[i]);
+		}
+		mMgr->stopGenerateThread();
+		ensure("no references left", mMgr->cleanup());
+	}
+}
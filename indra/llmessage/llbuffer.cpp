@@ -39,6 +39,10 @@
 #include "llmath.h"
 #include "llmemtype.h"
 #include "llstl.h"
+#include "llthread.h"
+
+#define APR_WANT_IOVEC
+#include "apr_want.h"
 
 /** 
  * LLSegment
@@ -102,6 +106,39 @@ bool LLSegment::operator==(const LLSegment& rhs) const
 /** 
  * LLHeapBuffer
  */
+LLMutex* LLHeapBuffer::sPoolMutex = NULL;
+std::vector<U8*> LLHeapBuffer::sPool;
+S32 LLHeapBuffer::sMaxPoolSize = 0;
+
+// static
+void LLHeapBuffer::initPool(S32 max_free)
+{
+	if(!sPoolMutex)
+	{
+		sPoolMutex = new LLMutex(NULL);
+	}
+	LLMutexLock lock(sPoolMutex);
+	sMaxPoolSize = max_free;
+	sPool.reserve(max_free);
+}
+
+// static
+void LLHeapBuffer::cleanupPool()
+{
+	if(!sPoolMutex)
+	{
+		return;
+	}
+	{
+		LLMutexLock lock(sPoolMutex);
+		std::for_each(sPool.begin(), sPool.end(), DeletePointerArray());
+		sPool.clear();
+		sMaxPoolSize = 0;
+	}
+	delete sPoolMutex;
+	sPoolMutex = NULL;
+}
+
 LLHeapBuffer::LLHeapBuffer() :
 	mBuffer(NULL),
 	mSize(0),
@@ -109,7 +146,6 @@ LLHeapBuffer::LLHeapBuffer() :
 	mReclaimedBytes(0)
 {
 	LLMemType m1(LLMemType::MTYPE_IO_BUFFER);
-	const S32 DEFAULT_HEAP_BUFFER_SIZE = 16384;
 	allocate(DEFAULT_HEAP_BUFFER_SIZE);
 }
 
@@ -144,6 +180,15 @@ LLHeapBuffer::LLHeapBuffer(const U8* src, S32 len) :
 LLHeapBuffer::~LLHeapBuffer()
 {
 	LLMemType m1(LLMemType::MTYPE_IO_BUFFER);
+	if(sPoolMutex && (DEFAULT_HEAP_BUFFER_SIZE == mSize))
+	{
+		LLMutexLock lock(sPoolMutex);
+		if((S32)sPool.size() < sMaxPoolSize)
+		{
+			sPool.push_back(mBuffer);
+			mBuffer = NULL;
+		}
+	}
 	delete[] mBuffer;
 	mBuffer = NULL;
 	mSize = 0;
@@ -162,6 +207,11 @@ bool LLHeapBuffer::createSegment(
 	LLSegment& segment)
 {
 	LLMemType m1(LLMemType::MTYPE_IO_BUFFER);
+	if(mShared)
+	{
+		return false;
+	}
+
 	// get actual size of the segment.
 	S32 actual_size = llmin(size, (mSize - S32(mNextFree - mBuffer)));
 
@@ -182,16 +232,34 @@ bool LLHeapBuffer::reclaimSegment(const LLSegment& segment)
 {
 	if(containsSegment(segment))
 	{
-		mReclaimedBytes += segment.size();
-		if(mReclaimedBytes == mSize)
+		if(mShared)
+		{
+			// Segments of a shared buffer may be reclaimed once for
+			// every buffer array holding them, and the memory is not
+			// reused anyway.
+			return true;
+		}
+		if((segment.data() + segment.size()) == mNextFree)
+		{
+			// This was the last memory handed out, typically the
+			// unused end of a segment just trimmed. It can be handed
+			// out again right away.
+			mNextFree = segment.data();
+		}
+		else
+		{
+			mReclaimedBytes += segment.size();
+		}
+		S32 used = mNextFree - mBuffer;
+		if(mReclaimedBytes == used)
 		{
-			// We have reclaimed all of the memory from this
-			// buffer. Therefore, we can reset the mNextFree to the
-			// start of the buffer, and reset the reclaimed bytes.
+			// We have reclaimed all of the memory handed out from
+			// this buffer. Therefore, we can reset the mNextFree to
+			// the start of the buffer, and reset the reclaimed bytes.
 			mReclaimedBytes = 0;
 			mNextFree = mBuffer;
 		}
-		else if(mReclaimedBytes > mSize)
+		else if(mReclaimedBytes > used)
 		{
 			llwarns << "LLHeapBuffer reclaimed more memory than allocated."
 				<< " This is probably programmer error." << llendl;
@@ -218,7 +286,19 @@ void LLHeapBuffer::allocate(S32 size)
 {
 	LLMemType m1(LLMemType::MTYPE_IO_BUFFER);
 	mReclaimedBytes = 0;	
-	mBuffer = new U8[size];
+	if(sPoolMutex && (DEFAULT_HEAP_BUFFER_SIZE == size))
+	{
+		LLMutexLock lock(sPoolMutex);
+		if(!sPool.empty())
+		{
+			mBuffer = sPool.back();
+			sPool.pop_back();
+		}
+	}
+	if(!mBuffer)
+	{
+		mBuffer = new U8[size];
+	}
 	if(mBuffer)
 	{
 		mSize = size;
@@ -239,7 +319,12 @@ LLBufferArray::LLBufferArray() :
 LLBufferArray::~LLBufferArray()
 {
 	LLMemType m1(LLMemType::MTYPE_IO_BUFFER);
-	std::for_each(mBuffers.begin(), mBuffers.end(), DeletePointer());
+	buffer_iterator_t iter = mBuffers.begin();
+	buffer_iterator_t end = mBuffers.end();
+	for(; iter != end; ++iter)
+	{
+		(*iter)->unref();
+	}
 }
 
 // static
@@ -570,6 +655,77 @@ U8* LLBufferArray::readAfter(
 	return rv;
 }
 
+S32 LLBufferArray::getIOVecs(
+	S32 channel,
+	U8* start,
+	struct iovec* vecs,
+	S32 max_vecs,
+	S32& bytes) const
+{
+	S32 count = 0;
+	bytes = 0;
+	const_segment_iterator_t it;
+	const_segment_iterator_t end = mSegments.end();
+	if(start)
+	{
+		it = getSegment(start);
+		if(it == end)
+		{
+			return count;
+		}
+		if((++start < ((*it).data() + (*it).size()))
+		   && (*it).isOnChannel(channel)
+		   && (count < max_vecs))
+		{
+			// the rest of this segment
+			vecs[count].iov_base = (char*)start;
+			vecs[count].iov_len = (*it).size() - (start - (*it).data());
+			bytes += (S32)vecs[count].iov_len;
+			++count;
+		}
+		++it;
+	}
+	else
+	{
+		it = mSegments.begin();
+	}
+	for( ; (it != end) && (count < max_vecs); ++it)
+	{
+		if(!(*it).isOnChannel(channel) || (0 == (*it).size()))
+		{
+			continue;
+		}
+		vecs[count].iov_base = (char*)(*it).data();
+		vecs[count].iov_len = (*it).size();
+		bytes += (*it).size();
+		++count;
+	}
+	return count;
+}
+
+const U8* LLBufferArray::readContiguous(
+	S32 channel,
+	U8* start,
+	std::vector<U8>& scratch,
+	S32& len) const
+{
+	struct iovec vecs[2];
+	S32 count = getIOVecs(channel, start, vecs, 2, len);
+	if(0 == count)
+	{
+		len = 0;
+		return NULL;
+	}
+	if(1 == count)
+	{
+		return (const U8*)vecs[0].iov_base;
+	}
+	len = countAfter(channel, start);
+	scratch.resize(len);
+	readAfter(channel, start, &scratch[0], len);
+	return &scratch[0];
+}
+
 U8* LLBufferArray::seek(
 	S32 channel,
 	U8* start,
@@ -733,6 +889,56 @@ bool LLBufferArray::takeContents(LLBufferArray& source)
 	return true;
 }
 
+bool LLBufferArray::appendSlice(
+	S32 channel,
+	LLBufferArray& source,
+	S32 source_channel,
+	U8* start,
+	S32 len)
+{
+	LLMemType m1(LLMemType::MTYPE_IO_BUFFER);
+	if((len <= 0) || (source.countAfter(source_channel, start) < len))
+	{
+		return false;
+	}
+
+	const S32 MAX_VECS = 16;
+	struct iovec vecs[MAX_VECS];
+	while(len > 0)
+	{
+		S32 bytes = 0;
+		S32 count = source.getIOVecs(source_channel, start, vecs, MAX_VECS, bytes);
+		if(0 == count)
+		{
+			// This should never happen either.
+			return false;
+		}
+		for(S32 i = 0; (i < count) && (len > 0); ++i)
+		{
+			LLSegment segment(
+				channel,
+				(U8*)vecs[i].iov_base,
+				llmin(len, (S32)vecs[i].iov_len));
+			LLBuffer* buf = source.findBuffer(segment);
+			if(!buf)
+			{
+				// This should never happen.
+				return false;
+			}
+			buf->setShared();
+			if(mBuffers.end() == std::find(mBuffers.begin(), mBuffers.end(), buf))
+			{
+				buf->ref();
+				mBuffers.push_back(buf);
+			}
+			mSegments.push_back(segment);
+			len -= segment.size();
+			start = segment.data() + segment.size() - 1;
+		}
+	}
+	return true;
+}
+
 LLBufferArray::segment_iterator_t LLBufferArray::makeSegment(
 	S32 channel,
 	S32 len)
@@ -755,8 +961,7 @@ LLBufferArray::segment_iterator_t LLBufferArray::makeSegment(
 	segment_iterator_t send = mSegments.end();
 	if(!made_segment)
 	{
-		LLBuffer* buf = new LLHeapBuffer;
-		mBuffers.push_back(buf);
+		LLBuffer* buf = newBuffer();
 		if(!buf->createSegment(channel, len, segment))
 		{
 			// failed. this should never happen.
@@ -831,8 +1036,7 @@ bool LLBufferArray::copyIntoBuffers(
 	}
 	while(len)
 	{
-		LLBuffer* buf = new LLHeapBuffer;
-		mBuffers.push_back(buf);
+		LLBuffer* buf = newBuffer();
 		if(!buf->createSegment(channel, len, segment))
 		{
 			// this totally failed - bail. This is the weird corner
@@ -849,3 +1053,25 @@ bool LLBufferArray::copyIntoBuffers(
 	}
 	return true;
 }
+
+LLBuffer* LLBufferArray::newBuffer()
+{
+	LLBuffer* buf = new LLHeapBuffer;
+	buf->ref();
+	mBuffers.push_back(buf);
+	return buf;
+}
+
+LLBuffer* LLBufferArray::findBuffer(const LLSegment& segment) const
+{
+	const_buffer_iterator_t iter = mBuffers.begin();
+	const_buffer_iterator_t end = mBuffers.end();
+	for(; iter != end; ++iter)
+	{
+		if((*iter)->containsSegment(segment))
+		{
+			return *iter;
+		}
+	}
+	return NULL;
+}
@@ -46,6 +46,11 @@
 #include <list>
 #include <vector>
 
+#include "llapr.h"
+
+class LLMutex;
+struct iovec;
+
 /** 
  * @class LLChannelDescriptors
  * @brief A way simple interface to accesss channels inside a buffer
@@ -142,12 +147,38 @@ protected:
 class LLBuffer
 {
 public:
+	LLBuffer() : mRefCount(0), mShared(false) {}
+
 	/** 
 	 * @brief The buffer base class should have no responsibilities
-	 * other than an interface.
+	 * other than an interface and a reference count.
 	 */ 
 	virtual ~LLBuffer() {}
 
+	/** 
+	 * @brief Reference counting.
+	 *
+	 * Every buffer array holding segments of this buffer holds a
+	 * reference to it, so the memory of a segment can be handed from
+	 * one array to another without a copy. The buffer is deleted when
+	 * the last reference is released.
+	 */
+	void ref() { mRefCount++; }
+	// the decrement returns zero when the count reaches zero
+	void unref() { if(0 == mRefCount--) delete this; }
+	S32 getNumRefs() { return mRefCount; }
+
+	/** 
+	 * @brief Mark the buffer as having segments in more than one
+	 * buffer array.
+	 *
+	 * A shared buffer no longer tracks which of its memory is in use,
+	 * so it will not create any more segments. Its memory is freed
+	 * with the last reference.
+	 */
+	void setShared() { mShared = true; }
+	bool isShared() const { return mShared; }
+
 	/** 
 	 * @brief Generate a segment for this buffer.
 	 *
@@ -191,6 +222,10 @@ public:
 	 * necessarily a good idea to use it for anything else.
 	 */
 	virtual S32 capacity() const = 0;
+
+protected:
+	LLAtomicS32 mRefCount;
+	bool mShared;
 };
 
 /** 
@@ -199,11 +234,26 @@ public:
  *
  * This class is a simple buffer implementation which allocates chunks
  * off the heap. Once a buffer is constructed, it's buffer has a fixed
- * length.
+ * length. Buffers of the default size are recycled through a free
+ * list once <code>initPool()</code> has been called.
  */
 class LLHeapBuffer : public LLBuffer
 {
 public:
+	enum { DEFAULT_HEAP_BUFFER_SIZE = 16384 };
+
+	/** 
+	 * @brief Start recycling default sized buffers.
+	 *
+	 * @param max_free The most unused buffers to keep around.
+	 */
+	static void initPool(S32 max_free);
+
+	/** 
+	 * @brief Free the unused buffers and stop recycling.
+	 */
+	static void cleanupPool();
+
 	/** 
 	 * @brief Construct a heap buffer with a reasonable default size.
 	 */
@@ -294,6 +344,10 @@ private:
 	 * intertnal state of this buffer.
 	 */ 
 	void allocate(S32 size);
+
+	static LLMutex* sPoolMutex;
+	static std::vector<U8*> sPool;
+	static S32 sMaxPoolSize;
 };
 
 /** 
@@ -301,7 +355,9 @@ private:
  * @brief Class to represent scattered memory buffers and in-order segments
  * of that buffered data.
  *
- * *NOTE: This class needs to have an iovec interface
+ * The buffers are reference counted, so segments can be sliced out of
+ * one array into another without copying the data, and a channel can
+ * be handed to scatter/gather I/O as an array of iovecs.
  */
 class LLBufferArray
 {
@@ -443,6 +499,50 @@ public:
 	 * @return Returns the address of the last read byte.
 	 */
 	U8* readAfter(S32 channel, U8* start, U8* dest, S32& len) const;
+
+	/** 
+	 * @brief Describe the bytes on a channel as iovecs for writev().
+	 *
+	 * Nothing is copied: the iovecs point at the segments, which stay
+	 * valid until the buffer array is changed.
+	 * @param channel The channel to describe.
+	 * @param start The address of the last byte not wanted, as for
+	 * <code>readAfter()</code>. You can specify NULL to start at the
+	 * beginning.
+	 * @param vecs[out] Where to put the iovecs.
+	 * @param max_vecs The number of iovecs at vecs.
+	 * @param bytes[out] The total number of bytes described.
+	 * @return Returns the number of iovecs used, 0 if there are no
+	 * bytes on the channel after start.
+	 */
+	S32 getIOVecs(
+		S32 channel,
+		U8* start,
+		struct iovec* vecs,
+		S32 max_vecs,
+		S32& bytes) const;
+
+	/** 
+	 * @brief Get the bytes on a channel as one block of memory.
+	 *
+	 * When the bytes are all in one segment, which is the usual case
+	 * for a response read off a socket, this returns a pointer into
+	 * that segment and copies nothing. Otherwise they are copied into
+	 * scratch. Either way the result is only good until the buffer
+	 * array or scratch is changed.
+	 * @param channel The channel to read.
+	 * @param start The address of the last byte not wanted, as for
+	 * <code>readAfter()</code>. You can specify NULL to start at the
+	 * beginning.
+	 * @param scratch Storage to use if the bytes need copying.
+	 * @param len[out] The number of bytes at the returned address.
+	 * @return Returns the address of the bytes, NULL if there are none.
+	 */
+	const U8* readContiguous(
+		S32 channel,
+		U8* start,
+		std::vector<U8>& scratch,
+		S32& len) const;
  
 	/** 
 	 * @brief Find an address in a buffer array
@@ -471,6 +571,29 @@ public:
 	 * @return Returns true if the operation succeeded.
 	 */
 	bool takeContents(LLBufferArray& source);
+
+	/** 
+	 * @brief Append bytes from a channel of another buffer array
+	 * without copying them.
+	 *
+	 * The new segments point into the source's buffers, which this
+	 * buffer array then shares. The source is not changed.
+	 * @param channel The channel for the new segments.
+	 * @param source The buffer array holding the data.
+	 * @param source_channel The channel of the data in source.
+	 * @param start The address of the last byte not wanted, as for
+	 * <code>readAfter()</code>. You can specify NULL to start at the
+	 * beginning.
+	 * @param len The number of bytes to append.
+	 * @return Returns true if the method worked, false if source does
+	 * not have len bytes on the channel after start.
+	 */
+	bool appendSlice(
+		S32 channel,
+		LLBufferArray& source,
+		S32 source_channel,
+		U8* start,
+		S32 len);
 	//@}
 
 	/* @name Segment methods
@@ -598,6 +721,18 @@ protected:
 		S32 len,
 		std::vector<LLSegment>& segments);
 
+	/** 
+	 * @brief Make a new buffer owned by this buffer array.
+	 */
+	LLBuffer* newBuffer();
+
+	/** 
+	 * @brief Find the buffer holding a segment.
+	 *
+	 * @return Returns the buffer or NULL.
+	 */
+	LLBuffer* findBuffer(const LLSegment& segment) const;
+
 protected:
 	S32 mNextBaseChannel;
 	buffer_list_t mBuffers;
@@ -69,16 +69,23 @@
 
 	Furthermore, it would behoove us to keep track of which
 	hosts an easy handle was used for and pick an easy handle
-	that matches the next request.  This code does not current
-	do this.
+	that matches the next request.  Each easy handle remembers
+	the host of its last request and the multi hands out a
+	matching free handle when it has one.
+
+	Newer versions of curl also share connections between all
+	the easy handles on a multi handle, so LLCurlRequest keeps
+	its multi handle for as long as it stays healthy instead of
+	starting a new one every so many requests.
  */
 
 //////////////////////////////////////////////////////////////////////////////
 
-static const U32 EASY_HANDLE_POOL_SIZE		= 5;
+static const U32 EASY_HANDLE_POOL_SIZE		= 16;
 static const S32 MULTI_PERFORM_CALL_REPEAT	= 5;
 static const S32 CURL_REQUEST_TIMEOUT = 30; // seconds
 static const S32 MAX_ACTIVE_REQUEST_COUNT = 100;
+static const S32 DEFAULT_MAX_REQUESTS_PER_HOST = 8;
 
 // DEBUG //
 S32 gCurlEasyCount = 0;
@@ -94,6 +101,7 @@ std::string LLCurl::sCAFile;
 // to alter this flag is only to allow us to suppress verification if it's
 // broken for some reason.
 bool LLCurl::sSSLVerify = true;
+bool LLCurl::sPipelining = false;
 
 //static
 void LLCurl::setCAPath(const std::string& path)
@@ -119,6 +127,18 @@ bool LLCurl::getSSLVerify()
 	return sSSLVerify;
 }
 
+//static
+void LLCurl::setPipelining(bool pipelining)
+{
+	sPipelining = pipelining;
+}
+
+//static
+bool LLCurl::getPipelining()
+{
+	return sPipelining;
+}
+
 //static
 std::string LLCurl::getVersionString()
 {
@@ -214,6 +234,17 @@ namespace boost
 };
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+// Returns the scheme, host and port part of url. Curl only reuses a
+// connection for requests which agree on all three.
+static std::string get_url_host(const std::string& url)
+{
+	std::string::size_type start = url.find("://");
+	start = (start == std::string::npos) ? 0 : start + 3;
+	return url.substr(0, url.find_first_of("/?#", start));
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
 
@@ -245,6 +276,7 @@ public:
 	
 	U32 report(CURLcode);
 	void getTransferInfo(LLCurl::TransferInfo* info);
+	S32 getNumConnects();
 
 	void prepRequest(const std::string& url, const std::vector<std::string>& headers, ResponderPtr, bool post = false);
 	
@@ -254,6 +286,7 @@ public:
 	std::stringstream& getHeaderOutput() { return mHeaderOutput; }
 	LLIOPipe::buffer_ptr_t& getOutput() { return mOutput; }
 	const LLChannelDescriptors& getChannels() { return mChannels; }
+	const std::string& getHost() const { return mHost; }
 	
 	void resetState();
 
@@ -272,6 +305,10 @@ private:
 	std::vector<char*>	mStrings;
 	
 	ResponderPtr		mResponder;
+
+	// Host of the most recent request. Not cleared by resetState()
+	// so the multi can match the handle to the next request.
+	std::string			mHost;
 };
 
 LLCurl::Easy::Easy()
@@ -366,6 +403,15 @@ void LLCurl::Easy::getTransferInfo(LLCurl::TransferInfo* info)
 	curl_easy_getinfo(mCurlEasyHandle, CURLINFO_SPEED_DOWNLOAD, &info->mSpeedDownload);
 }
 
+// Number of new connections the last transfer had to make; zero when
+// it ran on a connection which was kept alive.
+S32 LLCurl::Easy::getNumConnects()
+{
+	long connects = 0;
+	curl_easy_getinfo(mCurlEasyHandle, CURLINFO_NUM_CONNECTS, &connects);
+	return (S32)connects;
+}
+
 U32 LLCurl::Easy::report(CURLcode code)
 {
 	U32 responseCode = 0;	
@@ -487,6 +533,7 @@ void LLCurl::Easy::prepRequest(const std::string& url,
 	setopt(CURLOPT_TIMEOUT, CURL_REQUEST_TIMEOUT);
 
 	setoptString(CURLOPT_URL, url);
+	mHost = get_url_host(url);
 
 	mResponder = responder;
 
@@ -513,7 +560,7 @@ public:
 	Multi();
 	~Multi();
 
-	Easy* allocEasy();
+	Easy* allocEasy(const std::string& host = LLStringUtil::null);
 	bool addEasy(Easy* easy);
 	
 	void removeEasy(Easy* easy);
@@ -525,6 +572,11 @@ public:
 
 	S32 mQueued;
 	S32 mErrorCount;
+
+	// Filled in by process() for the owner to collect.
+	std::vector<std::string> mCompletedHosts;
+	S32 mNewConnections;
+	S32 mReusedConnections;
 	
 private:
 	void easyFree(Easy*);
@@ -535,13 +587,16 @@ private:
 	easy_active_list_t mEasyActiveList;
 	typedef std::map<CURL*, Easy*> easy_active_map_t;
 	easy_active_map_t mEasyActiveMap;
-	typedef std::set<Easy*> easy_free_list_t;
+	// Free handles keyed by the host they last talked to.
+	typedef std::multimap<std::string, Easy*> easy_free_list_t;
 	easy_free_list_t mEasyFreeList;
 };
 
 LLCurl::Multi::Multi()
 	: mQueued(0),
-	  mErrorCount(0)
+	  mErrorCount(0),
+	  mNewConnections(0),
+	  mReusedConnections(0)
 {
 	mCurlMultiHandle = curl_multi_init();
 	if (!mCurlMultiHandle)
@@ -550,6 +605,10 @@ LLCurl::Multi::Multi()
 		mCurlMultiHandle = curl_multi_init();
 	}
 	llassert_always(mCurlMultiHandle);
+	if (LLCurl::getPipelining())
+	{
+		curl_multi_setopt(mCurlMultiHandle, CURLMOPT_PIPELINING, 1L);
+	}
 	++gCurlMultiCount;
 }
 
@@ -567,7 +626,7 @@ LLCurl::Multi::~Multi()
 	mEasyActiveMap.clear();
 	
 	// Clean up freed
-	for_each(mEasyFreeList.begin(), mEasyFreeList.end(), DeletePointer());	
+	for_each(mEasyFreeList.begin(), mEasyFreeList.end(), DeletePairedPointer());	
 	mEasyFreeList.clear();
 
 	curl_multi_cleanup(mCurlMultiHandle);
@@ -616,6 +675,15 @@ S32 LLCurl::Multi::process()
 			if (iter != mEasyActiveMap.end())
 			{
 				Easy* easy = iter->second;
+				if (easy->getNumConnects() > 0)
+				{
+					++mNewConnections;
+				}
+				else
+				{
+					++mReusedConnections;
+				}
+				mCompletedHosts.push_back(easy->getHost());
 				response = easy->report(msg->data.result);
 				removeEasy(easy);
 			}
@@ -625,9 +693,11 @@ S32 LLCurl::Multi::process()
 				//*TODO: change to llwarns
 				llerrs << "cleaned up curl request completed!" << llendl;
 			}
-			if (response >= 400)
+			if (msg->data.result != CURLE_OK)
 			{
-				// failure of some sort, inc mErrorCount for debugging and flagging multi for destruction
+				// transport failure of some sort, inc mErrorCount for debugging and flagging
+				// multi for destruction. An http error status comes back over a healthy
+				// connection and is no reason to drop the others.
 				++mErrorCount;
 			}
 		}
@@ -635,7 +705,7 @@ S32 LLCurl::Multi::process()
 	return processed;
 }
 
-LLCurl::Easy* LLCurl::Multi::allocEasy()
+LLCurl::Easy* LLCurl::Multi::allocEasy(const std::string& host)
 {
 	Easy* easy = 0;
 
@@ -645,8 +715,13 @@ LLCurl::Easy* LLCurl::Multi::allocEasy()
 	}
 	else
 	{
-		easy = *(mEasyFreeList.begin());
-		mEasyFreeList.erase(easy);
+		easy_free_list_t::iterator iter = mEasyFreeList.find(host);
+		if (iter == mEasyFreeList.end())
+		{
+			iter = mEasyFreeList.begin();
+		}
+		easy = iter->second;
+		mEasyFreeList.erase(iter);
 	}
 	if (easy)
 	{
@@ -674,7 +749,7 @@ void LLCurl::Multi::easyFree(Easy* easy)
 	if (mEasyFreeList.size() < EASY_HANDLE_POOL_SIZE)
 	{
 		easy->resetState();
-		mEasyFreeList.insert(easy);
+		mEasyFreeList.insert(std::make_pair(easy->getHost(), easy));
 	}
 	else
 	{
@@ -703,12 +778,24 @@ std::string LLCurl::strerror(CURLcode errorcode)
 }
 
 ////////////////////////////////////////////////////////////////////////////
-// For generating a simple request for data
-// using one multi and one easy per request 
+// For generating simple requests for data, sharing one multi
+// and a pool of easy handles between all of them
+
+LLCurlRequest::Stats::Stats()
+	: mRequests(0),
+	  mCompleted(0),
+	  mNewConnections(0),
+	  mReusedConnections(0),
+	  mQueued(0),
+	  mMaxQueued(0)
+{
+}
 
 LLCurlRequest::LLCurlRequest() :
 	mActiveMulti(NULL),
-	mActiveRequestCount(0)
+	mActiveRequestCount(0),
+	mNextSerial(0),
+	mMaxRequestsPerHost(DEFAULT_MAX_REQUESTS_PER_HOST)
 {
 	mThreadID = LLThread::currentID();
 }
@@ -717,6 +804,12 @@ LLCurlRequest::~LLCurlRequest()
 {
 	llassert_always(mThreadID == LLThread::currentID());
 	for_each(mMultiSet.begin(), mMultiSet.end(), DeletePointer());
+	for_each(mRequestQueue.begin(), mRequestQueue.end(), DeletePointer());
+}
+
+void LLCurlRequest::setMaxRequestsPerHost(S32 max_requests)
+{
+	mMaxRequestsPerHost = llmax(max_requests, 1);
 }
 
 void LLCurlRequest::addMulti()
@@ -725,20 +818,19 @@ void LLCurlRequest::addMulti()
 	LLCurl::Multi* multi = new LLCurl::Multi();
 	mMultiSet.insert(multi);
 	mActiveMulti = multi;
-	mActiveRequestCount = 0;
 }
 
-LLCurl::Easy* LLCurlRequest::allocEasy()
+LLCurl::Easy* LLCurlRequest::allocEasy(const std::string& host)
 {
+	// Only start over with a fresh multi, and lose the connections
+	// the old one is keeping alive, when the old one has gone bad.
 	if (!mActiveMulti ||
-		mActiveRequestCount	>= MAX_ACTIVE_REQUEST_COUNT ||
 		mActiveMulti->mErrorCount > 0)
 	{
 		addMulti();
 	}
 	llassert_always(mActiveMulti);
-	++mActiveRequestCount;
-	LLCurl::Easy* easy = mActiveMulti->allocEasy();
+	LLCurl::Easy* easy = mActiveMulti->allocEasy(host);
 	return easy;
 }
 
@@ -757,52 +849,159 @@ void LLCurlRequest::get(const std::string& url, LLCurl::ResponderPtr responder)
 bool LLCurlRequest::getByteRange(const std::string& url,
 								 const headers_t& headers,
 								 S32 offset, S32 length,
-								 LLCurl::ResponderPtr responder)
+								 LLCurl::ResponderPtr responder,
+								 U32 priority)
 {
-	LLCurl::Easy* easy = allocEasy();
-	if (!easy)
+	Request* request = new Request;
+	request->mURL = url;
+	request->mHeaders = headers;
+	request->mOffset = offset;
+	request->mLength = length;
+	request->mPost = false;
+	request->mResponder = responder;
+	request->mPriority = priority;
+	return enqueue(request);
+}
+
+bool LLCurlRequest::post(const std::string& url,
+						 const headers_t& headers,
+						 const LLSD& data,
+						 LLCurl::ResponderPtr responder,
+						 U32 priority)
+{
+	Request* request = new Request;
+	request->mURL = url;
+	request->mHeaders = headers;
+	request->mOffset = 0;
+	request->mLength = -1;
+	request->mPost = true;
+	request->mData = data;
+	request->mResponder = responder;
+	request->mPriority = priority;
+	return enqueue(request);
+}
+
+// Starts request right away if its host has room, otherwise queues
+// it. Takes ownership of request.
+bool LLCurlRequest::enqueue(Request* request)
+{
+	llassert_always(mThreadID == LLThread::currentID());
+	request->mHost = get_url_host(request->mURL);
+	request->mSerial = mNextSerial++;
+	++mStats.mRequests;
+
+	// Nothing may jump ahead of an equal or higher priority request
+	// which is already waiting for the same host.
+	bool must_wait = !hasRoom(request->mHost);
+	for (request_queue_t::iterator iter = mRequestQueue.begin();
+		 !must_wait && iter != mRequestQueue.end() && (*iter)->mPriority >= request->mPriority;
+		 ++iter)
 	{
-		return false;
+		must_wait = ((*iter)->mHost == request->mHost);
 	}
-	easy->prepRequest(url, headers, responder);
-	easy->setopt(CURLOPT_HTTPGET, 1);
-	if (length > 0)
+
+	if (!must_wait)
 	{
-		std::string range = llformat("Range: bytes=%d-%d", offset,offset+length-1);
-		easy->slist_append(range.c_str());
+		bool res = startRequest(*request);
+		delete request;
+		return res;
 	}
-	easy->setHeaders();
-	bool res = addEasy(easy);
-	return res;
+
+	mRequestQueue.insert(request);
+	mStats.mQueued = mRequestQueue.size();
+	mStats.mMaxQueued = llmax(mStats.mMaxQueued, mStats.mQueued);
+	return true;
 }
 
-bool LLCurlRequest::post(const std::string& url,
-						 const headers_t& headers,
-						 const LLSD& data,
-						 LLCurl::ResponderPtr responder)
+bool LLCurlRequest::hasRoom(const std::string& host)
+{
+	if (mActiveRequestCount >= MAX_ACTIVE_REQUEST_COUNT)
+	{
+		return false;
+	}
+	host_count_map_t::iterator iter = mHostActiveCount.find(host);
+	return (iter == mHostActiveCount.end() || iter->second < mMaxRequestsPerHost);
+}
+
+bool LLCurlRequest::startRequest(const Request& request)
 {
-	LLCurl::Easy* easy = allocEasy();
+	LLCurl::Easy* easy = allocEasy(request.mHost);
 	if (!easy)
 	{
 		return false;
 	}
-	easy->prepRequest(url, headers, responder);
+	easy->prepRequest(request.mURL, request.mHeaders, request.mResponder);
 
-	LLSDSerialize::toXML(data, easy->getInput());
-	S32 bytes = easy->getInput().str().length();
-	
-	easy->setopt(CURLOPT_POST, 1);
-	easy->setopt(CURLOPT_POSTFIELDS, (void*)NULL);
-	easy->setopt(CURLOPT_POSTFIELDSIZE, bytes);
+	if (request.mPost)
+	{
+		LLSDSerialize::toXML(request.mData, easy->getInput());
+		S32 bytes = easy->getInput().str().length();
+		
+		easy->setopt(CURLOPT_POST, 1);
+		easy->setopt(CURLOPT_POSTFIELDS, (void*)NULL);
+		easy->setopt(CURLOPT_POSTFIELDSIZE, bytes);
 
-	easy->slist_append("Content-Type: application/llsd+xml");
-	easy->setHeaders();
+		easy->slist_append("Content-Type: application/llsd+xml");
+		easy->setHeaders();
+
+		lldebugs << "POSTING: " << bytes << " bytes." << llendl;
+	}
+	else
+	{
+		easy->setopt(CURLOPT_HTTPGET, 1);
+		if (request.mLength > 0)
+		{
+			std::string range = llformat("Range: bytes=%d-%d", request.mOffset, request.mOffset + request.mLength - 1);
+			easy->slist_append(range.c_str());
+		}
+		easy->setHeaders();
+	}
 
-	lldebugs << "POSTING: " << bytes << " bytes." << llendl;
 	bool res = addEasy(easy);
+	if (res)
+	{
+		++mActiveRequestCount;
+		++mHostActiveCount[request.mHost];
+	}
 	return res;
 }
-	
+
+void LLCurlRequest::startQueued()
+{
+	for (request_queue_t::iterator iter = mRequestQueue.begin();
+		 iter != mRequestQueue.end() && mActiveRequestCount < MAX_ACTIVE_REQUEST_COUNT; )
+	{
+		request_queue_t::iterator curiter = iter++;
+		Request* request = *curiter;
+		if (!hasRoom(request->mHost))
+		{
+			continue;
+		}
+		mRequestQueue.erase(curiter);
+		if (!startRequest(*request))
+		{
+			// The caller was told this request was accepted, so it
+			// has to hear about the failure through the responder.
+			llwarns << "Failed to start queued request for " << request->mURL << llendl;
+			LLIOPipe::buffer_ptr_t buffer(new LLBufferArray);
+			request->mResponder->completedRaw(499, "Failed to start request", buffer->nextChannel(), buffer);
+		}
+		delete request;
+	}
+	mStats.mQueued = mRequestQueue.size();
+}
+
+void LLCurlRequest::requestFinished(const std::string& host)
+{
+	--mActiveRequestCount;
+	++mStats.mCompleted;
+	host_count_map_t::iterator iter = mHostActiveCount.find(host);
+	if (iter != mHostActiveCount.end() && --(iter->second) <= 0)
+	{
+		mHostActiveCount.erase(iter);
+	}
+}
+
 // Note: call once per frame
 S32 LLCurlRequest::process()
 {
@@ -815,19 +1014,32 @@ S32 LLCurlRequest::process()
 		LLCurl::Multi* multi = *curiter;
 		S32 tres = multi->process();
 		res += tres;
+
+		for (std::vector<std::string>::iterator host_iter = multi->mCompletedHosts.begin();
+			 host_iter != multi->mCompletedHosts.end(); ++host_iter)
+		{
+			requestFinished(*host_iter);
+		}
+		multi->mCompletedHosts.clear();
+		mStats.mNewConnections += multi->mNewConnections;
+		mStats.mReusedConnections += multi->mReusedConnections;
+		multi->mNewConnections = 0;
+		multi->mReusedConnections = 0;
+
 		if (multi != mActiveMulti && tres == 0 && multi->mQueued == 0)
 		{
 			mMultiSet.erase(curiter);
 			delete multi;
 		}
 	}
+	startQueued();
 	return res;
 }
 
 S32 LLCurlRequest::getQueued()
 {
 	llassert_always(mThreadID == LLThread::currentID());
-	S32 queued = 0;
+	S32 queued = (S32)mRequestQueue.size();
 	for (curlmulti_set_t::iterator iter = mMultiSet.begin();
 		 iter != mMultiSet.end(); )
 	{
@@ -38,6 +38,8 @@
 
 #include "linden_common.h"
 
+#include <map>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -168,6 +170,17 @@ public:
 	 */
 	static bool getSSLVerify();
 
+	/**
+	 * @ brief Set flag controlling whether new multi handles pipeline
+	 * requests to the same host over a single connection.
+	 */
+	static void setPipelining(bool pipelining);
+
+	/**
+	 * @ brief Get flag controlling HTTP pipelining.
+	 */
+	static bool getPipelining();
+
 	/**
 	 * @ brief Initialize LLCurl class
 	 */
@@ -194,6 +207,7 @@ private:
 	static std::string sCAPath;
 	static std::string sCAFile;
 	static bool sSSLVerify;
+	static bool sPipelining;
 };
 
 namespace boost
@@ -203,23 +217,81 @@ namespace boost
 };
 
 
+/**
+ * @class LLCurlRequest
+ * @brief A pool of curl handles for issuing many small requests.
+ *
+ * Requests are handed to a long lived multi handle so that curl can
+ * keep the connection to each host alive between requests. At most
+ * getMaxRequestsPerHost() requests are in flight to any one host and
+ * at most MAX_ACTIVE_REQUEST_COUNT overall. Anything beyond that
+ * waits in a queue and is started by process() in priority order,
+ * highest first, then in the order it was made.
+ */
 class LLCurlRequest
 {
 public:
 	typedef std::vector<std::string> headers_t;
+
+	struct Stats
+	{
+		Stats();
+		U32 mRequests;			// requests accepted
+		U32 mCompleted;			// requests which have called their responder
+		U32 mNewConnections;	// completed requests which opened a connection
+		U32 mReusedConnections;	// completed requests on a kept alive connection
+		U32 mQueued;			// requests waiting for a free slot right now
+		U32 mMaxQueued;			// the most requests which have waited at once
+	};
 	
 	LLCurlRequest();
 	~LLCurlRequest();
 
 	void get(const std::string& url, LLCurl::ResponderPtr responder);
-	bool getByteRange(const std::string& url, const headers_t& headers, S32 offset, S32 length, LLCurl::ResponderPtr responder);
-	bool post(const std::string& url, const headers_t& headers, const LLSD& data, LLCurl::ResponderPtr responder);
+	bool getByteRange(const std::string& url, const headers_t& headers, S32 offset, S32 length, LLCurl::ResponderPtr responder, U32 priority = 0);
+	bool post(const std::string& url, const headers_t& headers, const LLSD& data, LLCurl::ResponderPtr responder, U32 priority = 0);
 	S32  process();
 	S32  getQueued();
 
+	void setMaxRequestsPerHost(S32 max_requests);
+	S32 getMaxRequestsPerHost() const { return mMaxRequestsPerHost; }
+	const Stats& getStats() const { return mStats; }
+
 private:
+	struct Request
+	{
+		std::string mURL;
+		std::string mHost;
+		headers_t mHeaders;
+		S32 mOffset;
+		S32 mLength;
+		bool mPost;
+		LLSD mData;
+		LLCurl::ResponderPtr mResponder;
+		U32 mPriority;
+		U32 mSerial;
+	};
+
+	struct RequestOrder
+	{
+		bool operator()(const Request* lhs, const Request* rhs) const
+		{
+			if (lhs->mPriority != rhs->mPriority)
+			{
+				return lhs->mPriority > rhs->mPriority;
+			}
+			return lhs->mSerial < rhs->mSerial;
+		}
+	};
+
+	bool enqueue(Request* request);
+	bool startRequest(const Request& request);
+	bool hasRoom(const std::string& host);
+	void startQueued();
+	void requestFinished(const std::string& host);
+
 	void addMulti();
-	LLCurl::Easy* allocEasy();
+	LLCurl::Easy* allocEasy(const std::string& host);
 	bool addEasy(LLCurl::Easy* easy);
 	
 private:
@@ -227,6 +299,16 @@ private:
 	curlmulti_set_t mMultiSet;
 	LLCurl::Multi* mActiveMulti;
 	S32 mActiveRequestCount;
+
+	typedef std::set<Request*, RequestOrder> request_queue_t;
+	request_queue_t mRequestQueue;
+	U32 mNextSerial;
+
+	typedef std::map<std::string, S32> host_count_map_t;
+	host_count_map_t mHostActiveCount;
+	S32 mMaxRequestsPerHost;
+
+	Stats mStats;
 	U32 mThreadID; // debug
 };
 
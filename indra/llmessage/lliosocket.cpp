@@ -37,6 +37,12 @@
 #include "lliosocket.h"
 
 #include "llapr.h"
+#include "apr_portable.h"
+#define APR_WANT_IOVEC
+#include "apr_want.h"
+#if !LL_WINDOWS
+#include <sys/uio.h>
+#endif
 
 #include "llbuffer.h"
 #include "llhost.h"
@@ -66,12 +72,61 @@ bool is_addr_in_use(apr_status_t status)
 #endif
 }
 
+// Scatter read, the missing counterpart of apr_socket_sendv(). Returns
+// APR_EOF if the peer has closed the connection.
+apr_status_t ll_socket_recvv(
+	apr_socket_t* socket,
+	struct iovec* vecs,
+	S32 count,
+	apr_size_t* len)
+{
+	*len = 0;
+#if LL_WINDOWS
+	apr_status_t status = APR_SUCCESS;
+	for(S32 i = 0; i < count; ++i)
+	{
+		apr_size_t bytes = vecs[i].iov_len;
+		status = apr_socket_recv(socket, (char*)vecs[i].iov_base, &bytes);
+		*len += bytes;
+		if((APR_SUCCESS != status) || (bytes < (apr_size_t)vecs[i].iov_len))
+		{
+			break;
+		}
+	}
+	if((*len > 0) && (APR_SUCCESS != status) && !APR_STATUS_IS_EOF(status))
+	{
+		// report the error on the next read
+		status = APR_SUCCESS;
+	}
+	return status;
+#else
+	apr_os_sock_t fd;
+	apr_status_t status = apr_os_sock_get(&fd, socket);
+	if(APR_SUCCESS != status)
+	{
+		return status;
+	}
+	ssize_t bytes;
+	do
+	{
+		bytes = readv(fd, vecs, count);
+	} while((bytes < 0) && (EINTR == errno));
+	if(bytes < 0)
+	{
+		return APR_FROM_OS_ERROR(errno);
+	}
+	if(0 == bytes)
+	{
+		return APR_EOF;
+	}
+	*len = (apr_size_t)bytes;
+	return APR_SUCCESS;
+#endif
+}
+
 #if LL_LINUX
 // Define this to see the actual file descriptors being tossed around.
 //#define LL_DEBUG_SOCKET_FILE_DESCRIPTORS 1
-#if LL_DEBUG_SOCKET_FILE_DESCRIPTORS
-#include "apr_portable.h"
-#endif
 #endif
 
 
@@ -329,17 +384,65 @@ LLIOPipe::EStatus LLIOSocketReader::process_impl(
 	//	buffer = new LLBufferArray;
 	//}
 	PUMP_DEBUG;
-	const apr_size_t READ_BUFFER_SIZE = 1024;
-	char read_buf[READ_BUFFER_SIZE]; /*Flawfinder: ignore*/
+	// Read straight into new segments at the end of the buffer
+	// array. Whatever part of them the read did not fill is given
+	// back to the buffers before the next read.
+	const S32 READ_BUFFER_SIZE = LLHeapBuffer::DEFAULT_HEAP_BUFFER_SIZE;
+	const S32 MAX_READ_SEGMENTS = 4;
+	LLBufferArray::segment_iterator_t segments[MAX_READ_SEGMENTS];
+	struct iovec vecs[MAX_READ_SEGMENTS];
+	LLBufferArray::segment_iterator_t end = buffer->endSegment();
 	apr_size_t len;
+	apr_size_t requested;
 	apr_status_t status = APR_SUCCESS;
 	do
 	{
 		PUMP_DEBUG;
-		len = READ_BUFFER_SIZE;
-		status = apr_socket_recv(mSource->getSocket(), read_buf, &len);
-		buffer->append(channels.out(), (U8*)read_buf, len);
-	} while((APR_SUCCESS == status) && (READ_BUFFER_SIZE == len));
+		S32 count = 0;
+		requested = 0;
+		while((count < MAX_READ_SEGMENTS) && (requested < (apr_size_t)READ_BUFFER_SIZE))
+		{
+			segments[count] = buffer->makeSegment(
+				channels.out(),
+				READ_BUFFER_SIZE - (S32)requested);
+			if(segments[count] == end)
+			{
+				break;
+			}
+			vecs[count].iov_base = (char*)(*segments[count]).data();
+			vecs[count].iov_len = (*segments[count]).size();
+			requested += vecs[count].iov_len;
+			++count;
+		}
+		if(0 == count)
+		{
+			status = APR_ENOMEM;
+			break;
+		}
+		status = ll_socket_recvv(mSource->getSocket(), vecs, count, &len);
+
+		// trim the segments to what was read
+		apr_size_t left = len;
+		for(S32 i = 0; i < count; ++i)
+		{
+			S32 size = (S32)vecs[i].iov_len;
+			if(left >= (apr_size_t)size)
+			{
+				left -= size;
+			}
+			else if(left > 0)
+			{
+				LLBufferArray::segment_iterator_t tail;
+				tail = buffer->splitAfter((U8*)vecs[i].iov_base + left - 1);
+				buffer->eraseSegment(++tail);
+				left = 0;
+			}
+			else
+			{
+				buffer->eraseSegment(segments[i]);
+			}
+		}
+	} while((APR_SUCCESS == status) && (requested == len));
 	lldebugs << "socket read status: " << status << llendl;
 	LLIOPipe::EStatus rv = STATUS_OK;
 
@@ -426,88 +529,62 @@ LLIOPipe::EStatus LLIOSocketWriter::process_impl(
 	}
 
 	PUMP_DEBUG;
-	// *FIX: Some sort of writev implementation would be much more
-	// efficient - not only because writev() is better, but also
-	// because we won't have to do as much work to find the start
-	// address.
-	LLBufferArray::segment_iterator_t it;
-	LLBufferArray::segment_iterator_t end = buffer->endSegment();
-	LLSegment segment;
-	it = buffer->constructSegmentAfter(mLastWritten, segment);
-	/*
-	if(NULL == mLastWritten)
-	{
-		it = buffer->beginSegment();
-		segment = (*it);
-	}
-	else
-	{
-		it = buffer->getSegment(mLastWritten);
-		segment = (*it);
-		S32 size = segment.size();
-		U8* data = segment.data();
-		if((data + size) == mLastWritten)
-		{
-			++it;
-			segment = (*it);
-		}
-		else
-		{
-			// *FIX: check the math on this one
-			segment = LLSegment(
-				(*it).getChannelMask(),
-				mLastWritten + 1,
-				size - (mLastWritten - data));
-		}
-	}
-	*/
-
-	PUMP_DEBUG;
+	// Hand everything after the last byte written to writev() in one
+	// call, straight out of the segments.
+	const S32 MAX_WRITE_SEGMENTS = 16;
+	struct iovec vecs[MAX_WRITE_SEGMENTS];
 	apr_size_t len;
 	bool done = false;
 	apr_status_t status = APR_SUCCESS;
-	while(it != end)
+	while(true)
 	{
-
 		PUMP_DEBUG;
-		if((*it).isOnChannel(channels.in()))
+		S32 bytes = 0;
+		S32 count = buffer->getIOVecs(
+			channels.in(),
+			mLastWritten,
+			vecs,
+			MAX_WRITE_SEGMENTS,
+			bytes);
+		if(0 == count)
 		{
-			PUMP_DEBUG;
-			len = (apr_size_t)segment.size();
-			status = apr_socket_send(
-				mDestination->getSocket(),
-				(const char*)segment.data(),
-				&len);
-			// We sometimes get a 'non-blocking socket operation could not be 
-			// completed immediately' error from apr_socket_send.  In this
-			// case we break and the data will be sent the next time the chain
-			// is pumped.
-			if(APR_STATUS_IS_EAGAIN(status))
-			{
-				ll_apr_warn_status(status);
-				break;
-			}
+			done = true;
+			break;
+		}
 
-			mLastWritten = segment.data() + len - 1;
+		len = 0;
+		status = apr_socket_sendv(
+			mDestination->getSocket(),
+			vecs,
+			count,
+			&len);
+		// We sometimes get a 'non-blocking socket operation could not be 
+		// completed immediately' error from apr_socket_sendv.  In this
+		// case we break and the data will be sent the next time the chain
+		// is pumped.
+		if(APR_STATUS_IS_EAGAIN(status))
+		{
+			ll_apr_warn_status(status);
+			break;
+		}
 
-			PUMP_DEBUG;
-			if((S32)len < segment.size())
+		// find the last byte written
+		apr_size_t left = len;
+		for(S32 i = 0; (i < count) && (left > 0); ++i)
+		{
+			apr_size_t size = (apr_size_t)vecs[i].iov_len;
+			if(left <= size)
 			{
-				break;
+				mLastWritten = (U8*)vecs[i].iov_base + left - 1;
 			}
-			
+			left -= llmin(left, size);
 		}
 
-		++it;
-		if(it != end)
-		{
-			segment = (*it);
-		}
-		else
+		PUMP_DEBUG;
+		if((S32)len < bytes)
 		{
-			done = true;
+			break;
 		}
-
 	}
 	PUMP_DEBUG;
 	if(done && eos)
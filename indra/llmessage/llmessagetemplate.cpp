@@ -74,6 +74,143 @@ void LLMsgData::addDataFast(char *blockname, char *varname, const void *data, S3
 	}
 }
 
+// LLMessageTemplateLayout functions
+
+static U32 layout_table_size(U32 count)
+{
+	// keep the tables at most half full so probes stay short
+	U32 size = 8;
+	while (size < count * 2)
+	{
+		size <<= 1;
+	}
+	return size;
+}
+
+void LLMessageTemplateLayout::build(const LLMessageTemplate& msg_template)
+{
+	mBlocks.clear();
+	mVariables.clear();
+
+	for (LLMessageTemplate::message_block_map_t::const_iterator block_iter = msg_template.mMemberBlocks.begin();
+		 block_iter != msg_template.mMemberBlocks.end(); ++block_iter)
+	{
+		const LLMessageBlock* blockp = *block_iter;
+		if (!blockp)
+		{
+			continue;
+		}
+
+		Block block;
+		block.mName = blockp->mName;
+		block.mType = blockp->mType;
+		block.mNumber = blockp->mNumber;
+		block.mFixedSize = 0;
+		block.mFirstVariable = (S32)mVariables.size();
+		block.mVariableCount = 0;
+
+		for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = blockp->mMemberVariables.begin();
+			 var_iter != blockp->mMemberVariables.end(); ++var_iter)
+		{
+			const LLMessageVariable* varp = *var_iter;
+			if (!varp)
+			{
+				continue;
+			}
+
+			Variable var;
+			var.mName = varp->getName();
+			var.mType = varp->getType();
+			var.mSize = varp->getSize();
+			var.mOffset = -1;
+			var.mBlock = (S32)mBlocks.size();
+			if (block.mFixedSize != -1)
+			{
+				if (var.mType == MVT_VARIABLE)
+				{
+					block.mFixedSize = -1;
+				}
+				else
+				{
+					var.mOffset = block.mFixedSize;
+					block.mFixedSize += var.mSize;
+				}
+			}
+			mVariables.push_back(var);
+			block.mVariableCount++;
+		}
+
+		if (block.mFixedSize == -1)
+		{
+			// offsets are only meaningful when every variable has a fixed size
+			for (S32 i = block.mFirstVariable; i < (S32)mVariables.size(); ++i)
+			{
+				mVariables[i].mOffset = -1;
+			}
+		}
+		mBlocks.push_back(block);
+	}
+
+	U32 table_size = layout_table_size((U32)mBlocks.size());
+	mBlockMask = table_size - 1;
+	mBlockTable.assign(table_size, -1);
+	for (S32 i = 0; i < (S32)mBlocks.size(); ++i)
+	{
+		U32 slot = hashName(mBlocks[i].mName) & mBlockMask;
+		while (mBlockTable[slot] != -1)
+		{
+			slot = (slot + 1) & mBlockMask;
+		}
+		mBlockTable[slot] = i;
+	}
+
+	table_size = layout_table_size((U32)mVariables.size());
+	mVariableMask = table_size - 1;
+	mVariableTable.assign(table_size, -1);
+	for (S32 i = 0; i < (S32)mVariables.size(); ++i)
+	{
+		U32 slot = (hashName(mVariables[i].mName) + (U32)mVariables[i].mBlock * 0x9E3779B9U) & mVariableMask;
+		while (mVariableTable[slot] != -1)
+		{
+			slot = (slot + 1) & mVariableMask;
+		}
+		mVariableTable[slot] = i;
+	}
+
+	mValid = true;
+}
+
+S32 LLMessageTemplateLayout::findBlock(const char* name) const
+{
+	U32 slot = hashName(name) & mBlockMask;
+	S32 index;
+	while ((index = mBlockTable[slot]) != -1)
+	{
+		if (mBlocks[index].mName == name)
+		{
+			return index;
+		}
+		slot = (slot + 1) & mBlockMask;
+	}
+	return -1;
+}
+
+S32 LLMessageTemplateLayout::findVariable(S32 block, const char* name) const
+{
+	U32 slot = (hashName(name) + (U32)block * 0x9E3779B9U) & mVariableMask;
+	S32 index;
+	while ((index = mVariableTable[slot]) != -1)
+	{
+		const Variable& var = mVariables[index];
+		if (var.mName == name && var.mBlock == block)
+		{
+			return index;
+		}
+		slot = (slot + 1) & mVariableMask;
+	}
+	return -1;
+}
+
 // LLMessageVariable functions and friends
 
 std::ostream& operator<<(std::ostream& s, LLMessageVariable &msg)
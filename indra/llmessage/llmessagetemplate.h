@@ -242,6 +242,63 @@ public:
 };
 
 
+class LLMessageTemplate;
+
+// Flattened, index-addressed copy of a template's blocks and variables.
+// Built once per template so the reader can decode packets and answer
+// getter lookups without walking the name keyed maps on every call.
+// Names are the canonical pointers from LLMessageStringTable, so the
+// lookup tables hash and compare the pointers rather than the strings.
+class LLMessageTemplateLayout
+{
+public:
+	struct Variable
+	{
+		char*				mName;
+		EMsgVariableType	mType;
+		S32					mSize;		// fixed size, or bytes of size info for MVT_VARIABLE
+		S32					mOffset;	// offset in a fixed size block instance, -1 otherwise
+		S32					mBlock;		// index of the owning block
+	};
+
+	struct Block
+	{
+		char*				mName;
+		EMsgBlockType		mType;
+		S32					mNumber;
+		S32					mFixedSize;	// bytes per instance, -1 if any variable is MVT_VARIABLE
+		S32					mFirstVariable;
+		S32					mVariableCount;
+	};
+
+	LLMessageTemplateLayout() : mBlockMask(0), mVariableMask(0), mValid(false) {}
+
+	void build(const LLMessageTemplate& msg_template);
+	void invalidate()						{ mValid = false; }
+	bool isValid() const					{ return mValid; }
+
+	// Both return -1 when the name is not part of the template.
+	// findVariable() returns an index into mVariables.
+	S32 findBlock(const char* name) const;
+	S32 findVariable(S32 block, const char* name) const;
+
+	std::vector<Block>		mBlocks;
+	std::vector<Variable>	mVariables;
+
+private:
+	static U32 hashName(const char* name)
+	{
+		U32 hash = (U32)(((size_t)name) >> 2) * 2654435761U;
+		return hash ^ (hash >> 16);
+	}
+
+	std::vector<S32>		mBlockTable;
+	std::vector<S32>		mVariableTable;
+	U32						mBlockMask;
+	U32						mVariableMask;
+	bool					mValid;
+};
+
 enum EMsgFrequency
 {
 	MFT_NULL	= 0,  // value is size of message number in bytes
@@ -312,6 +369,7 @@ public:
 				<< "has already been used as a block name!" << llendl;
 		}
 		*member_blockp = blockp;
+		mLayout.invalidate();
 		if (  (mTotalSize != -1)
 			&&(blockp->mTotalSize != -1)
 			&&(  (blockp->mType == MBT_SINGLE)
@@ -392,6 +450,16 @@ public:
 
 	friend std::ostream&	 operator<<(std::ostream& s, LLMessageTemplate &msg);
 
+	// Built lazily on first use, after the template parser is done with us.
+	const LLMessageTemplateLayout& getLayout()
+	{
+		if (!mLayout.isValid())
+		{
+			mLayout.build(*this);
+		}
+		return mLayout;
+	}
+
 	const LLMessageBlock* getBlock(char* name) const
 	{
 		message_block_map_t::const_iterator iter = mMemberBlocks.find(name);
@@ -420,6 +488,8 @@ public:
 	bool									mBanFromUntrusted;
 
 private:
+	LLMessageTemplateLayout					mLayout;
+
 	// message handler function (this is set by each application)
 	void									(*mHandlerFunc)(LLMessageSystem *msgsystem, void **user_data);
 	void									**mUserData;
@@ -0,0 +1,327 @@
+/** 
+ * @file llpatchdecoder.cpp
+ * @brief Batched, threaded decompression of DCT coded terrain patches.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "llpatchdecoder.h"
+
+#include <set>
+
+#include "bitpack.h"
+#include "llmath.h"
+#include "llsys.h"
+#include "lltaskscheduler.h"
+#include "patch_code.h"
+
+// Tables built by init_patch_decompressor(), in patch_idct.cpp
+extern F32 gPatchDequantizeTable[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+extern F32 gPatchICosines[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+extern S32 gDeCopyMatrix[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+
+//static
+bool LLPatchDecoder::sVectorize = false;
+bool LLPatchDecoder::sParallel = false;
+
+//----------------------------------------------------------------------------
+
+//static
+void LLPatchDecoder::initClass()
+{
+	sVectorize = hasSSE2Kernels() && gSysCPU.hasSSE2();
+	sParallel = true;
+
+	llinfos << "Terrain patch decoding: " << (sVectorize ? "SSE2" : "scalar") << llendl;
+}
+
+//static
+void LLPatchDecoder::cleanupClass()
+{
+	sParallel = false;
+}
+
+//static
+void LLPatchDecoder::setVectorize(bool vectorize)
+{
+	sVectorize = vectorize && hasSSE2Kernels() && gSysCPU.hasSSE2();
+}
+
+//static
+void LLPatchDecoder::parallelFor(range_func_t func, void* context, S32 count, S32 min_count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	if (sParallel)
+	{
+		LLTaskScheduler::parallelRange(func, context, count, min_count);
+	}
+	else
+	{
+		func(context, 0, count);
+	}
+}
+
+//----------------------------------------------------------------------------
+
+//static
+void LLPatchDecoder::readPatches(LLBitPack& bitpack, S32 patch_size, patch_list_t& patches)
+{
+	LLPatchHeader ph;
+	S32 wbits = 0;
+	while (1)
+	{
+		decode_patch_header(bitpack, &ph, wbits);
+		if (ph.quant_wbits == END_OF_PATCHES)
+		{
+			break;
+		}
+
+		// Patches are 4K, don't build them on the stack and copy them
+		patches.resize(patches.size() + 1);
+		Patch& patch = patches.back();
+		patch.mHeader = ph;
+		patch.mDest = NULL;
+		patch.mUserData = NULL;
+		decode_patch(bitpack, patch.mCoeffs, patch_size, wbits);
+	}
+}
+
+namespace
+{
+	// A land packet holds a few patches
+	const S32 MIN_PARALLEL_PACKETS = 4;
+	// A 16x16 patch takes a few microseconds, fewer than this many are not
+	// worth waking the scheduler threads for
+	const S32 MIN_PARALLEL_PATCHES = 16;
+
+	void read_packets(void* context, S32 begin, S32 end)
+	{
+		LLPatchDecoder::packet_list_t& packets = *(LLPatchDecoder::packet_list_t*)context;
+		for (S32 i = begin; i < end; ++i)
+		{
+			LLPatchDecoder::Packet& packet = packets[i];
+			if (packet.mPatchSize == NORMAL_PATCH_SIZE || packet.mPatchSize == LARGE_PATCH_SIZE)
+			{
+				LLPatchDecoder::readPatches(packet.mBitPack, packet.mPatchSize, packet.mPatches);
+			}
+		}
+	}
+
+	struct DecompressContext
+	{
+		std::vector<const LLPatchDecoder::Patch*> mPatches;
+		std::vector<S32> mStrides;
+		S32 mSize;
+		bool mVectorize;
+	};
+
+	void decompress_range(void* context, S32 begin, S32 end)
+	{
+		const DecompressContext& ctx = *(const DecompressContext*)context;
+		for (S32 i = begin; i < end; ++i)
+		{
+			LLPatchDecoder::decompressPatch(*ctx.mPatches[i], ctx.mSize, ctx.mStrides[i], ctx.mVectorize);
+		}
+	}
+}
+
+//static
+void LLPatchDecoder::readPackets(packet_list_t& packets)
+{
+	parallelFor(read_packets, &packets, (S32)packets.size(), MIN_PARALLEL_PACKETS);
+
+	for (U32 i = 0; i < packets.size(); ++i)
+	{
+		S32 size = packets[i].mPatchSize;
+		if (size != NORMAL_PATCH_SIZE && size != LARGE_PATCH_SIZE)
+		{
+			llwarns << "Unsupported terrain patch size " << size << llendl;
+		}
+	}
+}
+
+//static
+void LLPatchDecoder::decompressPackets(packet_list_t& packets)
+{
+	// Two patches for the same place would race, keep the last one.
+	// Regions all use the same patch size, but the tables can only hold
+	// one size at a time so do each size in turn.
+	std::set<F32*> seen;
+	DecompressContext ctx[2];
+	ctx[0].mSize = NORMAL_PATCH_SIZE;
+	ctx[1].mSize = LARGE_PATCH_SIZE;
+	for (S32 i = (S32)packets.size() - 1; i >= 0; --i)
+	{
+		const Packet& packet = packets[i];
+		DecompressContext& sized = ctx[packet.mPatchSize == NORMAL_PATCH_SIZE ? 0 : 1];
+		for (S32 j = (S32)packet.mPatches.size() - 1; j >= 0; --j)
+		{
+			const Patch& patch = packet.mPatches[j];
+			if (patch.mDest && seen.insert(patch.mDest).second)
+			{
+				sized.mPatches.push_back(&patch);
+				sized.mStrides.push_back(packet.mStride);
+			}
+		}
+	}
+
+	for (S32 i = 0; i < 2; ++i)
+	{
+		if (ctx[i].mPatches.empty())
+		{
+			continue;
+		}
+		// Build the tables once, before any thread reads them
+		init_patch_decompressor(ctx[i].mSize);
+		ctx[i].mVectorize = sVectorize;
+		parallelFor(decompress_range, &ctx[i], (S32)ctx[i].mPatches.size(), MIN_PARALLEL_PATCHES);
+	}
+}
+
+//static
+void LLPatchDecoder::decompressPatch(const Patch& patch, S32 size, S32 stride, bool vectorize)
+{
+	F32 block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+
+	const LLPatchHeader& ph = patch.mHeader;
+	F32 range = ph.range;
+	S32 prequant = (ph.quant_wbits >> 4) + 2;
+	S32 quantize = 1<<prequant;
+	F32 hmin = ph.dc_offset;
+
+	F32 ooq = 1.f/(F32)quantize;
+	F32 mult = ooq*range;
+	F32 addval = mult*(F32)(1<<(prequant - 1))+hmin;
+
+	S32 i, j;
+	for (i = 0; i < size*size; i++)
+	{
+		block[i] = patch.mCoeffs[gDeCopyMatrix[i]]*gPatchDequantizeTable[i];
+	}
+
+	if (vectorize)
+	{
+		idctPatchSSE2(block, size);
+	}
+	else
+	{
+		idctPatch(block, size);
+	}
+
+	for (j = 0; j < size; j++)
+	{
+		F32* dest = patch.mDest + j*stride;
+		const F32* src = block + j*size;
+		for (i = 0; i < size; i++)
+		{
+			dest[i] = src[i]*mult+addval;
+		}
+	}
+}
+
+namespace
+{
+	// Sized at compile time so that the loops unroll.  Each output is
+	// summed in the same order as in patch_idct.cpp, but the loops run
+	// over a row of outputs at a time, which the compiler can vectorize.
+	template <S32 SIZE>
+	void idct_patch_sized(F32* block)
+	{
+		F32 temp[SIZE*SIZE];
+		F32 total[SIZE];
+		const F32* pcp = gPatchICosines;
+		const F32 oosob = 2.f/(F32)SIZE;
+		S32 n, u, i;
+
+		// Columns, unscaled: row n of temp from every row of block
+		for (n = 0; n < SIZE; n++)
+		{
+			for (i = 0; i < SIZE; i++)
+			{
+				total[i] = OO_SQRT2*block[i];
+			}
+			for (u = 1; u < SIZE; u++)
+			{
+				const F32 cosine = pcp[u*SIZE + n];
+				const F32* in = block + u*SIZE;
+				for (i = 0; i < SIZE; i++)
+				{
+					total[i] += in[i]*cosine;
+				}
+			}
+			for (i = 0; i < SIZE; i++)
+			{
+				temp[n*SIZE + i] = total[i];
+			}
+		}
+
+		// Lines: row line of block from row line of temp
+		for (S32 line = 0; line < SIZE; line++)
+		{
+			const F32* linein = temp + line*SIZE;
+			const F32 dc = OO_SQRT2*linein[0];
+			for (n = 0; n < SIZE; n++)
+			{
+				total[n] = dc;
+			}
+			for (u = 1; u < SIZE; u++)
+			{
+				const F32 in = linein[u];
+				const F32* cosines = pcp + u*SIZE;
+				for (n = 0; n < SIZE; n++)
+				{
+					total[n] += in*cosines[n];
+				}
+			}
+			for (n = 0; n < SIZE; n++)
+			{
+				block[line*SIZE + n] = total[n]*oosob;
+			}
+		}
+	}
+}
+
+//static
+void LLPatchDecoder::idctPatch(F32* block, S32 size)
+{
+	if (size == NORMAL_PATCH_SIZE)
+	{
+		idct_patch_sized<NORMAL_PATCH_SIZE>(block);
+	}
+	else
+	{
+		idct_patch_sized<LARGE_PATCH_SIZE>(block);
+	}
+}
@@ -0,0 +1,137 @@
+/** 
+ * @file llpatchdecoder.h
+ * @brief Batched, threaded decompression of DCT coded terrain patches.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#ifndef LL_LLPATCHDECODER_H
+#define LL_LLPATCHDECODER_H
+
+#include <vector>
+
+#include "bitpack.h"
+#include "stdtypes.h"
+#include "patch_dct.h"
+
+// Decompresses the land patches of a set of LayerData packets as one
+// batch:
+//
+//  readPackets() reads the patch headers and coefficients of every
+//  packet, a packet per thread.
+//  The caller checks the patch ids and sets where each patch goes.
+//  decompressPackets() dequantizes, inverse transforms and writes out
+//  every patch, a patch per thread.
+//
+// The work is split up with LLTaskScheduler::parallelRange(), so it stays
+// on the calling thread when there is no scheduler.  Each patch is
+// decoded by exactly one thread, so the output does not depend on the
+// number of threads.
+//
+// The inverse DCT has a scalar version that matches decompress_patch()
+// and an SSE2 version that is bit-exact with it on builds that do scalar
+// float math in SSE registers.
+class LLPatchDecoder
+{
+public:
+	struct Patch
+	{
+		LLPatchHeader mHeader;
+		S32 mCoeffs[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		F32* mDest;			// first height of the patch, NULL to skip it
+		void* mUserData;
+	};
+	typedef std::vector<Patch> patch_list_t;
+
+	struct Packet
+	{
+		// bitpack must be positioned just after the group header
+		Packet(const LLBitPack& bitpack, S32 patch_size, S32 stride, void* user_data = NULL)
+			: mBitPack(bitpack), mPatchSize(patch_size), mStride(stride), mUserData(user_data)
+		{
+		}
+
+		LLBitPack mBitPack;
+		S32 mPatchSize;
+		S32 mStride;		// floats between rows of mDest
+		void* mUserData;
+		patch_list_t mPatches;
+	};
+	typedef std::vector<Packet> packet_list_t;
+
+	// Selects the kernels for this CPU.
+	static void initClass();
+	static void cleanupClass();
+
+	// For tests and benchmarks.  setVectorize(true) has no effect if the
+	// CPU or the build lacks SSE2; setParallel(true) none without an
+	// LLTaskScheduler.
+	static void setVectorize(bool vectorize);
+	static bool getVectorize()				{ return sVectorize; }
+	static void setParallel(bool parallel)	{ sParallel = parallel; }
+	static bool getParallel()				{ return sParallel; }
+
+	// Fills in mPatches of every packet, with NULL destinations.  Packets
+	// with a patch size other than 16 or 32 are left empty.
+	static void readPackets(packet_list_t& packets);
+
+	// Reads patches up to the end of patches marker.  Reentrant.
+	static void readPatches(LLBitPack& bitpack, S32 patch_size, patch_list_t& patches);
+
+	// Decompresses every patch with a destination.  If a destination
+	// appears more than once only the last patch for it is decoded, as if
+	// the packets had been decoded in order.
+	static void decompressPackets(packet_list_t& packets);
+
+	// Decompresses one patch.  Safe to call from any thread once
+	// init_patch_decompressor(size) has been called.
+	static void decompressPatch(const Patch& patch, S32 size, S32 stride, bool vectorize);
+
+	// Scalar reference inverse DCT of a size x size block, in place.  The
+	// same operations in the same order as idct_patch() in patch_idct.cpp.
+	static void idctPatch(F32* block, S32 size);
+
+	// SSE2 kernels, in llpatchdecoder_sse2.cpp
+	static bool hasSSE2Kernels();
+	static void idctPatchSSE2(F32* block, S32 size);
+
+	// Runs func(context, begin, end) over [0, count), split up with
+	// LLTaskScheduler::parallelRange() when there are at least min_count
+	// items.  The viewer also uses this for the per patch normal and
+	// height stats updates that follow a decode.
+	typedef void (*range_func_t)(void* context, S32 begin, S32 end);
+	static void parallelFor(range_func_t func, void* context, S32 count, S32 min_count = 8);
+
+private:
+	static bool sVectorize;
+	static bool sParallel;
+};
+
+#endif // LL_LLPATCHDECODER_H
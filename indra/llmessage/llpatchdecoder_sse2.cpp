@@ -0,0 +1,139 @@
+/** 
+ * @file llpatchdecoder_sse2.cpp
+ * @brief SSE2 inverse DCT for terrain patch decompression.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+#include "linden_common.h"
+
+#include "llpatchdecoder.h"
+
+#include "llmath.h"
+
+#if (LL_GNUC && defined(__SSE2__)) || (LL_MSVC && (defined(_M_IX86) || defined(_M_X64)))
+#define LL_PATCH_SSE2 1
+#else
+#define LL_PATCH_SSE2 0
+#endif
+
+#if LL_PATCH_SSE2
+
+#include <emmintrin.h>
+
+extern F32 gPatchICosines[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+
+// Each lane does the same operations in the same order as
+// LLPatchDecoder::idctPatch(): the DC term times OO_SQRT2, then each
+// coefficient times its cosine added in turn.  The column pass works on
+// four columns at once and the line pass on four outputs of a line.
+
+//static
+bool LLPatchDecoder::hasSSE2Kernels()
+{
+	return true;
+}
+
+template <S32 SIZE>
+static void idct_patch_sse2(F32* block)
+{
+	F32 temp[SIZE*SIZE];
+	const F32* pcp = gPatchICosines;
+	const __m128 oo_sqrt2 = _mm_set1_ps(OO_SQRT2);
+	const __m128 oosob = _mm_set1_ps(2.f/(F32)SIZE);
+	S32 n, u;
+
+	// Columns, unscaled
+	for (n = 0; n < SIZE; n++)
+	{
+		for (S32 column = 0; column < SIZE; column += 4)
+		{
+			__m128 total = _mm_mul_ps(oo_sqrt2, _mm_loadu_ps(block + column));
+			for (u = 1; u < SIZE; u++)
+			{
+				__m128 in = _mm_loadu_ps(block + u*SIZE + column);
+				total = _mm_add_ps(total, _mm_mul_ps(in, _mm_set1_ps(pcp[u*SIZE + n])));
+			}
+			_mm_storeu_ps(temp + n*SIZE + column, total);
+		}
+	}
+
+	// Lines
+	for (S32 line = 0; line < SIZE; line++)
+	{
+		const F32* linein = temp + line*SIZE;
+		const __m128 dc = _mm_mul_ps(oo_sqrt2, _mm_set1_ps(linein[0]));
+		for (n = 0; n < SIZE; n += 4)
+		{
+			__m128 total = dc;
+			for (u = 1; u < SIZE; u++)
+			{
+				__m128 cosines = _mm_loadu_ps(pcp + u*SIZE + n);
+				total = _mm_add_ps(total, _mm_mul_ps(_mm_set1_ps(linein[u]), cosines));
+			}
+			_mm_storeu_ps(block + line*SIZE + n, _mm_mul_ps(total, oosob));
+		}
+	}
+}
+
+//static
+void LLPatchDecoder::idctPatchSSE2(F32* block, S32 size)
+{
+	if (size == NORMAL_PATCH_SIZE)
+	{
+		idct_patch_sse2<NORMAL_PATCH_SIZE>(block);
+	}
+	else
+	{
+		idct_patch_sse2<LARGE_PATCH_SIZE>(block);
+	}
+}
+
+#else // LL_PATCH_SSE2
+
+// Never called: LLPatchDecoder::setVectorize() checks hasSSE2Kernels()
+
+//static
+bool LLPatchDecoder::hasSSE2Kernels()
+{
+	return false;
+}
+
+//static
+void LLPatchDecoder::idctPatchSSE2(F32* block, S32 size)
+{
+	llerrs << "SSE2 kernels not built" << llendl;
+}
+
+#endif // LL_PATCH_SSE2
@@ -36,9 +36,11 @@
 #include "linden_common.h"
 #include "llpumpio.h"
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include "apr_poll.h"
+#include "apr_file_io.h"
 
 #include "llapr.h"
 #include "llmemtype.h"
@@ -73,6 +75,13 @@ const F32 DEFAULT_CHAIN_EXPIRY_SECS = 30.0f;
 extern const F32 SHORT_CHAIN_EXPIRY_SECS = 1.0f;
 extern const F32 NEVER_CHAIN_EXPIRY_SECS = 0.0f;
 
+// Starting size of the pollset of an event driven pump. It doubles
+// when it fills up.
+static const U32 INITIAL_EVENT_POLLSET_SIZE = 64;
+
+// client data of the wakeup pipe in the pollset. Chain ids start at 1.
+static S32 WAKEUP_CLIENT_ID = 0;
+
 // sorta spammy debug modes.
 //#define LL_DEBUG_SPEW_BUFFER_CHANNEL_IN_ON_ERROR 1
 //#define LL_DEBUG_PROCESS_LINK 1
@@ -169,7 +178,8 @@ struct ll_delete_apr_pollset_fd_client_data
 /**
  * LLPumpIO
  */
-LLPumpIO::LLPumpIO(apr_pool_t* pool) :
+LLPumpIO::LLPumpIO(apr_pool_t* pool, U32 flags) :
+	mFlags(flags),
 	mState(LLPumpIO::NORMAL),
 	mRebuildPollset(false),
 	mPollset(NULL),
@@ -180,9 +190,17 @@ LLPumpIO::LLPumpIO(apr_pool_t* pool) :
 	mCurrentPoolReallocCount(0),
 	mChainsMutex(NULL),
 	mCallbackMutex(NULL),
+	mNextChainID(0),
+	mPollsetSize(0),
+	mPollsetCount(0),
+	mWakeRead(NULL),
+	mWakeWrite(NULL),
 	mCurrentChain(mRunningChains.end())
 {
 	mCurrentChain = mRunningChains.end();
+#if LL_THREADS_APR
+	mFlags |= THREAD_SAFE;
+#endif
 
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
 	initialize(pool);
@@ -207,9 +225,7 @@ bool LLPumpIO::addChain(const chain_t& chain, F32 timeout)
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
 	if(chain.empty()) return false;
 
-#if LL_THREADS_APR
 	LLScopedLock lock(mChainsMutex);
-#endif
 	LLChainInfo info;
 	info.setTimeoutSeconds(timeout);
 	info.mData = LLIOPipe::buffer_ptr_t(new LLBufferArray);
@@ -229,6 +245,8 @@ bool LLPumpIO::addChain(const chain_t& chain, F32 timeout)
 		info.mChainLinks.push_back(link);
 	}
 	mPendingChains.push_back(info);
+	lock.unlock();
+	wakeup();
 	return true;
 }
 
@@ -246,9 +264,7 @@ bool LLPumpIO::addChain(
 	if(!data) return false;
 	if(links.empty()) return false;
 
-#if LL_THREADS_APR
 	LLScopedLock lock(mChainsMutex);
-#endif
 #if LL_DEBUG_PIPE_TYPE_IN_PUMP
 	lldebugs << "LLPumpIO::addChain() " << links[0].mPipe << " '"
 		<< typeid(*(links[0].mPipe)).name() << "'" << llendl;
@@ -261,6 +277,8 @@ bool LLPumpIO::addChain(
 	info.mData = data;
 	info.mContext = context;
 	mPendingChains.push_back(info);
+	lock.unlock();
+	wakeup();
 	return true;
 }
 
@@ -336,6 +354,10 @@ bool LLPumpIO::setConditional(LLIOPipe* pipe, const apr_pollfd_t* poll)
 		LLChainInfo::pipe_conditional_t& value = (*it);
 		if(pipe_ptr == value.first)
 		{
+			if((mFlags & EVENT_DRIVEN) && (*mCurrentChain).mPolling)
+			{
+				removePollDescriptor(value.second);
+			}
 			ll_delete_apr_pollset_fd_client_data()(value);
 			it = (*mCurrentChain).mDescriptors.erase(it);
 			mRebuildPollset = true;
@@ -362,6 +384,18 @@ bool LLPumpIO::setConditional(LLIOPipe* pipe, const apr_pollfd_t* poll)
 		// *FIX: Should it always be this pool?
 		value.second.p = mPool;
 	}
+	if(mFlags & EVENT_DRIVEN)
+	{
+		// signalled descriptors lead straight to their chain.
+		value.second.client_data = new S32((*mCurrentChain).mID);
+		if((*mCurrentChain).mPolling)
+		{
+			reservePollset(1);
+			addPollDescriptor(value.second);
+		}
+		(*mCurrentChain).mDescriptors.push_back(value);
+		return true;
+	}
 	value.second.client_data = new S32(++mPollsetClientID);
 	(*mCurrentChain).mDescriptors.push_back(value);
 	mRebuildPollset = true;
@@ -393,6 +427,10 @@ S32 LLPumpIO::setLock()
 
 	// set the lock
 	(*mCurrentChain).mLock = mNextLock;
+	if(mFlags & EVENT_DRIVEN)
+	{
+		mLockedChains[mNextLock] = (*mCurrentChain).mID;
+	}
 	return mNextLock;
 }
 
@@ -404,10 +442,10 @@ void LLPumpIO::clearLock(S32 key)
 	// therefore won't be treading into deleted memory. I think we can
 	// also clear the lock on the chain safely since the pump only
 	// reads that value.
-#if LL_THREADS_APR
 	LLScopedLock lock(mChainsMutex);
-#endif
 	mClearLocks.insert(key);
+	lock.unlock();
+	wakeup();
 }
 
 bool LLPumpIO::sleepChain(F64 seconds)
@@ -462,9 +500,7 @@ void LLPumpIO::pump(const S32& poll_timeout)
 	PUMP_DEBUG;
 	if(true)
 	{
-#if LL_THREADS_APR
 		LLScopedLock lock(mChainsMutex);
-#endif
 		// bail if this pump is paused.
 		if(PAUSING == mState)
 		{
@@ -481,17 +517,34 @@ void LLPumpIO::pump(const S32& poll_timeout)
 		{
 			PUMP_DEBUG;
 			//lldebugs << "Pushing " << mPendingChains.size() << "." << llendl;
-			std::copy(
-				mPendingChains.begin(),
-				mPendingChains.end(),
-				std::back_insert_iterator<running_chains_t>(mRunningChains));
+			if(mFlags & EVENT_DRIVEN)
+			{
+				pending_chains_t::iterator it = mPendingChains.begin();
+				pending_chains_t::iterator end = mPendingChains.end();
+				for(; it != end; ++it)
+				{
+					activateChain(*it);
+				}
+			}
+			else
+			{
+				std::copy(
+					mPendingChains.begin(),
+					mPendingChains.end(),
+					std::back_insert_iterator<running_chains_t>(mRunningChains));
+			}
 			mPendingChains.clear();
 			PUMP_DEBUG;
 		}
 
 		// Clear any locks. This needs to be done here so that we do
 		// not clash during a call to clearLock().
-		if(!mClearLocks.empty())
+		if(!mClearLocks.empty() && (mFlags & EVENT_DRIVEN))
+		{
+			PUMP_DEBUG;
+			clearEventLocks();
+		}
+		else if(!mClearLocks.empty())
 		{
 			PUMP_DEBUG;
 			running_chains_t::iterator it = mRunningChains.begin();
@@ -509,6 +562,12 @@ void LLPumpIO::pump(const S32& poll_timeout)
 		}
 	}
 
+	if(mFlags & EVENT_DRIVEN)
+	{
+		pumpEvents(poll_timeout);
+		return;
+	}
+
 	PUMP_DEBUG;
 	// rebuild the pollset if necessary
 	if(mRebuildPollset)
@@ -744,9 +803,7 @@ bool LLPumpIO::respond(LLIOPipe* pipe)
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
 	if(NULL == pipe) return false;
 
-#if LL_THREADS_APR
 	LLScopedLock lock(mCallbackMutex);
-#endif
 	LLChainInfo info;
 	LLLinkInfo link;
 	link.mPipe = pipe;
@@ -766,9 +823,7 @@ bool LLPumpIO::respond(
 	if(!data) return false;
 	if(links.empty()) return false;
 
-#if LL_THREADS_APR
 	LLScopedLock lock(mCallbackMutex);
-#endif
 
 	// Add the callback response
 	LLChainInfo info;
@@ -785,9 +840,7 @@ void LLPumpIO::callback()
 	//llinfos << "LLPumpIO::callback()" << llendl;
 	if(true)
 	{
-#if LL_THREADS_APR
 		LLScopedLock lock(mCallbackMutex);
-#endif
 		std::copy(
 			mPendingCallbacks.begin(),
 			mPendingCallbacks.end(),
@@ -812,9 +865,7 @@ void LLPumpIO::callback()
 
 void LLPumpIO::control(LLPumpIO::EControl op)
 {
-#if LL_THREADS_APR
 	LLScopedLock lock(mChainsMutex);
-#endif
 	switch(op)
 	{
 	case PAUSE:
@@ -827,29 +878,69 @@ void LLPumpIO::control(LLPumpIO::EControl op)
 		// no-op
 		break;
 	}
+	lock.unlock();
+	wakeup();
+}
+
+void LLPumpIO::wakeup()
+{
+	if(mWakeWrite)
+	{
+		// If the pipe is full the pump is going to wake up anyway.
+		apr_file_putc('w', mWakeWrite);
+	}
 }
 
 void LLPumpIO::initialize(apr_pool_t* pool)
 {
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
 	if(!pool) return;
-#if LL_THREADS_APR
-	// SJB: Windows defaults to NESTED and OSX defaults to UNNESTED, so use UNNESTED explicitly.
-	apr_thread_mutex_create(&mChainsMutex, APR_THREAD_MUTEX_UNNESTED, pool);
-	apr_thread_mutex_create(&mCallbackMutex, APR_THREAD_MUTEX_UNNESTED, pool);
-#endif
+	if(mFlags & THREAD_SAFE)
+	{
+		// SJB: Windows defaults to NESTED and OSX defaults to UNNESTED, so use UNNESTED explicitly.
+		apr_thread_mutex_create(&mChainsMutex, APR_THREAD_MUTEX_UNNESTED, pool);
+		apr_thread_mutex_create(&mCallbackMutex, APR_THREAD_MUTEX_UNNESTED, pool);
+	}
 	mPool = pool;
+	if(mFlags & EVENT_DRIVEN)
+	{
+#if !LL_WINDOWS
+		// The select() based pollset on windows can not wait on
+		// files, so a pump thread there just wakes up on its poll
+		// timeout.
+		if(mFlags & THREAD_SAFE)
+		{
+			apr_status_t status = apr_file_pipe_create(&mWakeRead, &mWakeWrite, pool);
+			if(!ll_apr_warn_status(status))
+			{
+				apr_file_pipe_timeout_set(mWakeRead, 0);
+				apr_file_pipe_timeout_set(mWakeWrite, 0);
+			}
+			else
+			{
+				mWakeRead = NULL;
+				mWakeWrite = NULL;
+			}
+		}
+#endif
+		createEventPollset(INITIAL_EVENT_POLLSET_SIZE);
+	}
 }
 
 void LLPumpIO::cleanup()
 {
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
-#if LL_THREADS_APR
 	if(mChainsMutex) apr_thread_mutex_destroy(mChainsMutex);
 	if(mCallbackMutex) apr_thread_mutex_destroy(mCallbackMutex);
-#endif
 	mChainsMutex = NULL;
 	mCallbackMutex = NULL;
+	if(mWakeRead)
+	{
+		apr_file_close(mWakeRead);
+		apr_file_close(mWakeWrite);
+		mWakeRead = NULL;
+		mWakeWrite = NULL;
+	}
 	if(mPollset)
 	{
 //		lldebugs << "cleaning up pollset" << llendl;
@@ -861,6 +952,7 @@ void LLPumpIO::cleanup()
 		apr_pool_destroy(mCurrentPool);
 		mCurrentPool = NULL;
 	}
+	mRegistrations.clear();
 	mPool = NULL;
 }
 
@@ -1154,6 +1246,582 @@ bool LLPumpIO::handleChainError(
 	return handled;
 }
 
+//
+// Event driven pump
+//
+
+void LLPumpIO::pumpEvents(S32 poll_timeout)
+{
+	PUMP_DEBUG;
+	// Do not wait if there is a chain ready to go, and never past the
+	// next timeout.
+	if(!mReadyChains.empty())
+	{
+		poll_timeout = 0;
+	}
+	while((poll_timeout > 0) && !mDeadlines.empty())
+	{
+		running_chains_t::iterator it;
+		LLChainInfo* chain = findChain(mDeadlines.front().mChainID, it);
+		if(!chain || (chain->mDeadline != mDeadlines.front().mExpiry))
+		{
+			std::pop_heap(mDeadlines.begin(), mDeadlines.end());
+			mDeadlines.pop_back();
+			continue;
+		}
+		// Clamp before converting, a far off deadline doesn't fit in an S32.
+		F32 wait = chain->mTimer.getTimeToExpireF32() * 1000000.f;
+		poll_timeout = (S32)llclamp(wait, 0.f, (F32)poll_timeout);
+		break;
+	}
+
+	// Poll. Only the chains which were signalled are looked at.
+	PUMP_DEBUG;
+	typedef std::map<S32, apr_int16_t> signalled_t;
+	signalled_t signalled;
+	if(mPollset)
+	{
+		S32 count = 0;
+		const apr_pollfd_t* poll_fd = NULL;
+		{
+			LLPerfBlock polltime("pump_poll");
+			apr_pollset_poll(mPollset, poll_timeout, &count, &poll_fd);
+		}
+		PUMP_DEBUG;
+		static const apr_int16_t POLL_ANY_ERROR =
+			APR_POLLHUP | APR_POLLNVAL | APR_POLLERR;
+		for(S32 ii = 0; ii < count; ++ii)
+		{
+			ll_debug_poll_fd("Signalled pipe", &poll_fd[ii]);
+			apr_int16_t events = poll_fd[ii].rtnevents;
+			LLPollRegistration* reg =
+				(LLPollRegistration*)poll_fd[ii].client_data;
+			LLPollRegistration::waiters_t::iterator wait_it;
+			LLPollRegistration::waiters_t::iterator wait_end;
+			wait_it = reg->mWaiters.begin();
+			wait_end = reg->mWaiters.end();
+			for(; wait_it != wait_end; ++wait_it)
+			{
+				if(WAKEUP_CLIENT_ID == (*wait_it).first)
+				{
+					drainWakeup();
+				}
+				else if(events & ((*wait_it).second | POLL_ANY_ERROR))
+				{
+					// errors go to every chain on the descriptor.
+					signalled[(*wait_it).first] |= events;
+				}
+			}
+		}
+	}
+
+	// Expire chains off the top of the heap.
+	PUMP_DEBUG;
+	while(!mDeadlines.empty())
+	{
+		LLChainDeadline deadline = mDeadlines.front();
+		running_chains_t::iterator it;
+		LLChainInfo* chain = findChain(deadline.mChainID, it);
+		if(!chain || (chain->mDeadline != deadline.mExpiry))
+		{
+			std::pop_heap(mDeadlines.begin(), mDeadlines.end());
+			mDeadlines.pop_back();
+			continue;
+		}
+		if(!chain->mInit || !chain->mTimer.hasExpired())
+		{
+			// a chain which has not run yet will run below.
+			break;
+		}
+		std::pop_heap(mDeadlines.begin(), mDeadlines.end());
+		mDeadlines.pop_back();
+		chain->mDeadline = 0.0;
+
+		mCurrentChain = it;
+		if(handleChainError(*chain, LLIOPipe::STATUS_EXPIRED))
+		{
+			// the pipe probably handled the error. If the handler
+			// forgot to reset the expiration then we need to do
+			// that here.
+			if(chain->mTimer.getStarted() && chain->mTimer.hasExpired())
+			{
+				llinfos << "Error handler forgot to reset timeout. "
+						<< "Resetting to " << DEFAULT_CHAIN_EXPIRY_SECS
+						<< " seconds." << llendl;
+				chain->setTimeoutSeconds(DEFAULT_CHAIN_EXPIRY_SECS);
+			}
+			updateChainState(*chain);
+			scheduleDeadline(*chain);
+		}
+		else
+		{
+			// it timed out and no one handled it, so we need to
+			// retire the chain
+			retireChain(it);
+		}
+	}
+
+	// Collect the chains to process, in the order they were added.
+	PUMP_DEBUG;
+	std::set<S32> process(mReadyChains);
+	signalled_t::iterator sig_it = signalled.begin();
+	signalled_t::iterator sig_end = signalled.end();
+	for(; sig_it != sig_end; ++sig_it)
+	{
+		running_chains_t::iterator it;
+		LLChainInfo* chain = findChain((*sig_it).first, it);
+		if(!chain || chain->mLock)
+		{
+			continue;
+		}
+		static const apr_int16_t POLL_CHAIN_ERROR =
+			APR_POLLHUP | APR_POLLNVAL | APR_POLLERR;
+		if((*sig_it).second & POLL_CHAIN_ERROR)
+		{
+			// Same as the polling pump, HUP wins over other errors.
+			LLIOPipe::EStatus error_status;
+			if((*sig_it).second & APR_POLLHUP)
+				error_status = LLIOPipe::STATUS_LOST_CONNECTION;
+			else
+				error_status = LLIOPipe::STATUS_ERROR;
+			mCurrentChain = it;
+			if(handleChainError(*chain, error_status))
+			{
+				updateChainState(*chain);
+				scheduleDeadline(*chain);
+				continue;
+			}
+			llwarns << "Removing pipe "
+				<< chain->mChainLinks[0].mPipe
+				<< " '"
+#if LL_DEBUG_PIPE_TYPE_IN_PUMP
+				<< typeid(*(chain->mChainLinks[0].mPipe)).name()
+#endif
+				<< "' because: "
+				<< events_2_string((*sig_it).second)
+				<< llendl;
+			retireChain(it);
+			continue;
+		}
+		process.insert((*sig_it).first);
+	}
+
+	PUMP_DEBUG;
+	std::set<S32>::iterator proc_it = process.begin();
+	std::set<S32>::iterator proc_end = process.end();
+	for(; proc_it != proc_end; ++proc_it)
+	{
+		running_chains_t::iterator it;
+		LLChainInfo* chain = findChain(*proc_it, it);
+		if(!chain)
+		{
+			continue;
+		}
+		if(chain->mLock)
+		{
+			updateChainState(*chain);
+			continue;
+		}
+		mCurrentChain = it;
+		if(!chain->mInit)
+		{
+			chain->mHead = chain->mChainLinks.begin();
+			chain->mInit = true;
+		}
+		PUMP_DEBUG;
+		processChain(*chain);
+		if(chain->mHead == chain->mChainLinks.end())
+		{
+			retireChain(it);
+		}
+		else
+		{
+			updateChainState(*chain);
+			scheduleDeadline(*chain);
+		}
+	}
+
+	PUMP_DEBUG;
+	// null out the chain
+	mCurrentChain = mRunningChains.end();
+	END_PUMP_DEBUG;
+}
+
+void LLPumpIO::activateChain(const LLChainInfo& info)
+{
+	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
+	mRunningChains.push_back(info);
+	running_chains_t::iterator it = mRunningChains.end();
+	--it;
+	LLChainInfo& chain = (*it);
+
+	// deal with wrap.
+	if(++mNextChainID <= 0)
+	{
+		mNextChainID = 1;
+	}
+	chain.mID = mNextChainID;
+	chain.mPolling = true;
+	chain.mDeadline = 0.0;
+	mChainIndex[chain.mID] = it;
+	updateChainState(chain);
+	scheduleDeadline(chain);
+}
+
+void LLPumpIO::retireChain(running_chains_t::iterator it)
+{
+	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
+	LLChainInfo& chain = (*it);
+#if LL_DEBUG_PIPE_TYPE_IN_PUMP
+	lldebugs << "Removing chain " << chain.mChainLinks[0].mPipe
+			<< " '"
+			<< typeid(*(chain.mChainLinks[0].mPipe)).name()
+			<< "'" << llendl;
+#endif
+	setChainPolling(chain, false);
+	std::for_each(
+		chain.mDescriptors.begin(),
+		chain.mDescriptors.end(),
+		ll_delete_apr_pollset_fd_client_data());
+	mReadyChains.erase(chain.mID);
+	mChainIndex.erase(chain.mID);
+	if(chain.mLock)
+	{
+		mLockedChains.erase(chain.mLock);
+	}
+	if(mCurrentChain == it)
+	{
+		mCurrentChain = mRunningChains.end();
+	}
+	mRunningChains.erase(it);
+}
+
+void LLPumpIO::clearEventLocks()
+{
+	std::set<S32>::iterator it = mClearLocks.begin();
+	std::set<S32>::iterator end = mClearLocks.end();
+	for(; it != end; ++it)
+	{
+		std::map<S32, S32>::iterator locked = mLockedChains.find(*it);
+		if(locked == mLockedChains.end())
+		{
+			continue;
+		}
+		running_chains_t::iterator chain_it;
+		LLChainInfo* chain = findChain((*locked).second, chain_it);
+		if(chain && (chain->mLock == (*locked).first))
+		{
+			chain->mLock = 0;
+			updateChainState(*chain);
+		}
+		mLockedChains.erase(locked);
+	}
+	mClearLocks.clear();
+}
+
+void LLPumpIO::updateChainState(LLChainInfo& chain)
+{
+	bool locked = (0 != chain.mLock);
+	if(!locked && chain.mDescriptors.empty())
+	{
+		mReadyChains.insert(chain.mID);
+	}
+	else
+	{
+		mReadyChains.erase(chain.mID);
+	}
+
+	// A locked chain is not interested in its descriptors, and with
+	// a level triggered poll they would keep waking up the pump.
+	setChainPolling(chain, !locked);
+}
+
+void LLPumpIO::scheduleDeadline(LLChainInfo& chain)
+{
+	if(!chain.mTimer.getStarted())
+	{
+		chain.mDeadline = 0.0;
+		return;
+	}
+	F64 expiry = chain.mTimer.expiresAt();
+	if(expiry == chain.mDeadline)
+	{
+		return;
+	}
+	chain.mDeadline = expiry;
+	LLChainDeadline deadline;
+	deadline.mExpiry = expiry;
+	deadline.mChainID = chain.mID;
+	mDeadlines.push_back(deadline);
+	std::push_heap(mDeadlines.begin(), mDeadlines.end());
+	compactDeadlines();
+}
+
+void LLPumpIO::compactDeadlines()
+{
+	// Chains which keep moving their timeout leave stale entries
+	// behind. Rebuild once they outnumber the live ones.
+	if(mDeadlines.size() < (2 * mChainIndex.size() + INITIAL_EVENT_POLLSET_SIZE))
+	{
+		return;
+	}
+	mDeadlines.clear();
+	chain_index_t::iterator it = mChainIndex.begin();
+	chain_index_t::iterator end = mChainIndex.end();
+	for(; it != end; ++it)
+	{
+		LLChainInfo& chain = *((*it).second);
+		if(chain.mDeadline != 0.0)
+		{
+			LLChainDeadline deadline;
+			deadline.mExpiry = chain.mDeadline;
+			deadline.mChainID = chain.mID;
+			mDeadlines.push_back(deadline);
+		}
+	}
+	std::make_heap(mDeadlines.begin(), mDeadlines.end());
+}
+
+LLPumpIO::LLChainInfo* LLPumpIO::findChain(
+	S32 id,
+	running_chains_t::iterator& it)
+{
+	chain_index_t::iterator found = mChainIndex.find(id);
+	if(found == mChainIndex.end())
+	{
+		return NULL;
+	}
+	it = (*found).second;
+	return &(*it);
+}
+
+void LLPumpIO::createEventPollset(U32 size)
+{
+	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
+	if(mPollset)
+	{
+		apr_pollset_destroy(mPollset);
+		mPollset = NULL;
+	}
+	if(mCurrentPool)
+	{
+		apr_pool_destroy(mCurrentPool);
+		mCurrentPool = NULL;
+	}
+	mPollsetCount = 0;
+	mPollsetSize = 0;
+	mRegistrations.clear();
+	if(!mPool)
+	{
+		return;
+	}
+
+	// Make sure everything already in the pollset fits.
+	U32 needed = mWakeRead ? 1 : 0;
+	running_chains_t::iterator run_it = mRunningChains.begin();
+	running_chains_t::iterator run_end = mRunningChains.end();
+	for(; run_it != run_end; ++run_it)
+	{
+		if((*run_it).mPolling)
+		{
+			needed += (*run_it).mDescriptors.size();
+		}
+	}
+	size = llmax(size, needed * 2);
+
+	apr_status_t status = apr_pool_create(&mCurrentPool, mPool);
+	if(ll_apr_warn_status(status))
+	{
+		mCurrentPool = NULL;
+		return;
+	}
+	status = apr_pollset_create(&mPollset, size, mCurrentPool, 0);
+	if(ll_apr_warn_status(status))
+	{
+		mPollset = NULL;
+		return;
+	}
+	mPollsetSize = size;
+
+	if(mWakeRead)
+	{
+		apr_pollfd_t poll_fd;
+		poll_fd.p = mCurrentPool;
+		poll_fd.desc_type = APR_POLL_FILE;
+		poll_fd.reqevents = APR_POLLIN;
+		poll_fd.rtnevents = 0x0;
+		poll_fd.desc.f = mWakeRead;
+		poll_fd.client_data = &WAKEUP_CLIENT_ID;
+		addPollDescriptor(poll_fd);
+	}
+	for(run_it = mRunningChains.begin(); run_it != run_end; ++run_it)
+	{
+		if(!(*run_it).mPolling)
+		{
+			continue;
+		}
+		LLChainInfo::conditionals_t::iterator fd_it;
+		LLChainInfo::conditionals_t::iterator fd_end;
+		fd_it = (*run_it).mDescriptors.begin();
+		fd_end = (*run_it).mDescriptors.end();
+		for(; fd_it != fd_end; ++fd_it)
+		{
+			addPollDescriptor((*fd_it).second);
+		}
+	}
+}
+
+static void* poll_key(const apr_pollfd_t& poll)
+{
+	if(APR_POLL_FILE == poll.desc_type)
+	{
+		return poll.desc.f;
+	}
+	return poll.desc.s;
+}
+
+typedef std::vector<std::pair<S32, apr_int16_t> > poll_waiters_t;
+static apr_int16_t waited_events(const poll_waiters_t& waiters)
+{
+	apr_int16_t events = 0;
+	poll_waiters_t::const_iterator it;
+	for(it = waiters.begin(); it != waiters.end(); ++it)
+	{
+		events |= (*it).second;
+	}
+	return events;
+}
+
+void LLPumpIO::addPollDescriptor(apr_pollfd_t& poll)
+{
+	if(!mPollset)
+	{
+		return;
+	}
+	ll_debug_poll_fd("Adding", &poll);
+	LLPollRegistration& reg = mRegistrations[poll_key(poll)];
+	apr_int16_t events = waited_events(reg.mWaiters);
+	if(reg.mWaiters.empty())
+	{
+		reg.mPoll = poll;
+		reg.mPoll.client_data = &reg;
+	}
+	S32 id = *((S32*)poll.client_data);
+	reg.mWaiters.push_back(std::make_pair(id, poll.reqevents));
+	updateRegistration(reg, events);
+}
+
+void LLPumpIO::reservePollset(U32 count)
+{
+	if(mPollset && ((mPollsetCount + count) > mPollsetSize))
+	{
+		// The select and poll based pollsets have a fixed size, so
+		// start a bigger one. This re-adds everything already in the
+		// pollset.
+		createEventPollset(llmax(mPollsetSize * 2, mPollsetCount + count));
+	}
+}
+
+void LLPumpIO::removePollDescriptor(apr_pollfd_t& poll)
+{
+	if(!mPollset)
+	{
+		return;
+	}
+	ll_debug_poll_fd("Removing", &poll);
+	registrations_t::iterator it = mRegistrations.find(poll_key(poll));
+	if(it == mRegistrations.end())
+	{
+		return;
+	}
+	LLPollRegistration& reg = (*it).second;
+	apr_int16_t events = waited_events(reg.mWaiters);
+	S32 id = *((S32*)poll.client_data);
+	LLPollRegistration::waiters_t::iterator wait_it = reg.mWaiters.begin();
+	for(; wait_it != reg.mWaiters.end(); ++wait_it)
+	{
+		if(((*wait_it).first == id) && ((*wait_it).second == poll.reqevents))
+		{
+			reg.mWaiters.erase(wait_it);
+			break;
+		}
+	}
+	updateRegistration(reg, events);
+	if(reg.mWaiters.empty())
+	{
+		mRegistrations.erase(it);
+	}
+}
+
+void LLPumpIO::updateRegistration(LLPollRegistration& reg, apr_int16_t events)
+{
+	// The pollset cannot change what it waits for on a descriptor,
+	// so take it out and put it back with the new events.
+	apr_int16_t wanted = waited_events(reg.mWaiters);
+	if(wanted == events)
+	{
+		return;
+	}
+	apr_status_t status;
+	if(events)
+	{
+		status = apr_pollset_remove(mPollset, &reg.mPoll);
+		if((APR_SUCCESS == status) && (mPollsetCount > 0))
+		{
+			--mPollsetCount;
+		}
+	}
+	if(wanted)
+	{
+		reg.mPoll.reqevents = wanted;
+		reg.mPoll.rtnevents = 0x0;
+		status = apr_pollset_add(mPollset, &reg.mPoll);
+		if(!ll_apr_warn_status(status))
+		{
+			++mPollsetCount;
+		}
+	}
+}
+
+void LLPumpIO::setChainPolling(LLChainInfo& chain, bool polling)
+{
+	if(chain.mPolling == polling)
+	{
+		return;
+	}
+	if(polling)
+	{
+		// before the flag flips, so a new pollset does not get this
+		// chain's descriptors twice.
+		reservePollset(chain.mDescriptors.size());
+	}
+	chain.mPolling = polling;
+	LLChainInfo::conditionals_t::iterator it = chain.mDescriptors.begin();
+	LLChainInfo::conditionals_t::iterator end = chain.mDescriptors.end();
+	for(; it != end; ++it)
+	{
+		if(polling)
+		{
+			addPollDescriptor((*it).second);
+		}
+		else
+		{
+			removePollDescriptor((*it).second);
+		}
+	}
+}
+
+void LLPumpIO::drainWakeup()
+{
+	char buf[64];		/* Flawfinder: ignore */
+	apr_size_t len = sizeof(buf);
+	while((APR_SUCCESS == apr_file_read(mWakeRead, buf, &len))
+		  && (sizeof(buf) == len))
+	{
+		len = sizeof(buf);
+	}
+}
+
 /**
  * LLPumpIO::LLChainInfo
  */
@@ -1161,7 +1829,10 @@ bool LLPumpIO::handleChainError(
 LLPumpIO::LLChainInfo::LLChainInfo() :
 	mInit(false),
 	mLock(0),
-	mEOS(false)
+	mID(0),
+	mEOS(false),
+	mPolling(true),
+	mDeadline(0.0)
 {
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
 	mTimer.setTimerExpirySec(DEFAULT_CHAIN_EXPIRY_SECS);
@@ -36,6 +36,7 @@
 #ifndef LL_LLPUMPIO_H
 #define LL_LLPUMPIO_H
 
+#include <map>
 #include <set>
 #if LL_LINUX  // needed for PATH_MAX in APR.
 #include <sys/param.h>
@@ -79,14 +80,38 @@ extern const F32 NEVER_CHAIN_EXPIRY_SECS;
  * One way to conceptualize the way IO will work is that a pump
  * combines the unit processing of pipes to behave like file pipes on
  * the unix command line.
+ * By default every call to <code>pump()</code> visits every running
+ * chain, and the pollset is rebuilt whenever a conditional
+ * changes. An <code>EVENT_DRIVEN</code> pump keeps one pollset up to
+ * date as conditionals change and keeps the chain timeouts in a heap,
+ * so the cost of a pump depends on the number of chains with work to
+ * do rather than the number of chains waiting on the network.
  */
 class LLPumpIO
 {
 public:
+	/**
+	 * @brief Flags for the constructor.
+	 */
+	enum
+	{
+		// Register descriptors incrementally and only visit chains
+		// which are ready, signalled or expiring.
+		EVENT_DRIVEN = 1,
+
+		// Lock the chain and callback queues so that chains can be
+		// added from other threads while the pump runs on its own
+		// thread. See LLPumpIOThread.
+		THREAD_SAFE = 2
+	};
+
 	/**
 	 * @brief Constructor.
+	 *
+	 * @param pool The apr pool to use.
+	 * @param flags A combination of the flags above.
 	 */
-	LLPumpIO(apr_pool_t* pool);
+	LLPumpIO(apr_pool_t* pool, U32 flags = 0);
 
 	/**
 	 * @brief Destructor.
@@ -188,7 +213,9 @@ public:
 	 * signalled pipe will eventually invoke a call to process(), but
 	 * is a problem if the same apr_pollfd_t is on different
 	 * chains. Once we have more than just network i/o on the pump,
-	 * this might matter.
+	 * this might matter. Event driven pumps add each descriptor once
+	 * for all the pipes waiting on it, so they do not have this
+	 * problem.
 	 * *FIX: Given the structure of the pump and pipe relationship,
 	 * this should probably go through a different mechanism than the
 	 * pump. I think it would be best if the pipe had some kind of
@@ -330,6 +357,15 @@ public:
 	 */
 	void control(EControl op);
 
+	/** 
+	 * @brief Wake up a thread blocked in <code>pump()</code>.
+	 *
+	 * Only does anything for a <code>THREAD_SAFE</code>,
+	 * <code>EVENT_DRIVEN</code> pump. Adding a chain, clearing a lock
+	 * or sending a control does this for you.
+	 */
+	void wakeup();
+
 protected:
 	/** 
 	 * @brief State of the pump
@@ -342,6 +378,7 @@ protected:
 	};
 
 	// instance data
+	U32 mFlags;
 	EState mState;
 	bool mRebuildPollset;
 	apr_pollset_t* mPollset;
@@ -364,6 +401,7 @@ protected:
 		// basic member data
 		bool mInit;
 		S32 mLock;
+		S32 mID;
 		LLFrameTimer mTimer;
 		links_t::iterator mHead;
 		links_t mChainLinks;
@@ -375,6 +413,10 @@ protected:
 		typedef std::pair<LLIOPipe::ptr_t, apr_pollfd_t> pipe_conditional_t;
 		typedef std::vector<pipe_conditional_t> conditionals_t;
 		conditionals_t mDescriptors;
+
+		// event driven tracking
+		bool mPolling;		// mDescriptors are in the pollset
+		F64 mDeadline;		// expiry last put in the deadline heap
 	};
 
 	// All the running chains & info
@@ -398,13 +440,56 @@ protected:
 	apr_pool_t* mCurrentPool;
 	S32 mCurrentPoolReallocCount;
 
-#if LL_THREADS_APR
+	// NULL unless the pump is thread safe.
 	apr_thread_mutex_t* mChainsMutex;
 	apr_thread_mutex_t* mCallbackMutex;
-#else
-	int* mChainsMutex;
-	int* mCallbackMutex;
-#endif
+
+	// Event driven state. Running chains are found by id, since list
+	// iterators cannot be checked for validity.
+	typedef std::map<S32, running_chains_t::iterator> chain_index_t;
+	chain_index_t mChainIndex;
+	S32 mNextChainID;
+
+	// Unlocked chains without conditionals, processed on every pump.
+	// Chain ids increase, so this keeps the order chains were added.
+	std::set<S32> mReadyChains;
+
+	// Lock key to chain id, for clearing locks.
+	std::map<S32, S32> mLockedChains;
+
+	// Min-heap of chain timeouts. Entries are not removed when a
+	// timeout changes or a chain goes away, they are skipped when
+	// they come to the top.
+	struct LLChainDeadline
+	{
+		F64 mExpiry;
+		S32 mChainID;
+		bool operator<(const LLChainDeadline& rhs) const
+		{
+			// reversed, for a min-heap with the std heap functions.
+			return mExpiry > rhs.mExpiry;
+		}
+	};
+	std::vector<LLChainDeadline> mDeadlines;
+
+	// epoll will not take the same descriptor twice, so each socket
+	// or file goes in the pollset once, asking for everything the
+	// pipes waiting on it want. Keyed on the apr socket or file.
+	struct LLPollRegistration
+	{
+		apr_pollfd_t mPoll;
+
+		// client id and events of each pipe waiting on the descriptor.
+		typedef std::vector<std::pair<S32, apr_int16_t> > waiters_t;
+		waiters_t mWaiters;
+	};
+	typedef std::map<void*, LLPollRegistration> registrations_t;
+	registrations_t mRegistrations;
+
+	U32 mPollsetSize;
+	U32 mPollsetCount;
+	apr_file_t* mWakeRead;
+	apr_file_t* mWakeWrite;
 
 protected:
 	void initialize(apr_pool_t* pool);
@@ -436,6 +521,32 @@ protected:
 	 */
 	bool handleChainError(LLChainInfo& chain, LLIOPipe::EStatus error);
 
+	/** 
+	 * @name Event driven pump
+	 * @see EVENT_DRIVEN
+	 */
+	//@{
+	void pumpEvents(S32 poll_timeout);
+	void activateChain(const LLChainInfo& info);
+	void retireChain(running_chains_t::iterator chain);
+	void clearEventLocks();
+
+	// Puts the chain in or out of mReadyChains and the pollset after
+	// its lock or conditionals may have changed.
+	void updateChainState(LLChainInfo& chain);
+	void scheduleDeadline(LLChainInfo& chain);
+	void compactDeadlines();
+	LLChainInfo* findChain(S32 id, running_chains_t::iterator& it);
+
+	void createEventPollset(U32 size);
+	void reservePollset(U32 count);
+	void addPollDescriptor(apr_pollfd_t& poll);
+	void removePollDescriptor(apr_pollfd_t& poll);
+	void updateRegistration(LLPollRegistration& reg, apr_int16_t events);
+	void setChainPolling(LLChainInfo& chain, bool polling);
+	void drainWakeup();
+	//@}
+
 public:
 	/** 
 	 * @brief Return number of running chains.
@@ -0,0 +1,77 @@
+/** 
+ * @file llpumpiothread.cpp
+ * @brief Runs an event driven LLPumpIO on its own thread.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#include "linden_common.h"
+#include "llpumpiothread.h"
+
+#include "llpumpio.h"
+
+// How long the thread waits in the poll when there is nothing to do.
+// Chains put to sleep by LLPumpIO::sleepChain() are only woken up
+// this often. (microseconds)
+static const S32 IO_THREAD_POLL_TIMEOUT = 50000;
+
+LLPumpIOThread::LLPumpIOThread(const std::string& name) :
+	LLThread(name),
+	mPumpPool(NULL),
+	mPump(NULL)
+{
+	// the pump gets its own pool, since LLThread destroys its pool
+	// when it shuts down.
+	apr_pool_create(&mPumpPool, NULL);
+	mPump = new LLPumpIO(mPumpPool, LLPumpIO::EVENT_DRIVEN | LLPumpIO::THREAD_SAFE);
+}
+
+LLPumpIOThread::~LLPumpIOThread()
+{
+	shutdown();
+	if(isStopped())
+	{
+		delete mPump;
+		apr_pool_destroy(mPumpPool);
+	}
+	else
+	{
+		llwarns << "Leaking the pump of " << mName << llendl;
+	}
+	mPump = NULL;
+	mPumpPool = NULL;
+}
+
+void LLPumpIOThread::run()
+{
+	while(!isQuitting())
+	{
+		mPump->pump(IO_THREAD_POLL_TIMEOUT);
+	}
+}
@@ -0,0 +1,74 @@
+/** 
+ * @file llpumpiothread.h
+ * @brief Runs an event driven LLPumpIO on its own thread.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#ifndef LL_LLPUMPIOTHREAD_H
+#define LL_LLPUMPIOTHREAD_H
+
+#include "llthread.h"
+
+class LLPumpIO;
+
+/** 
+ * @class LLPumpIOThread
+ * @brief A thread which does nothing but pump an event driven,
+ * thread safe LLPumpIO.
+ *
+ * Chains may be added to the pump from any thread. The pump blocks in
+ * the poll until a descriptor is signalled, a chain is added, a lock
+ * is cleared or a chain is due to expire. Every pipe on the pump runs
+ * on this thread, so pipes that touch other state must hand their
+ * results back through <code>LLPumpIO::respond()</code>, and someone
+ * must call <code>getPump()->callback()</code> on the thread that
+ * wants them.
+ * Chain timeouts use the frame time, so they are only as accurate as
+ * the frame rate of the thread calling
+ * <code>LLFrameTimer::updateFrameTime()</code>.
+ */
+class LLPumpIOThread : public LLThread
+{
+public:
+	LLPumpIOThread(const std::string& name = "IO Pump");
+
+	// Stops the thread before deleting the pump.
+	virtual ~LLPumpIOThread();
+
+	LLPumpIO* getPump() { return mPump; }
+
+protected:
+	/*virtual*/ void run(void);
+
+	apr_pool_t* mPumpPool;
+	LLPumpIO* mPump;
+};
+
+#endif // LL_LLPUMPIOTHREAD_H
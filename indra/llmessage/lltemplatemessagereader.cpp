@@ -48,7 +48,6 @@ LLTemplateMessageReader::LLTemplateMessageReader(message_template_number_map_t&
 												 number_template_map) :
 	mReceiveSize(0),
 	mCurrentRMessageTemplate(NULL),
-	mCurrentRMessageData(NULL),
 	mMessageNumbers(number_template_map)
 {
 }
@@ -56,8 +55,6 @@ LLTemplateMessageReader::LLTemplateMessageReader(message_template_number_map_t&
 //virtual 
 LLTemplateMessageReader::~LLTemplateMessageReader()
 {
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
 }
 
 //virtual
@@ -65,8 +62,21 @@ void LLTemplateMessageReader::clearMessage()
 {
 	mReceiveSize = -1;
 	mCurrentRMessageTemplate = NULL;
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
+	mMessageView.clear();
+}
+
+BOOL LLTemplateMessageReader::findVariable(const char *blockname, const char *varname,
+										   S32 &block, S32 &variable) const
+{
+	const LLMessageTemplateLayout* layout = mMessageView.getLayout();
+	block = layout->findBlock(blockname);
+	if (block < 0)
+	{
+		variable = -1;
+		return FALSE;
+	}
+	variable = layout->findVariable(block, varname);
+	return variable >= 0;
 }
 
 void LLTemplateMessageReader::getData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum, S32 max_size)
@@ -78,77 +88,59 @@ void LLTemplateMessageReader::getData(const char *blockname, const char *varname
 		return;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mMessageView.isValid())
 	{
-		llerrs << "Invalid mCurrentMessageData in getData!" << llendl;
+		llerrs << "Invalid mMessageView in getData!" << llendl;
 		return;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; // this works because it's just a hash.  The bnamep is never derefference
-	char *vnamep = (char *)varname; 
+	S32 block = -1;
+	S32 variable = -1;
+	findVariable(blockname, varname, block, variable);
 
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	if (block < 0 || blocknum >= mMessageView.getNumberOfBlocks(block))
 	{
 		llerrs << "Block " << blockname << " #" << blocknum
-			<< " not in message " << mCurrentRMessageData->mName << llendl;
+			<< " not in message " << getMessageName() << llendl;
 		return;
 	}
 
-	LLMsgBlkData *msg_block_data = iter->second;
-	LLMsgVarData& vardata = msg_block_data->mMemberVarData[vnamep];
-
-	if (!vardata.getName())
+	const U8* vardata = NULL;
+	S32 vardata_size = 0;
+	if (variable < 0
+		|| !mMessageView.getVariable(block, blocknum, variable, vardata, vardata_size))
 	{
-		llerrs << "Variable "<< vnamep << " not in message "
-			<< mCurrentRMessageData->mName<< " block " << bnamep << llendl;
+		llerrs << "Variable "<< varname << " not in message "
+			<< getMessageName() << " block " << blockname << llendl;
 		return;
 	}
 
-	if (size && size != vardata.getSize())
+	if (size && size != vardata_size)
 	{
-		llerrs << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		llerrs << "Msg " << getMessageName()
+			<< " variable " << varname
+			<< " is size " << vardata_size
 			<< " but copying into buffer of size " << size
 			<< llendl;
 		return;
 	}
 
-
-	const S32 vardata_size = vardata.getSize();
 	if( max_size >= vardata_size )
 	{   
-		switch( vardata_size )
-		{ 
-		case 1:
-			*((U8*)datap) = *((U8*)vardata.getData());
-			break;
-		case 2:
-			*((U16*)datap) = *((U16*)vardata.getData());
-			break;
-		case 4:
-			*((U32*)datap) = *((U32*)vardata.getData());
-			break;
-		case 8:
-			((U32*)datap)[0] = ((U32*)vardata.getData())[0];
-			((U32*)datap)[1] = ((U32*)vardata.getData())[1];
-			break;
-		default:
-			memcpy(datap, vardata.getData(), vardata_size);
-			break;
-		}
+		// the view holds packet bytes, so swizzle on the way out
+		htonmemcpy(datap, vardata, 
+				   mMessageView.getLayout()->mVariables[variable].mType, 
+				   vardata_size);
 	}
 	else
 	{
-		llwarns << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		llwarns << "Msg " << getMessageName()
+			<< " variable " << varname
+			<< " is size " << vardata_size
 			<< " but truncated to max size of " << max_size
 			<< llendl;
 
-		memcpy(datap, vardata.getData(), max_size);
+		memcpy(datap, vardata, max_size);
 	}
 }
 
@@ -161,22 +153,13 @@ S32 LLTemplateMessageReader::getNumberOfBlocks(const char *blockname)
 		return -1;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mMessageView.isValid())
 	{
-		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
+		llerrs << "Invalid mMessageView in getData!" << llendl;
 		return -1;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
-	{
-		return 0;
-	}
-
-	return (iter->second)->mBlockNumber;
+	return mMessageView.getNumberOfBlocks(mMessageView.getLayout()->findBlock(blockname));
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
@@ -188,43 +171,41 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mMessageView.isValid())
 	{	// This is a serious error - crash
-		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
+		llerrs << "Invalid mMessageView in getData!" << llendl;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
+	S32 block = -1;
+	S32 variable = -1;
+	findVariable(blockname, varname, block, variable);
 	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	if (mMessageView.getNumberOfBlocks(block) == 0)
 	{	// don't crash
-		llinfos << "Block " << bnamep << " not in message "
-			<< mCurrentRMessageData->mName << llendl;
+		llinfos << "Block " << blockname << " not in message "
+			<< getMessageName() << llendl;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
 
-	char *vnamep = (char *)varname; 
-
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	const U8* vardata = NULL;
+	S32 vardata_size = 0;
+	if (variable < 0
+		|| !mMessageView.getVariable(block, 0, variable, vardata, vardata_size))
 	{	// don't crash
 		llinfos << "Variable " << varname << " not in message "
-			<< mCurrentRMessageData->mName << " block " << bnamep << llendl;
+			<< getMessageName() << " block " << blockname << llendl;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	if (mCurrentRMessageTemplate->mMemberBlocks[bnamep]->mType != MBT_SINGLE)
+	if (mMessageView.getLayout()->mBlocks[block].mType != MBT_SINGLE)
 	{	// This is a serious error - crash
-		llerrs << "Block " << bnamep << " isn't type MBT_SINGLE,"
+		llerrs << "Block " << blockname << " isn't type MBT_SINGLE,"
 			" use getSize with blocknum argument!" << llendl;
 		return LL_MESSAGE_ERROR;
 	}
 
-	return vardata.getSize();
+	return vardata_size;
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const char *varname)
@@ -236,35 +217,34 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mMessageView.isValid())
 	{	// This is a serious error - crash
-		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
+		llerrs << "Invalid mMessageView in getData!" << llendl;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; 
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
+	S32 block = -1;
+	S32 variable = -1;
+	findVariable(blockname, varname, block, variable);
 	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	if (blocknum >= mMessageView.getNumberOfBlocks(block))
 	{	// don't crash
-		llinfos << "Block " << bnamep << " not in message " 
-			<< mCurrentRMessageData->mName << llendl;
+		llinfos << "Block " << blockname << " #" << blocknum << " not in message " 
+			<< getMessageName() << llendl;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
 
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	const U8* vardata = NULL;
+	S32 vardata_size = 0;
+	if (variable < 0
+		|| !mMessageView.getVariable(block, blocknum, variable, vardata, vardata_size))
 	{	// don't crash
-		llinfos << "Variable " << vnamep << " not in message "
-			<<  mCurrentRMessageData->mName << " block " << bnamep << llendl;
+		llinfos << "Variable " << varname << " not in message "
+			<<  getMessageName() << " block " << blockname << llendl;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	return vardata.getSize();
+	return vardata_size;
 }
 
 void LLTemplateMessageReader::getBinaryData(const char *blockname, 
@@ -538,40 +518,37 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 {
 	llassert( mReceiveSize >= 0 );
 	llassert( mCurrentRMessageTemplate);
-	llassert( !mCurrentRMessageData );
-	delete mCurrentRMessageData; // just to make sure
+	llassert( !mMessageView.isValid() );
 
 	// The offset tells us how may bytes to skip after the end of the
 	// message name.
 	U8 offset = buffer[PHL_OFFSET];
 	S32 decode_pos = LL_PACKET_ID_SIZE + (S32)(mCurrentRMessageTemplate->mFrequency) + offset;
 
-	// create base working data set
-	mCurrentRMessageData = new LLMsgData(mCurrentRMessageTemplate->mName);
+	// reuse the working data set; the view only records offsets
+	const LLMessageTemplateLayout& layout = mCurrentRMessageTemplate->getLayout();
+	mMessageView.reset(&layout, buffer, mReceiveSize);
 	
-	// loop through the template building the data structure as we go
-	LLMessageTemplate::message_block_map_t::const_iterator iter;
-	for(iter = mCurrentRMessageTemplate->mMemberBlocks.begin();
-		iter != mCurrentRMessageTemplate->mMemberBlocks.end();
-		++iter)
+	// loop through the template building the view as we go
+	for (S32 block = 0; block < (S32)layout.mBlocks.size(); ++block)
 	{
-		LLMessageBlock* mbci = *iter;
+		const LLMessageTemplateLayout::Block& mbci = layout.mBlocks[block];
 		U8	repeat_number;
 		S32	i;
 
 		// how many of this block?
 
-		if (mbci->mType == MBT_SINGLE)
+		if (mbci.mType == MBT_SINGLE)
 		{
 			// just one
 			repeat_number = 1;
 		}
-		else if (mbci->mType == MBT_MULTIPLE)
+		else if (mbci.mType == MBT_MULTIPLE)
 		{
 			// a known number
-			repeat_number = mbci->mNumber;
+			repeat_number = mbci.mNumber;
 		}
-		else if (mbci->mType == MBT_VARIABLE)
+		else if (mbci.mType == MBT_VARIABLE)
 		{
 			// need to read the number from the message
 			// repeat number is a single byte
@@ -596,42 +573,33 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 			return FALSE;
 		}
 
-		LLMsgBlkData* cur_data_block = NULL;
+		mMessageView.beginBlock(block);
 
 		// now loop through the block
 		for (i = 0; i < repeat_number; i++)
 		{
-			if (i)
-			{
-				// build new name to prevent collisions
-				// TODO: This should really change to a vector
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-				cur_data_block->mName = mbci->mName + i;
-			}
-			else
+			if (mbci.mFixedSize >= 0
+				&& (decode_pos + mbci.mFixedSize) <= mReceiveSize)
 			{
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
+				// common case, offsets come from the template
+				mMessageView.addFixedInstance(decode_pos);
+				decode_pos += mbci.mFixedSize;
+				continue;
 			}
 
-			// add the block to the message
-			mCurrentRMessageData->addBlock(cur_data_block);
+			S32 slot = mMessageView.addInstance(mbci.mVariableCount);
 
 			// now read the variables
-			for (LLMessageBlock::message_variable_map_t::const_iterator iter = 
-					 mbci->mMemberVariables.begin();
-				 iter != mbci->mMemberVariables.end(); iter++)
+			for (S32 var = mbci.mFirstVariable;
+				 var < mbci.mFirstVariable + mbci.mVariableCount; ++var, ++slot)
 			{
-				const LLMessageVariable& mvci = **iter;
-
-				// ok, build out the variables
-				// add variable block
-				cur_data_block->addVariable(mvci.getName(), mvci.getType());
+				const LLMessageTemplateLayout::Variable& mvci = layout.mVariables[var];
 
 				// what type of variable?
-				if (mvci.getType() == MVT_VARIABLE)
+				if (mvci.mType == MVT_VARIABLE)
 				{
 					// variable, get the number of bytes to read from the template
-					S32 data_size = mvci.getSize();
+					S32 data_size = mvci.mSize;
 					U8 tsizeb = 0;
 					U16 tsizeh = 0;
 					U32 tsize = 0;
@@ -665,38 +633,42 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 					}
 					decode_pos += data_size;
 
-					cur_data_block->addData(mvci.getName(), &buffer[decode_pos], tsize, mvci.getType());
+					if ((decode_pos + (S32)tsize) > mReceiveSize)
+					{
+						// the view only holds the packet, don't read past it
+						logRanOffEndOfPacket(sender, decode_pos, tsize);
+						tsize = 0;
+					}
+					mMessageView.setVariable(slot, decode_pos, tsize);
 					decode_pos += tsize;
 				}
 				else
 				{
 					// fixed!
-					// so, copy data pointer and set data size to fixed size
-					if ((decode_pos + mvci.getSize()) > mReceiveSize)
+					// so, point at the data and set data size to fixed size
+					if ((decode_pos + mvci.mSize) > mReceiveSize)
 					{
-						logRanOffEndOfPacket(sender, decode_pos, mvci.getSize());
+						logRanOffEndOfPacket(sender, decode_pos, mvci.mSize);
 
 						// default to 0s.
-						U32 size = mvci.getSize();
-						std::vector<U8> data(size, 0);
-						cur_data_block->addData(mvci.getName(), &(data[0]), 
-												size, mvci.getType());
+						mMessageView.setVariable(slot, 
+												 mMessageView.appendZeros(mvci.mSize),
+												 mvci.mSize);
 					}
 					else
 					{
-						cur_data_block->addData(mvci.getName(), 
-												&buffer[decode_pos], 
-												mvci.getSize(), 
-												mvci.getType());
+						mMessageView.setVariable(slot, decode_pos, mvci.mSize);
 					}
-					decode_pos += mvci.getSize();
+					decode_pos += mvci.mSize;
 				}
 			}
 		}
+
+		mMessageView.endBlock(block);
 	}
 
-	if (mCurrentRMessageData->mMemberBlocks.empty()
-		&& !mCurrentRMessageTemplate->mMemberBlocks.empty())
+	if (mMessageView.getTotalBlockCount() == 0
+		&& !layout.mBlocks.empty())
 	{
 		lldebugs << "Empty message '" << mCurrentRMessageTemplate->mName << "' (no blocks)" << llendl;
 		return FALSE;
@@ -830,5 +802,8 @@ void LLTemplateMessageReader::copyToBuilder(LLMessageBuilder& builder) const
     {
         return;
     }
-	builder.copyFromMessageData(*mCurrentRMessageData);
+	// rare path (forwarding, LLSD conversion), so build the tree on demand
+	LLMsgData msg_data(mCurrentRMessageTemplate->mName);
+	mMessageView.copyToMsgData(msg_data);
+	builder.copyFromMessageData(msg_data);
 }
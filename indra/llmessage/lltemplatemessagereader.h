@@ -35,11 +35,11 @@
 #define LL_LLTEMPLATEMESSAGEREADER_H
 
 #include "llmessagereader.h"
+#include "lltemplatemessageview.h"
 
 #include <map>
 
 class LLMessageTemplate;
-class LLMsgData;
 
 class LLTemplateMessageReader : public LLMessageReader
 {
@@ -118,6 +118,11 @@ private:
 	void getData(const char *blockname, const char *varname, void *datap, 
 				 S32 size = 0, S32 blocknum = 0, S32 max_size = S32_MAX);
 
+	// Resolves block and variable names against the current template's
+	// layout.  Returns FALSE if the message has no such variable.
+	BOOL findVariable(const char *blockname, const char *varname,
+					  S32 &block, S32 &variable) const;
+
 	BOOL decodeTemplate(const U8* buffer, S32 buffer_size,  // inputs
 						LLMessageTemplate** msg_template ); // outputs
 
@@ -127,7 +132,7 @@ private:
 
 	S32	mReceiveSize;
 	LLMessageTemplate* mCurrentRMessageTemplate;
-	LLMsgData* mCurrentRMessageData;
+	LLTemplateMessageView mMessageView;
 	message_template_number_map_t& mMessageNumbers;
 };
 
@@ -0,0 +1,168 @@
+/** 
+ * @file lltemplatemessageview.cpp
+ * @brief Implementation of LLTemplateMessageView.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#include "linden_common.h"
+
+#include "lltemplatemessageview.h"
+
+#include "llmessagetemplate.h"
+
+LLTemplateMessageView::LLTemplateMessageView() :
+	mLayout(NULL)
+{
+	mData.reserve(MAX_BUFFER_SIZE);
+}
+
+void LLTemplateMessageView::reset(const LLMessageTemplateLayout* layout, const U8* buffer, S32 size)
+{
+	mLayout = layout;
+	// assign() and clear() keep the capacity from earlier packets
+	mData.assign(buffer, buffer + size);
+	mBlockFirst.assign(layout->mBlocks.size(), 0);
+	mBlockCount.assign(layout->mBlocks.size(), 0);
+	mInstances.clear();
+	mSlots.clear();
+}
+
+void LLTemplateMessageView::clear()
+{
+	mLayout = NULL;
+	mData.clear();
+	mInstances.clear();
+	mSlots.clear();
+}
+
+void LLTemplateMessageView::beginBlock(S32 block)
+{
+	mBlockFirst[block] = (S32)mInstances.size();
+	mBlockCount[block] = 0;
+}
+
+void LLTemplateMessageView::endBlock(S32 block)
+{
+	mBlockCount[block] = (S32)mInstances.size() - mBlockFirst[block];
+}
+
+void LLTemplateMessageView::addFixedInstance(S32 offset)
+{
+	Instance instance;
+	instance.mOffset = offset;
+	instance.mFirstSlot = -1;
+	mInstances.push_back(instance);
+}
+
+S32 LLTemplateMessageView::addInstance(S32 variable_count)
+{
+	Instance instance;
+	instance.mOffset = 0;
+	instance.mFirstSlot = (S32)mSlots.size();
+	mInstances.push_back(instance);
+
+	Slot empty;
+	empty.mOffset = 0;
+	empty.mSize = 0;
+	mSlots.resize(mSlots.size() + variable_count, empty);
+	return instance.mFirstSlot;
+}
+
+S32 LLTemplateMessageView::appendZeros(S32 size)
+{
+	S32 offset = (S32)mData.size();
+	mData.resize(mData.size() + size, 0);
+	return offset;
+}
+
+S32 LLTemplateMessageView::getNumberOfBlocks(S32 block) const
+{
+	if (!mLayout || block < 0 || block >= (S32)mBlockCount.size())
+	{
+		return 0;
+	}
+	return mBlockCount[block];
+}
+
+bool LLTemplateMessageView::getVariable(S32 block, S32 blocknum, S32 variable,
+										const U8*& data, S32& size) const
+{
+	if (blocknum < 0 || blocknum >= getNumberOfBlocks(block))
+	{
+		return false;
+	}
+
+	const Instance& instance = mInstances[mBlockFirst[block] + blocknum];
+	const LLMessageTemplateLayout::Variable& var = mLayout->mVariables[variable];
+	if (instance.mFirstSlot < 0)
+	{
+		size = var.mSize;
+		data = &mData[instance.mOffset + var.mOffset];
+	}
+	else
+	{
+		const Slot& slot = mSlots[instance.mFirstSlot + variable - mLayout->mBlocks[block].mFirstVariable];
+		size = slot.mSize;
+		data = size ? &mData[slot.mOffset] : NULL;
+	}
+	return true;
+}
+
+void LLTemplateMessageView::copyToMsgData(LLMsgData& msg_data) const
+{
+	if (!mLayout)
+	{
+		return;
+	}
+
+	for (S32 block = 0; block < (S32)mLayout->mBlocks.size(); ++block)
+	{
+		const LLMessageTemplateLayout::Block& layout_block = mLayout->mBlocks[block];
+		S32 count = mBlockCount[block];
+		for (S32 i = 0; i < count; ++i)
+		{
+			LLMsgBlkData* block_data = new LLMsgBlkData(layout_block.mName, count);
+			// later instances are keyed on name + index, see LLMsgData
+			block_data->mName = layout_block.mName + i;
+			msg_data.addBlock(block_data);
+
+			for (S32 var = layout_block.mFirstVariable;
+				 var < layout_block.mFirstVariable + layout_block.mVariableCount; ++var)
+			{
+				const LLMessageTemplateLayout::Variable& layout_var = mLayout->mVariables[var];
+				const U8* data = NULL;
+				S32 size = 0;
+				getVariable(block, i, var, data, size);
+				block_data->addVariable(layout_var.mName, layout_var.mType);
+				block_data->addData(layout_var.mName, data, size, layout_var.mType);
+			}
+		}
+	}
+}
@@ -0,0 +1,114 @@
+/** 
+ * @file lltemplatemessageview.h
+ * @brief Flat, index-addressed view over a decoded template message.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#ifndef LL_LLTEMPLATEMESSAGEVIEW_H
+#define LL_LLTEMPLATEMESSAGEVIEW_H
+
+#include <vector>
+
+#include "stdtypes.h"
+
+class LLMessageTemplateLayout;
+class LLMsgData;
+
+// Holds the result of decoding one template message as offsets into a
+// private copy of the packet, addressed by the block and variable indices
+// of an LLMessageTemplateLayout.  All storage is kept between packets, so
+// once the vectors have grown to fit the largest message seen, decoding
+// does not touch the heap at all.
+class LLTemplateMessageView
+{
+public:
+	LLTemplateMessageView();
+
+	// Starts a new message.  The packet bytes are copied so the view
+	// stays valid after the receive buffer is reused.
+	void reset(const LLMessageTemplateLayout* layout, const U8* buffer, S32 size);
+	void clear();
+
+	bool isValid() const						{ return mLayout != NULL; }
+	const LLMessageTemplateLayout* getLayout() const { return mLayout; }
+
+	// Decoding interface, used by LLTemplateMessageReader.  Instances of
+	// a block must be added between beginBlock() and endBlock().
+	void beginBlock(S32 block);
+	void endBlock(S32 block);
+	// An instance of a fixed size block which lies entirely inside the
+	// packet; variable offsets come straight from the layout.
+	void addFixedInstance(S32 offset);
+	// Any other instance.  Returns the first variable slot for it, to be
+	// filled in with setVariable().
+	S32 addInstance(S32 variable_count);
+	void setVariable(S32 slot, S32 offset, S32 size)
+	{
+		mSlots[slot].mOffset = offset;
+		mSlots[slot].mSize = size;
+	}
+	// Appends zero filled bytes to the copy of the packet, for fields
+	// which ran off the end of it.  Returns their offset.
+	S32 appendZeros(S32 size);
+
+	S32 getTotalBlockCount() const				{ return (S32)mInstances.size(); }
+	S32 getNumberOfBlocks(S32 block) const;
+
+	// variable is an index into LLMessageTemplateLayout::mVariables.
+	// Returns false if the block instance is not in the message.
+	bool getVariable(S32 block, S32 blocknum, S32 variable,
+					 const U8*& data, S32& size) const;
+
+	// Builds the old style tree representation, for consumers such as
+	// LLMessageBuilder::copyFromMessageData().
+	void copyToMsgData(LLMsgData& msg_data) const;
+
+private:
+	struct Instance
+	{
+		S32 mOffset;
+		S32 mFirstSlot;		// -1 for instances using the fixed layout
+	};
+
+	struct Slot
+	{
+		S32 mOffset;
+		S32 mSize;
+	};
+
+	const LLMessageTemplateLayout*	mLayout;
+	std::vector<U8>					mData;
+	std::vector<S32>				mBlockFirst;
+	std::vector<S32>				mBlockCount;
+	std::vector<Instance>			mInstances;
+	std::vector<Slot>				mSlots;
+};
+
+#endif // LL_LLTEMPLATEMESSAGEVIEW_H
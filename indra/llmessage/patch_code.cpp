@@ -236,7 +236,7 @@ void	decode_patch_group_header(LLBitPack &bitpack, LLGroupHeader *gopp)
 	gPatchSize = gopp->patch_size; 
 }
 
-void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph)
+void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph, S32 &wbits)
 {
 	U8 retvalu8;
 
@@ -285,13 +285,25 @@ void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph)
 #endif
 	ph->patchids = retvalu16;
 
-	gWordBits = (ph->quant_wbits & 0xf) + 2;
+	wbits = (ph->quant_wbits & 0xf) + 2;
+}
+
+void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph)
+{
+	S32 wbits = gWordBits;
+	decode_patch_header(bitpack, ph, wbits);
+	gWordBits = wbits;
 }
 
 void	decode_patch(LLBitPack &bitpack, S32 *patches)
+{
+	decode_patch(bitpack, patches, gPatchSize, gWordBits);
+}
+
+void	decode_patch(LLBitPack &bitpack, S32 *patches, S32 patch_size, S32 wbits)
 {
 #ifdef LL_BIG_ENDIAN
-	S32		i, j, patch_size = gPatchSize, wbits = gWordBits;
+	S32		i, j;
 	U8		tempu8;
 	U16		tempu16;
 	U32		tempu32;
@@ -364,7 +376,7 @@ void	decode_patch(LLBitPack &bitpack, S32 *patches)
 		}
 	}
 #else
-	S32		i, j, patch_size = gPatchSize, wbits = gWordBits;
+	S32		i, j;
 	U32		temp;
 	for (i = 0; i < patch_size*patch_size; i++)
 	{
@@ -50,4 +50,9 @@ void	decode_patch_group_header(LLBitPack &bitpack, LLGroupHeader *gopp);
 void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph);
 void	decode_patch(LLBitPack &bitpack, S32 *patches);
 
+// Reentrant versions of the above, which keep the word size in wbits
+// instead of in globals
+void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph, S32 &wbits);
+void	decode_patch(LLBitPack &bitpack, S32 *patches, S32 patch_size, S32 wbits);
+
 #endif
@@ -0,0 +1,338 @@
+/** 
+ * @file llpatchdecoder_test.cpp
+ * @brief LLPatchDecoder tests: exactness against decompress_patch() and region decode timing.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "../llpatchdecoder.h"
+
+#include "bitpack.h"
+#include "llmath.h"
+#include "lltaskscheduler.h"
+#include "lltimer.h"
+#include "../patch_code.h"
+#include "../patch_dct.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// A region as the viewer stores it: 256 meters of 1 meter grids plus
+	// the east and north buffer rows.
+	const S32 REGION_WIDTH = 256;
+	const S32 GRIDS_PER_EDGE = REGION_WIDTH + 1;
+	const S32 PATCHES_PER_PACKET = 4;	// about what fits in a LayerData packet
+	const S32 PACKET_BYTES = 4096;
+
+	struct LayerPacket
+	{
+		std::vector<U8> mData;
+		S32 mSize;
+	};
+	typedef std::vector<LayerPacket> packet_list_t;
+
+	void fill_terrain(std::vector<F32>& heights, S32 width, S32 stride)
+	{
+		heights.assign(stride * stride, 0.f);
+		for (S32 y = 0; y < width; ++y)
+		{
+			for (S32 x = 0; x < width; ++x)
+			{
+				F32 h = 20.f + 15.f * sinf(x * 0.031f) * cosf(y * 0.027f)
+						+ 3.f * sinf(x * 0.37f + y * 0.11f)
+						+ (F32)((x * 7 + y * 13) % 17) * 0.05f;
+				heights[y * stride + x] = h;
+			}
+		}
+	}
+
+	// Codes the land layer the way the simulator sends it, a few patches
+	// per packet, and returns the packets.
+	void record_layer_data(const std::vector<F32>& heights, S32 width, S32 stride, S32 patch_size,
+						   packet_list_t& packets)
+	{
+		S32 patches_per_edge = width / patch_size;
+		S32 cpatch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		init_patch_compressor(patch_size, stride, 0);
+
+		S32 count = 0;
+		LLBitPack* bitpack = NULL;
+		for (S32 j = 0; j < patches_per_edge; ++j)
+		{
+			for (S32 i = 0; i < patches_per_edge; ++i)
+			{
+				if (!bitpack)
+				{
+					packets.resize(packets.size() + 1);
+					packets.back().mData.resize(PACKET_BYTES);
+					bitpack = new LLBitPack(&packets.back().mData[0], PACKET_BYTES);
+					init_patch_coding(*bitpack);
+					LLGroupHeader gopp;
+					get_patch_group_header(&gopp);
+					code_patch_group_header(*bitpack, &gopp);
+				}
+
+				F32* patch = (F32*)&heights[j * patch_size * stride + i * patch_size];
+				LLPatchHeader ph;
+				F32 zmax, zmin;
+				prescan_patch(patch, &ph, zmax, zmin);
+				ph.patchids = (i << 5) | j;
+				compress_patch(patch, cpatch, &ph, 10);
+				code_patch_header(*bitpack, &ph, cpatch);
+				code_patch(*bitpack, cpatch, 0);
+
+				if (++count % PATCHES_PER_PACKET == 0 || (i == patches_per_edge - 1 && j == patches_per_edge - 1))
+				{
+					code_end_of_data(*bitpack);
+					packets.back().mSize = bitpack->flushBitPack();
+					delete bitpack;
+					bitpack = NULL;
+				}
+			}
+		}
+	}
+
+	// What LLSurface::decompressDCTPatch() did before LLPatchDecoder
+	void decode_region_serial(const packet_list_t& packets, std::vector<F32>& heights, S32 stride)
+	{
+		heights.assign(stride * stride, 0.f);
+		S32 cpatch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		for (U32 p = 0; p < packets.size(); ++p)
+		{
+			LLBitPack bitpack((U8*)&packets[p].mData[0], packets[p].mSize);
+			LLGroupHeader gopp;
+			decode_patch_group_header(bitpack, &gopp);
+			init_patch_decompressor(gopp.patch_size);
+			gopp.stride = stride;
+			set_group_of_patch_header(&gopp);
+
+			LLPatchHeader ph;
+			while (1)
+			{
+				decode_patch_header(bitpack, &ph);
+				if (ph.quant_wbits == END_OF_PATCHES)
+				{
+					break;
+				}
+				S32 i = ph.patchids >> 5;
+				S32 j = ph.patchids & 0x1F;
+				decode_patch(bitpack, cpatch);
+				decompress_patch(&heights[j * gopp.patch_size * stride + i * gopp.patch_size], cpatch, &ph);
+			}
+		}
+	}
+
+	// All packets read and decompressed as one batch by LLPatchDecoder
+	void decode_region_batched(const packet_list_t& packets, std::vector<F32>& heights, S32 stride)
+	{
+		heights.assign(stride * stride, 0.f);
+		LLPatchDecoder::packet_list_t batch;
+		for (U32 p = 0; p < packets.size(); ++p)
+		{
+			LLBitPack bitpack((U8*)&packets[p].mData[0], packets[p].mSize);
+			LLGroupHeader gopp;
+			decode_patch_group_header(bitpack, &gopp);
+			batch.push_back(LLPatchDecoder::Packet(bitpack, gopp.patch_size, stride));
+		}
+
+		LLPatchDecoder::readPackets(batch);
+		for (U32 p = 0; p < batch.size(); ++p)
+		{
+			S32 size = batch[p].mPatchSize;
+			for (U32 k = 0; k < batch[p].mPatches.size(); ++k)
+			{
+				LLPatchDecoder::Patch& patch = batch[p].mPatches[k];
+				S32 i = patch.mHeader.patchids >> 5;
+				S32 j = patch.mHeader.patchids & 0x1F;
+				patch.mDest = &heights[j * size * stride + i * size];
+			}
+		}
+		LLPatchDecoder::decompressPackets(batch);
+	}
+
+	void set_mode(bool vectorize, bool parallel)
+	{
+		LLPatchDecoder::setVectorize(vectorize);
+		LLPatchDecoder::setParallel(parallel);
+	}
+
+	bool same_bits(const std::vector<F32>& a, const std::vector<F32>& b)
+	{
+		return a.size() == b.size() && !memcmp(&a[0], &b[0], a.size() * sizeof(F32));
+	}
+}
+
+namespace tut
+{
+	struct LLPatchDecoderTest
+	{
+		LLPatchDecoderTest()
+		{
+			LLTaskScheduler::initClass(3);
+			LLPatchDecoder::initClass();
+		}
+
+		~LLPatchDecoderTest()
+		{
+			LLPatchDecoder::cleanupClass();
+			LLTaskScheduler::cleanupClass();
+			LLPatchDecoder::setVectorize(false);
+		}
+	};
+	typedef test_group<LLPatchDecoderTest> LLPatchDecoderTest_t;
+	typedef LLPatchDecoderTest_t::object LLPatchDecoderTest_object_t;
+	tut::LLPatchDecoderTest_t tut_LLPatchDecoderTest("LLPatchDecoder");
+
+	template<> template<>
+	void LLPatchDecoderTest_object_t::test<1>()
+		// the scalar batch matches decompress_patch() bit for bit
+	{
+		std::vector<F32> terrain;
+		fill_terrain(terrain, REGION_WIDTH, GRIDS_PER_EDGE);
+		packet_list_t packets;
+		record_layer_data(terrain, REGION_WIDTH, GRIDS_PER_EDGE, NORMAL_PATCH_SIZE, packets);
+		ensure("packets recorded", packets.size() == 256 / PATCHES_PER_PACKET);
+
+		std::vector<F32> expected, actual;
+		decode_region_serial(packets, expected, GRIDS_PER_EDGE);
+		set_mode(false, false);
+		decode_region_batched(packets, actual, GRIDS_PER_EDGE);
+		ensure("scalar batch", same_bits(expected, actual));
+
+		// and the codec itself is sane
+		F32 max_error = 0.f;
+		for (S32 y = 0; y < REGION_WIDTH; ++y)
+		{
+			for (S32 x = 0; x < REGION_WIDTH; ++x)
+			{
+				S32 k = y * GRIDS_PER_EDGE + x;
+				max_error = llmax(max_error, fabsf(expected[k] - terrain[k]));
+			}
+		}
+		ensure("decoded terrain close to the original", max_error < 1.f);
+	}
+
+	template<> template<>
+	void LLPatchDecoderTest_object_t::test<2>()
+		// SSE2 and threaded decodes match the scalar one, for both patch sizes
+	{
+		std::vector<F32> terrain;
+		fill_terrain(terrain, REGION_WIDTH, GRIDS_PER_EDGE);
+		const S32 sizes[] = { NORMAL_PATCH_SIZE, LARGE_PATCH_SIZE };
+		for (S32 s = 0; s < 2; ++s)
+		{
+			packet_list_t packets;
+			record_layer_data(terrain, REGION_WIDTH, GRIDS_PER_EDGE, sizes[s], packets);
+
+			std::vector<F32> expected, actual;
+			decode_region_serial(packets, expected, GRIDS_PER_EDGE);
+
+			set_mode(false, true);
+			decode_region_batched(packets, actual, GRIDS_PER_EDGE);
+			ensure(llformat("threaded scalar, size %d", sizes[s]), same_bits(expected, actual));
+
+			set_mode(true, false);
+			if (LLPatchDecoder::getVectorize())
+			{
+				decode_region_batched(packets, actual, GRIDS_PER_EDGE);
+				ensure(llformat("SSE2, size %d", sizes[s]), same_bits(expected, actual) || !LL_SSE2_MATH);
+
+				set_mode(true, true);
+				std::vector<F32> threaded;
+				decode_region_batched(packets, threaded, GRIDS_PER_EDGE);
+				ensure(llformat("threaded SSE2, size %d", sizes[s]), same_bits(actual, threaded));
+			}
+		}
+	}
+
+	template<> template<>
+	void LLPatchDecoderTest_object_t::test<3>()
+		// a patch sent twice in one batch decodes as the last copy
+	{
+		std::vector<F32> first, second;
+		fill_terrain(first, REGION_WIDTH, GRIDS_PER_EDGE);
+		fill_terrain(second, REGION_WIDTH, GRIDS_PER_EDGE);
+		for (U32 k = 0; k < second.size(); ++k)
+		{
+			second[k] += 5.f;
+		}
+		packet_list_t packets;
+		record_layer_data(first, REGION_WIDTH, GRIDS_PER_EDGE, NORMAL_PATCH_SIZE, packets);
+		record_layer_data(second, REGION_WIDTH, GRIDS_PER_EDGE, NORMAL_PATCH_SIZE, packets);
+
+		std::vector<F32> expected, actual;
+		decode_region_serial(packets, expected, GRIDS_PER_EDGE);
+		set_mode(true, true);
+		decode_region_batched(packets, actual, GRIDS_PER_EDGE);
+		ensure("last copy wins", same_bits(expected, actual) || !LL_SSE2_MATH);
+	}
+
+	template<> template<>
+	void LLPatchDecoderTest_object_t::test<4>()
+		// benchmark: decode of a full region from its LayerData packets
+	{
+		const S32 ITERATIONS = 50;
+		std::vector<F32> terrain, heights;
+		fill_terrain(terrain, REGION_WIDTH, GRIDS_PER_EDGE);
+		packet_list_t packets;
+		record_layer_data(terrain, REGION_WIDTH, GRIDS_PER_EDGE, NORMAL_PATCH_SIZE, packets);
+
+		LLTimer timer;
+		for (S32 i = 0; i < ITERATIONS; ++i)
+		{
+			decode_region_serial(packets, heights, GRIDS_PER_EDGE);
+		}
+		F32 ms = 1000.f / ITERATIONS;
+		llinfos << "LLPatchDecoder: " << packets.size() << " packets, 256x256 region, serial decompress_patch "
+				<< timer.getElapsedTimeF32() * ms << " ms" << llendl;
+
+		const char* names[] = { "scalar", "threaded scalar", "SSE2", "SSE2 threaded" };
+		for (S32 mode = 0; mode < 4; ++mode)
+		{
+			set_mode(mode >= 2, mode & 1);
+			if (mode >= 2 && !LLPatchDecoder::getVectorize())
+			{
+				llinfos << "LLPatchDecoder: SSE2 kernels unavailable, skipping" << llendl;
+				break;
+			}
+
+			timer.reset();
+			for (S32 i = 0; i < ITERATIONS; ++i)
+			{
+				decode_region_batched(packets, heights, GRIDS_PER_EDGE);
+			}
+			llinfos << "LLPatchDecoder: batched " << names[mode] << " "
+					<< timer.getElapsedTimeF32() * ms << " ms" << llendl;
+		}
+	}
+}
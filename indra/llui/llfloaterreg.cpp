@@ -39,6 +39,8 @@
 #include "llfloater.h"
 #include "llmultifloater.h"
 #include "llfloaterreglistener.h"
+#include "lltimer.h"
+#include "lluictrlfactory.h"
 
 //*******************************************************
 
@@ -406,6 +408,56 @@ void LLFloaterReg::registerControlVariables()
 	}
 }
 
+//static
+void LLFloaterReg::benchmarkXUILoad(S32 passes)
+{
+	passes = llmax(passes, 1);
+
+	// several floaters share a file
+	std::set<std::string> filenames;
+	for (build_map_t::iterator iter = sBuildMap.begin(); iter != sBuildMap.end(); ++iter)
+	{
+		if (!iter->second.mFile.empty())
+		{
+			filenames.insert(iter->second.mFile);
+		}
+	}
+
+	bool use_compiled = LLUICtrlFactory::getUseCompiledXUI();
+	F64 total_xml = 0.0;
+	F64 total_compiled = 0.0;
+	LLTimer timer;
+	for (std::set<std::string>::iterator iter = filenames.begin(); iter != filenames.end(); ++iter)
+	{
+		LLXMLNodePtr root;
+
+		LLUICtrlFactory::setUseCompiledXUI(false);
+		timer.reset();
+		for (S32 i = 0; i < passes; ++i)
+		{
+			LLUICtrlFactory::getLayeredXMLNode(*iter, root);
+		}
+		F64 xml_time = timer.getElapsedTimeF64() / passes;
+
+		LLUICtrlFactory::setUseCompiledXUI(true);
+		timer.reset();
+		for (S32 i = 0; i < passes; ++i)
+		{
+			LLUICtrlFactory::getLayeredXMLNode(*iter, root);
+		}
+		F64 compiled_time = timer.getElapsedTimeF64() / passes;
+
+		llinfos << *iter << ": xml " << xml_time * 1000.0 << " ms, compiled "
+				<< compiled_time * 1000.0 << " ms" << llendl;
+		total_xml += xml_time;
+		total_compiled += compiled_time;
+	}
+	LLUICtrlFactory::setUseCompiledXUI(use_compiled);
+
+	llinfos << "Loaded " << filenames.size() << " floater files, " << passes << " passes: xml "
+			<< total_xml * 1000.0 << " ms, compiled " << total_compiled * 1000.0 << " ms" << llendl;
+}
+
 // Callbacks
 
 // static
@@ -129,6 +129,10 @@ public:
 
 	static void registerControlVariables();
 
+	// Time loading the XUI of every registered floater, as XML and from the
+	// compiled binaries, and log the results
+	static void benchmarkXUILoad(S32 passes);
+
 	// Callback wrappers
 	static void initUICtrlToFloaterVisibilityControl(LLUICtrl* ctrl, const LLSD& sdname);
 	static void showFloaterInstance(const LLSD& sdname);
@@ -155,9 +155,175 @@ static LLFastTimer::DeclareTimer FTM_XML_PARSE("XML Reading/Parsing");
 bool LLUICtrlFactory::getLayeredXMLNode(const std::string &xui_filename, LLXMLNodePtr& root)
 {
 	LLFastTimer timer(FTM_XML_PARSE);
+	if (sUseCompiledXUI && getCompiledXMLNode(xui_filename, root))
+	{
+		return true;
+	}
 	return LLXMLNode::getLayeredXMLNode(xui_filename, root, LLUI::getXUIPaths());
 }
 
+// static
+bool LLUICtrlFactory::sUseCompiledXUI = true;
+
+static std::string get_compiled_xui_filename(const std::string& xui_filename)
+{
+	return xui_filename + ".bin";
+}
+
+// Names a layer file by the skin root findSkinnedFilename() found it in
+// and its path below that root, e.g. "default:xui/en/floater_about.xml".
+// Unlike the full path this is the same on the machine that compiled the
+// XUI and on the one loading it.  The default skin comes before the
+// current one so files from it get the same id whichever skin is chosen.
+static std::string get_xui_layer_id(const std::string& layer_filename)
+{
+	const std::string& delim = gDirUtilp->getDirDelimiter();
+	const std::string roots[] = { gDirUtilp->getUserSkinDir(), gDirUtilp->getDefaultSkinDir(), gDirUtilp->getSkinDir() };
+	const char* root_names[] = { "user", "default", "skin" };
+	for (U32 i = 0; i < LL_ARRAY_SIZE(roots); ++i)
+	{
+		const std::string& root = roots[i];
+		if (!root.empty()
+			&& layer_filename.size() > root.size() + delim.size()
+			&& layer_filename.compare(0, root.size(), root) == 0
+			&& layer_filename.compare(root.size(), delim.size(), delim) == 0)
+		{
+			std::string layer_id = layer_filename.substr(root.size() + delim.size());
+			if (delim != "/")
+			{
+				LLStringUtil::replaceString(layer_id, delim, "/");
+			}
+			return std::string(root_names[i]) + ":" + layer_id;
+		}
+	}
+	// outside the skins, never matches a compiled file
+	return layer_filename;
+}
+
+// The layers LLXMLNode::getLayeredXMLNode() merges, base first, as full
+// paths and as the ids stored with the compiled file
+static void get_xui_layer_files(const std::string& xui_filename, std::vector<std::string>& layer_files,
+								std::vector<std::string>& layer_ids)
+{
+	const std::vector<std::string>& paths = LLUI::getXUIPaths();
+	for (std::vector<std::string>::const_iterator it = paths.begin(); it != paths.end(); ++it)
+	{
+		std::string layer_filename = gDirUtilp->findSkinnedFilename(*it, xui_filename);
+		if (!layer_filename.empty())
+		{
+			layer_files.push_back(layer_filename);
+			layer_ids.push_back(get_xui_layer_id(layer_filename));
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// getCompiledXMLNode()
+//-----------------------------------------------------------------------------
+bool LLUICtrlFactory::getCompiledXMLNode(const std::string &xui_filename, LLXMLNodePtr& root)
+{
+	const std::vector<std::string>& paths = LLUI::getXUIPaths();
+	if (paths.empty())
+	{
+		return false;
+	}
+
+	std::string compiled_filename = gDirUtilp->findSkinnedFilename(paths.back(), get_compiled_xui_filename(xui_filename));
+	llstat compiled_stat;
+	if (compiled_filename.empty() || LLFile::stat(compiled_filename, &compiled_stat))
+	{
+		return false;
+	}
+
+	// any layer edited since the compile wins
+	std::vector<std::string> layer_files;
+	std::vector<std::string> layer_ids;
+	get_xui_layer_files(xui_filename, layer_files, layer_ids);
+	for (std::vector<std::string>::iterator it = layer_files.begin(); it != layer_files.end(); ++it)
+	{
+		llstat layer_stat;
+		if (LLFile::stat(*it, &layer_stat) || layer_stat.st_mtime > compiled_stat.st_mtime)
+		{
+			LL_DEBUGS("XUI") << "Compiled XUI out of date, using " << *it << LL_ENDL;
+			return false;
+		}
+	}
+
+	LLXMLNodePtr compiled_root;
+	std::vector<std::string> sources;
+	if (!LLXMLNode::parseBinaryFile(compiled_filename, compiled_root, &sources))
+	{
+		return false;
+	}
+
+	// a skin override added since the compile changes which files get merged
+	if (sources != layer_ids)
+	{
+		LL_DEBUGS("XUI") << "Compiled XUI layers differ, not using " << compiled_filename << LL_ENDL;
+		return false;
+	}
+
+	root = compiled_root;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// compileXUIFiles()
+//-----------------------------------------------------------------------------
+S32 LLUICtrlFactory::compileXUIFiles()
+{
+	const std::vector<std::string>& paths = LLUI::getXUIPaths();
+	if (paths.empty())
+	{
+		return 0;
+	}
+
+	const std::string& delim = gDirUtilp->getDirDelimiter();
+	std::string base_dir = gDirUtilp->getDefaultSkinDir() + delim + paths.front();
+	std::string output_dir = gDirUtilp->getSkinDir() + delim + paths.back();
+
+	// top level floaters, panels and menus, plus the widget templates
+	std::vector<std::string> xui_filenames;
+	const std::string subdirs[] = { "", "widgets" };
+	for (U32 i = 0; i < LL_ARRAY_SIZE(subdirs); ++i)
+	{
+		std::string dir = subdirs[i].empty() ? base_dir : base_dir + delim + subdirs[i];
+		std::string filename;
+		while (gDirUtilp->getNextFileInDir(dir, delim + "*.xml", filename, FALSE))
+		{
+			xui_filenames.push_back(subdirs[i].empty() ? filename : subdirs[i] + delim + filename);
+		}
+		if (!subdirs[i].empty())
+		{
+			// fails harmlessly if it already exists
+			LLFile::mkdir(output_dir + delim + subdirs[i]);
+		}
+	}
+
+	S32 num_compiled = 0;
+	for (std::vector<std::string>::iterator it = xui_filenames.begin(); it != xui_filenames.end(); ++it)
+	{
+		LLXMLNodePtr root;
+		if (!LLXMLNode::getLayeredXMLNode(*it, root, paths))
+		{
+			llwarns << "Unable to compile XUI file " << *it << llendl;
+			continue;
+		}
+
+		std::vector<std::string> layer_files;
+		std::vector<std::string> layer_ids;
+		get_xui_layer_files(*it, layer_files, layer_ids);
+		if (root->writeBinaryFile(output_dir + delim + get_compiled_xui_filename(*it), layer_ids))
+		{
+			++num_compiled;
+		}
+	}
+
+	llinfos << "Compiled " << num_compiled << " of " << xui_filenames.size()
+			<< " XUI files into " << output_dir << llendl;
+	return num_compiled;
+}
+
 
 //-----------------------------------------------------------------------------
 // getLocalizedXMLNode()
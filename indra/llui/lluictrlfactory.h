@@ -327,7 +327,17 @@ fail:
 
 	static void createChildren(LLView* viewp, LLXMLNodePtr node, const widget_registry_t&, LLXMLNodePtr output_node = NULL);
 
+	// Uses the compiled form of the merged layers when there is one and
+	// none of the layer files is newer, otherwise parses the XML.
 	static bool getLayeredXMLNode(const std::string &filename, LLXMLNodePtr& root);
+
+	// Merge every XUI file for the current language and write the binary
+	// form next to the localized files, see LLXMLNode::writeBinaryFile().
+	// Returns the number of files written.
+	static S32 compileXUIFiles();
+
+	static void setUseCompiledXUI(bool use_compiled) { sUseCompiledXUI = use_compiled; }
+	static bool getUseCompiledXUI() { return sUseCompiledXUI; }
 	
 	static bool getLocalizedXMLNode(const std::string &xui_filename, LLXMLNodePtr& root);
 
@@ -348,6 +358,10 @@ private:
 	// Avoid directly using LLUI and LLDir in the template code
 	static std::string findSkinnedFilename(const std::string& filename);
 
+	static bool getCompiledXMLNode(const std::string &xui_filename, LLXMLNodePtr& root);
+
+	static bool sUseCompiledXUI;
+
 	typedef std::deque<const LLCallbackMap::map_t*> factory_stack_t;
 	factory_stack_t					mFactoryStack;
 
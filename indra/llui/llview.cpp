@@ -63,6 +63,7 @@ bool	LLView::sDebugRects = false;
 bool	LLView::sDebugRectsShowNames = true;
 bool	LLView::sDebugKeys = false;
 bool	LLView::sDebugMouseHandling = false;
+bool	LLView::sDebugChildLookups = false;
 std::string LLView::sMouseHandlerMessage;
 BOOL	LLView::sForceReshape = FALSE;
 std::set<LLView*> LLView::sPreviewHighlightedElements;
@@ -140,7 +141,10 @@ LLView::LLView(const LLView::Params& p)
 	mDefaultTabGroup(p.default_tab_group),
 	mLastTabGroup(0),
 	mToolTipMsg((LLStringExplicit)p.tool_tip()),
-	mDefaultWidgets(NULL)
+	mDefaultWidgets(NULL),
+	mChildViewCache(NULL),
+	mChildViewCacheGeneration(0),
+	mTreeGeneration(0)
 {
 	// create rect first, as this will supply initial follows flags
 	setShape(p.rect);
@@ -179,6 +183,9 @@ LLView::~LLView()
 		delete mDefaultWidgets;
 		mDefaultWidgets = NULL;
 	}
+
+	delete mChildViewCache;
+	mChildViewCache = NULL;
 }
 
 // virtual
@@ -236,6 +243,48 @@ std::string LLView::getName() const
 	return mName.empty() ? std::string("(no name)") : mName;
 }
 
+void LLView::setName(std::string name)
+{
+	if (mParentView)
+	{
+		mParentView->removeChildName(this);
+		mName = name;
+		mParentView->addChildName(this);
+		mParentView->dirtyChildTree();
+	}
+	else
+	{
+		mName = name;
+	}
+}
+
+void LLView::addChildName(LLView* child)
+{
+	mChildNameMap.insert(child_name_map_t::value_type(child->getName(), child));
+}
+
+void LLView::removeChildName(LLView* child)
+{
+	std::pair<child_name_map_t::iterator, child_name_map_t::iterator> found = mChildNameMap.equal_range(child->getName());
+	for (child_name_map_t::iterator it = found.first; it != found.second; ++it)
+	{
+		if (it->second == child)
+		{
+			mChildNameMap.erase(it);
+			return;
+		}
+	}
+}
+
+// Invalidates the cached lookups of this view and all its ancestors.
+void LLView::dirtyChildTree()
+{
+	for (LLView* viewp = this; viewp; viewp = viewp->mParentView)
+	{
+		++viewp->mTreeGeneration;
+	}
+}
+
 void LLView::sendChildToFront(LLView* child)
 {
 // 	llassert_always(sDepth == 0); // Avoid re-ordering while drawing; it can cause subtle iterator bugs
@@ -247,6 +296,7 @@ void LLView::sendChildToFront(LLView* child)
 		{
 			mChildList.remove( child );
 			mChildList.push_front(child);
+			dirtyChildTree();
 		}
 	}
 }
@@ -262,6 +312,7 @@ void LLView::sendChildToBack(LLView* child)
 		{
 			mChildList.remove( child );
 			mChildList.push_back(child);
+			dirtyChildTree();
 		}
 	}
 }
@@ -302,6 +353,8 @@ bool LLView::addChild(LLView* child, S32 tab_group)
 
 	// add to front of child list, as normal
 	mChildList.push_front(child);
+	addChildName(child);
+	dirtyChildTree();
 
 	// add to ctrl list if is LLUICtrl
 	if (child->isCtrl())
@@ -338,6 +391,8 @@ void LLView::removeChild(LLView* child)
 	if (child->mParentView == this) 
 	{
 		mChildList.remove( child );
+		removeChildName(child);
+		dirtyChildTree();
 		child->mParentView = NULL;
 		if (child->isCtrl())
 		{
@@ -1708,6 +1763,10 @@ LLView* LLView::getChildView(const std::string& name, BOOL recurse) const
 
 static LLFastTimer::DeclareTimer FTM_FIND_VIEWS("Find Widgets");
 
+// Lookups of the same child between changes to the view tree that
+// sDebugChildLookups reports
+static const U32 HOT_CHILD_LOOKUPS = 1000;
+
 LLView* LLView::findChildView(const std::string& name, BOOL recurse) const
 {
 	LLFastTimer ft(FTM_FIND_VIEWS);
@@ -1716,17 +1775,47 @@ LLView* LLView::findChildView(const std::string& name, BOOL recurse) const
 	//	return NULL;
 	child_list_const_iter_t child_it;
 	// Look for direct children *first*
-	for ( child_it = mChildList.begin(); child_it != mChildList.end(); ++child_it)
+	std::pair<child_name_map_t::const_iterator, child_name_map_t::const_iterator> found = mChildNameMap.equal_range(name);
+	if (found.first != found.second)
 	{
-		LLView* childp = *child_it;
-		llassert(childp);
-		if (childp->getName() == name)
+		child_name_map_t::const_iterator next_it = found.first;
+		if (++next_it == found.second)
+		{
+			return found.first->second;
+		}
+
+		// Several children share the name, the frontmost one wins.
+		for ( child_it = mChildList.begin(); child_it != mChildList.end(); ++child_it)
 		{
-			return childp;
+			LLView* childp = *child_it;
+			llassert(childp);
+			if (childp->getName() == name)
+			{
+				return childp;
+			}
 		}
 	}
-	if (recurse)
+	if (recurse && !mChildList.empty())
 	{
+		if (mChildViewCache)
+		{
+			if (mChildViewCacheGeneration != mTreeGeneration)
+			{
+				mChildViewCache->clear();
+				mChildViewCacheGeneration = mTreeGeneration;
+			}
+			child_view_cache_t::iterator cached_it = mChildViewCache->find(name);
+			if (cached_it != mChildViewCache->end())
+			{
+				if (sDebugChildLookups && (++cached_it->second.mLookups == HOT_CHILD_LOOKUPS))
+				{
+					llwarns << "Child " << name << " of " << getName() << " looked up "
+							<< HOT_CHILD_LOOKUPS << " times, consider keeping a pointer to it" << llendl;
+				}
+				return cached_it->second.mView;
+			}
+		}
+
 		// Look inside each child as well.
 		for ( child_it = mChildList.begin(); child_it != mChildList.end(); ++child_it)
 		{
@@ -1735,6 +1824,20 @@ LLView* LLView::findChildView(const std::string& name, BOOL recurse) const
 			LLView* viewp = childp->findChildView(name, recurse);
 			if ( viewp )
 			{
+				// Views found through other links, like menu branches,
+				// aren't in this subtree so changes to them would go
+				// unnoticed.
+				if (viewp->hasAncestor(this))
+				{
+					if (!mChildViewCache)
+					{
+						mChildViewCache = new child_view_cache_t;
+						mChildViewCacheGeneration = mTreeGeneration;
+					}
+					CachedChildView& cached = (*mChildViewCache)[name];
+					cached.mView = viewp;
+					cached.mLookups = 0;
+				}
 				return viewp;
 			}
 		}
@@ -56,6 +56,7 @@
 #include "llfocusmgr.h"
 
 #include <list>
+#include <map>
 
 class LLSD;
 
@@ -244,7 +245,7 @@ public:
 	void		setFollowsAll()					{ mReshapeFlags |= FOLLOWS_ALL; }
 
 	void        setSoundFlags(U8 flags)			{ mSoundFlags = flags; }
-	void		setName(std::string name)			{ mName = name; }
+	void		setName(std::string name);
 	void		setUseBoundingRect( BOOL use_bounding_rect );
 	BOOL		getUseBoundingRect();
 
@@ -344,7 +345,7 @@ public:
 	LLView*		findPrevSibling(LLView* child);
 	LLView*		findNextSibling(LLView* child);
 	S32			getChildCount()	const			{ return (S32)mChildList.size(); }
-	template<class _Pr3> void sortChildren(_Pr3 _Pred) { mChildList.sort(_Pred); }
+	template<class _Pr3> void sortChildren(_Pr3 _Pred) { mChildList.sort(_Pred); dirtyChildTree(); }
 	BOOL		hasAncestor(const LLView* parentp) const;
 	BOOL		hasChild(const std::string& childname, BOOL recurse = FALSE) const;
 	BOOL 		childHasKeyboardFocus( const std::string& childname ) const;
@@ -467,6 +468,8 @@ public:
 	}
 
 	virtual LLView* getChildView(const std::string& name, BOOL recurse = TRUE) const;
+	// Direct children are found by name from an index, deeper ones are
+	// remembered until something in this view's subtree changes.
 	virtual LLView* findChildView(const std::string& name, BOOL recurse = TRUE) const;
 
 	template <class T> T* getDefaultWidget(const std::string& name) const
@@ -556,6 +559,26 @@ private:
 	LLView*		mParentView;
 	child_list_t mChildList;
 
+	// Lookups by name, see findChildView().  mChildNameMap indexes the
+	// direct children by getName().  mChildViewCache holds descendants
+	// already found by recursive lookups, and is thrown away whenever
+	// mTreeGeneration moves on, which it does when a view in the subtree
+	// is added, removed, renamed or reordered.
+	typedef std::multimap<std::string, LLView*> child_name_map_t;
+	struct CachedChildView
+	{
+		LLView*	mView;
+		U32		mLookups;
+	};
+	typedef std::map<std::string, CachedChildView> child_view_cache_t;
+	void		addChildName(LLView* child);
+	void		removeChildName(LLView* child);
+	void		dirtyChildTree();
+	child_name_map_t mChildNameMap;
+	mutable child_view_cache_t* mChildViewCache;
+	mutable U32	mChildViewCacheGeneration;
+	U32			mTreeGeneration;
+
 	std::string	mName;
 	// location in pixels, relative to surrounding structure, bottom,left=0,0
 	LLRect		mRect;
@@ -607,6 +630,10 @@ public:
 
 	static bool sDebugKeys;
 	static bool sDebugMouseHandling;
+
+	// Warn about children looked up by name over and over, which
+	// should be kept in member pointers instead.
+	static bool sDebugChildLookups;
 	static std::string sMouseHandlerMessage;
 	static S32	sSelectID;
 	static std::set<LLView*> sPreviewHighlightedElements;	// DEV-16869
@@ -0,0 +1,205 @@
+/** 
+ * @file llview_test.cpp
+ * @brief LLView child lookup tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "../llview.h"
+
+#include "lltut.h"
+
+namespace
+{
+	class TestView : public LLView
+	{
+	public:
+		TestView(const LLView::Params& p) : LLView(p) {}
+	};
+
+	LLView* make_view(const std::string& name, LLView* parent = NULL)
+	{
+		LLView::Params p;
+		p.name(name);
+		p.rect(LLRect(0, 10, 10, 0));
+		LLView* view = new TestView(p);
+		if (parent)
+		{
+			parent->addChild(view);
+		}
+		return view;
+	}
+
+	struct CompareByName
+	{
+		bool operator()(const LLView* a, const LLView* b) const
+		{
+			return a->getName() < b->getName();
+		}
+	};
+}
+
+namespace tut
+{
+	// root
+	//   branch
+	//     p2 (front)
+	//       x2 "target"
+	//     p1
+	//       x1 "target"
+	//
+	// Every test first looks up "target" from the root, which caches x2,
+	// then changes the tree below the root and looks it up again.
+	struct LLViewData
+	{
+		LLViewData()
+		{
+			mRoot = make_view("root");
+			mBranch = make_view("branch", mRoot);
+			mP1 = make_view("p1", mBranch);
+			mX1 = make_view("target", mP1);
+			mP2 = make_view("p2", mBranch);
+			mX2 = make_view("target", mP2);
+		}
+		~LLViewData()
+		{
+			delete mRoot;
+		}
+
+		LLView* lookup()
+		{
+			return mRoot->findChildView("target", TRUE);
+		}
+
+		LLView* mRoot;
+		LLView* mBranch;
+		LLView* mP1;
+		LLView* mX1;
+		LLView* mP2;
+		LLView* mX2;
+	};
+
+	typedef test_group<LLViewData> factory;
+	typedef factory::object object;
+}
+
+namespace
+{
+	tut::factory tf("LLView");
+}
+
+namespace tut
+{
+	template<> template<>
+	void object::test<1>()
+	{
+		// the frontmost match wins, and a repeated lookup agrees
+		ensure("frontmost match", lookup() == mX2);
+		ensure("cached match", lookup() == mX2);
+		ensure("direct child", mRoot->findChildView("branch", FALSE) == mBranch);
+		ensure("not recursive", mRoot->findChildView("target", FALSE) == NULL);
+		ensure("missing", mRoot->findChildView("missing", TRUE) == NULL);
+	}
+
+	template<> template<>
+	void object::test<2>()
+	{
+		// addChild() anywhere below the root
+		ensure("before", lookup() == mX2);
+		LLView* front = make_view("target", mP2);
+		ensure("added in front of the cached view", lookup() == front);
+
+		LLView* deeper = make_view("p0", mBranch);
+		LLView* x0 = make_view("target", make_view("q0", deeper));
+		ensure("added a new front branch", lookup() == x0);
+
+		// failed lookups don't stick either
+		ensure("missing", mRoot->findChildView("late", TRUE) == NULL);
+		LLView* late = make_view("late", mX1);
+		ensure("found once added", mRoot->findChildView("late", TRUE) == late);
+	}
+
+	template<> template<>
+	void object::test<3>()
+	{
+		// removeChild() of the cached view, and of its branch
+		ensure("before", lookup() == mX2);
+		mP2->removeChild(mX2);
+		ensure("removed view not returned", lookup() == mX1);
+		delete mX2;
+
+		mBranch->removeChild(mP1);
+		ensure("removed branch not returned", lookup() == NULL);
+		delete mP1;
+	}
+
+	template<> template<>
+	void object::test<4>()
+	{
+		// setName() of the cached view and of another one
+		ensure("before", lookup() == mX2);
+		mX2->setName("renamed");
+		ensure("renamed away", lookup() == mX1);
+		ensure("found by the new name", mRoot->findChildView("renamed", TRUE) == mX2);
+		mX2->setName("target");
+		ensure("renamed back", lookup() == mX2);
+		mX2->setName("renamed");
+		mX1->setName("renamed too");
+		ensure("nothing left by that name", lookup() == NULL);
+	}
+
+	template<> template<>
+	void object::test<5>()
+	{
+		// sendChildToBack() and sendChildToFront() below the root
+		ensure("before", lookup() == mX2);
+		mBranch->sendChildToBack(mP2);
+		ensure("sent to back", lookup() == mX1);
+		mBranch->sendChildToFront(mP2);
+		ensure("sent to front", lookup() == mX2);
+		mBranch->sendChildToFront(mP1);
+		ensure("other sent to front", lookup() == mX1);
+	}
+
+	template<> template<>
+	void object::test<6>()
+	{
+		// sortChildren() below the root
+		ensure("before", lookup() == mX2);
+		mBranch->sortChildren(CompareByName());
+		ensure("p1 sorted first", lookup() == mX1);
+		mP1->setName("p3");
+		ensure("renamed, not yet sorted", lookup() == mX1);
+		mBranch->sortChildren(CompareByName());
+		ensure("p2 sorted first", lookup() == mX2);
+	}
+}
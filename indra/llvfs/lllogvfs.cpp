@@ -0,0 +1,1843 @@
+/** 
+ * @file lllogvfs.cpp
+ * @brief Log-structured LLVFS backend.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "lllogvfs.h"
+
+#include <algorithm>
+
+#if LL_WINDOWS
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include "llapr.h"
+#include "llcrc.h"
+#include "lldir.h"
+#include "llfile.h"
+
+// defined in llvfs.cpp
+std::string get_extension(LLAssetType::EType type);
+
+static const U32 LOG_MAGIC = 0x4c4f474c;	// "LGOL"
+static const U32 RECORD_MAGIC = 0x5243524c;	// "LRCR"
+static const U32 INDEX_MAGIC = 0x5844494c;	// "LIDX"
+static const U32 LOG_VERSION = 1;
+static const U32 SEGMENT_HEADER_SIZE = 64;
+static const U32 RECORD_ALIGN = 8;
+static const U32 MIN_SEGMENT_SIZE = 64 * 1024;
+static const S32 NUM_STRIPES = 16;
+// Free segments held back from ordinary writes.  Cleaning may use the
+// last one, since it has to copy live data forward before it can free
+// anything.
+static const S32 RESERVED_SEGMENTS = 2;
+
+const S32 FILE_BLOCK_MASK = 0x000003FF;	// round reservations like LLVFS
+const S32 VFS_CLEANUP_SIZE = 5242880;	// how much space we free up in a single stroke
+const S32 BLOCK_LENGTH_INVALID = -1;	// mMaxSize of removed files
+
+static const std::string DATA_FILE_NAME("data");
+static const std::string INDEX_FILE_NAME("index");
+
+struct LLLogVFSSegmentHeader
+{
+	U32 mMagic;
+	U32 mVersion;
+	U32 mSeq;
+	U32 mSegmentSize;
+	U32 mNumSegments;
+};
+
+struct LLLogVFSRecordHeader
+{
+	U32 mMagic;
+	U32 mSeq;			// of the segment, so stale records from its last use are not replayed
+	U32 mType;
+	S32 mFileType;
+	U8 mFileID[UUID_BYTES];
+	S32 mLocation;		// data: offset in the file
+	S32 mLength;		// bytes of data following the header
+	S32 mMaxSize;		// data and reserve: reserved size of the file
+	U8 mNewID[UUID_BYTES];
+	S32 mNewType;
+	U32 mCRC;			// of the data, then the header with mCRC 0
+};
+
+static U32 record_size(S32 length)
+{
+	return (sizeof(LLLogVFSRecordHeader) + (U32)length + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+}
+
+//----------------------------------------------------------------------------
+// Positional reads and writes, safe from several threads at once.
+
+class LLLogVFSDataFile
+{
+public:
+	LLLogVFSDataFile();
+	~LLLogVFSDataFile();
+
+	bool open(const std::string& filename, bool read_only);
+	void close();
+	bool read(U64 offset, void* buffer, U32 size);
+	bool write(U64 offset, const void* buffer, U32 size);
+
+private:
+#if LL_WINDOWS
+	HANDLE mFile;
+#else
+	int mFD;
+#endif
+};
+
+#if LL_WINDOWS
+
+LLLogVFSDataFile::LLLogVFSDataFile() : mFile(INVALID_HANDLE_VALUE)
+{
+}
+
+bool LLLogVFSDataFile::open(const std::string& filename, bool read_only)
+{
+	close();
+	llutf16string utf16filename = utf8str_to_utf16str(filename);
+	mFile = CreateFileW(utf16filename.c_str(), GENERIC_READ | (read_only ? 0 : GENERIC_WRITE),
+						FILE_SHARE_READ, NULL, read_only ? OPEN_EXISTING : OPEN_ALWAYS,
+						FILE_ATTRIBUTE_NORMAL, NULL);
+	return mFile != INVALID_HANDLE_VALUE;
+}
+
+void LLLogVFSDataFile::close()
+{
+	if (mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+}
+
+bool LLLogVFSDataFile::read(U64 offset, void* buffer, U32 size)
+{
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+	DWORD bytes = 0;
+	return ReadFile(mFile, buffer, size, &bytes, &overlapped) && bytes == size;
+}
+
+bool LLLogVFSDataFile::write(U64 offset, const void* buffer, U32 size)
+{
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+	DWORD bytes = 0;
+	return WriteFile(mFile, buffer, size, &bytes, &overlapped) && bytes == size;
+}
+
+#else
+
+LLLogVFSDataFile::LLLogVFSDataFile() : mFD(-1)
+{
+}
+
+bool LLLogVFSDataFile::open(const std::string& filename, bool read_only)
+{
+	close();
+	mFD = ::open(filename.c_str(), read_only ? O_RDONLY : (O_RDWR | O_CREAT), 0600);
+	return mFD != -1;
+}
+
+void LLLogVFSDataFile::close()
+{
+	if (mFD != -1)
+	{
+		::close(mFD);
+		mFD = -1;
+	}
+}
+
+bool LLLogVFSDataFile::read(U64 offset, void* buffer, U32 size)
+{
+	U8* dest = (U8*)buffer;
+	while (size)
+	{
+		ssize_t bytes = pread(mFD, dest, size, (off_t)offset);
+		if (bytes <= 0)
+		{
+			if (bytes < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		dest += bytes;
+		offset += bytes;
+		size -= bytes;
+	}
+	return true;
+}
+
+bool LLLogVFSDataFile::write(U64 offset, const void* buffer, U32 size)
+{
+	const U8* src = (const U8*)buffer;
+	while (size)
+	{
+		ssize_t bytes = pwrite(mFD, src, size, (off_t)offset);
+		if (bytes <= 0)
+		{
+			if (bytes < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		src += bytes;
+		offset += bytes;
+		size -= bytes;
+	}
+	return true;
+}
+
+#endif
+
+LLLogVFSDataFile::~LLLogVFSDataFile()
+{
+	close();
+}
+
+//----------------------------------------------------------------------------
+
+LLLogVFS::FileEntry::FileEntry()
+:	mSize(0),
+	mMaxSize(BLOCK_LENGTH_INVALID),
+	mMetaSegment(-1),
+	mAccessTime((U32)time(NULL))
+{
+	for (S32 i = 0; i < VFSLOCK_COUNT; i++)
+	{
+		mLocks[i] = 0;
+	}
+}
+
+// static
+LLLogVFS* LLLogVFS::createLogVFS(const std::string& dirname, const BOOL read_only, const U32 max_size,
+								 const U32 segment_size)
+{
+	LLLogVFS* vfs = new LLLogVFS(dirname, read_only, max_size, llmax(segment_size, MIN_SEGMENT_SIZE));
+	if (!vfs->isValid())
+	{
+		delete vfs;
+		vfs = NULL;
+	}
+	return vfs;
+}
+
+LLLogVFS::LLLogVFS(const std::string& dirname, const BOOL read_only, const U32 max_size, const U32 segment_size)
+:	LLVFS(read_only),
+	mDirName(dirname),
+	mSegmentSize(segment_size),
+	mDataFile(NULL),
+	mCleanMutex(NULL),
+	mLogMutex(NULL),
+	mHeadSegment(-1),
+	mNextSeq(1),
+	mReservedSegments(0),
+	mReservedBytes(0),
+	mMaxBytes(max_size),
+	mCleanedSegments(0)
+{
+	// room for the live data, plus slack so cleaning does not have to
+	// copy nearly full segments over and over
+	U64 log_size = (U64)max_size + max_size / 4;
+	S32 num_segments = (S32)((log_size + mSegmentSize - 1) / mSegmentSize) + RESERVED_SEGMENTS + 1;
+	mSegments.resize(num_segments);
+
+	for (S32 i = 0; i < NUM_STRIPES; i++)
+	{
+		mStripes.push_back(new Stripe);
+	}
+
+	LL_INFOS("VFS") << "Opening log VFS in " << mDirName << LL_ENDL;
+
+	if (!mReadOnly)
+	{
+		LLFile::mkdir(mDirName);
+	}
+	mDataFile = new LLLogVFSDataFile;
+	if (!mDataFile->open(mDirName + gDirUtilp->getDirDelimiter() + DATA_FILE_NAME, mReadOnly))
+	{
+		LL_WARNS("VFS") << "Can't open log VFS data file in " << mDirName << LL_ENDL;
+		mValid = mReadOnly ? VFSVALID_BAD_CANNOT_OPEN_READONLY : VFSVALID_BAD_CANNOT_CREATE;
+		return;
+	}
+
+	if (!readIndex())
+	{
+		LL_INFOS("VFS") << "No log VFS index, replaying the log" << LL_ENDL;
+		rebuildFromLog();
+	}
+	mValid = VFSVALID_OK;
+}
+
+LLLogVFS::~LLLogVFS()
+{
+	if (isValid() && !mReadOnly)
+	{
+		writeIndex();
+	}
+	delete mDataFile;
+	mDataFile = NULL;
+	for_each(mStripes.begin(), mStripes.end(), DeletePointer());
+	mStripes.clear();
+}
+
+S32 LLLogVFS::getStripeIndex(const LLUUID& file_id) const
+{
+	// asset ids are random enough already
+	return (file_id.mData[0] ^ file_id.mData[UUID_BYTES - 1]) % NUM_STRIPES;
+}
+
+LLLogVFS::Stripe& LLLogVFS::getStripe(const LLUUID& file_id)
+{
+	return *mStripes[getStripeIndex(file_id)];
+}
+
+S32 LLLogVFS::roundSize(S32 size, LLAssetType::EType file_type) const
+{
+	// textures need the exact size, see LLVFS::setMaxSize()
+	if (file_type != LLAssetType::AT_TEXTURE && (size & FILE_BLOCK_MASK))
+	{
+		size += FILE_BLOCK_MASK;
+		size &= ~FILE_BLOCK_MASK;
+	}
+	return size;
+}
+
+S32 LLLogVFS::getMaxChunk() const
+{
+	return (S32)((mSegmentSize - SEGMENT_HEADER_SIZE - sizeof(LLLogVFSRecordHeader)) & ~(RECORD_ALIGN - 1));
+}
+
+U32 LLLogVFS::getReservedBytes()
+{
+	LLMutexLock lock(&mLogMutex);
+	return mReservedBytes;
+}
+
+S32 LLLogVFS::getFreeSegments()
+{
+	LLMutexLock lock(&mLogMutex);
+	return (S32)mFreeSegments.size();
+}
+
+//----------------------------------------------------------------------------
+// Log
+
+bool LLLogVFS::appendRecord(LLLogVFSRecordHeader& header, const U8* data, S32& segment, U32& data_offset,
+							bool cleaning, SegmentReservation* reservation)
+{
+	U32 size = record_size(header.mLength);
+	if (size > mSegmentSize - SEGMENT_HEADER_SIZE)
+	{
+		return false;
+	}
+
+	header.mMagic = RECORD_MAGIC;
+	header.mCRC = 0;
+	LLCRC crc;
+	if (header.mLength > 0)
+	{
+		crc.update(data, header.mLength);
+	}
+
+	LLMutexLock lock(&mLogMutex);
+
+	if (mHeadSegment < 0 || mSegments[mHeadSegment].mUsed + size > mSegmentSize)
+	{
+		// segments promised to other writes are off limits
+		bool promised = reservation && reservation->mCount > 0;
+		S32 available = (S32)mFreeSegments.size();
+		if (!promised)
+		{
+			available -= mReservedSegments;
+		}
+		if (available <= ((cleaning || promised) ? 0 : 1))
+		{
+			return false;
+		}
+		if (promised)
+		{
+			reservation->mCount--;
+			mReservedSegments--;
+		}
+		mHeadSegment = mFreeSegments.back();
+		mFreeSegments.pop_back();
+
+		Segment& head = mSegments[mHeadSegment];
+		head.mSeq = mNextSeq++;
+		head.mUsed = SEGMENT_HEADER_SIZE;
+		head.mLive = 0;
+
+		U8 buffer[SEGMENT_HEADER_SIZE];
+		memset(buffer, 0, SEGMENT_HEADER_SIZE);
+		LLLogVFSSegmentHeader* seg_header = (LLLogVFSSegmentHeader*)buffer;
+		seg_header->mMagic = LOG_MAGIC;
+		seg_header->mVersion = LOG_VERSION;
+		seg_header->mSeq = head.mSeq;
+		seg_header->mSegmentSize = mSegmentSize;
+		seg_header->mNumSegments = mSegments.size();
+		if (!mDataFile->write(getSegmentStart(mHeadSegment), buffer, SEGMENT_HEADER_SIZE))
+		{
+			llwarns << "VFS: Unable to write log segment header" << llendl;
+		}
+	}
+
+	Segment& head = mSegments[mHeadSegment];
+	header.mSeq = head.mSeq;
+	crc.update((const U8*)&header, sizeof(header));
+	header.mCRC = crc.getCRC();
+
+	U64 offset = getSegmentStart(mHeadSegment) + head.mUsed;
+	bool success = mDataFile->write(offset, &header, sizeof(header));
+	if (success && header.mLength > 0)
+	{
+		success = mDataFile->write(offset + sizeof(header), data, header.mLength);
+	}
+	if (!success)
+	{
+		llwarns << "VFS: Log write error" << llendl;
+		return false;
+	}
+
+	if (header.mType == RECORD_DATA)
+	{
+		head.mLive += header.mLength;
+	}
+	segment = mHeadSegment;
+	data_offset = head.mUsed + sizeof(header);
+	head.mUsed += size;
+	return true;
+}
+
+void LLLogVFS::releaseLive(const Extent& extent)
+{
+	LLMutexLock lock(&mLogMutex);
+	Segment& segment = mSegments[extent.mSegment];
+	segment.mLive -= llmin((U32)extent.mLength, segment.mLive);
+}
+
+void LLLogVFS::releaseLive(const std::vector<Extent>& extents)
+{
+	if (extents.empty())
+	{
+		return;
+	}
+	LLMutexLock lock(&mLogMutex);
+	for (std::vector<Extent>::const_iterator it = extents.begin(); it != extents.end(); ++it)
+	{
+		Segment& segment = mSegments[it->mSegment];
+		segment.mLive -= llmin((U32)it->mLength, segment.mLive);
+	}
+}
+
+bool LLLogVFS::writeReserve(const LLVFSFileSpecifier& spec, FileEntry& entry, bool cleaning)
+{
+	LLLogVFSRecordHeader header;
+	memset(&header, 0, sizeof(header));
+	header.mType = RECORD_RESERVE;
+	header.mFileType = spec.mFileType;
+	memcpy(header.mFileID, spec.mFileID.mData, UUID_BYTES);
+	header.mMaxSize = entry.mMaxSize;
+
+	S32 segment;
+	U32 offset;
+	if (!appendRecord(header, NULL, segment, offset, cleaning))
+	{
+		llwarns << "VFS: No log space to record size of " << spec.mFileID << llendl;
+		return false;
+	}
+	entry.mMetaSegment = segment;
+	return true;
+}
+
+void LLLogVFS::writeRemove(const LLVFSFileSpecifier& spec)
+{
+	LLLogVFSRecordHeader header;
+	memset(&header, 0, sizeof(header));
+	header.mType = RECORD_REMOVE;
+	header.mFileType = spec.mFileType;
+	memcpy(header.mFileID, spec.mFileID.mData, UUID_BYTES);
+
+	S32 segment;
+	U32 offset;
+	if (!appendRecord(header, NULL, segment, offset))
+	{
+		llwarns << "VFS: No log space to record removal of " << spec.mFileID << llendl;
+	}
+}
+
+//----------------------------------------------------------------------------
+// File table.  Stripe (if any) held.
+
+void LLLogVFS::overwriteExtents(FileEntry& entry, const Extent& extent)
+{
+	std::vector<Extent>& extents = entry.mExtents;
+	S32 start = extent.mLocation;
+	S32 end = extent.mLocation + extent.mLength;
+
+	if (extents.empty() || extents.back().mLocation + extents.back().mLength <= start)
+	{
+		// appending, the usual case
+		extents.push_back(extent);
+		return;
+	}
+
+	std::vector<Extent> result;
+	std::vector<Extent> released;
+	result.reserve(extents.size() + 2);
+	bool inserted = false;
+	for (std::vector<Extent>::iterator it = extents.begin(); it != extents.end(); ++it)
+	{
+		S32 old_start = it->mLocation;
+		S32 old_end = it->mLocation + it->mLength;
+		if (old_end <= start || old_start >= end)
+		{
+			if (!inserted && old_start >= end)
+			{
+				result.push_back(extent);
+				inserted = true;
+			}
+			result.push_back(*it);
+			continue;
+		}
+
+		if (old_start < start)
+		{
+			Extent left = *it;
+			left.mLength = start - old_start;
+			result.push_back(left);
+		}
+		if (!inserted)
+		{
+			result.push_back(extent);
+			inserted = true;
+		}
+		if (old_end > end)
+		{
+			Extent right = *it;
+			right.mLocation = end;
+			right.mOffset += end - old_start;
+			right.mLength = old_end - end;
+			result.push_back(right);
+		}
+
+		Extent dead = *it;
+		dead.mLength = llmin(old_end, end) - llmax(old_start, start);
+		released.push_back(dead);
+	}
+	if (!inserted)
+	{
+		result.push_back(extent);
+	}
+	extents.swap(result);
+	releaseLive(released);
+}
+
+void LLLogVFS::truncateEntry(FileEntry& entry, S32 size)
+{
+	std::vector<Extent> released;
+	while (!entry.mExtents.empty())
+	{
+		Extent& last = entry.mExtents.back();
+		if (last.mLocation >= size)
+		{
+			released.push_back(last);
+			entry.mExtents.pop_back();
+		}
+		else
+		{
+			if (last.mLocation + last.mLength > size)
+			{
+				Extent dead = last;
+				dead.mLength = last.mLocation + last.mLength - size;
+				released.push_back(dead);
+				last.mLength = size - last.mLocation;
+			}
+			break;
+		}
+	}
+	entry.mSize = llmin(entry.mSize, size);
+	releaseLive(released);
+}
+
+void LLLogVFS::removeEntry(file_map_t& files, file_map_t::iterator it)
+{
+	FileEntry& entry = it->second;
+	releaseLive(entry.mExtents);
+	entry.mExtents.clear();
+	if (entry.mMaxSize > 0)
+	{
+		LLMutexLock lock(&mLogMutex);
+		mReservedBytes -= llmin((U32)entry.mMaxSize, mReservedBytes);
+	}
+	entry.mMaxSize = BLOCK_LENGTH_INVALID;
+	entry.mSize = 0;
+	entry.mMetaSegment = -1;
+
+	bool locked = false;
+	for (S32 i = 0; i < VFSLOCK_COUNT; i++)
+	{
+		locked |= entry.mLocks[i] > 0;
+	}
+	if (!locked)
+	{
+		files.erase(it);
+	}
+	// else keep it around as an empty entry to hold the locks
+}
+
+bool LLLogVFS::moveEntry(const LLVFSFileSpecifier& old_spec, const LLVFSFileSpecifier& new_spec)
+{
+	file_map_t& old_files = getStripe(old_spec.mFileID).mFiles;
+	file_map_t& new_files = getStripe(new_spec.mFileID).mFiles;
+	file_map_t::iterator it = old_files.find(old_spec);
+	if (it == old_files.end())
+	{
+		return false;
+	}
+
+	file_map_t::iterator new_it = new_files.find(new_spec);
+	if (new_it != new_files.end())
+	{
+		for (S32 i = 0; i < (S32)VFSLOCK_COUNT; i++)
+		{
+			if (new_it->second.mLocks[i])
+			{
+				llerrs << "Renaming VFS block to a locked file." << llendl;
+			}
+		}
+		removeEntry(new_files, new_it);
+	}
+
+	// the file keeps its own locks
+	FileEntry& entry = new_files[new_spec];
+	entry = it->second;
+	old_files.erase(it);
+	entry.mAccessTime = (U32)time(NULL);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// Cleaning and eviction
+
+bool LLLogVFS::ensureFreeSegments(S32 size, SegmentReservation* reservation)
+{
+	// segments a write of size bytes can take, allowing for a partly
+	// used head and record headers
+	S32 max_chunk = getMaxChunk();
+	S32 write_segments = (size + max_chunk - 1) / max_chunk + 1;
+	S32 needed = write_segments + RESERVED_SEGMENTS;
+
+	LLMutexLock clean_lock(&mCleanMutex);
+	for (S32 attempt = 0; ; attempt++)
+	{
+		S32 victim = -1;
+		{
+			LLMutexLock lock(&mLogMutex);
+			S32 available = (S32)mFreeSegments.size() - mReservedSegments;
+			if (available < needed && attempt < (S32)mSegments.size())
+			{
+				U32 oldest = U32_MAX;
+				for (S32 i = 0; i < (S32)mSegments.size(); i++)
+				{
+					if (i != mHeadSegment && mSegments[i].mSeq && mSegments[i].mSeq < oldest)
+					{
+						oldest = mSegments[i].mSeq;
+						victim = i;
+					}
+				}
+			}
+			if (victim < 0)
+			{
+				// without the slack, the write itself may still fit
+				if (available < write_segments)
+				{
+					return false;
+				}
+				if (reservation)
+				{
+					reservation->mCount += write_segments;
+					mReservedSegments += write_segments;
+				}
+				return true;
+			}
+		}
+		cleanSegment(victim);
+	}
+}
+
+void LLLogVFS::releaseSegments(SegmentReservation& reservation)
+{
+	if (reservation.mCount > 0)
+	{
+		LLMutexLock lock(&mLogMutex);
+		mReservedSegments -= reservation.mCount;
+		reservation.mCount = 0;
+	}
+}
+
+// mCleanMutex held
+void LLLogVFS::cleanSegment(S32 victim)
+{
+	// Only the oldest segment is ever cleaned, so anything it has that is
+	// not live (removals, renames, overwritten data) only describes even
+	// older history and can be dropped.  Reserved sizes last recorded in
+	// it are written again.
+	bool success = true;
+	std::vector<U8> buffer;
+	for (S32 s = 0; s < NUM_STRIPES && success; s++)
+	{
+		Stripe& stripe = *mStripes[s];
+		LLMutexLock stripe_lock(&stripe.mMutex);
+		for (file_map_t::iterator it = stripe.mFiles.begin(); it != stripe.mFiles.end() && success; ++it)
+		{
+			const LLVFSFileSpecifier& spec = it->first;
+			FileEntry& entry = it->second;
+			if (entry.mMaxSize > 0 && entry.mMetaSegment == victim)
+			{
+				success = writeReserve(spec, entry, true);
+			}
+
+			for (std::vector<Extent>::iterator ext = entry.mExtents.begin();
+				 ext != entry.mExtents.end() && success; ++ext)
+			{
+				if (ext->mSegment != victim)
+				{
+					continue;
+				}
+				buffer.resize(ext->mLength);
+				if (!mDataFile->read(getSegmentStart(victim) + ext->mOffset, &buffer[0], ext->mLength))
+				{
+					llwarns << "VFS: Log read error cleaning segment " << victim << llendl;
+					success = false;
+					break;
+				}
+
+				LLLogVFSRecordHeader header;
+				memset(&header, 0, sizeof(header));
+				header.mType = RECORD_DATA;
+				header.mFileType = spec.mFileType;
+				memcpy(header.mFileID, spec.mFileID.mData, UUID_BYTES);
+				header.mLocation = ext->mLocation;
+				header.mMaxSize = entry.mMaxSize;
+				header.mLength = ext->mLength;
+
+				S32 segment;
+				U32 offset;
+				if (!appendRecord(header, &buffer[0], segment, offset, true))
+				{
+					llwarns << "VFS: No log space cleaning segment " << victim << llendl;
+					success = false;
+					break;
+				}
+				releaseLive(*ext);
+				ext->mSegment = segment;
+				ext->mOffset = offset;
+			}
+		}
+	}
+
+	if (success)
+	{
+		LLMutexLock lock(&mLogMutex);
+		Segment& segment = mSegments[victim];
+		segment = Segment();
+		mFreeSegments.push_back(victim);
+		mCleanedSegments++;
+
+		U8 zero[SEGMENT_HEADER_SIZE];
+		memset(zero, 0, SEGMENT_HEADER_SIZE);
+		mDataFile->write(getSegmentStart(victim), zero, SEGMENT_HEADER_SIZE);
+	}
+}
+
+// Like LLVFS::findFreeBlock(), removes least recently used files that are
+// not locked until size bytes more can be reserved.
+void LLLogVFS::evictLRU(S32 size, const LLVFSFileSpecifier& immune)
+{
+	LLMutexLock clean_lock(&mCleanMutex);
+
+	U64 target = (U64)size + VFS_CLEANUP_SIZE;
+	{
+		LLMutexLock lock(&mLogMutex);
+		if ((U64)mReservedBytes + size <= mMaxBytes)
+		{
+			return;
+		}
+		if (target > mMaxBytes)
+		{
+			target = size;
+		}
+	}
+
+	typedef std::vector<std::pair<U32, LLVFSFileSpecifier> > lru_list_t;
+	lru_list_t lru;
+	for (S32 s = 0; s < NUM_STRIPES; s++)
+	{
+		Stripe& stripe = *mStripes[s];
+		LLMutexLock stripe_lock(&stripe.mMutex);
+		for (file_map_t::iterator it = stripe.mFiles.begin(); it != stripe.mFiles.end(); ++it)
+		{
+			const FileEntry& entry = it->second;
+			if (entry.mMaxSize > 0 && !entry.mLocks[VFSLOCK_OPEN] && !entry.mLocks[VFSLOCK_READ]
+				&& !entry.mLocks[VFSLOCK_APPEND] && !(it->first == immune))
+			{
+				lru.push_back(std::make_pair(entry.mAccessTime, it->first));
+			}
+		}
+	}
+	std::sort(lru.begin(), lru.end());
+
+	S32 evicted = 0;
+	for (lru_list_t::iterator it = lru.begin(); it != lru.end(); ++it)
+	{
+		{
+			LLMutexLock lock(&mLogMutex);
+			if ((U64)mReservedBytes + target <= mMaxBytes)
+			{
+				break;
+			}
+		}
+
+		const LLVFSFileSpecifier& spec = it->second;
+		Stripe& stripe = getStripe(spec.mFileID);
+		LLMutexLock stripe_lock(&stripe.mMutex);
+		file_map_t::iterator file_it = stripe.mFiles.find(spec);
+		if (file_it != stripe.mFiles.end() && file_it->second.mMaxSize > 0)
+		{
+			const FileEntry& entry = file_it->second;
+			if (!entry.mLocks[VFSLOCK_OPEN] && !entry.mLocks[VFSLOCK_READ] && !entry.mLocks[VFSLOCK_APPEND])
+			{
+				removeEntry(stripe.mFiles, file_it);
+				writeRemove(spec);
+				evicted++;
+			}
+		}
+	}
+	lldebugs << "VFS: Evicted " << evicted << " files to make room for " << size << " bytes" << llendl;
+}
+
+//----------------------------------------------------------------------------
+// LLVFS interface
+
+BOOL LLLogVFS::getExists(const LLUUID &file_id, const LLAssetType::EType file_type)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+
+	Stripe& stripe = getStripe(file_id);
+	LLMutexLock lock(&stripe.mMutex);
+	file_map_t::iterator it = stripe.mFiles.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it == stripe.mFiles.end())
+	{
+		return FALSE;
+	}
+	it->second.mAccessTime = (U32)time(NULL);
+	return it->second.mMaxSize > 0;
+}
+
+S32 LLLogVFS::getSize(const LLUUID &file_id, const LLAssetType::EType file_type)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+
+	Stripe& stripe = getStripe(file_id);
+	LLMutexLock lock(&stripe.mMutex);
+	file_map_t::iterator it = stripe.mFiles.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it == stripe.mFiles.end())
+	{
+		return 0;
+	}
+	it->second.mAccessTime = (U32)time(NULL);
+	return it->second.mSize;
+}
+
+S32 LLLogVFS::getMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+
+	Stripe& stripe = getStripe(file_id);
+	LLMutexLock lock(&stripe.mMutex);
+	file_map_t::iterator it = stripe.mFiles.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it == stripe.mFiles.end())
+	{
+		return 0;
+	}
+	it->second.mAccessTime = (U32)time(NULL);
+	return it->second.mMaxSize;
+}
+
+BOOL LLLogVFS::checkAvailable(S32 max_size)
+{
+	LLMutexLock lock(&mLogMutex);
+	return (U64)mReservedBytes + max_size <= mMaxBytes;
+}
+
+BOOL LLLogVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type, S32 max_size)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+	if (mReadOnly)
+	{
+		llerrs << "Attempt to write to read-only VFS" << llendl;
+	}
+	if (max_size <= 0)
+	{
+		llwarns << "VFS: Attempt to assign size " << max_size << " to vfile " << file_id << llendl;
+		return FALSE;
+	}
+
+	max_size = roundSize(max_size, file_type);
+	LLVFSFileSpecifier spec(file_id, file_type);
+	Stripe& stripe = getStripe(file_id);
+
+	S32 increase = max_size;
+	{
+		LLMutexLock lock(&stripe.mMutex);
+		file_map_t::iterator it = stripe.mFiles.find(spec);
+		if (it != stripe.mFiles.end() && it->second.mMaxSize > 0)
+		{
+			increase = max_size - it->second.mMaxSize;
+		}
+	}
+	if (increase > 0)
+	{
+		evictLRU(increase, spec);
+	}
+	ensureFreeSegments(0);
+
+	LLMutexLock lock(&stripe.mMutex);
+	FileEntry& entry = stripe.mFiles[spec];
+	entry.mAccessTime = (U32)time(NULL);
+	S32 current = llmax(entry.mMaxSize, 0);
+	if (max_size == current)
+	{
+		return TRUE;
+	}
+
+	{
+		LLMutexLock log_lock(&mLogMutex);
+		if (max_size > current && (U64)mReservedBytes + (max_size - current) > mMaxBytes)
+		{
+			llwarns << "VFS: No space (" << max_size << ") for virtual file " << file_id << llendl;
+			return FALSE;
+		}
+		mReservedBytes = mReservedBytes + max_size - current;
+	}
+
+	if (max_size < entry.mSize)
+	{
+		// JC: Was a warning, but Ian says it's bad.
+		llerrs << "Truncating virtual file " << file_id << " to " << max_size << " bytes" << llendl;
+		truncateEntry(entry, max_size);
+	}
+	entry.mMaxSize = max_size;
+	writeReserve(spec, entry);
+	return TRUE;
+}
+
+// The file moves with its locks, see LLVFS::renameFile().
+void LLLogVFS::renameFile(const LLUUID &file_id, const LLAssetType::EType file_type,
+						  const LLUUID &new_id, const LLAssetType::EType &new_type)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+	if (mReadOnly)
+	{
+		llerrs << "Attempt to write to read-only VFS" << llendl;
+	}
+
+	ensureFreeSegments(0);
+
+	LLVFSFileSpecifier old_spec(file_id, file_type);
+	LLVFSFileSpecifier new_spec(new_id, new_type);
+	S32 old_stripe = getStripeIndex(file_id);
+	S32 new_stripe = getStripeIndex(new_id);
+
+	// The cleaner goes one stripe at a time, so a file must not move
+	// from a stripe it has yet to clean into one it already has.
+	LLMutexLock clean_lock(&mCleanMutex);
+
+	// lock stripes in order
+	LLMutex* first = &mStripes[llmin(old_stripe, new_stripe)]->mMutex;
+	LLMutex* second = &mStripes[llmax(old_stripe, new_stripe)]->mMutex;
+	first->lock();
+	if (second != first)
+	{
+		second->lock();
+	}
+
+	if (moveEntry(old_spec, new_spec))
+	{
+		LLLogVFSRecordHeader header;
+		memset(&header, 0, sizeof(header));
+		header.mType = RECORD_RENAME;
+		header.mFileType = file_type;
+		memcpy(header.mFileID, file_id.mData, UUID_BYTES);
+		header.mNewType = new_type;
+		memcpy(header.mNewID, new_id.mData, UUID_BYTES);
+
+		S32 segment;
+		U32 offset;
+		if (appendRecord(header, NULL, segment, offset))
+		{
+			mStripes[new_stripe]->mFiles[new_spec].mMetaSegment = segment;
+		}
+		else
+		{
+			llwarns << "VFS: No log space to record rename of " << file_id << llendl;
+		}
+	}
+	else
+	{
+		llwarns << "VFS: Attempt to rename nonexistent vfile " << file_id << ":" << file_type << llendl;
+	}
+
+	if (second != first)
+	{
+		second->unlock();
+	}
+	first->unlock();
+}
+
+void LLLogVFS::removeFile(const LLUUID &file_id, const LLAssetType::EType file_type)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+	if (mReadOnly)
+	{
+		llerrs << "Attempt to write to read-only VFS" << llendl;
+	}
+
+	ensureFreeSegments(0);
+
+	LLVFSFileSpecifier spec(file_id, file_type);
+	Stripe& stripe = getStripe(file_id);
+	LLMutexLock lock(&stripe.mMutex);
+	file_map_t::iterator it = stripe.mFiles.find(spec);
+	if (it != stripe.mFiles.end())
+	{
+		removeEntry(stripe.mFiles, it);
+		writeRemove(spec);
+	}
+	else
+	{
+		llwarns << "VFS: attempting to remove nonexistent file " << file_id << " type " << file_type << llendl;
+	}
+}
+
+S32 LLLogVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8 *buffer, S32 location, S32 length)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+	llassert(location >= 0);
+	llassert(length >= 0);
+
+	Stripe& stripe = getStripe(file_id);
+	LLMutexLock lock(&stripe.mMutex);
+	file_map_t::iterator it = stripe.mFiles.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it == stripe.mFiles.end())
+	{
+		return 0;
+	}
+
+	FileEntry& entry = it->second;
+	entry.mAccessTime = (U32)time(NULL);
+	if (location > entry.mSize)
+	{
+		llwarns << "VFS: Attempt to read location " << location << " in file " << file_id << " of length " << entry.mSize << llendl;
+		return 0;
+	}
+	length = llmin(length, entry.mSize - location);
+
+	// first extent that could overlap the read
+	std::vector<Extent>& extents = entry.mExtents;
+	S32 lo = 0;
+	S32 hi = (S32)extents.size();
+	while (lo < hi)
+	{
+		S32 mid = (lo + hi) / 2;
+		if (extents[mid].mLocation + extents[mid].mLength <= location)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	S32 pos = location;
+	S32 end = location + length;
+	for (S32 i = lo; i < (S32)extents.size() && pos < end; i++)
+	{
+		const Extent& extent = extents[i];
+		if (extent.mLocation > pos)
+		{
+			// never written
+			S32 gap = llmin(extent.mLocation, end) - pos;
+			memset(buffer + pos - location, 0, gap);
+			pos += gap;
+			if (pos >= end)
+			{
+				break;
+			}
+		}
+		S32 skip = pos - extent.mLocation;
+		S32 bytes = llmin(extent.mLength - skip, end - pos);
+		if (!mDataFile->read(getSegmentStart(extent.mSegment) + extent.mOffset + skip, buffer + pos - location, bytes))
+		{
+			llwarns << "VFS: Log read error in file " << file_id << llendl;
+			return pos - location;
+		}
+		pos += bytes;
+	}
+	if (pos < end)
+	{
+		memset(buffer + pos - location, 0, end - pos);
+	}
+	return length;
+}
+
+S32 LLLogVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type, const U8 *buffer, S32 location, S32 length)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+	if (mReadOnly)
+	{
+		llerrs << "Attempt to write to read-only VFS" << llendl;
+	}
+	llassert(length > 0);
+
+	// All or nothing, rather than running out of log part way through.
+	SegmentReservation reservation(this);
+	if (!ensureFreeSegments(length, &reservation))
+	{
+		llwarns << "VFS: No log space to write " << length << " bytes to " << file_id << llendl;
+		return 0;
+	}
+
+	LLVFSFileSpecifier spec(file_id, file_type);
+	Stripe& stripe = getStripe(file_id);
+	LLMutexLock lock(&stripe.mMutex);
+	file_map_t::iterator it = stripe.mFiles.find(spec);
+	if (it == stripe.mFiles.end())
+	{
+		return 0;
+	}
+
+	FileEntry& entry = it->second;
+	S32 in_loc = location;
+	if (location == -1)
+	{
+		location = entry.mSize;
+	}
+	llassert(location >= 0);
+	entry.mAccessTime = (U32)time(NULL);
+
+	if (entry.mMaxSize == BLOCK_LENGTH_INVALID)
+	{
+		// File was removed, ignore write
+		llwarns << "VFS: Attempt to write to invalid block"
+				<< " in file " << file_id
+				<< " location: " << in_loc
+				<< " bytes: " << length
+				<< llendl;
+		return length;
+	}
+	if (location > entry.mMaxSize)
+	{
+		llwarns << "VFS: Attempt to write to location " << location
+				<< " in file " << file_id
+				<< " type " << S32(file_type)
+				<< " of size " << entry.mSize
+				<< " block length " << entry.mMaxSize
+				<< llendl;
+		return length;
+	}
+	if (length > entry.mMaxSize - location)
+	{
+		llwarns << "VFS: Truncating write to virtual file " << file_id << " type " << S32(file_type) << llendl;
+		length = entry.mMaxSize - location;
+	}
+
+	S32 max_chunk = getMaxChunk();
+	S32 written = 0;
+	while (written < length)
+	{
+		LLLogVFSRecordHeader header;
+		memset(&header, 0, sizeof(header));
+		header.mType = RECORD_DATA;
+		header.mFileType = file_type;
+		memcpy(header.mFileID, file_id.mData, UUID_BYTES);
+		header.mLocation = location + written;
+		header.mMaxSize = entry.mMaxSize;
+		header.mLength = llmin(length - written, max_chunk);
+
+		Extent extent;
+		if (!appendRecord(header, buffer + written, extent.mSegment, extent.mOffset, false, &reservation))
+		{
+			llwarns << llformat("VFS Write Error: %d != %d", written, length) << llendl;
+			break;
+		}
+		extent.mLocation = header.mLocation;
+		extent.mLength = header.mLength;
+		overwriteExtents(entry, extent);
+		written += header.mLength;
+	}
+
+	entry.mSize = llmax(entry.mSize, location + written);
+	return written;
+}
+
+void LLLogVFS::incLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
+{
+	Stripe& stripe = getStripe(file_id);
+	LLMutexLock stripe_lock(&stripe.mMutex);
+	// creates an empty entry to hold the lock if needed
+	stripe.mFiles[LLVFSFileSpecifier(file_id, file_type)].mLocks[lock]++;
+
+	LLMutexLock log_lock(&mLogMutex);
+	mLockCounts[lock]++;
+}
+
+void LLLogVFS::decLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
+{
+	Stripe& stripe = getStripe(file_id);
+	LLMutexLock stripe_lock(&stripe.mMutex);
+	file_map_t::iterator it = stripe.mFiles.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it == stripe.mFiles.end())
+	{
+		return;
+	}
+
+	FileEntry& entry = it->second;
+	if (entry.mLocks[lock] > 0)
+	{
+		entry.mLocks[lock]--;
+	}
+	else
+	{
+		llwarns << "VFS: Decrementing zero-value lock " << lock << llendl;
+	}
+
+	if (entry.mMaxSize == BLOCK_LENGTH_INVALID
+		&& !entry.mLocks[VFSLOCK_OPEN] && !entry.mLocks[VFSLOCK_READ] && !entry.mLocks[VFSLOCK_APPEND])
+	{
+		// nothing left to hold
+		stripe.mFiles.erase(it);
+	}
+
+	LLMutexLock log_lock(&mLogMutex);
+	mLockCounts[lock]--;
+}
+
+BOOL LLLogVFS::isLocked(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
+{
+	Stripe& stripe = getStripe(file_id);
+	LLMutexLock stripe_lock(&stripe.mMutex);
+	file_map_t::iterator it = stripe.mFiles.find(LLVFSFileSpecifier(file_id, file_type));
+	return it != stripe.mFiles.end() && it->second.mLocks[lock] > 0;
+}
+
+//----------------------------------------------------------------------------
+// Index and replay
+
+void LLLogVFS::writeIndex()
+{
+	LLMutexLock clean_lock(&mCleanMutex);
+
+	std::vector<U32> data;
+	data.push_back(INDEX_MAGIC);
+	data.push_back(LOG_VERSION);
+	data.push_back(mSegmentSize);
+	data.push_back(mSegments.size());
+	{
+		LLMutexLock lock(&mLogMutex);
+		data.push_back(mNextSeq);
+		data.push_back((U32)mHeadSegment);
+		data.push_back(mReservedBytes);
+		for (std::vector<Segment>::const_iterator it = mSegments.begin(); it != mSegments.end(); ++it)
+		{
+			data.push_back(it->mSeq);
+			data.push_back(it->mUsed);
+			data.push_back(it->mLive);
+		}
+	}
+
+	for (S32 s = 0; s < NUM_STRIPES; s++)
+	{
+		Stripe& stripe = *mStripes[s];
+		LLMutexLock stripe_lock(&stripe.mMutex);
+		for (file_map_t::const_iterator it = stripe.mFiles.begin(); it != stripe.mFiles.end(); ++it)
+		{
+			const FileEntry& entry = it->second;
+			if (entry.mMaxSize <= 0)
+			{
+				continue;
+			}
+			const U32* id = (const U32*)it->first.mFileID.mData;
+			data.insert(data.end(), id, id + UUID_BYTES / sizeof(U32));
+			data.push_back((U32)it->first.mFileType);
+			data.push_back((U32)entry.mSize);
+			data.push_back((U32)entry.mMaxSize);
+			data.push_back((U32)entry.mMetaSegment);
+			data.push_back(entry.mAccessTime);
+			data.push_back(entry.mExtents.size());
+			for (std::vector<Extent>::const_iterator ext = entry.mExtents.begin(); ext != entry.mExtents.end(); ++ext)
+			{
+				data.push_back((U32)ext->mLocation);
+				data.push_back((U32)ext->mLength);
+				data.push_back((U32)ext->mSegment);
+				data.push_back(ext->mOffset);
+			}
+		}
+	}
+
+	std::string filename = mDirName + gDirUtilp->getDirDelimiter() + INDEX_FILE_NAME;
+	std::string temp_name = filename + ".tmp";
+	LLFILE* fp = LLFile::fopen(temp_name, "wb");
+	if (!fp)
+	{
+		llwarns << "VFS: Unable to write log index " << temp_name << llendl;
+		return;
+	}
+	bool success = fwrite(&data[0], data.size() * sizeof(U32), 1, fp) == 1;
+	success &= fclose(fp) == 0;
+	LLFile::remove(filename);
+	if (!success || LLFile::rename(temp_name, filename) != 0)
+	{
+		llwarns << "VFS: Unable to write log index " << filename << llendl;
+		LLFile::remove(temp_name);
+	}
+}
+
+bool LLLogVFS::readIndex()
+{
+	std::string filename = mDirName + gDirUtilp->getDirDelimiter() + INDEX_FILE_NAME;
+	LLFILE* fp = LLFile::fopen(filename, "rb");
+	if (!fp)
+	{
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	std::vector<U32> data(size > 0 ? size / sizeof(U32) : 0);
+	bool success = !data.empty() && fread(&data[0], data.size() * sizeof(U32), 1, fp) == 1;
+	fclose(fp);
+	if (!mReadOnly)
+	{
+		// only valid until the first change; a crash from here on
+		// means replaying the log
+		LLFile::remove(filename);
+	}
+
+	const S32 num_segments = mSegments.size();
+	const size_t header_words = 7 + num_segments * 3;
+	if (!success || data.size() < header_words
+		|| data[0] != INDEX_MAGIC || data[1] != LOG_VERSION
+		|| data[2] != mSegmentSize || data[3] != (U32)num_segments)
+	{
+		return false;
+	}
+
+	mNextSeq = data[4];
+	mHeadSegment = (S32)data[5];
+	mReservedBytes = data[6];
+	size_t pos = 7;
+	mFreeSegments.clear();
+	for (S32 i = num_segments - 1; i >= 0; i--)
+	{
+		Segment& segment = mSegments[i];
+		segment.mSeq = data[pos + i * 3];
+		segment.mUsed = data[pos + i * 3 + 1];
+		segment.mLive = data[pos + i * 3 + 2];
+		if (!segment.mSeq)
+		{
+			mFreeSegments.push_back(i);
+		}
+	}
+	pos = header_words;
+	if (mHeadSegment >= num_segments || (mHeadSegment >= 0 && !mSegments[mHeadSegment].mSeq))
+	{
+		resetSegments();
+		return false;
+	}
+
+	const size_t file_words = UUID_BYTES / sizeof(U32) + 6;
+	while (pos + file_words <= data.size())
+	{
+		LLVFSFileSpecifier spec;
+		memcpy(spec.mFileID.mData, &data[pos], UUID_BYTES);
+		pos += UUID_BYTES / sizeof(U32);
+		spec.mFileType = (LLAssetType::EType)data[pos++];
+
+		FileEntry& entry = getStripe(spec.mFileID).mFiles[spec];
+		entry.mSize = (S32)data[pos++];
+		entry.mMaxSize = (S32)data[pos++];
+		entry.mMetaSegment = (S32)data[pos++];
+		entry.mAccessTime = data[pos++];
+		U32 num_extents = data[pos++];
+		if (pos + num_extents * 4 > data.size())
+		{
+			break;
+		}
+		entry.mExtents.resize(num_extents);
+		for (U32 i = 0; i < num_extents; i++)
+		{
+			Extent& extent = entry.mExtents[i];
+			extent.mLocation = (S32)data[pos++];
+			extent.mLength = (S32)data[pos++];
+			extent.mSegment = (S32)data[pos++];
+			extent.mOffset = data[pos++];
+		}
+	}
+	if (pos != data.size())
+	{
+		llwarns << "VFS: Log index " << filename << " is corrupt" << llendl;
+		for (S32 s = 0; s < NUM_STRIPES; s++)
+		{
+			mStripes[s]->mFiles.clear();
+		}
+		resetSegments();
+		return false;
+	}
+	return true;
+}
+
+void LLLogVFS::resetSegments()
+{
+	for (std::vector<Segment>::iterator it = mSegments.begin(); it != mSegments.end(); ++it)
+	{
+		*it = Segment();
+	}
+	mFreeSegments.clear();
+	mHeadSegment = -1;
+	mNextSeq = 1;
+	mReservedBytes = 0;
+}
+
+void LLLogVFS::rebuildFromLog()
+{
+	LLMutexLock clean_lock(&mCleanMutex);
+	for (S32 s = 0; s < NUM_STRIPES; s++)
+	{
+		LLMutexLock stripe_lock(&mStripes[s]->mMutex);
+		mStripes[s]->mFiles.clear();
+	}
+	resetSegments();
+
+	// find the segments in use, oldest first
+	std::vector<std::pair<U32, S32> > used;
+	for (S32 i = 0; i < (S32)mSegments.size(); i++)
+	{
+		LLLogVFSSegmentHeader header;
+		if (mDataFile->read(getSegmentStart(i), &header, sizeof(header))
+			&& header.mMagic == LOG_MAGIC
+			&& header.mVersion == LOG_VERSION
+			&& header.mSegmentSize == mSegmentSize
+			&& header.mNumSegments == mSegments.size()
+			&& header.mSeq)
+		{
+			used.push_back(std::make_pair(header.mSeq, i));
+		}
+	}
+	std::sort(used.begin(), used.end());
+
+	S32 records = 0;
+	for (std::vector<std::pair<U32, S32> >::iterator it = used.begin(); it != used.end(); ++it)
+	{
+		mSegments[it->second].mSeq = it->first;
+		records += replaySegment(it->second);
+		mNextSeq = it->first + 1;
+	}
+
+	// Start a new segment rather than append after a possibly torn
+	// record.
+	mHeadSegment = -1;
+	for (S32 i = (S32)mSegments.size() - 1; i >= 0; i--)
+	{
+		if (!mSegments[i].mSeq)
+		{
+			mFreeSegments.push_back(i);
+		}
+	}
+
+	LL_INFOS("VFS") << "Replayed " << records << " records from " << used.size()
+		<< " log VFS segments" << LL_ENDL;
+}
+
+// Returns the number of records replayed.
+S32 LLLogVFS::replaySegment(S32 segment)
+{
+	U64 start = getSegmentStart(segment);
+	Segment& seg = mSegments[segment];
+	U32 offset = SEGMENT_HEADER_SIZE;
+	S32 records = 0;
+	std::vector<U8> data;
+	while (offset + sizeof(LLLogVFSRecordHeader) <= mSegmentSize)
+	{
+		LLLogVFSRecordHeader header;
+		if (!mDataFile->read(start + offset, &header, sizeof(header))
+			|| header.mMagic != RECORD_MAGIC
+			|| header.mSeq != seg.mSeq
+			|| header.mType < RECORD_DATA || header.mType > RECORD_RENAME
+			|| header.mLength < 0
+			|| offset + record_size(header.mLength) > mSegmentSize)
+		{
+			break;
+		}
+
+		LLCRC crc;
+		if (header.mLength > 0)
+		{
+			data.resize(header.mLength);
+			if (!mDataFile->read(start + offset + sizeof(header), &data[0], header.mLength))
+			{
+				break;
+			}
+			crc.update(&data[0], header.mLength);
+		}
+		U32 stored_crc = header.mCRC;
+		header.mCRC = 0;
+		crc.update((const U8*)&header, sizeof(header));
+		if (crc.getCRC() != stored_crc)
+		{
+			// torn write
+			break;
+		}
+
+		applyRecord(header, segment, offset + sizeof(header));
+		offset += record_size(header.mLength);
+		records++;
+	}
+	seg.mUsed = offset;
+	return records;
+}
+
+void LLLogVFS::applyRecord(const LLLogVFSRecordHeader& header, S32 segment, U32 data_offset)
+{
+	LLVFSFileSpecifier spec;
+	memcpy(spec.mFileID.mData, header.mFileID, UUID_BYTES);
+	spec.mFileType = (LLAssetType::EType)header.mFileType;
+	file_map_t& files = getStripe(spec.mFileID).mFiles;
+
+	switch (header.mType)
+	{
+	case RECORD_DATA:
+	{
+		// Cleaning may have moved the reserve record of a file past its
+		// data, so the data record has the size too.  Data from before
+		// a removal is replayed before the removal, or cleaned away
+		// along with it.
+		file_map_t::iterator it = files.find(spec);
+		if (it == files.end() || it->second.mMaxSize <= 0)
+		{
+			FileEntry& entry = files[spec];
+			mReservedBytes += header.mMaxSize;
+			entry.mMaxSize = header.mMaxSize;
+			entry.mMetaSegment = segment;
+			it = files.find(spec);
+		}
+		Extent extent;
+		extent.mLocation = header.mLocation;
+		extent.mLength = header.mLength;
+		extent.mSegment = segment;
+		extent.mOffset = data_offset;
+		mSegments[segment].mLive += header.mLength;
+		overwriteExtents(it->second, extent);
+		it->second.mSize = llmax(it->second.mSize, header.mLocation + header.mLength);
+		break;
+	}
+	case RECORD_RESERVE:
+	{
+		FileEntry& entry = files[spec];
+		S32 current = llmax(entry.mMaxSize, 0);
+		if (header.mMaxSize < entry.mSize)
+		{
+			truncateEntry(entry, header.mMaxSize);
+		}
+		mReservedBytes = mReservedBytes + header.mMaxSize - current;
+		entry.mMaxSize = header.mMaxSize;
+		entry.mMetaSegment = segment;
+		break;
+	}
+	case RECORD_REMOVE:
+	{
+		file_map_t::iterator it = files.find(spec);
+		if (it != files.end())
+		{
+			removeEntry(files, it);
+		}
+		break;
+	}
+	case RECORD_RENAME:
+	{
+		LLVFSFileSpecifier new_spec;
+		memcpy(new_spec.mFileID.mData, header.mNewID, UUID_BYTES);
+		new_spec.mFileType = (LLAssetType::EType)header.mNewType;
+		if (moveEntry(spec, new_spec))
+		{
+			getStripe(new_spec.mFileID).mFiles[new_spec].mMetaSegment = segment;
+		}
+		break;
+	}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Debugging
+
+void LLLogVFS::pokeFiles()
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+
+	U32 word;
+	if (mDataFile->read(0, &word, sizeof(word)) && !mReadOnly)
+	{
+		mDataFile->write(0, &word, sizeof(word));
+	}
+}
+
+void LLLogVFS::audit()
+{
+	LLMutexLock clean_lock(&mCleanMutex);
+
+	std::vector<U32> live(mSegments.size(), 0);
+	U32 reserved = 0;
+	S32 files = 0;
+	S32 errors = 0;
+	{
+		LLMutexLock lock(&mLogMutex);
+		for (S32 s = 0; s < NUM_STRIPES; s++)
+		{
+			// stripes are not held, so only call this when idle
+			const file_map_t& file_map = mStripes[s]->mFiles;
+			for (file_map_t::const_iterator it = file_map.begin(); it != file_map.end(); ++it)
+			{
+				const FileEntry& entry = it->second;
+				if (entry.mMaxSize > 0)
+				{
+					reserved += entry.mMaxSize;
+					files++;
+				}
+				S32 end = 0;
+				for (std::vector<Extent>::const_iterator ext = entry.mExtents.begin(); ext != entry.mExtents.end(); ++ext)
+				{
+					if (ext->mLocation < end
+						|| ext->mLocation + ext->mLength > entry.mSize
+						|| ext->mSegment < 0 || ext->mSegment >= (S32)mSegments.size()
+						|| !mSegments[ext->mSegment].mSeq
+						|| ext->mOffset + ext->mLength > mSegments[ext->mSegment].mUsed)
+					{
+						llwarns << "VFS: Bad extent in " << it->first.mFileID << " at " << ext->mLocation << llendl;
+						errors++;
+					}
+					else
+					{
+						live[ext->mSegment] += ext->mLength;
+					}
+					end = ext->mLocation + ext->mLength;
+				}
+			}
+		}
+
+		for (S32 i = 0; i < (S32)mSegments.size(); i++)
+		{
+			if (live[i] != mSegments[i].mLive)
+			{
+				llwarns << "VFS: Segment " << i << " live bytes " << mSegments[i].mLive
+					<< " should be " << live[i] << llendl;
+				errors++;
+			}
+		}
+		if (reserved != mReservedBytes)
+		{
+			llwarns << "VFS: Reserved bytes " << mReservedBytes << " should be " << reserved << llendl;
+			errors++;
+		}
+	}
+
+	llinfos << "VFS: Audited " << files << " files, " << errors << " errors" << llendl;
+}
+
+void LLLogVFS::dumpMap()
+{
+	LLMutexLock lock(&mLogMutex);
+	for (S32 i = 0; i < (S32)mSegments.size(); i++)
+	{
+		const Segment& segment = mSegments[i];
+		llinfos << "Segment " << i << (i == mHeadSegment ? " (head)" : "")
+				<< " seq " << segment.mSeq
+				<< " used " << segment.mUsed
+				<< " live " << segment.mLive << llendl;
+	}
+}
+
+void LLLogVFS::dumpStatistics()
+{
+	std::map<LLAssetType::EType, std::pair<S32,S32> > filetype_counts;
+	S32 invalid_file_count = 0;
+	for (S32 s = 0; s < NUM_STRIPES; s++)
+	{
+		Stripe& stripe = *mStripes[s];
+		LLMutexLock stripe_lock(&stripe.mMutex);
+		for (file_map_t::const_iterator it = stripe.mFiles.begin(); it != stripe.mFiles.end(); ++it)
+		{
+			if (it->second.mMaxSize == BLOCK_LENGTH_INVALID)
+			{
+				invalid_file_count++;
+			}
+			else
+			{
+				filetype_counts[it->first.mFileType].first++;
+				filetype_counts[it->first.mFileType].second += it->second.mMaxSize;
+			}
+		}
+	}
+
+	LLMutexLock lock(&mLogMutex);
+	U64 live_bytes = 0;
+	U64 used_bytes = 0;
+	for (std::vector<Segment>::const_iterator it = mSegments.begin(); it != mSegments.end(); ++it)
+	{
+		live_bytes += it->mLive;
+		used_bytes += it->mUsed;
+	}
+	llinfos << "Invalid blocks: " << invalid_file_count << llendl;
+	llinfos << "Reserved: " << mReservedBytes << " of " << mMaxBytes << " bytes" << llendl;
+	llinfos << "Segments: " << mSegments.size() << " of " << mSegmentSize << " bytes, "
+			<< mFreeSegments.size() << " free, " << mCleanedSegments << " cleaned" << llendl;
+	llinfos << "Log: " << used_bytes << " bytes used, " << live_bytes << " live" << llendl;
+
+	for (std::map<LLAssetType::EType, std::pair<S32,S32> >::iterator iter = filetype_counts.begin();
+		 iter != filetype_counts.end(); ++iter)
+	{
+		llinfos << "Type: " << LLAssetType::getDesc(iter->first)
+				<< " Count: " << iter->second.first
+				<< " Bytes: " << (iter->second.second>>20) << " MB" << llendl;
+	}
+}
+
+void LLLogVFS::listFiles()
+{
+	for (S32 s = 0; s < NUM_STRIPES; s++)
+	{
+		Stripe& stripe = *mStripes[s];
+		LLMutexLock stripe_lock(&stripe.mMutex);
+		for (file_map_t::const_iterator it = stripe.mFiles.begin(); it != stripe.mFiles.end(); ++it)
+		{
+			if (it->second.mMaxSize != BLOCK_LENGTH_INVALID && it->second.mSize > 0)
+			{
+				llinfos << " File: " << it->first.mFileID
+						<< " Type: " << LLAssetType::getDesc(it->first.mFileType)
+						<< " Size: " << it->second.mSize
+						<< llendl;
+			}
+		}
+	}
+}
+
+void LLLogVFS::dumpFiles()
+{
+	std::vector<std::pair<LLVFSFileSpecifier, S32> > files;
+	for (S32 s = 0; s < NUM_STRIPES; s++)
+	{
+		Stripe& stripe = *mStripes[s];
+		LLMutexLock stripe_lock(&stripe.mMutex);
+		for (file_map_t::const_iterator it = stripe.mFiles.begin(); it != stripe.mFiles.end(); ++it)
+		{
+			if (it->second.mMaxSize != BLOCK_LENGTH_INVALID && it->second.mSize > 0)
+			{
+				files.push_back(std::make_pair(it->first, it->second.mSize));
+			}
+		}
+	}
+
+	for (U32 i = 0; i < files.size(); i++)
+	{
+		const LLVFSFileSpecifier& spec = files[i].first;
+		S32 size = files[i].second;
+		std::vector<U8> buffer(size);
+		size = getData(spec.mFileID, spec.mFileType, &buffer[0], 0, size);
+
+		std::string filename = spec.mFileID.asString() + get_extension(spec.mFileType);
+		llinfos << " Writing " << filename << llendl;
+
+		LLAPRFile outfile;
+		outfile.open(filename, LL_APR_WB);
+		outfile.write(&buffer[0], size);
+		outfile.close();
+	}
+
+	llinfos << "Extracted " << files.size() << " files" << llendl;
+}
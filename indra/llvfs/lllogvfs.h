@@ -0,0 +1,232 @@
+/** 
+ * @file lllogvfs.h
+ * @brief Log-structured LLVFS backend.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#ifndef LL_LLLOGVFS_H
+#define LL_LLLOGVFS_H
+
+#include <map>
+#include <vector>
+
+#include "llvfs.h"
+
+class LLLogVFSDataFile;
+struct LLLogVFSRecordHeader;
+
+// An LLVFS that keeps its data in a circular log instead of a
+// block-allocated data file.
+//
+// [dir]/data
+//  A fixed number of fixed size segments.  Every change (a data write,
+//  a change of reserved size, a removal or a rename) is appended to the
+//  head segment as a checksummed record.  When free segments run low
+//  the oldest segment is cleaned: its live data is copied to the head
+//  of the log and the segment is reused.  Records never span segments.
+// [dir]/index
+//  Written on a clean shutdown and deleted when opened.  If it is
+//  missing the file table is rebuilt by replaying the segments oldest
+//  first, stopping at the first torn record in each.
+//
+// Space is reserved with setMaxSize() just like LLVFS, evicting the
+// least recently used unlocked files when full.
+//
+// The file table is split into lock stripes by file id.  Reads of
+// different files run in parallel with positional I/O and no global
+// lock.  Appends to the log are serialized, which keeps records in
+// order for replay, but never wait on readers or on a seek.
+class LLLogVFS : public LLVFS
+{
+public:
+	// Opens or creates a log VFS of max_size bytes in dirname.  Returns
+	// NULL on failure.
+	static LLLogVFS* createLogVFS(const std::string& dirname, const BOOL read_only, const U32 max_size,
+								  const U32 segment_size = DEFAULT_SEGMENT_SIZE);
+	virtual ~LLLogVFS();
+
+	virtual BOOL getExists(const LLUUID &file_id, const LLAssetType::EType file_type);
+	virtual S32	 getSize(const LLUUID &file_id, const LLAssetType::EType file_type);
+
+	virtual BOOL checkAvailable(S32 max_size);
+
+	virtual S32  getMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type);
+	virtual BOOL setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type, S32 max_size);
+
+	virtual void renameFile(const LLUUID &file_id, const LLAssetType::EType file_type,
+		const LLUUID &new_id, const LLAssetType::EType &new_type);
+	virtual void removeFile(const LLUUID &file_id, const LLAssetType::EType file_type);
+
+	virtual S32 getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8 *buffer, S32 location, S32 length);
+	virtual S32 storeData(const LLUUID &file_id, const LLAssetType::EType file_type, const U8 *buffer, S32 location, S32 length);
+
+	virtual void incLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+	virtual void decLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+	virtual BOOL isLocked(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+
+	virtual void pokeFiles();
+	// Checks the file table against the segment accounting.
+	virtual void audit();
+	virtual void dumpMap();
+	virtual void dumpStatistics();
+	virtual void listFiles();
+	virtual void dumpFiles();
+
+	// Writes the index so the next open does not need to replay the log.
+	// Done on destruction.
+	void writeIndex();
+	// Throws away the in-memory file table and replays the log, as after
+	// a crash.
+	void rebuildFromLog();
+
+	// stats
+	U32 getMaxBytes() const							{ return mMaxBytes; }
+	U32 getReservedBytes();
+	S32 getNumSegments() const						{ return (S32)mSegments.size(); }
+	S32 getFreeSegments();
+	U32 getCleanedSegments() const					{ return mCleanedSegments; }
+
+	static const U32 DEFAULT_SEGMENT_SIZE = 16 * 1024 * 1024;
+
+private:
+	LLLogVFS(const std::string& dirname, const BOOL read_only, const U32 max_size, const U32 segment_size);
+
+	struct Segment
+	{
+		Segment() : mSeq(0), mUsed(0), mLive(0) {}
+		U32 mSeq;			// 0 if free
+		U32 mUsed;			// end of the last record
+		U32 mLive;			// bytes of live file data
+	};
+
+	struct Extent
+	{
+		S32 mLocation;		// in the file
+		S32 mLength;
+		S32 mSegment;
+		U32 mOffset;		// of the data in the segment
+	};
+
+	struct FileEntry
+	{
+		FileEntry();
+
+		S32 mSize;
+		S32 mMaxSize;		// reserved length, BLOCK_LENGTH_INVALID if removed
+		S32 mMetaSegment;	// segment with the newest record of mMaxSize
+		U32 mAccessTime;
+		S32 mLocks[VFSLOCK_COUNT];
+		std::vector<Extent> mExtents;	// sorted by location, not overlapping
+	};
+	typedef std::map<LLVFSFileSpecifier, FileEntry> file_map_t;
+
+	// Free segments promised to a write in progress.  Whatever the write
+	// did not use is handed back when it goes away.
+	struct SegmentReservation
+	{
+		SegmentReservation(LLLogVFS* vfs) : mVFS(vfs), mCount(0) {}
+		~SegmentReservation()							{ mVFS->releaseSegments(*this); }
+		LLLogVFS* mVFS;
+		S32 mCount;
+	};
+
+	struct Stripe
+	{
+		Stripe() : mMutex(NULL) {}
+		LLMutex mMutex;
+		file_map_t mFiles;
+	};
+
+	enum ERecordType
+	{
+		RECORD_DATA = 1,
+		RECORD_RESERVE = 2,
+		RECORD_REMOVE = 3,
+		RECORD_RENAME = 4
+	};
+
+	Stripe& getStripe(const LLUUID& file_id);
+	S32 getStripeIndex(const LLUUID& file_id) const;
+
+	bool readIndex();
+	void resetSegments();
+	S32 replaySegment(S32 segment);
+	void applyRecord(const LLLogVFSRecordHeader& header, S32 segment, U32 data_offset);
+	U64 getSegmentStart(S32 segment) const			{ return (U64)segment * mSegmentSize; }
+
+	// Appends a record, followed by header.mLength bytes of data, to the
+	// log.  Returns false if there is no space left.  Cleaning may use
+	// the last free segment, a write with a reservation uses its own.
+	bool appendRecord(LLLogVFSRecordHeader& header, const U8* data, S32& segment, U32& data_offset,
+					  bool cleaning = false, SegmentReservation* reservation = NULL);
+	void releaseLive(const Extent& extent);
+	void releaseLive(const std::vector<Extent>& extents);
+
+	// Cleans segments until there are enough free for a write of size
+	// bytes, and promises them to the write if reservation is given.
+	// Returns false if that much can't be freed.  Called without any
+	// stripe held.
+	bool ensureFreeSegments(S32 size, SegmentReservation* reservation = NULL);
+	void releaseSegments(SegmentReservation& reservation);
+	void cleanSegment(S32 segment);
+
+	bool writeReserve(const LLVFSFileSpecifier& spec, FileEntry& entry, bool cleaning = false);
+	void writeRemove(const LLVFSFileSpecifier& spec);
+	void truncateEntry(FileEntry& entry, S32 size);
+	void overwriteExtents(FileEntry& entry, const Extent& extent);
+	void removeEntry(file_map_t& files, file_map_t::iterator it);
+	// Moves a file to a new id, replacing any file there.  Both stripes
+	// held.
+	bool moveEntry(const LLVFSFileSpecifier& old_spec, const LLVFSFileSpecifier& new_spec);
+	void evictLRU(S32 size, const LLVFSFileSpecifier& immune);
+	S32 roundSize(S32 size, LLAssetType::EType file_type) const;
+	S32 getMaxChunk() const;
+
+	std::string mDirName;
+	U32 mSegmentSize;
+	LLLogVFSDataFile* mDataFile;
+	std::vector<Segment> mSegments;
+	std::vector<Stripe*> mStripes;
+
+	// serializes cleaning and eviction; taken before any stripe
+	LLMutex mCleanMutex;
+	// guards mSegments and everything below; taken after a stripe
+	LLMutex mLogMutex;
+	S32 mHeadSegment;
+	U32 mNextSeq;
+	std::vector<S32> mFreeSegments;
+	S32 mReservedSegments;		// free segments promised to writes
+	U32 mReservedBytes;
+	U32 mMaxBytes;
+	U32 mCleanedSegments;
+};
+
+#endif // LL_LLLOGVFS_H
@@ -0,0 +1,1029 @@
+/** 
+ * @file llmappedcachestore.cpp
+ * @brief Memory-mapped, UUID indexed store for cached asset data.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#include "linden_common.h"
+
+#include "llmappedcachestore.h"
+
+#include <algorithm>
+
+#include "lldir.h"
+#include "llfile.h"
+#include "llmappedfile.h"
+
+static const U32 STORE_MAGIC = 0x534d4c4c; // "LLMS"
+static const U32 STORE_VERSION = 2;
+static const U32 STORE_PAGE_SIZE = 4096;
+static const U32 STORE_SEGMENT_PAGES = 4096; // 16MB segment files
+static const U32 HEADER_CHUNK_ENTRIES = 8192;
+// Segments and header chunks are mapped on demand; keep the address
+// space used bounded for 32 bit builds.
+static const U32 MAX_MAPPED_SEGMENTS = 8;
+static const U32 MAX_MAPPED_HEADER_CHUNKS = 16;
+
+static const std::string INDEX_FILE_NAME("store.index");
+static const std::string SEGMENT_FILE_PREFIX("store.seg.");
+static const std::string HEADER_FILE_PREFIX("store.hdr.");
+
+struct LLMappedCacheStore::FileHeader
+{
+	U32 mMagic;
+	U32 mVersion;
+	S32 mHeaderSize;
+	U32 mMaxEntries;
+	U32 mTableSize;
+	U32 mPageSize;
+	U32 mMaxPages;
+	U32 mSegmentPages;
+
+	U32 mClean;
+	U32 mEntryCount;
+	U32 mNextEntry;		// entries at or past this index have never been used
+	S32 mFreeEntry;		// free entries, chained through Entry::mNext
+	U32 mNextPage;		// pages at or past this index have never been used
+	S32 mFreePage;		// free pages, chained through the page table
+	U32 mFreePageCount;
+	U32 mPagesUsed;
+	S32 mLRUHead;		// most recently used
+	S32 mLRUTail;
+	U64 mDataBytes;
+};
+
+struct LLMappedCacheStore::Entry
+{
+	LLUUID mID;
+	S32 mImageSize;
+	S32 mDataSize;		// < 0 if the entry is free
+	U32 mTime;
+	S32 mPrev;
+	S32 mNext;
+	S32 mFirstPage;
+};
+
+static U64 align8(U64 size)
+{
+	return (size + 7) & ~(U64)7;
+}
+
+static U32 pages_for(S32 datasize, S32 header_size)
+{
+	if (datasize <= header_size)
+	{
+		return 0;
+	}
+	return ((U32)(datasize - header_size) + STORE_PAGE_SIZE - 1) / STORE_PAGE_SIZE;
+}
+
+LLMappedCacheStore::LLMappedCacheStore() :
+	mHeader(NULL),
+	mHashTable(NULL),
+	mEntries(NULL),
+	mPageTable(NULL),
+	mMutex(NULL),
+	mIndexFile(NULL),
+	mMappedSegments(0),
+	mMappedHeaderChunks(0),
+	mMapUseCounter(0),
+	mHeaderSize(0),
+	mMaxEntries(0),
+	mTableMask(0),
+	mMaxPages(0),
+	mHits(0),
+	mMisses(0),
+	mEvictions(0)
+{
+}
+
+LLMappedCacheStore::~LLMappedCacheStore()
+{
+	close();
+}
+
+//static
+void LLMappedCacheStore::removeFiles(const std::string& dirname)
+{
+	LLFile::remove(dirname + gDirUtilp->getDirDelimiter() + INDEX_FILE_NAME);
+	gDirUtilp->deleteFilesInDir(dirname, SEGMENT_FILE_PREFIX + "*");
+	gDirUtilp->deleteFilesInDir(dirname, HEADER_FILE_PREFIX + "*");
+}
+
+//static
+bool LLMappedCacheStore::filesExist(const std::string& dirname)
+{
+	return LLFile::isfile(dirname + gDirUtilp->getDirDelimiter() + INDEX_FILE_NAME);
+}
+
+bool LLMappedCacheStore::open(const std::string& dirname, S32 header_size, U32 max_entries, U64 max_body_bytes)
+{
+	LLMutexLock lock(&mMutex);
+	closeLocked();
+
+	if (header_size < 0 || max_entries == 0 || max_entries > 0x7fffffff)
+	{
+		llwarns << "Invalid cache store limits" << llendl;
+		return false;
+	}
+
+	U64 max_pages = (max_body_bytes + STORE_PAGE_SIZE - 1) / STORE_PAGE_SIZE;
+	if (max_pages > 0x7fffffff)
+	{
+		max_pages = 0x7fffffff;
+	}
+
+	mDirName = dirname;
+	mHeaderSize = header_size;
+	mMaxEntries = max_entries;
+	mMaxPages = (U32)max_pages;
+	U32 table_size = 8;
+	while (table_size < max_entries * 2)
+	{
+		table_size <<= 1;
+	}
+	mTableMask = table_size - 1;
+
+	LLFile::mkdir(dirname);
+	std::string index_filename = dirname + gDirUtilp->getDirDelimiter() + INDEX_FILE_NAME;
+
+	bool valid = false;
+	if (LLFile::isfile(index_filename))
+	{
+		valid = mapIndex(index_filename, false);
+		if (!valid)
+		{
+			llinfos << "Cache store in " << dirname << " has a different layout, recreating" << llendl;
+			closeLocked();
+			removeFiles(dirname);
+		}
+	}
+	if (!valid)
+	{
+		if (!mapIndex(index_filename, true))
+		{
+			closeLocked();
+			return false;
+		}
+		initIndex();
+	}
+	else if (!mHeader->mClean)
+	{
+		llwarns << "Cache store in " << dirname << " was not closed cleanly, rebuilding index" << llendl;
+		rebuildIndexLocked();
+	}
+
+	U32 segments = (mMaxPages + STORE_SEGMENT_PAGES - 1) / STORE_SEGMENT_PAGES;
+	mSegments.assign(segments, (LLMappedFile*)NULL);
+	mSegmentLastUse.assign(segments, 0);
+	U32 chunks = (mMaxEntries + HEADER_CHUNK_ENTRIES - 1) / HEADER_CHUNK_ENTRIES;
+	mHeaderChunks.assign(chunks, (LLMappedFile*)NULL);
+	mHeaderChunkLastUse.assign(chunks, 0);
+
+	// Anything that happens from here until close() may leave the index
+	// inconsistent on disk.
+	mHeader->mClean = 0;
+	mIndexFile->flush();
+	return true;
+}
+
+// The index file holds only the tables every lookup touches.  The header
+// records would be most of it (a fifth of the whole texture cache), so
+// they live in their own chunk files, mapped as they are used.
+bool LLMappedCacheStore::mapIndex(const std::string& filename, bool create)
+{
+	U64 header_bytes = align8(sizeof(FileHeader));
+	U64 table_bytes = align8((U64)(mTableMask + 1) * sizeof(S32));
+	U64 entry_bytes = align8((U64)mMaxEntries * sizeof(Entry));
+	U64 page_bytes = align8((U64)mMaxPages * sizeof(S32));
+	U64 total = header_bytes + table_bytes + entry_bytes + page_bytes;
+
+	if (create)
+	{
+		LLFile::remove(filename);
+	}
+
+	mIndexFile = new LLMappedFile;
+	if (!mIndexFile->open(filename, create ? total : 0))
+	{
+		delete mIndexFile;
+		mIndexFile = NULL;
+		return false;
+	}
+	if (mIndexFile->getSize() != total)
+	{
+		return false;
+	}
+
+	U8* base = mIndexFile->getData();
+	mHeader = (FileHeader*)base;
+	base += header_bytes;
+	mHashTable = (S32*)base;
+	base += table_bytes;
+	mEntries = (Entry*)base;
+	base += entry_bytes;
+	mPageTable = (S32*)base;
+
+	if (!create)
+	{
+		return mHeader->mMagic == STORE_MAGIC
+			&& mHeader->mVersion == STORE_VERSION
+			&& mHeader->mHeaderSize == mHeaderSize
+			&& mHeader->mMaxEntries == mMaxEntries
+			&& mHeader->mTableSize == mTableMask + 1
+			&& mHeader->mPageSize == STORE_PAGE_SIZE
+			&& mHeader->mMaxPages == mMaxPages
+			&& mHeader->mSegmentPages == STORE_SEGMENT_PAGES;
+	}
+	return true;
+}
+
+void LLMappedCacheStore::initIndex()
+{
+	mHeader->mMagic = STORE_MAGIC;
+	mHeader->mVersion = STORE_VERSION;
+	mHeader->mHeaderSize = mHeaderSize;
+	mHeader->mMaxEntries = mMaxEntries;
+	mHeader->mTableSize = mTableMask + 1;
+	mHeader->mPageSize = STORE_PAGE_SIZE;
+	mHeader->mMaxPages = mMaxPages;
+	mHeader->mSegmentPages = STORE_SEGMENT_PAGES;
+
+	mHeader->mClean = 0;
+	mHeader->mEntryCount = 0;
+	mHeader->mNextEntry = 0;
+	mHeader->mFreeEntry = -1;
+	mHeader->mNextPage = 0;
+	mHeader->mFreePage = -1;
+	mHeader->mFreePageCount = 0;
+	mHeader->mPagesUsed = 0;
+	mHeader->mLRUHead = -1;
+	mHeader->mLRUTail = -1;
+	mHeader->mDataBytes = 0;
+
+	for (U32 i = 0; i <= mTableMask; ++i)
+	{
+		mHashTable[i] = -1;
+	}
+}
+
+void LLMappedCacheStore::close()
+{
+	LLMutexLock lock(&mMutex);
+	closeLocked();
+}
+
+void LLMappedCacheStore::closeLocked()
+{
+	for (U32 i = 0; i < mSegments.size(); ++i)
+	{
+		delete mSegments[i];
+	}
+	mSegments.clear();
+	mSegmentLastUse.clear();
+	mMappedSegments = 0;
+	for (U32 i = 0; i < mHeaderChunks.size(); ++i)
+	{
+		delete mHeaderChunks[i];
+	}
+	mHeaderChunks.clear();
+	mHeaderChunkLastUse.clear();
+	mMappedHeaderChunks = 0;
+
+	if (mIndexFile)
+	{
+		if (mHeader && mHeader->mMagic == STORE_MAGIC)
+		{
+			mHeader->mClean = 1;
+		}
+		delete mIndexFile;
+		mIndexFile = NULL;
+	}
+	mHeader = NULL;
+	mHashTable = NULL;
+	mEntries = NULL;
+	mPageTable = NULL;
+}
+
+void LLMappedCacheStore::clear()
+{
+	LLMutexLock lock(&mMutex);
+	if (mIndexFile)
+	{
+		initIndex();
+	}
+}
+
+void LLMappedCacheStore::flush()
+{
+	LLMutexLock lock(&mMutex);
+	for (U32 i = 0; i < mSegments.size(); ++i)
+	{
+		if (mSegments[i])
+		{
+			mSegments[i]->flush();
+		}
+	}
+	for (U32 i = 0; i < mHeaderChunks.size(); ++i)
+	{
+		if (mHeaderChunks[i])
+		{
+			mHeaderChunks[i]->flush();
+		}
+	}
+	if (mIndexFile)
+	{
+		mIndexFile->flush();
+	}
+}
+
+//----------------------------------------------------------------------------
+// hash table
+
+U32 LLMappedCacheStore::hashID(const LLUUID& id) const
+{
+	// UUIDs are random enough that folding the words is sufficient
+	U32 words[4];
+	memcpy(words, id.mData, sizeof(words));
+	return words[0] ^ words[1] ^ words[2] ^ words[3];
+}
+
+S32 LLMappedCacheStore::findEntry(const LLUUID& id) const
+{
+	U32 slot = hashID(id) & mTableMask;
+	while (mHashTable[slot] >= 0)
+	{
+		S32 idx = mHashTable[slot];
+		if (mEntries[idx].mID == id)
+		{
+			return idx;
+		}
+		slot = (slot + 1) & mTableMask;
+	}
+	return -1;
+}
+
+void LLMappedCacheStore::insertHash(S32 idx)
+{
+	U32 slot = hashID(mEntries[idx].mID) & mTableMask;
+	while (mHashTable[slot] >= 0)
+	{
+		slot = (slot + 1) & mTableMask;
+	}
+	mHashTable[slot] = idx;
+}
+
+void LLMappedCacheStore::eraseHash(S32 idx)
+{
+	U32 slot = hashID(mEntries[idx].mID) & mTableMask;
+	while (mHashTable[slot] != idx)
+	{
+		if (mHashTable[slot] < 0)
+		{
+			return;
+		}
+		slot = (slot + 1) & mTableMask;
+	}
+
+	// Shift later members of the probe run back so that no lookup
+	// crosses an empty slot before reaching its entry.
+	U32 hole = slot;
+	U32 next = slot;
+	while (true)
+	{
+		next = (next + 1) & mTableMask;
+		if (mHashTable[next] < 0)
+		{
+			break;
+		}
+		U32 home = hashID(mEntries[mHashTable[next]].mID) & mTableMask;
+		bool movable = (next > hole) ? (home <= hole || home > next)
+									 : (home <= hole && home > next);
+		if (movable)
+		{
+			mHashTable[hole] = mHashTable[next];
+			hole = next;
+		}
+	}
+	mHashTable[hole] = -1;
+}
+
+//----------------------------------------------------------------------------
+// LRU
+
+void LLMappedCacheStore::lruUnlink(S32 idx)
+{
+	Entry& entry = mEntries[idx];
+	if (entry.mPrev >= 0)
+	{
+		mEntries[entry.mPrev].mNext = entry.mNext;
+	}
+	else
+	{
+		mHeader->mLRUHead = entry.mNext;
+	}
+	if (entry.mNext >= 0)
+	{
+		mEntries[entry.mNext].mPrev = entry.mPrev;
+	}
+	else
+	{
+		mHeader->mLRUTail = entry.mPrev;
+	}
+	entry.mPrev = entry.mNext = -1;
+}
+
+void LLMappedCacheStore::lruPushFront(S32 idx)
+{
+	Entry& entry = mEntries[idx];
+	entry.mPrev = -1;
+	entry.mNext = mHeader->mLRUHead;
+	if (mHeader->mLRUHead >= 0)
+	{
+		mEntries[mHeader->mLRUHead].mPrev = idx;
+	}
+	else
+	{
+		mHeader->mLRUTail = idx;
+	}
+	mHeader->mLRUHead = idx;
+}
+
+//----------------------------------------------------------------------------
+// allocation
+
+S32 LLMappedCacheStore::allocEntry()
+{
+	if (mHeader->mFreeEntry < 0 && mHeader->mNextEntry >= mMaxEntries)
+	{
+		if (!evictOne(-1))
+		{
+			return -1;
+		}
+	}
+
+	S32 idx;
+	if (mHeader->mFreeEntry >= 0)
+	{
+		idx = mHeader->mFreeEntry;
+		mHeader->mFreeEntry = mEntries[idx].mNext;
+	}
+	else
+	{
+		idx = (S32)mHeader->mNextEntry++;
+	}
+
+	Entry& entry = mEntries[idx];
+	entry.mImageSize = 0;
+	entry.mDataSize = 0;
+	entry.mTime = 0;
+	entry.mPrev = entry.mNext = -1;
+	entry.mFirstPage = -1;
+	mHeader->mEntryCount++;
+	return idx;
+}
+
+void LLMappedCacheStore::freeEntry(S32 idx)
+{
+	Entry& entry = mEntries[idx];
+	eraseHash(idx);
+	lruUnlink(idx);
+	freePages(entry.mFirstPage);
+	mHeader->mDataBytes -= entry.mDataSize;
+	entry.mID.setNull();
+	entry.mFirstPage = -1;
+	entry.mDataSize = -1;
+	entry.mNext = mHeader->mFreeEntry;
+	mHeader->mFreeEntry = idx;
+	mHeader->mEntryCount--;
+}
+
+void LLMappedCacheStore::freePages(S32 first_page)
+{
+	S32 page = first_page;
+	while (page >= 0)
+	{
+		S32 next = mPageTable[page];
+		mPageTable[page] = mHeader->mFreePage;
+		mHeader->mFreePage = page;
+		mHeader->mFreePageCount++;
+		mHeader->mPagesUsed--;
+		page = next;
+	}
+}
+
+bool LLMappedCacheStore::reservePages(U32 count, S32 keep_idx)
+{
+	if (count > mMaxPages)
+	{
+		return false;
+	}
+	while (mHeader->mFreePageCount + (mMaxPages - mHeader->mNextPage) < count)
+	{
+		if (!evictOne(keep_idx))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+S32 LLMappedCacheStore::allocPage()
+{
+	S32 page;
+	if (mHeader->mFreePage >= 0)
+	{
+		page = mHeader->mFreePage;
+		mHeader->mFreePage = mPageTable[page];
+		mHeader->mFreePageCount--;
+	}
+	else
+	{
+		llassert(mHeader->mNextPage < mMaxPages);
+		page = (S32)mHeader->mNextPage++;
+	}
+	mPageTable[page] = -1;
+	mHeader->mPagesUsed++;
+	return page;
+}
+
+bool LLMappedCacheStore::evictOne(S32 keep_idx)
+{
+	S32 idx = mHeader->mLRUTail;
+	if (idx >= 0 && idx == keep_idx)
+	{
+		idx = mEntries[idx].mPrev;
+	}
+	if (idx < 0)
+	{
+		return false;
+	}
+	freeEntry(idx);
+	mEvictions++;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// segments and header chunks
+
+std::string LLMappedCacheStore::getSegmentFileName(U32 segment) const
+{
+	return mDirName + gDirUtilp->getDirDelimiter() + SEGMENT_FILE_PREFIX + llformat("%u", segment);
+}
+
+std::string LLMappedCacheStore::getHeaderChunkFileName(U32 chunk) const
+{
+	return mDirName + gDirUtilp->getDirDelimiter() + HEADER_FILE_PREFIX + llformat("%u", chunk);
+}
+
+// Returns files[index], mapping it if needed and unmapping the least
+// recently used file of the set when max_mapped are already mapped.
+LLMappedFile* LLMappedCacheStore::getMappedFile(std::vector<LLMappedFile*>& files, std::vector<U32>& last_use,
+												U32& mapped, U32 max_mapped, U32 index,
+												const std::string& filename, U64 size)
+{
+	last_use[index] = ++mMapUseCounter;
+	if (files[index])
+	{
+		return files[index];
+	}
+
+	if (mapped >= max_mapped)
+	{
+		U32 oldest = 0;
+		U32 oldest_use = U32_MAX;
+		for (U32 i = 0; i < files.size(); ++i)
+		{
+			if (files[i] && last_use[i] < oldest_use)
+			{
+				oldest = i;
+				oldest_use = last_use[i];
+			}
+		}
+		delete files[oldest];
+		files[oldest] = NULL;
+		mapped--;
+	}
+
+	LLMappedFile* file = new LLMappedFile;
+	if (!file->open(filename, size))
+	{
+		delete file;
+		return NULL;
+	}
+	files[index] = file;
+	mapped++;
+	return file;
+}
+
+LLMappedFile* LLMappedCacheStore::getSegment(U32 segment)
+{
+	if (segment >= mSegments.size())
+	{
+		return NULL;
+	}
+	U32 pages = llmin(STORE_SEGMENT_PAGES, mMaxPages - segment * STORE_SEGMENT_PAGES);
+	return getMappedFile(mSegments, mSegmentLastUse, mMappedSegments, MAX_MAPPED_SEGMENTS,
+						 segment, getSegmentFileName(segment), (U64)pages * STORE_PAGE_SIZE);
+}
+
+U8* LLMappedCacheStore::getPage(S32 page)
+{
+	LLMappedFile* file = getSegment((U32)page / STORE_SEGMENT_PAGES);
+	if (!file)
+	{
+		return NULL;
+	}
+	return file->getData() + (U64)((U32)page % STORE_SEGMENT_PAGES) * STORE_PAGE_SIZE;
+}
+
+U8* LLMappedCacheStore::getHeaderData(S32 idx)
+{
+	U32 chunk = (U32)idx / HEADER_CHUNK_ENTRIES;
+	if (chunk >= mHeaderChunks.size())
+	{
+		return NULL;
+	}
+	U32 entries = llmin(HEADER_CHUNK_ENTRIES, mMaxEntries - chunk * HEADER_CHUNK_ENTRIES);
+	LLMappedFile* file = getMappedFile(mHeaderChunks, mHeaderChunkLastUse, mMappedHeaderChunks, MAX_MAPPED_HEADER_CHUNKS,
+									   chunk, getHeaderChunkFileName(chunk), (U64)entries * mHeaderSize);
+	if (!file)
+	{
+		return NULL;
+	}
+	return file->getData() + (U64)((U32)idx % HEADER_CHUNK_ENTRIES) * mHeaderSize;
+}
+
+//----------------------------------------------------------------------------
+// public accessors
+
+bool LLMappedCacheStore::getInfo(const LLUUID& id, S32& imagesize, S32& datasize)
+{
+	LLMutexLock lock(&mMutex);
+	if (!mIndexFile)
+	{
+		return false;
+	}
+	S32 idx = findEntry(id);
+	if (idx < 0)
+	{
+		return false;
+	}
+	imagesize = mEntries[idx].mImageSize;
+	datasize = mEntries[idx].mDataSize;
+	return true;
+}
+
+S32 LLMappedCacheStore::read(const LLUUID& id, S32 offset, S32 max_size, U8*& data, S32& imagesize)
+{
+	data = NULL;
+	LLMutexLock lock(&mMutex);
+	if (!mIndexFile)
+	{
+		return -1;
+	}
+	S32 idx = findEntry(id);
+	if (idx < 0)
+	{
+		mMisses++;
+		return -1;
+	}
+	mHits++;
+
+	Entry& entry = mEntries[idx];
+	imagesize = entry.mImageSize;
+	entry.mTime = (U32)time(NULL);
+	lruUnlink(idx);
+	lruPushFront(idx);
+
+	if (offset < 0)
+	{
+		offset = 0;
+	}
+	S32 size = llmin(max_size, entry.mDataSize - offset);
+	if (size <= 0)
+	{
+		return 0;
+	}
+
+	data = new U8[size];
+	S32 copied = 0;
+	if (offset < mHeaderSize)
+	{
+		U8* src = getHeaderData(idx);
+		if (!src)
+		{
+			llwarns << "Cache store entry " << id << " is missing header data" << llendl;
+			delete[] data;
+			data = NULL;
+			freeEntry(idx);
+			return -1;
+		}
+		S32 n = llmin(size, mHeaderSize - offset);
+		memcpy(data, src + offset, n);
+		copied = n;
+	}
+	if (copied < size)
+	{
+		U32 body_offset = (U32)(offset + copied - mHeaderSize);
+		S32 page = entry.mFirstPage;
+		for (U32 skip = body_offset / STORE_PAGE_SIZE; skip > 0 && page >= 0; --skip)
+		{
+			page = mPageTable[page];
+		}
+		U32 page_offset = body_offset % STORE_PAGE_SIZE;
+		while (copied < size)
+		{
+			U8* src = page >= 0 ? getPage(page) : NULL;
+			if (!src)
+			{
+				llwarns << "Cache store entry " << id << " is missing body data" << llendl;
+				delete[] data;
+				data = NULL;
+				freeEntry(idx);
+				return -1;
+			}
+			S32 n = llmin(size - copied, (S32)(STORE_PAGE_SIZE - page_offset));
+			memcpy(data + copied, src + page_offset, n);
+			copied += n;
+			page_offset = 0;
+			page = mPageTable[page];
+		}
+	}
+	return size;
+}
+
+bool LLMappedCacheStore::write(const LLUUID& id, const U8* data, S32 datasize, S32 imagesize)
+{
+	LLMutexLock lock(&mMutex);
+	if (!mIndexFile || datasize <= 0 || id.isNull())
+	{
+		return false;
+	}
+	U32 num_pages = pages_for(datasize, mHeaderSize);
+	if (num_pages > mMaxPages)
+	{
+		return false;
+	}
+
+	S32 idx = findEntry(id);
+	if (idx >= 0)
+	{
+		Entry& entry = mEntries[idx];
+		if (entry.mImageSize == imagesize && entry.mDataSize >= datasize)
+		{
+			// already have at least this much of the same image
+			entry.mTime = (U32)time(NULL);
+			lruUnlink(idx);
+			lruPushFront(idx);
+			return true;
+		}
+		freePages(entry.mFirstPage);
+		entry.mFirstPage = -1;
+		mHeader->mDataBytes -= entry.mDataSize;
+		entry.mDataSize = 0;
+		lruUnlink(idx);
+	}
+	else
+	{
+		idx = allocEntry();
+		if (idx < 0)
+		{
+			return false;
+		}
+		mEntries[idx].mID = id;
+		insertHash(idx);
+	}
+	lruPushFront(idx);
+
+	if (!reservePages(num_pages, idx))
+	{
+		freeEntry(idx);
+		return false;
+	}
+
+	Entry& entry = mEntries[idx];
+	entry.mImageSize = imagesize;
+	entry.mTime = (U32)time(NULL);
+
+	S32 header_bytes = llmin(datasize, mHeaderSize);
+	if (header_bytes > 0)
+	{
+		U8* dst = getHeaderData(idx);
+		if (!dst)
+		{
+			llwarns << "Unable to map cache store header data for " << id << llendl;
+			freeEntry(idx);
+			return false;
+		}
+		memcpy(dst, data, header_bytes);
+	}
+
+	// Link the whole chain into the entry first so that a failure part
+	// way through can be cleaned up by freeEntry().
+	S32 prev = -1;
+	for (U32 i = 0; i < num_pages; ++i)
+	{
+		S32 page = allocPage();
+		if (prev < 0)
+		{
+			entry.mFirstPage = page;
+		}
+		else
+		{
+			mPageTable[prev] = page;
+		}
+		prev = page;
+	}
+
+	S32 copied = header_bytes;
+	for (S32 page = entry.mFirstPage; page >= 0; page = mPageTable[page])
+	{
+		U8* dst = getPage(page);
+		if (!dst)
+		{
+			llwarns << "Unable to map cache store segment for " << id << llendl;
+			freeEntry(idx);
+			return false;
+		}
+		S32 n = llmin(datasize - copied, (S32)STORE_PAGE_SIZE);
+		memcpy(dst, data + copied, n);
+		copied += n;
+	}
+
+	entry.mDataSize = datasize;
+	mHeader->mDataBytes += datasize;
+	return true;
+}
+
+bool LLMappedCacheStore::remove(const LLUUID& id)
+{
+	LLMutexLock lock(&mMutex);
+	if (!mIndexFile)
+	{
+		return false;
+	}
+	S32 idx = findEntry(id);
+	if (idx < 0)
+	{
+		return false;
+	}
+	freeEntry(idx);
+	return true;
+}
+
+U32 LLMappedCacheStore::getEntryCount()
+{
+	LLMutexLock lock(&mMutex);
+	return mHeader ? mHeader->mEntryCount : 0;
+}
+
+U64 LLMappedCacheStore::getBodyBytes()
+{
+	LLMutexLock lock(&mMutex);
+	return mHeader ? mHeader->mDataBytes : 0;
+}
+
+U64 LLMappedCacheStore::getMaxBodyBytes() const
+{
+	return (U64)mMaxPages * STORE_PAGE_SIZE;
+}
+
+//----------------------------------------------------------------------------
+// recovery
+
+struct LLCacheStoreEntryTimeLess
+{
+	LLCacheStoreEntryTimeLess(const std::vector<U32>& times) : mTimes(times) {}
+	bool operator()(S32 a, S32 b) const { return mTimes[a] < mTimes[b]; }
+	const std::vector<U32>& mTimes;
+};
+
+void LLMappedCacheStore::rebuildIndex()
+{
+	LLMutexLock lock(&mMutex);
+	if (mIndexFile)
+	{
+		rebuildIndexLocked();
+	}
+}
+
+void LLMappedCacheStore::rebuildIndexLocked()
+{
+
+	U32 num_entries = llmin(mHeader->mNextEntry, mMaxEntries);
+	U32 num_pages = llmin(mHeader->mNextPage, mMaxPages);
+	mHeader->mNextEntry = num_entries;
+	mHeader->mNextPage = num_pages;
+
+	for (U32 i = 0; i <= mTableMask; ++i)
+	{
+		mHashTable[i] = -1;
+	}
+
+	// Walk each live entry's page chain; an entry whose chain is the
+	// wrong length or runs into another entry's pages is dropped.
+	std::vector<U8> page_used(num_pages, 0);
+	std::vector<S32> live;
+	std::vector<U32> times(num_entries, 0);
+	std::vector<S32> chain;
+	for (U32 i = 0; i < num_entries; ++i)
+	{
+		Entry& entry = mEntries[i];
+		entry.mPrev = entry.mNext = -1;
+		if (entry.mDataSize < 0 || entry.mID.isNull() || findEntry(entry.mID) >= 0)
+		{
+			continue;
+		}
+		U32 expected = pages_for(entry.mDataSize, mHeaderSize);
+		bool valid = true;
+		chain.clear();
+		for (S32 page = entry.mFirstPage; page >= 0; page = mPageTable[page])
+		{
+			if ((U32)page >= num_pages || page_used[page] || chain.size() >= expected)
+			{
+				valid = false;
+				break;
+			}
+			page_used[page] = 1;
+			chain.push_back(page);
+		}
+		if (!valid || chain.size() != expected)
+		{
+			for (U32 p = 0; p < chain.size(); ++p)
+			{
+				page_used[chain[p]] = 0;
+			}
+			continue;
+		}
+		insertHash(i);
+		live.push_back(i);
+		times[i] = entry.mTime;
+	}
+
+	// free lists
+	mHeader->mFreeEntry = -1;
+	for (S32 i = (S32)num_entries - 1; i >= 0; --i)
+	{
+		if (findEntry(mEntries[i].mID) != i)
+		{
+			mEntries[i].mID.setNull();
+			mEntries[i].mDataSize = -1;
+			mEntries[i].mFirstPage = -1;
+			mEntries[i].mNext = mHeader->mFreeEntry;
+			mHeader->mFreeEntry = i;
+		}
+	}
+	mHeader->mFreePage = -1;
+	mHeader->mFreePageCount = 0;
+	for (S32 p = (S32)num_pages - 1; p >= 0; --p)
+	{
+		if (!page_used[p])
+		{
+			mPageTable[p] = mHeader->mFreePage;
+			mHeader->mFreePage = p;
+			mHeader->mFreePageCount++;
+		}
+	}
+
+	// LRU from the access times, most recent at the head
+	std::sort(live.begin(), live.end(), LLCacheStoreEntryTimeLess(times));
+	mHeader->mLRUHead = mHeader->mLRUTail = -1;
+	mHeader->mDataBytes = 0;
+	for (U32 i = 0; i < live.size(); ++i)
+	{
+		lruPushFront(live[i]);
+		mHeader->mDataBytes += mEntries[live[i]].mDataSize;
+	}
+	mHeader->mEntryCount = live.size();
+	mHeader->mPagesUsed = num_pages - mHeader->mFreePageCount;
+
+	llinfos << "Rebuilt cache store index: " << live.size() << " entries" << llendl;
+}
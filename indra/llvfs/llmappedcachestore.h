@@ -0,0 +1,177 @@
+/** 
+ * @file llmappedcachestore.h
+ * @brief Memory-mapped, UUID indexed store for cached asset data.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#ifndef LL_LLMAPPEDCACHESTORE_H
+#define LL_LLMAPPEDCACHESTORE_H
+
+#include <string>
+#include <vector>
+
+#include "llthread.h"
+#include "lluuid.h"
+
+class LLMappedFile;
+
+// Stores UUID keyed blobs (the texture cache uses it for texture headers
+// and bodies) in memory-mapped files:
+//
+// [dir]/store.index
+//  File header, an open-addressed UUID hash table, the entry records
+//  (which also form the LRU list) and the page table.
+// [dir]/store.hdr.N
+//  A fixed size header record per entry holding the first bytes of each
+//  blob, in chunks of entries.
+// [dir]/store.seg.N
+//  Body data, in fixed size pages chained through the page table.
+//
+// Everything is persistent, so opening a populated store only maps the
+// index; there is nothing to parse.  Header chunks and body segments are
+// mapped as they are used.  Lookups are a hash probe, LRU updates and
+// evictions are O(1), and reads are memcpy()s out of the mappings.  If
+// the store was not closed cleanly the index is rebuilt from the entry
+// records on the next open.
+//
+// All public methods are thread safe.
+class LLMappedCacheStore
+{
+public:
+	LLMappedCacheStore();
+	~LLMappedCacheStore();
+
+	// Opens or creates the store in dirname.  A store created with other
+	// limits is discarded and recreated.  max_body_bytes is rounded up to
+	// a whole number of pages.
+	bool open(const std::string& dirname, S32 header_size, U32 max_entries, U64 max_body_bytes);
+	void close();
+	bool isOpen() const								{ return mIndexFile != NULL; }
+
+	// Drops every entry, keeping the files.
+	void clear();
+	// Deletes the files of a closed store.
+	static void removeFiles(const std::string& dirname);
+	static bool filesExist(const std::string& dirname);
+
+	// Returns false if id is not stored.  datasize is the number of bytes
+	// stored for it, which may be less than imagesize.
+	bool getInfo(const LLUUID& id, S32& imagesize, S32& datasize);
+	bool exists(const LLUUID& id)					{ S32 i, d; return getInfo(id, i, d); }
+
+	// Copies up to max_size stored bytes starting at offset into a new[]
+	// buffer owned by the caller, and marks the entry as recently used.
+	// Returns the number of bytes read, or -1 if id is not stored.
+	S32 read(const LLUUID& id, S32 offset, S32 max_size, U8*& data, S32& imagesize);
+
+	// Stores datasize bytes for id, replacing any shorter data, evicting
+	// least recently used entries to make room.  Returns false if the
+	// data can not fit in the store at all.
+	bool write(const LLUUID& id, const U8* data, S32 datasize, S32 imagesize);
+
+	bool remove(const LLUUID& id);
+
+	// Forces dirty pages of the mapped files out to disk.
+	void flush();
+
+	// Rebuilds the hash table, free lists and LRU from the entry records.
+	// Done automatically when opening a store that was not closed
+	// cleanly.
+	void rebuildIndex();
+
+	// stats
+	U32 getEntryCount();
+	U32 getMaxEntries() const						{ return mMaxEntries; }
+	U64 getBodyBytes();
+	U64 getMaxBodyBytes() const;
+	U32 getHits() const								{ return mHits; }
+	U32 getMisses() const							{ return mMisses; }
+	U32 getEvictions() const						{ return mEvictions; }
+
+private:
+	struct FileHeader;
+	struct Entry;
+
+	bool mapIndex(const std::string& filename, bool create);
+	void initIndex();
+	void closeLocked();
+	void rebuildIndexLocked();
+
+	U32 hashID(const LLUUID& id) const;
+	S32 findEntry(const LLUUID& id) const;
+	void insertHash(S32 idx);
+	void eraseHash(S32 idx);
+
+	void lruUnlink(S32 idx);
+	void lruPushFront(S32 idx);
+
+	S32 allocEntry();
+	void freeEntry(S32 idx);
+	void freePages(S32 first_page);
+	bool reservePages(U32 count, S32 keep_idx);
+	S32 allocPage();
+	bool evictOne(S32 keep_idx);
+
+	LLMappedFile* getMappedFile(std::vector<LLMappedFile*>& files, std::vector<U32>& last_use,
+								U32& mapped, U32 max_mapped, U32 index,
+								const std::string& filename, U64 size);
+	U8* getPage(S32 page);
+	LLMappedFile* getSegment(U32 segment);
+	std::string getSegmentFileName(U32 segment) const;
+	U8* getHeaderData(S32 idx);
+	std::string getHeaderChunkFileName(U32 chunk) const;
+
+	FileHeader* mHeader;
+	S32* mHashTable;
+	Entry* mEntries;
+	S32* mPageTable;
+
+	LLMutex mMutex;
+	std::string mDirName;
+	LLMappedFile* mIndexFile;
+	std::vector<LLMappedFile*> mSegments;
+	std::vector<U32> mSegmentLastUse;
+	U32 mMappedSegments;
+	std::vector<LLMappedFile*> mHeaderChunks;
+	std::vector<U32> mHeaderChunkLastUse;
+	U32 mMappedHeaderChunks;
+	U32 mMapUseCounter;
+
+	S32 mHeaderSize;
+	U32 mMaxEntries;
+	U32 mTableMask;
+	U32 mMaxPages;
+
+	U32 mHits;
+	U32 mMisses;
+	U32 mEvictions;
+};
+
+#endif // LL_LLMAPPEDCACHESTORE_H
@@ -0,0 +1,228 @@
+/** 
+ * @file llmappedfile.cpp
+ * @brief Read/write memory mapping of a whole file.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#include "linden_common.h"
+
+#include "llmappedfile.h"
+
+#if LL_WINDOWS
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+class LLMappedFilePlatformImpl
+{
+public:
+#if LL_WINDOWS
+	LLMappedFilePlatformImpl() : mFile(INVALID_HANDLE_VALUE), mMapping(NULL) {}
+	HANDLE mFile;
+	HANDLE mMapping;
+#else
+	LLMappedFilePlatformImpl() : mFD(-1) {}
+	int mFD;
+#endif
+};
+
+LLMappedFile::LLMappedFile() :
+	mImpl(new LLMappedFilePlatformImpl),
+	mData(NULL),
+	mSize(0)
+{
+}
+
+LLMappedFile::~LLMappedFile()
+{
+	close();
+	delete mImpl;
+}
+
+#if LL_WINDOWS
+
+bool LLMappedFile::open(const std::string& filename, U64 size)
+{
+	close();
+	mFileName = filename;
+
+	llutf16string utf16filename = utf8str_to_utf16str(filename);
+	mImpl->mFile = CreateFileW(utf16filename.c_str(), GENERIC_READ | GENERIC_WRITE,
+							   FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+							   FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mImpl->mFile == INVALID_HANDLE_VALUE)
+	{
+		llwarns << "Unable to open " << filename << " error " << GetLastError() << llendl;
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	GetFileSizeEx(mImpl->mFile, &file_size);
+	if (size < (U64)file_size.QuadPart)
+	{
+		size = (U64)file_size.QuadPart;
+	}
+	if (!size)
+	{
+		close();
+		return false;
+	}
+
+	// CreateFileMapping() grows the file to the mapping size
+	mImpl->mMapping = CreateFileMapping(mImpl->mFile, NULL, PAGE_READWRITE,
+									   (DWORD)(size >> 32), (DWORD)(size & 0xFFFFFFFF), NULL);
+	if (!mImpl->mMapping)
+	{
+		llwarns << "Unable to map " << filename << " error " << GetLastError() << llendl;
+		close();
+		return false;
+	}
+
+	mData = (U8*)MapViewOfFile(mImpl->mMapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+	if (!mData)
+	{
+		llwarns << "Unable to map view of " << filename << " error " << GetLastError() << llendl;
+		close();
+		return false;
+	}
+	mSize = size;
+	return true;
+}
+
+void LLMappedFile::close()
+{
+	if (mData)
+	{
+		UnmapViewOfFile(mData);
+		mData = NULL;
+	}
+	if (mImpl->mMapping)
+	{
+		CloseHandle(mImpl->mMapping);
+		mImpl->mMapping = NULL;
+	}
+	if (mImpl->mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mImpl->mFile);
+		mImpl->mFile = INVALID_HANDLE_VALUE;
+	}
+	mSize = 0;
+}
+
+bool LLMappedFile::flush()
+{
+	if (!mData)
+	{
+		return false;
+	}
+	return FlushViewOfFile(mData, (SIZE_T)mSize) && FlushFileBuffers(mImpl->mFile);
+}
+
+#else // LL_WINDOWS
+
+bool LLMappedFile::open(const std::string& filename, U64 size)
+{
+	close();
+	mFileName = filename;
+
+	mImpl->mFD = ::open(filename.c_str(), O_RDWR | O_CREAT, 0600);
+	if (mImpl->mFD < 0)
+	{
+		llwarns << "Unable to open " << filename << " errno " << errno << llendl;
+		return false;
+	}
+
+	struct stat file_status;
+	if (fstat(mImpl->mFD, &file_status) != 0)
+	{
+		llwarns << "Unable to stat " << filename << " errno " << errno << llendl;
+		close();
+		return false;
+	}
+	if (size < (U64)file_status.st_size)
+	{
+		size = (U64)file_status.st_size;
+	}
+	else if (size > (U64)file_status.st_size
+			 && ftruncate(mImpl->mFD, (off_t)size) != 0)
+	{
+		llwarns << "Unable to grow " << filename << " to " << size << " errno " << errno << llendl;
+		close();
+		return false;
+	}
+	if (!size)
+	{
+		close();
+		return false;
+	}
+
+	void* data = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, mImpl->mFD, 0);
+	if (data == MAP_FAILED)
+	{
+		llwarns << "Unable to map " << filename << " errno " << errno << llendl;
+		close();
+		return false;
+	}
+	mData = (U8*)data;
+	mSize = size;
+	return true;
+}
+
+void LLMappedFile::close()
+{
+	if (mData)
+	{
+		munmap(mData, (size_t)mSize);
+		mData = NULL;
+	}
+	if (mImpl->mFD >= 0)
+	{
+		::close(mImpl->mFD);
+		mImpl->mFD = -1;
+	}
+	mSize = 0;
+}
+
+bool LLMappedFile::flush()
+{
+	if (!mData)
+	{
+		return false;
+	}
+	return msync(mData, (size_t)mSize, MS_SYNC) == 0;
+}
+
+#endif // LL_WINDOWS
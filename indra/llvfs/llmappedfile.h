@@ -0,0 +1,75 @@
+/** 
+ * @file llmappedfile.h
+ * @brief Read/write memory mapping of a whole file.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#ifndef LL_LLMAPPEDFILE_H
+#define LL_LLMAPPEDFILE_H
+
+#include <string>
+
+#include "stdtypes.h"
+
+class LLMappedFilePlatformImpl;
+
+// Maps a whole file into memory for reading and writing.  The file is
+// created or grown to the requested size when it is opened.  Changes made
+// through getData() are written back by the OS; flush() forces them out.
+class LLMappedFile
+{
+public:
+	LLMappedFile();
+	~LLMappedFile();
+
+	// Opens (creating if needed) and maps filename.  If size is larger
+	// than the file, the file is extended with zeros.  If size is 0 the
+	// current file size is used, and an empty file fails to map.
+	bool open(const std::string& filename, U64 size = 0);
+	void close();
+	bool flush();
+
+	bool isOpen() const			{ return mData != NULL; }
+	U8* getData() const			{ return mData; }
+	U64 getSize() const			{ return mSize; }
+	const std::string& getFileName() const { return mFileName; }
+
+private:
+	// not copyable
+	LLMappedFile(const LLMappedFile&);
+	LLMappedFile& operator=(const LLMappedFile&);
+
+	LLMappedFilePlatformImpl* mImpl;
+	std::string mFileName;
+	U8* mData;
+	U64 mSize;
+};
+
+#endif // LL_LLMAPPEDFILE_H
@@ -0,0 +1,551 @@
+/** 
+ * @file llobjectcachefile.cpp
+ * @brief Memory-mapped, indexed region object cache file.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "llobjectcachefile.h"
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+
+#include "llfile.h"
+#include "llmappedfile.h"
+
+// Fixed size file header.  The first three fields are where earlier
+// cache versions kept theirs.
+struct LLObjectCacheFile::Header
+{
+	U32 mZero;
+	U32 mVersion;
+	U8 mCacheID[UUID_BYTES];
+	U32 mDataEnd;		// end of the record log
+	U32 mIndexOffset;	// 0 while the index is being rewritten
+	U32 mIndexCount;
+	U32 mDeadBytes;
+};
+
+static const U32 HEADER_SIZE = 64;
+
+// Leave room to append to the log without remapping on every save.
+static const U32 GROW_SLACK = 64 * 1024;
+
+LLObjectCacheFile::LLObjectCacheFile()
+:	mFile(NULL),
+	mLiveCount(0),
+	mDeadBytes(0),
+	mDataEnd(0),
+	mDirty(false)
+{
+}
+
+LLObjectCacheFile::~LLObjectCacheFile()
+{
+	close();
+}
+
+bool LLObjectCacheFile::open(const std::string& filename, const LLUUID& cache_id)
+{
+	close();
+	mFileName = filename;
+	mCacheID = cache_id;
+
+	if (!LLFile::isfile(filename))
+	{
+		return false;
+	}
+
+	mFile = new LLMappedFile;
+	if (!mFile->open(filename) || mFile->getSize() < HEADER_SIZE)
+	{
+		close();
+		return false;
+	}
+
+	const Header* header = (const Header*)mFile->getData();
+	if (header->mZero != 0
+		|| header->mVersion != VERSION
+		|| memcmp(header->mCacheID, cache_id.mData, UUID_BYTES) != 0
+		|| header->mDataEnd < HEADER_SIZE
+		|| header->mDataEnd > mFile->getSize())
+	{
+		// another version, another region, or garbage: start over on save
+		close();
+		return false;
+	}
+
+	mDataEnd = header->mDataEnd;
+	mDeadBytes = llmin(header->mDeadBytes, mDataEnd - HEADER_SIZE);
+	if (!readIndex())
+	{
+		llinfos << "Rebuilding object cache index for " << filename << llendl;
+		rebuildIndex();
+	}
+	return mLiveCount > 0;
+}
+
+void LLObjectCacheFile::close()
+{
+	if (mFile && mDirty && mDataEnd)
+	{
+		// persist removals made since the last save
+		save(std::vector<Entry>(), S32_MAX);
+	}
+	delete mFile;
+	mFile = NULL;
+	mIndex.clear();
+	mLiveCount = 0;
+	mDeadBytes = 0;
+	mDataEnd = 0;
+	mDirty = false;
+}
+
+bool LLObjectCacheFile::readIndex()
+{
+	const Header* header = (const Header*)mFile->getData();
+	U64 index_end = (U64)header->mIndexOffset + (U64)header->mIndexCount * sizeof(IndexEntry);
+	if (header->mIndexOffset < mDataEnd || index_end > mFile->getSize())
+	{
+		return false;
+	}
+
+	mIndex.resize(header->mIndexCount);
+	if (!mIndex.empty())
+	{
+		memcpy(&mIndex[0], mFile->getData() + header->mIndexOffset, mIndex.size() * sizeof(IndexEntry));
+	}
+	mLiveCount = (S32)mIndex.size();
+
+	// the index is written sorted with live entries only; check that
+	// rather than trust it
+	for (S32 i = 0; i < mLiveCount; ++i)
+	{
+		if (mIndex[i].mOffset < HEADER_SIZE
+			|| mIndex[i].mOffset >= mDataEnd
+			|| (i > 0 && !(mIndex[i - 1] < mIndex[i])))
+		{
+			mIndex.clear();
+			mLiveCount = 0;
+			return false;
+		}
+	}
+	return true;
+}
+
+void LLObjectCacheFile::rebuildIndex()
+{
+	mIndex.clear();
+	mLiveCount = 0;
+	mDeadBytes = 0;
+
+	U32 offset = HEADER_SIZE;
+	const U8* data = mFile->getData();
+	while (offset + sizeof(Record) <= mDataEnd)
+	{
+		const Record* record = (const Record*)(data + offset);
+		if (record->mSize < 0 || offset + getRecordSize(record->mSize) > mDataEnd)
+		{
+			break;
+		}
+		IndexEntry entry;
+		entry.mLocalID = record->mLocalID;
+		entry.mCRC = record->mCRC;
+		entry.mOffset = offset;
+		mIndex.push_back(entry);
+		offset += getRecordSize(record->mSize);
+	}
+	// drop whatever follows the last whole record
+	mDataEnd = offset;
+
+	// a stable sort keeps duplicates in log order, so the last of each
+	// run is the newest
+	std::stable_sort(mIndex.begin(), mIndex.end());
+	index_t::iterator out = mIndex.begin();
+	for (index_t::iterator it = mIndex.begin(); it != mIndex.end(); ++it)
+	{
+		if (out != mIndex.begin() && (out - 1)->mLocalID == it->mLocalID)
+		{
+			mDeadBytes += getRecordSize(getRecordAt((out - 1)->mOffset)->mSize);
+			*(out - 1) = *it;
+		}
+		else
+		{
+			*out++ = *it;
+		}
+	}
+	mIndex.erase(out, mIndex.end());
+	mLiveCount = (S32)mIndex.size();
+	mDirty = true;
+}
+
+// static
+bool LLObjectCacheFile::offsetLess(const IndexEntry& lhs, const IndexEntry& rhs)
+{
+	return lhs.mOffset < rhs.mOffset;
+}
+
+// static
+U32 LLObjectCacheFile::getRecordSize(S32 data_size)
+{
+	return sizeof(Record) + (((U32)data_size + 3) & ~3);
+}
+
+U32 LLObjectCacheFile::getLiveBytes() const
+{
+	return mDataEnd ? mDataEnd - HEADER_SIZE - mDeadBytes : 0;
+}
+
+const LLObjectCacheFile::Record* LLObjectCacheFile::getRecordAt(U32 offset) const
+{
+	if (!mFile || offset < HEADER_SIZE || offset + sizeof(Record) > mDataEnd)
+	{
+		return NULL;
+	}
+	const Record* record = (const Record*)(mFile->getData() + offset);
+	if (record->mSize < 0 || offset + getRecordSize(record->mSize) > mDataEnd)
+	{
+		return NULL;
+	}
+	return record;
+}
+
+LLObjectCacheFile::IndexEntry* LLObjectCacheFile::findIndex(U32 local_id)
+{
+	IndexEntry key;
+	key.mLocalID = local_id;
+	index_t::iterator it = std::lower_bound(mIndex.begin(), mIndex.end(), key);
+	if (it == mIndex.end() || it->mLocalID != local_id)
+	{
+		return NULL;
+	}
+	return &(*it);
+}
+
+const LLObjectCacheFile::IndexEntry* LLObjectCacheFile::findIndex(U32 local_id) const
+{
+	return const_cast<LLObjectCacheFile*>(this)->findIndex(local_id);
+}
+
+bool LLObjectCacheFile::find(U32 local_id, U32& crc) const
+{
+	const IndexEntry* entry = findIndex(local_id);
+	if (!entry || !entry->mOffset)
+	{
+		return false;
+	}
+	crc = entry->mCRC;
+	return true;
+}
+
+const LLObjectCacheFile::Record* LLObjectCacheFile::getRecord(U32 local_id, const U8*& data) const
+{
+	const IndexEntry* entry = findIndex(local_id);
+	const Record* record = entry ? getRecordAt(entry->mOffset) : NULL;
+	if (!record || record->mLocalID != local_id)
+	{
+		data = NULL;
+		return NULL;
+	}
+	data = (const U8*)record + sizeof(Record);
+	return record;
+}
+
+void LLObjectCacheFile::remove(U32 local_id)
+{
+	IndexEntry* entry = findIndex(local_id);
+	if (!entry || !entry->mOffset)
+	{
+		return;
+	}
+	const Record* record = getRecordAt(entry->mOffset);
+	U32 size = record ? getRecordSize(record->mSize) : 0;
+	mDeadBytes += size;
+	entry->mOffset = 0;
+	mLiveCount--;
+	mDirty = true;
+}
+
+bool LLObjectCacheFile::save(const std::vector<Entry>& entries, S32 max_entries)
+{
+	if (entries.empty() && !mDirty)
+	{
+		return true;
+	}
+	if (!mFile || !mDataEnd)
+	{
+		// nothing usable on disk
+		return compact(entries, max_entries);
+	}
+
+	// see what the file would look like after appending
+	S32 live_count = mLiveCount;
+	U32 live_bytes = getLiveBytes();
+	U32 dead_bytes = mDeadBytes;
+	for (std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		live_bytes += getRecordSize(it->mRecord.mSize);
+		const IndexEntry* entry = findIndex(it->mRecord.mLocalID);
+		const Record* record = entry ? getRecordAt(entry->mOffset) : NULL;
+		if (record)
+		{
+			U32 size = getRecordSize(record->mSize);
+			dead_bytes += size;
+			live_bytes -= llmin(size, live_bytes);
+		}
+		else
+		{
+			live_count++;
+		}
+	}
+
+	if (dead_bytes > live_bytes || live_count > max_entries)
+	{
+		return compact(entries, max_entries);
+	}
+	return append(entries);
+}
+
+void LLObjectCacheFile::writeHeader(U8* dest, U32 data_end, U32 index_offset, U32 index_count) const
+{
+	Header header;
+	memset(&header, 0, sizeof(header));
+	header.mVersion = VERSION;
+	memcpy(header.mCacheID, mCacheID.mData, UUID_BYTES);
+	header.mDataEnd = data_end;
+	header.mIndexOffset = index_offset;
+	header.mIndexCount = index_count;
+	header.mDeadBytes = mDeadBytes;
+	memcpy(dest, &header, sizeof(header));
+}
+
+bool LLObjectCacheFile::append(const std::vector<Entry>& entries)
+{
+	// update the index first, while old records are still mapped
+	U32 data_end = mDataEnd;
+	index_t added;
+	for (std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		const Record& record = it->mRecord;
+		remove(record.mLocalID);
+
+		IndexEntry* entry = findIndex(record.mLocalID);
+		if (entry)
+		{
+			entry->mCRC = record.mCRC;
+			entry->mOffset = data_end;
+		}
+		else
+		{
+			IndexEntry new_entry;
+			new_entry.mLocalID = record.mLocalID;
+			new_entry.mCRC = record.mCRC;
+			new_entry.mOffset = data_end;
+			added.push_back(new_entry);
+		}
+		mLiveCount++;
+		data_end += getRecordSize(record.mSize);
+	}
+	if (!added.empty())
+	{
+		std::sort(added.begin(), added.end());
+		index_t merged;
+		merged.reserve(mIndex.size() + added.size());
+		std::merge(mIndex.begin(), mIndex.end(), added.begin(), added.end(), std::back_inserter(merged));
+		mIndex.swap(merged);
+	}
+
+	// live entries only go to disk
+	index_t::iterator out = mIndex.begin();
+	for (index_t::iterator it = mIndex.begin(); it != mIndex.end(); ++it)
+	{
+		if (it->mOffset)
+		{
+			*out++ = *it;
+		}
+	}
+	mIndex.erase(out, mIndex.end());
+
+	U64 needed = (U64)data_end + mIndex.size() * sizeof(IndexEntry);
+	if (needed > mFile->getSize())
+	{
+		mFile->close();
+		if (!mFile->open(mFileName, needed + GROW_SLACK))
+		{
+			llwarns << "Unable to grow object cache " << mFileName << llendl;
+			delete mFile;
+			mFile = NULL;
+			mDataEnd = 0;
+			mDirty = false;
+			return false;
+		}
+	}
+
+	// invalidate the index until the new one is complete, so a crash
+	// part way through leaves a file that is rebuilt from the log
+	U8* base = mFile->getData();
+	writeHeader(base, mDataEnd, 0, 0);
+
+	U32 offset = mDataEnd;
+	for (std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		memcpy(base + offset, &it->mRecord, sizeof(Record));
+		if (it->mRecord.mSize > 0)
+		{
+			memcpy(base + offset + sizeof(Record), it->mData, it->mRecord.mSize);
+		}
+		offset += getRecordSize(it->mRecord.mSize);
+	}
+	mDataEnd = data_end;
+	if (!mIndex.empty())
+	{
+		memcpy(base + mDataEnd, &mIndex[0], mIndex.size() * sizeof(IndexEntry));
+	}
+	writeHeader(base, mDataEnd, mDataEnd, mIndex.size());
+	mFile->flush();
+	mDirty = false;
+	return true;
+}
+
+bool LLObjectCacheFile::compact(const std::vector<Entry>& entries, S32 max_entries)
+{
+	// gather the surviving records oldest first: the old log in file
+	// order, then the new entries
+	std::vector<Entry> records;
+	index_t by_offset;
+	for (index_t::const_iterator it = mIndex.begin(); it != mIndex.end(); ++it)
+	{
+		if (it->mOffset)
+		{
+			by_offset.push_back(*it);
+		}
+	}
+	std::sort(by_offset.begin(), by_offset.end(), offsetLess);
+
+	std::set<U32> replaced;
+	for (std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		replaced.insert(it->mRecord.mLocalID);
+	}
+	for (index_t::const_iterator it = by_offset.begin(); it != by_offset.end(); ++it)
+	{
+		const Record* record = getRecordAt(it->mOffset);
+		if (record && !replaced.count(it->mLocalID))
+		{
+			Entry entry;
+			entry.mRecord = *record;
+			entry.mData = (const U8*)record + sizeof(Record);
+			records.push_back(entry);
+		}
+	}
+	records.insert(records.end(), entries.begin(), entries.end());
+
+	// keep the newest max_entries
+	std::set<U32> seen;
+	std::vector<Entry> kept;
+	for (std::vector<Entry>::reverse_iterator it = records.rbegin(); it != records.rend(); ++it)
+	{
+		if ((S32)kept.size() >= max_entries)
+		{
+			break;
+		}
+		if (seen.insert(it->mRecord.mLocalID).second)
+		{
+			kept.push_back(*it);
+		}
+	}
+	std::reverse(kept.begin(), kept.end());
+
+	std::string temp_name = mFileName + ".tmp";
+	LLFILE* fp = LLFile::fopen(temp_name, "wb");
+	if (!fp)
+	{
+		llwarns << "Unable to write object cache " << temp_name << llendl;
+		return false;
+	}
+
+	index_t index;
+	index.reserve(kept.size());
+	U32 offset = HEADER_SIZE;
+	bool success = true;
+	std::vector<U8> header(HEADER_SIZE, 0);
+	success &= fwrite(&header[0], HEADER_SIZE, 1, fp) == 1;
+	for (std::vector<Entry>::const_iterator it = kept.begin(); it != kept.end() && success; ++it)
+	{
+		static const U8 pad[4] = { 0, 0, 0, 0 };
+		U32 data_size = it->mRecord.mSize;
+		U32 padding = getRecordSize(data_size) - sizeof(Record) - data_size;
+		success &= fwrite(&it->mRecord, sizeof(Record), 1, fp) == 1;
+		success &= !data_size || fwrite(it->mData, data_size, 1, fp) == 1;
+		success &= !padding || fwrite(pad, padding, 1, fp) == 1;
+
+		IndexEntry entry;
+		entry.mLocalID = it->mRecord.mLocalID;
+		entry.mCRC = it->mRecord.mCRC;
+		entry.mOffset = offset;
+		index.push_back(entry);
+		offset += getRecordSize(data_size);
+	}
+	std::sort(index.begin(), index.end());
+	success &= index.empty() || fwrite(&index[0], index.size() * sizeof(IndexEntry), 1, fp) == 1;
+
+	mDeadBytes = 0;
+	writeHeader(&header[0], offset, offset, index.size());
+	success &= fseek(fp, 0, SEEK_SET) == 0;
+	success &= fwrite(&header[0], HEADER_SIZE, 1, fp) == 1;
+	success &= fclose(fp) == 0;
+
+	// the old file (and so every record pointer) goes away here
+	delete mFile;
+	mFile = NULL;
+	mIndex.clear();
+	mDirty = false;
+	mDataEnd = 0;
+
+	if (!success)
+	{
+		llwarns << "Failed writing object cache " << temp_name << llendl;
+		LLFile::remove(temp_name);
+		return false;
+	}
+	LLFile::remove(mFileName);
+	if (LLFile::rename(temp_name, mFileName) != 0)
+	{
+		llwarns << "Unable to replace object cache " << mFileName << llendl;
+		LLFile::remove(temp_name);
+		return false;
+	}
+
+	open(mFileName, mCacheID);
+	return true;
+}
@@ -0,0 +1,154 @@
+/** 
+ * @file llobjectcachefile.h
+ * @brief Memory-mapped, indexed region object cache file.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#ifndef LL_LLOBJECTCACHEFILE_H
+#define LL_LLOBJECTCACHEFILE_H
+
+#include <string>
+#include <vector>
+
+#include "lluuid.h"
+
+class LLMappedFile;
+
+// Region object cache file (objects_X_Y.slc).  Object update blobs are
+// stored as an append-only log of records, followed by an index of
+// (local id, crc, offset) sorted by local id:
+//
+//  file header | record | record | ... | index | (unused space)
+//
+// Opening a cache maps the file and reads the index; records are only
+// touched when a caller asks for one.  Saving appends new records and
+// rewrites the index in place.  Replaced or removed records stay in the
+// log as dead space until it outgrows the live data, at which point the
+// file is rewritten with only the live records.
+//
+// Not thread safe.
+class LLObjectCacheFile
+{
+public:
+	// Bumped whenever the on-disk layout or the object update format
+	// changes.  Older viewers check the same header position against
+	// their own version and discard the file.
+	static const U32 VERSION = 15;
+
+	// Fixed size part of every record in the log, followed by mSize
+	// bytes of data padded to 4 bytes.
+	struct Record
+	{
+		U32 mLocalID;
+		U32 mCRC;
+		S32 mHitCount;
+		S32 mDupeCount;
+		S32 mCRCChangeCount;
+		S32 mSize;
+	};
+
+	// A record to be written, with its data owned by the caller.
+	struct Entry
+	{
+		Record mRecord;
+		const U8* mData;
+	};
+
+	LLObjectCacheFile();
+	~LLObjectCacheFile();
+
+	// Maps filename and reads its index.  A missing file, or one written
+	// by another version or for another cache id, opens as an empty
+	// cache which is replaced on the next save.  Returns true if any
+	// entries were found.
+	bool open(const std::string& filename, const LLUUID& cache_id);
+	void close();
+
+	S32 getNumEntries() const						{ return mLiveCount; }
+
+	// Looks up local_id in the index.  Returns false if there is no live
+	// record for it.
+	bool find(U32 local_id, U32& crc) const;
+
+	// Returns the record for local_id and points data at its bytes, or
+	// NULL.  Both point into the mapping and are only valid until the
+	// next save() or close().
+	const Record* getRecord(U32 local_id, const U8*& data) const;
+
+	// Marks the record for local_id dead.
+	void remove(U32 local_id);
+
+	// Appends entries, which must have distinct local ids, replacing any
+	// records with the same ids, and writes the index.  If the dead space
+	// has grown larger than the live data, or there are more than
+	// max_entries live records, the file is compacted instead, keeping
+	// the newest max_entries records.
+	bool save(const std::vector<Entry>& entries, S32 max_entries);
+
+	// stats
+	U32 getLiveBytes() const;
+	U32 getDeadBytes() const						{ return mDeadBytes; }
+
+private:
+	struct Header;
+	struct IndexEntry
+	{
+		U32 mLocalID;
+		U32 mCRC;
+		U32 mOffset;	// 0 for a dead entry
+
+		bool operator<(const IndexEntry& rhs) const	{ return mLocalID < rhs.mLocalID; }
+	};
+	typedef std::vector<IndexEntry> index_t;
+
+	bool readIndex();
+	void rebuildIndex();
+	const Record* getRecordAt(U32 offset) const;
+	IndexEntry* findIndex(U32 local_id);
+	const IndexEntry* findIndex(U32 local_id) const;
+	bool append(const std::vector<Entry>& entries);
+	bool compact(const std::vector<Entry>& entries, S32 max_entries);
+	void writeHeader(U8* dest, U32 data_end, U32 index_offset, U32 index_count) const;
+
+	static bool offsetLess(const IndexEntry& lhs, const IndexEntry& rhs);
+	static U32 getRecordSize(S32 data_size);
+
+	std::string mFileName;
+	LLUUID mCacheID;
+	LLMappedFile* mFile;
+	index_t mIndex;
+	S32 mLiveCount;
+	U32 mDeadBytes;
+	U32 mDataEnd;
+	bool mDirty;
+};
+
+#endif // LL_LLOBJECTCACHEFILE_H
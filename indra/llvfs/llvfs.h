@@ -86,8 +86,12 @@ private:
 			const BOOL read_only, 
 			const U32 presize, 
 			const BOOL remove_after_crash);
+protected:
+	// For alternative backends (see LLLogVFS), which keep their own
+	// storage and override the public file interface below.
+	LLVFS(const BOOL read_only);
 public:
-	~LLVFS();
+	virtual ~LLVFS();
 
 	// Use this function normally to create LLVFS files
 	// Pass 0 to not presize
@@ -101,40 +105,40 @@ public:
 	EVFSValid getValidState() const	{ return mValid; }
 
 	// ---------- The following fucntions lock/unlock mDataMutex ----------
-	BOOL getExists(const LLUUID &file_id, const LLAssetType::EType file_type);
-	S32	 getSize(const LLUUID &file_id, const LLAssetType::EType file_type);
+	virtual BOOL getExists(const LLUUID &file_id, const LLAssetType::EType file_type);
+	virtual S32	 getSize(const LLUUID &file_id, const LLAssetType::EType file_type);
 
-	BOOL checkAvailable(S32 max_size);
+	virtual BOOL checkAvailable(S32 max_size);
 	
-	S32  getMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type);
-	BOOL setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type, S32 max_size);
+	virtual S32  getMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type);
+	virtual BOOL setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type, S32 max_size);
 
-	void renameFile(const LLUUID &file_id, const LLAssetType::EType file_type,
+	virtual void renameFile(const LLUUID &file_id, const LLAssetType::EType file_type,
 		const LLUUID &new_id, const LLAssetType::EType &new_type);
-	void removeFile(const LLUUID &file_id, const LLAssetType::EType file_type);
+	virtual void removeFile(const LLUUID &file_id, const LLAssetType::EType file_type);
 
-	S32 getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8 *buffer, S32 location, S32 length);
-	S32 storeData(const LLUUID &file_id, const LLAssetType::EType file_type, const U8 *buffer, S32 location, S32 length);
+	virtual S32 getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8 *buffer, S32 location, S32 length);
+	virtual S32 storeData(const LLUUID &file_id, const LLAssetType::EType file_type, const U8 *buffer, S32 location, S32 length);
 
-	void incLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
-	void decLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
-	BOOL isLocked(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+	virtual void incLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+	virtual void decLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+	virtual BOOL isLocked(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
 	// ----------------------------------------------------------------
 
 	// Used to trigger evil WinXP behavior of "preloading" entire file into memory.
-	void pokeFiles();
+	virtual void pokeFiles();
 
 	// Verify that the index file contents match the in-memory file structure
 	// Very slow, do not call routinely. JC
-	void audit();
+	virtual void audit();
 	// Check for uninitialized blocks.  Slow, do not call in release. JC
-	void checkMem();
+	virtual void checkMem();
 	// for debugging, prints a map of the vfs
-	void dumpMap();
-	void dumpLockCounts();
-	void dumpStatistics();
-	void listFiles();
-	void dumpFiles();
+	virtual void dumpMap();
+	virtual void dumpLockCounts();
+	virtual void dumpStatistics();
+	virtual void listFiles();
+	virtual void dumpFiles();
 
 protected:
 	void removeFileBlock(LLVFSFileBlock *fileblock);
@@ -33,6 +33,7 @@
 
 #include "linden_common.h"
 #include "llvfsthread.h"
+#include "llfasttimer.h"
 #include "llstl.h"
 
 //============================================================================
@@ -272,8 +273,11 @@ void LLVFSThread::Request::deleteRequest()
 	LLQueuedThread::QueuedRequest::deleteRequest();
 }
 
+static LLFastTimer::DeclareTimer FTM_VFS_WORK("VFS Worker");
+
 bool LLVFSThread::Request::processRequest()
 {
+	LLThreadFastTimer t(FTM_VFS_WORK);
 	bool complete = false;
 	if (mOperation ==  FILE_READ)
 	{
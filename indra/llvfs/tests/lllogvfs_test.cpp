@@ -0,0 +1,473 @@
+/** 
+ * @file lllogvfs_test.cpp
+ * @brief Tests and benchmark for the log-structured VFS.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "../lllogvfs.h"
+
+#include "../lldir.h"
+#include "llapr.h"
+#include "llfile.h"
+#include "llthread.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const LLAssetType::EType TYPE = LLAssetType::AT_TEXTURE;
+
+	// fills a buffer with a pattern derived from the id and a
+	// generation, so contents can be verified without keeping a copy
+	void make_data(const LLUUID& id, S32 generation, std::vector<U8>& data, S32 size)
+	{
+		data.resize(size);
+		for (S32 i = 0; i < size; ++i)
+		{
+			data[i] = (U8)(id.mData[i % UUID_BYTES] + i / UUID_BYTES + generation * 31);
+		}
+	}
+
+	// Mixed readers and writers on a shared set of files, like the
+	// texture fetch and decode threads.
+	class VFSWorker : public LLThread
+	{
+	public:
+		VFSWorker(LLVFS* vfs, const std::vector<LLUUID>& ids, S32 file_size, S32 ops, U32 seed)
+		:	LLThread("VFSWorker"),
+			mVFS(vfs),
+			mIDs(ids),
+			mFileSize(file_size),
+			mOps(ops),
+			mSeed(seed),
+			mDone(0),
+			mErrors(0)
+		{
+		}
+
+		bool isDone() { return mDone != 0; }
+		S32 getErrors() const { return mErrors; }
+
+	protected:
+		/*virtual*/ void run()
+		{
+			std::vector<U8> buffer(mFileSize);
+			for (S32 i = 0; i < mOps; ++i)
+			{
+				mSeed = mSeed * 1103515245 + 12345;
+				const LLUUID& id = mIDs[(mSeed >> 8) % mIDs.size()];
+				if ((mSeed >> 4) % 4 == 0)
+				{
+					// rewrite the first quarter
+					mVFS->storeData(id, TYPE, &buffer[0], 0, mFileSize / 4);
+				}
+				else if (mVFS->getData(id, TYPE, &buffer[0], 0, mFileSize) != mFileSize)
+				{
+					mErrors++;
+				}
+			}
+			mDone = 1;
+		}
+
+	private:
+		LLVFS* mVFS;
+		const std::vector<LLUUID>& mIDs;
+		S32 mFileSize;
+		S32 mOps;
+		U32 mSeed;
+		LLAtomicU32 mDone;
+		S32 mErrors;
+	};
+
+	// Renames each file back and forth between two ids.
+	class VFSRenamer : public LLThread
+	{
+	public:
+		VFSRenamer(LLVFS* vfs, std::vector<LLUUID>& ids, std::vector<LLUUID>& other_ids, S32 rounds)
+		:	LLThread("VFSRenamer"),
+			mVFS(vfs),
+			mIDs(ids),
+			mOtherIDs(other_ids),
+			mRounds(rounds),
+			mDone(0)
+		{
+		}
+
+		bool isDone() { return mDone != 0; }
+
+	protected:
+		/*virtual*/ void run()
+		{
+			for (S32 round = 0; round < mRounds; ++round)
+			{
+				for (U32 i = 0; i < mIDs.size(); ++i)
+				{
+					mVFS->renameFile(mIDs[i], TYPE, mOtherIDs[i], TYPE);
+					std::swap(mIDs[i], mOtherIDs[i]);
+				}
+			}
+			mDone = 1;
+		}
+
+	private:
+		LLVFS* mVFS;
+		std::vector<LLUUID>& mIDs;
+		std::vector<LLUUID>& mOtherIDs;
+		S32 mRounds;
+		LLAtomicU32 mDone;
+	};
+
+	// returns seconds taken by num_threads workers
+	F32 run_workers(LLVFS* vfs, const std::vector<LLUUID>& ids, S32 file_size, S32 num_threads, S32 ops)
+	{
+		std::vector<VFSWorker*> workers;
+		for (S32 i = 0; i < num_threads; ++i)
+		{
+			workers.push_back(new VFSWorker(vfs, ids, file_size, ops, i + 1));
+		}
+		LLTimer timer;
+		for (S32 i = 0; i < num_threads; ++i)
+		{
+			workers[i]->start();
+		}
+		for (S32 i = 0; i < num_threads; ++i)
+		{
+			while (!workers[i]->isDone())
+			{
+				ms_sleep(1);
+			}
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+		S32 errors = 0;
+		for (S32 i = 0; i < num_threads; ++i)
+		{
+			while (!workers[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			errors += workers[i]->getErrors();
+			delete workers[i];
+		}
+		tut::ensure_equals("short reads", errors, 0);
+		return elapsed;
+	}
+}
+
+namespace tut
+{
+	struct LLLogVFSTest
+	{
+		LLLogVFSTest()
+		:	mVFS(NULL)
+		{
+			mDirName = std::string(LLFile::tmpdir()) + llformat("lllogvfs_test_%d", (S32)LLUUID::getRandomSeed() & 0xffff);
+			removeFiles();
+		}
+
+		~LLLogVFSTest()
+		{
+			delete mVFS;
+			removeFiles();
+		}
+
+		void removeFiles()
+		{
+			std::string prefix = mDirName + gDirUtilp->getDirDelimiter();
+			LLFile::remove(prefix + "data");
+			LLFile::remove(prefix + "index");
+			LLFile::remove(prefix + "index.tmp");
+			LLFile::rmdir(mDirName);
+		}
+
+		void open(U32 max_size = 4 * 1024 * 1024, U32 segment_size = LLLogVFS::DEFAULT_SEGMENT_SIZE)
+		{
+			delete mVFS;
+			mVFS = LLLogVFS::createLogVFS(mDirName, FALSE, max_size, segment_size);
+			ensure("opened", mVFS != NULL);
+		}
+
+		void writeFile(const LLUUID& id, S32 size, S32 generation = 0)
+		{
+			std::vector<U8> data;
+			make_data(id, generation, data, size);
+			ensure("reserved", mVFS->setMaxSize(id, TYPE, size));
+			ensure_equals("stored", mVFS->storeData(id, TYPE, &data[0], 0, size), size);
+		}
+
+		// checks the contents of id, written as source_id if it was renamed
+		void ensureFile(const LLUUID& id, S32 size, S32 generation = 0, const LLUUID& source_id = LLUUID::null)
+		{
+			std::string name = id.asString();
+			ensure(name, mVFS->getExists(id, TYPE));
+			ensure_equals(name.c_str(), mVFS->getSize(id, TYPE), size);
+
+			std::vector<U8> expected, data(size);
+			make_data(source_id.isNull() ? id : source_id, generation, expected, size);
+			ensure_equals(name.c_str(), mVFS->getData(id, TYPE, &data[0], 0, size), size);
+			ensure(name, memcmp(&expected[0], &data[0], size) == 0);
+		}
+
+		std::string mDirName;
+		LLLogVFS* mVFS;
+	};
+
+	typedef test_group<LLLogVFSTest> LLLogVFSTest_t;
+	typedef LLLogVFSTest_t::object LLLogVFSTest_object_t;
+	tut::LLLogVFSTest_t tut_LLLogVFSTest("LLLogVFS");
+
+	template<> template<>
+	void LLLogVFSTest_object_t::test<1>()
+		// reads, appends and overwrites, then reopening from the index
+	{
+		open();
+		LLUUID id;
+		id.generate();
+		ensure("missing", !mVFS->getExists(id, TYPE));
+		ensure_equals("store to missing file", mVFS->storeData(id, TYPE, (const U8*)"x", 0, 1), 0);
+
+		std::vector<U8> data;
+		make_data(id, 0, data, 10000);
+		ensure("reserved", mVFS->setMaxSize(id, TYPE, 10000));
+		ensure_equals("max size", mVFS->getMaxSize(id, TYPE), 10000);
+		ensure_equals("first", mVFS->storeData(id, TYPE, &data[0], 0, 4000), 4000);
+		ensure_equals("append", mVFS->storeData(id, TYPE, &data[4000], -1, 6000), 6000);
+		ensureFile(id, 10000);
+
+		// overwrite the middle, then put it back
+		std::vector<U8> zeros(3000, 0);
+		mVFS->storeData(id, TYPE, &zeros[0], 2000, 3000);
+		std::vector<U8> buffer(10000);
+		mVFS->getData(id, TYPE, &buffer[0], 0, 10000);
+		ensure("overwritten", buffer[1999] == data[1999] && buffer[2000] == 0 && buffer[4999] == 0 && buffer[5000] == data[5000]);
+		mVFS->storeData(id, TYPE, &data[1000], 1000, 5000);
+		ensureFile(id, 10000);
+
+		ensure_equals("partial read", mVFS->getData(id, TYPE, &buffer[0], 9000, 5000), 1000);
+		ensure("partial data", memcmp(&buffer[0], &data[9000], 1000) == 0);
+		ensure_equals("reserved bytes", mVFS->getReservedBytes(), 10000U);
+
+		open();
+		ensureFile(id, 10000);
+		mVFS->audit();
+	}
+
+	template<> template<>
+	void LLLogVFSTest_object_t::test<2>()
+		// rename, remove and replaying the log without an index
+	{
+		open();
+		std::vector<LLUUID> ids(10);
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			ids[i].generate();
+			writeFile(ids[i], 1000 * (i + 1));
+		}
+
+		LLUUID new_id;
+		new_id.generate();
+		mVFS->renameFile(ids[0], TYPE, new_id, TYPE);
+		ensure("renamed away", !mVFS->getExists(ids[0], TYPE));
+		// renaming onto an existing file replaces it
+		mVFS->renameFile(ids[1], TYPE, ids[2], TYPE);
+		mVFS->removeFile(ids[3], TYPE);
+		ensure("removed", !mVFS->getExists(ids[3], TYPE));
+
+		mVFS->rebuildFromLog();
+		for (S32 pass = 0; pass < 2; ++pass)
+		{
+			ensure("renamed away", !mVFS->getExists(ids[0], TYPE));
+			ensure("replaced", !mVFS->getExists(ids[1], TYPE));
+			ensure("removed", !mVFS->getExists(ids[3], TYPE));
+			ensureFile(new_id, 1000, 0, ids[0]);
+			ensureFile(ids[2], 2000, 0, ids[1]);
+			for (U32 i = 4; i < ids.size(); ++i)
+			{
+				ensureFile(ids[i], 1000 * (i + 1));
+			}
+			ensure_equals("reserved bytes", mVFS->getReservedBytes(), (U32)(1000 + 2000 + 5000 + 6000 + 7000 + 8000 + 9000 + 10000));
+
+			// as after a crash
+			delete mVFS;
+			mVFS = NULL;
+			LLFile::remove(mDirName + gDirUtilp->getDirDelimiter() + "index");
+			open();
+		}
+		mVFS->audit();
+	}
+
+	template<> template<>
+	void LLLogVFSTest_object_t::test<3>()
+		// running out of space evicts the least recently used unlocked files
+	{
+		const S32 FILE_SIZE = 100 * 1024;
+		open(1024 * 1024);
+		std::vector<LLUUID> ids(20);
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			ids[i].generate();
+		}
+		mVFS->incLock(ids[0], TYPE, VFSLOCK_OPEN);
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			writeFile(ids[i], FILE_SIZE);
+			ms_sleep(i < 2 ? 1000 : 0);	// access times have second resolution
+		}
+		ensure("within budget", mVFS->getReservedBytes() <= mVFS->getMaxBytes());
+		ensure("locked file kept", mVFS->getExists(ids[0], TYPE));
+		ensure("oldest unlocked file evicted", !mVFS->getExists(ids[1], TYPE));
+		ensureFile(ids[19], FILE_SIZE);
+		ensure("locked", mVFS->isLocked(ids[0], TYPE, VFSLOCK_OPEN));
+		mVFS->decLock(ids[0], TYPE, VFSLOCK_OPEN);
+		ensure("unlocked", !mVFS->isLocked(ids[0], TYPE, VFSLOCK_OPEN));
+		mVFS->audit();
+	}
+
+	template<> template<>
+	void LLLogVFSTest_object_t::test<4>()
+		// rewriting files over and over cleans old segments without
+		// losing anything, before or after a replay
+	{
+		const S32 FILE_SIZE = 20000;
+		open(512 * 1024, 64 * 1024);
+		std::vector<LLUUID> ids(16);
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			ids[i].generate();
+			writeFile(ids[i], FILE_SIZE);
+		}
+		std::vector<S32> generation(ids.size(), 0);
+		for (S32 round = 1; round < 40; ++round)
+		{
+			U32 i = (round * 7) % ids.size();
+			std::vector<U8> data;
+			make_data(ids[i], round, data, FILE_SIZE);
+			ensure_equals("rewrite", mVFS->storeData(ids[i], TYPE, &data[0], 0, FILE_SIZE), FILE_SIZE);
+			generation[i] = round;
+		}
+		ensure("segments cleaned", mVFS->getCleanedSegments() > 0);
+
+		for (S32 pass = 0; pass < 2; ++pass)
+		{
+			for (U32 i = 0; i < ids.size(); ++i)
+			{
+				ensureFile(ids[i], FILE_SIZE, generation[i]);
+			}
+			mVFS->rebuildFromLog();
+		}
+		mVFS->audit();
+	}
+
+	template<> template<>
+	void LLLogVFSTest_object_t::test<6>()
+		// renames while other threads' writes keep the cleaner busy
+		// leave the renamed files intact
+	{
+		const S32 FILE_SIZE = 20000;
+		const S32 NUM_FILES = 8;
+		open(512 * 1024, 64 * 1024);
+		std::vector<LLUUID> ids(NUM_FILES), sources(NUM_FILES), other_ids(NUM_FILES), churn_ids(NUM_FILES);
+		for (S32 i = 0; i < NUM_FILES; ++i)
+		{
+			ids[i].generate();
+			sources[i] = ids[i];
+			other_ids[i].generate();
+			churn_ids[i].generate();
+			writeFile(ids[i], FILE_SIZE);
+			writeFile(churn_ids[i], FILE_SIZE);
+		}
+
+		VFSRenamer renamer(mVFS, ids, other_ids, 500);
+		renamer.start();
+		run_workers(mVFS, churn_ids, FILE_SIZE, 2, 4000);
+		while (!renamer.isDone() || !renamer.isStopped())
+		{
+			ms_sleep(1);
+		}
+		ensure("segments cleaned", mVFS->getCleanedSegments() > 0);
+
+		// the churn overwrote every segment the renamed files were in
+		// before, so stale extents would show
+		run_workers(mVFS, churn_ids, FILE_SIZE, 1, 2000);
+		for (S32 i = 0; i < NUM_FILES; ++i)
+		{
+			ensure("renamed away", !mVFS->getExists(other_ids[i], TYPE));
+			ensureFile(ids[i], FILE_SIZE, 0, sources[i]);
+		}
+		mVFS->audit();
+	}
+
+	template<> template<>
+	void LLLogVFSTest_object_t::test<5>()
+		// benchmark: concurrent readers and writers against LLVFS
+	{
+		const S32 NUM_FILES = 256;
+		const S32 FILE_SIZE = 64 * 1024;
+		const S32 NUM_THREADS = 4;
+		const S32 OPS = 2000;
+
+		std::vector<LLUUID> ids(NUM_FILES);
+		std::vector<U8> data(FILE_SIZE);
+		for (S32 i = 0; i < NUM_FILES; ++i)
+		{
+			ids[i].generate();
+		}
+
+		std::string prefix = std::string(LLFile::tmpdir()) + llformat("lllogvfs_bench_%d", (S32)LLUUID::getRandomSeed() & 0xffff);
+		std::string index_name = prefix + ".db2.x";
+		std::string data_name = prefix + ".db2";
+		LLVFS* block_vfs = LLVFS::createLLVFS(index_name, data_name, FALSE, 64 * 1024 * 1024, FALSE);
+		ensure("block vfs", block_vfs != NULL);
+		open(64 * 1024 * 1024);
+
+		LLVFS* stores[2] = { block_vfs, mVFS };
+		F32 times[2];
+		for (S32 s = 0; s < 2; ++s)
+		{
+			for (S32 i = 0; i < NUM_FILES; ++i)
+			{
+				stores[s]->setMaxSize(ids[i], TYPE, FILE_SIZE);
+				stores[s]->storeData(ids[i], TYPE, &data[0], 0, FILE_SIZE);
+			}
+			times[s] = run_workers(stores[s], ids, FILE_SIZE, NUM_THREADS, OPS);
+		}
+
+		delete block_vfs;
+		LLFile::remove(index_name);
+		LLFile::remove(data_name);
+
+		llinfos << "LLVFS vs LLLogVFS: " << NUM_THREADS << " threads doing " << OPS
+				<< " ops each (3/4 " << FILE_SIZE / 1024 << "KB reads, 1/4 writes): LLVFS "
+				<< times[0] * 1000.f << " ms, LLLogVFS " << times[1] * 1000.f << " ms" << llendl;
+	}
+}
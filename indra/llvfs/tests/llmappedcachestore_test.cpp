@@ -0,0 +1,366 @@
+/** 
+ * @file llmappedcachestore_test.cpp
+ * @brief LLMappedCacheStore test cases and benchmarks.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#include "linden_common.h"
+
+#include "../llmappedcachestore.h"
+
+#include "../lldir.h"
+#include "llfile.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const S32 HEADER_SIZE = 600;
+
+	// fills a buffer with a pattern derived from the id so contents can
+	// be verified without keeping a copy
+	void make_data(const LLUUID& id, std::vector<U8>& data, S32 size)
+	{
+		data.resize(size);
+		for (S32 i = 0; i < size; ++i)
+		{
+			data[i] = (U8)(id.mData[i % UUID_BYTES] + i / UUID_BYTES);
+		}
+	}
+
+	bool check_data(const LLUUID& id, const U8* data, S32 offset, S32 size)
+	{
+		std::vector<U8> expected;
+		make_data(id, expected, offset + size);
+		return memcmp(&expected[offset], data, size) == 0;
+	}
+}
+
+namespace tut
+{
+	struct LLMappedCacheStoreTest
+	{
+		LLMappedCacheStoreTest()
+		{
+			mDirName = std::string(LLFile::tmpdir()) + llformat("llmappedcachestore_test_%d", (S32)LLUUID::getRandomSeed() & 0xffff);
+			LLMappedCacheStore::removeFiles(mDirName);
+		}
+
+		~LLMappedCacheStoreTest()
+		{
+			mStore.close();
+			LLMappedCacheStore::removeFiles(mDirName);
+			LLFile::rmdir(mDirName);
+		}
+
+		void writeEntry(const LLUUID& id, S32 size)
+		{
+			std::vector<U8> data;
+			make_data(id, data, size);
+			ensure("write", mStore.write(id, &data[0], size, size));
+		}
+
+		void ensureEntry(const LLUUID& id, S32 size)
+		{
+			U8* data = NULL;
+			S32 imagesize = 0;
+			S32 read = mStore.read(id, 0, size, data, imagesize);
+			ensure_equals("read size", read, size);
+			ensure_equals("image size", imagesize, size);
+			ensure("read data", check_data(id, data, 0, size));
+			delete[] data;
+		}
+
+		std::string mDirName;
+		LLMappedCacheStore mStore;
+	};
+	typedef test_group<LLMappedCacheStoreTest> LLMappedCacheStoreTest_t;
+	typedef LLMappedCacheStoreTest_t::object LLMappedCacheStoreTest_object_t;
+	tut::LLMappedCacheStoreTest_t tut_LLMappedCacheStoreTest("LLMappedCacheStore");
+
+	template<> template<>
+	void LLMappedCacheStoreTest_object_t::test<1>()
+		// write, read back, partial reads, remove
+	{
+		ensure("open", mStore.open(mDirName, HEADER_SIZE, 64, 1024 * 1024));
+
+		LLUUID small_id, big_id;
+		small_id.generate();
+		big_id.generate();
+		writeEntry(small_id, 100);
+		writeEntry(big_id, 50000);
+		ensure_equals("entries", mStore.getEntryCount(), 2U);
+		ensure_equals("bytes", mStore.getBodyBytes(), (U64)50100);
+
+		ensureEntry(small_id, 100);
+		ensureEntry(big_id, 50000);
+
+		// a read spanning the header record and several pages
+		U8* data = NULL;
+		S32 imagesize = 0;
+		ensure_equals("partial read", mStore.read(big_id, 500, 10000, data, imagesize), 10000);
+		ensure("partial data", check_data(big_id, data, 500, 10000));
+		delete[] data;
+
+		// reading past the end
+		ensure_equals("read past end", mStore.read(small_id, 100, 10, data, imagesize), 0);
+		ensure("no data past end", data == NULL);
+
+		ensure("remove", mStore.remove(big_id));
+		ensure("removed", !mStore.exists(big_id));
+		ensure_equals("miss", mStore.read(big_id, 0, 10, data, imagesize), -1);
+		ensure_equals("entries after remove", mStore.getEntryCount(), 1U);
+	}
+
+	template<> template<>
+	void LLMappedCacheStoreTest_object_t::test<2>()
+		// contents persist across close/open
+	{
+		ensure("open", mStore.open(mDirName, HEADER_SIZE, 64, 1024 * 1024));
+		std::vector<LLUUID> ids(10);
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			ids[i].generate();
+			writeEntry(ids[i], 1000 + i * 5000);
+		}
+		mStore.close();
+
+		ensure("reopen", mStore.open(mDirName, HEADER_SIZE, 64, 1024 * 1024));
+		ensure_equals("entries", mStore.getEntryCount(), (U32)ids.size());
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			ensureEntry(ids[i], 1000 + i * 5000);
+		}
+		mStore.close();
+
+		// different limits discard the old store
+		ensure("reopen resized", mStore.open(mDirName, HEADER_SIZE, 128, 1024 * 1024));
+		ensure_equals("entries after resize", mStore.getEntryCount(), 0U);
+	}
+
+	template<> template<>
+	void LLMappedCacheStoreTest_object_t::test<3>()
+		// least recently used entries are evicted first
+	{
+		ensure("open", mStore.open(mDirName, HEADER_SIZE, 4, 1024 * 1024));
+		LLUUID ids[5];
+		for (S32 i = 0; i < 4; ++i)
+		{
+			ids[i].generate();
+			writeEntry(ids[i], 2000);
+		}
+		// touch the oldest so the second oldest goes instead
+		ensureEntry(ids[0], 2000);
+		ids[4].generate();
+		writeEntry(ids[4], 2000);
+
+		ensure("touched entry kept", mStore.exists(ids[0]));
+		ensure("lru entry evicted", !mStore.exists(ids[1]));
+		ensure("newest entry", mStore.exists(ids[4]));
+		ensure_equals("evictions", mStore.getEvictions(), 1U);
+
+		// running out of body pages evicts as well
+		mStore.close();
+		LLMappedCacheStore::removeFiles(mDirName);
+		ensure("open small", mStore.open(mDirName, HEADER_SIZE, 64, 64 * 1024));
+		std::vector<LLUUID> big(4);
+		for (U32 i = 0; i < big.size(); ++i)
+		{
+			big[i].generate();
+			writeEntry(big[i], 20000);
+		}
+		ensure("oldest evicted for space", !mStore.exists(big[0]));
+		ensureEntry(big[3], 20000);
+		ensure("body within limit", mStore.getBodyBytes() <= mStore.getMaxBodyBytes());
+
+		std::vector<U8> too_big(128 * 1024);
+		ensure("too big rejected", !mStore.write(big[0], &too_big[0], too_big.size(), too_big.size()));
+	}
+
+	template<> template<>
+	void LLMappedCacheStoreTest_object_t::test<4>()
+		// rewriting with more data and removal keep the hash table consistent
+	{
+		ensure("open", mStore.open(mDirName, HEADER_SIZE, 256, 4 * 1024 * 1024));
+		std::vector<LLUUID> ids(200);
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			ids[i].generate();
+			writeEntry(ids[i], 600);
+		}
+		for (U32 i = 0; i < ids.size(); i += 3)
+		{
+			ensure("remove", mStore.remove(ids[i]));
+		}
+		for (U32 i = 1; i < ids.size(); i += 3)
+		{
+			writeEntry(ids[i], 9000);
+		}
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			if (i % 3 == 0)
+			{
+				ensure("removed", !mStore.exists(ids[i]));
+			}
+			else
+			{
+				ensureEntry(ids[i], i % 3 == 1 ? 9000 : 600);
+			}
+		}
+	}
+
+	template<> template<>
+	void LLMappedCacheStoreTest_object_t::test<5>()
+		// rebuilding the index after an unclean shutdown
+	{
+		ensure("open", mStore.open(mDirName, HEADER_SIZE, 64, 1024 * 1024));
+		std::vector<LLUUID> ids(20);
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			ids[i].generate();
+			writeEntry(ids[i], 3000 * (i + 1));
+		}
+		for (U32 i = 0; i < ids.size(); i += 4)
+		{
+			mStore.remove(ids[i]);
+		}
+		U64 bytes = mStore.getBodyBytes();
+
+		mStore.rebuildIndex();
+		ensure_equals("entries", mStore.getEntryCount(), 15U);
+		ensure_equals("bytes", mStore.getBodyBytes(), bytes);
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			if (i % 4 == 0)
+			{
+				ensure("removed", !mStore.exists(ids[i]));
+			}
+			else
+			{
+				ensureEntry(ids[i], 3000 * (i + 1));
+			}
+		}
+
+		// the rebuilt free lists are usable
+		LLUUID id;
+		id.generate();
+		writeEntry(id, 40000);
+		ensureEntry(id, 40000);
+	}
+
+	template<> template<>
+	void LLMappedCacheStoreTest_object_t::test<6>()
+		// benchmark: cold start, hit latency and eviction throughput
+	{
+		const U32 MAX_ENTRIES = 8192;
+		const U32 NUM_ENTRIES = 4096;
+		const S32 ENTRY_SIZE = 8192;
+		ensure("open", mStore.open(mDirName, HEADER_SIZE, MAX_ENTRIES, (U64)NUM_ENTRIES * ENTRY_SIZE));
+
+		std::vector<LLUUID> ids(NUM_ENTRIES);
+		std::vector<U8> data(ENTRY_SIZE);
+		for (U32 i = 0; i < NUM_ENTRIES; ++i)
+		{
+			ids[i].generate();
+			data[0] = (U8)i;
+			mStore.write(ids[i], &data[0], ENTRY_SIZE, ENTRY_SIZE);
+		}
+		mStore.close();
+
+		LLTimer timer;
+		ensure("reopen", mStore.open(mDirName, HEADER_SIZE, MAX_ENTRIES, (U64)NUM_ENTRIES * ENTRY_SIZE));
+		F32 open_time = timer.getElapsedTimeF32();
+		ensure_equals("entries", mStore.getEntryCount(), NUM_ENTRIES);
+
+		const U32 READ_PASSES = 4;
+		timer.reset();
+		for (U32 pass = 0; pass < READ_PASSES; ++pass)
+		{
+			for (U32 i = 0; i < NUM_ENTRIES; ++i)
+			{
+				U8* buffer = NULL;
+				S32 imagesize;
+				mStore.read(ids[i], 0, ENTRY_SIZE, buffer, imagesize);
+				delete[] buffer;
+			}
+		}
+		F32 read_time = timer.getElapsedTimeF32();
+		ensure_equals("hits", mStore.getHits(), NUM_ENTRIES * READ_PASSES);
+
+		// every write of a new id now evicts an old one
+		timer.reset();
+		for (U32 i = 0; i < NUM_ENTRIES; ++i)
+		{
+			LLUUID id;
+			id.generate();
+			mStore.write(id, &data[0], ENTRY_SIZE, ENTRY_SIZE);
+		}
+		F32 evict_time = timer.getElapsedTimeF32();
+		ensure("evicted", mStore.getEvictions() >= NUM_ENTRIES);
+
+		llinfos << "LLMappedCacheStore: open with " << NUM_ENTRIES << " entries "
+				<< open_time * 1000.f << " ms, hit "
+				<< read_time * 1000000.f / (NUM_ENTRIES * READ_PASSES) << " us/read, evicting write "
+				<< evict_time * 1000000.f / NUM_ENTRIES << " us/write" << llendl;
+	}
+
+	template<> template<>
+	void LLMappedCacheStoreTest_object_t::test<7>()
+		// header records spread over several chunk files
+	{
+		const U32 MAX_ENTRIES = 20000;
+		ensure("open", mStore.open(mDirName, HEADER_SIZE, MAX_ENTRIES, 1024 * 1024));
+		std::vector<LLUUID> ids(MAX_ENTRIES);
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			ids[i].generate();
+			writeEntry(ids[i], 100 + i % 400);
+		}
+		LLUUID big_id;
+		big_id.generate();
+		writeEntry(big_id, 5000);
+		ensure_equals("oldest evicted", mStore.getEvictions(), 1U);
+		mStore.close();
+
+		// the index no longer holds the header records
+		llstat stat_data;
+		LLFile::stat(mDirName + gDirUtilp->getDirDelimiter() + "store.index", &stat_data);
+		ensure("index size", stat_data.st_size < (S64)MAX_ENTRIES * HEADER_SIZE / 4);
+
+		ensure("reopen", mStore.open(mDirName, HEADER_SIZE, MAX_ENTRIES, 1024 * 1024));
+		ensure_equals("entries", mStore.getEntryCount(), MAX_ENTRIES);
+		for (U32 i = 1; i < ids.size(); ++i)
+		{
+			ensureEntry(ids[i], 100 + i % 400);
+		}
+		ensureEntry(big_id, 5000);
+	}
+}
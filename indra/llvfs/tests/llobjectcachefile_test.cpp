@@ -0,0 +1,340 @@
+/** 
+ * @file llobjectcachefile_test.cpp
+ * @brief LLObjectCacheFile test cases and loader benchmark.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "linden_common.h"
+
+#include "../llobjectcachefile.h"
+
+#include <map>
+
+#include "llfile.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// object data with contents derived from the local id and crc, so
+	// it can be checked without keeping a copy
+	void make_data(U32 local_id, U32 crc, std::vector<U8>& data, S32 size)
+	{
+		data.resize(size);
+		for (S32 i = 0; i < size; ++i)
+		{
+			data[i] = (U8)(local_id * 7 + crc * 13 + i);
+		}
+	}
+
+	S32 data_size(U32 local_id)
+	{
+		return 60 + (local_id * 37) % 400;
+	}
+}
+
+namespace tut
+{
+	struct LLObjectCacheFileTest
+	{
+		LLObjectCacheFileTest()
+		{
+			mFileName = std::string(LLFile::tmpdir()) + llformat("llobjectcachefile_test_%d.slc", (S32)LLUUID::getRandomSeed() & 0xffff);
+			LLFile::remove(mFileName);
+			mCacheID.generate();
+		}
+
+		~LLObjectCacheFileTest()
+		{
+			mCache.close();
+			LLFile::remove(mFileName);
+			LLFile::remove(mFileName + ".tmp");
+		}
+
+		// saves local ids [first, last) with the given crc
+		bool saveRange(U32 first, U32 last, U32 crc, S32 max_entries = 100000)
+		{
+			std::vector<std::vector<U8> > buffers(last - first);
+			std::vector<LLObjectCacheFile::Entry> entries(last - first);
+			for (U32 id = first; id < last; ++id)
+			{
+				std::vector<U8>& data = buffers[id - first];
+				make_data(id, crc, data, data_size(id));
+				LLObjectCacheFile::Entry& entry = entries[id - first];
+				memset(&entry.mRecord, 0, sizeof(entry.mRecord));
+				entry.mRecord.mLocalID = id;
+				entry.mRecord.mCRC = crc;
+				entry.mRecord.mHitCount = id % 5;
+				entry.mRecord.mSize = data.size();
+				entry.mData = &data[0];
+			}
+			return mCache.save(entries, max_entries);
+		}
+
+		void ensureEntry(U32 id, U32 crc)
+		{
+			std::string name = llformat("entry %d", id);
+			U32 found_crc = 0;
+			ensure(name.c_str(), mCache.find(id, found_crc));
+			ensure_equals(name.c_str(), found_crc, crc);
+
+			const U8* data = NULL;
+			const LLObjectCacheFile::Record* record = mCache.getRecord(id, data);
+			ensure(name.c_str(), record != NULL);
+			ensure_equals(name.c_str(), record->mLocalID, id);
+			ensure_equals(name.c_str(), record->mHitCount, (S32)(id % 5));
+			ensure_equals(name.c_str(), record->mSize, data_size(id));
+
+			std::vector<U8> expected;
+			make_data(id, crc, expected, data_size(id));
+			ensure(name.c_str(), memcmp(&expected[0], data, expected.size()) == 0);
+		}
+
+		std::string mFileName;
+		LLUUID mCacheID;
+		LLObjectCacheFile mCache;
+	};
+	typedef test_group<LLObjectCacheFileTest> LLObjectCacheFileTest_t;
+	typedef LLObjectCacheFileTest_t::object LLObjectCacheFileTest_object_t;
+	tut::LLObjectCacheFileTest_t tut_LLObjectCacheFileTest("LLObjectCacheFile");
+
+	template<> template<>
+	void LLObjectCacheFileTest_object_t::test<1>()
+		// save, reopen, look up
+	{
+		ensure("missing file is empty", !mCache.open(mFileName, mCacheID));
+		ensure("save", saveRange(1, 201, 10));
+		ensure_equals("entries", mCache.getNumEntries(), 200);
+		mCache.close();
+
+		ensure("reopen", mCache.open(mFileName, mCacheID));
+		ensure_equals("entries after reopen", mCache.getNumEntries(), 200);
+		for (U32 id = 1; id < 201; ++id)
+		{
+			ensureEntry(id, 10);
+		}
+		U32 crc;
+		const U8* data;
+		ensure("unknown id", !mCache.find(500, crc));
+		ensure("unknown record", mCache.getRecord(500, data) == NULL);
+		mCache.close();
+
+		// another region's cache is not used
+		LLUUID other_id;
+		other_id.generate();
+		ensure("other cache id", !mCache.open(mFileName, other_id));
+		ensure_equals("no entries", mCache.getNumEntries(), 0);
+	}
+
+	template<> template<>
+	void LLObjectCacheFileTest_object_t::test<2>()
+		// appending, replacing and removing
+	{
+		mCache.open(mFileName, mCacheID);
+		ensure("save", saveRange(1, 101, 10));
+		U32 live_bytes = mCache.getLiveBytes();
+
+		// replace a few, add a few
+		ensure("append", saveRange(90, 121, 11));
+		ensure_equals("entries", mCache.getNumEntries(), 120);
+		ensure("dead space from replaced records", mCache.getDeadBytes() > 0);
+		ensure("live bytes", mCache.getLiveBytes() > live_bytes);
+
+		mCache.remove(5);
+		mCache.remove(95);
+		mCache.remove(1000);
+		ensure_equals("entries after remove", mCache.getNumEntries(), 118);
+		mCache.close();
+
+		ensure("reopen", mCache.open(mFileName, mCacheID));
+		ensure_equals("entries after reopen", mCache.getNumEntries(), 118);
+		U32 crc;
+		ensure("removed", !mCache.find(5, crc));
+		ensure("removed replaced", !mCache.find(95, crc));
+		for (U32 id = 1; id < 121; ++id)
+		{
+			if (id != 5 && id != 95)
+			{
+				ensureEntry(id, id < 90 ? 10 : 11);
+			}
+		}
+	}
+
+	template<> template<>
+	void LLObjectCacheFileTest_object_t::test<3>()
+		// dead space and entry limits trigger compaction
+	{
+		mCache.open(mFileName, mCacheID);
+		ensure("save", saveRange(1, 101, 10));
+		for (U32 crc = 11; crc < 20; ++crc)
+		{
+			ensure("rewrite", saveRange(1, 101, crc));
+			ensure("dead space bounded", mCache.getDeadBytes() <= mCache.getLiveBytes());
+		}
+		for (U32 id = 1; id < 101; ++id)
+		{
+			ensureEntry(id, 19);
+		}
+
+		// over the limit, the oldest records go
+		ensure("save over limit", saveRange(101, 151, 10, 120));
+		ensure_equals("entries limited", mCache.getNumEntries(), 120);
+		ensure_equals("no dead space", mCache.getDeadBytes(), 0U);
+		U32 crc;
+		ensure("oldest dropped", !mCache.find(30, crc));
+		ensureEntry(31, 19);
+		ensureEntry(150, 10);
+	}
+
+	template<> template<>
+	void LLObjectCacheFileTest_object_t::test<4>()
+		// a file with a missing or damaged index is rebuilt from the log
+	{
+		mCache.open(mFileName, mCacheID);
+		ensure("save", saveRange(1, 51, 10));
+		ensure("append", saveRange(40, 61, 11));
+		mCache.close();
+
+		// zero the index offset in the header, as if a save was cut short
+		LLFILE* fp = LLFile::fopen(mFileName, "r+b");
+		ensure("open file", fp != NULL);
+		U32 zero = 0;
+		fseek(fp, 8 + UUID_BYTES + 4, SEEK_SET);
+		fwrite(&zero, sizeof(zero), 1, fp);
+		fclose(fp);
+
+		ensure("reopen", mCache.open(mFileName, mCacheID));
+		ensure_equals("entries", mCache.getNumEntries(), 60);
+		for (U32 id = 1; id < 61; ++id)
+		{
+			ensureEntry(id, id < 40 ? 10 : 11);
+		}
+		mCache.close();
+
+		// the rebuilt index was saved on close
+		ensure("reopen rebuilt", mCache.open(mFileName, mCacheID));
+		ensure_equals("entries after rebuild", mCache.getNumEntries(), 60);
+		mCache.close();
+
+		// a file from another version is ignored
+		fp = LLFile::fopen(mFileName, "r+b");
+		U32 version = LLObjectCacheFile::VERSION - 1;
+		fseek(fp, 4, SEEK_SET);
+		fwrite(&version, sizeof(version), 1, fp);
+		fclose(fp);
+		ensure("old version", !mCache.open(mFileName, mCacheID));
+		ensure("replaced on save", saveRange(1, 11, 12));
+		mCache.close();
+		ensure("reopen replaced", mCache.open(mFileName, mCacheID));
+		ensure_equals("entries after replace", mCache.getNumEntries(), 10);
+	}
+
+	template<> template<>
+	void LLObjectCacheFileTest_object_t::test<5>()
+		// benchmark: loading a region cache the way the previous format
+		// did versus mapping the file and materializing only cache hits
+	{
+		const U32 NUM_ENTRIES = 30000;
+		const U32 HIT_STRIDE = 20;		// 5% of the objects are looked up
+
+		// previous format: count, then per entry local id, crc, counts,
+		// size and data, all read back with fread
+		std::string legacy_name = mFileName + ".legacy";
+		LLFILE* fp = LLFile::fopen(legacy_name, "wb");
+		ensure("legacy file", fp != NULL);
+		fwrite(&NUM_ENTRIES, sizeof(NUM_ENTRIES), 1, fp);
+		std::vector<U8> data;
+		for (U32 id = 1; id <= NUM_ENTRIES; ++id)
+		{
+			S32 header[6] = { (S32)id, 10, 0, 0, 0, data_size(id) };
+			make_data(id, 10, data, header[5]);
+			fwrite(header, sizeof(header), 1, fp);
+			fwrite(&data[0], data.size(), 1, fp);
+		}
+		fclose(fp);
+		ensure("save", saveRange(1, NUM_ENTRIES + 1, 10));
+		mCache.close();
+
+		LLTimer timer;
+		fp = LLFile::fopen(legacy_name, "rb");
+		U32 count = 0;
+		fread(&count, sizeof(count), 1, fp);
+		std::map<U32, U8*> legacy;
+		for (U32 i = 0; i < count; ++i)
+		{
+			S32 header[6];
+			if (fread(header, sizeof(header), 1, fp) != 1)
+			{
+				break;
+			}
+			U8* buffer = new U8[header[5]];
+			fread(buffer, header[5], 1, fp);
+			legacy[header[0]] = buffer;
+		}
+		fclose(fp);
+		U32 legacy_hits = 0;
+		for (U32 id = 1; id <= NUM_ENTRIES; id += HIT_STRIDE)
+		{
+			legacy_hits += legacy.count(id);
+		}
+		F32 legacy_time = timer.getElapsedTimeF32();
+		for (std::map<U32, U8*>::iterator it = legacy.begin(); it != legacy.end(); ++it)
+		{
+			delete[] it->second;
+		}
+		LLFile::remove(legacy_name);
+
+		timer.reset();
+		ensure("open", mCache.open(mFileName, mCacheID));
+		F32 open_time = timer.getElapsedTimeF32();
+		U32 hits = 0;
+		for (U32 id = 1; id <= NUM_ENTRIES; id += HIT_STRIDE)
+		{
+			const U8* record_data;
+			const LLObjectCacheFile::Record* record = mCache.getRecord(id, record_data);
+			if (record)
+			{
+				U8* buffer = new U8[record->mSize];
+				memcpy(buffer, record_data, record->mSize);
+				delete[] buffer;
+				hits++;
+			}
+		}
+		F32 mapped_time = timer.getElapsedTimeF32();
+		ensure_equals("hits", hits, legacy_hits);
+
+		llinfos << "LLObjectCacheFile: " << NUM_ENTRIES << " entries, "
+				<< NUM_ENTRIES / HIT_STRIDE << " hits: fread loader "
+				<< legacy_time * 1000.f << " ms, mapped open " << open_time * 1000.f
+				<< " ms, open and hits " << mapped_time * 1000.f << " ms" << llendl;
+	}
+}
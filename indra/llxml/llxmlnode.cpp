@@ -919,6 +919,294 @@ bool LLXMLNode::getLayeredXMLNode(const std::string &xui_filename, LLXMLNodePtr&
 	return true;
 }
 
+//
+// Binary trees
+//
+// Layout, all integers little endian U32:
+//   magic, version
+//   source count, sources (length + bytes each)
+//   name count, names (length + bytes each)
+//   root node
+// and each node is
+//   name index, line number, id, version major, version minor, length,
+//   precision, type, encoding, value,
+//   attribute count, attribute nodes, child count, child nodes
+// Children are written in sibling order, so reading them back with
+// addChild() rebuilds the same sibling list and name map.
+//
+
+static const U32 BINARY_XML_MAGIC = 0x42584c4c; // "LLXB"
+static const U32 BINARY_XML_VERSION = 1;
+// far more than any merged XUI file
+static const long MAX_BINARY_XML_LENGTH = 64 * 1024 * 1024;
+
+typedef std::map<const LLStringTableEntry*, U32> binary_name_map_t;
+
+static void write_binary_u32(std::string& out, U32 value)
+{
+	out += (char)(value & 0xff);
+	out += (char)((value >> 8) & 0xff);
+	out += (char)((value >> 16) & 0xff);
+	out += (char)((value >> 24) & 0xff);
+}
+
+static void write_binary_string(std::string& out, const std::string& value)
+{
+	write_binary_u32(out, (U32)value.size());
+	out += value;
+}
+
+static void collect_binary_names(LLXMLNode* node, binary_name_map_t& names, std::vector<const LLStringTableEntry*>& order)
+{
+	if (names.insert(std::make_pair(node->getName(), (U32)order.size())).second)
+	{
+		order.push_back(node->getName());
+	}
+	for (LLXMLAttribList::iterator it = node->mAttributes.begin(); it != node->mAttributes.end(); ++it)
+	{
+		collect_binary_names(it->second, names, order);
+	}
+	for (LLXMLNodePtr child = node->getFirstChild(); child.notNull(); child = child->getNextSibling())
+	{
+		collect_binary_names(child, names, order);
+	}
+}
+
+static void write_binary_node(std::string& out, LLXMLNode* node, const binary_name_map_t& names)
+{
+	write_binary_u32(out, names.find(node->getName())->second);
+	write_binary_u32(out, (U32)node->mLineNumber);
+	write_binary_string(out, node->mID);
+	write_binary_u32(out, node->mVersionMajor);
+	write_binary_u32(out, node->mVersionMinor);
+	write_binary_u32(out, node->mLength);
+	write_binary_u32(out, node->mPrecision);
+	write_binary_u32(out, (U32)node->mType);
+	write_binary_u32(out, (U32)node->mEncoding);
+	write_binary_string(out, node->getValue());
+
+	write_binary_u32(out, (U32)node->mAttributes.size());
+	for (LLXMLAttribList::iterator it = node->mAttributes.begin(); it != node->mAttributes.end(); ++it)
+	{
+		write_binary_node(out, it->second, names);
+	}
+
+	U32 child_count = 0;
+	for (LLXMLNodePtr child = node->getFirstChild(); child.notNull(); child = child->getNextSibling())
+	{
+		++child_count;
+	}
+	write_binary_u32(out, child_count);
+	for (LLXMLNodePtr child = node->getFirstChild(); child.notNull(); child = child->getNextSibling())
+	{
+		write_binary_node(out, child, names);
+	}
+}
+
+// Bounds checked cursor over a binary tree.  Any read past the end
+// leaves the reader in the failed state and returns zeros.
+class LLBinaryXMLReader
+{
+public:
+	LLBinaryXMLReader(const U8* buffer, U32 length)
+	:	mCur(buffer),
+		mEnd(buffer + length),
+		mFailed(false)
+	{}
+
+	bool failed() const { return mFailed; }
+
+	U32 readU32()
+	{
+		if (mEnd - mCur < 4)
+		{
+			mFailed = true;
+			mCur = mEnd;
+			return 0;
+		}
+		U32 value = (U32)mCur[0] | ((U32)mCur[1] << 8) | ((U32)mCur[2] << 16) | ((U32)mCur[3] << 24);
+		mCur += 4;
+		return value;
+	}
+
+	void readString(std::string& value)
+	{
+		U32 length = readU32();
+		if ((U32)(mEnd - mCur) < length)
+		{
+			mFailed = true;
+			mCur = mEnd;
+			value.clear();
+			return;
+		}
+		value.assign((const char*)mCur, length);
+		mCur += length;
+	}
+
+	LLXMLNodePtr readNode(const std::vector<LLStringTableEntry*>& names, BOOL is_attribute, S32 depth)
+	{
+		U32 name_index = readU32();
+		// guard against corrupt files sending us off into deep recursion
+		if (mFailed || name_index >= names.size() || depth > MAX_DEPTH)
+		{
+			mFailed = true;
+			return LLXMLNodePtr();
+		}
+
+		LLXMLNodePtr node = new LLXMLNode(names[name_index], is_attribute);
+		node->setLineNumber((S32)readU32());
+		readString(node->mID);
+		node->mVersionMajor = readU32();
+		node->mVersionMinor = readU32();
+		node->mLength = readU32();
+		node->mPrecision = readU32();
+		U32 type = readU32();
+		U32 encoding = readU32();
+		std::string value;
+		readString(value);
+		if (!value.empty())
+		{
+			node->setValue(value);
+		}
+		node->mType = (LLXMLNode::ValueType)type;
+		node->mEncoding = (LLXMLNode::Encoding)encoding;
+
+		U32 attribute_count = readU32();
+		for (U32 i = 0; i < attribute_count && !mFailed; ++i)
+		{
+			LLXMLNodePtr attribute = readNode(names, TRUE, depth + 1);
+			if (attribute.notNull())
+			{
+				node->addChild(attribute);
+			}
+		}
+
+		U32 child_count = readU32();
+		for (U32 i = 0; i < child_count && !mFailed; ++i)
+		{
+			LLXMLNodePtr child = readNode(names, FALSE, depth + 1);
+			if (child.notNull())
+			{
+				node->addChild(child);
+			}
+		}
+
+		return mFailed ? LLXMLNodePtr() : node;
+	}
+
+private:
+	static const S32 MAX_DEPTH = 256;
+
+	const U8* mCur;
+	const U8* mEnd;
+	bool mFailed;
+};
+
+// static
+bool LLXMLNode::parseBinaryFile(const std::string& filename, LLXMLNodePtr& node, std::vector<std::string>* sources)
+{
+	LLFILE* fp = LLFile::fopen(filename, "rb");		/* Flawfinder: ignore */
+	if (fp == NULL)
+	{
+		node = new LLXMLNode();
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	long length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (length <= 0 || length > MAX_BINARY_XML_LENGTH)
+	{
+		// -1 if the size can't be had, an empty file has no header and a
+		// directory can report any size
+		llwarns << "Unable to read binary XML file: " << filename << llendl;
+		fclose(fp);
+		node = new LLXMLNode();
+		return false;
+	}
+
+	std::vector<U8> buffer(length);
+	size_t nread = fread(&buffer[0], 1, length, fp);
+	fclose(fp);
+
+	LLBinaryXMLReader reader(&buffer[0], nread);
+	if (reader.readU32() != BINARY_XML_MAGIC
+		|| reader.readU32() != BINARY_XML_VERSION)
+	{
+		llwarns << "Not a binary XML file, or wrong version: " << filename << llendl;
+		node = new LLXMLNode();
+		return false;
+	}
+
+	U32 source_count = reader.readU32();
+	std::string str;
+	for (U32 i = 0; i < source_count && !reader.failed(); ++i)
+	{
+		reader.readString(str);
+		if (sources)
+		{
+			sources->push_back(str);
+		}
+	}
+
+	// resolve each name against the string table once, rather than per node
+	U32 name_count = reader.readU32();
+	std::vector<LLStringTableEntry*> names;
+	for (U32 i = 0; i < name_count && !reader.failed(); ++i)
+	{
+		reader.readString(str);
+		names.push_back(gStringTable.addStringEntry(str));
+	}
+
+	LLXMLNodePtr root = reader.readNode(names, FALSE, 0);
+	if (reader.failed() || root.isNull())
+	{
+		llwarns << "Truncated or corrupt binary XML file: " << filename << llendl;
+		node = new LLXMLNode();
+		return false;
+	}
+
+	node = root;
+	return true;
+}
+
+bool LLXMLNode::writeBinaryFile(const std::string& filename, const std::vector<std::string>& sources)
+{
+	binary_name_map_t names;
+	std::vector<const LLStringTableEntry*> name_order;
+	collect_binary_names(this, names, name_order);
+
+	std::string out;
+	write_binary_u32(out, BINARY_XML_MAGIC);
+	write_binary_u32(out, BINARY_XML_VERSION);
+	write_binary_u32(out, (U32)sources.size());
+	for (std::vector<std::string>::const_iterator it = sources.begin(); it != sources.end(); ++it)
+	{
+		write_binary_string(out, *it);
+	}
+	write_binary_u32(out, (U32)name_order.size());
+	for (std::vector<const LLStringTableEntry*>::const_iterator it = name_order.begin(); it != name_order.end(); ++it)
+	{
+		write_binary_string(out, (*it)->mString);
+	}
+	write_binary_node(out, this, names);
+
+	LLFILE* fp = LLFile::fopen(filename, "wb");		/* Flawfinder: ignore */
+	if (fp == NULL)
+	{
+		llwarns << "Unable to open binary XML file for writing: " << filename << llendl;
+		return false;
+	}
+	size_t nwritten = fwrite(out.data(), 1, out.size(), fp);
+	fclose(fp);
+	if (nwritten != out.size())
+	{
+		llwarns << "Short write to binary XML file: " << filename << llendl;
+		LLFile::remove(filename);
+		return false;
+	}
+	return true;
+}
+
 // static
 void LLXMLNode::writeHeaderToFile(LLFILE *out_file)
 {
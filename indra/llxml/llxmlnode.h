@@ -158,6 +158,15 @@ public:
 	
 	static bool getLayeredXMLNode(const std::string &xui_filename, LLXMLNodePtr& root,
 								  const std::vector<std::string>& paths);
+
+	// Compact binary form of a parsed tree.  Loading it skips expat and
+	// the per-attribute parsing done by StartXMLNode().  sources is an
+	// opaque list of strings stored alongside the tree, e.g. the files it
+	// was built from, so the caller can tell if the binary is out of date.
+	static bool parseBinaryFile(const std::string& filename, LLXMLNodePtr& node,
+								std::vector<std::string>* sources = NULL);
+	bool writeBinaryFile(const std::string& filename,
+						 const std::vector<std::string>& sources = std::vector<std::string>());
 	
 	
 	// Write standard XML file header:
@@ -0,0 +1,148 @@
+/** 
+ * @file llxmlnode_test.cpp
+ * @brief LLXMLNode binary tree tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+#include "linden_common.h"
+
+#include "../llxmlnode.h"
+
+#include "lluuid.h"
+
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct xmlnode_binary
+	{
+		std::string mFilename;
+
+		xmlnode_binary()
+		{
+			LLUUID random;
+			random.generate();
+			std::ostringstream oStr;
+#ifdef LL_WINDOWS
+			char* tmp_dir = getenv("TMP");
+			oStr << (tmp_dir ? tmp_dir : "c:/tmp") << "/llxmlnode-test-" << random << ".bin";
+#else
+			oStr << "/tmp/llxmlnode-test-" << random << ".bin";
+#endif
+			mFilename = oStr.str();
+		}
+
+		~xmlnode_binary()
+		{
+			LLFile::remove(mFilename);
+		}
+
+		LLXMLNodePtr parse(const std::string& xml)
+		{
+			LLXMLNodePtr node;
+			std::vector<U8> buffer(xml.begin(), xml.end());
+			LLXMLNode::parseBuffer(&buffer[0], buffer.size(), node, NULL);
+			return node;
+		}
+
+		std::string toString(LLXMLNodePtr node)
+		{
+			std::ostringstream out;
+			node->writeToOstream(out);
+			return out.str();
+		}
+	};
+
+	typedef test_group<xmlnode_binary> xmlnode_binary_test;
+	typedef xmlnode_binary_test::object xmlnode_binary_t;
+	tut::xmlnode_binary_test tut_xmlnode_binary("LLXMLNodeBinary");
+
+	template<> template<>
+	void xmlnode_binary_t::test<1>()
+	{
+		LLXMLNodePtr node = parse(
+			"<floater name=\"test\" width=\"200\" type=\"string\">\n"
+			"  <button name=\"ok\" label=\"OK &amp; close\"/>\n"
+			"  <text name=\"first\">hello</text>\n"
+			"  <text name=\"second\">world</text>\n"
+			"  <panel name=\"inner\"><button name=\"deep\"/></panel>\n"
+			"</floater>\n");
+		ensure("parsed", node.notNull() && !node->isNull());
+
+		std::vector<std::string> sources;
+		sources.push_back("a/floater_test.xml");
+		sources.push_back("b/floater_test.xml");
+		ensure("write", node->writeBinaryFile(mFilename, sources));
+
+		LLXMLNodePtr loaded;
+		std::vector<std::string> loaded_sources;
+		ensure("read", LLXMLNode::parseBinaryFile(mFilename, loaded, &loaded_sources));
+		ensure("sources", loaded_sources == sources);
+		ensure_equals("tree", toString(loaded), toString(node));
+		ensure_equals("line numbers", loaded->getFirstChild()->getLineNumber(), node->getFirstChild()->getLineNumber());
+
+		// lookups by name go through the child map, not the sibling list
+		LLXMLNodePtr panel;
+		LLXMLNodePtr button;
+		ensure("child lookup", loaded->getChild("panel", panel, FALSE));
+		ensure("nested lookup", panel->getChild("button", button, FALSE));
+		ensure("attribute", button->hasAttribute("name"));
+	}
+
+	template<> template<>
+	void xmlnode_binary_t::test<2>()
+	{
+		LLXMLNodePtr node = parse("<a><b name=\"x\"/><c>text</c></a>");
+		ensure("write", node->writeBinaryFile(mFilename));
+
+		LLFILE* fp = LLFile::fopen(mFilename, "rb");
+		std::string data;
+		int c;
+		while ((c = fgetc(fp)) != EOF)
+		{
+			data += (char)c;
+		}
+		fclose(fp);
+
+		// every truncation is rejected rather than half loaded
+		for (size_t length = 0; length < data.size(); ++length)
+		{
+			fp = LLFile::fopen(mFilename, "wb");
+			fwrite(data.data(), 1, length, fp);
+			fclose(fp);
+			LLXMLNodePtr loaded;
+			ensure("truncated file rejected", !LLXMLNode::parseBinaryFile(mFilename, loaded));
+		}
+
+		LLXMLNodePtr loaded;
+		ensure("missing file", !LLXMLNode::parseBinaryFile(mFilename + ".missing", loaded));
+		ensure("directory", !LLXMLNode::parseBinaryFile(".", loaded));
+	}
+}
@@ -50,6 +50,7 @@
 #include "llwindow.h"
 #include "llviewerstats.h"
 #include "llmd5.h"
+#include "llbuffer.h"
 #include "llpumpio.h"
 #include "llmimetypes.h"
 #include "llslurl.h"
@@ -88,8 +89,12 @@
 
 // Linden library includes
 #include "llimagej2c.h"
+#include "lllogvfs.h"
 #include "llmemory.h"
+#include "llpatchdecoder.h"
 #include "llprimitive.h"
+#include "lltaskscheduler.h"
+#include "lltracerecorder.h"
 #include "llurlaction.h"
 #include "llvfile.h"
 #include "llvfsthread.h"
@@ -324,6 +329,7 @@ void init_default_trans_args()
 // File scope definitons
 const char *VFS_DATA_FILE_BASE = "data.db2.x.";
 const char *VFS_INDEX_FILE_BASE = "index.db2.x.";
+const char *VFS_LOG_DIR = "vfslog";
 
 static std::string gWindowTitle;
 
@@ -580,7 +586,8 @@ LLAppViewer::LLAppViewer() :
 	mAgentRegionLastAlive(false),
 	mRandomizeFramerate(LLCachedControl<bool>(gSavedSettings,"Randomize Framerate", FALSE)),
 	mPeriodicSlowFrame(LLCachedControl<bool>(gSavedSettings,"Periodic Slow Frame", FALSE)),
-	mFastTimerLogThread(NULL)
+	mFastTimerLogThread(NULL),
+	mRecordTimerTrace(false)
 {
 	if(NULL != sInstance)
 	{
@@ -735,6 +742,8 @@ bool LLAppViewer::init()
 	LLToolMgr::getInstance(); // Initialize tool manager if not already instantiated
 	
 	LLViewerFloaterReg::registerFloaters();
+
+	LLUICtrlFactory::setUseCompiledXUI(gSavedSettings.getBOOL("UseCompiledXUI"));
 	
 	/////////////////////////////////////////////////
 	//
@@ -909,6 +918,22 @@ bool LLAppViewer::init()
 	}
 	
 	LLViewerMedia::initClass();
+
+	// Offline XUI compile and load benchmark, both quit when done.  Done
+	// last so that cleanup() finds everything initialized.
+	if (gSavedSettings.getBOOL("CompileXUI") || gSavedSettings.getS32("BenchmarkXUILoad") > 0)
+	{
+		if (gSavedSettings.getBOOL("CompileXUI"))
+		{
+			LLUICtrlFactory::compileXUIFiles();
+		}
+		if (gSavedSettings.getS32("BenchmarkXUILoad") > 0)
+		{
+			LLFloaterReg::benchmarkXUILoad(gSavedSettings.getS32("BenchmarkXUILoad"));
+		}
+		removeMarkerFile();
+		forceQuit();
+	}
 	
 	return true;
 }
@@ -933,10 +958,14 @@ bool LLAppViewer::mainLoop()
 	//-------------------------------------------
 
 	// Create IO Pump to use for HTTP Requests.
-	gServicePump = new LLPumpIO(gAPRPoolp);
+	const S32 MAX_FREE_IO_BUFFERS = 64;
+	LLHeapBuffer::initPool(MAX_FREE_IO_BUFFERS);
+	gServicePump = new LLPumpIO(gAPRPoolp,
+		gSavedSettings.getBOOL("IOPumpEventDriven") ? LLPumpIO::EVENT_DRIVEN : 0);
 	LLHTTPClient::setPump(*gServicePump);
 	LLCurl::setCAFile(gDirUtilp->getCAFile());
 	LLCurl::setSSLVerify(! gSavedSettings.getBOOL("NoVerifySSLCert"));
+	LLCurl::setPipelining(gSavedSettings.getBOOL("HttpPipelining"));
 	
 	// Note: this is where gLocalSpeakerMgr and gActiveSpeakerMgr used to be instantiated.
 
@@ -1142,6 +1171,11 @@ bool LLAppViewer::mainLoop()
 						LLFastTimer ftm(FTM_LFS);
 	 					io_pending += LLLFSThread::updateClass(1);
 					}
+					if (LLTaskScheduler::getInstance())
+					{
+						// main thread callbacks of scheduled tasks
+						work_pending += LLTaskScheduler::getInstance()->update(1);
+					}
 
 					if (io_pending > 1000)
 					{
@@ -1440,6 +1474,7 @@ bool LLAppViewer::cleanup()
 	//#endif // LL_WINDOWS
 
 	LLVolumeMgr* volume_manager = LLPrimitive::getVolumeManager();
+	volume_manager->stopGenerateThread();
 	if (!volume_manager->cleanup())
 	{
 		llwarns << "Remaining references in the volume manager!" << llendflush;
@@ -1542,6 +1577,10 @@ bool LLAppViewer::cleanup()
 		pending += LLAppViewer::getTextureFetch()->update(1); // unpauses the texture fetch thread
 		pending += LLVFSThread::updateClass(0);
 		pending += LLLFSThread::updateClass(0);
+		if (LLTaskScheduler::getInstance())
+		{
+			pending += LLTaskScheduler::getInstance()->update(0);
+		}
 		F64 idle_time = idleTimer.getElapsedTimeF64();
 		if(!pending)
 		{
@@ -1571,6 +1610,17 @@ bool LLAppViewer::cleanup()
     sImageDecodeThread = NULL;
 	delete mFastTimerLogThread;
 	mFastTimerLogThread = NULL;
+
+	if (LLTraceRecorder::isRecording())
+	{
+		LLTraceRecorder::stopRecording();
+		std::string json_file = gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "timers.json");
+		llofstream json(json_file);
+		if (LLTraceRecorder::exportChromeTrace(gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "timers.lltrace"), json))
+		{
+			llinfos << "Timer trace exported to " << json_file << llendl;
+		}
+	}
 	
 	if (LLFastTimerView::sAnalyzePerformance)
 	{
@@ -1605,8 +1655,11 @@ bool LLAppViewer::cleanup()
 	
 	// This should eventually be done in LLAppViewer
 	LLImage::cleanupClass();
+	LLPatchDecoder::cleanupClass();
 	LLVFSThread::cleanupClass();
 	LLLFSThread::cleanupClass();
+	// after every queued thread that runs on it
+	LLTaskScheduler::cleanupClass();
 
 #ifndef LL_RELEASE_FOR_DOWNLOAD
 	llinfos << "Auditing VFS" << llendl;
@@ -1634,6 +1687,9 @@ bool LLAppViewer::cleanup()
 	// *NOTE:Mani - The following call is not thread safe. 
 	LLCurl::cleanupClass();
 
+	// Once nothing left running can hand back a buffer
+	LLHeapBuffer::cleanupPool();
+
 	// If we're exiting to launch an URL, do that here so the screen
 	// is at the right resolution before we launch IE.
 	if (!gLaunchFileOnQuit.empty())
@@ -1694,15 +1750,30 @@ bool LLAppViewer::initThreads()
 		LLWatchdog::getInstance()->init(watchdog_killer_callback);
 	}
 
+	// Threaded queues created from here on run on the scheduler's threads
+	LLTaskScheduler::initClass(enable_threads ? 0 : -1);
+
 	LLVFSThread::initClass(enable_threads && false);
 	LLLFSThread::initClass(enable_threads && false);
 
 	// Image decoding
-	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
+	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true,
+															  gSavedSettings.getS32("TextureDecodeThreads"));
 	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
 	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), sImageDecodeThread, enable_threads && true);
 	LLImage::initClass();
 
+	// Terrain patch decoding
+	LLPatchDecoder::initClass();
+
+	// Volume generation
+	LLVolumeMgr* volume_manager = LLPrimitive::getVolumeManager();
+	volume_manager->setCacheSize(gSavedSettings.getS32("VolumeCacheSize"));
+	if (gSavedSettings.getBOOL("VolumeBackgroundGeneration"))
+	{
+		volume_manager->startGenerateThread(enable_threads && true);
+	}
+
 	if (LLFastTimer::sLog || LLFastTimer::sMetricLog)
 	{
 		LLFastTimer::sLogLock = new LLMutex(NULL);
@@ -1710,6 +1781,11 @@ bool LLAppViewer::initThreads()
 		mFastTimerLogThread->start();
 	}
 
+	if (mRecordTimerTrace)
+	{
+		LLTraceRecorder::startRecording(gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "timers.lltrace"));
+	}
+
 	// *FIX: no error handling here!
 	return true;
 }
@@ -2073,6 +2149,11 @@ bool LLAppViewer::initConfiguration()
 		LLFastTimer::sMetricLog = TRUE ;
 	}
 
+	if (clp.hasOption("recordtrace"))
+	{
+		mRecordTimerTrace = true;
+	}
+
 	if (clp.hasOption("graphicslevel"))
 	{
 		const LLCommandLineParser::token_vector_t& value = clp.getOption("graphicslevel");
@@ -3235,7 +3316,16 @@ bool LLAppViewer::initCache()
 	gSavedSettings.setU32("VFSSalt", new_salt);
 
 	// Don't remove VFS after viewer crashes.  If user has corrupt data, they can reinstall. JC
-	gVFS = LLVFS::createLLVFS(new_vfs_index_file, new_vfs_data_file, false, vfs_size_u32, false);
+	if (gSavedSettings.getBOOL("VFSLogStructured"))
+	{
+		// Recovers from a crash by replaying its log, and changing the
+		// size just starts a new log.
+		gVFS = LLLogVFS::createLogVFS(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, VFS_LOG_DIR), FALSE, vfs_size_u32);
+	}
+	else
+	{
+		gVFS = LLVFS::createLLVFS(new_vfs_index_file, new_vfs_data_file, false, vfs_size_u32, false);
+	}
 	if( !gVFS )
 	{
 		return false;
@@ -3265,6 +3355,7 @@ void LLAppViewer::purgeCache()
 	LLAppViewer::getTextureCache()->purgeCache(LL_PATH_CACHE);
 	std::string mask = gDirUtilp->getDirDelimiter() + "*.*";
 	gDirUtilp->deleteFilesInDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE,""),mask);
+	gDirUtilp->deleteFilesInDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE,VFS_LOG_DIR),gDirUtilp->getDirDelimiter() + "*");
 }
 
 std::string LLAppViewer::getSecondLifeTitle() const
@@ -3657,6 +3748,9 @@ void LLAppViewer::idle()
 		gAgent.updateAgentPosition(gFrameDTClamped, yaw, current_mouse.mX, current_mouse.mY);
 	}
 
+	// Hand volumes generated in the background to their objects
+	LLPrimitive::getVolumeManager()->update();
+
 	{
 		LLFastTimer t(FTM_OBJECTLIST_UPDATE); 
 		
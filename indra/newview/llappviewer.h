@@ -259,6 +259,7 @@ private:
 	LLWatchdogTimeout* mMainloopTimeout;
 
 	LLThread*	mFastTimerLogThread;
+	bool		mRecordTimerTrace;		// -recordtrace
 	// for tracking viewer<->region circuit death
 	bool mAgentRegionLastAlive;
 	LLUUID mAgentRegionLastID;
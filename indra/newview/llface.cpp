@@ -869,7 +869,7 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 								const U16 &index_offset)
 {
 	const LLVolumeFace &vf = volume.getVolumeFace(f);
-	S32 num_vertices = (S32)vf.mVertices.size();
+	S32 num_vertices = vf.getNumVertices();
 	S32 num_indices = LLPipeline::sUseTriStrips ? (S32)vf.mTriStrip.size() : (S32) vf.mIndices.size();
 	
 	if (mVertexBuffer.notNull())
@@ -1145,28 +1145,28 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		mVObjp->getVolume()->genBinormals(f);
 	}
 
-	for (S32 i = 0; i < num_vertices; i++)
+	if (rebuild_tcoord)
 	{
-		if (rebuild_tcoord)
+		for (S32 i = 0; i < num_vertices; i++)
 		{
-			LLVector2 tc = vf.mVertices[i].mTexCoord;
+			LLVector2 tc = vf.getTexCoord(i);
 		
 			if (texgen != LLTextureEntry::TEX_GEN_DEFAULT)
 			{
-				LLVector3 vec = vf.mVertices[i].mPosition; 
+				LLVector3 vec = vf.getPosition(i); 
 			
 				vec.scaleVec(scale);
 
 				switch (texgen)
 				{
 					case LLTextureEntry::TEX_GEN_PLANAR:
-						planarProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
+						planarProjection(tc, vf.getNormal(i), vf.mCenter, vec);
 						break;
 					case LLTextureEntry::TEX_GEN_SPHERICAL:
-						sphericalProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
+						sphericalProjection(tc, vf.getNormal(i), vf.mCenter, vec);
 						break;
 					case LLTextureEntry::TEX_GEN_CYLINDRICAL:
-						cylindricalProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
+						cylindricalProjection(tc, vf.getNormal(i), vf.mCenter, vec);
 						break;
 					default:
 						break;
@@ -1276,10 +1276,10 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		
 			if (bump_code && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TEXCOORD1))
 			{
-				LLVector3 tangent = vf.mVertices[i].mBinormal % vf.mVertices[i].mNormal;
+				LLVector3 tangent = vf.getBinormal(i) % vf.getNormal(i);
 
 				LLMatrix3 tangent_to_object;
-				tangent_to_object.setRows(tangent, vf.mVertices[i].mBinormal, vf.mVertices[i].mNormal);
+				tangent_to_object.setRows(tangent, vf.getBinormal(i), vf.getNormal(i));
 				LLVector3 binormal = binormal_dir * tangent_to_object;
 				binormal = binormal * mat_normal;
 				
@@ -1294,30 +1294,29 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 				*tex_coords2++ = tc;
 			}	
 		}
-			
-		if (rebuild_pos)
-		{
-			*vertices++ = vf.mVertices[i].mPosition * mat_vert;
-		}
-		
-		if (rebuild_normal)
-		{
-			LLVector3 normal = vf.mVertices[i].mNormal * mat_normal;
-			normal.normVec();
-			
-			*normals++ = normal;
-		}
-		
-		if (rebuild_binormal)
-		{
-			LLVector3 binormal = vf.mVertices[i].mBinormal * mat_normal;
-			binormal.normVec();
-			*binormals++ = binormal;
-		}
-		
-		if (rebuild_color)
+	}
+
+	// The rest are whole streams straight from the volume face
+	if (rebuild_pos)
+	{
+		vf.getPositions(vertices, mat_vert);
+	}
+
+	if (rebuild_normal)
+	{
+		vf.getNormals(normals, mat_normal);
+	}
+
+	if (rebuild_binormal)
+	{
+		vf.getBinormals(binormals, mat_normal);
+	}
+
+	if (rebuild_color)
+	{
+		for (S32 i = 0; i < num_vertices; i++)
 		{
-			*colors++ = color;		
+			*colors++ = color;
 		}
 	}
 
@@ -879,7 +879,8 @@ void LLFolderViewItem::draw()
 	bool possibly_has_children = false;
 	bool up_to_date = mListener && mListener->isUpToDate();
 	if((up_to_date && hasVisibleChildren() ) || // we fetched our children and some of them have passed the filter...
-		(!up_to_date && mListener && mListener->hasChildren())) // ...or we know we have children but haven't fetched them (doesn't obey filter)
+		(!up_to_date && mListener && mListener->hasChildren()) || // ...or we know we have children but haven't fetched them (doesn't obey filter)
+		(!areChildrenInited() && mListener && mListener->hasChildren())) // ...or we have children but haven't built their views
 	{
 		possibly_has_children = true;
 	}
@@ -1094,7 +1095,8 @@ mLastArrangeGeneration( -1 ),
 mLastCalculatedWidth(0),
 mCompletedFilterGeneration(-1),
 mMostFilteredDescendantGeneration(-1),
-mNeedsSort(false)
+mNeedsSort(false),
+mAreChildrenInited(TRUE)
 {}
 
 // Destroys the object
@@ -258,6 +258,10 @@ public:
 	BOOL getIsCurSelection() { return mIsCurSelection; }
 
 	BOOL hasVisibleChildren() { return mHasVisibleChildren; }
+
+	// Whether views have been built for all of this item's children,
+	// see LLInventoryPanel::buildChildViews().
+	virtual BOOL areChildrenInited() const { return TRUE; }
 	
 	void setShowLoadStatus(bool status) { mShowLoadStatus = status; }
 
@@ -396,6 +400,7 @@ protected:
 	S32			mCompletedFilterGeneration;
 	S32			mMostFilteredDescendantGeneration;
 	bool		mNeedsSort;
+	BOOL		mAreChildrenInited;
 public:
 	typedef enum e_recurse_type
 	{
@@ -511,6 +516,10 @@ public:
 	// Get the current state of the folder.
 	virtual BOOL isOpen() const { return mIsOpen; }
 
+	// Inventory panels build child views the first time a folder is opened.
+	/*virtual*/ BOOL areChildrenInited() const { return mAreChildrenInited; }
+	void setChildrenInited(BOOL inited) { mAreChildrenInited = inited; }
+
 	// special case if an object is dropped on the child.
 	BOOL handleDragAndDropFromChild(MASK mask,
 		BOOL drop,
@@ -0,0 +1,798 @@
+/** 
+ * @file llinventorycache.cpp
+ * @brief Binary, indexed inventory cache
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llinventorycache.h"
+
+#include "llapr.h"
+#include "llinventory.h"
+#include "lltaskscheduler.h"
+#include "llxorcipher.h"
+
+#include <algorithm>
+
+// Deltas may grow to this fraction of the base before save() compacts
+const F32 MAX_DELTA_RATIO = 0.5f;
+// and there may not be more than this many segments
+const U32 MAX_SEGMENTS = 32;
+// Items decoded per parallel job
+const U32 ITEMS_PER_JOB = 1024;
+
+const U32 SEGMENT_HEADER_SIZE = 40;
+const U32 CATEGORY_ENTRY_SIZE = 40;
+const U32 SEGMENT_FLAG_BASE = 0x1;
+
+const U8 ITEM_FLAG_GROUP_OWNED = 0x1;
+const U8 ITEM_FLAG_SHADOW_ASSET = 0x2;
+
+const char SEGMENT_MAGIC[4] = { 'L', 'L', 'I', 'C' };
+
+// Same pad as the shadow ids of the text inventory format
+const LLUUID MAGIC_ID("3c115e51-04f4-523c-9fa6-98aff1034730");
+
+namespace
+{
+	// FNV-1a, 64 bit
+	U64 hash_bytes(const U8* data, U32 size, U64 hash = 0xcbf29ce484222325ULL)
+	{
+		for (U32 i = 0; i < size; ++i)
+		{
+			hash ^= data[i];
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+	void put_bytes(std::vector<U8>& out, const void* data, U32 size)
+	{
+		const U8* bytes = (const U8*)data;
+		out.insert(out.end(), bytes, bytes + size);
+	}
+
+	void put_u8(std::vector<U8>& out, U8 value)
+	{
+		out.push_back(value);
+	}
+
+	void put_u32(std::vector<U8>& out, U32 value)
+	{
+		put_bytes(out, &value, sizeof(value));
+	}
+
+	void put_u64(std::vector<U8>& out, U64 value)
+	{
+		put_bytes(out, &value, sizeof(value));
+	}
+
+	void put_uuid(std::vector<U8>& out, const LLUUID& id)
+	{
+		put_bytes(out, id.mData, UUID_BYTES);
+	}
+
+	void put_string(std::vector<U8>& out, const std::string& str)
+	{
+		U32 length = llmin((U32)str.size(), (U32)U16_MAX);
+		U16 size = (U16)length;
+		put_bytes(out, &size, sizeof(size));
+		put_bytes(out, str.data(), length);
+	}
+
+	void set_u32(std::vector<U8>& out, U32 offset, U32 value)
+	{
+		memcpy(&out[offset], &value, sizeof(value));
+	}
+
+	// Bounds checked reads over a byte range
+	class Reader
+	{
+	public:
+		Reader(const U8* data, U32 size) : mData(data), mSize(size), mPos(0), mGood(true) {}
+
+		bool good() const { return mGood; }
+		U32 getPos() const { return mPos; }
+
+		bool getBytes(void* out, U32 size)
+		{
+			if (!mGood || size > mSize - mPos)
+			{
+				mGood = false;
+				return false;
+			}
+			memcpy(out, mData + mPos, size);
+			mPos += size;
+			return true;
+		}
+
+		U8 getU8() { U8 v = 0; getBytes(&v, sizeof(v)); return v; }
+		U32 getU32() { U32 v = 0; getBytes(&v, sizeof(v)); return v; }
+		S32 getS32() { S32 v = 0; getBytes(&v, sizeof(v)); return v; }
+		U64 getU64() { U64 v = 0; getBytes(&v, sizeof(v)); return v; }
+		void getUUID(LLUUID& id) { getBytes(id.mData, UUID_BYTES); }
+
+		void getString(std::string& str)
+		{
+			U16 size = 0;
+			if (getBytes(&size, sizeof(size)) && size <= mSize - mPos)
+			{
+				str.assign((const char*)mData + mPos, size);
+				mPos += size;
+			}
+			else
+			{
+				mGood = false;
+			}
+		}
+
+	private:
+		const U8* mData;
+		U32 mSize;
+		U32 mPos;
+		bool mGood;
+	};
+
+	void encode_category(const LLInventoryCache::Category& cat, std::vector<U8>& out)
+	{
+		put_uuid(out, cat.mID);
+		put_uuid(out, cat.mParentID);
+		put_uuid(out, cat.mOwnerID);
+		put_u32(out, (U32)cat.mVersion);
+		put_u8(out, (U8)(S8)cat.mPreferredType);
+		put_string(out, cat.mName);
+	}
+
+	bool decode_category(const U8* data, U32 size, LLInventoryCache::Category& cat)
+	{
+		Reader reader(data, size);
+		reader.getUUID(cat.mID);
+		reader.getUUID(cat.mParentID);
+		reader.getUUID(cat.mOwnerID);
+		cat.mVersion = reader.getS32();
+		cat.mPreferredType = (LLFolderType::EType)(S8)reader.getU8();
+		reader.getString(cat.mName);
+		return reader.good();
+	}
+}
+
+LLInventoryCache::Category::Category()
+:	mPreferredType(LLFolderType::FT_NONE),
+	mVersion(-1)
+{
+}
+
+LLInventoryCache::LLInventoryCache()
+:	mValidSize(0),
+	mLastSaveSize(0),
+	mLastSaveRewrote(false)
+{
+}
+
+LLInventoryCache::~LLInventoryCache()
+{
+}
+
+void LLInventoryCache::clear()
+{
+	mData.clear();
+	mValidSize = 0;
+	mSegments.clear();
+	mSlots.clear();
+	mCategoryList.clear();
+	mFilename.clear();
+}
+
+//static
+// Item records hold the item's own fields, not the ones a link forwards
+// to, hence the qualified calls.
+void LLInventoryCache::encodeItem(const LLInventoryItem& item, std::vector<U8>& out)
+{
+	const LLPermissions& perm = item.LLInventoryItem::getPermissions();
+	LLUUID asset_id = item.LLInventoryItem::getAssetUUID();
+	U8 flags = 0;
+	if (perm.isGroupOwned())
+	{
+		flags |= ITEM_FLAG_GROUP_OWNED;
+	}
+	if ((perm.getMaskBase() & PERM_ITEM_UNRESTRICTED) != PERM_ITEM_UNRESTRICTED
+		&& asset_id.notNull())
+	{
+		LLXORCipher cipher(MAGIC_ID.mData, UUID_BYTES);
+		cipher.encrypt(asset_id.mData, UUID_BYTES);
+		flags |= ITEM_FLAG_SHADOW_ASSET;
+	}
+
+	put_uuid(out, item.getUUID());
+	put_uuid(out, item.getParentUUID());
+	put_uuid(out, perm.getCreator());
+	put_uuid(out, perm.getOwner());
+	put_uuid(out, perm.getLastOwner());
+	put_uuid(out, perm.getGroup());
+	put_uuid(out, asset_id);
+	put_u32(out, perm.getMaskBase());
+	put_u32(out, perm.getMaskOwner());
+	put_u32(out, perm.getMaskGroup());
+	put_u32(out, perm.getMaskEveryone());
+	put_u32(out, perm.getMaskNextOwner());
+	put_u8(out, flags);
+	put_u8(out, (U8)(S8)item.LLInventoryItem::getType());
+	put_u8(out, (U8)(S8)item.LLInventoryItem::getInventoryType());
+	put_u32(out, item.LLInventoryItem::getFlags());
+	const LLSaleInfo& sale_info = item.LLInventoryItem::getSaleInfo();
+	put_u8(out, (U8)sale_info.getSaleType());
+	put_u32(out, (U32)sale_info.getSalePrice());
+	put_u32(out, (U32)(S32)item.LLInventoryItem::getCreationDate());
+	put_string(out, item.LLInventoryItem::getName());
+	put_string(out, item.LLInventoryItem::getDescription());
+}
+
+//static
+bool LLInventoryCache::decodeItem(const U8* data, U32 size, LLInventoryItem& item)
+{
+	Reader reader(data, size);
+	LLUUID id, parent_id, creator, owner, last_owner, group, asset_id;
+	reader.getUUID(id);
+	reader.getUUID(parent_id);
+	reader.getUUID(creator);
+	reader.getUUID(owner);
+	reader.getUUID(last_owner);
+	reader.getUUID(group);
+	reader.getUUID(asset_id);
+	U32 mask_base = reader.getU32();
+	U32 mask_owner = reader.getU32();
+	U32 mask_group = reader.getU32();
+	U32 mask_everyone = reader.getU32();
+	U32 mask_next = reader.getU32();
+	U8 flags = reader.getU8();
+	S8 type = (S8)reader.getU8();
+	S8 inv_type = (S8)reader.getU8();
+	U32 item_flags = reader.getU32();
+	U8 sale_type = reader.getU8();
+	S32 sale_price = reader.getS32();
+	S32 creation_date = reader.getS32();
+	std::string name;
+	std::string desc;
+	reader.getString(name);
+	reader.getString(desc);
+	if (!reader.good())
+	{
+		return false;
+	}
+
+	if (flags & ITEM_FLAG_SHADOW_ASSET)
+	{
+		LLXORCipher cipher(MAGIC_ID.mData, UUID_BYTES);
+		cipher.decrypt(asset_id.mData, UUID_BYTES);
+	}
+
+	// the masks were fixed before they were saved, so initMasks() leaves
+	// them as they are
+	LLPermissions perm;
+	perm.init(creator, owner, last_owner, group);
+	perm.yesReallySetOwner(owner, (flags & ITEM_FLAG_GROUP_OWNED) != 0);
+	perm.initMasks(mask_base, mask_owner, mask_everyone, mask_group, mask_next);
+
+	item.setUUID(id);
+	item.setParent(parent_id);
+	item.setPermissions(perm);
+	item.setAssetUUID(asset_id);
+	item.setType((LLAssetType::EType)type);
+	item.setInventoryType((LLInventoryType::EType)inv_type);
+	item.setFlags(item_flags);
+	item.setSaleInfo(LLSaleInfo((LLSaleInfo::EForSale)sale_type, sale_price));
+	item.setCreationDate((time_t)creation_date);
+	item.rename(name);
+	item.setDescription(desc);
+	return true;
+}
+
+LLInventoryCache::EStatus LLInventoryCache::load(const std::string& filename, S32 cache_version)
+{
+	clear();
+	mFilename = filename;
+
+	LLFILE* fp = LLFile::fopen(filename, "rb");
+	if (!fp)
+	{
+		return STATUS_NOT_FOUND;
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size > 0)
+	{
+		mData.resize((size_t)size);
+		if (fread(&mData[0], 1, (size_t)size, fp) != (size_t)size)
+		{
+			mData.clear();
+		}
+	}
+	fclose(fp);
+
+	bool obsolete = false;
+	U32 offset = 0;
+	while (offset < mData.size())
+	{
+		if (!parseSegment(offset, cache_version, obsolete))
+		{
+			break;
+		}
+		mValidSize = offset;
+	}
+
+	if (mSegments.empty())
+	{
+		EStatus status = obsolete ? STATUS_OBSOLETE : STATUS_CORRUPT;
+		clear();
+		mFilename = filename;
+		return status;
+	}
+	if (mValidSize < mData.size())
+	{
+		llwarns << "Ignoring " << (mData.size() - mValidSize) << " bytes of damaged inventory cache in "
+				<< filename << llendl;
+	}
+
+	// apply the segments in order
+	for (U32 s = 0; s < mSegments.size(); ++s)
+	{
+		const Segment& segment = mSegments[s];
+		for (U32 i = 0; i < segment.mRemoved.size(); ++i)
+		{
+			mSlots.erase(segment.mRemoved[i]);
+		}
+		for (U32 i = 0; i < segment.mCategories.size(); ++i)
+		{
+			Slot& slot = mSlots[segment.mCategories[i].mID];
+			slot.mSegment = s;
+			slot.mEntry = i;
+		}
+	}
+
+	mCategoryList.reserve(mSlots.size());
+	for (slot_map_t::const_iterator it = mSlots.begin(); it != mSlots.end(); ++it)
+	{
+		const CategoryEntry& entry = mSegments[it->second.mSegment].mCategories[it->second.mEntry];
+		Category cat;
+		if (decode_category(getRecords(it->second) + entry.mBlockOffset, entry.mBlockSize, cat)
+			&& cat.mID == it->first)
+		{
+			mCategoryList.push_back(cat);
+		}
+		else
+		{
+			llwarns << "Ignoring bad cached inventory category " << it->first << llendl;
+		}
+	}
+
+	return STATUS_OK;
+}
+
+bool LLInventoryCache::parseSegment(U32& offset, S32 cache_version, bool& obsolete)
+{
+	if (mData.size() - offset < SEGMENT_HEADER_SIZE)
+	{
+		return false;
+	}
+
+	Reader header(&mData[offset], SEGMENT_HEADER_SIZE);
+	char magic[4];
+	header.getBytes(magic, sizeof(magic));
+	U32 format_version = header.getU32();
+	S32 file_cache_version = header.getS32();
+	U32 flags = header.getU32();
+	U32 category_count = header.getU32();
+	U32 item_count = header.getU32();
+	U32 removed_count = header.getU32();
+	U32 payload_size = header.getU32();
+	U64 checksum = header.getU64();
+
+	if (memcmp(magic, SEGMENT_MAGIC, sizeof(magic)) != 0)
+	{
+		return false;
+	}
+	if (format_version != FORMAT_VERSION || file_cache_version != cache_version)
+	{
+		obsolete = true;
+		return false;
+	}
+	// the first segment is the base, every other one a delta
+	if (((flags & SEGMENT_FLAG_BASE) != 0) != mSegments.empty())
+	{
+		return false;
+	}
+
+	U32 payload = offset + SEGMENT_HEADER_SIZE;
+	if (payload_size > mData.size() - payload
+		|| hash_bytes(payload_size ? &mData[payload] : NULL, payload_size) != checksum)
+	{
+		return false;
+	}
+
+	U64 tables_size = (U64)category_count * CATEGORY_ENTRY_SIZE + (U64)item_count * 4 + (U64)removed_count * UUID_BYTES;
+	if (tables_size > payload_size)
+	{
+		return false;
+	}
+
+	Segment segment;
+	segment.mRecordsOffset = payload + (U32)tables_size;
+	segment.mRecordsSize = payload_size - (U32)tables_size;
+
+	Reader reader(&mData[payload], (U32)tables_size);
+	segment.mCategories.resize(category_count);
+	for (U32 i = 0; i < category_count; ++i)
+	{
+		CategoryEntry& entry = segment.mCategories[i];
+		reader.getUUID(entry.mID);
+		entry.mBlockOffset = reader.getU32();
+		entry.mBlockSize = reader.getU32();
+		entry.mFirstItem = reader.getU32();
+		entry.mItemCount = reader.getU32();
+		entry.mHash = reader.getU64();
+		if (entry.mBlockOffset > segment.mRecordsSize
+			|| entry.mBlockSize > segment.mRecordsSize - entry.mBlockOffset
+			|| entry.mFirstItem > item_count
+			|| entry.mItemCount > item_count - entry.mFirstItem)
+		{
+			return false;
+		}
+	}
+	segment.mItemOffsets.resize(item_count);
+	for (U32 i = 0; i < item_count; ++i)
+	{
+		segment.mItemOffsets[i] = reader.getU32();
+		if (segment.mItemOffsets[i] >= segment.mRecordsSize)
+		{
+			return false;
+		}
+	}
+	segment.mRemoved.resize(removed_count);
+	for (U32 i = 0; i < removed_count; ++i)
+	{
+		reader.getUUID(segment.mRemoved[i]);
+	}
+	if (!reader.good())
+	{
+		return false;
+	}
+
+	mSegments.push_back(segment);
+	offset = payload + payload_size;
+	return true;
+}
+
+const U8* LLInventoryCache::getRecords(const Slot& slot) const
+{
+	return &mData[0] + mSegments[slot.mSegment].mRecordsOffset;
+}
+
+U32 LLInventoryCache::getItemCount(const LLUUID& category_id) const
+{
+	slot_map_t::const_iterator it = mSlots.find(category_id);
+	if (it == mSlots.end())
+	{
+		return 0;
+	}
+	return mSegments[it->second.mSegment].mCategories[it->second.mEntry].mItemCount;
+}
+
+class LLInventoryCache::DecodeBody : public LLTaskScheduler::ParallelBody
+{
+public:
+	struct Record
+	{
+		const U8* mData;
+		U32 mSize;		// bytes left in the segment
+	};
+
+	DecodeBody(ItemFactory& factory, item_list_t& out, U32 first)
+	:	mFactory(factory), mOut(out), mFirst(first), mFailed(0)
+	{
+	}
+
+	S32 getJobCount() const
+	{
+		return (S32)((mRecords.size() + ITEMS_PER_JOB - 1) / ITEMS_PER_JOB);
+	}
+
+	/*virtual*/ void run(S32 index)
+	{
+		U32 begin = (U32)index * ITEMS_PER_JOB;
+		U32 end = llmin(begin + ITEMS_PER_JOB, (U32)mRecords.size());
+		for (U32 i = begin; i < end; ++i)
+		{
+			LLPointer<LLInventoryItem> item = mFactory.createItem();
+			if (decodeItem(mRecords[i].mData, mRecords[i].mSize, *item))
+			{
+				mOut[mFirst + i] = item;
+			}
+			else
+			{
+				mFailed++;
+			}
+		}
+	}
+
+	std::vector<Record> mRecords;
+	ItemFactory& mFactory;
+	item_list_t& mOut;
+	U32 mFirst;
+	LLAtomicU32 mFailed;
+};
+
+void LLInventoryCache::getItems(const std::set<LLUUID>& category_ids, ItemFactory& factory, item_list_t& items) const
+{
+	U32 first = items.size();
+	DecodeBody body(factory, items, first);
+	for (std::set<LLUUID>::const_iterator it = category_ids.begin(); it != category_ids.end(); ++it)
+	{
+		slot_map_t::const_iterator slot = mSlots.find(*it);
+		if (slot == mSlots.end())
+		{
+			continue;
+		}
+		const Segment& segment = mSegments[slot->second.mSegment];
+		const CategoryEntry& entry = segment.mCategories[slot->second.mEntry];
+		const U8* records = getRecords(slot->second);
+		for (U32 i = 0; i < entry.mItemCount; ++i)
+		{
+			U32 offset = segment.mItemOffsets[entry.mFirstItem + i];
+			DecodeBody::Record record;
+			record.mData = records + offset;
+			record.mSize = segment.mRecordsSize - offset;
+			body.mRecords.push_back(record);
+		}
+	}
+
+	items.resize(first + body.mRecords.size());
+	S32 jobs = body.getJobCount();
+	LLTaskScheduler* scheduler = LLTaskScheduler::getInstance();
+	if (scheduler && jobs > 1)
+	{
+		scheduler->parallelFor(jobs, body);
+	}
+	else
+	{
+		for (S32 i = 0; i < jobs; ++i)
+		{
+			body.run(i);
+		}
+	}
+
+	if ((U32)body.mFailed)
+	{
+		llwarns << "Ignoring " << (U32)body.mFailed << " bad cached inventory items" << llendl;
+		U32 kept = first;
+		for (U32 i = first; i < items.size(); ++i)
+		{
+			if (items[i].notNull())
+			{
+				items[kept++] = items[i];
+			}
+		}
+		items.resize(kept);
+	}
+}
+
+bool LLInventoryCache::save(const std::string& filename, S32 cache_version,
+							const category_list_t& categories, const item_ptr_list_t& items)
+{
+	mLastSaveSize = 0;
+	mLastSaveRewrote = false;
+
+	if (filename != mFilename)
+	{
+		load(filename, cache_version);
+	}
+
+	// group the items by category, in the order given
+	std::map<LLUUID, U32> category_index;
+	for (U32 i = 0; i < categories.size(); ++i)
+	{
+		category_index[categories[i].mID] = i;
+	}
+	std::vector<std::vector<const LLInventoryItem*> > children(categories.size());
+	for (U32 i = 0; i < items.size(); ++i)
+	{
+		std::map<LLUUID, U32>::const_iterator it = category_index.find(items[i]->getParentUUID());
+		if (it != category_index.end())
+		{
+			children[it->second].push_back(items[i]);
+		}
+	}
+
+	// encode every block and see which ones the file lacks
+	std::vector<std::vector<U8> > blocks(categories.size());
+	std::vector<std::vector<U32> > offsets(categories.size());
+	std::vector<U64> hashes(categories.size());
+	std::vector<U32> changed;
+	U32 changed_size = 0;
+	for (U32 i = 0; i < categories.size(); ++i)
+	{
+		std::vector<U8>& block = blocks[i];
+		encode_category(categories[i], block);
+		for (U32 j = 0; j < children[i].size(); ++j)
+		{
+			offsets[i].push_back(block.size());
+			encodeItem(*children[i][j], block);
+		}
+		hashes[i] = hash_bytes(&block[0], block.size());
+
+		slot_map_t::const_iterator it = mSlots.find(categories[i].mID);
+		if (it == mSlots.end()
+			|| mSegments[it->second.mSegment].mCategories[it->second.mEntry].mHash != hashes[i])
+		{
+			changed.push_back(i);
+			changed_size += block.size();
+		}
+	}
+	std::vector<LLUUID> removed;
+	for (slot_map_t::const_iterator it = mSlots.begin(); it != mSlots.end(); ++it)
+	{
+		if (category_index.find(it->first) == category_index.end())
+		{
+			removed.push_back(it->first);
+		}
+	}
+
+	bool have_file = !mSegments.empty() && mValidSize == mData.size();
+	if (have_file && changed.empty() && removed.empty())
+	{
+		return true;
+	}
+
+	// deltas past the base make the file slower to load, compact them
+	U32 base_size = 0;
+	if (have_file)
+	{
+		base_size = mSegments[0].mRecordsOffset + mSegments[0].mRecordsSize;
+	}
+	bool rewrite = !have_file
+		|| mSegments.size() >= MAX_SEGMENTS
+		|| (F32)(mValidSize - base_size + changed_size) > (F32)base_size * MAX_DELTA_RATIO;
+
+	std::vector<U32> which;
+	if (rewrite)
+	{
+		which.resize(categories.size());
+		for (U32 i = 0; i < categories.size(); ++i)
+		{
+			which[i] = i;
+		}
+		removed.clear();
+	}
+	else
+	{
+		which.swap(changed);
+	}
+
+	// index sorted by id
+	std::vector<std::pair<LLUUID, U32> > sorted;
+	sorted.reserve(which.size());
+	for (U32 i = 0; i < which.size(); ++i)
+	{
+		sorted.push_back(std::make_pair(categories[which[i]].mID, which[i]));
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	std::vector<U8> tables;
+	std::vector<U32> item_offsets;
+	U32 records_size = 0;
+	for (U32 i = 0; i < sorted.size(); ++i)
+	{
+		U32 c = sorted[i].second;
+		U32 item_count = children[c].size();
+		put_uuid(tables, categories[c].mID);
+		put_u32(tables, records_size);
+		put_u32(tables, blocks[c].size());
+		put_u32(tables, item_offsets.size());
+		put_u32(tables, item_count);
+		put_u64(tables, hashes[c]);
+
+		for (U32 j = 0; j < item_count; ++j)
+		{
+			item_offsets.push_back(records_size + offsets[c][j]);
+		}
+		records_size += blocks[c].size();
+	}
+	for (U32 i = 0; i < item_offsets.size(); ++i)
+	{
+		put_u32(tables, item_offsets[i]);
+	}
+	for (U32 i = 0; i < removed.size(); ++i)
+	{
+		put_uuid(tables, removed[i]);
+	}
+
+	U64 checksum = hash_bytes(tables.empty() ? NULL : &tables[0], tables.size());
+	for (U32 i = 0; i < sorted.size(); ++i)
+	{
+		const std::vector<U8>& block = blocks[sorted[i].second];
+		checksum = hash_bytes(&block[0], block.size(), checksum);
+	}
+
+	std::vector<U8> header;
+	put_bytes(header, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+	put_u32(header, FORMAT_VERSION);
+	put_u32(header, (U32)cache_version);
+	put_u32(header, rewrite ? SEGMENT_FLAG_BASE : 0);
+	put_u32(header, sorted.size());
+	put_u32(header, item_offsets.size());
+	put_u32(header, removed.size());
+	put_u32(header, tables.size() + records_size);
+	put_u64(header, checksum);
+	llassert(header.size() == SEGMENT_HEADER_SIZE);
+
+	// a rewrite goes to a new file first, a delta is appended
+	std::string write_name = rewrite ? filename + ".tmp" : filename;
+	LLFILE* fp = LLFile::fopen(write_name, rewrite ? "wb" : "ab");
+	if (!fp)
+	{
+		llwarns << "Unable to write inventory cache " << write_name << llendl;
+		clear();
+		return false;
+	}
+	bool ok = fwrite(&header[0], 1, header.size(), fp) == header.size();
+	if (ok && !tables.empty())
+	{
+		ok = fwrite(&tables[0], 1, tables.size(), fp) == tables.size();
+	}
+	for (U32 i = 0; ok && i < sorted.size(); ++i)
+	{
+		const std::vector<U8>& block = blocks[sorted[i].second];
+		ok = fwrite(&block[0], 1, block.size(), fp) == block.size();
+	}
+	ok = (fclose(fp) == 0) && ok;
+
+	if (ok && rewrite)
+	{
+		LLFile::remove(filename);
+		ok = LLFile::rename(write_name, filename) == 0;
+	}
+	if (!ok)
+	{
+		llwarns << "Failed writing inventory cache " << write_name << llendl;
+		if (rewrite)
+		{
+			LLFile::remove(write_name);
+		}
+	}
+
+	mLastSaveSize = header.size() + tables.size() + records_size;
+	mLastSaveRewrote = rewrite;
+
+	// the file changed under our index, read it again on the next save
+	clear();
+	return ok;
+}
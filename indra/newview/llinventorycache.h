@@ -0,0 +1,181 @@
+/** 
+ * @file llinventorycache.h
+ * @brief Binary, indexed inventory cache
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+#ifndef LL_LLINVENTORYCACHE_H
+#define LL_LLINVENTORYCACHE_H
+
+#include "llfoldertype.h"
+#include "llpointer.h"
+#include "lluuid.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class LLInventoryItem;
+
+// The agent's inventory cache, as one binary file.
+//
+// The file is a list of segments.  The first one holds every cached
+// category; each later one (a delta) holds the categories that changed
+// since, and the ids of the categories that went away.  A segment is:
+//
+//   header        magic, format and cache versions, counts, payload size
+//                 and checksum
+//   category index  per category: id, where its block starts and ends,
+//                 its first item and item count, a hash of the block
+//   item table    record offset of every item, grouped by category
+//   removed ids
+//   records       one block per category: the category record followed
+//                 by the records of its items
+//
+// The index lets load() stay away from the item records until asked for
+// some categories' items, and getItems() decodes those in parallel.
+// save() compares block hashes with what the file already holds and
+// appends only the blocks that differ, rewriting the whole file when the
+// deltas have grown to half the base.  A torn trailing segment fails its
+// checksum and is ignored, leaving the cache as of the previous save.
+class LLInventoryCache
+{
+public:
+	// A category as cached
+	struct Category
+	{
+		Category();
+
+		LLUUID mID;
+		LLUUID mParentID;
+		LLUUID mOwnerID;
+		LLFolderType::EType mPreferredType;
+		S32 mVersion;
+		std::string mName;
+	};
+	typedef std::vector<Category> category_list_t;
+	typedef std::vector<const LLInventoryItem*> item_ptr_list_t;
+	typedef std::vector<LLPointer<LLInventoryItem> > item_list_t;
+
+	// Makes the items getItems() decodes into.  Called from several
+	// threads at once.
+	class ItemFactory
+	{
+	public:
+		virtual ~ItemFactory() {}
+		virtual LLInventoryItem* createItem() = 0;
+	};
+
+	enum EStatus
+	{
+		STATUS_OK = 0,
+		STATUS_NOT_FOUND,	// no cache file
+		STATUS_OBSOLETE,	// written for another cache version
+		STATUS_CORRUPT		// unreadable from the first segment on
+	};
+
+	enum { FORMAT_VERSION = 1 };
+
+	LLInventoryCache();
+	~LLInventoryCache();
+
+	// Reads the file and its index.  Segments after a bad one are ignored.
+	EStatus load(const std::string& filename, S32 cache_version);
+	void clear();
+
+	// The cached categories, with later segments applied
+	const category_list_t& getCategories() const { return mCategoryList; }
+	// Number of cached items in a category, 0 if not cached
+	U32 getItemCount(const LLUUID& category_id) const;
+	// Appends the items of the given categories to items.  The work is
+	// split over LLTaskScheduler's workers when there is one.
+	void getItems(const std::set<LLUUID>& category_ids, ItemFactory& factory, item_list_t& items) const;
+
+	// Writes categories and the items in them, appending a delta to the
+	// file loaded last or rewriting it.  Items whose parent is not in
+	// categories are not cached.  Returns false if the file could not
+	// be written.
+	bool save(const std::string& filename, S32 cache_version,
+			  const category_list_t& categories, const item_ptr_list_t& items);
+
+	// For tests and stats
+	U32 getSegmentCount() const { return (U32)mSegments.size(); }
+	U32 getLastSaveSize() const { return mLastSaveSize; }
+	bool getLastSaveRewrote() const { return mLastSaveRewrote; }
+
+	// Record codecs, exposed for tests
+	static void encodeItem(const LLInventoryItem& item, std::vector<U8>& out);
+	static bool decodeItem(const U8* data, U32 size, LLInventoryItem& item);
+
+private:
+	struct CategoryEntry
+	{
+		LLUUID mID;
+		U32 mBlockOffset;
+		U32 mBlockSize;
+		U32 mFirstItem;
+		U32 mItemCount;
+		U64 mHash;
+	};
+
+	struct Segment
+	{
+		std::vector<CategoryEntry> mCategories;
+		std::vector<U32> mItemOffsets;
+		std::vector<LLUUID> mRemoved;
+		U32 mRecordsOffset;		// in mData
+		U32 mRecordsSize;
+	};
+
+	// Where the current version of a category lives
+	struct Slot
+	{
+		U32 mSegment;
+		U32 mEntry;
+	};
+	typedef std::map<LLUUID, Slot> slot_map_t;
+
+	class DecodeBody;
+
+	bool parseSegment(U32& offset, S32 cache_version, bool& obsolete);
+	const U8* getRecords(const Slot& slot) const;
+
+	std::vector<U8> mData;		// the whole file
+	U32 mValidSize;				// bytes of mData in good segments
+	std::vector<Segment> mSegments;
+	slot_map_t mSlots;
+	category_list_t mCategoryList;
+	std::string mFilename;
+	U32 mLastSaveSize;
+	bool mLastSaveRewrote;
+};
+
+#endif // LL_LLINVENTORYCACHE_H
@@ -108,13 +108,31 @@ BOOL LLInventoryFilter::check(const LLFolderViewItem* item)
 	return passed;
 }
 
+BOOL LLInventoryFilter::check(const LLInventorySearchIndex::Entry& entry)
+{
+	// Unlike check(item), folders aren't passed just for SHOW_ALL_FOLDERS,
+	// they show anyway once their parent folder is open.  The index holds
+	// bare names, without the suffixes and localized folder names the
+	// views search, so the views have the final say.
+	return checkAgainstFilterType(entry.mInventoryType, entry.mID, entry.mCreationDate) &&
+		(mFilterSubString.size() == 0 || entry.mName.find(mFilterSubString) != std::string::npos) &&
+		((entry.mPermissions & mFilterOps.mPermissions) == mFilterOps.mPermissions);
+}
+
 BOOL LLInventoryFilter::checkAgainstFilterType(const LLFolderViewItem* item)
 {
 	const LLFolderViewEventListener* listener = item->getListener();
 	if (!listener) return FALSE;
 
-	const LLInventoryType::EType object_type = listener->getInventoryType();
-	const LLUUID object_id = listener->getUUID();
+	return checkAgainstFilterType(listener->getInventoryType(),
+								  listener->getUUID(),
+								  listener->getCreationDate());
+}
+
+BOOL LLInventoryFilter::checkAgainstFilterType(LLInventoryType::EType object_type,
+											   const LLUUID& object_id,
+											   time_t creation_date)
+{
 	const LLInventoryObject *object = gInventory.getObject(object_id);
 
 	const U32 filterTypes = mFilterOps.mFilterTypes;
@@ -150,7 +168,7 @@ BOOL LLInventoryFilter::checkAgainstFilterType(const LLFolderViewItem* item)
 		if (!object) return FALSE;
 
 		LLUUID cat_id = object_id;
-		if (listener->getInventoryType() != LLInventoryType::IT_CATEGORY)
+		if (object_type != LLInventoryType::IT_CATEGORY)
 		{
 			cat_id = object->getParentUUID();
 		}
@@ -193,8 +211,8 @@ BOOL LLInventoryFilter::checkAgainstFilterType(const LLFolderViewItem* item)
 		{
 			earliest = 0;
 		}
-		if (listener->getCreationDate() < earliest ||
-			listener->getCreationDate() > mFilterOps.mMaxDate)
+		if (creation_date < earliest ||
+			creation_date > mFilterOps.mMaxDate)
 			return FALSE;
 	}
 	//
@@ -36,6 +36,7 @@
 
 #include "llinventorytype.h"
 #include "llpermissionsflags.h"
+#include "llinventorysearchindex.h"
 
 class LLFolderViewItem;
 
@@ -103,6 +104,9 @@ public:
 	// +-------------------------------------------------------------------+
 	BOOL 				check(const LLFolderViewItem* item);
 	BOOL 				checkAgainstFilterType(const LLFolderViewItem* item);
+	// Whether an object that may not have a view yet matches the filter,
+	// see LLInventoryModel::getSearchIndex().
+	BOOL 				check(const LLInventorySearchIndex::Entry& entry);
 	std::string::size_type getStringMatchOffset() const;
 
 	// +-------------------------------------------------------------------+
@@ -158,6 +162,10 @@ public:
 	void 				fromLLSD(LLSD& data);
 
 private:
+	BOOL 				checkAgainstFilterType(LLInventoryType::EType object_type,
+											   const LLUUID& object_id,
+											   time_t creation_date);
+
 	struct FilterOps
 	{
 		FilterOps();
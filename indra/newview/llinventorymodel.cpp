@@ -38,6 +38,7 @@
 #include "llagentwearables.h"
 #include "llinventorypanel.h"
 #include "llinventorybridge.h"
+#include "llinventorycache.h"
 #include "llinventoryfunctions.h"
 #include "llinventoryobserver.h"
 #include "llinventorypanel.h"
@@ -85,6 +86,15 @@ static std::deque<LLUUID> sFetchQueue;
 const F32 MAX_TIME_FOR_SINGLE_FETCH = 10.f;
 const S32 MAX_FETCH_RETRIES = 10;
 const char CACHE_FORMAT_STRING[] = "%s.inv"; 
+const char BINARY_CACHE_FORMAT_STRING[] = "%s.invb";
+
+// Items loaded from the binary cache, which like the text cache leaves
+// them to be fetched in full when needed.
+class LLCachedItemFactory : public LLInventoryCache::ItemFactory
+{
+public:
+	/*virtual*/ LLInventoryItem* createItem() { return new LLViewerInventoryItem; }
+};
 
 struct InventoryIDPtrLess
 {
@@ -154,13 +164,10 @@ LLInventoryModel gInventory;
 LLInventoryModel::LLInventoryModel()
 :	mModifyMask(LLInventoryObserver::ALL),
 	mChangedItemIDs(),
-	mCategoryMap(),
-	mItemMap(),
 	mCategoryLock(),
 	mItemLock(),
 	mLastItem(NULL),
-	mParentChildCategoryTree(),
-	mParentChildItemTree(),
+	mSearchIndexStale(true),
 	mObservers(),
 	mRootFolderID(),
 	mLibraryRootFolderID(),
@@ -197,6 +204,18 @@ BOOL LLInventoryModel::isObjectDescendentOf(const LLUUID& obj_id,
 {
 	if (obj_id == cat_id) return TRUE;
 
+	// Once the parent-child arrays are built, the index answers
+	// without climbing the parent chain.
+	if (mIsAgentInvUsable)
+	{
+		const LLViewerInventoryItem* item = getItem(obj_id);
+		if (item)
+		{
+			return mIndex.isCategoryUnder(item->getParentUUID(), cat_id);
+		}
+		return mIndex.isCategoryUnder(obj_id, cat_id);
+	}
+
 	const LLInventoryObject* obj = getObject(obj_id);
 	while(obj)
 	{
@@ -265,10 +284,9 @@ LLViewerInventoryItem* LLInventoryModel::getItem(const LLUUID& id) const
 	}
 	else
 	{
-		item_map_t::const_iterator iter = mItemMap.find(id);
-		if (iter != mItemMap.end())
+		item = mIndex.getItem(id);
+		if (item)
 		{
-			item = iter->second;
 			mLastItem = item;
 		}
 	}
@@ -278,23 +296,91 @@ LLViewerInventoryItem* LLInventoryModel::getItem(const LLUUID& id) const
 // Get the category by id. Returns NULL if not found
 LLViewerInventoryCategory* LLInventoryModel::getCategory(const LLUUID& id) const
 {
-	LLViewerInventoryCategory* category = NULL;
-	cat_map_t::const_iterator iter = mCategoryMap.find(id);
-	if (iter != mCategoryMap.end())
-	{
-		category = iter->second;
-	}
-	return category;
+	return mIndex.getCategory(id);
 }
 
 S32 LLInventoryModel::getItemCount() const
 {
-	return mItemMap.size();
+	return mIndex.getItemCount();
 }
 
 S32 LLInventoryModel::getCategoryCount() const
 {
-	return mCategoryMap.size();
+	return mIndex.getCategoryCount();
+}
+
+const LLInventorySearchIndex& LLInventoryModel::getSearchIndex()
+{
+	if (mSearchIndexStale)
+	{
+		mSearchIndex.clear();
+		mSearchIndexChanges.clear();
+		cat_array_t cats;
+		mIndex.getAllCategories(cats);
+		for (S32 i = 0; i < cats.count(); ++i)
+		{
+			updateSearchEntry(cats[i]->getUUID());
+		}
+		item_array_t items;
+		mIndex.getAllItems(items);
+		for (S32 i = 0; i < items.count(); ++i)
+		{
+			updateSearchEntry(items[i]->getUUID());
+		}
+		mSearchIndexStale = false;
+	}
+	else
+	{
+		for (std::set<LLUUID>::iterator it = mSearchIndexChanges.begin();
+			 it != mSearchIndexChanges.end(); ++it)
+		{
+			updateSearchEntry(*it);
+		}
+		mSearchIndexChanges.clear();
+	}
+	return mSearchIndex;
+}
+
+// What the folder view bridges report for the object, see
+// LLInventoryPanel::buildNewViews() and LLItemBridge::getPermissionMask().
+void LLInventoryModel::updateSearchEntry(const LLUUID& id)
+{
+	const LLInventoryObject* obj = getObject(id);
+	if (!obj)
+	{
+		mSearchIndex.remove(id);
+		return;
+	}
+
+	LLInventorySearchIndex::Entry entry;
+	entry.mID = id;
+	entry.mParentID = obj->getParentUUID();
+	entry.mLinkedID = obj->getLinkedUUID();
+	entry.mIsLink = obj->getIsLinkType();
+	entry.mName = obj->getName();
+	LLStringUtil::toUpper(entry.mName);
+
+	const LLViewerInventoryItem* item = getItem(id);
+	if (item)
+	{
+		BOOL copy = item->getPermissions().allowCopyBy(gAgent.getID());
+		BOOL mod = item->getPermissions().allowModifyBy(gAgent.getID());
+		BOOL xfer = item->getPermissions().allowOperationBy(PERM_TRANSFER,
+															gAgent.getID());
+		if (copy) entry.mPermissions |= PERM_COPY;
+		if (mod)  entry.mPermissions |= PERM_MODIFY;
+		if (xfer) entry.mPermissions |= PERM_TRANSFER;
+
+		entry.mInventoryType = item->getInventoryType();
+		entry.mCreationDate = item->getCreationDate();
+	}
+	else
+	{
+		// Folders have full perms and no creation dates.
+		entry.mInventoryType = LLInventoryType::IT_CATEGORY;
+		entry.mPermissions = PERM_ALL;
+	}
+	mSearchIndex.update(entry);
 }
 
 // Return the direct descendents of the id provided. The array
@@ -306,8 +392,8 @@ void LLInventoryModel::getDirectDescendentsOf(const LLUUID& cat_id,
 											  cat_array_t*& categories,
 											  item_array_t*& items) const
 {
-	categories = get_ptr_in_map(mParentChildCategoryTree, cat_id);
-	items = get_ptr_in_map(mParentChildItemTree, cat_id);
+	categories = mIndex.getChildCategories(cat_id);
+	items = mIndex.getChildItems(cat_id);
 }
 
 // SJB: Added version to lock the arrays to catch potential logic bugs
@@ -362,7 +448,7 @@ const LLUUID &LLInventoryModel::findCatUUID(LLFolderType::EType preferred_type,
 	if(root_id.notNull())
 	{
 		cat_array_t* cats = NULL;
-		cats = get_ptr_in_map(mParentChildCategoryTree, root_id);
+		cats = mIndex.getChildCategories(root_id);
 		if(cats)
 		{
 			S32 count = cats->count();
@@ -457,6 +543,14 @@ void LLInventoryModel::collectDescendents(const LLUUID& id,
 										  item_array_t& items,
 										  BOOL include_trash)
 {
+	// the index keeps subtree sizes, so the arrays only grow once
+	S32 cat_count = 0;
+	S32 item_count = 0;
+	if (mIndex.getDescendentCounts(id, cat_count, item_count))
+	{
+		cats.reserve(cats.count() + cat_count);
+		items.reserve(items.count() + item_count);
+	}
 	LLAlwaysCollect always;
 	collectDescendentsIf(id, cats, items, include_trash, always);
 }
@@ -468,30 +562,20 @@ void LLInventoryModel::collectDescendentsIf(const LLUUID& id,
 											LLInventoryCollectFunctor& add,
 											BOOL follow_folder_links)
 {
-	// Start with categories
+	// Everything under the trash is skipped, trash itself is not
+	LLUUID trash_id;
 	if(!include_trash)
 	{
-		const LLUUID trash_id = findCategoryUUIDForType(LLFolderType::FT_TRASH);
+		trash_id = findCategoryUUIDForType(LLFolderType::FT_TRASH);
 		if(trash_id.notNull() && (trash_id == id))
 			return;
 	}
-	cat_array_t* cat_array = get_ptr_in_map(mParentChildCategoryTree, id);
-	if(cat_array)
-	{
-		S32 count = cat_array->count();
-		for(S32 i = 0; i < count; ++i)
-		{
-			LLViewerInventoryCategory* cat = cat_array->get(i);
-			if(add(cat,NULL))
-			{
-				cats.put(cat);
-			}
-			collectDescendentsIf(cat->getUUID(), cats, items, include_trash, add);
-		}
-	}
+
+	// Start with categories and everything under them
+	mIndex.collectDescendentsIf(id, cats, items, trash_id, add, false);
 
 	LLViewerInventoryItem* item = NULL;
-	item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, id);
+	item_array_t* item_array = mIndex.getChildItems(id);
 
 	// Follow folder links recursively.  Currently never goes more
 	// than one level deep (for current outfit support)
@@ -517,7 +601,10 @@ void LLInventoryModel::collectDescendentsIf(const LLUUID& id,
 						// outfit traversal.
 						cats.put(LLPointer<LLViewerInventoryCategory>(linked_cat));
 					}
-					collectDescendentsIf(linked_cat->getUUID(), cats, items, include_trash, add, FALSE);
+					if(linked_cat->getUUID() != trash_id)
+					{
+						mIndex.collectDescendentsIf(linked_cat->getUUID(), cats, items, trash_id, add);
+					}
 				}
 			}
 		}
@@ -660,17 +747,8 @@ U32 LLInventoryModel::updateItem(const LLViewerInventoryItem* item)
 		if(old_parent_id != new_parent_id)
 		{
 			// need to update the parent-child tree
-			item_array_t* item_array;
-			item_array = get_ptr_in_map(mParentChildItemTree, old_parent_id);
-			if(item_array)
-			{
-				item_array->removeObj(old_item);
-			}
-			item_array = get_ptr_in_map(mParentChildItemTree, new_parent_id);
-			if(item_array)
-			{
-				item_array->put(old_item);
-			}
+			mIndex.unlinkItem(old_item, old_parent_id);
+			mIndex.linkItem(old_item, new_parent_id);
 			mask |= LLInventoryObserver::STRUCTURE;
 		}
 		if(old_item->getName() != item->getName())
@@ -690,12 +768,11 @@ U32 LLInventoryModel::updateItem(const LLViewerInventoryItem* item)
 		{
 			const LLUUID category_id = findCategoryUUIDForType(LLFolderType::assetTypeToFolderType(new_item->getType()));
 			new_item->setParent(category_id);
-			item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, category_id);
-			if( item_array )
+			if( mIndex.getChildItems(category_id) )
 			{
 				// *FIX: bit of a hack to call update server from here...
 				new_item->updateServer(TRUE);
-				item_array->put(new_item);
+				mIndex.linkItem(new_item, category_id);
 			}
 			else
 			{
@@ -715,25 +792,19 @@ U32 LLInventoryModel::updateItem(const LLViewerInventoryItem* item)
 				parent_id = findCategoryUUIDForType(LLFolderType::FT_LOST_AND_FOUND);
 				new_item->setParent(parent_id);
 			}
-			item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, parent_id);
-			if(item_array)
-			{
-				item_array->put(new_item);
-			}
-			else
+			if(!mIndex.linkItem(new_item, parent_id))
 			{
 				// Whoops! No such parent, make one.
 				llinfos << "Lost item: " << new_item->getUUID() << " - "
 						<< new_item->getName() << llendl;
 				parent_id = findCategoryUUIDForType(LLFolderType::FT_LOST_AND_FOUND);
 				new_item->setParent(parent_id);
-				item_array = get_ptr_in_map(mParentChildItemTree, parent_id);
-				if(item_array)
+				if(mIndex.getChildItems(parent_id))
 				{
 					// *FIX: bit of a hack to call update server from
 					// here...
 					new_item->updateServer(TRUE);
-					item_array->put(new_item);
+					mIndex.linkItem(new_item, parent_id);
 				}
 				else
 				{
@@ -770,7 +841,7 @@ U32 LLInventoryModel::updateItem(const LLViewerInventoryItem* item)
 
 LLInventoryModel::cat_array_t* LLInventoryModel::getUnlockedCatArray(const LLUUID& id)
 {
-	cat_array_t* cat_array = get_ptr_in_map(mParentChildCategoryTree, id);
+	cat_array_t* cat_array = mIndex.getChildCategories(id);
 	if (cat_array)
 	{
 		llassert_always(mCategoryLock[id] == false);
@@ -780,7 +851,7 @@ LLInventoryModel::cat_array_t* LLInventoryModel::getUnlockedCatArray(const LLUUI
 
 LLInventoryModel::item_array_t* LLInventoryModel::getUnlockedItemArray(const LLUUID& id)
 {
-	item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, id);
+	item_array_t* item_array = mIndex.getChildItems(id);
 	if (item_array)
 	{
 		llassert_always(mItemLock[id] == false);
@@ -813,16 +884,13 @@ void LLInventoryModel::updateCategory(const LLViewerInventoryCategory* cat)
 		if(old_parent_id != new_parent_id)
 		{
 			// need to update the parent-child tree
-			cat_array_t* cat_array;
-			cat_array = getUnlockedCatArray(old_parent_id);
-			if(cat_array)
+			if(getUnlockedCatArray(old_parent_id))
 			{
-				cat_array->removeObj(old_cat);
+				mIndex.unlinkCategory(old_cat, old_parent_id);
 			}
-			cat_array = getUnlockedCatArray(new_parent_id);
-			if(cat_array)
+			if(getUnlockedCatArray(new_parent_id))
 			{
-				cat_array->put(old_cat);
+				mIndex.linkCategory(old_cat, new_parent_id);
 			}
 			mask |= LLInventoryObserver::STRUCTURE;
 		}
@@ -841,20 +909,15 @@ void LLInventoryModel::updateCategory(const LLViewerInventoryCategory* cat)
 		addCategory(new_cat);
 
 		// make sure this category is correctly referenced by it's parent.
-		cat_array_t* cat_array;
-		cat_array = getUnlockedCatArray(cat->getParentUUID());
-		if(cat_array)
+		if(getUnlockedCatArray(cat->getParentUUID()))
 		{
-			cat_array->put(new_cat);
+			mIndex.linkCategory(new_cat, cat->getParentUUID());
 		}
 
-		// make space in the tree for this category's children.
+		// addCategory() made space in the tree for this category's
+		// children.
 		llassert_always(mCategoryLock[new_cat->getUUID()] == false);
 		llassert_always(mItemLock[new_cat->getUUID()] == false);
-		cat_array_t* catsp = new cat_array_t;
-		item_array_t* itemsp = new item_array_t;
-		mParentChildCategoryTree[new_cat->getUUID()] = catsp;
-		mParentChildItemTree[new_cat->getUUID()] = itemsp;
 		addChangedMask(LLInventoryObserver::ADD, cat->getUUID());
 	}
 }
@@ -868,7 +931,7 @@ void LLInventoryModel::moveObject(const LLUUID& object_id, const LLUUID& cat_id)
 		return;
 	}
 
-	if((object_id == cat_id) || !is_in_map(mCategoryMap, cat_id))
+	if((object_id == cat_id) || !getCategory(cat_id))
 	{
 		llwarns << "Could not move inventory object " << object_id << " to "
 				<< cat_id << llendl;
@@ -877,24 +940,18 @@ void LLInventoryModel::moveObject(const LLUUID& object_id, const LLUUID& cat_id)
 	LLViewerInventoryCategory* cat = getCategory(object_id);
 	if(cat && (cat->getParentUUID() != cat_id))
 	{
-		cat_array_t* cat_array;
-		cat_array = getUnlockedCatArray(cat->getParentUUID());
-		if(cat_array) cat_array->removeObj(cat);
-		cat_array = getUnlockedCatArray(cat_id);
+		if(getUnlockedCatArray(cat->getParentUUID())) mIndex.unlinkCategory(cat, cat->getParentUUID());
 		cat->setParent(cat_id);
-		if(cat_array) cat_array->put(cat);
+		if(getUnlockedCatArray(cat_id)) mIndex.linkCategory(cat, cat_id);
 		addChangedMask(LLInventoryObserver::STRUCTURE, object_id);
 		return;
 	}
 	LLViewerInventoryItem* item = getItem(object_id);
 	if(item && (item->getParentUUID() != cat_id))
 	{
-		item_array_t* item_array;
-		item_array = getUnlockedItemArray(item->getParentUUID());
-		if(item_array) item_array->removeObj(item);
-		item_array = getUnlockedItemArray(cat_id);
+		if(getUnlockedItemArray(item->getParentUUID())) mIndex.unlinkItem(item, item->getParentUUID());
 		item->setParent(cat_id);
-		if(item_array) item_array->put(item);
+		if(getUnlockedItemArray(cat_id)) mIndex.linkItem(item, cat_id);
 		addChangedMask(LLInventoryObserver::STRUCTURE, object_id);
 		return;
 	}
@@ -914,33 +971,21 @@ void LLInventoryModel::deleteObject(const LLUUID& id)
 	lldebugs << "Deleting inventory object " << id << llendl;
 	mLastItem = NULL;
 	LLUUID parent_id = obj->getParentUUID();
-	mCategoryMap.erase(id);
-	mItemMap.erase(id);
-	//mInventory.erase(id);
-	item_array_t* item_list = getUnlockedItemArray(parent_id);
-	if(item_list)
-	{
-		LLViewerInventoryItem* item = (LLViewerInventoryItem*)((LLInventoryObject*)obj);
-		item_list->removeObj(item);
-	}
-	cat_array_t* cat_list = getUnlockedCatArray(parent_id);
-	if(cat_list)
-	{
-		LLViewerInventoryCategory* cat = (LLViewerInventoryCategory*)((LLInventoryObject*)obj);
-		cat_list->removeObj(cat);
-	}
-	item_list = getUnlockedItemArray(id);
-	if(item_list)
+	LLViewerInventoryItem* item = mIndex.getItem(id);
+	if(item && getUnlockedItemArray(parent_id))
 	{
-		delete item_list;
-		mParentChildItemTree.erase(id);
+		mIndex.unlinkItem(item, parent_id);
 	}
-	cat_list = getUnlockedCatArray(id);
-	if(cat_list)
+	LLViewerInventoryCategory* cat = mIndex.getCategory(id);
+	if(cat && getUnlockedCatArray(parent_id))
 	{
-		delete cat_list;
-		mParentChildCategoryTree.erase(id);
+		mIndex.unlinkCategory(cat, parent_id);
 	}
+	// the child arrays go with the category, they must not be locked
+	getUnlockedItemArray(id);
+	getUnlockedCatArray(id);
+	mIndex.removeCategory(id);
+	mIndex.removeItem(id);
 	addChangedMask(LLInventoryObserver::REMOVE, id);
 	obj = NULL; // delete obj
 	updateLinkedObjectsFromPurge(id);
@@ -1213,6 +1258,15 @@ void LLInventoryModel::addChangedMask(U32 mask, const LLUUID& referent)
 	if (referent.notNull())
 	{
 		mChangedItemIDs.insert(referent);
+		if (!mSearchIndexStale)
+		{
+			mSearchIndexChanges.insert(referent);
+		}
+	}
+	else if (mask & (LLInventoryObserver::REBUILD | LLInventoryObserver::ADD | LLInventoryObserver::REMOVE))
+	{
+		// no telling what changed
+		mSearchIndexStale = true;
 	}
 	
 	// Update all linked items.  Starting with just LABEL because I'm
@@ -1587,11 +1641,9 @@ void LLInventoryModel::bulkFetch(std::string url)
 					sLibraryFetchStarted)
 			    {	//Already have this folder but append child folders to list.
 				    // add all children to queue
-				    parent_cat_map_t::iterator cat_it = gInventory.mParentChildCategoryTree.find(cat->getUUID());
-				    if (cat_it != gInventory.mParentChildCategoryTree.end())
+				    cat_array_t* child_categories = gInventory.mIndex.getChildCategories(cat->getUUID());
+				    if (child_categories)
 				    {
-					    cat_array_t* child_categories = cat_it->second;
-    
 					    for (S32 child_num = 0; child_num < child_categories->count(); child_num++)
 					    {
 						    sFetchQueue.push_back(child_categories->get(child_num)->getUUID());
@@ -1837,11 +1889,9 @@ void LLInventoryModel::backgroundFetch(void*)
 				sFetchQueue.pop_front();
 
 				// add all children to queue
-				parent_cat_map_t::iterator cat_it = gInventory.mParentChildCategoryTree.find(cat->getUUID());
-				if (cat_it != gInventory.mParentChildCategoryTree.end())
+				cat_array_t* child_categories = gInventory.mIndex.getChildCategories(cat->getUUID());
+				if (child_categories)
 				{
-					cat_array_t* child_categories = cat_it->second;
-
 					for (S32 child_num = 0; child_num < child_categories->count(); child_num++)
 					{
 						sFetchQueue.push_back(child_categories->get(child_num)->getUUID());
@@ -1908,9 +1958,46 @@ void LLInventoryModel::cache(
 	agent_id.toString(agent_id_str);
 	std::string path(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, agent_id_str));
 	inventory_filename = llformat(CACHE_FORMAT_STRING, path.c_str());
-	saveToFile(inventory_filename, categories, items);
 	std::string gzip_filename(inventory_filename);
 	gzip_filename.append(".gz");
+
+	// The binary cache only writes the folders that changed since the
+	// last save.
+	LLInventoryCache::category_list_t cache_categories;
+	S32 count = categories.count();
+	for(S32 i = 0; i < count; ++i)
+	{
+		LLViewerInventoryCategory* cat = categories[i];
+		if(cat->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
+		{
+			LLInventoryCache::Category cache_cat;
+			cache_cat.mID = cat->getUUID();
+			cache_cat.mParentID = cat->getParentUUID();
+			cache_cat.mOwnerID = cat->getOwnerID();
+			cache_cat.mPreferredType = cat->getPreferredType();
+			cache_cat.mVersion = cat->getVersion();
+			cache_cat.mName = cat->getName();
+			cache_categories.push_back(cache_cat);
+		}
+	}
+	LLInventoryCache::item_ptr_list_t cache_items;
+	count = items.count();
+	cache_items.reserve(count);
+	for(S32 i = 0; i < count; ++i)
+	{
+		cache_items.push_back(items[i].get());
+	}
+	LLInventoryCache inventory_cache;
+	if(inventory_cache.save(llformat(BINARY_CACHE_FORMAT_STRING, path.c_str()),
+							sCurrentInvCacheVersion, cache_categories, cache_items))
+	{
+		// loadSkeleton() prefers the binary cache, a text one would
+		// only go stale
+		LLFile::remove(gzip_filename);
+		return;
+	}
+
+	saveToFile(inventory_filename, categories, items);
 	if(gzip_file(inventory_filename, gzip_filename))
 	{
 		lldebugs << "Successfully compressed " << inventory_filename << llendl;
@@ -1928,9 +2015,8 @@ void LLInventoryModel::addCategory(LLViewerInventoryCategory* category)
 	//llinfos << "LLInventoryModel::addCategory()" << llendl;
 	if(category)
 	{
-		// Insert category uniquely into the map
-		mCategoryMap[category->getUUID()] = category; // LLPointer will deref and delete the old one
-		//mInventory[category->getUUID()] = category;
+		// Insert category uniquely into the index
+		mIndex.addCategory(category); // LLPointer will deref and delete the old one
 	}
 }
 
@@ -1958,7 +2044,7 @@ void LLInventoryModel::addItem(LLViewerInventoryItem* item)
 			llinfos << "Adding broken link [ name: " << item->getName() << " itemID: " << item->getUUID() << " assetID: " << item->getAssetUUID() << " )  parent: " << item->getParentUUID() << llendl;
 		}
 
-		mItemMap[item->getUUID()] = item;
+		mIndex.addItem(item);
 	}
 }
 
@@ -1966,20 +2052,9 @@ void LLInventoryModel::addItem(LLViewerInventoryItem* item)
 void LLInventoryModel::empty()
 {
 //	llinfos << "LLInventoryModel::empty()" << llendl;
-	std::for_each(
-		mParentChildCategoryTree.begin(),
-		mParentChildCategoryTree.end(),
-		DeletePairedPointer());
-	mParentChildCategoryTree.clear();
-	std::for_each(
-		mParentChildItemTree.begin(),
-		mParentChildItemTree.end(),
-		DeletePairedPointer());
-	mParentChildItemTree.clear();
-	mCategoryMap.clear(); // remove all references (should delete entries)
-	mItemMap.clear(); // remove all references (should delete entries)
+	mIndex.clear(); // remove all references (should delete entries)
 	mLastItem = NULL;
-	//mInventory.clear();
+	mSearchIndexStale = true;
 }
 
 void LLInventoryModel::accountForUpdate(const LLCategoryUpdate& update) const
@@ -2112,13 +2187,13 @@ LLInventoryModel::EHasChildren LLInventoryModel::categoryHasChildren(
 	}
 
 	// Shouldn't have to run this, but who knows.
-	parent_cat_map_t::const_iterator cat_it = mParentChildCategoryTree.find(cat->getUUID());
-	if (cat_it != mParentChildCategoryTree.end() && cat_it->second->count() > 0)
+	const cat_array_t* child_categories = mIndex.getChildCategories(cat->getUUID());
+	if (child_categories && child_categories->count() > 0)
 	{
 		return CHILDREN_YES;
 	}
-	parent_item_map_t::const_iterator item_it = mParentChildItemTree.find(cat->getUUID());
-	if (item_it != mParentChildItemTree.end() && item_it->second->count() > 0)
+	const item_array_t* child_items = mIndex.getChildItems(cat->getUUID());
+	if (child_items && child_items->count() > 0)
 	{
 		return CHILDREN_YES;
 	}
@@ -2210,7 +2285,11 @@ bool LLInventoryModel::loadSkeleton(
 		const S32 NO_VERSION = LLViewerInventoryCategory::VERSION_UNKNOWN;
 		std::string gzip_filename(inventory_filename);
 		gzip_filename.append(".gz");
-		LLFILE* fp = LLFile::fopen(gzip_filename, "rb");
+		std::string binary_filename = llformat(BINARY_CACHE_FORMAT_STRING, path.c_str());
+		LLInventoryCache inventory_cache;
+		LLInventoryCache::EStatus cache_status = inventory_cache.load(binary_filename, sCurrentInvCacheVersion);
+		bool use_binary_cache = (cache_status == LLInventoryCache::STATUS_OK);
+		LLFILE* fp = use_binary_cache ? NULL : LLFile::fopen(gzip_filename, "rb");
 		bool remove_inventory_file = false;
 		if(fp)
 		{
@@ -2229,7 +2308,28 @@ bool LLInventoryModel::loadSkeleton(
 			}
 		}
 		bool is_cache_obsolete = false;
-		if(loadFromFile(inventory_filename, categories, items, is_cache_obsolete))
+		bool loaded = false;
+		if(use_binary_cache)
+		{
+			// Only the folders come in now, their items once we know
+			// which folders are current.
+			const LLInventoryCache::category_list_t& cache_categories = inventory_cache.getCategories();
+			for(U32 i = 0; i < cache_categories.size(); ++i)
+			{
+				const LLInventoryCache::Category& cache_cat = cache_categories[i];
+				LLPointer<LLViewerInventoryCategory> cat = new LLViewerInventoryCategory(
+					cache_cat.mID, cache_cat.mParentID, cache_cat.mPreferredType,
+					cache_cat.mName, cache_cat.mOwnerID);
+				cat->setVersion(cache_cat.mVersion);
+				categories.put(cat);
+			}
+			loaded = true;
+		}
+		else
+		{
+			loaded = loadFromFile(inventory_filename, categories, items, is_cache_obsolete);
+		}
+		if(loaded)
 		{
 			// We were able to find a cache of files. So, use what we
 			// found to generate a set of categories we should add. We
@@ -2267,6 +2367,26 @@ bool LLInventoryModel::loadSkeleton(
 				}
 			}
 
+			if(use_binary_cache)
+			{
+				LLCachedItemFactory factory;
+				LLInventoryCache::item_list_t cached_items;
+				inventory_cache.getItems(cached_ids, factory, cached_items);
+				inventory_cache.clear();
+				items.reserve(cached_items.size());
+				for(U32 i = 0; i < cached_items.size(); ++i)
+				{
+					LLViewerInventoryItem* item = (LLViewerInventoryItem*)cached_items[i].get();
+					if(item->getUUID().isNull())
+					{
+						llwarns << "Ignoring inventory with null item id: "
+								<< item->getName() << llendl;
+						continue;
+					}
+					items.put(item);
+				}
+			}
+
 			// go ahead and add the cats returned during the download
 			std::set<LLUUID>::const_iterator not_cached_id = cached_ids.end();
 			cached_category_count = cached_ids.size();
@@ -2287,17 +2407,15 @@ bool LLInventoryModel::loadSkeleton(
 			// Add all the items loaded which are parented to a
 			// category with a correctly cached parent
 			S32 bad_link_count = 0;
-			cat_map_t::iterator unparented = mCategoryMap.end();
 			for(item_array_t::const_iterator item_iter = items.begin();
 				item_iter != items.end();
 				++item_iter)
 			{
 				LLViewerInventoryItem *item = (*item_iter).get();
-				const cat_map_t::iterator cit = mCategoryMap.find(item->getParentUUID());
+				LLViewerInventoryCategory* cat = mIndex.getCategory(item->getParentUUID());
 				
-				if(cit != unparented)
+				if(cat)
 				{
-					const LLViewerInventoryCategory* cat = cit->second.get();
 					if(cat->getVersion() != NO_VERSION)
 					{
 						// This can happen if the linked object's baseobj is removed from the cache but the linked object is still in the cache.
@@ -2308,7 +2426,7 @@ bool LLInventoryModel::loadSkeleton(
 									 << item->getName() << " itemID: " << item->getUUID()
 									 << " assetID: " << item->getAssetUUID()
 									 << " ).  Ignoring and invalidating " << cat->getName() << " . " << llendl;
-							invalid_categories.insert(cit->second);
+							invalid_categories.insert(cat);
 							continue;
 						}
 						addItem(item);
@@ -2380,6 +2498,11 @@ bool LLInventoryModel::loadSkeleton(
 			llwarns << "Inv cache out of date, removing" << llendl;
 			LLFile::remove(gzip_filename);
 		}
+		if(cache_status == LLInventoryCache::STATUS_OBSOLETE)
+		{
+			llwarns << "Binary inv cache out of date, removing" << llendl;
+			LLFile::remove(binary_filename);
+		}
 		categories.clear(); // will unref and delete entries
 	}
 
@@ -2485,39 +2608,14 @@ void LLInventoryModel::buildParentChildMap()
 	// attempt to cache. More time & thought is necessary.
 
 	// First the categories. We'll copy all of the categories into a
-	// temporary container to iterate over (oh for real iterators.)
-	// While we're at it, we'll allocate the arrays in the trees.
+	// temporary container to iterate over. Each one got its child
+	// arrays in the index when it was added.
 	cat_array_t cats;
-	cat_array_t* catsp;
-	item_array_t* itemsp;
-	
-	for(cat_map_t::iterator cit = mCategoryMap.begin(); cit != mCategoryMap.end(); ++cit)
-	{
-		LLViewerInventoryCategory* cat = cit->second;
-		cats.put(cat);
-		if (mParentChildCategoryTree.count(cat->getUUID()) == 0)
-		{
-			llassert_always(mCategoryLock[cat->getUUID()] == false);
-			catsp = new cat_array_t;
-			mParentChildCategoryTree[cat->getUUID()] = catsp;
-		}
-		if (mParentChildItemTree.count(cat->getUUID()) == 0)
-		{
-			llassert_always(mItemLock[cat->getUUID()] == false);
-			itemsp = new item_array_t;
-			mParentChildItemTree[cat->getUUID()] = itemsp;
-		}
-	}
+	mIndex.getAllCategories(cats);
 
 	// Insert a special parent for the root - so that lookups on
-	// LLUUID::null as the parent work correctly. This is kind of a
-	// blatent wastes of space since we allocate a block of memory for
-	// the array, but whatever - it's not that much space.
-	if (mParentChildCategoryTree.count(LLUUID::null) == 0)
-	{
-		catsp = new cat_array_t;
-		mParentChildCategoryTree[LLUUID::null] = catsp;
-	}
+	// LLUUID::null as the parent work correctly.
+	mIndex.addChildArrays(LLUUID::null);
 
 	// Now we have a structure with all of the categories that we can
 	// iterate over and insert into the correct place in the child
@@ -2528,10 +2626,9 @@ void LLInventoryModel::buildParentChildMap()
 	for(i = 0; i < count; ++i)
 	{
 		LLViewerInventoryCategory* cat = cats.get(i);
-		catsp = getUnlockedCatArray(cat->getParentUUID());
-		if(catsp)
+		if(getUnlockedCatArray(cat->getParentUUID()))
 		{
-			catsp->put(cat);
+			mIndex.linkCategory(cat, cat->getParentUUID());
 		}
 		else
 		{
@@ -2561,10 +2658,9 @@ void LLInventoryModel::buildParentChildMap()
 				cat->setParent(gInventory.getRootFolderID());
 			}
 			cat->updateServer(TRUE);
-			catsp = getUnlockedCatArray(cat->getParentUUID());
-			if(catsp)
+			if(getUnlockedCatArray(cat->getParentUUID()))
 			{
-				catsp->put(cat);
+				mIndex.linkCategory(cat, cat->getParentUUID());
 			}
 			else
 			{		
@@ -2585,15 +2681,7 @@ void LLInventoryModel::buildParentChildMap()
 	// have to do is iterate over the items and put them in the right
 	// place.
 	item_array_t items;
-	if(!mItemMap.empty())
-	{
-		LLPointer<LLViewerInventoryItem> item;
-		for(item_map_t::iterator iit = mItemMap.begin(); iit != mItemMap.end(); ++iit)
-		{
-			item = (*iit).second;
-			items.put(item);
-		}
-	}
+	mIndex.getAllItems(items);
 	count = items.count();
 	lost = 0;
 	std::vector<LLUUID> lost_item_ids;
@@ -2601,10 +2689,9 @@ void LLInventoryModel::buildParentChildMap()
 	{
 		LLPointer<LLViewerInventoryItem> item;
 		item = items.get(i);
-		itemsp = getUnlockedItemArray(item->getParentUUID());
-		if(itemsp)
+		if(getUnlockedItemArray(item->getParentUUID()))
 		{
-			itemsp->put(item);
+			mIndex.linkItem(item, item->getParentUUID());
 		}
 		else
 		{
@@ -2618,10 +2705,9 @@ void LLInventoryModel::buildParentChildMap()
 			// we update server here, the client might crash.
 			//item->updateServer();
 			lost_item_ids.push_back(item->getUUID());
-			itemsp = getUnlockedItemArray(item->getParentUUID());
-			if(itemsp)
+			if(getUnlockedItemArray(item->getParentUUID()))
 			{
-				itemsp->put(item);
+				mIndex.linkItem(item, item->getParentUUID());
 			}
 			else
 			{
@@ -2665,7 +2751,7 @@ void LLInventoryModel::buildParentChildMap()
 	const LLUUID &agent_inv_root_id = gInventory.getRootFolderID();
 	if (agent_inv_root_id.notNull())
 	{
-		cat_array_t* catsp = get_ptr_in_map(mParentChildCategoryTree, agent_inv_root_id);
+		cat_array_t* catsp = mIndex.getChildCategories(agent_inv_root_id);
 		if(catsp)
 		{
 			// *HACK - fix root inventory folder
@@ -2673,24 +2759,19 @@ void LLInventoryModel::buildParentChildMap()
 			
 			std::string name = "My Inventory";
 			LLUUID prev_root_id = mRootFolderID;
-			for (parent_cat_map_t::const_iterator it = mParentChildCategoryTree.begin(),
-					 it_end = mParentChildCategoryTree.end(); it != it_end; ++it)
+			for (cat_array_t::const_iterator cat_it = cats.begin(),
+					 cat_it_end = cats.end(); cat_it != cat_it_end; ++cat_it)
 			{
-				cat_array_t* cat_array = it->second;
-				for (cat_array_t::const_iterator cat_it = cat_array->begin(),
-						 cat_it_end = cat_array->end(); cat_it != cat_it_end; ++cat_it)
-					{
-					LLPointer<LLViewerInventoryCategory> category = *cat_it;
+				LLPointer<LLViewerInventoryCategory> category = *cat_it;
 
-					if(category && category->getPreferredType() != LLFolderType::FT_ROOT_INVENTORY)
-						continue;
-					if ( category && 0 == LLStringUtil::compareInsensitive(name, category->getName()) )
+				if(category && category->getPreferredType() != LLFolderType::FT_ROOT_INVENTORY)
+					continue;
+				if ( category && 0 == LLStringUtil::compareInsensitive(name, category->getName()) )
+				{
+					if(category->getUUID()!=mRootFolderID)
 					{
-						if(category->getUUID()!=mRootFolderID)
-						{
-							LLUUID& new_inv_root_folder_id = const_cast<LLUUID&>(mRootFolderID);
-							new_inv_root_folder_id = category->getUUID();
-						}
+						LLUUID& new_inv_root_folder_id = const_cast<LLUUID&>(mRootFolderID);
+						new_inv_root_folder_id = category->getUUID();
 					}
 				}
 			}
@@ -3732,10 +3813,12 @@ void LLInventoryModel::rearrangeFavoriteLandmarks(const LLUUID& source_item_id,
 void LLInventoryModel::dumpInventory() const
 {
 	llinfos << "\nBegin Inventory Dump\n**********************:" << llendl;
-	llinfos << "mCategory[] contains " << mCategoryMap.size() << " items." << llendl;
-	for(cat_map_t::const_iterator cit = mCategoryMap.begin(); cit != mCategoryMap.end(); ++cit)
+	cat_array_t cats;
+	mIndex.getAllCategories(cats);
+	llinfos << "mCategory[] contains " << cats.count() << " items." << llendl;
+	for(cat_array_t::const_iterator cit = cats.begin(); cit != cats.end(); ++cit)
 	{
-		const LLViewerInventoryCategory* cat = cit->second;
+		const LLViewerInventoryCategory* cat = *cit;
 		if(cat)
 		{
 			llinfos << "  " <<  cat->getUUID() << " '" << cat->getName() << "' "
@@ -3747,10 +3830,12 @@ void LLInventoryModel::dumpInventory() const
 			llinfos << "  NULL!" << llendl;
 		}
 	}	
-	llinfos << "mItemMap[] contains " << mItemMap.size() << " items." << llendl;
-	for(item_map_t::const_iterator iit = mItemMap.begin(); iit != mItemMap.end(); ++iit)
+	item_array_t items;
+	mIndex.getAllItems(items);
+	llinfos << "mItemMap[] contains " << items.count() << " items." << llendl;
+	for(item_array_t::const_iterator iit = items.begin(); iit != items.end(); ++iit)
 	{
-		const LLViewerInventoryItem* item = iit->second;
+		const LLViewerInventoryItem* item = *iit;
 		if(item)
 		{
 			llinfos << "  " << item->getUUID() << " "
@@ -39,6 +39,8 @@
 #include "lldarray.h"
 #include "llframetimer.h"
 #include "llhttpclient.h"
+#include "llinventoryindex.h"
+#include "llinventorysearchindex.h"
 #include "lluuid.h"
 #include "llpermissionsflags.h"
 #include "llstring.h"
@@ -136,6 +138,11 @@ public:
 	S32 getItemCount() const;
 	S32 getCategoryCount() const;
 
+	// Names, types, permissions and dates of every object, for
+	// searching without folder views.  Built on first use and kept
+	// up to date from the changes observers are told about.
+	const LLInventorySearchIndex& getSearchIndex();
+
 	// Return the direct descendents of the id provided.Set passed
 	// in values to NULL if the call fails.
 	// *WARNING: The array provided points straight into the guts of
@@ -488,12 +495,6 @@ private:
 	// cache recent lookups
 	mutable LLPointer<LLViewerInventoryItem> mLastItem;
 
-	// This last set of indices is used to map parents to children.
-	typedef std::map<LLUUID, cat_array_t*> parent_cat_map_t;
-	typedef std::map<LLUUID, item_array_t*> parent_item_map_t;
-	parent_cat_map_t mParentChildCategoryTree;
-	parent_item_map_t mParentChildItemTree;
-
 	typedef std::set<LLInventoryObserver*> observer_list_t;
 	observer_list_t mObservers;
 
@@ -518,13 +519,17 @@ private:
 	// Information for tracking the actual inventory. We index this
 	// information in a lot of different ways so we can access
 	// the inventory using several different identifiers.
-	// mInventory member data is the 'master' list of inventory, and
-	// mCategoryMap and mItemMap store uuid->object mappings. 
-	typedef std::map<LLUUID, LLPointer<LLViewerInventoryCategory> > cat_map_t;
-	typedef std::map<LLUUID, LLPointer<LLViewerInventoryItem> > item_map_t;
-	//inv_map_t mInventory;
-	cat_map_t mCategoryMap;
-	item_map_t mItemMap;
+	// mIndex holds every category and item by id, and the child
+	// arrays that map parents to children.
+	typedef LLInventoryIndex<LLViewerInventoryCategory, LLViewerInventoryItem> inventory_index_t;
+	inventory_index_t mIndex;
+
+	// Objects changed since mSearchIndex was last brought up to date,
+	// unless it has to be rebuilt from scratch anyway.
+	void updateSearchEntry(const LLUUID& id);
+	LLInventorySearchIndex mSearchIndex;
+	std::set<LLUUID> mSearchIndexChanges;
+	bool mSearchIndexStale;
 
 	// Flag set when notifyObservers is being called, to look for bugs
 	// where it's called recursively.
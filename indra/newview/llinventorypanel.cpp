@@ -47,6 +47,7 @@
 #include "llsidepanelinventory.h"
 #include "llsidetray.h"
 #include "llscrollcontainer.h"
+#include "llviewercontrol.h"
 #include "llviewerfoldertype.h"
 #include "llvoavatarself.h"
 
@@ -76,6 +77,32 @@ protected:
 	LLInventoryPanel* mIP;
 };
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Class LLCollectSearchResults
+//
+// Collects the search index entries that pass a panel's filter but
+// have no view yet.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class LLCollectSearchResults
+{
+public:
+	LLCollectSearchResults(LLInventoryFilter* filter, LLFolderView* folders) :
+		mFilter(filter), mFolders(folders) {}
+	bool operator()(const LLInventorySearchIndex::Entry& entry)
+	{
+		if (mFolders->getItemByID(entry.mID) || !mFilter->check(entry))
+		{
+			return false;
+		}
+		mResults.push_back(entry.mID);
+		return true;
+	}
+	std::vector<LLUUID> mResults;
+protected:
+	LLInventoryFilter* mFilter;
+	LLFolderView* mFolders;
+};
+
 LLInventoryPanel::LLInventoryPanel(const LLInventoryPanel::Params& p) :	
 	LLPanel(p),
 	mInventoryObserver(NULL),
@@ -87,7 +114,9 @@ LLInventoryPanel::LLInventoryPanel(const LLInventoryPanel::Params& p) :
 	mViewsInitialized(false),
 	mStartFolderString(p.start_folder),	
 	mBuildDefaultHierarchy(true),
-	mInvFVBridgeBuilder(NULL)
+	mInvFVBridgeBuilder(NULL),
+	mSearchGeneration(-1),
+	mSearchMustPassGeneration(-1)
 {
 	mInvFVBridgeBuilder = &INVENTORY_BRIDGE_BUILDER;
 
@@ -192,11 +221,57 @@ LLInventoryPanel::~LLInventoryPanel()
 
 void LLInventoryPanel::draw()
 {
+	updateSearch();
 	// Select the desired item (in case it wasn't loaded when the selection was requested)
 	mFolders->updateSelection();
 	LLPanel::draw();
 }
 
+// Folders only build their children's views when they are opened, so
+// search the model for the rest and build views for what it finds, a
+// few at a time.  The folder views filter those as usual.
+void LLInventoryPanel::updateSearch()
+{
+	static LLFastTimer::DeclareTimer FTM_INVENTORY_SEARCH("Inventory Search");
+	LLFastTimer t(FTM_INVENTORY_SEARCH);
+
+	LLInventoryFilter* filter = getFilter();
+	if (!mViewsInitialized || !filter || !filter->isActive())
+	{
+		mSearchGeneration = -1;
+		return;
+	}
+
+	const LLInventorySearchIndex& index = mInventory->getSearchIndex();
+	if (filter->getCurrentGeneration() != mSearchGeneration)
+	{
+		// A more restrictive filter can only lose results, so the
+		// search under way can carry on.
+		if ((mSearchGeneration < 0) || (filter->getMustPassGeneration() != mSearchMustPassGeneration))
+		{
+			mSearchQuery.start(index, filter->getFilterSubString());
+		}
+		mSearchGeneration = filter->getCurrentGeneration();
+		mSearchMustPassGeneration = filter->getMustPassGeneration();
+	}
+	if (mSearchQuery.isDone())
+	{
+		return;
+	}
+
+	LLCollectSearchResults results(filter, mFolders);
+	mSearchQuery.step(index,
+					  llmax(gSavedSettings.getS32("InventorySearchEntriesPerFrame"), 1),
+					  llclamp(gSavedSettings.getS32("FilterItemsPerFrame"), 1, 5000),
+					  results);
+	for (std::vector<LLUUID>::iterator it = results.mResults.begin();
+		 it != results.mResults.end();
+		 ++it)
+	{
+		buildViewsForObject(*it);
+	}
+}
+
 LLInventoryFilter* LLInventoryPanel::getFilter()
 {
 	if (mFolders) 
@@ -349,8 +424,21 @@ void LLInventoryPanel::modelChanged(U32 mask)
 			// Item exists in memory but a UI element hasn't been created for it.
 			if (model_item && !view_item)
 			{
-				// Add the UI element for this item.
-				buildNewViews(item_id);
+				// Add the UI element for this item, if its folder's children have been built.
+				LLFolderViewFolder* parent_view = dynamic_cast<LLFolderViewFolder*>(mFolders->getItemByID(model_item->getParentUUID()));
+				if ((item_id == mStartFolderID) || (parent_view && parent_view->areChildrenInited()))
+				{
+					buildNewViews(item_id);
+				}
+				else if (getFilter()->isActive())
+				{
+					// It may be a search result.
+					const LLInventorySearchIndex::Entry* entry = mInventory->getSearchIndex().getEntry(item_id);
+					if (entry && getFilter()->check(*entry))
+					{
+						buildViewsForObject(item_id);
+					}
+				}
 				// Select any newly created object that has the auto rename at top of folder root set.
 				if(mFolders->getRoot()->needsAutoRename())
 				{
@@ -488,6 +576,11 @@ void LLInventoryPanel::buildNewViews(const LLUUID& id)
 			// This item exists outside the inventory's hierarchy, so don't add it.
 			return;
 		}
+		else if (!parent_folder)
+		{
+			// The parent's view hasn't been built yet, this one will be built along with it.
+			return;
+		}
 		
 		if (objectp->getType() <= LLAssetType::AT_NONE ||
 			objectp->getType() >= LLAssetType::AT_COUNT)
@@ -526,6 +619,11 @@ void LLInventoryPanel::buildNewViews(const LLUUID& id)
 				{
 					folderp->setHidden(TRUE);
 				}
+				else
+				{
+					// Children are built when the folder is first opened.
+					folderp->setChildrenInited(FALSE);
+				}
 				const LLViewerInventoryCategory *cat = dynamic_cast<LLViewerInventoryCategory *>(objectp);
 				if (cat && getIsHiddenFolderType(cat->getPreferredType()))
 				{
@@ -571,38 +669,110 @@ void LLInventoryPanel::buildNewViews(const LLUUID& id)
 		}
 	}
 
-	// If this is a folder, add the children of the folder and recursively add any 
-	// child folders.
-	if ((id == mStartFolderID) ||
-		(objectp && objectp->getType() == LLAssetType::AT_CATEGORY))
+	// If this is the panel's root folder, add its children.  Other folders
+	// add theirs when they are first opened, see buildChildViews().
+	if (id == mStartFolderID)
 	{
-		LLViewerInventoryCategory::cat_array_t* categories;
-		LLViewerInventoryItem::item_array_t* items;
-		mInventory->lockDirectDescendentArrays(id, categories, items);
-		
-		if(categories)
+		addChildViews(id);
+	}
+}
+
+void LLInventoryPanel::buildChildViews(const LLUUID& id)
+{
+	LLFolderViewFolder* folderp = dynamic_cast<LLFolderViewFolder*>(mFolders->getItemByID(id));
+	if (!folderp || folderp->areChildrenInited())
+	{
+		return;
+	}
+	folderp->setChildrenInited(TRUE);
+
+	// Don't add children of hidden folders unless this is the panel's root folder.
+	if (folderp->getHidden() && (id != mStartFolderID))
+	{
+		return;
+	}
+	addChildViews(id);
+}
+
+void LLInventoryPanel::buildViewsForObject(const LLUUID& id)
+{
+	if (!mViewsInitialized || mFolders->getItemByID(id))
+	{
+		return;
+	}
+	if ((mStartFolderID != LLUUID::null) && (!gInventory.isObjectDescendentOf(id, mStartFolderID)))
+	{
+		return;
+	}
+
+	// Walk up to the nearest ancestor that has a view, then build
+	// views back down to the object.
+	std::vector<LLUUID> missing;
+	LLUUID ancestor_id = id;
+	LLFolderViewItem* ancestorp = NULL;
+	while (!ancestorp)
+	{
+		const LLInventoryObject* objectp = gInventory.getObject(ancestor_id);
+		if (!objectp)
 		{
-			for (LLViewerInventoryCategory::cat_array_t::const_iterator cat_iter = categories->begin();
-				 cat_iter != categories->end();
-				 ++cat_iter)
+			return;
+		}
+		missing.push_back(ancestor_id);
+		ancestor_id = objectp->getParentUUID();
+		ancestorp = mFolders->getItemByID(ancestor_id);
+	}
+	if (ancestorp->getHidden() && (ancestor_id != mStartFolderID))
+	{
+		return;
+	}
+
+	for (std::vector<LLUUID>::reverse_iterator it = missing.rbegin();
+		 it != missing.rend();
+		 ++it)
+	{
+		buildNewViews(*it);
+		LLFolderViewItem* itemp = mFolders->getItemByID(*it);
+		if (!itemp || itemp->getHidden())
+		{
+			return;
+		}
+	}
+}
+
+void LLInventoryPanel::addChildViews(const LLUUID& id)
+{
+	LLViewerInventoryCategory::cat_array_t* categories;
+	LLViewerInventoryItem::item_array_t* items;
+	mInventory->lockDirectDescendentArrays(id, categories, items);
+	
+	if(categories)
+	{
+		for (LLViewerInventoryCategory::cat_array_t::const_iterator cat_iter = categories->begin();
+			 cat_iter != categories->end();
+			 ++cat_iter)
+		{
+			const LLViewerInventoryCategory* cat = (*cat_iter);
+			if (!mFolders->getItemByID(cat->getUUID()))
 			{
-				const LLViewerInventoryCategory* cat = (*cat_iter);
 				buildNewViews(cat->getUUID());
 			}
 		}
-		
-		if(items)
+	}
+	
+	if(items)
+	{
+		for (LLViewerInventoryItem::item_array_t::const_iterator item_iter = items->begin();
+			 item_iter != items->end();
+			 ++item_iter)
 		{
-			for (LLViewerInventoryItem::item_array_t::const_iterator item_iter = items->begin();
-				 item_iter != items->end();
-				 ++item_iter)
+			const LLViewerInventoryItem* item = (*item_iter);
+			if (!mFolders->getItemByID(item->getUUID()))
 			{
-				const LLViewerInventoryItem* item = (*item_iter);
 				buildNewViews(item->getUUID());
 			}
 		}
-		mInventory->unlockDirectDescendentArrays(id);
 	}
+	mInventory->unlockDirectDescendentArrays(id);
 }
 
 // bit of a hack to make sure the inventory is open.
@@ -728,6 +898,7 @@ void LLInventoryPanel::setSelection(const LLUUID& obj_id, BOOL take_keyboard_foc
 	{
 		return;
 	}
+	buildViewsForObject(obj_id);
 	mFolders->setSelectionByID(obj_id, take_keyboard_focus);
 }
 
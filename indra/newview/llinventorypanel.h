@@ -226,13 +226,27 @@ protected:
 	void 				initializeViews();
 	void rebuildViewsFor(const LLUUID& id); // Given the id and the parent, build all of the folder views.
 	virtual void buildNewViews(const LLUUID& id);
+public:
+	// Builds views for the folder's children the first time it is opened.
+	void				buildChildViews(const LLUUID& id);
+	// Builds views for the object and any folders above it that lack them.
+	void				buildViewsForObject(const LLUUID& id);
 private:
+	void				addChildViews(const LLUUID& id);
+	void				updateSearch();
+
 	BOOL				mBuildDefaultHierarchy; // default inventory hierarchy should be created in postBuild()
 	BOOL				mViewsInitialized; // Views have been generated
 	// UUID of category from which hierarchy should be built.  Set with the 
 	// "start_folder" xml property.  Default is LLUUID::null that means total Inventory hierarchy. 
 	std::string         mStartFolderString;
 	LLUUID				mStartFolderID;
+
+	// Search of the model for filter matches that have no views yet,
+	// see updateSearch().
+	LLInventorySearchIndex::Query mSearchQuery;
+	S32					mSearchGeneration;
+	S32					mSearchMustPassGeneration;
 };
 
 #endif // LL_LLINVENTORYPANEL_H
@@ -743,6 +743,11 @@ LLPolyMesh::LLPolyMesh(LLPolyMeshSharedData *shared_data, LLPolyMesh *reference_
 //-----------------------------------------------------------------------------
 LLPolyMesh::~LLPolyMesh()
 {
+	if (!mMorphBatch.isEmpty() && mAvatarp)
+	{
+		mAvatarp->getMorphBatchQueue().removeMesh(this);
+	}
+
 	S32 i;
 	for (i = 0; i < mJointRenderData.count(); i++)
 	{
@@ -979,6 +984,72 @@ LLPolyMorphData*	LLPolyMesh::getMorphData(const std::string& morph_name)
 // 	mSharedData->mMorphData.clear();
 // }
 
+//-----------------------------------------------------------------------------
+// addPendingMorph()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::addPendingMorph(const LLPolyMorphStreams* morph, F32 delta_weight, const F32* mask_weights, BOOL clothing)
+{
+	llassert(!isLOD());
+
+	LLPolyMorphBatchQueue* queue = mAvatarp ? &mAvatarp->getMorphBatchQueue() : NULL;
+	bool batching = queue && queue->isBatching();
+	if (mMorphBatch.isEmpty() && batching)
+	{
+		queue->addMesh(this);
+	}
+	mMorphBatch.add(morph, delta_weight, mask_weights, clothing);
+
+	if (!batching)
+	{
+		applyPendingMorphs();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// applyPendingMorphs()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::applyPendingMorphs()
+{
+	if (mMorphBatch.isEmpty())
+	{
+		return;
+	}
+	if (mAvatarp && mAvatarp->getMorphBatchQueue().isBatching())
+	{
+		mAvatarp->getMorphBatchQueue().removeMesh(this);
+	}
+
+	LLPolyMorphBatch::Target target;
+	target.mNumVertices = getNumVertices();
+	target.mCoords = mCoords;
+	target.mScaledNormals = mScaledNormals;
+	target.mNormals = mNormals;
+	target.mScaledBinormals = mScaledBinormals;
+	target.mBinormals = mBinormals;
+	target.mTexCoords = mTexCoords;
+	target.mClothingWeights = mClothingWeights;
+	mMorphBatch.apply(target);
+}
+
+//-----------------------------------------------------------------------------
+// LLPolyMorphBatchQueue::end()
+//-----------------------------------------------------------------------------
+void LLPolyMorphBatchQueue::end()
+{
+	llassert(mDepth > 0);
+	if (--mDepth > 0)
+	{
+		return;
+	}
+
+	std::vector<LLPolyMesh*> meshes;
+	meshes.swap(mMeshes);
+	for (std::vector<LLPolyMesh*>::iterator iter = meshes.begin(); iter != meshes.end(); ++iter)
+	{
+		(*iter)->applyPendingMorphs();
+	}
+}
+
 //-----------------------------------------------------------------------------
 // getWritableWeights()
 //-----------------------------------------------------------------------------
@@ -36,12 +36,14 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include "llstl.h"
 
 #include "v3math.h"
 #include "v2math.h"
 #include "llquaternion.h"
 #include "llpolymorph.h"
+#include "llpolymorphbatch.h"
 #include "lljoint.h"
 //#include "lldarray.h"
 
@@ -315,6 +317,17 @@ public:
 	}
 
 	LLPolyMorphData*	getMorphData(const std::string& morph_name);
+
+	//--------------------------------------------------------------------
+	// Morph Batching
+	//--------------------------------------------------------------------
+	// Queues a weight change of one of this mesh's morphs.  Outside of a
+	// batch it is applied right away.
+	void addPendingMorph(const LLPolyMorphStreams* morph, F32 delta_weight, const F32* mask_weights, BOOL clothing);
+	// Applies this mesh's queued morph changes now.
+	void applyPendingMorphs();
+
+
 // 	void	removeMorphData(LLPolyMorphData *morph_target);
 // 	void	deleteAllMorphData();
 
@@ -364,6 +377,9 @@ protected:
 	
 	LLPolyMesh				*mReferenceMesh;
 
+	// morph changes not yet applied to the arrays above
+	LLPolyMorphBatch		mMorphBatch;
+
 	// global mesh list
 	typedef std::map<std::string, LLPolyMeshSharedData*> LLPolyMeshSharedDataTable; 
 	static LLPolyMeshSharedDataTable sGlobalSharedMeshList;
@@ -372,6 +388,39 @@ protected:
 	LLVOAvatar* mAvatarp;
 };
 
+// The meshes of one avatar with queued morph changes.  Between begin()
+// and the outermost end(), morph changes are queued per mesh and applied
+// by end(), so a mesh is renormalized once however many of its morphs
+// changed.  Nothing may read the morphed vertices in between.  Each
+// avatar has its own, see LLVOAvatar::getMorphBatchQueue().
+class LLPolyMorphBatchQueue
+{
+public:
+	LLPolyMorphBatchQueue() : mDepth(0) {}
+
+	void begin()				{ mDepth++; }
+	void end();
+	bool isBatching() const		{ return mDepth > 0; }
+
+	void addMesh(LLPolyMesh* mesh)		{ mMeshes.push_back(mesh); }
+	void removeMesh(LLPolyMesh* mesh)	{ vector_replace_with_last(mMeshes, mesh); }
+
+private:
+	S32							mDepth;
+	std::vector<LLPolyMesh*>	mMeshes;
+};
+
+// Batches the morph changes made to one avatar's meshes in its scope
+class LLPolyMorphBatchScope
+{
+public:
+	LLPolyMorphBatchScope(LLPolyMorphBatchQueue& queue) : mQueue(queue) { mQueue.begin(); }
+	~LLPolyMorphBatchScope()	{ mQueue.end(); }
+
+private:
+	LLPolyMorphBatchQueue&	mQueue;
+};
+
 //-----------------------------------------------------------------------------
 // LLPolySkeletalDeformationInfo
 // Shared information for LLPolySkeletalDeformations
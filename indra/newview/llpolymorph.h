@@ -37,6 +37,7 @@
 #include <string>
 #include <vector>
 
+#include "llpolymorphbatch.h"
 #include "llviewervisualparam.h"
 
 class LLPolyMeshSharedData;
@@ -68,6 +69,8 @@ public:
 	LLVector3*			mNormals;
 	LLVector3*			mBinormals;
 	LLVector2*			mTexCoords;
+	// the same deltas, one array per component, for LLPolyMorphBatch
+	LLPolyMorphStreams	mStreams;
 
 	F32					mTotalDistortion;	// vertex distortion summed over entire morph
 	F32					mMaxDistortion;		// maximum single vertex distortion in a given morph
@@ -0,0 +1,291 @@
+/** 
+ * @file llpolymorphbatch.cpp
+ * @brief Batched application of morph targets to a mesh.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+//-----------------------------------------------------------------------------
+// Header Files
+//-----------------------------------------------------------------------------
+#include "llviewerprecompiledheaders.h"
+
+#include "llpolymorphbatch.h"
+
+#include "llmemory.h"
+#include "llsys.h"
+#include "v2math.h"
+#include "v3math.h"
+#include "v4math.h"
+
+bool LLPolyMorphBatch::sVectorize = false;
+
+//-----------------------------------------------------------------------------
+// LLPolyMorphStreams()
+//-----------------------------------------------------------------------------
+LLPolyMorphStreams::LLPolyMorphStreams()
+	: mCount(0),
+	  mStride(0),
+	  mIndices(NULL),
+	  mData(NULL)
+{
+}
+
+//-----------------------------------------------------------------------------
+// ~LLPolyMorphStreams()
+//-----------------------------------------------------------------------------
+LLPolyMorphStreams::~LLPolyMorphStreams()
+{
+	ll_aligned_free_16(mData);
+}
+
+//-----------------------------------------------------------------------------
+// init()
+//-----------------------------------------------------------------------------
+void LLPolyMorphStreams::init(U32 count, const U32* indices, const LLVector3* coords, const LLVector3* normals,
+							  const LLVector3* binormals, const LLVector2* tex_coords)
+{
+	ll_aligned_free_16(mData);
+
+	mCount = count;
+	mStride = (count + 3) & ~3;
+	mIndices = indices;
+	mData = (F32*)ll_aligned_malloc_16(sizeof(F32) * mStride * NUM_STREAMS);
+	memset(mData, 0, sizeof(F32) * mStride * NUM_STREAMS);
+
+	for (U32 i = 0; i < count; i++)
+	{
+		for (S32 axis = 0; axis < 3; axis++)
+		{
+			mData[(COORD_X + axis) * mStride + i] = coords[i].mV[axis];
+			mData[(NORMAL_X + axis) * mStride + i] = normals[i].mV[axis];
+			mData[(BINORMAL_X + axis) * mStride + i] = binormals[i].mV[axis];
+		}
+		mData[TEX_U * mStride + i] = tex_coords[i].mV[VX];
+		mData[TEX_V * mStride + i] = tex_coords[i].mV[VY];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// LLPolyMorphBatch
+//-----------------------------------------------------------------------------
+LLPolyMorphBatch::Target::Target()
+	: mNumVertices(0),
+	  mCoords(NULL),
+	  mScaledNormals(NULL),
+	  mNormals(NULL),
+	  mScaledBinormals(NULL),
+	  mBinormals(NULL),
+	  mTexCoords(NULL),
+	  mClothingWeights(NULL)
+{
+}
+
+LLPolyMorphBatch::LLPolyMorphBatch()
+{
+}
+
+//-----------------------------------------------------------------------------
+// add()
+//-----------------------------------------------------------------------------
+void LLPolyMorphBatch::add(const LLPolyMorphStreams* morph, F32 delta_weight, const F32* mask_weights, BOOL clothing)
+{
+	for (entry_list_t::iterator iter = mEntries.begin(); iter != mEntries.end(); ++iter)
+	{
+		if (iter->mMorph == morph && iter->mMaskWeights == mask_weights && iter->mClothing == clothing)
+		{
+			iter->mDeltaWeight += delta_weight;
+			return;
+		}
+	}
+
+	Entry entry;
+	entry.mMorph = morph;
+	entry.mDeltaWeight = delta_weight;
+	entry.mMaskWeights = mask_weights;
+	entry.mClothing = clothing;
+	mEntries.push_back(entry);
+}
+
+//-----------------------------------------------------------------------------
+// apply()
+//-----------------------------------------------------------------------------
+bool LLPolyMorphBatch::apply(const Target& target)
+{
+	if (mEntries.empty())
+	{
+		return false;
+	}
+
+	if (mTouchedFlags.size() < target.mNumVertices)
+	{
+		mTouchedFlags.resize(target.mNumVertices, 0);
+	}
+
+	bool moved = false;
+	for (entry_list_t::iterator iter = mEntries.begin(); iter != mEntries.end(); ++iter)
+	{
+		const Entry& entry = *iter;
+		if (entry.mDeltaWeight == 0.f)
+		{
+			// changed and changed back within the batch
+			continue;
+		}
+		moved = true;
+		if (sVectorize)
+		{
+			accumulateSSE2(target, entry.mMorph, entry.mDeltaWeight, entry.mMaskWeights, entry.mClothing, &mTouchedFlags[0]);
+		}
+		else
+		{
+			accumulate(target, entry.mMorph, entry.mDeltaWeight, entry.mMaskWeights, entry.mClothing, &mTouchedFlags[0]);
+		}
+	}
+	mEntries.clear();
+
+	if (!moved)
+	{
+		return false;
+	}
+
+	mTouched.clear();
+	for (U32 v = 0; v < target.mNumVertices; v++)
+	{
+		if (mTouchedFlags[v])
+		{
+			mTouched.push_back(v);
+			mTouchedFlags[v] = 0;
+		}
+	}
+
+	if (mTouched.empty())
+	{
+		return true;
+	}
+	if (sVectorize)
+	{
+		renormalizeSSE2(target, &mTouched[0], (U32)mTouched.size());
+	}
+	else
+	{
+		renormalize(target, &mTouched[0], (U32)mTouched.size());
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// setVectorize()
+//-----------------------------------------------------------------------------
+//static
+void LLPolyMorphBatch::setVectorize(bool vectorize)
+{
+	sVectorize = vectorize && hasSSE2Kernels() && gSysCPU.hasSSE2();
+}
+
+//-----------------------------------------------------------------------------
+// accumulate()
+// The same operations in the same order as the LLVector3 arithmetic of
+// LLPolyMorphTarget::apply() used to do per morph.
+//-----------------------------------------------------------------------------
+//static
+void LLPolyMorphBatch::accumulate(const Target& target, const LLPolyMorphStreams* morph, F32 delta_weight,
+								  const F32* mask_weights, BOOL clothing, U8* touched_flags, U32 first)
+{
+	const U32* indices = morph->getIndices();
+	const F32* coord_x = morph->getStream(LLPolyMorphStreams::COORD_X);
+	const F32* coord_y = morph->getStream(LLPolyMorphStreams::COORD_Y);
+	const F32* coord_z = morph->getStream(LLPolyMorphStreams::COORD_Z);
+	const F32* normal_x = morph->getStream(LLPolyMorphStreams::NORMAL_X);
+	const F32* normal_y = morph->getStream(LLPolyMorphStreams::NORMAL_Y);
+	const F32* normal_z = morph->getStream(LLPolyMorphStreams::NORMAL_Z);
+	const F32* binormal_x = morph->getStream(LLPolyMorphStreams::BINORMAL_X);
+	const F32* binormal_y = morph->getStream(LLPolyMorphStreams::BINORMAL_Y);
+	const F32* binormal_z = morph->getStream(LLPolyMorphStreams::BINORMAL_Z);
+	const F32* tex_u = morph->getStream(LLPolyMorphStreams::TEX_U);
+	const F32* tex_v = morph->getStream(LLPolyMorphStreams::TEX_V);
+	LLVector4* clothing_weights = clothing ? target.mClothingWeights : NULL;
+
+	for (U32 i = first, count = morph->getCount(); i < count; i++)
+	{
+		U32 v = indices[i];
+		F32 mask_weight = mask_weights ? mask_weights[i] : 1.f;
+
+		F32 dx = coord_x[i] * delta_weight * mask_weight;
+		F32 dy = coord_y[i] * delta_weight * mask_weight;
+		F32 dz = coord_z[i] * delta_weight * mask_weight;
+		target.mCoords[v].mV[VX] += dx;
+		target.mCoords[v].mV[VY] += dy;
+		target.mCoords[v].mV[VZ] += dz;
+		if (clothing_weights)
+		{
+			LLVector4& clothing_weight = clothing_weights[v];
+			clothing_weight.mV[VX] += dx;
+			clothing_weight.mV[VY] += dy;
+			clothing_weight.mV[VZ] += dz;
+			clothing_weight.mV[VW] = mask_weight;
+		}
+
+		target.mScaledNormals[v].mV[VX] += normal_x[i] * delta_weight * mask_weight * NORMAL_SOFTEN_FACTOR;
+		target.mScaledNormals[v].mV[VY] += normal_y[i] * delta_weight * mask_weight * NORMAL_SOFTEN_FACTOR;
+		target.mScaledNormals[v].mV[VZ] += normal_z[i] * delta_weight * mask_weight * NORMAL_SOFTEN_FACTOR;
+
+		target.mScaledBinormals[v].mV[VX] += binormal_x[i] * delta_weight * mask_weight * NORMAL_SOFTEN_FACTOR;
+		target.mScaledBinormals[v].mV[VY] += binormal_y[i] * delta_weight * mask_weight * NORMAL_SOFTEN_FACTOR;
+		target.mScaledBinormals[v].mV[VZ] += binormal_z[i] * delta_weight * mask_weight * NORMAL_SOFTEN_FACTOR;
+
+		target.mTexCoords[v].mV[VX] += tex_u[i] * delta_weight * mask_weight;
+		target.mTexCoords[v].mV[VY] += tex_v[i] * delta_weight * mask_weight;
+
+		touched_flags[v] = 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// renormalize()
+//-----------------------------------------------------------------------------
+//static
+void LLPolyMorphBatch::renormalize(const Target& target, const U32* touched, U32 count)
+{
+	for (U32 i = 0; i < count; i++)
+	{
+		U32 v = touched[i];
+
+		// calculate new normals based on half angles
+		LLVector3 normalized_normal = target.mScaledNormals[v];
+		normalized_normal.normVec();
+		target.mNormals[v] = normalized_normal;
+
+		// calculate new binormals
+		LLVector3 tangent = target.mScaledBinormals[v] % normalized_normal;
+		LLVector3 normalized_binormal = normalized_normal % tangent;
+		normalized_binormal.normVec();
+		target.mBinormals[v] = normalized_binormal;
+	}
+}
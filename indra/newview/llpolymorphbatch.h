@@ -0,0 +1,159 @@
+/** 
+ * @file llpolymorphbatch.h
+ * @brief Batched application of morph targets to a mesh.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+
+#ifndef LL_LLPOLYMORPHBATCH_H
+#define LL_LLPOLYMORPHBATCH_H
+
+#include <vector>
+
+class LLVector2;
+class LLVector3;
+class LLVector4;
+
+// Morphed normals and binormals only move this much of the morph's delta
+const F32 NORMAL_SOFTEN_FACTOR = 0.65f;
+
+//-----------------------------------------------------------------------------
+// LLPolyMorphStreams
+// A morph target's vertex deltas with one array per component, as the
+// batched kernels read them.  Built once when the morph is loaded.
+//-----------------------------------------------------------------------------
+class LLPolyMorphStreams
+{
+public:
+	enum EStream
+	{
+		COORD_X, COORD_Y, COORD_Z,
+		NORMAL_X, NORMAL_Y, NORMAL_Z,
+		BINORMAL_X, BINORMAL_Y, BINORMAL_Z,
+		TEX_U, TEX_V,
+		NUM_STREAMS
+	};
+
+	LLPolyMorphStreams();
+	~LLPolyMorphStreams();
+
+	// indices must outlive the streams.
+	void init(U32 count, const U32* indices, const LLVector3* coords, const LLVector3* normals,
+			  const LLVector3* binormals, const LLVector2* tex_coords);
+
+	U32 getCount() const							{ return mCount; }
+	const U32* getIndices() const					{ return mIndices; }
+	// Each stream is 16 byte aligned and padded to a multiple of 4.
+	const F32* getStream(EStream stream) const		{ return mData + stream * mStride; }
+
+private:
+	// No copy constructor or copy assignment
+	LLPolyMorphStreams(const LLPolyMorphStreams&);
+	LLPolyMorphStreams& operator=(const LLPolyMorphStreams&);
+
+	U32			mCount;
+	U32			mStride;
+	const U32*	mIndices;
+	F32*		mData;
+};
+
+//-----------------------------------------------------------------------------
+// LLPolyMorphBatch
+// The morph weight changes pending on one mesh.  Changes to the same morph
+// are summed, and apply() adds them all to the mesh in one pass.  The
+// unnormalized normals and binormals are accumulated as before, but each
+// vertex the batch moved is renormalized only once, at the end, which
+// gives the same result as renormalizing after every morph.
+//-----------------------------------------------------------------------------
+class LLPolyMorphBatch
+{
+public:
+	// The mesh arrays a batch writes
+	struct Target
+	{
+		Target();
+
+		U32			mNumVertices;
+		LLVector3*	mCoords;
+		LLVector3*	mScaledNormals;
+		LLVector3*	mNormals;
+		LLVector3*	mScaledBinormals;
+		LLVector3*	mBinormals;
+		LLVector2*	mTexCoords;
+		LLVector4*	mClothingWeights;	// may be NULL
+	};
+
+	LLPolyMorphBatch();
+
+	// Adds delta_weight of a morph.  mask_weights, one per morph vertex,
+	// scale the deltas and may be NULL; they are read by apply(), so the
+	// caller applies the batch before changing them.  Clothing morphs also
+	// move the clothing weights.
+	void add(const LLPolyMorphStreams* morph, F32 delta_weight, const F32* mask_weights, BOOL clothing);
+	bool isEmpty() const							{ return mEntries.empty(); }
+	// Applies and clears the batch.  Returns false if the net weight
+	// changes were all zero and the mesh was left alone.
+	bool apply(const Target& target);
+
+	// Use the SSE2 kernels.  No effect if the CPU or the build lacks SSE2.
+	static void setVectorize(bool vectorize);
+	static bool getVectorize()						{ return sVectorize; }
+
+	// The kernels.  The SSE2 versions are in llpolymorphbatch_sse2.cpp and
+	// are bit-exact with these on builds that do their float math in SSE
+	// registers.  accumulate() adds the morph vertices from first on and
+	// sets a flag for every mesh vertex it moves; renormalize() recomputes
+	// the output normal and binormal of every vertex in touched.
+	static void accumulate(const Target& target, const LLPolyMorphStreams* morph, F32 delta_weight,
+						   const F32* mask_weights, BOOL clothing, U8* touched_flags, U32 first = 0);
+	static void renormalize(const Target& target, const U32* touched, U32 count);
+	static void accumulateSSE2(const Target& target, const LLPolyMorphStreams* morph, F32 delta_weight,
+							   const F32* mask_weights, BOOL clothing, U8* touched_flags);
+	static void renormalizeSSE2(const Target& target, const U32* touched, U32 count);
+	static bool hasSSE2Kernels();
+
+private:
+	struct Entry
+	{
+		const LLPolyMorphStreams*	mMorph;
+		F32							mDeltaWeight;
+		const F32*					mMaskWeights;
+		BOOL						mClothing;
+	};
+	typedef std::vector<Entry> entry_list_t;
+	entry_list_t		mEntries;
+	std::vector<U8>		mTouchedFlags;	// per mesh vertex, all zero between batches
+	std::vector<U32>	mTouched;
+
+	static bool			sVectorize;
+};
+
+#endif // LL_LLPOLYMORPHBATCH_H
@@ -0,0 +1,237 @@
+/** 
+ * @file llpolymorphbatch_sse2.cpp
+ * @brief SSE2 morph target kernels.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+//-----------------------------------------------------------------------------
+// Header Files
+//-----------------------------------------------------------------------------
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llpolymorphbatch.h"
+
+#include "llmath.h"
+#include "v2math.h"
+#include "v3math.h"
+#include "v4math.h"
+
+#if (LL_GNUC && defined(__SSE2__)) || (LL_MSVC && (defined(_M_IX86) || defined(_M_X64)))
+#define LL_POLYMORPH_SSE2 1
+#else
+#define LL_POLYMORPH_SSE2 0
+#endif
+
+#if LL_POLYMORPH_SSE2
+
+#include <emmintrin.h>
+
+// Four vertices at a time, each lane doing the same operations in the
+// same order as the scalar kernels in llpolymorphbatch.cpp.  The morph
+// deltas are already one stream per component; mesh vertices are
+// gathered into and scattered from registers holding one component of
+// four vertices.
+
+//static
+bool LLPolyMorphBatch::hasSSE2Kernels()
+{
+	return true;
+}
+
+//static
+void LLPolyMorphBatch::accumulateSSE2(const Target& target, const LLPolyMorphStreams* morph, F32 delta_weight,
+									  const F32* mask_weights, BOOL clothing, U8* touched_flags)
+{
+	const __m128 weight = _mm_set1_ps(delta_weight);
+	const __m128 soften = _mm_set1_ps(NORMAL_SOFTEN_FACTOR);
+	const __m128 one = _mm_set1_ps(1.f);
+
+	const U32* indices = morph->getIndices();
+	const F32* streams[LLPolyMorphStreams::NUM_STREAMS];
+	for (S32 s = 0; s < LLPolyMorphStreams::NUM_STREAMS; s++)
+	{
+		streams[s] = morph->getStream((LLPolyMorphStreams::EStream)s);
+	}
+	LLVector4* clothing_weights = clothing ? target.mClothingWeights : NULL;
+
+	F32 deltas[LLPolyMorphStreams::NUM_STREAMS][4];
+	F32 masks[4];
+
+	U32 count = morph->getCount();
+	U32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 mask = mask_weights ? _mm_loadu_ps(mask_weights + i) : one;
+		_mm_storeu_ps(masks, mask);
+
+		for (S32 s = LLPolyMorphStreams::COORD_X; s <= LLPolyMorphStreams::COORD_Z; s++)
+		{
+			_mm_storeu_ps(deltas[s], _mm_mul_ps(_mm_mul_ps(_mm_load_ps(streams[s] + i), weight), mask));
+		}
+		for (S32 s = LLPolyMorphStreams::NORMAL_X; s <= LLPolyMorphStreams::BINORMAL_Z; s++)
+		{
+			_mm_storeu_ps(deltas[s], _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_load_ps(streams[s] + i), weight), mask), soften));
+		}
+		for (S32 s = LLPolyMorphStreams::TEX_U; s <= LLPolyMorphStreams::TEX_V; s++)
+		{
+			_mm_storeu_ps(deltas[s], _mm_mul_ps(_mm_mul_ps(_mm_load_ps(streams[s] + i), weight), mask));
+		}
+
+		for (S32 lane = 0; lane < 4; lane++)
+		{
+			U32 v = indices[i + lane];
+			F32* coord = target.mCoords[v].mV;
+			coord[VX] += deltas[LLPolyMorphStreams::COORD_X][lane];
+			coord[VY] += deltas[LLPolyMorphStreams::COORD_Y][lane];
+			coord[VZ] += deltas[LLPolyMorphStreams::COORD_Z][lane];
+			if (clothing_weights)
+			{
+				F32* clothing_weight = clothing_weights[v].mV;
+				clothing_weight[VX] += deltas[LLPolyMorphStreams::COORD_X][lane];
+				clothing_weight[VY] += deltas[LLPolyMorphStreams::COORD_Y][lane];
+				clothing_weight[VZ] += deltas[LLPolyMorphStreams::COORD_Z][lane];
+				clothing_weight[VW] = masks[lane];
+			}
+			F32* normal = target.mScaledNormals[v].mV;
+			normal[VX] += deltas[LLPolyMorphStreams::NORMAL_X][lane];
+			normal[VY] += deltas[LLPolyMorphStreams::NORMAL_Y][lane];
+			normal[VZ] += deltas[LLPolyMorphStreams::NORMAL_Z][lane];
+			F32* binormal = target.mScaledBinormals[v].mV;
+			binormal[VX] += deltas[LLPolyMorphStreams::BINORMAL_X][lane];
+			binormal[VY] += deltas[LLPolyMorphStreams::BINORMAL_Y][lane];
+			binormal[VZ] += deltas[LLPolyMorphStreams::BINORMAL_Z][lane];
+			F32* tex_coord = target.mTexCoords[v].mV;
+			tex_coord[VX] += deltas[LLPolyMorphStreams::TEX_U][lane];
+			tex_coord[VY] += deltas[LLPolyMorphStreams::TEX_V][lane];
+			touched_flags[v] = 1;
+		}
+	}
+
+	accumulate(target, morph, delta_weight, mask_weights, clothing, touched_flags, i);
+}
+
+// v normalized like LLVector3::normVec(): zero if its length is too small
+static inline void normalize4(__m128& x, __m128& y, __m128& z)
+{
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 mag_threshold = _mm_set1_ps(FP_MAG_THRESHOLD);
+
+	__m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+	__m128 valid = _mm_cmpgt_ps(mag, mag_threshold);
+	__m128 oomag = _mm_div_ps(one, mag);
+	x = _mm_and_ps(valid, _mm_mul_ps(x, oomag));
+	y = _mm_and_ps(valid, _mm_mul_ps(y, oomag));
+	z = _mm_and_ps(valid, _mm_mul_ps(z, oomag));
+}
+
+//static
+void LLPolyMorphBatch::renormalizeSSE2(const Target& target, const U32* touched, U32 count)
+{
+	F32 out[6][4];
+
+	U32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const F32* n0 = target.mScaledNormals[touched[i]].mV;
+		const F32* n1 = target.mScaledNormals[touched[i + 1]].mV;
+		const F32* n2 = target.mScaledNormals[touched[i + 2]].mV;
+		const F32* n3 = target.mScaledNormals[touched[i + 3]].mV;
+		__m128 nx = _mm_set_ps(n3[VX], n2[VX], n1[VX], n0[VX]);
+		__m128 ny = _mm_set_ps(n3[VY], n2[VY], n1[VY], n0[VY]);
+		__m128 nz = _mm_set_ps(n3[VZ], n2[VZ], n1[VZ], n0[VZ]);
+
+		const F32* b0 = target.mScaledBinormals[touched[i]].mV;
+		const F32* b1 = target.mScaledBinormals[touched[i + 1]].mV;
+		const F32* b2 = target.mScaledBinormals[touched[i + 2]].mV;
+		const F32* b3 = target.mScaledBinormals[touched[i + 3]].mV;
+		__m128 bx = _mm_set_ps(b3[VX], b2[VX], b1[VX], b0[VX]);
+		__m128 by = _mm_set_ps(b3[VY], b2[VY], b1[VY], b0[VY]);
+		__m128 bz = _mm_set_ps(b3[VZ], b2[VZ], b1[VZ], b0[VZ]);
+
+		// calculate new normals based on half angles
+		normalize4(nx, ny, nz);
+
+		// calculate new binormals: tangent = binormal % normal,
+		// binormal = normal % tangent
+		__m128 tx = _mm_sub_ps(_mm_mul_ps(by, nz), _mm_mul_ps(ny, bz));
+		__m128 ty = _mm_sub_ps(_mm_mul_ps(bz, nx), _mm_mul_ps(nz, bx));
+		__m128 tz = _mm_sub_ps(_mm_mul_ps(bx, ny), _mm_mul_ps(nx, by));
+		bx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(ty, nz));
+		by = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(tz, nx));
+		bz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(tx, ny));
+		normalize4(bx, by, bz);
+
+		_mm_storeu_ps(out[0], nx);
+		_mm_storeu_ps(out[1], ny);
+		_mm_storeu_ps(out[2], nz);
+		_mm_storeu_ps(out[3], bx);
+		_mm_storeu_ps(out[4], by);
+		_mm_storeu_ps(out[5], bz);
+		for (S32 lane = 0; lane < 4; lane++)
+		{
+			U32 v = touched[i + lane];
+			target.mNormals[v].setVec(out[0][lane], out[1][lane], out[2][lane]);
+			target.mBinormals[v].setVec(out[3][lane], out[4][lane], out[5][lane]);
+		}
+	}
+
+	renormalize(target, touched + i, count - i);
+}
+
+#else // LL_POLYMORPH_SSE2
+
+// Never called: LLPolyMorphBatch::setVectorize() checks hasSSE2Kernels()
+
+//static
+bool LLPolyMorphBatch::hasSSE2Kernels()
+{
+	return false;
+}
+
+//static
+void LLPolyMorphBatch::accumulateSSE2(const Target& target, const LLPolyMorphStreams* morph, F32 delta_weight,
+									  const F32* mask_weights, BOOL clothing, U8* touched_flags)
+{
+	llerrs << "SSE2 kernels not built" << llendl;
+}
+
+//static
+void LLPolyMorphBatch::renormalizeSSE2(const Target& target, const U32* touched, U32 count)
+{
+	llerrs << "SSE2 kernels not built" << llendl;
+}
+
+#endif // LL_POLYMORPH_SSE2
@@ -52,6 +52,7 @@
 
 static LLFastTimer::DeclareTimer FTM_FRUSTUM_CULL("Frustum Culling");
 static LLFastTimer::DeclareTimer FTM_CULL_REBOUND("Cull Rebound");
+static LLFastTimer::DeclareTimer FTM_CULL_LAYOUT("Cull Layout");
 
 const F32 SG_OCCLUSION_FUDGE = 0.25f;
 #define SG_DISCARD_TOLERANCE 0.01f
@@ -68,6 +69,7 @@ const F32 SG_OCCLUSION_FUDGE = 0.25f;
 static U32 sZombieGroups = 0;
 U32 LLSpatialGroup::sNodeCount = 0;
 BOOL LLSpatialGroup::sNoDelete = FALSE;
+BOOL LLSpatialPartition::sLinearCull = TRUE;
 
 static F32 sLastMaxTexPriority = 1.f;
 static F32 sCurMaxTexPriority = 1.f;
@@ -877,6 +879,7 @@ void LLSpatialGroup::shift(const LLVector3 &offset)
 	LLVector3d offsetd(offset);
 	mOctreeNode->setCenter(mOctreeNode->getCenter()+offsetd);
 	mOctreeNode->updateMinMax();
+	mSpatialPartition->mCullLayoutDirty = TRUE;
 	mBounds[0] += offset;
 	mExtents[0] += offset;
 	mExtents[1] += offset;
@@ -1157,6 +1160,7 @@ LLSpatialGroup::LLSpatialGroup(OctreeNode* node, LLSpatialPartition* part) :
 	mBuilt(0.f),
 	mOctreeNode(node),
 	mSpatialPartition(part),
+	mCullIndex(-1),
 	mVertexBuffer(NULL), 
 	mBufferUsage(GL_STATIC_DRAW_ARB),
 	mDistance(0.f),
@@ -1181,6 +1185,7 @@ LLSpatialGroup::LLSpatialGroup(OctreeNode* node, LLSpatialPartition* part) :
 	mBounds[0] = LLVector3(node->getCenter());
 	mBounds[1] = LLVector3(node->getSize());
 
+	part->mCullLayoutDirty = TRUE;
 	part->mLODSeed = (part->mLODSeed+1)%part->mLODPeriod;
 	mLODHash = part->mLODSeed;
 
@@ -1368,6 +1373,7 @@ void LLSpatialGroup::handleDestruction(const TreeNode* node)
 	mBufferMap.clear();
 	sZombieGroups++;
 	mOctreeNode = NULL;
+	mSpatialPartition->mCullLayoutDirty = TRUE;
 }
 
 void LLSpatialGroup::handleStateChange(const TreeNode* node)
@@ -1377,6 +1383,7 @@ void LLSpatialGroup::handleStateChange(const TreeNode* node)
 	{
 		mOctreeNode = (OctreeNode*) node;
 	}
+	mSpatialPartition->mCullLayoutDirty = TRUE;
 	unbound();
 }
 
@@ -1392,6 +1399,7 @@ void LLSpatialGroup::handleChildAddition(const OctreeNode* parent, OctreeNode* c
 		OCT_ERRS << "LLSpatialGroup redundancy detected." << llendl;
 	}
 
+	mSpatialPartition->mCullLayoutDirty = TRUE;
 	unbound();
 
 	assert_states_valid(this);
@@ -1399,6 +1407,7 @@ void LLSpatialGroup::handleChildAddition(const OctreeNode* parent, OctreeNode* c
 
 void LLSpatialGroup::handleChildRemoval(const OctreeNode* parent, const OctreeNode* child)
 {
+	mSpatialPartition->mCullLayoutDirty = TRUE;
 	unbound();
 }
 
@@ -1501,6 +1510,11 @@ BOOL LLSpatialGroup::rebound()
 		mBounds[0] = (newMin + newMax)*0.5f;
 		mBounds[1] = (newMax - newMin)*0.5f;
 	}
+
+	if (mCullIndex >= 0 && !mSpatialPartition->mCullLayoutDirty)
+	{ //keep the cull layout current without rebuilding it
+		mSpatialPartition->mCullBounds.set(mCullIndex, mBounds[0], mBounds[1]);
+	}
 	
 	setState(OCCLUSION_DIRTY);
 	
@@ -1622,6 +1636,7 @@ LLSpatialPartition::LLSpatialPartition(U32 data_mask, BOOL render_by_group, U32
 	mDepthMask = FALSE;
 	mSlopRatio = 0.25f;
 	mInfiniteFarClip = FALSE;
+	mCullLayoutDirty = TRUE;
 
 	LLGLNamePool::registerPool(&sQueryPool);
 
@@ -1746,6 +1761,44 @@ void LLSpatialPartition::shift(const LLVector3 &offset)
 	shifter.traverse(mOctree);
 }
 
+void LLSpatialPartition::updateCullLayout()
+{
+	if (!mCullLayoutDirty)
+	{
+		return;
+	}
+
+	LLFastTimer ftm(FTM_CULL_LAYOUT);
+	mCullGroups.clear();
+	mCullSubtreeEnd.clear();
+	addToCullLayout(mOctree);
+
+	mCullBounds.resize(mCullGroups.size());
+	for (U32 i = 0; i < mCullGroups.size(); ++i)
+	{
+		LLSpatialGroup* group = mCullGroups[i];
+		mCullBounds.set(i, group->mBounds[0], group->mBounds[1]);
+	}
+
+	mCullLayoutDirty = FALSE;
+}
+
+void LLSpatialPartition::addToCullLayout(LLSpatialGroup::OctreeNode* node)
+{
+	LLSpatialGroup* group = (LLSpatialGroup*) node->getListener(0);
+	U32 index = mCullGroups.size();
+	group->mCullIndex = (S32) index;
+	mCullGroups.push_back(group);
+	mCullSubtreeEnd.push_back(index + 1);
+
+	for (U32 i = 0; i < node->getChildCount(); i++)
+	{
+		addToCullLayout(node->getChild(i));
+	}
+
+	mCullSubtreeEnd[index] = mCullGroups.size();
+}
+
 class LLOctreeCull : public LLSpatialGroup::OctreeTraveler
 {
 public:
@@ -1793,10 +1846,79 @@ public:
 			mRes = 0;
 		}
 	}
+
+	// Same walk as traverse(), over the partition's cull layout instead of
+	// the octree, testing group bounds four at a time as the walk reaches
+	// them.  Visits the same groups in the same order.
+	void traverseLinear(LLSpatialPartition* part)
+	{
+		part->updateCullLayout();
+
+		LLFrustumCuller frustum(*mCamera, useFarClip());
+		LLFrustumCullResults& results = part->mCullResults;
+		results.begin(&frustum, &part->mCullBounds);
+
+		const std::vector<LLSpatialGroup*>& groups = part->mCullGroups;
+		const std::vector<U32>& subtree_end = part->mCullSubtreeEnd;
+
+		//where traverse() would return from a group it tested and reset mRes
+		std::vector<U32> reset_at;
+		reset_at.reserve(32);
+
+		U32 count = groups.size();
+		U32 i = 0;
+		while (i < count)
+		{
+			while (!reset_at.empty() && reset_at.back() <= i)
+			{
+				reset_at.pop_back();
+				mRes = 0;
+			}
+
+			LLSpatialGroup* group = groups[i];
+			if (earlyFail(group))
+			{
+				i = subtree_end[i];
+				continue;
+			}
+
+			if (mRes == 2 || 
+				(mRes && group->isState(LLSpatialGroup::SKIP_FRUSTUM_CHECK)))
+			{	//fully in, just add everything
+				visit(group->mOctreeNode);
+			}
+			else
+			{
+				mRes = frustumCheckLinear(group, results.get(i));
+				if (!mRes)
+				{
+					i = subtree_end[i];
+					continue;
+				}
+				visit(group->mOctreeNode);
+				reset_at.push_back(subtree_end[i]);
+			}
+			++i;
+		}
+
+		mRes = 0;
+	}
+
+	// frustum far plane used by traverseLinear()
+	virtual bool useFarClip()
+	{
+		return false;
+	}
 	
 	virtual S32 frustumCheck(const LLSpatialGroup* group)
 	{
 		S32 res = mCamera->AABBInFrustumNoFarClip(group->mBounds[0], group->mBounds[1]);
+		return frustumCheckLinear(group, res);
+	}
+
+	// finish frustumCheck() given the result of the box test
+	virtual S32 frustumCheckLinear(const LLSpatialGroup* group, S32 res)
+	{
 		if (res != 0)
 		{
 			res = llmin(res, AABBSphereIntersect(group->mExtents[0], group->mExtents[1], mCamera->getOrigin(), mCamera->mFrustumCornerDist));
@@ -1874,6 +1996,11 @@ public:
 		return mCamera->AABBInFrustumNoFarClip(group->mBounds[0], group->mBounds[1]);
 	}
 
+	virtual S32 frustumCheckLinear(const LLSpatialGroup* group, S32 res)
+	{
+		return res;
+	}
+
 	virtual S32 frustumCheckObjects(const LLSpatialGroup* group)
 	{
 		S32 res = mCamera->AABBInFrustumNoFarClip(group->mObjectBounds[0], group->mObjectBounds[1]);
@@ -1887,11 +2014,21 @@ public:
 	LLOctreeCullShadow(LLCamera* camera)
 		: LLOctreeCull(camera) { }
 
+	virtual bool useFarClip()
+	{
+		return true;
+	}
+
 	virtual S32 frustumCheck(const LLSpatialGroup* group)
 	{
 		return mCamera->AABBInFrustum(group->mBounds[0], group->mBounds[1]);
 	}
 
+	virtual S32 frustumCheckLinear(const LLSpatialGroup* group, S32 res)
+	{
+		return res;
+	}
+
 	virtual S32 frustumCheckObjects(const LLSpatialGroup* group)
 	{
 		return mCamera->AABBInFrustum(group->mObjectBounds[0], group->mObjectBounds[1]);
@@ -2209,19 +2346,40 @@ S32 LLSpatialPartition::cull(LLCamera &camera, std::vector<LLDrawable *>* result
 	{
 		LLFastTimer ftm(FTM_FRUSTUM_CULL);
 		LLOctreeCullShadow culler(&camera);
-		culler.traverse(mOctree);
+		if (sLinearCull)
+		{
+			culler.traverseLinear(this);
+		}
+		else
+		{
+			culler.traverse(mOctree);
+		}
 	}
 	else if (mInfiniteFarClip || !LLPipeline::sUseFarClip)
 	{
 		LLFastTimer ftm(FTM_FRUSTUM_CULL);		
 		LLOctreeCullNoFarClip culler(&camera);
-		culler.traverse(mOctree);
+		if (sLinearCull)
+		{
+			culler.traverseLinear(this);
+		}
+		else
+		{
+			culler.traverse(mOctree);
+		}
 	}
 	else
 	{
 		LLFastTimer ftm(FTM_FRUSTUM_CULL);		
 		LLOctreeCull culler(&camera);
-		culler.traverse(mOctree);
+		if (sLinearCull)
+		{
+			culler.traverseLinear(this);
+		}
+		else
+		{
+			culler.traverse(mOctree);
+		}
 	}
 	
 	return 0;
@@ -46,6 +46,7 @@
 #include "lldrawpool.h"
 #include "llface.h"
 #include "llviewercamera.h"
+#include "llfrustumcull.h"
 
 #include <queue>
 
@@ -347,6 +348,7 @@ public:
 	F32 mBuilt;
 	OctreeNode* mOctreeNode;
 	LLSpatialPartition* mSpatialPartition;
+	S32 mCullIndex; //position in mSpatialPartition's cull layout
 	LLVector3 mBounds[2];
 	LLVector3 mExtents[2];
 	
@@ -430,7 +432,15 @@ public:
 	BOOL isOcclusionEnabled();
 	BOOL getVisibleExtents(LLCamera& camera, LLVector3& visMin, LLVector3& visMax);
 
+	// Rebuild the cull layout if the octree changed shape since the last cull
+	void updateCullLayout();
+
+private:
+	void addToCullLayout(LLSpatialGroup::OctreeNode* node);
+
 public:
+	static BOOL sLinearCull; // if TRUE, frustum cull from the cull layout instead of walking the octree
+
 	LLSpatialGroup::OctreeNode* mOctree;
 	BOOL mOcclusionEnabled; // if TRUE, occlusion culling is performed
 	BOOL mInfiniteFarClip; // if TRUE, frustum culling ignores far clip plane
@@ -443,6 +453,15 @@ public:
 	BOOL mDepthMask; //if TRUE, objects in this partition will be written to depth during alpha rendering
 	U32 mDrawableType;
 	U32 mPartitionType;
+
+	// Cull layout: the groups of mOctree in traversal order, with the index
+	// past the end of each group's subtree and the group bounds as streams
+	// for LLFrustumCuller.  Rebound updates the bounds in place.
+	std::vector<LLSpatialGroup*> mCullGroups;
+	std::vector<U32> mCullSubtreeEnd;
+	LLAABBStreams mCullBounds;
+	LLFrustumCullResults mCullResults;
+	BOOL mCullLayoutDirty;
 };
 
 // class for creating bridges between spatial partitions
@@ -647,6 +647,7 @@ BOOL LLSurface::idleUpdate(F32 max_update_time)
 
 	// Always call updateNormals() / updateVerticalStats()
 	//  every frame to avoid artifacts
+	calcDirtyPatches();
 	for(std::set<LLSurfacePatch *>::iterator iter = mDirtyPatchList.begin();
 		iter != mDirtyPatchList.end(); )
 	{
@@ -667,28 +668,99 @@ BOOL LLSurface::idleUpdate(F32 max_update_time)
 	return did_update;
 }
 
-void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch) 
+namespace
 {
+	struct CalcNormalsContext
+	{
+		std::vector<LLSurfacePatch *> mPatches;
+		std::vector<U8> mDirty;
+	};
 
-	LLPatchHeader  ph;
-	S32 j, i;
-	S32 patch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
-	LLSurfacePatch *patchp;
+	void calc_normals(void *context, S32 begin, S32 end)
+	{
+		CalcNormalsContext &ctx = *(CalcNormalsContext *)context;
+		for (S32 i = begin; i < end; i++)
+		{
+			ctx.mDirty[i] = ctx.mPatches[i]->calcNormals();
+		}
+	}
 
-	init_patch_decompressor(gopp->patch_size);
-	gopp->stride = mGridsPerEdge;
-	set_group_of_patch_header(gopp);
+	void calc_vertical_stats(void *context, S32 begin, S32 end)
+	{
+		LLSurfacePatch **patches = (LLSurfacePatch **)context;
+		for (S32 i = begin; i < end; i++)
+		{
+			patches[i]->calcVerticalStats();
+		}
+	}
+}
+
+void LLSurface::calcDirtyPatches()
+{
+	if (mDirtyPatchList.size() < 2)
+	{
+		return;
+	}
 
-	while (1)
+	// A patch's normals along its edges depend on, and its corner height
+	// is shared with, its neighbors, but patches two apart never touch the
+	// same data.  So the normals are done in four passes, one for each
+	// combination of odd and even row and column, each pass spread over
+	// the LLPatchDecoder threads.
+	CalcNormalsContext passes[4];
+	std::vector<LLSurfacePatch *> patches;
+	patches.reserve(mDirtyPatchList.size());
+	for (std::set<LLSurfacePatch *>::iterator iter = mDirtyPatchList.begin();
+		 iter != mDirtyPatchList.end(); ++iter)
 	{
-		decode_patch_header(bitpack, &ph);
-		if (ph.quant_wbits == END_OF_PATCHES)
+		LLSurfacePatch *patchp = *iter;
+		S32 index = (S32)(patchp - mPatchList);
+		S32 i = index % mPatchesPerEdge;
+		S32 j = index / mPatchesPerEdge;
+		passes[(i & 1) + 2*(j & 1)].mPatches.push_back(patchp);
+		patches.push_back(patchp);
+	}
+
+	S32 pass;
+	for (pass = 0; pass < 4; pass++)
+	{
+		CalcNormalsContext &ctx = passes[pass];
+		ctx.mDirty.resize(ctx.mPatches.size());
+		LLPatchDecoder::parallelFor(calc_normals, &ctx, (S32)ctx.mPatches.size());
+	}
+	for (pass = 0; pass < 4; pass++)
+	{
+		for (U32 k = 0; k < passes[pass].mPatches.size(); k++)
 		{
-			break;
+			if (passes[pass].mDirty[k])
+			{
+				dirtySurfacePatch(passes[pass].mPatches[k]);
+			}
 		}
+	}
+
+	// The stats only read the patch's heights, once all the corners are in
+	LLPatchDecoder::parallelFor(calc_vertical_stats, &patches[0], (S32)patches.size());
+}
+
+void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch) 
+{
+	LLPatchDecoder::packet_list_t packets;
+	packets.push_back(LLPatchDecoder::Packet(bitpack, gopp->patch_size, mGridsPerEdge, this));
+	LLPatchDecoder::readPackets(packets);
+	placeDCTPatches(packets.back());
+	LLPatchDecoder::decompressPackets(packets);
+	applyDCTPatches(packets.back());
+}
 
-		i = ph.patchids >> 5;
-		j = ph.patchids & 0x1F;
+BOOL LLSurface::placeDCTPatches(LLPatchDecoder::Packet &packet)
+{
+	LLPatchDecoder::patch_list_t &patches = packet.mPatches;
+	for (U32 k = 0; k < patches.size(); k++)
+	{
+		const LLPatchHeader &ph = patches[k].mHeader;
+		S32 i = ph.patchids >> 5;
+		S32 j = ph.patchids & 0x1F;
 
 		if ((i >= mPatchesPerEdge) || (j >= mPatchesPerEdge))
 		{
@@ -702,14 +774,27 @@ void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL
 				<< " patchids " << (S32)ph.patchids
 				<< llendl;
             LLAppViewer::instance()->badNetworkHandler();
-			return;
+			patches.resize(k);
+			return FALSE;
 		}
 
-		patchp = &mPatchList[j*mPatchesPerEdge + i];
-
+		LLSurfacePatch *patchp = &mPatchList[j*mPatchesPerEdge + i];
+		patches[k].mDest = patchp->getDataZ();
+		patches[k].mUserData = patchp;
+	}
+	return TRUE;
+}
 
-		decode_patch(bitpack, patch);
-		decompress_patch(patchp->getDataZ(), patch, &ph);
+void LLSurface::applyDCTPatches(const LLPatchDecoder::Packet &packet)
+{
+	const LLPatchDecoder::patch_list_t &patches = packet.mPatches;
+	for (U32 k = 0; k < patches.size(); k++)
+	{
+		LLSurfacePatch *patchp = (LLSurfacePatch *)patches[k].mUserData;
+		if (!patchp)
+		{
+			continue;
+		}
 
 		// Update edges for neighbors.  Need to guarantee that this gets done before we generate vertical stats.
 		patchp->updateNorthEdge();
@@ -46,6 +46,7 @@
 #include "v4color.h"
 
 #include "llvowater.h"
+#include "llpatchdecoder.h"
 #include "llpatchvertexarray.h"
 #include "llviewertexture.h"
 
@@ -93,6 +94,13 @@ public:
 	void disconnectAllNeighbors();
 
 	virtual void decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch);
+	// Batched decompression, see LLVLManager::unpackData().  Points the
+	// patches read from packet at this surface's height field, returning
+	// FALSE and dropping the rest of the packet on a bad patch id.
+	BOOL placeDCTPatches(LLPatchDecoder::Packet &packet);
+	// Once decompressed: updates the edges the patches share with their
+	// neighbors and flags the patches as having new data, in packet order.
+	void applyDCTPatches(const LLPatchDecoder::Packet &packet);
 	virtual void updatePatchVisibilities(LLAgent &agent);
 
 	inline F32 getZ(const U32 k) const				{ return mSurfaceZ[k]; }
@@ -121,6 +129,9 @@ public:
 
 	// Update methods (called during idle, normally)
 	BOOL idleUpdate(F32 max_update_time);
+	// Normals and height stats of the dirty patches, threaded.  Called by
+	// idleUpdate(), leaving the rest of the update to be done in order.
+	void calcDirtyPatches();
 
 	BOOL containsPosition(const LLVector3 &position);
 
@@ -58,6 +58,7 @@ LLSurfacePatch::LLSurfacePatch() :
 	mSTexUpdate(FALSE),
 	mDirty(FALSE),
 	mDirtyZStats(TRUE),
+	mZStatsCalculated(FALSE),
 	mHeightsGenerated(FALSE),
 	mDataOffset(0),
 	mDataZ(NULL),
@@ -110,6 +111,7 @@ void LLSurfacePatch::dirty()
 	}
 
 	mDirtyZStats = TRUE;
+	mZStatsCalculated = FALSE;
 	mHeightsGenerated = FALSE;
 	
 	if (!mDirty)
@@ -399,6 +401,32 @@ void LLSurfacePatch::updateVerticalStats()
 		return;
 	}
 
+	if (!mZStatsCalculated)
+	{
+		calcVerticalStats();
+	}
+
+	mSurfacep->mMaxZ = llmax(mMaxZ, mSurfacep->mMaxZ);
+	mSurfacep->mMinZ = llmin(mMinZ, mSurfacep->mMinZ);
+	mSurfacep->mHasZData = TRUE;
+	mSurfacep->getRegion()->calculateCenterGlobal();
+
+	if (mVObjp)
+	{
+		mVObjp->dirtyPatch();
+	}
+	mDirtyZStats = FALSE;
+	mZStatsCalculated = FALSE;
+}
+
+
+void LLSurfacePatch::calcVerticalStats()
+{
+	if (!mDirtyZStats)
+	{
+		return;
+	}
+
 	U32 grids_per_patch_edge = mSurfacep->getGridsPerPatchEdge();
 	U32 grids_per_edge = mSurfacep->getGridsPerEdge();
 	F32 meters_per_grid = mSurfacep->getMetersPerGrid();
@@ -442,24 +470,23 @@ void LLSurfacePatch::updateVerticalStats()
 						mMaxZ - mMinZ);
 	mRadius = diam_vec.magVec() * 0.5f;
 
-	mSurfacep->mMaxZ = llmax(mMaxZ, mSurfacep->mMaxZ);
-	mSurfacep->mMinZ = llmin(mMinZ, mSurfacep->mMinZ);
-	mSurfacep->mHasZData = TRUE;
-	mSurfacep->getRegion()->calculateCenterGlobal();
+	mZStatsCalculated = TRUE;
+}
 
-	if (mVObjp)
+
+void LLSurfacePatch::updateNormals() 
+{
+	if (calcNormals())
 	{
-		mVObjp->dirtyPatch();
+		mSurfacep->dirtySurfacePatch(this);
 	}
-	mDirtyZStats = FALSE;
 }
 
-
-void LLSurfacePatch::updateNormals() 
+BOOL LLSurfacePatch::calcNormals() 
 {
 	if (mSurfacep->mType == 'w')
 	{
-		return;
+		return FALSE;
 	}
 	U32 grids_per_patch_edge = mSurfacep->getGridsPerPatchEdge();
 	U32 grids_per_edge = mSurfacep->getGridsPerEdge();
@@ -606,15 +633,11 @@ void LLSurfacePatch::updateNormals()
 		dirty_patch = TRUE;
 	}
 
-	if (dirty_patch)
-	{
-		mSurfacep->dirtySurfacePatch(this);
-	}
-
 	for (i = 0; i < 9; i++)
 	{
 		mNormalsInvalid[i] = FALSE;
 	}
+	return dirty_patch;
 }
 
 void LLSurfacePatch::updateEastEdge()
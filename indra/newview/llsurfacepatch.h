@@ -86,6 +86,15 @@ public:
 	void updateCompositionStats();
 	void updateNormals();
 
+	// The parts of updateVerticalStats() and updateNormals() that only
+	// write this patch's own data, which LLSurface::idleUpdate() runs on
+	// several threads.  calcNormals() also reads and writes the edges this
+	// patch shares with its neighbors, so no neighbor (diagonals included)
+	// may run at the same time.  It returns TRUE if the patch needs to be
+	// put on the surface's dirty list.
+	void calcVerticalStats();
+	BOOL calcNormals();
+
 	void updateEastEdge();
 	void updateNorthEdge();
 
@@ -155,6 +164,7 @@ protected:
 
 	BOOL mDirty;
 	BOOL mDirtyZStats;
+	BOOL mZStatsCalculated;	// by calcVerticalStats(), but not yet applied to the surface
 	BOOL mHeightsGenerated;
 
 	U32 mDataOffset;
@@ -39,6 +39,7 @@
 #include "lldir.h"
 #include "llimage.h"
 #include "lllfsthread.h"
+#include "llmappedcachestore.h"
 #include "llviewercontrol.h"
 
 // Included to allow LLTextureCache::purgeTextures() to pause watchdog timeout
@@ -51,9 +52,14 @@
 //  First TEXTURE_CACHE_ENTRY_SIZE bytes of each texture in texture.entries in same order
 // cache/textures/[0-F]/UUID.texture
 //  Actual texture body files
+//
+// With TextureCacheMappedStore set, all of the above is replaced by an
+// LLMappedCacheStore in cache/texturecache/store.*, using
+// TEXTURE_CACHE_ENTRY_SIZE header records.
 
 //note: there is no good to define 1024 for TEXTURE_CACHE_ENTRY_SIZE while FIRST_PACKET_SIZE is 600 on sim side.
 const S32 TEXTURE_CACHE_ENTRY_SIZE = FIRST_PACKET_SIZE;//1024;
+const S32 MAX_REASONABLE_FILE_SIZE = 512*1024*1024; // 512 MB
 const F32 TEXTURE_CACHE_PURGE_AMOUNT = .20f; // % amount to reduce the cache by when it exceeds its limit
 const F32 TEXTURE_CACHE_LRU_SIZE = .10f; // % amount for LRU list (low overhead to regenerate)
 
@@ -400,6 +406,19 @@ bool LLTextureCacheRemoteWorker::doRead()
 	}
 
 	// Second state / stage : identify the cache or not...
+	if (!done && (mState == CACHE) && mCache->mMappedStore)
+	{
+		// The store holds header and body together, read it all at once
+		S32 size = mDataSize > 0 ? mDataSize : MAX_REASONABLE_FILE_SIZE;
+		mDataSize = mCache->mMappedStore->read(mID, mOffset, size, mReadData, mImageSize);
+		if (mDataSize < 0)
+		{
+			// not cached
+			mDataSize = 0;
+		}
+		done = true;
+	}
+
 	if (!done && (mState == CACHE))
 	{
 		idx = mCache->getHeaderCacheEntry(mID, mImageSize);
@@ -544,6 +563,18 @@ bool LLTextureCacheRemoteWorker::doWrite()
 	
 	// No LOCAL state for write(): because it doesn't make much sense to cache a local file...
 
+	if (!done && (mState == CACHE) && mCache->mMappedStore)
+	{
+		// Does nothing if at least this much of the image is already stored
+		if (!mCache->mMappedStore->write(mID, mWriteData, mDataSize, mImageSize))
+		{
+			llwarns << "LLTextureCacheWorker: "  << mID
+					<< " Unable to write to texture store!" << llendl;
+			mDataSize = -1; // failed
+		}
+		done = true;
+	}
+
 	// Second state / stage : set an entry in the headers entry (texture.entries) file
 	if (!done && (mState == CACHE))
 	{
@@ -661,9 +692,12 @@ bool LLTextureCacheRemoteWorker::doWrite()
 	return done;
 }
 
+static LLFastTimer::DeclareTimer FTM_TEXTURE_CACHE_WORK("Texture Cache Worker");
+
 //virtual
 bool LLTextureCacheWorker::doWork(S32 param)
 {
+	LLThreadFastTimer t(FTM_TEXTURE_CACHE_WORK);
 	bool res = false;
 	if (param == 0) // read
 	{
@@ -745,7 +779,8 @@ LLTextureCache::LLTextureCache(bool threaded)
 	  mHeaderAPRFile(NULL),
 	  mReadOnly(TRUE), //do not allow to change the texture cache until setReadOnly() is called.
 	  mTexturesSizeTotal(0),
-	  mDoPurge(FALSE)
+	  mDoPurge(FALSE),
+	  mMappedStore(NULL)
 {
 }
 
@@ -753,6 +788,7 @@ LLTextureCache::~LLTextureCache()
 {
 	clearDeleteList() ;
 	writeUpdatedEntries() ;
+	delete mMappedStore;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -876,6 +912,10 @@ bool LLTextureCache::updateTextureEntryList(const LLUUID& id, S32 bodysize)
 //debug
 BOOL LLTextureCache::isInCache(const LLUUID& id) 
 {
+	if (mMappedStore)
+	{
+		return mMappedStore->exists(id);
+	}
 	LLMutexLock lock(&mHeaderMutex);
 	id_map_t::const_iterator iter = mHeaderIDMap.find(id);
 	
@@ -921,10 +961,19 @@ BOOL LLTextureCache::isInLocal(const LLUUID& id)
 		
 	return FALSE ;
 }
+S64 LLTextureCache::getUsage()
+{
+	return mMappedStore ? (S64)mMappedStore->getBodyBytes() : mTexturesSizeTotal;
+}
+
+U32 LLTextureCache::getEntries()
+{
+	return mMappedStore ? mMappedStore->getEntryCount() : mHeaderEntriesInfo.mEntries;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
 //static
-const S32 MAX_REASONABLE_FILE_SIZE = 512*1024*1024; // 512 MB
 F32 LLTextureCache::sHeaderCacheVersion = 1.4f;
 U32 LLTextureCache::sCacheMaxEntries = MAX_REASONABLE_FILE_SIZE / TEXTURE_CACHE_ENTRY_SIZE;
 S64 LLTextureCache::sCacheMaxTexturesSize = 0; // no limit
@@ -1017,6 +1066,25 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL disable_textu
 			std::string dirname = mTexturesDirName + gDirUtilp->getDirDelimiter() + subdirs[i];
 			LLFile::mkdir(dirname);
 		}
+
+		// The store is only ever opened by one viewer; a read only
+		// instance falls back to the legacy files.
+		if (gSavedSettings.getBOOL("TextureCacheMappedStore"))
+		{
+			mMappedStore = new LLMappedCacheStore;
+			if (mMappedStore->open(mTexturesDirName, TEXTURE_CACHE_ENTRY_SIZE, sCacheMaxEntries, sCacheMaxTexturesSize))
+			{
+				migrateLegacyCache();
+				return max_size;
+			}
+			llwarns << "Unable to open texture store, using the legacy texture cache" << llendl;
+			delete mMappedStore;
+			mMappedStore = NULL;
+		}
+		else if (LLMappedCacheStore::filesExist(mTexturesDirName))
+		{
+			LLMappedCacheStore::removeFiles(mTexturesDirName);
+		}
 	}
 	readHeaderCache();
 	purgeTextures(true); // calc mTexturesSize and make some room in the texture cache if we need it
@@ -1478,6 +1546,72 @@ void LLTextureCache::readHeaderCache()
 	mHeaderMutex.unlock();
 }
 
+// Moves the contents of texture.entries/texture.cache and the body files
+// into mMappedStore, oldest first so that the store's LRU order matches.
+void LLTextureCache::migrateLegacyCache()
+{
+	LLMutexLock lock(&mHeaderMutex);
+
+	readEntriesHeader();
+	if (mHeaderEntriesInfo.mEntries == 0)
+	{
+		return;
+	}
+	std::vector<Entry> entries;
+	if (mHeaderEntriesInfo.mVersion == sHeaderCacheVersion)
+	{
+		openAndReadEntries(entries);
+	}
+
+	typedef std::pair<U32, S32> lru_data_t;
+	std::vector<lru_data_t> order;
+	for (U32 i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].mImageSize > 0 && entries[i].mBodySize >= 0 && entries[i].mBodySize < entries[i].mImageSize)
+		{
+			order.push_back(std::make_pair(entries[i].mTime, (S32)i));
+		}
+	}
+	std::sort(order.begin(), order.end());
+
+	LL_INFOS("TextureCache") << "Migrating " << order.size() << " textures to the texture store" << LL_ENDL;
+	U32 migrated = 0;
+	std::vector<U8> buffer;
+	for (U32 i = 0; i < order.size(); i++)
+	{
+		S32 idx = order[i].second;
+		const Entry& entry = entries[idx];
+		S32 datasize = llmin(entry.mImageSize, TEXTURE_CACHE_ENTRY_SIZE + entry.mBodySize);
+		buffer.resize(datasize);
+
+		S32 header_bytes = llmin(datasize, TEXTURE_CACHE_ENTRY_SIZE);
+		S32 bytes_read = LLAPRFile::readEx(mHeaderDataFileName, &buffer[0], idx * TEXTURE_CACHE_ENTRY_SIZE,
+										   header_bytes, getLocalAPRFilePool());
+		if (bytes_read != header_bytes)
+		{
+			continue;
+		}
+		if (datasize > header_bytes)
+		{
+			bytes_read = LLAPRFile::readEx(getTextureFileName(entry.mID), &buffer[header_bytes], 0,
+										   datasize - header_bytes, getLocalAPRFilePool());
+			if (bytes_read != datasize - header_bytes)
+			{
+				continue;
+			}
+		}
+		if (mMappedStore->write(entry.mID, &buffer[0], datasize, entry.mImageSize))
+		{
+			++migrated;
+		}
+	}
+	LL_INFOS("TextureCache") << "Migrated " << migrated << " textures" << LL_ENDL;
+
+	purgeAllTextures(false);
+	LLAPRFile::remove(mHeaderEntriesFileName, getLocalAPRFilePool());
+	LLAPRFile::remove(mHeaderDataFileName, getLocalAPRFilePool());
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
 void LLTextureCache::purgeAllTextures(bool purge_directories)
@@ -1852,7 +1986,11 @@ bool LLTextureCache::removeFromCache(const LLUUID& id)
 {
 	//llwarns << "Removing texture from cache: " << id << llendl;
 	bool ret = false ;
-	if (!mReadOnly)
+	if (!mReadOnly && mMappedStore)
+	{
+		ret = mMappedStore->remove(id);
+	}
+	else if (!mReadOnly)
 	{
 		lockHeaders() ;
 
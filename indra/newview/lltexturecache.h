@@ -42,6 +42,7 @@
 #include "llworkerthread.h"
 
 class LLImageFormatted;
+class LLMappedCacheStore;
 class LLTextureCacheWorker;
 
 class LLTextureCache : public LLWorkerThread
@@ -136,9 +137,9 @@ public:
 	// debug
 	S32 getNumReads() { return mReaders.size(); }
 	S32 getNumWrites() { return mWriters.size(); }
-	S64 getUsage() { return mTexturesSizeTotal; }
+	S64 getUsage();
 	S64 getMaxUsage() { return sCacheMaxTexturesSize; }
-	U32 getEntries() { return mHeaderEntriesInfo.mEntries; }
+	U32 getEntries();
 	U32 getMaxEntries() { return sCacheMaxEntries; };
 	BOOL isInCache(const LLUUID& id) ;
 	BOOL isInLocal(const LLUUID& id) ;
@@ -156,6 +157,7 @@ protected:
 private:
 	void setDirNames(ELLPath location);
 	void readHeaderCache();
+	void migrateLegacyCache();
 	void purgeAllTextures(bool purge_directories);
 	void purgeTextures(bool validate);
 	LLAPRFile* openHeaderEntriesFile(bool readonly, S32 offset);
@@ -213,6 +215,9 @@ private:
 	S64 mTexturesSizeTotal;
 	LLAtomic32<BOOL> mDoPurge;
 
+	// Replaces the header and body files when TextureCacheMappedStore is set
+	LLMappedCacheStore* mMappedStore;
+
 	typedef std::map<S32, Entry> idx_entry_map_t;
 	idx_entry_map_t mUpdatedEntryMap;
 
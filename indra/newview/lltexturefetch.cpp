@@ -248,6 +248,7 @@ private:
 	e_request_state mSentRequest;
 	handle_t mDecodeHandle;
 	BOOL mDecoded;
+	BOOL mDecodeCancelled;
 	BOOL mWritten;
 	BOOL mNeedsAux;
 	BOOL mHaveAllData;
@@ -402,6 +403,7 @@ LLTextureFetchWorker::LLTextureFetchWorker(LLTextureFetch* fetcher,
 	  mSentRequest(UNSENT),
 	  mDecodeHandle(0),
 	  mDecoded(FALSE),
+	  mDecodeCancelled(FALSE),
 	  mWritten(FALSE),
 	  mNeedsAux(FALSE),
 	  mHaveAllData(FALSE),
@@ -518,6 +520,14 @@ void LLTextureFetchWorker::setDesiredDiscard(S32 discard, S32 size)
 		{
 			prioritize = true;
 		}
+		else if (mState == DECODE_IMAGE_UPDATE && mDecodeHandle != 0 && !mDecoded &&
+				 !mHaveAllData && discard < mLoadedDiscard)
+		{
+			// The data being decoded cannot reach the new level. Stop the
+			// decode and go back for more data instead of finishing it.
+			mDecodeCancelled = TRUE;
+			mFetcher->mImageDecodeThread->cancelDecode(mDecodeHandle);
+		}
 		mDesiredDiscard = discard;
 		mDesiredSize = size;
 	}
@@ -568,9 +578,12 @@ void LLTextureFetchWorker::startWork(S32 param)
 
 #include "llviewertexturelist.h" // debug
 
+static LLFastTimer::DeclareTimer FTM_TEXTURE_FETCH_WORK("Texture Fetch Worker");
+
 // Called from LLWorkerThread::processRequest()
 bool LLTextureFetchWorker::doWork(S32 param)
 {
+	LLThreadFastTimer t(FTM_TEXTURE_FETCH_WORK);
 	LLMutexLock lock(&mWorkMutex);
 
 	if ((mFetcher->isQuitting() || mImagePriority < 1.0f || getFlags(LLWorkerClass::WCF_DELETE_REQUESTED)))
@@ -802,7 +815,9 @@ bool LLTextureFetchWorker::doWork(S32 param)
 	if (mState == SEND_HTTP_REQ)
 	{
 		{
-			const S32 HTTP_QUEUE_MAX_SIZE = 8;
+			// mCurlGetRequest only keeps a few of these in flight per host (see startThread())
+			// at once and starts the rest in priority order as they free up.
+			const S32 HTTP_QUEUE_MAX_SIZE = 32;
 			// *TODO: Integrate this with llviewerthrottle
 			// Note: LLViewerThrottle uses dynamic throttling which makes sense for UDP,
 			// but probably not for Textures.
@@ -855,7 +870,8 @@ bool LLTextureFetchWorker::doWork(S32 param)
 				std::vector<std::string> headers;
 				headers.push_back("Accept: image/x-j2c");
 				res = mFetcher->mCurlGetRequest->getByteRange(mUrl, headers, offset, mRequestedSize,
-															  new HTTPGetResponder(mFetcher, mID, LLTimer::getTotalTime(), mRequestedSize, offset));
+															  new HTTPGetResponder(mFetcher, mID, LLTimer::getTotalTime(), mRequestedSize, offset),
+															  mWorkPriority);
 			}
 			if (!res)
 			{
@@ -1000,6 +1016,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		S32 discard = mHaveAllData ? 0 : mLoadedDiscard;
 		U32 image_priority = LLWorkerThread::PRIORITY_NORMAL | mWorkPriority;
 		mDecoded  = FALSE;
+		mDecodeCancelled = FALSE;
 		mState = DECODE_IMAGE_UPDATE;
 		LL_DEBUGS("Texture") << mID << ": Decoding. Bytes: " << mFormattedImage->getDataSize() << " Discard: " << discard
 				<< " All Data: " << mHaveAllData << LL_ENDL;
@@ -1012,7 +1029,14 @@ bool LLTextureFetchWorker::doWork(S32 param)
 	{
 		if (mDecoded)
 		{
-			if (mDecodedDiscard < 0)
+			if (mDecodeCancelled && mDecodedDiscard < 0)
+			{
+				// Cancelled for a lower discard level, keep the data and fetch more
+				LL_DEBUGS("Texture") << mID << ": Decode cancelled. Desired Discard: " << mDesiredDiscard << LL_ENDL;
+				setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
+				mState = WRITE_TO_CACHE;
+			}
+			else if (mDecodedDiscard < 0)
 			{
 				LL_DEBUGS("Texture") << mID << ": Failed to Decode." << LL_ENDL;
 				if (mCachedSize > 0 && !mInLocalCache && mRetryAttempt == 0)
@@ -1092,9 +1116,10 @@ bool LLTextureFetchWorker::doWork(S32 param)
 
 	if (mState == DONE)
 	{
-		if (mDecodedDiscard >= 0 && mDesiredDiscard < mDecodedDiscard)
+		if ((mDecodedDiscard >= 0 && mDesiredDiscard < mDecodedDiscard) || mDecodeCancelled)
 		{
 			// More data was requested, return to INIT
+			mDecodeCancelled = FALSE;
 			mState = INIT;
 			setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 			return false;
@@ -1380,9 +1405,14 @@ void LLTextureFetchWorker::callbackDecoded(bool success, LLImageRaw* raw, LLImag
 		mRawImage = raw;
 		mAuxImage = aux;
 		mDecodedDiscard = mFormattedImage->getDiscardLevel();
+		mDecodeCancelled = FALSE; // finished before the cancel was seen
  		LL_DEBUGS("Texture") << mID << ": Decode Finished. Discard: " << mDecodedDiscard
 							 << " Raw Image: " << llformat("%dx%d",mRawImage->getWidth(),mRawImage->getHeight()) << LL_ENDL;
 	}
+	else if (mDecodeCancelled)
+	{
+		mDecodedDiscard = -1;
+	}
 	else
 	{
 		llwarns << "DECODE FAILED: " << mID << " Discard: " << (S32)mFormattedImage->getDiscardLevel() << llendl;
@@ -1423,7 +1453,9 @@ bool LLTextureFetchWorker::writeToCacheComplete()
 // public
 
 LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* imagedecodethread, bool threaded)
-	: LLWorkerThread("TextureFetch", threaded),
+	// mCurlGetRequest must be created, used and deleted on one thread, so
+	// this keeps its own thread rather than running on the scheduler
+	: LLWorkerThread("TextureFetch", threaded, false),
 	  mDebugCount(0),
 	  mDebugPause(FALSE),
 	  mPacketCount(0),
@@ -1776,13 +1808,21 @@ void LLTextureFetch::shutDownImageDecodeThread()
 void LLTextureFetch::startThread()
 {
 	// Construct mCurlGetRequest from Worker Thread
+	const S32 HTTP_REQUESTS_PER_HOST = 8;
 	mCurlGetRequest = new LLCurlRequest();
+	mCurlGetRequest->setMaxRequestsPerHost(HTTP_REQUESTS_PER_HOST);
 }
 
 // WORKER THREAD
 void LLTextureFetch::endThread()
 {
 	// Destroy mCurlGetRequest from Worker Thread
+	const LLCurlRequest::Stats& stats = mCurlGetRequest->getStats();
+	llinfos << "Texture HTTP requests: " << stats.mRequests
+			<< " completed: " << stats.mCompleted
+			<< " new connections: " << stats.mNewConnections
+			<< " reused connections: " << stats.mReusedConnections
+			<< " most queued: " << stats.mMaxQueued << llendl;
 	delete mCurlGetRequest;
 	mCurlGetRequest = NULL;
 }
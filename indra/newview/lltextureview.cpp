@@ -397,7 +397,7 @@ public:
 		:	texture_view("texture_view")
 		{
 			S32 line_height = (S32)(LLFontGL::getFontMonospace()->getLineHeight() + .5f);
-			rect(LLRect(0,0,100,line_height * 4));
+			rect(LLRect(0,0,100,line_height * 5));
 		}
 	};
 
@@ -515,7 +515,7 @@ void LLGLTexMemBar::draw()
 					LLAppViewer::getTextureCache()->getNumReads(),
 					LLAppViewer::getTextureCache()->getNumWrites(),
 					LLLFSThread::sLocal->getPending(),
-					LLImageRaw::sRawImageCount,
+					(S32)LLImageRaw::sRawImageCount,
 					LLAppViewer::getTextureFetch()->getNumHTTPRequests(),
 					LLAppViewer::getImageDecodeThread()->getPending(), 
 					gTextureList.mCreateTextureList.size(),
@@ -525,6 +525,30 @@ void LLGLTexMemBar::draw()
 	LLFontGL::getFontMonospace()->renderUTF8(text, 0, 0, v_offset + line_height*2,
 									 text_color, LLFontGL::LEFT, LLFontGL::TOP);
 
+	// Decode pool: totals, then per thread busy flag, decodes and average slice time
+	LLImageDecodeThread* decode_thread = LLAppViewer::getImageDecodeThread();
+	LLImageDecodeThread::Stats decode_stats = decode_thread->getStats();
+	std::vector<LLImageDecodeThread::WorkerStats> worker_stats;
+	decode_thread->getWorkerStats(worker_stats);
+	F32 decodes = (F32)llmax(decode_stats.mDecodes, (U32)1);
+	text = llformat("Decode Threads: %d Queue: %d Done: %d Cancel: %d Fail: %d Wait: %.1f ms Latency: %.1f/%.1f ms",
+					decode_thread->getNumWorkers(),
+					decode_thread->getPending(),
+					decode_stats.mDecodes,
+					decode_stats.mCancels,
+					decode_stats.mFailures,
+					(F32)(decode_stats.mWaitTime * 1000.0) / decodes,
+					(F32)(decode_stats.mLatency * 1000.0) / decodes,
+					(F32)(decode_stats.mMaxLatency * 1000.0));
+	for (S32 i = 0; i < (S32)worker_stats.size(); ++i)
+	{
+		const LLImageDecodeThread::WorkerStats& stats = worker_stats[i];
+		text += llformat(" [%d%s %d %.1fms]", i, stats.mBusy ? "*" : "", stats.mDecodes,
+						 stats.mSlices ? (F32)(stats.mBusyTime * 1000.0) / stats.mSlices : 0.f);
+	}
+	LLFontGL::getFontMonospace()->renderUTF8(text, 0, 0, v_offset + line_height*4,
+									 text_color, LLFontGL::LEFT, LLFontGL::TOP);
+
 	left = 600;
 	
 	S32 dx1 = 0;
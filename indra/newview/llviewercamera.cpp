@@ -792,9 +792,9 @@ BOOL LLViewerCamera::areVertsVisible(LLViewerObject* volumep, BOOL all_verts)
 	{
 		const LLVolumeFace& face = volume->getVolumeFace(i);
 				
-		for (U32 v = 0; v < face.mVertices.size(); v++)
+		for (S32 v = 0; v < face.getNumVertices(); v++)
 		{
-			LLVector4 vec = LLVector4(face.mVertices[v].mPosition) * mat;
+			LLVector4 vec = LLVector4(face.getPosition(v)) * mat;
 
 			if (drawablep->isActive())
 			{
@@ -74,6 +74,7 @@
 #include "llnavigationbar.h"
 #include "llfloatertools.h"
 #include "llpaneloutfitsinventory.h"
+#include "lluictrlfactory.h"
 
 #ifdef TOGGLE_HACKED_GODLIKE_VIEWER
 BOOL 				gHackGodmode = FALSE;
@@ -374,6 +375,18 @@ static bool handleDebugViewsChanged(const LLSD& newvalue)
 	return true;
 }
 
+static bool handleDebugChildLookupsChanged(const LLSD& newvalue)
+{
+	LLView::sDebugChildLookups = newvalue.asBoolean();
+	return true;
+}
+
+static bool handleUseCompiledXUIChanged(const LLSD& newvalue)
+{
+	LLUICtrlFactory::setUseCompiledXUI(newvalue.asBoolean());
+	return true;
+}
+
 static bool handleLogFileChanged(const LLSD& newvalue)
 {
 	std::string log_filename = newvalue.asString();
@@ -620,6 +633,8 @@ void settings_setup_listeners()
 	gSavedSettings.getControl("BuildAxisDeadZone4")->getSignal()->connect(boost::bind(&handleJoystickChanged, _2));
 	gSavedSettings.getControl("BuildAxisDeadZone5")->getSignal()->connect(boost::bind(&handleJoystickChanged, _2));
 	gSavedSettings.getControl("DebugViews")->getSignal()->connect(boost::bind(&handleDebugViewsChanged, _2));
+	gSavedSettings.getControl("DebugChildLookups")->getSignal()->connect(boost::bind(&handleDebugChildLookupsChanged, _2));
+	gSavedSettings.getControl("UseCompiledXUI")->getSignal()->connect(boost::bind(&handleUseCompiledXUIChanged, _2));
 	gSavedSettings.getControl("UserLogFile")->getSignal()->connect(boost::bind(&handleLogFileChanged, _2));
 	gSavedSettings.getControl("RenderHideGroupTitle")->getSignal()->connect(boost::bind(handleHideGroupTitleChanged, _2));
 	gSavedSettings.getControl("HighResSnapshot")->getSignal()->connect(boost::bind(handleHighResSnapshotChanged, _2));
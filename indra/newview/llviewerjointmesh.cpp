@@ -885,6 +885,13 @@ void LLViewerJointMesh::updateVectorize()
 	}
 }
 
+//static
+bool LLViewerJointMesh::isSkinningThreadSafe()
+{
+	// the performance test keeps its timings in statics
+	return !sVectorizePerfTest && sUpdateGeometryFunc != &updateGeometryOriginal;
+}
+
 void LLViewerJointMesh::updateJointGeometry()
 {
 	if (!(mValid
@@ -151,6 +151,10 @@ public:
 	/*virtual*/ BOOL isAnimatable() const { return FALSE; }
 	
 	static void updateVectorize(); // Update globals when settings variables change
+	// True if updateJointGeometry() may run off the main thread, on buffers
+	// already mapped.  Only the vectorized versions keep their joint
+	// matrices to themselves.
+	static bool isSkinningThreadSafe();
 	
 private:
 	// Avatar vertex skinning is a significant performance issue on computers
@@ -717,6 +717,9 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 		}
 	}
 
+	// avatars animate in parallel once the idle updates are done
+	LLVOAvatar::openUpdateQueue();
+
 	if (gSavedSettings.getBOOL("FreezeTime"))
 	{
 		for (std::vector<LLViewerObject*>::iterator iter = idle_list.begin();
@@ -729,6 +732,7 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 				objectp->idleUpdate(agent, world, frame_time);
 			}
 		}
+		LLVOAvatar::flushUpdateQueue();
 	}
 	else
 	{
@@ -746,6 +750,7 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 				num_active_objects++;
 			}
 		}
+		LLVOAvatar::flushUpdateQueue();
 		for (std::vector<LLViewerObject*>::iterator kill_iter = kill_list.begin();
 			kill_iter != kill_list.end(); kill_iter++)
 		{
@@ -75,10 +75,6 @@
 	#pragma warning(disable:4355)
 #endif
 
-// Viewer object cache version, change if object update
-// format changes. JC
-const U32 INDRA_OBJECT_CACHE_VERSION = 14;
-
 
 extern BOOL gNoRender;
 
@@ -328,6 +324,12 @@ LLViewerRegion::~LLViewerRegion()
 }
 
 
+std::string LLViewerRegion::getCacheFilename() const
+{
+	return gDirUtilp->getExpandedFilename(LL_PATH_CACHE,"") + gDirUtilp->getDirDelimiter() +
+		llformat("objects_%d_%d.slc",U32(mHandle>>32)/REGION_WIDTH_UNITS, U32(mHandle)/REGION_WIDTH_UNITS );
+}
+
 void LLViewerRegion::loadCache()
 {
 	if (mCacheLoaded)
@@ -338,78 +340,14 @@ void LLViewerRegion::loadCache()
 	// Presume success.  If it fails, we don't want to try again.
 	mCacheLoaded = TRUE;
 
-	LLVOCacheEntry *entry;
-
-	std::string filename;
-	filename = gDirUtilp->getExpandedFilename(LL_PATH_CACHE,"") + gDirUtilp->getDirDelimiter() +
-		llformat("objects_%d_%d.slc",U32(mHandle>>32)/REGION_WIDTH_UNITS, U32(mHandle)/REGION_WIDTH_UNITS );
-
-	LLFILE* fp = LLFile::fopen(filename, "rb");		/* Flawfinder: ignore */
-	if (!fp)
+	// Only maps the file and reads its index; entries are read from it
+	// as getDP() gets CRC hits.  A missing file, an old version or
+	// another region's cache all just start out empty.
+	if (mCacheFile.open(getCacheFilename(), mCacheID))
 	{
-		// might not have a file, which is normal
-		return;
-	}
-
-	U32 zero;
-	size_t nread;
-	nread = fread(&zero, sizeof(U32), 1, fp);
-	if (nread != 1 || zero)
-	{
-		// a non-zero value here means bad things!
-		// skip reading the cached values
-		llinfos << "Cache file invalid" << llendl;
-		fclose(fp);
-		return;
-	}
-
-	U32 version;
-	nread = fread(&version, sizeof(U32), 1, fp);
-	if (nread != 1 || version != INDRA_OBJECT_CACHE_VERSION)
-	{
-		// a version mismatch here means we've changed the binary format!
-		// skip reading the cached values
-		llinfos << "Cache version changed, discarding" << llendl;
-		fclose(fp);
-		return;
-	}
-
-	LLUUID cache_id;
-	nread = fread(&cache_id.mData, 1, UUID_BYTES, fp);
-	if (nread != (size_t)UUID_BYTES || mCacheID != cache_id)
-	{
-		llinfos << "Cache ID doesn't match for this region, discarding"
-			<< llendl;
-		fclose(fp);
-		return;
+		LL_DEBUGS("ObjectCache") << "Mapped " << mCacheFile.getNumEntries()
+			<< " cached objects for region " << getName() << LL_ENDL;
 	}
-
-	S32 num_entries;
-	nread = fread(&num_entries, sizeof(S32), 1, fp);
-	if (nread != 1)
-	{
-		llinfos << "Short read, discarding" << llendl;
-		fclose(fp);
-		return;
-	}
-	
-	S32 i;
-	for (i = 0; i < num_entries; i++)
-	{
-		entry = new LLVOCacheEntry(fp);
-		if (!entry->getLocalID())
-		{
-			llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
-			delete entry;
-			entry = NULL;
-			break;
-		}
-		mCacheEnd.insert(*entry);
-		mCacheMap[entry->getLocalID()] = entry;
-		mCacheEntriesCount++;
-	}
-
-	fclose(fp);
 }
 
 
@@ -420,62 +358,35 @@ void LLViewerRegion::saveCache()
 		return;
 	}
 
-	S32 num_entries = mCacheEntriesCount;
-	if (0 == num_entries)
-	{
-		return;
-	}
-
-	std::string filename;
-	filename = gDirUtilp->getExpandedFilename(LL_PATH_CACHE,"") + gDirUtilp->getDirDelimiter() +
-		llformat("sobjects_%d_%d.slc", U32(mHandle>>32)/REGION_WIDTH_UNITS, U32(mHandle)/REGION_WIDTH_UNITS );
-
-	LLFILE* fp = LLFile::fopen(filename, "wb");		/* Flawfinder: ignore */
-	if (!fp)
-	{
-		llwarns << "Unable to write cache file " << filename << llendl;
-		return;
-	}
-
-	// write out zero to indicate a version cache file
-	U32 zero = 0;
-	if (fwrite(&zero, sizeof(U32), 1, fp) != 1)
-	{
-		llwarns << "Short write" << llendl;
-	}
-
-	// write out version number
-	U32 version = INDRA_OBJECT_CACHE_VERSION;
-	if (fwrite(&version, sizeof(U32), 1, fp) != 1)
-	{
-		llwarns << "Short write" << llendl;
-	}
-
-	// write the cache id for this sim
-	if (fwrite(&mCacheID.mData, 1, UUID_BYTES, fp) != (size_t)UUID_BYTES)
+	// Entries read from the file are already there, only append the
+	// new and changed ones.
+	std::vector<LLObjectCacheFile::Entry> entries;
+	entries.reserve(mCacheEntriesCount);
+	LLVOCacheEntry *entry;
+	for (entry = mCacheStart.getNext(); entry && (entry != &mCacheEnd); entry = entry->getNext())
 	{
-		llwarns << "Short write" << llendl;
+		if (entry->isDirty())
+		{
+			entries.push_back(LLObjectCacheFile::Entry());
+			entry->getCacheFileEntry(entries.back());
+		}
 	}
 
-	if (fwrite(&num_entries, sizeof(S32), 1, fp) != 1)
+	if (!entries.empty())
 	{
-		llwarns << "Short write" << llendl;
-	}
-
-	LLVOCacheEntry *entry;
-
-	for (entry = mCacheStart.getNext(); entry && (entry != &mCacheEnd); entry = entry->getNext())
-	{
-		entry->writeToFile(fp);
+		if (!mCacheFile.save(entries, MAX_OBJECT_CACHE_ENTRIES))
+		{
+			llwarns << "Unable to write cache file " << getCacheFilename() << llendl;
+		}
 	}
+	mCacheFile.close();
 
 	mCacheMap.clear();
 	mCacheEnd.unlink();
 	mCacheEnd.init();
 	mCacheStart.deleteAll();
 	mCacheStart.init();
-
-	fclose(fp);
+	mCacheEntriesCount = 0;
 }
 
 void LLViewerRegion::sendMessage()
@@ -1127,6 +1038,21 @@ void LLViewerRegion::getInfo(LLSD& info)
 	info["Region"]["Handle"]["y"] = (LLSD::Integer)y;
 }
 
+void LLViewerRegion::addCacheEntry(LLVOCacheEntry* entry)
+{
+	if (mCacheEntriesCount > MAX_OBJECT_CACHE_ENTRIES)
+	{
+		LLVOCacheEntry* oldest = mCacheStart.getNext();
+		mCacheMap.erase(oldest->getLocalID());
+		delete oldest;
+		mCacheEntriesCount--;
+	}
+
+	mCacheEnd.insert(*entry);
+	mCacheMap[entry->getLocalID()] = entry;
+	mCacheEntriesCount++;
+}
+
 void LLViewerRegion::cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinaryBuffer &dp)
 {
 	U32 local_id = objectp->getLocalID();
@@ -1151,26 +1077,19 @@ void LLViewerRegion::cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinary
 			mCacheEnd.insert(*entry);
 			mCacheMap[local_id] = entry;
 		}
+		return;
 	}
-	else
-	{
-		// we haven't seen this object before
 
-		// Create new entry and add to map
-		if (mCacheEntriesCount > MAX_OBJECT_CACHE_ENTRIES)
-		{
-			entry = mCacheStart.getNext();
-			mCacheMap.erase(entry->getLocalID());
-			delete entry;
-			mCacheEntriesCount--;
-		}
-		entry = new LLVOCacheEntry(local_id, crc, dp);
-
-		mCacheEnd.insert(*entry);
-		mCacheMap[local_id] = entry;
-		mCacheEntriesCount++;
+	U32 file_crc;
+	if (mCacheFile.find(local_id, file_crc) && file_crc == crc)
+	{
+		// already in the cache file, no need to bring it in
+		return;
 	}
-	return ;
+
+	// we haven't seen this object before, or the cache file version is
+	// stale.  Saving the new entry replaces the record in the file.
+	addCacheEntry(new LLVOCacheEntry(local_id, crc, dp));
 }
 
 // Get data packer for this object, if we have cached data
@@ -1181,25 +1100,45 @@ LLDataPacker *LLViewerRegion::getDP(U32 local_id, U32 crc)
 
 	LLVOCacheEntry* entry = get_if_there(mCacheMap, local_id, (LLVOCacheEntry*)NULL);
 
-	if (entry)
+	if (!entry)
 	{
-		// we've seen this object before
-		if (entry->getCRC() == crc)
+		U32 file_crc;
+		if (!mCacheFile.find(local_id, file_crc))
 		{
-			// Record a hit
-			entry->recordHit();
-			return entry->getDP(crc);
+			// llinfos << "Cache miss for " << local_id << llendl;
+			mCacheMissFull.put(local_id);
+			return NULL;
 		}
-		else
+		if (file_crc != crc)
 		{
 			// llinfos << "CRC miss for " << local_id << llendl;
 			mCacheMissCRC.put(local_id);
+			return NULL;
 		}
+
+		// CRC hit on the cache file, read the entry in
+		const U8* data;
+		const LLObjectCacheFile::Record* record = mCacheFile.getRecord(local_id, data);
+		if (!record)
+		{
+			mCacheMissFull.put(local_id);
+			return NULL;
+		}
+		entry = new LLVOCacheEntry(*record, data);
+		addCacheEntry(entry);
+	}
+
+	// we've seen this object before
+	if (entry->getCRC() == crc)
+	{
+		// Record a hit
+		entry->recordHit();
+		return entry->getDP(crc);
 	}
 	else
 	{
-		// llinfos << "Cache miss for " << local_id << llendl;
-		mCacheMissFull.put(local_id);
+		// llinfos << "CRC miss for " << local_id << llendl;
+		mCacheMissCRC.put(local_id);
 	}
 	return NULL;
 }
@@ -1313,7 +1252,8 @@ void LLViewerRegion::dumpCache()
 		change_bin[changes]++;
 	}
 
-	llinfos << "Count " << mCacheEntriesCount << llendl;
+	llinfos << "Count " << mCacheEntriesCount << " in memory, "
+		<< mCacheFile.getNumEntries() << " in file" << llendl;
 	for (i = 0; i < BINS; i++)
 	{
 		llinfos << "Hits " << i << " " << hit_bin[i] << llendl;
@@ -386,7 +386,10 @@ private:
 	// Maps local ids to cache entries.
 	// Regions can have order 10,000 objects, so assume
 	// a structure of size 2^14 = 16,000
+	// Only entries that were hit or updated this session are in memory,
+	// the rest stay in mCacheFile until asked for.
 	BOOL									mCacheLoaded;
+	LLObjectCacheFile						mCacheFile;
 	typedef std::map<U32, LLVOCacheEntry *>	cache_map_t;
 	cache_map_t			  				 	mCacheMap;
 	LLVOCacheEntry							mCacheStart;
@@ -394,6 +397,8 @@ private:
 	U32										mCacheEntriesCount;
 	LLDynamicArray<U32>						mCacheMissFull;
 	LLDynamicArray<U32>						mCacheMissCRC;
+	void addCacheEntry(LLVOCacheEntry* entry);
+	std::string getCacheFilename() const;
 	// time?
 	// LRU info?
 
@@ -81,6 +81,11 @@ void LLVLManager::unpackData(const S32 num_packets)
 {
 	static LLFrameTimer decode_timer;
 	
+	// The land patches of all the packets are decompressed as one batch,
+	// see LLPatchDecoder.  Wind and clouds are done as they come.
+	LLPatchDecoder::packet_list_t land_packets;
+	land_packets.reserve(mPacketData.count());
+
 	S32 i;
 	for (i = 0; i < mPacketData.count(); i++)
 	{
@@ -92,7 +97,8 @@ void LLVLManager::unpackData(const S32 num_packets)
 		decode_patch_group_header(bit_pack, &goph);
 		if (LAND_LAYER_CODE == datap->mType)
 		{
-			datap->mRegionp->getLand().decompressDCTPatch(bit_pack, &goph, FALSE);
+			LLSurface &land = datap->mRegionp->getLand();
+			land_packets.push_back(LLPatchDecoder::Packet(bit_pack, goph.patch_size, land.getGridsPerEdge(), &land));
 		}
 		else if (WIND_LAYER_CODE == datap->mType)
 		{
@@ -105,6 +111,22 @@ void LLVLManager::unpackData(const S32 num_packets)
 		}
 	}
 
+	if (!land_packets.empty())
+	{
+		LLPatchDecoder::readPackets(land_packets);
+		for (i = 0; i < (S32)land_packets.size(); i++)
+		{
+			LLSurface *landp = (LLSurface *)land_packets[i].mUserData;
+			landp->placeDCTPatches(land_packets[i]);
+		}
+		LLPatchDecoder::decompressPackets(land_packets);
+		for (i = 0; i < (S32)land_packets.size(); i++)
+		{
+			LLSurface *landp = (LLSurface *)land_packets[i].mUserData;
+			landp->applyDCTPatches(land_packets[i]);
+		}
+	}
+
 	for (i = 0; i < mPacketData.count(); i++)
 	{
 		delete mPacketData[i];
@@ -66,12 +66,14 @@
 #include "llkeyframewalkmotion.h"
 #include "llmutelist.h"
 #include "llmoveview.h"
+#include "llpolymorphbatch.h"
 #include "llquantize.h"
 #include "llregionhandle.h"
 #include "llresmgr.h"
 #include "llselectmgr.h"
 #include "llsprite.h"
 #include "lltargetingmotion.h"
+#include "lltaskscheduler.h"
 #include "lltexlayer.h"
 #include "lltoolmorph.h"
 #include "llviewercamera.h"
@@ -615,6 +617,8 @@ BOOL LLVOAvatar::sVisibleInFirstPerson = FALSE;
 F32 LLVOAvatar::sLODFactor = 1.f;
 BOOL LLVOAvatar::sUseImpostors = FALSE;
 BOOL LLVOAvatar::sJointDebug = FALSE;
+LLVOAvatar::avatar_vec_t LLVOAvatar::sUpdateQueue;
+BOOL LLVOAvatar::sQueueUpdates = FALSE;
 
 F32 LLVOAvatar::sUnbakedTime = 0.f;
 F32 LLVOAvatar::sUnbakedUpdateTime = 0.f;
@@ -692,6 +696,7 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 	}
 
 	mDirtyMesh = TRUE;	// Dirty geometry, need to regenerate.
+	mSkinInUpdate = FALSE;
 	mMeshTexturesDirty = FALSE;
 	mShadow0Facep = NULL;
 	mShadow1Facep = NULL;
@@ -1206,6 +1211,8 @@ void LLVOAvatar::initInstance(void)
 	if (LLCharacter::sInstances.size() == 1)
 	{
 		LLKeyframeMotion::setVFS(gStaticVFS);
+		LLKeyframeMotion::setVectorize(true);
+		LLPolyMorphBatch::setVectorize(true);
 		registerMotion( ANIM_AGENT_BUSY,					LLNullMotion::create );
 		registerMotion( ANIM_AGENT_CROUCH,					LLKeyframeStandMotion::create );
 		registerMotion( ANIM_AGENT_CROUCHWALK,				LLKeyframeWalkMotion::create );
@@ -2117,6 +2124,7 @@ S32 LLVOAvatar::setTETexture(const U8 te, const LLUUID& uuid)
 
 static LLFastTimer::DeclareTimer FTM_AVATAR_UPDATE("Update Avatar");
 static LLFastTimer::DeclareTimer FTM_JOINT_UPDATE("Update Joints");
+static LLFastTimer::DeclareTimer FTM_UPDATE_SKELETON("Update Skeleton");
 
 //------------------------------------------------------------------------
 // idleUpdate()
@@ -2196,11 +2204,31 @@ BOOL LLVOAvatar::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 	// animate the character
 	// store off last frame's root position to be consistent with camera position
 	LLVector3 root_pos_last = mRoot.getWorldPosition();
+	if (sQueueUpdates && !isSelf() && !mIsDummy)
+	{
+		if (beginUpdateCharacter(agent))
+		{
+			// the rest of the update runs from flushUpdateQueue()
+			mRootPosLast = root_pos_last;
+			sUpdateQueue.push_back(this);
+		}
+		else
+		{
+			idleUpdateFinish(FALSE, root_pos_last);
+		}
+		return TRUE;
+	}
+
 	BOOL detailed_update = updateCharacter(agent);
+	idleUpdateFinish(detailed_update, root_pos_last);
+	return TRUE;
+}
 
+void LLVOAvatar::idleUpdateFinish(BOOL detailed_update, const LLVector3& root_pos_last)
+{
 	if (gNoRender)
 	{
-		return TRUE;
+		return;
 	}
 
 	static LLUICachedControl<bool> visualizers_in_calls("ShowVoiceVisualizersInCalls", false);
@@ -2221,7 +2249,58 @@ BOOL LLVOAvatar::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 	idleUpdateNameTag( root_pos_last );
 	idleUpdateRenderCost();
 	idleUpdateTractorBeam();
-	return TRUE;
+}
+
+//------------------------------------------------------------------------
+// Parallel updates
+//------------------------------------------------------------------------
+class LLVOAvatar::UpdateBody : public LLTaskScheduler::ParallelBody
+{
+public:
+	/*virtual*/ void run(S32 index)
+	{
+		sUpdateQueue[index]->updateSkeleton();
+	}
+};
+
+//static
+void LLVOAvatar::openUpdateQueue()
+{
+	static LLCachedControl<bool> parallel_update(gSavedSettings, "AvatarParallelUpdate");
+	sQueueUpdates = parallel_update && LLTaskScheduler::getInstance() != NULL;
+}
+
+//static
+void LLVOAvatar::flushUpdateQueue()
+{
+	sQueueUpdates = FALSE;
+	if (sUpdateQueue.empty())
+	{
+		return;
+	}
+
+	{
+		LLFastTimer t(FTM_UPDATE_SKELETON);
+
+		// GL calls stay on the main thread
+		for (avatar_vec_t::iterator iter = sUpdateQueue.begin(); iter != sUpdateQueue.end(); ++iter)
+		{
+			LLVOAvatar* avatarp = *iter;
+			avatarp->mSkinInUpdate = avatarp->mapSkinnedBuffers();
+		}
+
+		UpdateBody body;
+		LLTaskScheduler::getInstance()->parallelFor((S32)sUpdateQueue.size(), body);
+	}
+
+	// finish in the order the avatars were queued
+	for (avatar_vec_t::iterator iter = sUpdateQueue.begin(); iter != sUpdateQueue.end(); ++iter)
+	{
+		LLVOAvatar* avatarp = *iter;
+		avatarp->endUpdateCharacter();
+		avatarp->idleUpdateFinish(TRUE, avatarp->mRootPosLast);
+	}
+	sUpdateQueue.clear();
 }
 
 void LLVOAvatar::idleUpdateVoiceVisualizer(bool voice_enabled)
@@ -2296,7 +2375,10 @@ void LLVOAvatar::idleUpdateVoiceVisualizer(bool voice_enabled)
 					if( mAahMorph ) mAahMorph->setWeight(mAahMorph->getMinWeight(), FALSE);
 					
 					mLipSyncActive = false;
-					LLCharacter::updateVisualParams();
+					{
+						LLPolyMorphBatchScope morph_batch(mMorphBatchQueue);
+						LLCharacter::updateVisualParams();
+					}
 					dirtyMesh();
 				}
 			}
@@ -2455,6 +2537,7 @@ void LLVOAvatar::idleUpdateAppearanceAnimation()
 		{
 			F32 morph_amt = calcMorphAmount();
 			LLVisualParam *param;
+			LLPolyMorphBatchScope morph_batch(mMorphBatchQueue);
 
 			if (!isSelf())
 			{
@@ -2530,7 +2613,10 @@ void LLVOAvatar::idleUpdateLipSync(bool voice_enabled)
 		}
 
 		mLipSyncActive = true;
-		LLCharacter::updateVisualParams();
+		{
+			LLPolyMorphBatchScope morph_batch(mMorphBatchQueue);
+			LLCharacter::updateVisualParams();
+		}
 		dirtyMesh();
 	}
 }
@@ -3002,6 +3088,28 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 {
 	LLMemType mt(LLMemType::MTYPE_AVATAR);
 
+	if (!beginUpdateCharacter(agent))
+	{
+		return FALSE;
+	}
+
+	{
+		LLFastTimer t(FTM_UPDATE_SKELETON);
+		updateSkeleton();
+	}
+
+	endUpdateCharacter();
+
+	return TRUE;
+}
+
+//------------------------------------------------------------------------
+// beginUpdateCharacter()
+// Everything before the skeleton is animated.  Returns FALSE if the
+// avatar is not animated this frame.
+//------------------------------------------------------------------------
+BOOL LLVOAvatar::beginUpdateCharacter(LLAgent &agent)
+{
 	// clear debug text
 	mDebugText.clear();
 	if (LLVOAvatar::sShowAnimationDebug)
@@ -3369,19 +3477,53 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 	// store data relevant to motions
 	mSpeed = speed;
 
-	// update animations
+	// start the animation update
 	if (mSpecialRenderMode == 1) // Animation Preview
-		updateMotions(LLCharacter::FORCE_UPDATE);
+		beginUpdateMotions(LLCharacter::FORCE_UPDATE);
 	else
-		updateMotions(LLCharacter::NORMAL_UPDATE);
+		beginUpdateMotions(LLCharacter::NORMAL_UPDATE);
+
+	return TRUE;
+}
+
+//------------------------------------------------------------------------
+// updateSkeleton()
+// Runs the motions and poses the skeleton.  When queued this is called
+// from the task scheduler threads, so it must only touch this avatar.
+// Visual param changes from the motions (blinks, hand poses, emotes) are
+// held for endUpdateCharacter(), see LLCharacter::requestVisualParamsUpdate().
+//------------------------------------------------------------------------
+void LLVOAvatar::updateSkeleton()
+{
+	// update animations
+	evaluateMotions();
 
 	// update head position
 	updateHeadOffset();
 
+	mRoot.updateWorldMatrixChildren();
+
+	// with morphs about to change, dirtyMesh() will have the meshes
+	// skinned again at render time anyway
+	if (mSkinInUpdate && !isVisualParamsUpdatePending())
+	{
+		skinMeshes();
+	}
+}
+
+//------------------------------------------------------------------------
+// endUpdateCharacter()
+// Everything after the skeleton is posed.
+//------------------------------------------------------------------------
+void LLVOAvatar::endUpdateCharacter()
+{
+	endUpdateMotions();
+
 	//-------------------------------------------------------------------------
 	// Find the ground under each foot, these are used for a variety
 	// of things that follow
 	//-------------------------------------------------------------------------
+	LLVector3 normal;
 	LLVector3 ankle_left_pos_agent = mFootLeftp->getWorldPosition();
 	LLVector3 ankle_right_pos_agent = mFootRightp->getWorldPosition();
 
@@ -3460,8 +3602,6 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 		}
 	}
 
-	mRoot.updateWorldMatrixChildren();
-
 	if (!mDebugText.size() && mText.notNull())
 	{
 		mText->markDead();
@@ -3472,10 +3612,18 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 		setDebugText(mDebugText);
 	}
 
-	//mesh vertices need to be reskinned
-	mNeedsSkin = TRUE;
-
-	return TRUE;
+	if (mSkinInUpdate)
+	{
+		// skinned by updateSkeleton()
+		unmapSkinnedBuffers();
+		mSkinInUpdate = FALSE;
+		mNeedsSkin = FALSE;
+	}
+	else
+	{
+		//mesh vertices need to be reskinned
+		mNeedsSkin = TRUE;
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -3652,6 +3800,87 @@ bool LLVOAvatar::shouldAlphaMask()
 
 }
 
+//-----------------------------------------------------------------------------
+// skinMeshes()
+// Deforms the software skinned meshes.  From updateSkeleton() the
+// vertex buffers have already been mapped by mapSkinnedBuffers().
+//-----------------------------------------------------------------------------
+void LLVOAvatar::skinMeshes()
+{
+	mMeshLOD[MESH_ID_LOWER_BODY]->updateJointGeometry();
+	mMeshLOD[MESH_ID_UPPER_BODY]->updateJointGeometry();
+
+	if( isWearingWearableType( WT_SKIRT ) )
+	{
+		mMeshLOD[MESH_ID_SKIRT]->updateJointGeometry();
+	}
+
+	if (!isSelf() || gAgent.needsRenderHead() || LLPipeline::sShadowRender)
+	{
+		mMeshLOD[MESH_ID_EYELASH]->updateJointGeometry();
+		mMeshLOD[MESH_ID_HEAD]->updateJointGeometry();
+		mMeshLOD[MESH_ID_HAIR]->updateJointGeometry();
+	}
+}
+
+static void map_avatar_face(LLFace* facep, BOOL map)
+{
+	if (facep && facep->mVertexBuffer.notNull())
+	{
+		if (map)
+		{
+			facep->mVertexBuffer->mapBuffer();
+		}
+		else
+		{
+			facep->mVertexBuffer->setBuffer(0);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// mapSkinnedBuffers()
+// Maps the mesh vertex buffers so that skinMeshes() can run off the main
+// thread.  Returns FALSE if the meshes can't be skinned in the update.
+//-----------------------------------------------------------------------------
+BOOL LLVOAvatar::mapSkinnedBuffers()
+{
+	if (!mIsBuilt
+		|| mDirtyMesh
+		|| mDrawable.isNull()
+		|| mDrawable->isState(LLDrawable::REBUILD_GEOMETRY)
+		|| !LLViewerJointMesh::isSkinningThreadSafe()
+		|| LLViewerShaderMgr::instance()->getVertexShaderLevel(LLViewerShaderMgr::SHADER_AVATAR) > 0)
+	{
+		return FALSE;
+	}
+
+	// face 0 plus the per part faces added by updateMeshData()
+	map_avatar_face(mDrawable->getFace(0), TRUE);
+	for (S32 i = llmax(1, mNumInitFaces); i < mDrawable->getNumFaces(); i++)
+	{
+		map_avatar_face(mDrawable->getFace(i), TRUE);
+	}
+	return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// unmapSkinnedBuffers()
+//-----------------------------------------------------------------------------
+void LLVOAvatar::unmapSkinnedBuffers()
+{
+	if (mDrawable.isNull())
+	{
+		return;
+	}
+
+	map_avatar_face(mDrawable->getFace(0), FALSE);
+	for (S32 i = llmax(1, mNumInitFaces); i < mDrawable->getNumFaces(); i++)
+	{
+		map_avatar_face(mDrawable->getFace(i), FALSE);
+	}
+}
+
 //-----------------------------------------------------------------------------
 // renderSkinned()
 //-----------------------------------------------------------------------------
@@ -3677,27 +3906,9 @@ U32 LLVOAvatar::renderSkinned(EAvatarRenderPass pass)
 		if (mNeedsSkin)
 		{
 			//generate animated mesh
-			mMeshLOD[MESH_ID_LOWER_BODY]->updateJointGeometry();
-			mMeshLOD[MESH_ID_UPPER_BODY]->updateJointGeometry();
-
-			if( isWearingWearableType( WT_SKIRT ) )
-			{
-				mMeshLOD[MESH_ID_SKIRT]->updateJointGeometry();
-			}
-
-			if (!isSelf() || gAgent.needsRenderHead() || LLPipeline::sShadowRender)
-			{
-				mMeshLOD[MESH_ID_EYELASH]->updateJointGeometry();
-				mMeshLOD[MESH_ID_HEAD]->updateJointGeometry();
-				mMeshLOD[MESH_ID_HAIR]->updateJointGeometry();
-			}
+			skinMeshes();
 			mNeedsSkin = FALSE;
-			
-			LLVertexBuffer* vb = mDrawable->getFace(0)->mVertexBuffer;
-			if (vb)
-			{
-				vb->setBuffer(0);
-			}
+			unmapSkinnedBuffers();
 		}
 	}
 	else
@@ -5137,7 +5348,11 @@ void LLVOAvatar::updateVisualParams()
 
 	setSex( (getVisualParamWeight( "male" ) > 0.5f) ? SEX_MALE : SEX_FEMALE );
 
-	LLCharacter::updateVisualParams();
+	{
+		// one pass over each mesh for all the morphs that changed
+		LLPolyMorphBatchScope morph_batch(mMorphBatchQueue);
+		LLCharacter::updateVisualParams();
+	}
 
 	if (mLastSkeletonSerialNum != mSkeletonSerialNum)
 	{
@@ -214,6 +214,36 @@ public:
 	void 			idleUpdateRenderCost();
 	void 			idleUpdateTractorBeam();
 	void 			idleUpdateBelowWater();
+protected:
+	// The part of idleUpdate() that follows updateCharacter()
+	void			idleUpdateFinish(BOOL detailed_update, const LLVector3& root_pos_last);
+
+	//--------------------------------------------------------------------
+	// Parallel updates
+	//--------------------------------------------------------------------
+public:
+	// While the queue is open, idleUpdate() of other avatars stops after
+	// beginUpdateCharacter() and queues the avatar.  flushUpdateQueue()
+	// runs updateSkeleton() for all of them on the task scheduler, then
+	// finishes their idle updates in queue order.  MAIN THREAD.
+	static void		openUpdateQueue();
+	static void		flushUpdateQueue();
+protected:
+	// updateCharacter() in three steps.  beginUpdateCharacter() returns
+	// FALSE when there is nothing more to do this frame.  updateSkeleton()
+	// runs the motions, the joint matrices and, when mSkinInUpdate is set,
+	// CPU skinning into buffers mapped beforehand.  It only writes to this
+	// avatar, so it can run on any thread.
+	BOOL			beginUpdateCharacter(LLAgent &agent);
+	void			updateSkeleton();
+	void			endUpdateCharacter();
+private:
+	class UpdateBody;
+	typedef std::vector<LLPointer<LLVOAvatar> > avatar_vec_t;
+	static avatar_vec_t	sUpdateQueue;
+	static BOOL		sQueueUpdates;
+	LLVector3		mRootPosLast; // root position before the queued update
+	BOOL			mSkinInUpdate;
 
 	//--------------------------------------------------------------------
 	// Static preferences (controlled by user settings/menus)
@@ -350,6 +380,11 @@ public:
 	S32			mSpecialRenderMode; // special lighting
 private:
 	bool		shouldAlphaMask();
+	// CPU skinning of the LOD meshes.  The vertex buffers are mapped and
+	// unmapped around it, on the main thread.
+	void		skinMeshes();
+	BOOL		mapSkinnedBuffers();
+	void		unmapSkinnedBuffers();
 
 	BOOL 		mNeedsSkin; // avatar has been animated and verts have not been updated
 	S32	 		mUpdatePeriod;
@@ -362,6 +397,10 @@ public:
 	BOOL 		morphMaskNeedsUpdate(LLVOAvatarDefines::EBakedTextureIndex index = LLVOAvatarDefines::BAKED_NUM_INDICES);
 	void 		addMaskedMorph(LLVOAvatarDefines::EBakedTextureIndex index, LLPolyMorphTarget* morph_target, BOOL invert, std::string layer);
 	void 		applyMorphMask(U8* tex_data, S32 width, S32 height, S32 num_components, LLVOAvatarDefines::EBakedTextureIndex index = LLVOAvatarDefines::BAKED_NUM_INDICES);
+	// morph changes to this avatar's meshes held by an LLPolyMorphBatchScope
+	LLPolyMorphBatchQueue& getMorphBatchQueue() { return mMorphBatchQueue; }
+private:
+	LLPolyMorphBatchQueue mMorphBatchQueue;
 
 	//--------------------------------------------------------------------
 	// Visibility
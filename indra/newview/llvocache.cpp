@@ -51,6 +51,7 @@ LLVOCacheEntry::LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &
 	mBuffer = new U8[dp.getBufferSize()];
 	mDP.assignBuffer(mBuffer, dp.getBufferSize());
 	mDP = dp;
+	mDirty = TRUE;
 }
 
 LLVOCacheEntry::LLVOCacheEntry()
@@ -62,45 +63,21 @@ LLVOCacheEntry::LLVOCacheEntry()
 	mCRCChangeCount = 0;
 	mBuffer = NULL;
 	mDP.assignBuffer(mBuffer, 0);
+	mDirty = FALSE;
 }
 
 
-static inline void checkedRead(LLFILE *fp, void *data, size_t nbytes)
+LLVOCacheEntry::LLVOCacheEntry(const LLObjectCacheFile::Record& record, const U8* data)
 {
-	if (fread(data, 1, nbytes, fp) != nbytes)
-	{
-		llwarns << "Short read" << llendl;
-		memset(data, 0, nbytes);
-	}
-}
-
-LLVOCacheEntry::LLVOCacheEntry(LLFILE *fp)
-{
-	S32 size;
-	checkedRead(fp, &mLocalID, sizeof(U32));
-	checkedRead(fp, &mCRC, sizeof(U32));
-	checkedRead(fp, &mHitCount, sizeof(S32));
-	checkedRead(fp, &mDupeCount, sizeof(S32));
-	checkedRead(fp, &mCRCChangeCount, sizeof(S32));
-
-	checkedRead(fp, &size, sizeof(S32));
-
-	// Corruption in the cache entries
-	if ((size > 10000) || (size < 1))
-	{
-		// We've got a bogus size, skip reading it.
-		// We won't bother seeking, because the rest of this file
-		// is likely bogus, and will be tossed anyway.
-		llwarns << "Bogus cache entry, size " << size << ", aborting!" << llendl;
-		mLocalID = 0;
-		mCRC = 0;
-		mBuffer = NULL;
-		return;
-	}
-
-	mBuffer = new U8[size];
-	checkedRead(fp, mBuffer, size);
-	mDP.assignBuffer(mBuffer, size);
+	mLocalID = record.mLocalID;
+	mCRC = record.mCRC;
+	mHitCount = record.mHitCount;
+	mDupeCount = record.mDupeCount;
+	mCRCChangeCount = record.mCRCChangeCount;
+	mBuffer = new U8[record.mSize];
+	memcpy(mBuffer, data, record.mSize);
+	mDP.assignBuffer(mBuffer, record.mSize);
+	mDirty = FALSE;
 }
 
 LLVOCacheEntry::~LLVOCacheEntry()
@@ -123,6 +100,7 @@ void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
 		mBuffer = new U8[dp.getBufferSize()];
 		mDP.assignBuffer(mBuffer, dp.getBufferSize());
 		mDP = dp;
+		mDirty = TRUE;
 	}
 }
 
@@ -155,22 +133,13 @@ void LLVOCacheEntry::dump() const
 		<< llendl;
 }
 
-static inline void checkedWrite(LLFILE *fp, const void *data, size_t nbytes)
-{
-	if (fwrite(data, 1, nbytes, fp) != nbytes)
-	{
-		llwarns << "Short write" << llendl;
-	}
-}
-
-void LLVOCacheEntry::writeToFile(LLFILE *fp) const
+void LLVOCacheEntry::getCacheFileEntry(LLObjectCacheFile::Entry& entry) const
 {
-	checkedWrite(fp, &mLocalID, sizeof(U32));
-	checkedWrite(fp, &mCRC, sizeof(U32));
-	checkedWrite(fp, &mHitCount, sizeof(S32));
-	checkedWrite(fp, &mDupeCount, sizeof(S32));
-	checkedWrite(fp, &mCRCChangeCount, sizeof(S32));
-	S32 size = mDP.getBufferSize();
-	checkedWrite(fp, &size, sizeof(S32));
-	checkedWrite(fp, mBuffer, size);
+	entry.mRecord.mLocalID = mLocalID;
+	entry.mRecord.mCRC = mCRC;
+	entry.mRecord.mHitCount = mHitCount;
+	entry.mRecord.mDupeCount = mDupeCount;
+	entry.mRecord.mCRCChangeCount = mCRCChangeCount;
+	entry.mRecord.mSize = mDP.getBufferSize();
+	entry.mData = mBuffer;
 }
@@ -37,6 +37,7 @@
 #include "lluuid.h"
 #include "lldatapacker.h"
 #include "lldlinked.h"
+#include "llobjectcachefile.h"
 
 
 //---------------------------------------------------------------------------
@@ -47,7 +48,7 @@ class LLVOCacheEntry : public LLDLinked<LLVOCacheEntry>
 {
 public:
 	LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
-	LLVOCacheEntry(LLFILE *fp);
+	LLVOCacheEntry(const LLObjectCacheFile::Record& record, const U8* data);
 	LLVOCacheEntry();
 	~LLVOCacheEntry();
 
@@ -55,9 +56,12 @@ public:
 	U32 getCRC() const				{ return mCRC; }
 	S32 getHitCount() const			{ return mHitCount; }
 	S32 getCRCChangeCount() const	{ return mCRCChangeCount; }
+	// TRUE if the data is newer than the region's cache file.
+	BOOL isDirty() const			{ return mDirty; }
 
 	void dump() const;
-	void writeToFile(LLFILE *fp) const;
+	// Fills entry for LLObjectCacheFile::save(), pointing at our buffer.
+	void getCacheFileEntry(LLObjectCacheFile::Entry& entry) const;
 	void assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp);
 	LLDataPackerBinaryBuffer *getDP(U32 crc);
 	void recordHit();
@@ -71,6 +75,7 @@ protected:
 	S32							mCRCChangeCount;
 	LLDataPackerBinaryBuffer	mDP;
 	U8							*mBuffer;
+	BOOL						mDirty;
 };
 
 #endif
@@ -188,6 +188,7 @@ LLVOVolume::LLVOVolume(const LLUUID &id, const LLPCode pcode, LLViewerRegion *re
 	mVObjRadius = LLVector3(1,1,0.5f).length();
 	mNumFaces = 0;
 	mLODChanged = FALSE;
+	mLODPending = FALSE;
 	mSculptChanged = FALSE;
 	mSpotLightPriority = 0.f;
 
@@ -930,7 +931,10 @@ BOOL LLVOVolume::setVolume(const LLVolumeParams &volume_params, const S32 detail
 		}
 	}
 	
-	if ((LLPrimitive::setVolume(volume_params, mLOD, (mVolumeImpl && mVolumeImpl->isVolumeUnique()))) || mSculptChanged)
+	bool unique = mVolumeImpl && mVolumeImpl->isVolumeUnique();
+	S32 lod = unique ? mLOD : getReadyLOD(volume_params);
+
+	if ((LLPrimitive::setVolume(volume_params, lod, unique)) || mSculptChanged)
 	{
 		mFaceMappingChanged = TRUE;
 		
@@ -956,6 +960,24 @@ BOOL LLVOVolume::setVolume(const LLVolumeParams &volume_params, const S32 detail
 	return FALSE;
 }
 
+// Returns the LOD to show while mLOD is generated in the background.
+// With no volume of these params ready yet mLOD is built right away.
+S32 LLVOVolume::getReadyLOD(const LLVolumeParams& volume_params)
+{
+	LLVolumeMgr* volume_manager = LLPrimitive::getVolumeManager();
+	if (!volume_manager->hasGenerateThread())
+	{
+		return mLOD;
+	}
+	S32 lod = volume_manager->requestVolume(volume_params, mLOD);
+	if (lod < 0)
+	{
+		lod = mLOD;
+	}
+	mLODPending = (lod != mLOD);
+	return lod;
+}
+
 void LLVOVolume::updateSculptTexture()
 {
 	LLPointer<LLViewerFetchedTexture> old_sculpt = mSculptTexture;
@@ -1132,6 +1154,14 @@ BOOL LLVOVolume::updateLOD()
 	
 	BOOL lod_changed = calcLOD();
 
+	if (!lod_changed && mLODPending &&
+		LLPrimitive::getVolumeManager()->isVolumeReady(getVolume()->getParams(), mLOD))
+	{
+		// the LOD we asked for has been generated, swap it in
+		mLODPending = FALSE;
+		lod_changed = TRUE;
+	}
+
 	if (lod_changed)
 	{
 		gPipeline.markRebuild(mDrawable, LLDrawable::REBUILD_VOLUME, FALSE);
@@ -1521,11 +1551,11 @@ void LLVOVolume::updateFaceSize(S32 idx)
 		const LLVolumeFace& vol_face = getVolume()->getVolumeFace(idx);
 		if (LLPipeline::sUseTriStrips)
 		{
-			facep->setSize(vol_face.mVertices.size(), vol_face.mTriStrip.size());
+			facep->setSize(vol_face.getNumVertices(), vol_face.mTriStrip.size());
 		}
 		else
 		{
-			facep->setSize(vol_face.mVertices.size(), vol_face.mIndices.size());
+			facep->setSize(vol_face.getNumVertices(), vol_face.mIndices.size());
 		}
 	}
 }
@@ -1786,9 +1816,9 @@ LLVector3 LLVOVolume::getApproximateFaceNormal(U8 face_id)
 	if (volume && face_id < volume->getNumVolumeFaces())
 	{
 		const LLVolumeFace& face = volume->getVolumeFace(face_id);
-		for (S32 i = 0; i < (S32)face.mVertices.size(); ++i)
+		for (S32 i = 0; i < face.getNumVertices(); ++i)
 		{
-			result += face.mVertices[i].mNormal;
+			result += face.getNormal(i);
 		}
 
 		result = volumeDirectionToAgent(result);
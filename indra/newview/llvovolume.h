@@ -278,6 +278,7 @@ public:
 protected:
 	S32	computeLODDetail(F32	distance, F32 radius);
 	BOOL calcLOD();
+	S32 getReadyLOD(const LLVolumeParams& volume_params);
 	LLFace* addFace(S32 face_index);
 	void updateTEData();
 
@@ -295,6 +296,7 @@ private:
 	LLFrameTimer mTextureUpdateTimer;
 	S32			mLOD;
 	BOOL		mLODChanged;
+	BOOL		mLODPending;	// showing another LOD until mLOD is generated
 	BOOL		mSculptChanged;
 	F32			mSpotLightPriority;
 	LLMatrix4	mRelativeXform;
@@ -364,6 +364,8 @@ void LLPipeline::init()
 	sRenderAttachedLights = gSavedSettings.getBOOL("RenderAttachedLights");
 	sRenderAttachedParticles = gSavedSettings.getBOOL("RenderAttachedParticles");
 
+	LLFrustumCuller::setVectorize(true);
+
 	mInitialized = TRUE;
 	
 	stop_glerror();
@@ -0,0 +1,462 @@
+/** 
+ * @file llinventorycache_test.cpp
+ * @brief Test cases for LLInventoryCache.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llinventorycache.h"
+// Dependencies
+#include "llinventory.h"
+#include "lltimer.h"
+
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Notes: 
+// * Add here stubbed implementation of the few classes and methods used in the class to be tested
+// * Add as little as possible (let the link errors guide you)
+// * Do not make any assumption as to how those classes or methods work (i.e. don't copy/paste code)
+// * A simulator for a class can be implemented here. Please comment and document thoroughly.
+
+class TestItemFactory : public LLInventoryCache::ItemFactory
+{
+public:
+	/*virtual*/ LLInventoryItem* createItem() { return new LLInventoryItem(); }
+};
+
+// A made up inventory: categories, with items in all but the first
+struct TestInventory
+{
+	TestInventory(U32 num_categories, U32 items_per_category)
+	{
+		LLUUID owner;
+		owner.generate();
+		LLUUID root_id;
+		for (U32 c = 0; c < num_categories; c++)
+		{
+			LLInventoryCache::Category cat;
+			cat.mID.generate();
+			cat.mParentID = root_id;
+			cat.mOwnerID = owner;
+			cat.mPreferredType = c ? LLFolderType::FT_NONE : LLFolderType::FT_ROOT_INVENTORY;
+			cat.mVersion = 10 + c;
+			cat.mName = llformat("Folder %d", c);
+			if (!c)
+			{
+				root_id = cat.mID;
+				continue;
+			}
+			mCategories.push_back(cat);
+			for (U32 i = 0; i < items_per_category; i++)
+			{
+				addItem(cat.mID, owner, i);
+			}
+		}
+		// the root last, to check the order categories come in does not matter
+		LLInventoryCache::Category root;
+		root.mID = root_id;
+		root.mOwnerID = owner;
+		root.mPreferredType = LLFolderType::FT_ROOT_INVENTORY;
+		root.mVersion = 3;
+		root.mName = "My Inventory";
+		mCategories.push_back(root);
+	}
+
+	void addItem(const LLUUID& parent_id, const LLUUID& owner, U32 i)
+	{
+		LLUUID id, creator, asset_id, group;
+		id.generate();
+		creator.generate();
+		asset_id.generate();
+		bool group_owned = (i % 7 == 3);
+		if (group_owned)
+		{
+			group.generate();
+		}
+		LLPermissions perm;
+		perm.init(creator, owner, creator, group);
+		perm.initMasks(i % 2 ? PERM_ALL : PERM_ITEM_UNRESTRICTED | PERM_MOVE,
+					   PERM_ALL, PERM_NONE, PERM_COPY, PERM_MOVE | PERM_TRANSFER);
+		if (group_owned)
+		{
+			perm.setOwnerAndGroup(owner, group, group, true);
+		}
+		LLPointer<LLInventoryItem> item = new LLInventoryItem(
+			id, parent_id, perm, (i % 5 == 4) ? LLUUID::null : asset_id,
+			(i % 3) ? LLAssetType::AT_OBJECT : LLAssetType::AT_NOTECARD,
+			(i % 3) ? LLInventoryType::IT_OBJECT : LLInventoryType::IT_NOTECARD,
+			llformat("Item %d", i), (i % 4) ? llformat("Description of item %d", i) : std::string(),
+			LLSaleInfo((i % 6) ? LLSaleInfo::FS_NOT : LLSaleInfo::FS_COPY, (S32)i),
+			i * 3, 1262304000 + (S32)i);
+		mItems.push_back(item);
+	}
+
+	LLInventoryCache::item_ptr_list_t getItemPtrs() const
+	{
+		LLInventoryCache::item_ptr_list_t ptrs;
+		for (U32 i = 0; i < mItems.size(); i++)
+		{
+			ptrs.push_back(mItems[i].get());
+		}
+		return ptrs;
+	}
+
+	std::set<LLUUID> getCategoryIDs() const
+	{
+		std::set<LLUUID> ids;
+		for (U32 i = 0; i < mCategories.size(); i++)
+		{
+			ids.insert(mCategories[i].mID);
+		}
+		return ids;
+	}
+
+	LLInventoryCache::category_list_t mCategories;
+	std::vector<LLPointer<LLInventoryItem> > mItems;
+};
+
+bool same_item(const LLInventoryItem& a, const LLInventoryItem& b)
+{
+	return a.getUUID() == b.getUUID()
+		&& a.getParentUUID() == b.getParentUUID()
+		&& a.getPermissions() == b.getPermissions()
+		&& a.getAssetUUID() == b.getAssetUUID()
+		&& a.getType() == b.getType()
+		&& a.getInventoryType() == b.getInventoryType()
+		&& a.getName() == b.getName()
+		&& a.getDescription() == b.getDescription()
+		&& a.getSaleInfo() == b.getSaleInfo()
+		&& a.getFlags() == b.getFlags()
+		&& a.getCreationDate() == b.getCreationDate();
+}
+
+// End Stubbing
+// -------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+
+namespace tut
+{
+	// Test wrapper declarations
+	struct inventorycache_test
+	{
+		inventorycache_test()
+		{
+			mFileName = std::string(LLFile::tmpdir()) + llformat("llinventorycache_test_%d.invb", (S32)LLUUID::getRandomSeed() & 0xffff);
+			LLFile::remove(mFileName);
+		}
+		~inventorycache_test()
+		{
+			LLFile::remove(mFileName);
+		}
+
+		// Loads the file into a fresh cache and checks it holds inventory
+		void checkLoad(const char* msg, const TestInventory& inventory)
+		{
+			LLInventoryCache cache;
+			ensure_equals(msg, cache.load(mFileName, CACHE_VERSION), LLInventoryCache::STATUS_OK);
+			ensure_equals(msg, cache.getCategories().size(), inventory.mCategories.size());
+
+			std::map<LLUUID, const LLInventoryCache::Category*> categories;
+			for (U32 i = 0; i < inventory.mCategories.size(); i++)
+			{
+				categories[inventory.mCategories[i].mID] = &inventory.mCategories[i];
+			}
+			for (U32 i = 0; i < cache.getCategories().size(); i++)
+			{
+				const LLInventoryCache::Category& cat = cache.getCategories()[i];
+				ensure(msg, categories.count(cat.mID) == 1);
+				const LLInventoryCache::Category& expected = *categories[cat.mID];
+				ensure(msg, cat.mParentID == expected.mParentID);
+				ensure(msg, cat.mOwnerID == expected.mOwnerID);
+				ensure_equals(msg, cat.mPreferredType, expected.mPreferredType);
+				ensure_equals(msg, cat.mVersion, expected.mVersion);
+				ensure_equals(msg, cat.mName, expected.mName);
+			}
+
+			TestItemFactory factory;
+			LLInventoryCache::item_list_t items;
+			cache.getItems(inventory.getCategoryIDs(), factory, items);
+			ensure_equals(msg, items.size(), inventory.mItems.size());
+
+			std::map<LLUUID, const LLInventoryItem*> expected_items;
+			for (U32 i = 0; i < inventory.mItems.size(); i++)
+			{
+				expected_items[inventory.mItems[i]->getUUID()] = inventory.mItems[i].get();
+			}
+			for (U32 i = 0; i < items.size(); i++)
+			{
+				ensure(msg, items[i].notNull());
+				ensure(msg, expected_items.count(items[i]->getUUID()) == 1);
+				ensure(msg, same_item(*items[i], *expected_items[items[i]->getUUID()]));
+			}
+		}
+
+		enum { CACHE_VERSION = 2 };
+		std::string mFileName;
+	};
+
+	// Tut templating thingamagic: test group, object and test instance
+	typedef test_group<inventorycache_test> inventorycache_t;
+	typedef inventorycache_t::object inventorycache_object_t;
+	tut::inventorycache_t tut_inventorycache("inventorycache");
+
+	// ---------------------------------------------------------------------------------------
+	// Test functions
+	// Notes:
+	// * Test as many as you possibly can without requiring a full blown simulation of everything
+	// * The tests are executed in sequence so the test instance state may change between calls
+	// * Remember that you cannot test private methods with tut
+	// ---------------------------------------------------------------------------------------
+
+	// Item records keep every field
+	template<> template<>
+	void inventorycache_object_t::test<1>()
+	{
+		TestInventory inventory(2, 42);
+		for (U32 i = 0; i < inventory.mItems.size(); i++)
+		{
+			std::vector<U8> record;
+			LLInventoryCache::encodeItem(*inventory.mItems[i], record);
+			LLPointer<LLInventoryItem> item = new LLInventoryItem();
+			ensure("decoded", LLInventoryCache::decodeItem(&record[0], record.size(), *item));
+			ensure("same item", same_item(*item, *inventory.mItems[i]));
+			ensure_not("short record", LLInventoryCache::decodeItem(&record[0], record.size() - 1, *item));
+		}
+	}
+
+	// Saving and loading, all categories and some
+	template<> template<>
+	void inventorycache_object_t::test<2>()
+	{
+		LLInventoryCache cache;
+		ensure_equals("no file", cache.load(mFileName, CACHE_VERSION), LLInventoryCache::STATUS_NOT_FOUND);
+
+		TestInventory inventory(40, 25);
+		ensure("saved", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+		ensure("first save rewrites", cache.getLastSaveRewrote());
+		checkLoad("round trip", inventory);
+
+		ensure_equals("loaded", cache.load(mFileName, CACHE_VERSION), LLInventoryCache::STATUS_OK);
+		ensure_equals("item count", cache.getItemCount(inventory.mCategories[5].mID), 25U);
+		ensure_equals("unknown category", cache.getItemCount(LLUUID::generateNewID()), 0U);
+
+		std::set<LLUUID> some;
+		some.insert(inventory.mCategories[5].mID);
+		some.insert(inventory.mCategories[17].mID);
+		TestItemFactory factory;
+		LLInventoryCache::item_list_t items;
+		cache.getItems(some, factory, items);
+		ensure_equals("some items", items.size(), 50U);
+		for (U32 i = 0; i < items.size(); i++)
+		{
+			ensure("in a requested category", some.count(items[i]->getParentUUID()) == 1);
+		}
+
+		// items whose parent is not cached are left out
+		TestInventory orphans(3, 4);
+		LLInventoryCache::item_ptr_list_t ptrs = inventory.getItemPtrs();
+		ptrs.push_back(orphans.mItems[0].get());
+		ensure("saved with orphan", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, ptrs));
+		ensure_equals("orphan not written", cache.getLastSaveSize(), 0U);
+	}
+
+	// Changes are appended as deltas
+	template<> template<>
+	void inventorycache_object_t::test<3>()
+	{
+		LLInventoryCache cache;
+		TestInventory inventory(200, 20);
+		ensure("saved", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+		U32 base_size = cache.getLastSaveSize();
+
+		// nothing changed, nothing written
+		ensure("saved unchanged", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+		ensure_equals("unchanged size", cache.getLastSaveSize(), 0U);
+
+		// one renamed item, one new item, one version bump
+		inventory.mItems[30]->rename("Renamed");
+		inventory.addItem(inventory.mCategories[7].mID, inventory.mCategories[7].mOwnerID, 99);
+		inventory.mCategories[9].mVersion++;
+		ensure("saved changes", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+		ensure_not("delta", cache.getLastSaveRewrote());
+		ensure("delta is small", cache.getLastSaveSize() * 20 < base_size);
+		checkLoad("after delta", inventory);
+
+		// a category goes away with its items
+		LLUUID gone = inventory.mCategories[11].mID;
+		inventory.mCategories.erase(inventory.mCategories.begin() + 11);
+		std::vector<LLPointer<LLInventoryItem> > kept;
+		for (U32 i = 0; i < inventory.mItems.size(); i++)
+		{
+			if (inventory.mItems[i]->getParentUUID() != gone)
+			{
+				kept.push_back(inventory.mItems[i]);
+			}
+		}
+		inventory.mItems.swap(kept);
+		ensure("saved removal", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+		ensure_not("removal delta", cache.getLastSaveRewrote());
+		checkLoad("after removal", inventory);
+
+		ensure_equals("loaded", cache.load(mFileName, CACHE_VERSION), LLInventoryCache::STATUS_OK);
+		ensure_equals("segments", cache.getSegmentCount(), 3U);
+	}
+
+	// Deltas are compacted into a new base once they grow
+	template<> template<>
+	void inventorycache_object_t::test<4>()
+	{
+		LLInventoryCache cache;
+		TestInventory inventory(50, 10);
+		ensure("saved", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+
+		bool rewrote = false;
+		for (U32 i = 0; i < 50 && !rewrote; i++)
+		{
+			inventory.mItems[i * 7 % inventory.mItems.size()]->rename(llformat("Pass %d", i));
+			inventory.mCategories[i % 10].mVersion++;
+			ensure("saved pass", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+			rewrote = cache.getLastSaveRewrote();
+		}
+		ensure("compacted", rewrote);
+		checkLoad("after compaction", inventory);
+
+		ensure_equals("loaded", cache.load(mFileName, CACHE_VERSION), LLInventoryCache::STATUS_OK);
+		ensure_equals("one segment", cache.getSegmentCount(), 1U);
+	}
+
+	// A torn last segment is ignored, another cache version is obsolete
+	template<> template<>
+	void inventorycache_object_t::test<5>()
+	{
+		LLInventoryCache cache;
+		TestInventory inventory(30, 10);
+		ensure("saved", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+		std::string name = inventory.mItems[3]->getName();
+		inventory.mItems[3]->rename("Lost");
+		ensure("saved delta", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+		U32 delta_size = cache.getLastSaveSize();
+
+		// cut the delta short, as a crash during the write would
+		llstat stat_data;
+		ensure_equals("stat", LLFile::stat(mFileName, &stat_data), 0);
+		S32 size = (S32)stat_data.st_size;
+		std::vector<U8> data(size);
+		LLFILE* fp = LLFile::fopen(mFileName, "rb");
+		ensure("read", fp && fread(&data[0], 1, size, fp) == (size_t)size);
+		fclose(fp);
+		fp = LLFile::fopen(mFileName, "wb");
+		ensure("write", fp && fwrite(&data[0], 1, size - delta_size / 2, fp) == (size_t)(size - delta_size / 2));
+		fclose(fp);
+
+		inventory.mItems[3]->rename(name);
+		checkLoad("torn delta", inventory);
+
+		// the next save rewrites the damaged file
+		ensure("saved over torn", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+		ensure("rewrote torn", cache.getLastSaveRewrote());
+		checkLoad("rewritten", inventory);
+
+		ensure_equals("obsolete", cache.load(mFileName, CACHE_VERSION + 1), LLInventoryCache::STATUS_OBSOLETE);
+	}
+
+	// Loading a large inventory, against the text format the legacy
+	// cache writes
+	template<> template<>
+	void inventorycache_object_t::test<6>()
+	{
+		const U32 NUM_CATEGORIES = 2000;
+		const U32 ITEMS_PER_CATEGORY = 50;
+		TestInventory inventory(NUM_CATEGORIES, ITEMS_PER_CATEGORY);
+		std::string text_name = mFileName + ".inv";
+
+		LLTimer timer;
+		LLFILE* fp = LLFile::fopen(text_name, "wb");
+		ensure("text file", fp != NULL);
+		for (U32 i = 0; i < inventory.mItems.size(); i++)
+		{
+			inventory.mItems[i]->exportFile(fp);
+		}
+		fclose(fp);
+		F64 text_save = timer.getElapsedTimeAndResetF64();
+
+		std::vector<LLPointer<LLInventoryItem> > text_items;
+		fp = LLFile::fopen(text_name, "rb");
+		ensure("text file", fp != NULL);
+		char buffer[MAX_STRING];
+		char keyword[MAX_STRING];
+		while (fgets(buffer, MAX_STRING, fp))
+		{
+			if (sscanf(buffer, " %254s", keyword) == 1 && !strcmp(keyword, "inv_item"))
+			{
+				LLPointer<LLInventoryItem> item = new LLInventoryItem();
+				item->importFile(fp);
+				text_items.push_back(item);
+			}
+		}
+		fclose(fp);
+		F64 text_load = timer.getElapsedTimeAndResetF64();
+		LLFile::remove(text_name);
+
+		LLInventoryCache cache;
+		ensure("saved", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+		F64 binary_save = timer.getElapsedTimeAndResetF64();
+
+		LLInventoryCache loaded;
+		ensure_equals("loaded", loaded.load(mFileName, CACHE_VERSION), LLInventoryCache::STATUS_OK);
+		F64 binary_index = timer.getElapsedTimeF64();
+		TestItemFactory factory;
+		LLInventoryCache::item_list_t items;
+		loaded.getItems(inventory.getCategoryIDs(), factory, items);
+		F64 binary_load = timer.getElapsedTimeAndResetF64();
+
+		inventory.mItems[1000]->rename("Changed");
+		ensure("saved delta", cache.save(mFileName, CACHE_VERSION, inventory.mCategories, inventory.getItemPtrs()));
+		F64 binary_delta = timer.getElapsedTimeF64();
+
+		llinfos << "LLInventoryCache: " << inventory.mItems.size() << " items in " << NUM_CATEGORIES
+			<< " categories.  text save: " << text_save << "s load: " << text_load
+			<< "s.  binary save: " << binary_save << "s load: " << binary_load
+			<< "s (index " << binary_index << "s) delta save: " << binary_delta
+			<< "s, " << cache.getLastSaveSize() << " bytes" << llendl;
+
+		ensure_equals("text items", text_items.size(), inventory.mItems.size());
+		ensure_equals("binary items", items.size(), inventory.mItems.size());
+	}
+}
@@ -0,0 +1,448 @@
+/** 
+ * @file llpolymorphbatch_test.cpp
+ * @brief Test cases for LLPolyMorphBatch.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ * 
+ * Copyright (c) 2010, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlife.com/developers/opensource/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlife.com/developers/opensource/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ * 
+ */
+
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llpolymorphbatch.h"
+// Dependencies
+#include "lltimer.h"
+#include "v2math.h"
+#include "v3math.h"
+#include "v4math.h"
+
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Notes: 
+// * Add here stubbed implementation of the few classes and methods used in the class to be tested
+// * Add as little as possible (let the link errors guide you)
+// * Do not make any assumption as to how those classes or methods work (i.e. don't copy/paste code)
+// * A simulator for a class can be implemented here. Please comment and document thoroughly.
+
+// The SSE2 kernels only promise bit-exact results where the scalar code
+// does its float math in SSE registers too.
+#if defined(__x86_64__) || defined(_M_X64)
+const F32 SSE2_TOLERANCE = 0.f;
+#else
+const F32 SSE2_TOLERANCE = 1.0e-5f;
+#endif
+
+// Repeatable pseudo random numbers in [-1, 1)
+class TestRand
+{
+public:
+	TestRand(U32 seed) : mState(seed) {}
+	F32 next()
+	{
+		mState = mState * 1664525 + 1013904223;
+		return (F32)(mState >> 8) / (F32)(1 << 23) - 1.f;
+	}
+private:
+	U32 mState;
+};
+
+// The morphable arrays of an LLPolyMesh
+struct TestMesh
+{
+	TestMesh(U32 num_vertices, U32 seed)
+		: mCoords(num_vertices), mScaledNormals(num_vertices), mNormals(num_vertices),
+		  mScaledBinormals(num_vertices), mBinormals(num_vertices), mTexCoords(num_vertices),
+		  mClothingWeights(num_vertices)
+	{
+		TestRand rand(seed);
+		for (U32 v = 0; v < num_vertices; v++)
+		{
+			mCoords[v].setVec(rand.next(), rand.next(), rand.next());
+			mScaledNormals[v].setVec(rand.next(), rand.next(), rand.next());
+			mNormals[v] = mScaledNormals[v];
+			mNormals[v].normVec();
+			mScaledBinormals[v].setVec(rand.next(), rand.next(), rand.next());
+			mBinormals[v] = mScaledBinormals[v];
+			mBinormals[v].normVec();
+			mTexCoords[v].setVec(rand.next(), rand.next());
+			mClothingWeights[v].clearVec();
+		}
+	}
+
+	LLPolyMorphBatch::Target getTarget()
+	{
+		LLPolyMorphBatch::Target target;
+		target.mNumVertices = (U32)mCoords.size();
+		target.mCoords = &mCoords[0];
+		target.mScaledNormals = &mScaledNormals[0];
+		target.mNormals = &mNormals[0];
+		target.mScaledBinormals = &mScaledBinormals[0];
+		target.mBinormals = &mBinormals[0];
+		target.mTexCoords = &mTexCoords[0];
+		target.mClothingWeights = &mClothingWeights[0];
+		return target;
+	}
+
+	std::vector<LLVector3> mCoords;
+	std::vector<LLVector3> mScaledNormals;
+	std::vector<LLVector3> mNormals;
+	std::vector<LLVector3> mScaledBinormals;
+	std::vector<LLVector3> mBinormals;
+	std::vector<LLVector2> mTexCoords;
+	std::vector<LLVector4> mClothingWeights;
+};
+
+// The vertex deltas of an LLPolyMorphData
+struct TestMorph
+{
+	TestMorph(U32 num_indices, U32 num_vertices, U32 seed)
+		: mIndices(num_indices), mCoords(num_indices), mNormals(num_indices),
+		  mBinormals(num_indices), mTexCoords(num_indices), mMaskWeights(num_indices)
+	{
+		TestRand rand(seed);
+		// increasing, as in the .llm files, with gaps
+		U32 vertex = 0;
+		for (U32 i = 0; i < num_indices; i++)
+		{
+			vertex += 1 + (U32)((rand.next() + 1.f) * 0.5f * (F32)((num_vertices - vertex) / (num_indices - i) - 1));
+			mIndices[i] = vertex - 1;
+			mCoords[i].setVec(rand.next(), rand.next(), rand.next());
+			mNormals[i].setVec(rand.next(), rand.next(), rand.next());
+			mBinormals[i].setVec(rand.next(), rand.next(), rand.next());
+			mTexCoords[i].setVec(rand.next(), rand.next());
+			mMaskWeights[i] = (rand.next() + 1.f) * 0.5f;
+		}
+		mStreams.init(num_indices, &mIndices[0], &mCoords[0], &mNormals[0], &mBinormals[0], &mTexCoords[0]);
+	}
+
+	std::vector<U32> mIndices;
+	std::vector<LLVector3> mCoords;
+	std::vector<LLVector3> mNormals;
+	std::vector<LLVector3> mBinormals;
+	std::vector<LLVector2> mTexCoords;
+	std::vector<F32> mMaskWeights;
+	LLPolyMorphStreams mStreams;
+};
+
+// LLPolyMorphTarget::apply() as it was before batching: the reference
+// the batched results are checked against.
+void apply_morph_reference(TestMesh& mesh, const TestMorph& morph, F32 delta_weight, const F32* maskWeightArray, BOOL clothing)
+{
+	for(U32 vert_index_morph = 0; vert_index_morph < morph.mIndices.size(); vert_index_morph++)
+	{
+		S32 vert_index_mesh = morph.mIndices[vert_index_morph];
+
+		F32 maskWeight = 1.f;
+		if (maskWeightArray)
+		{
+			maskWeight = maskWeightArray[vert_index_morph];
+		}
+
+		mesh.mCoords[vert_index_mesh] += morph.mCoords[vert_index_morph] * delta_weight * maskWeight;
+		if (clothing)
+		{
+			LLVector3 clothing_offset = morph.mCoords[vert_index_morph] * delta_weight * maskWeight;
+			LLVector4* clothing_weight = &mesh.mClothingWeights[vert_index_mesh];
+			clothing_weight->mV[VX] += clothing_offset.mV[VX];
+			clothing_weight->mV[VY] += clothing_offset.mV[VY];
+			clothing_weight->mV[VZ] += clothing_offset.mV[VZ];
+			clothing_weight->mV[VW] = maskWeight;
+		}
+
+		// calculate new normals based on half angles
+		mesh.mScaledNormals[vert_index_mesh] += morph.mNormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
+		LLVector3 normalized_normal = mesh.mScaledNormals[vert_index_mesh];
+		normalized_normal.normVec();
+		mesh.mNormals[vert_index_mesh] = normalized_normal;
+
+		// calculate new binormals
+		mesh.mScaledBinormals[vert_index_mesh] += morph.mBinormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
+		LLVector3 tangent = mesh.mScaledBinormals[vert_index_mesh] % normalized_normal;
+		LLVector3 normalized_binormal = normalized_normal % tangent; 
+		normalized_binormal.normVec();
+		mesh.mBinormals[vert_index_mesh] = normalized_binormal;
+
+		mesh.mTexCoords[vert_index_mesh] += morph.mTexCoords[vert_index_morph] * delta_weight * maskWeight;
+	}
+}
+
+bool within(F32 a, F32 b, F32 tolerance)
+{
+	return tolerance == 0.f ? a == b : fabsf(a - b) <= tolerance;
+}
+
+// Returns the first vertex where the meshes differ by more than
+// tolerance, or -1.
+S32 compare_meshes(const TestMesh& a, const TestMesh& b, F32 tolerance)
+{
+	for (U32 v = 0; v < a.mCoords.size(); v++)
+	{
+		for (S32 i = 0; i < 3; i++)
+		{
+			if (!within(a.mCoords[v].mV[i], b.mCoords[v].mV[i], tolerance)
+				|| !within(a.mScaledNormals[v].mV[i], b.mScaledNormals[v].mV[i], tolerance)
+				|| !within(a.mNormals[v].mV[i], b.mNormals[v].mV[i], tolerance)
+				|| !within(a.mScaledBinormals[v].mV[i], b.mScaledBinormals[v].mV[i], tolerance)
+				|| !within(a.mBinormals[v].mV[i], b.mBinormals[v].mV[i], tolerance))
+			{
+				return (S32)v;
+			}
+		}
+		for (S32 i = 0; i < 2; i++)
+		{
+			if (!within(a.mTexCoords[v].mV[i], b.mTexCoords[v].mV[i], tolerance))
+			{
+				return (S32)v;
+			}
+		}
+		for (S32 i = 0; i < 4; i++)
+		{
+			if (!within(a.mClothingWeights[v].mV[i], b.mClothingWeights[v].mV[i], tolerance))
+			{
+				return (S32)v;
+			}
+		}
+	}
+	return -1;
+}
+
+// End Stubbing
+// -------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+
+namespace tut
+{
+	// Test wrapper declarations
+	struct polymorphbatch_test
+	{
+		// A mesh the size of the avatar upper body and some morphs of it,
+		// with vertex counts that are not all multiples of 4
+		polymorphbatch_test()
+		{
+			for (U32 m = 0; m < NUM_MORPHS; m++)
+			{
+				mMorphs.push_back(new TestMorph(100 + 37 * m, NUM_VERTICES, 17 + m));
+			}
+		}
+		~polymorphbatch_test()
+		{
+			for (U32 m = 0; m < NUM_MORPHS; m++)
+			{
+				delete mMorphs[m];
+			}
+			LLPolyMorphBatch::setVectorize(false);
+		}
+
+		const F32* getMask(U32 m)
+		{
+			return (m % 3 == 1) ? &mMorphs[m]->mMaskWeights[0] : NULL;
+		}
+		BOOL isClothing(U32 m)
+		{
+			return m % 4 == 2;
+		}
+		F32 getDeltaWeight(U32 m)
+		{
+			return 0.1f + 0.07f * (F32)m;
+		}
+
+		// Applies every morph one at a time the old way to reference, and
+		// in one batch to batched, and checks they come out the same.
+		void checkOneBatch(const char* msg, F32 tolerance)
+		{
+			TestMesh reference(NUM_VERTICES, 5);
+			TestMesh batched(NUM_VERTICES, 5);
+			LLPolyMorphBatch batch;
+			for (U32 m = 0; m < NUM_MORPHS; m++)
+			{
+				apply_morph_reference(reference, *mMorphs[m], getDeltaWeight(m), getMask(m), isClothing(m));
+				batch.add(&mMorphs[m]->mStreams, getDeltaWeight(m), getMask(m), isClothing(m));
+			}
+			ensure(msg, batch.apply(batched.getTarget()));
+			ensure(msg, batch.isEmpty());
+			ensure_equals(msg, compare_meshes(reference, batched, tolerance), -1);
+		}
+
+		enum { NUM_VERTICES = 3000, NUM_MORPHS = 24 };
+		std::vector<TestMorph*> mMorphs;
+	};
+
+	// Tut templating thingamagic: test group, object and test instance
+	typedef test_group<polymorphbatch_test> polymorphbatch_t;
+	typedef polymorphbatch_t::object polymorphbatch_object_t;
+	tut::polymorphbatch_t tut_polymorphbatch("polymorphbatch");
+
+	// ---------------------------------------------------------------------------------------
+	// Test functions
+	// Notes:
+	// * Test as many as you possibly can without requiring a full blown simulation of everything
+	// * The tests are executed in sequence so the test instance state may change between calls
+	// * Remember that you cannot test private methods with tut
+	// ---------------------------------------------------------------------------------------
+
+	// One change per morph in a batch matches applying them one by one
+	template<> template<>
+	void polymorphbatch_object_t::test<1>()
+	{
+		LLPolyMorphBatch::setVectorize(false);
+		checkOneBatch("scalar batch", 0.f);
+	}
+
+	// The SSE2 kernels give the same results
+	template<> template<>
+	void polymorphbatch_object_t::test<2>()
+	{
+		LLPolyMorphBatch::setVectorize(true);
+		if (!LLPolyMorphBatch::getVectorize())
+		{
+			skip("no SSE2");
+		}
+		checkOneBatch("SSE2 batch", SSE2_TOLERANCE);
+	}
+
+	// Several changes of the same morph are merged and applied once
+	template<> template<>
+	void polymorphbatch_object_t::test<3>()
+	{
+		for (S32 vectorize = 0; vectorize < 2; vectorize++)
+		{
+			LLPolyMorphBatch::setVectorize(vectorize != 0);
+
+			TestMesh reference(NUM_VERTICES, 7);
+			TestMesh batched(NUM_VERTICES, 7);
+			LLPolyMorphBatch batch;
+			for (U32 m = 0; m < NUM_MORPHS; m++)
+			{
+				apply_morph_reference(reference, *mMorphs[m], 0.5f, getMask(m), isClothing(m));
+				apply_morph_reference(reference, *mMorphs[m], -0.25f, getMask(m), isClothing(m));
+				batch.add(&mMorphs[m]->mStreams, 0.5f, getMask(m), isClothing(m));
+				batch.add(&mMorphs[m]->mStreams, -0.25f, getMask(m), isClothing(m));
+			}
+			ensure("merged batch applied", batch.apply(batched.getTarget()));
+			ensure_equals("merged batch", compare_meshes(reference, batched, 1.0e-5f), -1);
+		}
+	}
+
+	// A batch whose changes cancel out leaves the mesh alone
+	template<> template<>
+	void polymorphbatch_object_t::test<4>()
+	{
+		for (S32 vectorize = 0; vectorize < 2; vectorize++)
+		{
+			LLPolyMorphBatch::setVectorize(vectorize != 0);
+
+			TestMesh reference(NUM_VERTICES, 9);
+			TestMesh batched(NUM_VERTICES, 9);
+			LLPolyMorphBatch batch;
+			for (U32 m = 0; m < NUM_MORPHS; m++)
+			{
+				batch.add(&mMorphs[m]->mStreams, 0.75f, getMask(m), isClothing(m));
+				batch.add(&mMorphs[m]->mStreams, -0.75f, getMask(m), isClothing(m));
+			}
+			ensure_not("net zero batch", batch.apply(batched.getTarget()));
+			ensure("net zero batch cleared", batch.isEmpty());
+			ensure_equals("net zero batch", compare_meshes(reference, batched, 0.f), -1);
+
+			// and an empty one does nothing at all
+			ensure_not("empty batch", batch.apply(batched.getTarget()));
+		}
+	}
+
+	// Batches can be reused, and the same morph with a different mask is
+	// a separate change
+	template<> template<>
+	void polymorphbatch_object_t::test<5>()
+	{
+		LLPolyMorphBatch::setVectorize(false);
+
+		TestMesh reference(NUM_VERTICES, 11);
+		TestMesh batched(NUM_VERTICES, 11);
+		LLPolyMorphBatch batch;
+		for (S32 frame = 0; frame < 3; frame++)
+		{
+			apply_morph_reference(reference, *mMorphs[0], 0.3f, NULL, FALSE);
+			apply_morph_reference(reference, *mMorphs[0], 0.2f, &mMorphs[0]->mMaskWeights[0], FALSE);
+			batch.add(&mMorphs[0]->mStreams, 0.3f, NULL, FALSE);
+			batch.add(&mMorphs[0]->mStreams, 0.2f, &mMorphs[0]->mMaskWeights[0], FALSE);
+			ensure("reused batch applied", batch.apply(batched.getTarget()));
+			ensure_equals("reused batch", compare_meshes(reference, batched, 0.f), -1);
+		}
+	}
+
+	// Timing of a full appearance update, for the log
+	template<> template<>
+	void polymorphbatch_object_t::test<6>()
+	{
+		const S32 UPDATES = 50;
+		F64 seconds[3];
+
+		for (S32 method = 0; method < 3; method++)
+		{
+			LLPolyMorphBatch::setVectorize(method == 2);
+			if (method == 2 && !LLPolyMorphBatch::getVectorize())
+			{
+				seconds[method] = 0.0;
+				continue;
+			}
+
+			TestMesh mesh(NUM_VERTICES, 13);
+			LLPolyMorphBatch batch;
+			LLTimer timer;
+			for (S32 update = 0; update < UPDATES; update++)
+			{
+				F32 sign = (update & 1) ? -1.f : 1.f;
+				for (U32 m = 0; m < NUM_MORPHS; m++)
+				{
+					if (method == 0)
+					{
+						apply_morph_reference(mesh, *mMorphs[m], sign * getDeltaWeight(m), getMask(m), isClothing(m));
+					}
+					else
+					{
+						batch.add(&mMorphs[m]->mStreams, sign * getDeltaWeight(m), getMask(m), isClothing(m));
+					}
+				}
+				batch.apply(mesh.getTarget());
+			}
+			seconds[method] = timer.getElapsedTimeF64();
+		}
+
+		llinfos << "LLPolyMorphBatch: " << UPDATES << " updates of " << NUM_MORPHS << " morphs, "
+				<< "per morph " << seconds[0] * 1000.0 << "ms, "
+				<< "batched " << seconds[1] * 1000.0 << "ms, "
+				<< "SSE2 " << seconds[2] * 1000.0 << "ms" << llendl;
+		ensure("timed", true);
+	}
+}
@@ -40,6 +40,7 @@
 
 #include "apr_pools.h"
 
+#include "llapr.h"
 #include "llbuffer.h"
 #include "llbufferstream.h"
 #include "lliosocket.h"
@@ -51,6 +52,7 @@
 #include "llsdrpcclient.h"
 #include "llsdrpcserver.h"
 #include "llsdserialize.h"
+#include "llthread.h"
 #include "lluuid.h"
 #include "llinstantmessage.h"
 
@@ -873,6 +875,221 @@ namespace tut
 		ensure("reading string finished", extractor->done());
 		ensure_equals("string was empty", extractor->string(), "");
 	}
+
+	template<> template<>
+	void PumpAndChainTestObject::test<2>()
+	{
+		// same as above on an event driven pump
+		delete mPump;
+		mPump = new LLPumpIO(mPool, LLPumpIO::EVENT_DRIVEN);
+		LLPipeStringExtractor* extractor = new LLPipeStringExtractor();
+
+		mChain.push_back(LLIOPipe::ptr_t(new LLIOFlush));
+		mChain.push_back(LLIOPipe::ptr_t(extractor));
+
+		LLTimer timer;
+		timer.setTimerExpirySec(100.0f);
+
+		mPump->addChain(mChain, DEFAULT_CHAIN_EXPIRY_SECS);
+		while(!extractor->done() && !timer.hasExpired())
+		{
+			mPump->pump();
+			mPump->callback();
+		}
+		
+		ensure("reading string finished", extractor->done());
+		ensure_equals("string was empty", extractor->string(), "");
+		ensure_equals("chain retired", (U32)mPump->runningChains(), (U32)0);
+	}
+
+	template<> template<>
+	void PumpAndChainTestObject::test<3>()
+	{
+		// timeouts on an event driven pump
+		delete mPump;
+		mPump = new LLPumpIO(mPool, LLPumpIO::EVENT_DRIVEN);
+		LLFrameTimer::updateFrameTime();
+
+		mChain.push_back(LLIOPipe::ptr_t(new LLIONull));
+		mPump->addChain(mChain, NEVER_CHAIN_EXPIRY_SECS);
+		mChain.clear();
+		mChain.push_back(LLIOPipe::ptr_t(new LLIONull));
+		mPump->addChain(mChain, 0.5f);
+		mChain.clear();
+		mChain.push_back(LLIOPipe::ptr_t(new LLIONull));
+		mPump->addChain(mChain, 0.2f);
+
+		pump_loop(mPump, 0.1f);
+		ensure_equals("all chains running", (U32)mPump->runningChains(), (U32)3);
+		pump_loop(mPump, 0.3f);
+		ensure_equals("short chain expired", (U32)mPump->runningChains(), (U32)2);
+		pump_loop(mPump, 0.4f);
+		ensure_equals("only the endless chain left", (U32)mPump->runningChains(), (U32)1);
+	}
+
+	template<> template<>
+	void PumpAndChainTestObject::test<4>()
+	{
+		// a chain put to sleep on an event driven pump
+		delete mPump;
+		mPump = new LLPumpIO(mPool, LLPumpIO::EVENT_DRIVEN);
+		LLFrameTimer::updateFrameTime();
+		LLPipeStringExtractor* extractor = new LLPipeStringExtractor();
+
+		mChain.push_back(LLIOPipe::ptr_t(new LLIOSleeper));
+		mChain.push_back(LLIOPipe::ptr_t(extractor));
+		mPump->addChain(mChain, DEFAULT_CHAIN_EXPIRY_SECS);
+
+		pump_loop(mPump, 1.0f);
+		ensure("still sleeping", !extractor->done());
+		pump_loop(mPump, 1.5f);
+		ensure("woke up", extractor->done());
+		ensure_equals(
+			"sleeper response",
+			extractor->string(),
+			std::string("huh? sorry, I was sleeping.\n"));
+	}
+
+	/**
+	 * @brief Pipe which locks its chain the first time through, and
+	 * counts the times it gets past that. Safe to look at from
+	 * another thread.
+	 */
+	class LLIOLockOnce : public LLIOPipe
+	{
+	public:
+		LLIOLockOnce(LLAtomicS32* key, LLAtomicS32* count) :
+			mKey(key), mCount(count), mLocked(false) {}
+	protected:
+		virtual EStatus process_impl(
+			const LLChannelDescriptors& channels,
+			buffer_ptr_t& buffer,
+			bool& eos,
+			LLSD& context,
+			LLPumpIO* pump)
+		{
+			if(!mLocked)
+			{
+				mLocked = true;
+				*mKey = pump->setLock();
+				return STATUS_BREAK;
+			}
+			(*mCount)++;
+			return STATUS_DONE;
+		}
+		LLAtomicS32* mKey;
+		LLAtomicS32* mCount;
+		bool mLocked;
+	};
+
+	/**
+	 * @brief Thread pumping with a poll timeout much longer than any
+	 * test, so it only gets going when the pump is woken up.
+	 */
+	class LLLongPollThread : public LLThread
+	{
+	public:
+		LLLongPollThread(LLPumpIO* pump) :
+			LLThread("long poll"), mPump(pump) {}
+		virtual void shutdown()
+		{
+			setQuitting();
+			mPump->wakeup();
+			LLThread::shutdown();
+		}
+	protected:
+		virtual void run()
+		{
+			while(!isQuitting())
+			{
+				mPump->pump(60 * 1000000);
+			}
+		}
+		LLPumpIO* mPump;
+	};
+
+	// Seconds until another thread sets the value, or the timeout.
+	F32 wait_until_set(LLAtomicS32& value, F32 timeout)
+	{
+		LLTimer timer;
+		while((value == 0) && (timer.getElapsedTimeF32() < timeout))
+		{
+			ms_sleep(1);
+		}
+		return timer.getElapsedTimeF32();
+	}
+
+	template<> template<>
+	void PumpAndChainTestObject::test<5>()
+	{
+		// a locked chain with a deadline far off leaves an event
+		// driven pump waiting for the whole poll timeout.
+		delete mPump;
+		mPump = new LLPumpIO(mPool, LLPumpIO::EVENT_DRIVEN);
+		LLFrameTimer::updateFrameTime();
+		LLAtomicS32 key(0);
+		LLAtomicS32 count(0);
+		mChain.push_back(LLIOPipe::ptr_t(new LLIOLockOnce(&key, &count)));
+		mPump->addChain(mChain, 3600.f);
+		pump_loop(mPump, 0.1f);
+		ensure("chain locked", key != 0);
+
+		LLTimer timer;
+		mPump->pump(200000);
+		ensure("waited in the poll", timer.getElapsedTimeF32() > 0.1f);
+		ensure_equals("still locked", (S32)count, 0);
+	}
+
+	template<> template<>
+	void PumpAndChainTestObject::test<6>()
+	{
+		// a chain added from another thread wakes up a thread safe
+		// pump waiting in the poll.
+		delete mPump;
+		mPump = new LLPumpIO(
+			mPool,
+			LLPumpIO::EVENT_DRIVEN | LLPumpIO::THREAD_SAFE);
+		LLLongPollThread thread(mPump);
+		thread.start();
+		ms_sleep(100);
+
+		LLAtomicS32 key(0);
+		LLAtomicS32 count(0);
+		mChain.push_back(LLIOPipe::ptr_t(new LLIOLockOnce(&key, &count)));
+		mPump->addChain(mChain, NEVER_CHAIN_EXPIRY_SECS);
+		F32 elapsed = wait_until_set(key, 5.f);
+		thread.shutdown();
+		ensure("chain ran", key != 0);
+		ensure("pump woke up for the chain", elapsed < 1.f);
+	}
+
+	template<> template<>
+	void PumpAndChainTestObject::test<7>()
+	{
+		// clearing a lock from another thread gets the chain going
+		// again on a thread safe pump waiting in the poll.
+		delete mPump;
+		mPump = new LLPumpIO(
+			mPool,
+			LLPumpIO::EVENT_DRIVEN | LLPumpIO::THREAD_SAFE);
+		LLLongPollThread thread(mPump);
+		thread.start();
+
+		LLAtomicS32 key(0);
+		LLAtomicS32 count(0);
+		mChain.push_back(LLIOPipe::ptr_t(new LLIOLockOnce(&key, &count)));
+		mPump->addChain(mChain, NEVER_CHAIN_EXPIRY_SECS);
+		wait_until_set(key, 5.f);
+		ensure("chain locked", key != 0);
+		ms_sleep(100);
+		ensure_equals("not run while locked", (S32)count, 0);
+
+		mPump->clearLock(key);
+		F32 elapsed = wait_until_set(count, 5.f);
+		thread.shutdown();
+		ensure_equals("ran once unlocked", (S32)count, 1);
+		ensure("pump woke up for the lock", elapsed < 1.f);
+	}
 }
 
 /*
@@ -1181,6 +1398,196 @@ namespace tut
 		ensure_equals("accepted socked close", count, 1);
 		lldebugs << "** Sleeper should have timed out.." << llendl;
 	}
+
+	/**
+	 * @brief Pipe which sends back what it got, and ends the chain.
+	 */
+	class LLIOEchoOnce : public LLIOPipe
+	{
+	protected:
+		virtual EStatus process_impl(
+			const LLChannelDescriptors& channels,
+			buffer_ptr_t& buffer,
+			bool& eos,
+			LLSD& context,
+			LLPumpIO* pump)
+		{
+			if(0 == buffer->count(channels.in())) return STATUS_BREAK;
+			std::for_each(
+				buffer->beginSegment(),
+				buffer->endSegment(),
+				LLChangeChannel(channels.in(), channels.out()));
+			eos = true;
+			return STATUS_DONE;
+		}
+	};
+
+	// Average seconds for a connection to be echoed by the server on
+	// the pump. The client talks straight to its socket, so only the
+	// server is on the pump.
+	F32 time_echoes(LLPumpIO* pump, apr_pool_t* pool, U16 port, S32 rounds)
+	{
+		LLHost server_host("127.0.0.1", port);
+		LLTimer timer;
+		for(S32 i = 0; i < rounds; ++i)
+		{
+			LLSocket::ptr_t client = LLSocket::create(pool, LLSocket::STREAM_TCP);
+			ensure("Connected to server", client->blockingConnect(server_host));
+			apr_size_t len = 4;
+			ensure_equals(
+				"sent",
+				apr_socket_send(client->getSocket(), "ping", &len),
+				APR_SUCCESS);
+
+			std::string echo;
+			LLTimer expiry;
+			expiry.setTimerExpirySec(DEFAULT_CHAIN_EXPIRY_SECS);
+			while((echo.size() < 4) && !expiry.hasExpired())
+			{
+				LLFrameTimer::updateFrameTime();
+				pump->pump();
+				char buf[8];		/* Flawfinder: ignore */
+				len = sizeof(buf);
+				if(APR_SUCCESS == apr_socket_recv(client->getSocket(), buf, &len))
+				{
+					echo.append(buf, len);
+				}
+			}
+			ensure_equals("echo", echo, std::string("ping"));
+		}
+		return timer.getElapsedTimeF32() / rounds;
+	}
+
+	// Connects clients which never send anything, so the server has
+	// that many chains waiting on a read.
+	void add_idle_clients(
+		LLPumpIO* pump,
+		apr_pool_t* pool,
+		U16 port,
+		S32 count,
+		std::vector<LLSocket::ptr_t>& clients)
+	{
+		LLHost server_host("127.0.0.1", port);
+		for(S32 i = 0; i < count; ++i)
+		{
+			LLSocket::ptr_t client = LLSocket::create(pool, LLSocket::STREAM_TCP);
+			ensure("Connected to server", client->blockingConnect(server_host));
+			clients.push_back(client);
+
+			// accept it before the listen backlog fills up
+			U32 running = pump->runningChains();
+			LLTimer expiry;
+			expiry.setTimerExpirySec(1.0f);
+			while((pump->runningChains() == running) && !expiry.hasExpired())
+			{
+				LLFrameTimer::updateFrameTime();
+				pump->pump();
+			}
+		}
+		pump_loop(pump, 0.1f);
+	}
+
+	template<> template<>
+	void fitness_test_object::test<6>()
+	{
+		// Echo connections with and without a lot of idle connections
+		// on the same server, on a polling and an event driven pump.
+		const S32 IDLE_CONNECTIONS = 200;
+		const S32 ROUNDS = 50;
+		const U16 EVENT_SERVER_PORT = SERVER_LISTEN_PORT + 10;
+
+		LLPumpIO* pumps[2];
+		LLSocket::ptr_t sockets[2];
+		U16 ports[2];
+		pumps[0] = mPump;
+		sockets[0] = mSocket;
+		ports[0] = SERVER_LISTEN_PORT;
+		pumps[1] = new LLPumpIO(mPool, LLPumpIO::EVENT_DRIVEN);
+		sockets[1] = LLSocket::create(mPool, LLSocket::STREAM_TCP, EVENT_SERVER_PORT);
+		ports[1] = EVENT_SERVER_PORT;
+		ensure("event server socket", sockets[1].get() != NULL);
+
+		F32 busy[2];
+		F32 idle[2];
+		for(S32 i = 0; i < 2; ++i)
+		{
+			LLPumpIO::chain_t chain;
+			typedef LLCloneIOFactory<LLIOEchoOnce> echo_t;
+			boost::shared_ptr<LLChainIOFactory> factory(new echo_t(new LLIOEchoOnce));
+			LLIOServerSocket* server = new LLIOServerSocket(
+				mPool,
+				sockets[i],
+				factory);
+			chain.push_back(LLIOPipe::ptr_t(server));
+			pumps[i]->addChain(chain, NEVER_CHAIN_EXPIRY_SECS);
+			pump_loop(pumps[i], 0.1f);
+
+			idle[i] = time_echoes(pumps[i], mPool, ports[i], ROUNDS);
+			std::vector<LLSocket::ptr_t> clients;
+			add_idle_clients(pumps[i], mPool, ports[i], IDLE_CONNECTIONS, clients);
+			ensure_equals(
+				"idle connections accepted",
+				(U32)pumps[i]->runningChains(),
+				(U32)IDLE_CONNECTIONS + 1);
+			busy[i] = time_echoes(pumps[i], mPool, ports[i], ROUNDS);
+			clients.clear();
+			pump_loop(pumps[i], 0.1f);
+		}
+		llinfos << "fitness_test_object::test<6> ms per echo, "
+				<< "no idle connections / " << IDLE_CONNECTIONS
+				<< " idle connections: polling pump " << idle[0] * 1000.f
+				<< " / " << busy[0] * 1000.f
+				<< ", event driven pump " << idle[1] * 1000.f
+				<< " / " << busy[1] * 1000.f << llendl;
+
+		sockets[1].reset();
+		delete pumps[1];
+	}
+
+	template<> template<>
+	void fitness_test_object::test<7>()
+	{
+		// An event driven pump puts each socket in the pollset once,
+		// so a client writing and reading the same socket on two
+		// chains works.
+		delete mPump;
+		mPump = new LLPumpIO(mPool, LLPumpIO::EVENT_DRIVEN);
+		LLPumpIO::chain_t chain;
+		typedef LLCloneIOFactory<LLIOEchoOnce> echo_t;
+		boost::shared_ptr<LLChainIOFactory> factory(new echo_t(new LLIOEchoOnce));
+		chain.push_back(LLIOPipe::ptr_t(new LLIOServerSocket(mPool, mSocket, factory)));
+		mPump->addChain(chain, NEVER_CHAIN_EXPIRY_SECS);
+		pump_loop(mPump, 0.1f);
+
+		LLHost server_host("127.0.0.1", SERVER_LISTEN_PORT);
+		LLSocket::ptr_t client = LLSocket::create(mPool, LLSocket::STREAM_TCP);
+		ensure("Connected to server", client->blockingConnect(server_host));
+		// the reader goes first, so it is waiting on the socket when
+		// the writer chain comes and goes.
+		// hang on to the extractor, the chain goes away when it is done.
+		LLPipeStringExtractor* extractor = new LLPipeStringExtractor();
+		LLIOPipe::ptr_t extractor_ptr(extractor);
+		chain.clear();
+		chain.push_back(LLIOPipe::ptr_t(new LLIOSocketReader(client)));
+		chain.push_back(extractor_ptr);
+		mPump->addChain(chain, DEFAULT_CHAIN_EXPIRY_SECS);
+		pump_loop(mPump, 0.1f);
+
+		chain.clear();
+		chain.push_back(LLIOPipe::ptr_t(new LLPipeStringInjector("ping")));
+		chain.push_back(LLIOPipe::ptr_t(new LLIOSocketWriter(client)));
+		mPump->addChain(chain, DEFAULT_CHAIN_EXPIRY_SECS);
+		client.reset();
+
+		LLTimer expiry;
+		expiry.setTimerExpirySec(5.0f);
+		while(!extractor->done() && !expiry.hasExpired())
+		{
+			LLFrameTimer::updateFrameTime();
+			mPump->pump();
+		}
+		ensure_equals("echo", extractor->string(), std::string("ping"));
+	}
 }
 
 namespace tut
@@ -40,6 +40,9 @@
 #include "llerror.h"
 #include "llmemtype.h"
 
+#define APR_WANT_IOVEC
+#include "apr_want.h"
+
 
 namespace tut
 {
@@ -275,4 +278,95 @@ namespace tut
 		it = bufferArray.constructSegmentAfter(NULL, segment);
 		ensure("constructSegmentAfter() function failed", (it == end));
 	}
+
+	// appendSlice() shares the data, which outlives the source
+	template<> template<>
+	void buffer_object_t::test<14>()
+	{
+		const char array[] = "SecondLife is a Virtual World";
+		S32 len = strlen(array);
+		LLBufferArray* source = new LLBufferArray;
+		source->append(0, (U8*)array, len);
+
+		char buf[255];
+		S32 len1 = 10;
+		U8* last = source->readAfter(0, NULL, (U8*)buf, len1);
+
+		LLBufferArray slice;
+		ensure("appendSlice() past the end", !slice.appendSlice(1, *source, 0, last, len));
+		ensure("appendSlice() failed", slice.appendSlice(1, *source, 0, last, 5));
+		ensure_equals("appendSlice() wrong count", slice.count(1), 5);
+		ensure("appendSlice() copied", (*slice.beginSegment()).data() == last + 1);
+
+		// further writes to the source do not land in shared memory
+		source->append(0, (U8*)array, len);
+		delete source;
+
+		len1 = 5;
+		slice.readAfter(1, NULL, (U8*)buf, len1);
+		ensure_equals("appendSlice() wrong data", std::string(buf, len1), std::string(" is a"));
+	}
+
+	// getIOVecs()
+	template<> template<>
+	void buffer_object_t::test<15>()
+	{
+		const char array[] = "SecondLife is a Virtual World";
+		S32 len = strlen(array);
+		LLBufferArray bufferArray;
+		bufferArray.append(0, (U8*)array, len);
+		bufferArray.append(1, (U8*)array, len);
+		bufferArray.append(0, (U8*)array, len);
+
+		struct iovec vecs[4];
+		S32 bytes = 0;
+		S32 count = bufferArray.getIOVecs(0, NULL, vecs, 4, bytes);
+		ensure_equals("getIOVecs() wrong count", count, 2);
+		ensure_equals("getIOVecs() wrong bytes", bytes, len * 2);
+		ensure_equals("getIOVecs() wrong data", std::string((char*)vecs[1].iov_base, vecs[1].iov_len), std::string(array));
+
+		char buf[255];
+		S32 len1 = 11;
+		U8* last = bufferArray.readAfter(0, NULL, (U8*)buf, len1);
+		count = bufferArray.getIOVecs(0, last, vecs, 1, bytes);
+		ensure_equals("getIOVecs() partial count", count, 1);
+		ensure_equals("getIOVecs() partial data", std::string((char*)vecs[0].iov_base, vecs[0].iov_len), std::string("is a Virtual World"));
+	}
+
+	// unused segment memory is handed out again
+	template<> template<>
+	void buffer_object_t::test<16>()
+	{
+		LLBufferArray bufferArray;
+		LLChannelDescriptors channelDescriptors;
+		for(S32 i = 0; i < 100; ++i)
+		{
+			LLBufferArray::segment_iterator_t it;
+			it = bufferArray.makeSegment(channelDescriptors.out(), 1000);
+			U8* last = (*it).data() + 9;
+			it = bufferArray.splitAfter(last);
+			bufferArray.eraseSegment(++it);
+		}
+		ensure_equals("trimmed segments wasted memory", bufferArray.capacity(), (S32)LLHeapBuffer::DEFAULT_HEAP_BUFFER_SIZE);
+		ensure_equals("trimmed segments lost data", bufferArray.count(channelDescriptors.out()), 1000);
+	}
+
+	// recycled heap buffers
+	template<> template<>
+	void buffer_object_t::test<17>()
+	{
+		LLHeapBuffer::initPool(4);
+		U8* memory = NULL;
+		{
+			LLBufferArray bufferArray;
+			bufferArray.append(0, (U8*)"a", 1);
+			memory = (*bufferArray.beginSegment()).data();
+		}
+		{
+			LLBufferArray bufferArray;
+			bufferArray.append(0, (U8*)"b", 1);
+			ensure("heap buffer not recycled", memory == (*bufferArray.beginSegment()).data());
+		}
+		LLHeapBuffer::cleanupPool();
+	}
 }
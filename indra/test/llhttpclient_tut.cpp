@@ -44,6 +44,9 @@
 #if !LL_WINDOWS
 
 #include "lltut.h"
+#include "llbufferstream.h"
+#include "llchainio.h"
+#include "llcurl.h"
 #include "llhttpclient.h"
 #include "llformat.h"
 #include "llpipeutil.h"
@@ -82,6 +85,65 @@ namespace tut
 		}
 	};
 
+	// A stand in for a texture server. Answers each request on a
+	// connection with a fixed size body and keeps the connection open
+	// unless the request asks for it to be closed.
+	class KeepAliveResponder : public LLIOPipe
+	{
+	public:
+		static const S32 BODY_SIZE = 2048;
+		static S32 sConnections;
+
+		KeepAliveResponder() : mLastRead(NULL) { ++sConnections; }
+
+	protected:
+		virtual EStatus process_impl(
+			const LLChannelDescriptors& channels,
+			buffer_ptr_t& buffer,
+			bool& eos,
+			LLSD& context,
+			LLPumpIO* pump)
+		{
+			S32 len = buffer->countAfter(channels.in(), mLastRead);
+			if(len > 0)
+			{
+				std::vector<U8> bytes(len);
+				mLastRead = buffer->readAfter(channels.in(), mLastRead, &bytes[0], len);
+				mPending.append((const char*)&bytes[0], len);
+			}
+
+			EStatus status = eos ? STATUS_DONE : STATUS_BREAK;
+			std::string::size_type end;
+			while((end = mPending.find("\r\n\r\n")) != std::string::npos)
+			{
+				bool close = (mPending.substr(0, end).find("Connection: close") != std::string::npos);
+				mPending.erase(0, end + 4);
+
+				LLBufferStream ostr(channels, buffer.get());
+				ostr << "HTTP/1.1 200 OK\r\n"
+					 << "Content-Type: application/octet-stream\r\n"
+					 << "Content-Length: " << BODY_SIZE << "\r\n";
+				if(close)
+				{
+					ostr << "Connection: close\r\n";
+				}
+				ostr << "\r\n" << std::string(BODY_SIZE, 'x');
+				ostr.flush();
+
+				if(close)
+				{
+					return STATUS_DONE;
+				}
+				status = STATUS_OK;
+			}
+			return status;
+		}
+
+		U8* mLastRead;
+		std::string mPending;
+	};
+	S32 KeepAliveResponder::sConnections = 0;
+
 	LLHTTPRegistration<LLSDStorageNode> gStorageNode("/test/storage");
 	LLHTTPRegistration<ErrorNode>		gErrorNode("/test/error");
 	LLHTTPRegistration<TimeOutNode>		gTimeOutNode("/test/timeout");
@@ -138,12 +200,92 @@ namespace tut
 			delete mServerPump;
 			mServerPump = NULL;
 		}
+
+		void setupKeepAliveServer()
+		{
+			LLSocket::ptr_t socket = LLSocket::create(
+				mPool, LLSocket::STREAM_TCP, KEEP_ALIVE_PORT);
+			ensure("keep alive server socket", socket.get() != NULL);
+			boost::shared_ptr<LLChainIOFactory> factory(
+				new LLSimpleIOFactory<KeepAliveResponder>);
+			LLPumpIO::chain_t chain;
+			chain.push_back(LLIOPipe::ptr_t(
+				new LLIOServerSocket(mPool, socket, factory)));
+			mServerPump->addChain(chain, NEVER_CHAIN_EXPIRY_SECS);
+			KeepAliveResponder::sConnections = 0;
+		}
+
+		void runRequests(LLCurlRequest& request, std::vector<S32>& done,
+						 size_t expected, float timeout = 20.0f)
+		{
+			LLTimer timer;
+			timer.setTimerExpirySec(timeout);
+			while(done.size() < expected && !timer.hasExpired())
+			{
+				mServerPump->pump();
+				mServerPump->callback();
+				request.process();
+			}
+		}
 	
 	private:
 		apr_pool_t* mPool;
 		LLPumpIO* mServerPump;
 		LLPumpIO* mClientPump;
 
+	protected:
+		static const U16 KEEP_ALIVE_PORT = 8889;
+
+		// Records the order requests finish in, or -1 for a failure.
+		class OrderResponder : public LLCurl::Responder
+		{
+		public:
+			OrderResponder(std::vector<S32>& done, S32 id)
+				: mDone(done), mID(id)
+			{
+			}
+
+			virtual void completedRaw(
+				U32 status,
+				const std::string& reason,
+				const LLChannelDescriptors& channels,
+				const LLIOPipe::buffer_ptr_t& buffer)
+			{
+				mDone.push_back(isGoodStatus(status) ? mID : -1);
+			}
+
+		private:
+			std::vector<S32>& mDone;
+			S32 mID;
+		};
+
+		F32 timeRequests(S32 count, bool close_connections, LLCurlRequest::Stats& stats)
+		{
+			LLCurlRequest request;
+			LLCurlRequest::headers_t headers;
+			if(close_connections)
+			{
+				headers.push_back("Connection: close");
+			}
+			std::string url = llformat("http://127.0.0.1:%d/texture", KEEP_ALIVE_PORT);
+			std::vector<S32> done;
+
+			LLTimer timer;
+			for(S32 i = 0; i < count; ++i)
+			{
+				request.getByteRange(url, headers, 0, KeepAliveResponder::BODY_SIZE,
+									 new OrderResponder(done, i), count - i);
+			}
+			runRequests(request, done, count);
+			F32 elapsed = timer.getElapsedTimeF32();
+
+			ensure_equals("all requests finished", done.size(), (size_t)count);
+			ensure("no request failed",
+				   std::find(done.begin(), done.end(), -1) == done.end());
+			stats = request.getStats();
+			return elapsed;
+		}
+
 		
 	protected:
 		void ensureStatusOK()
@@ -382,6 +524,68 @@ namespace tut
 		ensureStatusOK();
 		ensure("result object wasn't destroyed", mResultDeleted);
 	}
+
+	template<> template<>
+	void HTTPClientTestObject::test<10>()
+	{
+		// one request per host at a time, the waiting ones in priority order
+		setupKeepAliveServer();
+
+		LLCurlRequest request;
+		request.setMaxRequestsPerHost(1);
+		LLCurlRequest::headers_t headers;
+		std::string url = llformat("http://127.0.0.1:%d/texture", KEEP_ALIVE_PORT);
+		std::vector<S32> done;
+
+		ensure("first request", request.getByteRange(url, headers, 0, 1024, new OrderResponder(done, 0), 0));
+		request.getByteRange(url, headers, 0, 1024, new OrderResponder(done, 1), 1);
+		request.getByteRange(url, headers, 0, 1024, new OrderResponder(done, 2), 5);
+		request.getByteRange(url, headers, 0, 1024, new OrderResponder(done, 3), 3);
+		ensure_equals("waiting requests", request.getStats().mQueued, 3U);
+
+		runRequests(request, done, 4);
+		ensure_equals("finished requests", done.size(), (size_t)4);
+		ensure_equals("first", done[0], 0);
+		ensure_equals("highest priority next", done[1], 2);
+		ensure_equals("then", done[2], 3);
+		ensure_equals("lowest priority last", done[3], 1);
+
+		const LLCurlRequest::Stats& stats = request.getStats();
+		ensure_equals("nothing waiting", stats.mQueued, 0U);
+		ensure_equals("most waiting", stats.mMaxQueued, 3U);
+		ensure_equals("completed", stats.mCompleted, 4U);
+		ensure_equals("one connection to the server", KeepAliveResponder::sConnections, 1);
+		ensure_equals("connection kept alive", stats.mReusedConnections, 3U);
+	}
+
+	template<> template<>
+	void HTTPClientTestObject::test<11>()
+	{
+		// small ranged gets with kept alive connections against a new
+		// connection for each
+		const S32 REQUESTS = 200;
+		setupKeepAliveServer();
+
+		LLCurlRequest::Stats pooled;
+		F32 pooled_time = timeRequests(REQUESTS, false, pooled);
+		S32 pooled_connections = KeepAliveResponder::sConnections;
+
+		KeepAliveResponder::sConnections = 0;
+		LLCurlRequest::Stats closed;
+		F32 closed_time = timeRequests(REQUESTS, true, closed);
+		S32 closed_connections = KeepAliveResponder::sConnections;
+
+		llinfos << "HTTPClientTestObject::test<11> " << REQUESTS << " gets, kept alive: "
+				<< (pooled_time * 1000.f / REQUESTS) << "ms each on "
+				<< pooled_connections << " connections, closed: "
+				<< (closed_time * 1000.f / REQUESTS) << "ms each on "
+				<< closed_connections << " connections" << llendl;
+
+		ensure("connections were reused", pooled.mReusedConnections > 0);
+		ensure("no more connections than the per host limit",
+			   pooled_connections <= LLCurlRequest().getMaxRequestsPerHost());
+		ensure_equals("closed connections were not reused", closed.mReusedConnections, 0U);
+	}
 }
 
 #endif	// !LL_WINDOWS
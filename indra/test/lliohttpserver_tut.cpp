@@ -35,7 +35,10 @@
 #include "linden_common.h"
 #include "lltut.h"
 #include "llbufferstream.h"
+#include "llhost.h"
 #include "lliohttpserver.h"
+#include "lliosocket.h"
+#include "llioutil.h"
 #include "llsdhttpserver.h"
 #include "llsdserialize.h"
 
@@ -80,6 +83,26 @@ namespace tut
 			}
 		};
 
+		// Sends the request body back without copying it.
+		class WireEcho : public LLIOPipe
+		{
+		protected:
+			virtual EStatus process_impl(
+				const LLChannelDescriptors& channels,
+				buffer_ptr_t& buffer,
+				bool& eos,
+				LLSD& context,
+				LLPumpIO* pump)
+			{
+				if(!eos) return STATUS_BREAK;
+				std::for_each(
+					buffer->beginSegment(),
+					buffer->endSegment(),
+					LLChangeChannel(channels.in(), channels.out()));
+				return STATUS_DONE;
+			}
+		};
+
 		HTTPServiceTestData()
 			: mResponse(NULL)
 		{
@@ -346,6 +369,75 @@ namespace tut
 	}
 
 
+	template<> template<>
+	void HTTPServiceTestObject::test<9>()
+	{
+		// loopback throughput through the socket pipes and the http
+		// server, one connection per request.
+		const U16 SERVER_LISTEN_PORT = 13051;
+		const S32 REQUESTS = 20;
+		const S32 BODY_SIZE = 1024 * 1024;
+
+		apr_pool_t* pool;
+		apr_pool_create(&pool, NULL);
+		LLPumpIO* pump = new LLPumpIO(pool);
+
+		LLHTTPNode& root = LLIOHTTPServer::create(pool, *pump, SERVER_LISTEN_PORT);
+		root.addNode("/wire/echo", new LLHTTPNodeForPipe<WireEcho>);
+		pump_loop(pump, 0.1f);
+
+		std::string body(BODY_SIZE, 'x');
+		std::ostringstream request;
+		request << "POST /wire/echo HTTP/1.0\r\n";
+		request << "Content-Length: " << body.size() << "\r\n";
+		request << "\r\n";
+		request << body;
+
+		LLTimer timer;
+		S64 bytes = 0;
+		for(S32 i = 0; i < REQUESTS; ++i)
+		{
+			LLSocket::ptr_t client = LLSocket::create(pool, LLSocket::STREAM_TCP);
+			LLHost server_host("127.0.0.1", SERVER_LISTEN_PORT);
+			ensure("Connected to server", client->blockingConnect(server_host));
+
+			LLPumpIO::chain_t chain;
+			chain.push_back(LLIOPipe::ptr_t(new LLPipeStringInjector(request.str())));
+			chain.push_back(LLIOPipe::ptr_t(new LLIOSocketWriter(client)));
+			chain.push_back(LLIOPipe::ptr_t(new LLIONull));
+			pump->addChain(chain, DEFAULT_CHAIN_EXPIRY_SECS);
+
+			LLPipeStringExtractor* extractor = new LLPipeStringExtractor();
+			chain.clear();
+			chain.push_back(LLIOPipe::ptr_t(new LLIOSocketReader(client)));
+			chain.push_back(LLIOPipe::ptr_t(extractor));
+			pump->addChain(chain, DEFAULT_CHAIN_EXPIRY_SECS);
+			client.reset();
+
+			LLTimer expiry;
+			expiry.setTimerExpirySec(DEFAULT_CHAIN_EXPIRY_SECS);
+			while(!extractor->done() && !expiry.hasExpired())
+			{
+				LLFrameTimer::updateFrameTime();
+				pump->pump();
+				pump->callback();
+			}
+			ensure("echo finished", extractor->done());
+			std::string result = extractor->string();
+			ensure_starts_with("echo status", result, "HTTP/1.0 200 OK\r\n");
+			ensure_ends_with("echo body", result, body);
+			bytes += request.str().size() + result.size();
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+		llinfos << "HTTPServiceTestObject::test<9> " << REQUESTS
+				<< " echoes of " << BODY_SIZE << " bytes in " << elapsed
+				<< "s, " << (bytes / (1024.f * 1024.f)) / llmax(elapsed, 0.001f)
+				<< " MB/s" << llendl;
+
+		delete pump;
+		apr_pool_destroy(pool);
+	}
+
 	/* TO DO:
 		test generation of not found and method not allowed errors
 	*/
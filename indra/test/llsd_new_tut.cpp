@@ -725,27 +725,27 @@ namespace tut
 		
 		{
 			SDAllocationCheck check("assign integer value", 1);
-			LLSD v = 45;
-			v = 33;
+			LLSD v = 4500;
+			v = 3300;
 			v = 0;
 		}
 
 		{
 			SDAllocationCheck check("copy construct integer", 1);
-			LLSD v = 45;
+			LLSD v = 4500;
 			LLSD w = v;
 		}
 
 		{
 			SDAllocationCheck check("assign integer", 1);
-			LLSD v = 45;
+			LLSD v = 4500;
 			LLSD w;
 			w = v;
 		}
 		
 		{
 			SDAllocationCheck check("avoids extra clone", 2);
-			LLSD v = 45;
+			LLSD v = 4500;
 			LLSD w = v;
 			w = "nice day";
 		}
@@ -760,6 +760,42 @@ namespace tut
 		ensure("type is a string", v.isString());
 	}
 
+	template<> template<>
+	void SDTestObject::test<15>()
+		// common small scalars share one implementation
+	{
+		SDCleanupCheck check;
+		
+		{
+			SDAllocationCheck check("shared scalars", 0);
+			LLSD b = true;
+			b = false;
+			LLSD i = 45;
+			i = -1;
+			i = 255;
+			LLSD r = 0.0;
+			LLSD s = "";
+			LLSD u = LLUUID::null;
+		}
+		
+		{
+			SDAllocationCheck check("unshared scalars", 4);
+			LLSD i = 256;
+			LLSD r = -0.0;
+			LLSD s = "nice day";
+			LLSD u = LLUUID::generateNewID();
+		}
+		
+		{
+			SDAllocationCheck check("changing a shared scalar", 1);
+			LLSD a = 7;
+			LLSD b = 7;
+			b.assign(4500);
+			ensureTypeAndValue("other shared value unaltered", a, 7);
+			ensureTypeAndValue("changed shared value", b, 4500);
+		}
+	}
+
 	/* TO DO:
 		conversion of undefined to UUID, Date, URI and Binary
 		conversion of undefined to map and array
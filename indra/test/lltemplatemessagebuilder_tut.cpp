@@ -973,5 +973,151 @@ namespace tut
 		ensure_equals("Ensure unchanged buffer ", strlen(outBuffer), 0);
 		delete reader;
 	}
-}
 
+	template<> template<>
+	void LLTemplateMessageBuilderTestObject::test<46>()
+		// repeated blocks mixing fixed and variable length fields
+	{
+		LLMessageTemplate messageTemplate = defaultTemplate();
+		LLMessageBlock* block = createBlock(_PREHASH_Test0, MVT_U32, 4);
+		block->addVariable(_PREHASH_Test1, MVT_VARIABLE, 1);
+		block->addVariable(_PREHASH_Test2, MVT_LLUUID, 16);
+		messageTemplate.addBlock(block);
+		messageTemplate.addBlock(createBlock(_PREHASH_Test1, MVT_U16, 2, MBT_SINGLE));
+
+		const S32 count = 3;
+		LLUUID ids[count];
+		std::string names[count] = { "", "one", "two two" };
+		LLTemplateMessageBuilder* builder = defaultBuilder(messageTemplate);
+		for (S32 i = 0; i < count; ++i)
+		{
+			if (i)
+			{
+				builder->nextBlock(_PREHASH_Test0);
+			}
+			ids[i].generate();
+			builder->addU32(_PREHASH_Test0, 1000 + i);
+			builder->addString(_PREHASH_Test1, names[i]);
+			builder->addUUID(_PREHASH_Test2, ids[i]);
+		}
+		builder->nextBlock(_PREHASH_Test1);
+		builder->addU16(_PREHASH_Test0, 0xbeef);
+		LLTemplateMessageReader* reader = setReader(messageTemplate, builder);
+
+		ensure_equals("Ensure repeat count", reader->getNumberOfBlocks(_PREHASH_Test0), count);
+		ensure_equals("Ensure unknown block", reader->getNumberOfBlocks(_PREHASH_Test2), 0);
+		for (S32 i = 0; i < count; ++i)
+		{
+			U32 outU32;
+			LLUUID outUUID;
+			std::string outString;
+			reader->getU32(_PREHASH_Test0, _PREHASH_Test0, outU32, i);
+			reader->getString(_PREHASH_Test0, _PREHASH_Test1, outString, i);
+			reader->getUUID(_PREHASH_Test0, _PREHASH_Test2, outUUID, i);
+			ensure_equals("Ensure U32", outU32, (U32)(1000 + i));
+			ensure_equals("Ensure String", outString, names[i]);
+			ensure_equals("Ensure UUID", outUUID, ids[i]);
+			ensure_equals("Ensure variable size", 
+						  reader->getSize(_PREHASH_Test0, i, _PREHASH_Test1), 
+						  (S32)names[i].size() + 1);
+		}
+		ensure_equals("Ensure missing instance", 
+					  reader->getSize(_PREHASH_Test0, count, _PREHASH_Test1), 
+					  LL_BLOCK_NOT_IN_MESSAGE);
+		ensure_equals("Ensure missing variable", 
+					  reader->getSize(_PREHASH_Test1, _PREHASH_Test1), 
+					  LL_VARIABLE_NOT_IN_BLOCK);
+
+		U16 outU16;
+		reader->getU16(_PREHASH_Test1, _PREHASH_Test0, outU16);
+		ensure_equals("Ensure U16", outU16, 0xbeef);
+		ensure_equals("Ensure fixed size", reader->getSize(_PREHASH_Test1, _PREHASH_Test0), 2);
+		delete reader;
+	}
+
+	template<> template<>
+	void LLTemplateMessageBuilderTestObject::test<47>()
+		// one reader decoding successive packets, template changed in between
+	{
+		LLMessageTemplate messageTemplate = defaultTemplate();
+		messageTemplate.addBlock(defaultBlock(MVT_U32, 4));
+		numberMap[1] = &messageTemplate;
+		LLTemplateMessageReader reader(numberMap);
+
+		const U32 bufferSize = 1024;
+		U8 buffer[bufferSize];
+		for (U32 i = 0; i < 2; ++i)
+		{
+			LLTemplateMessageBuilder* builder = defaultBuilder(messageTemplate);
+			builder->addU32(_PREHASH_Test0, i);
+			if (i)
+			{
+				builder->nextBlock(_PREHASH_Test1);
+				builder->addF32(_PREHASH_Test0, 0.5f);
+			}
+			memset(buffer, 0, LL_PACKET_ID_SIZE);
+			U32 builtSize = builder->buildMessage(buffer, bufferSize, 0);
+			delete builder;
+
+			reader.validateMessage(buffer, builtSize, LLHost());
+			reader.readMessage(buffer, LLHost());
+			U32 outValue;
+			reader.getU32(_PREHASH_Test0, _PREHASH_Test0, outValue);
+			ensure_equals("Ensure U32", outValue, i);
+			if (i)
+			{
+				F32 outF32;
+				reader.getF32(_PREHASH_Test1, _PREHASH_Test0, outF32);
+				ensure_equals("Ensure F32", outF32, 0.5f);
+			}
+			reader.clearMessage();
+
+			// the new block must be picked up by the next decode
+			if (!i)
+			{
+				messageTemplate.addBlock(createBlock(_PREHASH_Test1, MVT_F32, 4, MBT_SINGLE));
+			}
+		}
+	}
+
+	template<> template<>
+	void LLTemplateMessageBuilderTestObject::test<48>()
+		// forwarding repeated blocks keeps every instance
+	{
+		LLMessageTemplate messageTemplate = defaultTemplate();
+		LLMessageBlock* block = createBlock(_PREHASH_Test0, MVT_U32, 4);
+		block->addVariable(_PREHASH_Test1, MVT_VARIABLE, 2);
+		messageTemplate.addBlock(block);
+
+		const S32 count = 4;
+		LLTemplateMessageBuilder* builder = defaultBuilder(messageTemplate);
+		for (S32 i = 0; i < count; ++i)
+		{
+			if (i)
+			{
+				builder->nextBlock(_PREHASH_Test0);
+			}
+			builder->addU32(_PREHASH_Test0, i * 7);
+			builder->addString(_PREHASH_Test1, llformat("data %d", i));
+		}
+		LLTemplateMessageReader* reader = setReader(messageTemplate, builder);
+
+		builder = defaultBuilder(messageTemplate);
+		builder->newMessage(_PREHASH_TestMessage);
+		reader->copyToBuilder(*builder);
+		delete reader;
+		reader = setReader(messageTemplate, builder);
+
+		ensure_equals("Ensure repeat count", reader->getNumberOfBlocks(_PREHASH_Test0), count);
+		for (S32 i = 0; i < count; ++i)
+		{
+			U32 outU32;
+			std::string outString;
+			reader->getU32(_PREHASH_Test0, _PREHASH_Test0, outU32, i);
+			reader->getString(_PREHASH_Test0, _PREHASH_Test1, outString, i);
+			ensure_equals("Ensure U32", outU32, (U32)(i * 7));
+			ensure_equals("Ensure String", outString, llformat("data %d", i));
+		}
+		delete reader;
+	}
+}